@@ -1040,3 +1040,237 @@ done:
 no_pkt:
    return Status;
 }
+
+/**
+  Split the current bulk-in aggregate into the receive ring.
+
+  This routine calls ::Ax88179BulkIn when the previous aggregate has been
+  consumed.  Each frame is validated and queued for ::SN_Receive.  Frames
+  which arrive while the ring is full are dropped and counted in the
+  statistics.
+
+  @param [in] NicDevice       Pointer to the NIC_DEVICE structure
+
+  @retval EFI_SUCCESS          At least one frame is queued in the ring.
+  @retval EFI_NOT_READY        No frames are available.
+
+**/
+EFI_STATUS
+Ax88179RxRingFill (
+  IN NIC_DEVICE *NicDevice
+  )
+{
+  EFI_NETWORK_STATISTICS  *Stats;
+  ETHERNET_HEADER         *Header;
+  RX_PACKET               *RxPacket;
+  EFI_STATUS              Status;
+  UINT16                  RxHdr;
+  UINT16                  Length;
+
+  Stats = &NicDevice->Statistics;
+
+  if (NicDevice->PktCnt == 0) {
+    Status = Ax88179BulkIn (NicDevice);
+    if (EFI_ERROR (Status)) {
+      return (NicDevice->RxCount != 0) ? EFI_SUCCESS : EFI_NOT_READY;
+    }
+  }
+
+  while (NicDevice->PktCnt != 0) {
+    RxHdr = *((UINT16*) (NicDevice->CurPktHdrOff + 2));
+    Length = RxHdr & 0x1fff;
+
+    //
+    //  The packet headers follow the packet data, so a length that runs
+    //  into them or a missing EEEE marker means the rest is unusable
+    //
+    if ((Length < 2) ||
+        ((NicDevice->CurPktOff + Length) > NicDevice->CurPktHdrOff) ||
+        (*((UINT16*)NicDevice->CurPktOff) != 0xEEEE)) {
+      Stats->RxTotalFrames += NicDevice->PktCnt;
+      Stats->RxDroppedFrames += NicDevice->PktCnt;
+      NicDevice->PktCnt = 0;
+      break;
+    }
+
+    Length -= 2; /*EEEE*/
+    Stats->RxTotalFrames++;
+
+    if ((RxHdr & RXHDR_CRCERR) != 0) {
+      Stats->RxCrcErrorFrames++;
+    } else if ((RxHdr & RXHDR_DROP) != 0) {
+      Stats->RxDroppedFrames++;
+    } else if (Length < MIN_ETHERNET_PKT_SIZE) {
+      Stats->RxUndersizeFrames++;
+    } else if ((Length - ETHERNET_HEADER_SIZE) > MAX_ETHERNET_PKT_SIZE) {
+      Stats->RxOversizeFrames++;
+    } else if (NicDevice->RxCount == AX88179_RX_RING_SIZE) {
+      Stats->RxDroppedFrames++;
+    } else {
+      RxPacket = &NicDevice->RxRing[(NicDevice->RxHead + NicDevice->RxCount) % AX88179_RX_RING_SIZE];
+      RxPacket->Length = Length;
+      CopyMem (RxPacket->Data, NicDevice->CurPktOff + 2, Length);
+      NicDevice->RxCount++;
+
+      Header = (ETHERNET_HEADER *) RxPacket->Data;
+      if ((Header->DestAddr[0] & 1) == 0) {
+        Stats->RxUnicastFrames++;
+      } else if (CompareMem (Header->DestAddr,
+                             &NicDevice->SimpleNetworkData.BroadcastAddress,
+                             PXE_HWADDR_LEN_ETHER) == 0) {
+        Stats->RxBroadcastFrames++;
+      } else {
+        Stats->RxMulticastFrames++;
+      }
+      Stats->RxGoodFrames++;
+      Stats->RxTotalBytes += Length;
+    }
+
+    NicDevice->PktCnt--;
+    NicDevice->CurPktHdrOff += 4;
+    NicDevice->CurPktOff += (Length + 2 + 7) & 0xfff8;
+  }
+
+  return (NicDevice->RxCount != 0) ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+/**
+  Discard the frames queued in the receive ring and the rest of the
+  current bulk-in aggregate.
+
+  @param [in] NicDevice       Pointer to the NIC_DEVICE structure
+
+**/
+VOID
+Ax88179RxRingFlush (
+  IN NIC_DEVICE *NicDevice
+  )
+{
+  NicDevice->RxHead = 0;
+  NicDevice->RxCount = 0;
+  NicDevice->PktCnt = 0;
+}
+
+/**
+  Refill the receive ring between calls to ::SN_Receive.
+
+  The USB I/O protocol has no asynchronous bulk transfers, so frames that
+  arrive while the network stack is busy are picked up from this periodic
+  timer instead.  The timer stays out of the way while ::SN_Receive is
+  polling the device itself.
+
+  @param [in] Event           Timer event
+  @param [in] Context         Pointer to the NIC_DEVICE structure
+
+**/
+VOID
+EFIAPI
+Ax88179RxTimer (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  NIC_DEVICE *NicDevice;
+
+  NicDevice = (NIC_DEVICE *) Context;
+
+  if ((EfiSimpleNetworkInitialized != NicDevice->SimpleNetworkData.State) ||
+      !NicDevice->LinkUp || !NicDevice->Complete) {
+    return;
+  }
+
+  //
+  //  Send frames which were queued since the last call into the driver
+  //
+  Ax88179TxFlush (NicDevice);
+
+  if (NicDevice->RxPolled) {
+    NicDevice->RxPolled = FALSE;
+    return;
+  }
+
+  Ax88179RxRingFill (NicDevice);
+}
+
+/**
+  Send the frames queued by ::SN_Transmit in a single bulk-out transfer.
+
+  Each frame in the aggregation buffer carries its own AX88179 transmit
+  header, so the controller splits them again.  The caller's buffers move
+  to the completed part of the transmit queue whether or not the transfer
+  succeeds; failed frames are counted as dropped.
+
+  @param [in] NicDevice       Pointer to the NIC_DEVICE structure
+
+  @retval EFI_SUCCESS          The queued frames were sent.
+  @retval EFI_DEVICE_ERROR     The transfer failed and the frames were dropped.
+
+**/
+EFI_STATUS
+Ax88179TxFlush (
+  IN NIC_DEVICE *NicDevice
+  )
+{
+  EFI_USB_IO_PROTOCOL *UsbIo;
+  EFI_STATUS          Status;
+  UINTN               TransferLength;
+  UINT32              TransferStatus;
+
+  if (NicDevice->TxPendingCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  UsbIo = NicDevice->UsbIo;
+  TransferLength = NicDevice->TxAggrLen;
+  Status = UsbIo->UsbBulkTransfer (UsbIo,
+                                    BULK_OUT_ENDPOINT,
+                                    NicDevice->TxAggrBuf,
+                                    &TransferLength,
+                                    USB_BUS_TIMEOUT,
+                                    &TransferStatus);
+
+  NicDevice->Statistics.TxTotalFrames += NicDevice->TxPendingCount;
+  if (!EFI_ERROR (Status) && !EFI_ERROR (TransferStatus)) {
+    NicDevice->Statistics.TxGoodFrames += NicDevice->TxPendingCount;
+  } else {
+    NicDevice->Statistics.TxDroppedFrames += NicDevice->TxPendingCount;
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  NicDevice->TxPendingCount = 0;
+  NicDevice->TxAggrLen = 0;
+  return Status;
+}
+
+/**
+  Reset the network statistics.
+
+  Counters which this driver does not collect are set to all ones as
+  required by the UEFI specification.
+
+  @param [in] NicDevice       Pointer to the NIC_DEVICE structure
+
+**/
+VOID
+Ax88179StatisticsReset (
+  IN NIC_DEVICE *NicDevice
+  )
+{
+  EFI_NETWORK_STATISTICS *Stats;
+
+  Stats = &NicDevice->Statistics;
+  SetMem (Stats, sizeof (*Stats), 0xff);
+  Stats->RxTotalFrames = 0;
+  Stats->RxGoodFrames = 0;
+  Stats->RxUndersizeFrames = 0;
+  Stats->RxOversizeFrames = 0;
+  Stats->RxDroppedFrames = 0;
+  Stats->RxUnicastFrames = 0;
+  Stats->RxBroadcastFrames = 0;
+  Stats->RxMulticastFrames = 0;
+  Stats->RxCrcErrorFrames = 0;
+  Stats->RxTotalBytes = 0;
+  Stats->TxTotalFrames = 0;
+  Stats->TxGoodFrames = 0;
+  Stats->TxDroppedFrames = 0;
+}
@@ -72,6 +72,10 @@
 #define AX88179_BULKIN_SIZE_INK     2
 #define AX88179_MAX_BULKIN_SIZE    (1024 * AX88179_BULKIN_SIZE_INK)
 #define AX88179_MAX_PKT_SIZE  2048
+#define AX88179_RX_RING_SIZE  32    ///<  Number of received frames queued for SN_Receive
+#define AX88179_RX_POLL_PERIOD  EFI_TIMER_PERIOD_MILLISECONDS (10)  ///<  Receive ring refill period
+#define AX88179_MAX_BULKOUT_SIZE  (1024 * 16)  ///<  Largest aggregated transmit transfer
+#define AX88179_TX_QUEUE_SIZE     16    ///<  Transmit buffers not yet returned by SN_GetStatus
 
 #define HC_DEBUG        0
 #define ADD_MACPATHNOD  1
@@ -279,14 +283,33 @@ typedef struct {
   UINT8                     *CurPktHdrOff;
   UINT8                     *CurPktOff;
 
-  TX_PACKET                 *TxTest;
+  //
+  //  Receive ring, filled from the timer and drained by SN_Receive
+  //
+  RX_PACKET                 *RxRing;
+  UINTN                     RxHead;             ///<  Index of the oldest queued frame
+  UINTN                     RxCount;            ///<  Number of queued frames
+  BOOLEAN                   RxPolled;           ///<  SN_Receive polled the device since the last timer tick
+
+  EFI_NETWORK_STATISTICS    Statistics;
+
+  //
+  //  Transmit queue.  The first TxCount - TxPendingCount buffers have been
+  //  sent and wait to be recycled by SN_GetStatus, the rest are copied into
+  //  TxAggrBuf and go out with the next bulk-out transfer.
+  //
+  UINT8                     *TxAggrBuf;
+  UINTN                     TxAggrLen;
+  VOID                      *TxQueue[AX88179_TX_QUEUE_SIZE];
+  UINTN                     TxHead;
+  UINTN                     TxCount;
+  UINTN                     TxPendingCount;
 
   INT8                      MulticastHash[8];
   EFI_MAC_ADDRESS           MAC;
 
   UINT16                    CurMediumStatus;
   UINT16                    CurRxControl;
-  VOID *                    TxBuffer;
 
   EFI_DEVICE_PATH_PROTOCOL  *MyDevPath;
   BOOLEAN                   Grub_f;
@@ -1049,5 +1072,32 @@ Ax88179BulkIn(
   IN NIC_DEVICE *NicDevice
 );
 
+EFI_STATUS
+Ax88179RxRingFill (
+  IN NIC_DEVICE *NicDevice
+  );
+
+VOID
+Ax88179RxRingFlush (
+  IN NIC_DEVICE *NicDevice
+  );
+
+VOID
+EFIAPI
+Ax88179RxTimer (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+EFI_STATUS
+Ax88179TxFlush (
+  IN NIC_DEVICE *NicDevice
+  );
+
+VOID
+Ax88179StatisticsReset (
+  IN NIC_DEVICE *NicDevice
+  );
+
 
 #endif  //  AX88179_H_
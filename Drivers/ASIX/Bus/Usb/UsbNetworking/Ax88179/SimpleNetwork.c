@@ -132,13 +132,21 @@ SN_GetStatus (
     // Return the transmit buffer
     //
     NicDevice = DEV_FROM_SIMPLE_NETWORK (SimpleNetwork);
+    Mode = SimpleNetwork->Mode;
 
-    if ((TxBuf != NULL) && (NicDevice->TxBuffer != NULL)) {
-      *TxBuf = NicDevice->TxBuffer;
-      NicDevice->TxBuffer = NULL;
+    if (EfiSimpleNetworkInitialized == Mode->State) {
+      Ax88179TxFlush (NicDevice);
+    }
+
+    if (TxBuf != NULL) {
+      *TxBuf = NULL;
+      if (NicDevice->TxCount > NicDevice->TxPendingCount) {
+        *TxBuf = NicDevice->TxQueue[NicDevice->TxHead];
+        NicDevice->TxHead = (NicDevice->TxHead + 1) % AX88179_TX_QUEUE_SIZE;
+        NicDevice->TxCount--;
+      }
     }
 
-    Mode = SimpleNetwork->Mode;
     if (EfiSimpleNetworkInitialized == Mode->State) {
       if ((TxBuf == NULL) && (InterruptStatus == NULL)) {
         Status = EFI_INVALID_PARAMETER;
@@ -364,6 +372,13 @@ SN_Initialize (
           Mode->MediaPresentSupported = TRUE;
           NicDevice = DEV_FROM_SIMPLE_NETWORK (SimpleNetwork);
           Mode->MediaPresent = Ax88179GetLinkStatus (NicDevice);
+
+          //
+          // Start refilling the receive ring
+          //
+          gBS->SetTimer (NicDevice->Timer,
+                          TimerPeriodic,
+                          AX88179_RX_POLL_PERIOD);
         }
       } else {
         Status = EFI_UNSUPPORTED;
@@ -527,8 +542,7 @@ SN_Receive (
   NIC_DEVICE              *NicDevice;
   EFI_STATUS              Status;
   UINT16                  Type = 0;
-  UINT16                  CurrentPktLen;
-  BOOLEAN                 Valid = TRUE;
+  RX_PACKET               *RxPacket;
   EFI_TPL                 TplPrevious;
 
   TplPrevious = gBS->RaiseTPL (TPL_CALLBACK);
@@ -563,54 +577,46 @@ SN_Receive (
         }
 
         //
-        //  Attempt to do bulk in
+        //  Take the oldest frame from the receive ring, polling the
+        //  device once if the timer has not queued anything yet
         //
-        if (NicDevice->PktCnt == 0) {
-          Status = Ax88179BulkIn(NicDevice);
+        NicDevice->RxPolled = TRUE;
+        Ax88179TxFlush (NicDevice);
+        if (NicDevice->RxCount == 0) {
+          Status = Ax88179RxRingFill (NicDevice);
           if (EFI_ERROR(Status))
             goto  no_pkt;
         }
-        CurrentPktLen = *((UINT16*) (NicDevice->CurPktHdrOff + 2));
-        if (CurrentPktLen & (RXHDR_DROP | RXHDR_CRCERR))
-          Valid = FALSE;
-        CurrentPktLen &=  0x1fff;
-        CurrentPktLen -= 2; /*EEEE*/
-
-        if (Valid && (60 <= CurrentPktLen) &&
-        ((CurrentPktLen - 14) <= MAX_ETHERNET_PKT_SIZE) &&
-            (*((UINT16*)NicDevice->CurPktOff)) == 0xEEEE) {
-          if (*BufferSize < (UINTN)CurrentPktLen) {
-            gBS->RestoreTPL (TplPrevious);
-            return EFI_BUFFER_TOO_SMALL;
-          }
-          *BufferSize = CurrentPktLen;
-          CopyMem (Buffer, NicDevice->CurPktOff + 2, CurrentPktLen);
+        RxPacket = &NicDevice->RxRing[NicDevice->RxHead];
 
-          Header = (ETHERNET_HEADER *) NicDevice->CurPktOff + 2;
+        if (*BufferSize < (UINTN)RxPacket->Length) {
+          *BufferSize = RxPacket->Length;
+          gBS->RestoreTPL (TplPrevious);
+          return EFI_BUFFER_TOO_SMALL;
+        }
+        *BufferSize = RxPacket->Length;
+        CopyMem (Buffer, RxPacket->Data, RxPacket->Length);
 
-          if ((HeaderSize != NULL)  && ((*HeaderSize != 7720))) {
-            *HeaderSize = sizeof (*Header);
-          }
+        Header = (ETHERNET_HEADER *) RxPacket->Data;
 
-          if (DestAddr != NULL) {
-            CopyMem (DestAddr, &Header->DestAddr, PXE_HWADDR_LEN_ETHER);
-          }
-          if (SrcAddr != NULL) {
-            CopyMem (SrcAddr, &Header->SrcAddr, PXE_HWADDR_LEN_ETHER);
-          }
-          if (Protocol != NULL) {
-            Type = Header->Type;
-            Type = (UINT16)((Type >> 8) | (Type << 8));
-            *Protocol = Type;
-          }
-          NicDevice->PktCnt--;
-          NicDevice->CurPktHdrOff += 4;
-          NicDevice->CurPktOff += (CurrentPktLen + 2 + 7) & 0xfff8;
-          Status = EFI_SUCCESS;
-        } else {
-          NicDevice->PktCnt = 0;
-          Status = EFI_NOT_READY;
+        if ((HeaderSize != NULL)  && ((*HeaderSize != 7720))) {
+          *HeaderSize = sizeof (*Header);
+        }
+
+        if (DestAddr != NULL) {
+          CopyMem (DestAddr, &Header->DestAddr, PXE_HWADDR_LEN_ETHER);
         }
+        if (SrcAddr != NULL) {
+          CopyMem (SrcAddr, &Header->SrcAddr, PXE_HWADDR_LEN_ETHER);
+        }
+        if (Protocol != NULL) {
+          Type = Header->Type;
+          Type = (UINT16)((Type >> 8) | (Type << 8));
+          *Protocol = Type;
+        }
+        NicDevice->RxHead = (NicDevice->RxHead + 1) % AX88179_RX_RING_SIZE;
+        NicDevice->RxCount--;
+        Status = EFI_SUCCESS;
       } else {
         Status = EFI_NOT_READY;
       }
@@ -863,6 +869,8 @@ SN_Reset (
       //  Update the device state
       //
       NicDevice = DEV_FROM_SIMPLE_NETWORK (SimpleNetwork);
+      Ax88179TxFlush (NicDevice);
+      Ax88179RxRingFlush (NicDevice);
 
       //
       //  Reset the device
@@ -953,7 +961,7 @@ SN_Setup (
            0xff);
   Mode->IfType = NET_IFTYPE_ETHERNET;
   Mode->MacAddressChangeable = TRUE;
-  Mode->MultipleTxSupported = FALSE;
+  Mode->MultipleTxSupported = TRUE;
   Mode->MediaPresentSupported = TRUE;
   Mode->MediaPresent = FALSE;
   //
@@ -968,6 +976,12 @@ SN_Setup (
   NicDevice->Grub_f = FALSE;
   NicDevice->FirstRst = TRUE;
   NicDevice->PktCnt = 0;
+  NicDevice->RxHead = 0;
+  NicDevice->RxCount = 0;
+  NicDevice->TxAggrLen = 0;
+  NicDevice->TxHead = 0;
+  NicDevice->TxCount = 0;
+  NicDevice->TxPendingCount = 0;
   NicDevice->SkipRXCnt = 0;
   NicDevice->UsbMaxPktSize = 512;
   NicDevice->SetZeroLen = TRUE;
@@ -998,12 +1012,43 @@ SN_Setup (
   }
 
   Status = gBS->AllocatePool (EfiBootServicesData,
-                               sizeof (TX_PACKET),
-                               (VOID **) &NicDevice->TxTest);
+                               AX88179_MAX_BULKOUT_SIZE,
+                               (VOID **) &NicDevice->TxAggrBuf);
+  if (EFI_ERROR (Status)) {
+    gBS->FreePool (NicDevice->BulkInbuf);
+    NicDevice->BulkInbuf = NULL;
+    return Status;
+  }
+
+  Status = gBS->AllocatePool (EfiBootServicesData,
+                               AX88179_RX_RING_SIZE * sizeof (RX_PACKET),
+                               (VOID **) &NicDevice->RxRing);
+  if (EFI_ERROR (Status)) {
+    gBS->FreePool (NicDevice->TxAggrBuf);
+    gBS->FreePool (NicDevice->BulkInbuf);
+    NicDevice->TxAggrBuf = NULL;
+    NicDevice->BulkInbuf = NULL;
+    return Status;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                              TPL_CALLBACK,
+                              Ax88179RxTimer,
+                              NicDevice,
+                              &NicDevice->Timer);
   if (EFI_ERROR (Status)) {
+    gBS->FreePool (NicDevice->RxRing);
+    gBS->FreePool (NicDevice->TxAggrBuf);
     gBS->FreePool (NicDevice->BulkInbuf);
+    NicDevice->RxRing = NULL;
+    NicDevice->TxAggrBuf = NULL;
+    NicDevice->BulkInbuf = NULL;
+    NicDevice->Timer = NULL;
+    return Status;
   }
 
+  Ax88179StatisticsReset (NicDevice);
+
   //
   //  Return the setup status
   //
@@ -1071,7 +1116,7 @@ SN_Start (
       SetMem(&Mode->BroadcastAddress, PXE_HWADDR_LEN_ETHER, 0xff);
       Mode->IfType = NET_IFTYPE_ETHERNET;
       Mode->MacAddressChangeable = TRUE;
-      Mode->MultipleTxSupported = FALSE;
+      Mode->MultipleTxSupported = TRUE;
       Mode->MediaPresentSupported = TRUE;
       Mode->MediaPresent = FALSE;
 
@@ -1217,30 +1262,49 @@ SN_Statistics (
   EFI_STATUS              Status;
   EFI_TPL                 TplPrevious;
   EFI_SIMPLE_NETWORK_MODE *Mode;
+  NIC_DEVICE              *NicDevice;
+
+  if ((SimpleNetwork == NULL) || (SimpleNetwork->Mode == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
   TplPrevious = gBS->RaiseTPL(TPL_CALLBACK);
   Mode = SimpleNetwork->Mode;
 
   if (EfiSimpleNetworkInitialized == Mode->State) {
-    if ((StatisticsSize != NULL) && (*StatisticsSize == 0)) {
-      Status = EFI_BUFFER_TOO_SMALL;
+    NicDevice = DEV_FROM_SIMPLE_NETWORK (SimpleNetwork);
+
+    //
+    // A NULL table is only allowed when just resetting the statistics
+    //
+    if (StatisticsSize == NULL) {
+      Status = Reset ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+    } else if ((*StatisticsSize != 0) && (StatisticsTable == NULL)) {
+      Status = EFI_INVALID_PARAMETER;
       goto EXIT;
+    } else {
+      CopyMem (StatisticsTable,
+                &NicDevice->Statistics,
+                MIN (*StatisticsSize, sizeof (NicDevice->Statistics)));
+      if (*StatisticsSize < sizeof (NicDevice->Statistics)) {
+        Status = EFI_BUFFER_TOO_SMALL;
+      } else {
+        Status = EFI_SUCCESS;
+      }
+      *StatisticsSize = sizeof (NicDevice->Statistics);
     }
 
-    if(Reset) {
-      Status = EFI_SUCCESS;
-    } else {
-      Status = EFI_SUCCESS;
+    if (Reset && (Status != EFI_INVALID_PARAMETER)) {
+      Ax88179StatisticsReset (NicDevice);
     }
   } else {
     if (EfiSimpleNetworkStarted == Mode->State) {
-      Status = EFI_DEVICE_ERROR; ;
+      Status = EFI_DEVICE_ERROR;
     } else {
-      Status = EFI_NOT_STARTED ;
+      Status = EFI_NOT_STARTED;
     }
   }
 
-  Status = EFI_UNSUPPORTED;
 EXIT:
   gBS->RestoreTPL(TplPrevious);
   return Status;
@@ -1339,6 +1403,9 @@ SN_Shutdown (
       // Stop the adapter
       //
       NicDevice = DEV_FROM_SIMPLE_NETWORK (SimpleNetwork);
+      gBS->SetTimer (NicDevice->Timer, TimerCancel, 0);
+      Ax88179TxFlush (NicDevice);
+      Ax88179RxRingFlush (NicDevice);
 
       Status = Ax88179MacAddressGet (NicDevice, &Mode->PermanentAddress.Addr[0]);
       if (!EFI_ERROR (Status)) {
@@ -1423,10 +1490,10 @@ SN_Transmit (
   ETHERNET_HEADER         *Header;
   EFI_SIMPLE_NETWORK_MODE *Mode;
   NIC_DEVICE              *NicDevice;
-  EFI_USB_IO_PROTOCOL     *UsbIo;
+  TX_PACKET               *TxPacket;
   EFI_STATUS              Status;
+  UINTN                   FrameLength;
   UINTN                   TransferLength;
-  UINT32                  TransferStatus;
   UINT16                  Type = 0;
   EFI_TPL                 TplPrevious;
 
@@ -1466,17 +1533,40 @@ SN_Transmit (
           Status = EFI_INVALID_PARAMETER;
           goto EXIT;
         }
+        if (BufferSize > (Mode->MediaHeaderSize + Mode->MaxPacketSize)) {
+          Status = EFI_INVALID_PARAMETER;
+          goto EXIT;
+        }
+
         //
-        //  Copy the packet into the USB buffer
+        //  Every queued buffer must be recycled through SN_GetStatus
+        //  before its slot can be reused
         //
-        // Buffer starting with 14 bytes 0
-        CopyMem (&NicDevice->TxTest->Data[0], Buffer, BufferSize);
-        NicDevice->TxTest->TxHdr1 = (UINT32) BufferSize;
-        NicDevice->TxTest->TxHdr2 = 0;
+        if (NicDevice->TxCount == AX88179_TX_QUEUE_SIZE) {
+          Status = EFI_NOT_READY;
+          goto EXIT;
+        }
+
+        FrameLength = MAX (BufferSize, MIN_ETHERNET_PKT_SIZE);
+        TransferLength = ALIGN_VALUE (sizeof (TxPacket->TxHdr1)
+                                    + sizeof (TxPacket->TxHdr2)
+                                    + FrameLength, 4);
+        if ((NicDevice->TxAggrLen + TransferLength) > AX88179_MAX_BULKOUT_SIZE) {
+          Ax88179TxFlush (NicDevice);
+        }
+
         //
-        //  Transmit the packet
+        //  Append the packet to the aggregation buffer, each packet
+        //  starting on a 4 byte boundary with its own TX header
         //
-        Header = (ETHERNET_HEADER *) &NicDevice->TxTest->Data[0];
+        TxPacket = (TX_PACKET *) &NicDevice->TxAggrBuf[NicDevice->TxAggrLen];
+        CopyMem (&TxPacket->Data[0], Buffer, BufferSize);
+        ZeroMem (&TxPacket->Data[BufferSize],
+                  TransferLength - sizeof (TxPacket->TxHdr1) - sizeof (TxPacket->TxHdr2) - BufferSize);
+        TxPacket->TxHdr1 = (UINT32) FrameLength;
+        TxPacket->TxHdr2 = 0;
+
+        Header = (ETHERNET_HEADER *) &TxPacket->Data[0];
         if (HeaderSize != 0) {
           if (DestAddr != NULL) {
             CopyMem (&Header->DestAddr, DestAddr, PXE_HWADDR_LEN_ETHER);
@@ -1495,36 +1585,15 @@ SN_Transmit (
           Header->Type = Type;
         }
 
-        if (NicDevice->TxTest->TxHdr1 < MIN_ETHERNET_PKT_SIZE) {
-          NicDevice->TxTest->TxHdr1 = MIN_ETHERNET_PKT_SIZE;
-          ZeroMem (&NicDevice->TxTest->Data[BufferSize],
-                    MIN_ETHERNET_PKT_SIZE - BufferSize);
-        }
-
-        TransferLength = sizeof (NicDevice->TxTest->TxHdr1)
-                       + sizeof (NicDevice->TxTest->TxHdr2)
-                       + NicDevice->TxTest->TxHdr1;
         //
-        //  Work around USB bus driver bug where a timeout set by receive
-        //  succeeds but the timeout expires immediately after, causing the
-        //  transmit operation to timeout.
+        //  The packet goes out with the next flush from SN_GetStatus,
+        //  SN_Receive, the timer or a full aggregation buffer
         //
-        UsbIo = NicDevice->UsbIo;
-        Status = UsbIo->UsbBulkTransfer (UsbIo,
-                                           BULK_OUT_ENDPOINT,
-                                           &NicDevice->TxTest->TxHdr1,
-                                           &TransferLength,
-                                           0xfffffffe,
-                                           &TransferStatus);
-
-        if (!EFI_ERROR(Status) && !EFI_ERROR(Status)) {
-          NicDevice->TxBuffer = Buffer;
-          Status = EFI_SUCCESS;
-        } else if (EFI_TIMEOUT == Status && EFI_USB_ERR_TIMEOUT == TransferStatus) {
-          Status = EFI_NOT_READY;
-        } else {
-          Status = EFI_DEVICE_ERROR;
-        }
+        NicDevice->TxAggrLen += TransferLength;
+        NicDevice->TxQueue[(NicDevice->TxHead + NicDevice->TxCount) % AX88179_TX_QUEUE_SIZE] = Buffer;
+        NicDevice->TxCount++;
+        NicDevice->TxPendingCount++;
+        Status = EFI_SUCCESS;
       } else {
         //
         // No packets available.
@@ -69,6 +69,28 @@ CheckBounds (
   return EFI_SUCCESS;
 }
 
+/**
+ * Mark a band of lines of the local copy of the Frame Buffer as "dirty", so that they get
+ * converted and transmitted in the next screen update.
+ * @param UsbDisplayLinkDev
+ * @param Y               First line that was written to
+ * @param Height          Number of lines that were written to
+ */
+STATIC VOID
+MarkDirtyLines (
+    IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev,
+    IN UINTN Y,
+    IN UINTN Height
+    )
+{
+  if (Y < UsbDisplayLinkDev->LastY1) {
+    UsbDisplayLinkDev->LastY1 = Y;
+  }
+  if ((Y + Height) > UsbDisplayLinkDev->LastY2) {
+    UsbDisplayLinkDev->LastY2 = Y + Height;
+  }
+}
+
 /**
  * Update the local copy of the Frame Buffer. This local copy is periodically transmitted to the
  * DisplayLink device (via DlGopSendScreenUpdate)
@@ -122,12 +144,7 @@ BuildBackBuffer (
   case EfiBltBufferToVideo:
   {
     // Update the store of the area of the screen that is "dirty" - that we need to send in the next screen update.
-    if (DestinationY < UsbDisplayLinkDev->LastY1) {
-      UsbDisplayLinkDev->LastY1 = DestinationY;
-    }
-    if ((DestinationY + Height) > UsbDisplayLinkDev->LastY2) {
-      UsbDisplayLinkDev->LastY2 = DestinationY + Height;
-    }
+    MarkDirtyLines (UsbDisplayLinkDev, DestinationY, Height);
 
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* Blt;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
@@ -146,6 +163,8 @@ BuildBackBuffer (
 
   case EfiBltVideoToVideo:
   {
+    MarkDirtyLines (UsbDisplayLinkDev, DestinationY, Height);
+
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* SrcB;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
     SrcB = UsbDisplayLinkDev->Screen + SourceY * PixelsPerScanLine + SourceX;
@@ -163,6 +182,8 @@ BuildBackBuffer (
 
   case EfiBltVideoFill:
   {
+    MarkDirtyLines (UsbDisplayLinkDev, DestinationY, Height);
+
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
     DstB = UsbDisplayLinkDev->Screen + DestinationY * PixelsPerScanLine + DestinationX;
     for (H = 0; H < Height; H++) {
@@ -247,59 +268,59 @@ DlGopSendTestPattern (
   DlUsbBulkWrite (UsbDisplayLinkDev, DstBuf, 1, &USBStatus);
   FreePool (DstBuf);
 
+  // The pattern has overwritten the whole screen on the device, so the next update needs to resend all of it
+  MarkDirtyLines (UsbDisplayLinkDev, 0, UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution);
+
   return Status;
 }
 
 
 /**
- * Transfer the latest copy of the Blt buffer over USB to the DisplayLink device
+ * Start a new frame if any of the screen has been BLTted to since the last one.
+ * Only the lines that have been BLTted to get converted to the device's pixel format,
+ * and the frame stops after the last of them.
  * @param UsbDisplayLinkDev
- * @return
+ * @return TRUE if a frame was started, FALSE if there's nothing to send
  */
-EFI_STATUS
-DlGopSendScreenUpdate (
+STATIC BOOLEAN
+DlGopStartFrame (
     IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev
     )
 {
-  EFI_STATUS Status;
-  UINT32 USBStatus;
-  Status = EFI_SUCCESS;
-
   // If it has been a while since we sent an update, send a full screen.
   // This allows us to update a hot-plugged monitor quickly.
   if (UsbDisplayLinkDev->TimeSinceLastScreenUpdate > DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD) {
     UsbDisplayLinkDev->LastY1 = 0;
-    UsbDisplayLinkDev->LastY2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution - 1;
+    UsbDisplayLinkDev->LastY2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution;
   }
 
   // If there has been no BLT since the last update/poll, drop out quietly.
   if (UsbDisplayLinkDev->LastY2 < UsbDisplayLinkDev->LastY1) {
     UsbDisplayLinkDev->TimeSinceLastScreenUpdate += (DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD / 1000);  // Convert us to ms
-    return EFI_SUCCESS;
+    return FALSE;
   }
 
   UsbDisplayLinkDev->TimeSinceLastScreenUpdate = 0;
 
+  // Lock out Blt() while we take a snapshot of the back buffer. The frame gets sent from the snapshot, so
+  // anything BLTted to while it's being sent gets picked up by the next frame.
   EFI_TPL OriginalTPL = gBS->RaiseTPL (TPL_NOTIFY);
 
-  UINTN DataLen;
   UINTN Width;
-  UINTN Height;
+  UINTN H;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL* SrcPtr;
   UINT8* DstPtr;
-  UINT8 DstBuffer[1920 * 3]; // Get rid of the magic numbers at some point
-                             // Could also use a buffer allocated at runtime to store the line, stored in the USB_DISPLAYLINK_DEV structure.
-  UINTN H;
 
-  DataLen = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution * 3; // Send 1 line @ 24 bits per pixel
   Width = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution;
-  Height = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution;
-  SrcPtr = UsbDisplayLinkDev->Screen;
-  DstPtr = DstBuffer;
+  UsbDisplayLinkDev->FrameFirstDirtyLine = UsbDisplayLinkDev->LastY1;
+  UsbDisplayLinkDev->FrameLastLine = MIN (UsbDisplayLinkDev->LastY2, UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution);
+  UsbDisplayLinkDev->FrameLine = 0;
 
-  for (H = 0; H < Height; H++) {
-    DstPtr = DstBuffer;
+  // Lines outside the dirty band haven't changed since they were last converted.
+  SrcPtr = UsbDisplayLinkDev->Screen + UsbDisplayLinkDev->FrameFirstDirtyLine * Width;
+  DstPtr = UsbDisplayLinkDev->ScreenRgb + UsbDisplayLinkDev->FrameFirstDirtyLine * Width * 3;
 
+  for (H = UsbDisplayLinkDev->FrameFirstDirtyLine; H < UsbDisplayLinkDev->FrameLastLine; H++) {
     UINTN W;
     for (W = 0; W < Width; W++) {
       // Need to swap round the RGB values
@@ -309,37 +330,89 @@ DlGopSendScreenUpdate (
       SrcPtr++;
       DstPtr += 3;
     }
+  }
+
+  UsbDisplayLinkDev->LastY2 = 0;
+  UsbDisplayLinkDev->LastY1 = (UINTN)-1;
+  UsbDisplayLinkDev->FrameInProgress = TRUE;
+
+  gBS->RestoreTPL (OriginalTPL);
+
+  return TRUE;
+}
+
+/**
+ * Transfer the latest copy of the Blt buffer over USB to the DisplayLink device.
+ * Each call sends the next chunk of lines of the frame in progress (starting a new frame if
+ * needed), so the caller needs to call again soon while UsbDisplayLinkDev->FrameInProgress is set.
+ * @param UsbDisplayLinkDev
+ * @return
+ */
+EFI_STATUS
+DlGopSendScreenUpdate (
+    IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev
+    )
+{
+  EFI_STATUS Status;
+  UINT32 USBStatus;
+  Status = EFI_SUCCESS;
+
+  if (!UsbDisplayLinkDev->FrameInProgress && !DlGopStartFrame (UsbDisplayLinkDev)) {
+    return EFI_SUCCESS;
+  }
+
+  UINTN DataLen;
+  UINTN ChunkLastLine;
+  UINT8* DstPtr;
+
+  DataLen = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution * 3; // Send 1 line @ 24 bits per pixel
+  ChunkLastLine = MIN (UsbDisplayLinkDev->FrameLine + DISPLAYLINK_LINES_PER_FRAME_CHUNK, UsbDisplayLinkDev->FrameLastLine);
+
+  // The device writes the lines it receives into its frame buffer in order, starting from the top,
+  // and the payload that terminates the frame takes it back to the top. As lines can't be addressed
+  // directly, the ones above the dirty band still need to be sent, but the ones below it don't.
+  // Each line needs to be a transfer of its own, so they can't be merged into bigger transfers.
+  DstPtr = UsbDisplayLinkDev->ScreenRgb + UsbDisplayLinkDev->FrameLine * DataLen;
 
-    Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, DataLen, &USBStatus);
+  while (UsbDisplayLinkDev->FrameLine < ChunkLastLine) {
+    Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstPtr, DataLen, &USBStatus);
 
     // USBStatus values defined in usbio.h, e.g. EFI_USB_ERR_TIMEOUT 0x40
     if (EFI_ERROR (Status)) {
-      DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
+      DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", UsbDisplayLinkDev->FrameLine, DataLen, Status, USBStatus));
       break;
     }
     // Need an extra DlUsbBulkWrite if the data length is divisible by USB MaxPacketSize. This spare data will just get written into the (invisible) stride area.
     // Note that the API doesn't let us do a bulk write of 0.
     if ((DataLen & (UsbDisplayLinkDev->BulkOutEndpointDescriptor.MaxPacketSize - 1)) == 0) {
-      Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 2, &USBStatus);
+      Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstPtr, 2, &USBStatus);
       if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
+        DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", UsbDisplayLinkDev->FrameLine, DataLen, Status, USBStatus));
         break;
       }
     }
+    UsbDisplayLinkDev->DataSent += DataLen;
+    UsbDisplayLinkDev->FrameLine++;
+    DstPtr += DataLen;
   }
 
-  if (!EFI_ERROR (Status)) {
-    // If we've successfully transmitted the frame, reset the values that store which area of the screen has been BLTted to.
-    // If we haven't succeeded, this will mean we'll try to resend it after the next poll period.
-    UsbDisplayLinkDev->LastY2 = 0;
-    UsbDisplayLinkDev->LastY1 = (UINTN)-1;
+  if (EFI_ERROR (Status)) {
+    // If we haven't succeeded, mark the frame's lines as dirty again so we'll try to resend them after the next poll period.
+    EFI_TPL OriginalTPL = gBS->RaiseTPL (TPL_NOTIFY);
+    MarkDirtyLines (
+      UsbDisplayLinkDev,
+      UsbDisplayLinkDev->FrameFirstDirtyLine,
+      UsbDisplayLinkDev->FrameLastLine - MIN (UsbDisplayLinkDev->FrameFirstDirtyLine, UsbDisplayLinkDev->FrameLastLine));
+    gBS->RestoreTPL (OriginalTPL);
+  } else if (UsbDisplayLinkDev->FrameLine < UsbDisplayLinkDev->FrameLastLine) {
+    // More chunks to go
+    return EFI_SUCCESS;
   }
 
   // Payload with length of 1 to terminate the frame
   // We need to do this even if we had an error, to indicate to the DL device that it should now expect a new frame.
-  DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 1, &USBStatus);
-
-  gBS->RestoreTPL (OriginalTPL);
+  DlUsbBulkWrite (UsbDisplayLinkDev, UsbDisplayLinkDev->ScreenRgb, 1, &USBStatus);
+  UsbDisplayLinkDev->FrameInProgress = FALSE;
 
   return Status;
 }
@@ -454,6 +527,9 @@ DisplayLinkSetMode (
   // When the GOP driver is sideloaded, the TPL of this call is TPL_APPLICATION (4) and the timer can interrupt us.
   Gop->Mode->Mode = GRAPHICS_OUTPUT_INVALID_MODE_NUMBER;
 
+  // Any frame that was being sent is for the old mode (and the old back buffer); drop it.
+  UsbDisplayLinkDev->FrameInProgress = FALSE;
+
   // Get a video mode from the EDID
   Status = DlEdidGetSupportedVideoModeWithFallback (ModeNumber, UsbDisplayLinkDev->EdidActive.Edid, UsbDisplayLinkDev->EdidActive.SizeOfEdid, &VideoMode);
 
@@ -477,12 +553,29 @@ DisplayLinkSetMode (
     FreePool (UsbDisplayLinkDev->Screen);
   }
 
+  if (UsbDisplayLinkDev->ScreenRgb != NULL) {
+    FreePool (UsbDisplayLinkDev->ScreenRgb);
+  }
+
   UsbDisplayLinkDev->Screen = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL*)AllocateZeroPool (
     Gop->Mode->Info->HorizontalResolution *
     Gop->Mode->Info->VerticalResolution *
     sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
 
-  if (UsbDisplayLinkDev->Screen == NULL) {
+  // 24 bits per pixel, as sent to the device
+  UsbDisplayLinkDev->ScreenRgb = (UINT8*)AllocateZeroPool (
+    Gop->Mode->Info->HorizontalResolution *
+    Gop->Mode->Info->VerticalResolution * 3);
+
+  if (UsbDisplayLinkDev->Screen == NULL || UsbDisplayLinkDev->ScreenRgb == NULL) {
+    if (UsbDisplayLinkDev->Screen != NULL) {
+      FreePool (UsbDisplayLinkDev->Screen);
+      UsbDisplayLinkDev->Screen = NULL;
+    }
+    if (UsbDisplayLinkDev->ScreenRgb != NULL) {
+      FreePool (UsbDisplayLinkDev->ScreenRgb);
+      UsbDisplayLinkDev->ScreenRgb = NULL;
+    }
     return EFI_OUT_OF_RESOURCES;
   }
 
@@ -496,7 +589,12 @@ DisplayLinkSetMode (
     Gop->Mode->Mode = GRAPHICS_OUTPUT_INVALID_MODE_NUMBER;
     FreePool (UsbDisplayLinkDev->Screen);
     UsbDisplayLinkDev->Screen = NULL;
+    FreePool (UsbDisplayLinkDev->ScreenRgb);
+    UsbDisplayLinkDev->ScreenRgb = NULL;
   } else {
+    // Start from a clean slate; the whole of the new mode gets marked as dirty below.
+    UsbDisplayLinkDev->LastY2 = 0;
+    UsbDisplayLinkDev->LastY1 = (UINTN)-1;
     BuildBackBuffer (
       UsbDisplayLinkDev,
       UsbDisplayLinkDev->Screen,
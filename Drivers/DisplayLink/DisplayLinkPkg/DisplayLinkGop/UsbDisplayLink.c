@@ -528,7 +528,8 @@ DisplayLinkPeriodicTimer (
   DisplayLinkCopyFromPrimaryGopDevice (UsbDisplayLinkDev);
 #endif // COPY_PIXELS_FROM_PRIMARY_GOP_DEVICE
 
-  if (UsbDisplayLinkDev->ShowBandwidth) {
+  // The bandwidth is averaged over 50 screen update periods; the events for the chunks of a frame don't count.
+  if (UsbDisplayLinkDev->ShowBandwidth && !UsbDisplayLinkDev->FrameInProgress) {
     STATIC UINTN Count = 0;
 
     if (Count++ % 50 == 0) {
@@ -537,7 +538,8 @@ DisplayLinkPeriodicTimer (
     }
   }
 
-  if (UsbDisplayLinkDev->ShowTestPattern)
+  // Test patterns are whole frames of their own, so they can't be sent in the middle of another frame.
+  if (UsbDisplayLinkDev->ShowTestPattern && !UsbDisplayLinkDev->FrameInProgress)
   {
     if (UsbDisplayLinkDev->ShowTestPattern == 5) {
       DlGopSendTestPattern (UsbDisplayLinkDev, 0);
@@ -549,11 +551,15 @@ DisplayLinkPeriodicTimer (
 
   }
 
-  // Send the latest version of the frame buffer to the DL device over USB
+  // Send (the next chunk of) the latest version of the frame buffer to the DL device over USB
   DlGopSendScreenUpdate (UsbDisplayLinkDev);
 
-  // Restart the timer now we've finished
-  Status = gBS->SetTimer (UsbDisplayLinkDev->TimerEvent, TimerRelative, DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD);
+  // Restart the timer now we've finished. If we're in the middle of a frame, come back
+  // for the next chunk shortly; other events get to run in between.
+  Status = gBS->SetTimer (
+    UsbDisplayLinkDev->TimerEvent,
+    TimerRelative,
+    UsbDisplayLinkDev->FrameInProgress ? DISPLAYLINK_FRAME_CHUNK_TIMER_PERIOD : DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Failed to create timer.\n"));
   }
@@ -1065,6 +1071,11 @@ UsbDisplayLinkDriverBindingStop (
     UsbDisplayLinkDev->Screen = NULL;
   }
 
+  if (UsbDisplayLinkDev->ScreenRgb != NULL) {
+    FreePool (UsbDisplayLinkDev->ScreenRgb);
+    UsbDisplayLinkDev->ScreenRgb = NULL;
+  }
+
   if (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode) {
     if (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info) {
       FreePool (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info);
@@ -42,6 +42,10 @@
 #define DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD  ((UINTN)1000000) // 0.1s in us
 #define DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD   ((UINTN)30000) // 3s in ticks
 
+// Frames are sent a chunk of lines at a time, so that the timer handler never hogs the CPU for a whole frame.
+#define DISPLAYLINK_LINES_PER_FRAME_CHUNK       ((UINTN)64)
+#define DISPLAYLINK_FRAME_CHUNK_TIMER_PERIOD    ((UINTN)10000) // 1ms, the delay between the chunks of a frame
+
 #define DISPLAYLINK_FIXED_VERTICAL_REFRESH_RATE ((UINT16)60)
 
 // Requests to read values from the firmware
@@ -80,15 +84,20 @@ typedef struct {
   EFI_EDID_ACTIVE_PROTOCOL      EdidActive;
   EFI_UNICODE_STRING_TABLE      *ControllerNameTable;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Screen;
+  UINT8                         *ScreenRgb;                    /** Copy of Screen in the 24bpp RGB format sent to the device */
   UINTN                         DataSent;                       /** Debug - used to track the bandwidth */
   EFI_EVENT                     TimerEvent;
   EFI_EVENT                     DriverExitBootServicesEvent;
   BOOLEAN                       ShowBandwidth;                 /** Debugging - show the bandwidth on the screen */
   BOOLEAN                       ShowTestPattern;               /** Show a colourbar pattern instead of the BLTd contents of the framebuffer */
-  UINTN                         LastY1;                        /** Used to track if we can do a partial screen update */
+  UINTN                         LastY1;                        /** Band of lines [LastY1, LastY2) BLTted to since the last screen update */
   UINTN                         LastY2;
   UINTN                         LastWidth;
   UINTN                         TimeSinceLastScreenUpdate;     /** Do a full screen update every (x) seconds */
+  BOOLEAN                       FrameInProgress;               /** A frame is being sent, a chunk of lines per timer event */
+  UINTN                         FrameLine;                     /** Next line of the frame to send */
+  UINTN                         FrameLastLine;                 /** The frame stops before this line */
+  UINTN                         FrameFirstDirtyLine;           /** First line of the frame that had been BLTted to */
 } USB_DISPLAYLINK_DEV;
 
 #define USB_DISPLAYLINK_DEV_SIGNATURE SIGNATURE_32 ('d', 'l', 'i', 'n')
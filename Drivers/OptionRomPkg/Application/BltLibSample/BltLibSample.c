@@ -1,18 +1,26 @@
 /** @file
   Example program using BltLib
 
+  Run with -b to measure the throughput of each BltLib operation instead of
+  drawing the test patterns.
+
   Copyright (c) 2006 - 2018, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
 
 #include <Uefi.h>
+#include <Protocol/ShellParameters.h>
+#include <Library/BaseLib.h>
 #include <Library/BltLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiApplicationEntryPoint.h>
 #include <Library/UefiBootServicesTableLib.h>
 
+#define BENCHMARK_ITERATIONS  32
+
 
 UINT64
 ReadTimestamp (
@@ -233,6 +241,174 @@ TestColor (
 }
 
 
+/**
+  Measures how many timestamp ticks elapse per microsecond.
+
+  @return  Timestamp ticks per microsecond
+
+**/
+UINT64
+TimestampTicksPerMicrosecond (
+  VOID
+  )
+{
+  UINT64  Start;
+  UINT64  End;
+
+  Start = ReadTimestamp ();
+  gBS->Stall (10000);
+  End = ReadTimestamp ();
+
+  return DivU64x32 (End - Start, 10000);
+}
+
+
+/**
+  Prints the throughput of one benchmarked operation.
+
+  @param[in]  Operation            Name of the operation
+  @param[in]  Pixels               Number of pixels processed
+  @param[in]  Ticks                Timestamp ticks the operation took
+  @param[in]  TicksPerMicrosecond  Timestamp ticks per microsecond
+
+**/
+VOID
+PrintRate (
+  IN CHAR16  *Operation,
+  IN UINTN   Pixels,
+  IN UINT64  Ticks,
+  IN UINT64  TicksPerMicrosecond
+  )
+{
+  UINT64  Rate;
+
+  if ((Ticks == 0) || (TicksPerMicrosecond == 0)) {
+    Print (L"%-18s: too fast to measure\n", Operation);
+    return;
+  }
+
+  //
+  // Pixels per microsecond are MPixels per second, keep one decimal
+  //
+  Rate = DivU64x64Remainder (
+           MultU64x64 (MultU64x32 (Pixels, 10), TicksPerMicrosecond),
+           Ticks,
+           NULL
+           );
+  Print (
+    L"%-18s: %5ld.%ld MPixels/s\n",
+    Operation,
+    DivU64x32 (Rate, 10),
+    ModU64x32 (Rate, 10)
+    );
+}
+
+
+/**
+  Times each BltLib operation over the whole screen and prints its throughput.
+
+**/
+VOID
+Benchmark (
+  VOID
+  )
+{
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Buffer;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  Color;
+  UINTN                          Width;
+  UINTN                          Height;
+  UINTN                          Loop;
+  UINT64                         TicksPerMicrosecond;
+  UINT64                         Start;
+
+  BltLibGetSizes (&Width, &Height);
+  Buffer = AllocatePool (Width * Height * sizeof (*Buffer));
+  if (Buffer == NULL) {
+    Print (L"Not enough memory for a %dx%d buffer\n", Width, Height);
+    return;
+  }
+  for (Loop = 0; Loop < Width * Height; Loop++) {
+    *(UINT32*) &Buffer[Loop] = (UINT32) (Loop * 0x9e3779b9);
+  }
+
+  TicksPerMicrosecond = TimestampTicksPerMicrosecond ();
+  Print (L"%dx%d, %d iterations per operation\n", Width, Height, BENCHMARK_ITERATIONS);
+
+  *(UINT32*) &Color = 0x00336699;
+  Start = ReadTimestamp ();
+  for (Loop = 0; Loop < BENCHMARK_ITERATIONS; Loop++) {
+    BltLibVideoFill (&Color, 0, 0, Width, Height);
+  }
+  PrintRate (L"VideoFill", Width * Height * BENCHMARK_ITERATIONS, ReadTimestamp () - Start, TicksPerMicrosecond);
+
+  //
+  // Not starting at column 0 takes the row by row fill path
+  //
+  Start = ReadTimestamp ();
+  for (Loop = 0; Loop < BENCHMARK_ITERATIONS; Loop++) {
+    BltLibVideoFill (&Color, 1, 0, Width - 1, Height);
+  }
+  PrintRate (L"VideoFill (rows)", (Width - 1) * Height * BENCHMARK_ITERATIONS, ReadTimestamp () - Start, TicksPerMicrosecond);
+
+  Start = ReadTimestamp ();
+  for (Loop = 0; Loop < BENCHMARK_ITERATIONS; Loop++) {
+    BltLibBufferToVideo (Buffer, 0, 0, Width, Height);
+  }
+  PrintRate (L"BufferToVideo", Width * Height * BENCHMARK_ITERATIONS, ReadTimestamp () - Start, TicksPerMicrosecond);
+
+  Start = ReadTimestamp ();
+  for (Loop = 0; Loop < BENCHMARK_ITERATIONS; Loop++) {
+    BltLibVideoToBltBuffer (Buffer, 0, 0, Width, Height);
+  }
+  PrintRate (L"VideoToBltBuffer", Width * Height * BENCHMARK_ITERATIONS, ReadTimestamp () - Start, TicksPerMicrosecond);
+
+  Start = ReadTimestamp ();
+  for (Loop = 0; Loop < BENCHMARK_ITERATIONS; Loop++) {
+    BltLibVideoToVideo (0, 0, 0, Height / 2, Width, Height / 2);
+  }
+  PrintRate (L"VideoToVideo", Width * (Height / 2) * BENCHMARK_ITERATIONS, ReadTimestamp () - Start, TicksPerMicrosecond);
+
+  FreePool (Buffer);
+}
+
+
+/**
+  Checks whether the application was started with the -b option.
+
+  @param[in] ImageHandle    The image handle of the application.
+
+  @retval TRUE              The benchmark was requested.
+  @retval FALSE             The benchmark was not requested.
+
+**/
+BOOLEAN
+BenchmarkRequested (
+  IN EFI_HANDLE        ImageHandle
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL  *ShellParameters;
+  UINTN                          Index;
+
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters
+                  );
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  for (Index = 1; Index < ShellParameters->Argc; Index++) {
+    if (StrCmp (ShellParameters->Argv[Index], L"-b") == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
 /**
   The user Entry Point for Application. The user code starts with this function
   as the real entry point for the application.
@@ -271,6 +447,11 @@ UefiMain (
     return Status;
   }
 
+  if (BenchmarkRequested (ImageHandle)) {
+    Benchmark ();
+    return EFI_SUCCESS;
+  }
+
   TestFills ();
 
   TestColor ();
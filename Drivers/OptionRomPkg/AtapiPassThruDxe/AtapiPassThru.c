@@ -239,6 +239,7 @@ Returns:
                     );
   if (!EFI_ERROR (Status)) {
     Supports &= (EFI_PCI_DEVICE_ENABLE               |
+                 EFI_PCI_IO_ATTRIBUTE_BUS_MASTER     |
                  EFI_PCI_IO_ATTRIBUTE_IDE_PRIMARY_IO |
                  EFI_PCI_IO_ATTRIBUTE_IDE_SECONDARY_IO);
     Status = PciIo->Attributes (
@@ -386,6 +387,18 @@ Returns:
          Controller
          );
 
+  if (AtapiScsiPrivate->PrdTable != NULL) {
+    AtapiScsiPrivate->PciIo->Unmap (
+                               AtapiScsiPrivate->PciIo,
+                               AtapiScsiPrivate->PrdTableMapping
+                               );
+    AtapiScsiPrivate->PciIo->FreeBuffer (
+                               AtapiScsiPrivate->PciIo,
+                               1,
+                               AtapiScsiPrivate->PrdTable
+                               );
+  }
+
   gBS->FreePool (AtapiScsiPrivate);
 
   return EFI_SUCCESS;
@@ -416,6 +429,8 @@ Returns:
   EFI_STATUS                Status;
   ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate;
   IDE_REGISTERS_BASE_ADDR   IdeRegsBaseAddr[ATAPI_MAX_CHANNEL];
+  VOID                      *PrdTable;
+  UINTN                     PrdTableSize;
 
   AtapiScsiPrivate = AllocateZeroPool (sizeof (ATAPI_SCSI_PASS_THRU_DEV));
   if (AtapiScsiPrivate == NULL) {
@@ -442,6 +457,44 @@ Returns:
 
   InitAtapiIoPortRegisters(AtapiScsiPrivate, IdeRegsBaseAddr);
 
+  //
+  // Allocate the PRD table used by the Bus Master IDE engine. It is only
+  // needed when at least one channel is bus master capable; if it cannot be
+  // set up, all transfers simply go through PIO.
+  //
+  if (IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr != 0 ||
+      IdeRegsBaseAddr[IdeSecondary].BusMasterBaseAddr != 0) {
+    Status = PciIo->AllocateBuffer (
+                      PciIo,
+                      AllocateAnyPages,
+                      EfiBootServicesData,
+                      1,
+                      &PrdTable,
+                      0
+                      );
+    if (!EFI_ERROR (Status)) {
+      PrdTableSize = EFI_PAGE_SIZE;
+      Status = PciIo->Map (
+                        PciIo,
+                        EfiPciIoOperationBusMasterCommonBuffer,
+                        PrdTable,
+                        &PrdTableSize,
+                        &AtapiScsiPrivate->PrdTableDeviceAddr,
+                        &AtapiScsiPrivate->PrdTableMapping
+                        );
+      if (EFI_ERROR (Status) ||
+          PrdTableSize != EFI_PAGE_SIZE ||
+          AtapiScsiPrivate->PrdTableDeviceAddr + EFI_PAGE_SIZE > BASE_4GB) {
+        if (!EFI_ERROR (Status)) {
+          PciIo->Unmap (PciIo, AtapiScsiPrivate->PrdTableMapping);
+        }
+        PciIo->FreeBuffer (PciIo, 1, PrdTable);
+      } else {
+        AtapiScsiPrivate->PrdTable = PrdTable;
+      }
+    }
+  }
+
   //
   // Initialize the LatestTargetId to MAX_TARGET_ID.
   //
@@ -932,9 +985,12 @@ Returns:
   }
 
   //
-  // stall 5 seconds to make the device status stable
+  // Wait for the device to settle into a stable state (BSY and DRQ clear)
+  // instead of stalling for a fixed time.
   //
-  gBS->Stall (5000000);
+  if (EFI_ERROR (StatusDRQClear (AtapiScsiPrivate, 31000000))) {
+    return EFI_TIMEOUT;
+  }
 
   return EFI_SUCCESS;
 }
@@ -1448,9 +1504,12 @@ Returns:
   }
 
   //
-  // stall 5 seconds to make the device status stable
+  // Wait for the device to settle into a stable state (BSY and DRQ clear)
+  // instead of stalling for a fixed time.
   //
-  gBS->Stall (5000000);
+  if (EFI_ERROR (StatusDRQClear (AtapiScsiPrivate, 31000000))) {
+    return EFI_TIMEOUT;
+  }
 
   return EFI_SUCCESS;
 }
@@ -1617,6 +1676,23 @@ Returns:
     (UINT16) ((PciData.Device.Bar[3] & 0x0000fffc) + 2);
   }
 
+  //
+  // The Bus Master IDE registers live in BAR4 regardless of the operating
+  // mode. Only use them when the controller advertises bus master support
+  // and bus mastering has been enabled in the command register.
+  //
+  IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr   = 0;
+  IdeRegsBaseAddr[IdeSecondary].BusMasterBaseAddr = 0;
+  if ((PciData.Hdr.ClassCode[0] & IDE_BUS_MASTER_CAPABLE) != 0 &&
+      (PciData.Device.Bar[4] & BIT0) != 0 &&
+      (PciData.Device.Bar[4] & 0x0000fff0) != 0 &&
+      (PciData.Hdr.Command & EFI_PCI_COMMAND_BUS_MASTER) != 0) {
+    IdeRegsBaseAddr[IdePrimary].BusMasterBaseAddr   =
+    (UINT16) (PciData.Device.Bar[4] & 0x0000fff0);
+    IdeRegsBaseAddr[IdeSecondary].BusMasterBaseAddr =
+    (UINT16) ((PciData.Device.Bar[4] & 0x0000fff0) + BM_SECONDARY_OFFSET);
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -1646,6 +1722,7 @@ Returns:
   UINT8               IdeChannel;
   UINT16              CommandBlockBaseAddr;
   UINT16              ControlBlockBaseAddr;
+  UINT16              BusMasterBaseAddr;
   IDE_BASE_REGISTERS  *RegisterPointer;
 
 
@@ -1671,6 +1748,16 @@ Returns:
 
     (*(UINT16 *) &RegisterPointer->Alt) = ControlBlockBaseAddr;
     RegisterPointer->DriveAddress = (UINT16) (ControlBlockBaseAddr + 0x01);
+
+    //
+    // Bus Master IDE registers, left zero when the channel has no DMA engine
+    //
+    BusMasterBaseAddr = IdeRegsBaseAddr[IdeChannel].BusMasterBaseAddr;
+    if (BusMasterBaseAddr != 0) {
+      RegisterPointer->BusMasterCommand  = (UINT16) (BusMasterBaseAddr + BMIC_OFFSET);
+      RegisterPointer->BusMasterStatus   = (UINT16) (BusMasterBaseAddr + BMIS_OFFSET);
+      RegisterPointer->BusMasterPrdTable = (UINT16) (BusMasterBaseAddr + BMID_OFFSET);
+    }
   }
 
 }
@@ -2174,6 +2261,8 @@ Returns:
   UINT16      *CommandIndex;
   UINT8       Count;
   EFI_STATUS  Status;
+  BOOLEAN     UseDma;
+  VOID        *Mapping;
 
   //
   // Set all the command parameters by fill related registers.
@@ -2210,12 +2299,37 @@ Returns:
   }
 
   //
-  // No OVL; No DMA (by setting feature register)
+  // Prefer the Bus Master IDE engine for the data phase; fall back to PIO
+  // when the channel, the device or the buffer cannot do DMA.
+  //
+  UseDma  = FALSE;
+  Mapping = NULL;
+  if (AtapiPassThruDmaSupported (
+        AtapiScsiPrivate,
+        Target,
+        PacketCommand,
+        Buffer,
+        *ByteCount,
+        Direction
+        )) {
+    Status = AtapiPassThruDmaSetup (
+               AtapiScsiPrivate,
+               Buffer,
+               *ByteCount,
+               Direction,
+               &Mapping
+               );
+    UseDma = (BOOLEAN) !EFI_ERROR (Status);
+  }
+
+  //
+  // No OVL; DMA only if the data phase goes through the Bus Master IDE
+  // engine (by setting feature register)
   //
   WritePortB (
     AtapiScsiPrivate->PciIo,
     AtapiScsiPrivate->IoPort->Reg1.Feature,
-    0x00
+    (UINT8) (UseDma ? DMA : 0x00)
     );
 
   //
@@ -2264,6 +2378,9 @@ Returns:
       Status = EFI_DEVICE_ERROR;
     }
 
+    if (UseDma) {
+      AtapiScsiPrivate->PciIo->Unmap (AtapiScsiPrivate->PciIo, Mapping);
+    }
     *ByteCount = 0;
     return Status;
   }
@@ -2276,6 +2393,15 @@ Returns:
     WritePortW (AtapiScsiPrivate->PciIo, AtapiScsiPrivate->IoPort->Data, *CommandIndex);
   }
 
+  if (UseDma) {
+    return AtapiPassThruDmaReadWriteData (
+            AtapiScsiPrivate,
+            Mapping,
+            ByteCount,
+            TimeoutInMicroSeconds
+            );
+  }
+
   //
   // call AtapiPassThruPioReadWriteData() function to get
   // requested transfer data form device.
@@ -2415,6 +2541,317 @@ Arguments:
   return Status;
 }
 
+BOOLEAN
+AtapiPassThruDmaSupported (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT8                     *PacketCommand,
+  VOID                      *Buffer,
+  UINT32                    ByteCount,
+  DATA_DIRECTION            Direction
+  )
+/*++
+
+Routine Description:
+
+  Check whether the data phase of an ATAPI command can use bus master DMA.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The device on the channel, 0 for master, 1 for slave.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The size of Buffer in bytes.
+  Direction:          Indicates the data transfer direction.
+
+Returns:
+
+  TRUE if the command can be sent with the DMA bit set, FALSE otherwise.
+
+--*/
+{
+  UINT8 BusMasterStatus;
+
+  if (AtapiScsiPrivate->IoPort->BusMasterCommand == 0 ||
+      AtapiScsiPrivate->PrdTable == NULL) {
+    return FALSE;
+  }
+
+  if (Buffer == NULL || ByteCount == 0 ||
+      (ByteCount & 0x01) != 0 || ((UINTN) Buffer & 0x01) != 0) {
+    return FALSE;
+  }
+
+  if (Direction != DataIn && Direction != DataOut) {
+    return FALSE;
+  }
+
+  //
+  // The DMA engine does not report how many bytes the device actually
+  // transferred, so only use it for the block commands whose transfer
+  // length is fully described by the command packet.
+  //
+  switch (PacketCommand[0]) {
+  case OP_READ_10:
+  case OP_READ_12:
+  case OP_WRITE_10:
+  case OP_WRITE_12:
+    break;
+
+  default:
+    return FALSE;
+  }
+
+  //
+  // The platform firmware sets the "drive DMA capable" bits once it has
+  // programmed the controller timings for a DMA mode of that drive.
+  //
+  BusMasterStatus = ReadPortB (
+                      AtapiScsiPrivate->PciIo,
+                      AtapiScsiPrivate->IoPort->BusMasterStatus
+                      );
+  if ((BusMasterStatus & (BMIS_DRV0_DMA_CAPABLE << Target)) == 0) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+EFI_STATUS
+AtapiPassThruDmaSetup (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Buffer,
+  UINT32                    ByteCount,
+  DATA_DIRECTION            Direction,
+  VOID                      **Mapping
+  )
+/*++
+
+Routine Description:
+
+  Map the caller's buffer, describe it in the PRD table and program the
+  Bus Master IDE engine. The engine is started by AtapiPassThruDmaReadWriteData()
+  once the command packet has been sent.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The size of Buffer in bytes.
+  Direction:          Indicates the data transfer direction.
+  Mapping:            Returns the PCI I/O mapping of Buffer.
+
+Returns:
+
+  EFI_SUCCESS       - The engine is ready to be started.
+  EFI_UNSUPPORTED   - The buffer cannot be described for the engine, use PIO.
+  Others            - Mapping the buffer failed.
+
+--*/
+{
+  EFI_STATUS                     Status;
+  EFI_PCI_IO_PROTOCOL            *PciIo;
+  EFI_PCI_IO_PROTOCOL_OPERATION  Operation;
+  EFI_PHYSICAL_ADDRESS           DeviceAddress;
+  UINTN                          MappedLength;
+  UINTN                          Remaining;
+  UINT32                         RegionLength;
+  UINTN                          PrdIndex;
+  ATAPI_PRD                      *PrdTable;
+  UINT8                          Command;
+  UINT8                          BusMasterStatus;
+
+  PciIo    = AtapiScsiPrivate->PciIo;
+  PrdTable = AtapiScsiPrivate->PrdTable;
+
+  //
+  // DataIn means the engine writes to host memory
+  //
+  if (Direction == DataIn) {
+    Operation = EfiPciIoOperationBusMasterWrite;
+  } else {
+    Operation = EfiPciIoOperationBusMasterRead;
+  }
+
+  MappedLength = ByteCount;
+  Status = PciIo->Map (
+                    PciIo,
+                    Operation,
+                    Buffer,
+                    &MappedLength,
+                    &DeviceAddress,
+                    Mapping
+                    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // PRD entries only hold 32-bit addresses
+  //
+  if (MappedLength != ByteCount ||
+      DeviceAddress + MappedLength > BASE_4GB) {
+    PciIo->Unmap (PciIo, *Mapping);
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Split the buffer into regions that do not cross a 64KB boundary
+  //
+  Remaining = MappedLength;
+  PrdIndex  = 0;
+  while (Remaining > 0) {
+    if (PrdIndex == MAX_PRD_ENTRIES) {
+      PciIo->Unmap (PciIo, *Mapping);
+      return EFI_UNSUPPORTED;
+    }
+
+    RegionLength = (UINT32) (PRD_REGION_BOUNDARY - (DeviceAddress & (PRD_REGION_BOUNDARY - 1)));
+    if (RegionLength > Remaining) {
+      RegionLength = (UINT32) Remaining;
+    }
+
+    PrdTable[PrdIndex].RegionBaseAddr = (UINT32) DeviceAddress;
+    //
+    // A byte count of 0 stands for a 64KB region
+    //
+    PrdTable[PrdIndex].ByteCount      = (UINT16) RegionLength;
+    PrdTable[PrdIndex].EndOfTable     = 0;
+
+    DeviceAddress += RegionLength;
+    Remaining     -= RegionLength;
+    PrdIndex++;
+  }
+
+  PrdTable[PrdIndex - 1].EndOfTable = PRD_EOT;
+
+  //
+  // Program the direction with the engine stopped, clear the interrupt and
+  // error bits (write 1 to clear) and point the engine at the PRD table.
+  //
+  Command = 0;
+  if (Direction == DataIn) {
+    Command = BMIC_NREAD;
+  }
+  WritePortB (PciIo, AtapiScsiPrivate->IoPort->BusMasterCommand, Command);
+
+  BusMasterStatus = ReadPortB (PciIo, AtapiScsiPrivate->IoPort->BusMasterStatus);
+  WritePortB (
+    PciIo,
+    AtapiScsiPrivate->IoPort->BusMasterStatus,
+    (UINT8) (BusMasterStatus | BMIS_INTERRUPT | BMIS_ERROR)
+    );
+
+  WritePortDW (
+    PciIo,
+    AtapiScsiPrivate->IoPort->BusMasterPrdTable,
+    (UINT32) AtapiScsiPrivate->PrdTableDeviceAddr
+    );
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AtapiPassThruDmaReadWriteData (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Mapping,
+  UINT32                    *ByteCount,
+  UINT64                    TimeoutInMicroSeconds
+  )
+/*++
+
+Routine Description:
+
+  Performs the DMA data transfer between ATAPI device and host after the
+  ATAPI command packet is sent, then releases the buffer mapping.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Mapping:            The mapping returned by AtapiPassThruDmaSetup().
+  ByteCount:          When input, indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+                      A TimeoutInMicroSeconds value of 0 means that
+                      this function will wait indefinitely for the ATAPI
+                      command to execute.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT8                Command;
+  UINT8                BusMasterStatus;
+
+  PciIo = AtapiScsiPrivate->PciIo;
+
+  Command = ReadPortB (PciIo, AtapiScsiPrivate->IoPort->BusMasterCommand);
+  WritePortB (
+    PciIo,
+    AtapiScsiPrivate->IoPort->BusMasterCommand,
+    (UINT8) (Command | BMIC_START)
+    );
+
+  //
+  // The device may take up to 400ns to raise BSY after the command packet;
+  // read the Alternate Status register once before polling for completion.
+  //
+  ReadPortB (PciIo, AtapiScsiPrivate->IoPort->Alt.AltStatus);
+
+  //
+  // The device clears BSY and DRQ once the whole transfer has completed
+  //
+  Status = StatusDRQClear (AtapiScsiPrivate, TimeoutInMicroSeconds);
+
+  //
+  // Stop the engine and clear its interrupt and error bits
+  //
+  WritePortB (
+    PciIo,
+    AtapiScsiPrivate->IoPort->BusMasterCommand,
+    (UINT8) (Command & ~BMIC_START)
+    );
+  BusMasterStatus = ReadPortB (PciIo, AtapiScsiPrivate->IoPort->BusMasterStatus);
+  WritePortB (
+    PciIo,
+    AtapiScsiPrivate->IoPort->BusMasterStatus,
+    (UINT8) (BusMasterStatus | BMIS_INTERRUPT | BMIS_ERROR)
+    );
+
+  PciIo->Unmap (PciIo, Mapping);
+
+  if (EFI_ERROR (Status)) {
+    *ByteCount = 0;
+    AtapiPassThruCheckErrorStatus (AtapiScsiPrivate);
+    if (Status == EFI_ABORTED) {
+      Status = EFI_DEVICE_ERROR;
+    }
+    return Status;
+  }
+
+  if ((BusMasterStatus & BMIS_ERROR) != 0) {
+    *ByteCount = 0;
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // read status register to check whether error happens.
+  //
+  Status = AtapiPassThruCheckErrorStatus (AtapiScsiPrivate);
+  if (EFI_ERROR (Status)) {
+    *ByteCount = 0;
+  }
+
+  return Status;
+}
+
 
 UINT8
 ReadPortB (
@@ -2558,6 +2995,40 @@ Returns:
               );
 }
 
+VOID
+WritePortDW (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port,
+  IN  UINT32                Data
+  )
+/*++
+
+Routine Description:
+
+  Write one dword to a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+  Data       - The data to write
+
+Returns:
+
+   NONE
+
+--*/
+{
+  PciIo->Io.Write (
+              PciIo,
+              EfiPciIoWidthUint32,
+              EFI_PCI_IO_PASS_THROUGH_BAR,
+              (UINT64) Port,
+              1,
+              &Data
+              );
+}
+
 EFI_STATUS
 StatusDRQClear (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate,
@@ -2590,7 +3061,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -2621,9 +3092,9 @@ Returns:
       }
     }
     //
-    //  Stall for 30 us
+    //  Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
 
     //
     // Loop infinitely if not meeting expected condition
@@ -2674,7 +3145,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -2703,9 +3174,9 @@ Returns:
       }
     }
     //
-    //  Stall for 30 us
+    //  Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
 
     //
     // Loop infinitely if not meeting expected condition
@@ -2756,7 +3227,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -2787,9 +3258,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
 
     //
     // Loop infinitely if not meeting expected condition
@@ -2841,7 +3312,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -2871,9 +3342,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
 
     //
     // Loop infinitely if not meeting expected condition
@@ -2923,7 +3394,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -2937,9 +3408,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
 
     //
     // Loop infinitely if not meeting expected condition
@@ -2989,7 +3460,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -3003,9 +3474,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
     //
     // Loop infinitely if not meeting expected condition
     //
@@ -3056,7 +3527,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -3083,9 +3554,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
     //
     // Loop infinitely if not meeting expected condition
     //
@@ -3136,7 +3607,7 @@ Returns:
   if (TimeoutInMicroSeconds == 0) {
     Delay = 2;
   } else {
-    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) 30) + 1;
+    Delay = DivU64x32 (TimeoutInMicroSeconds, (UINT32) ATAPI_STATUS_POLL_INTERVAL) + 1;
   }
 
   do {
@@ -3163,9 +3634,9 @@ Returns:
     }
 
     //
-    // Stall for 30 us
+    // Stall for ATAPI_STATUS_POLL_INTERVAL us
     //
-    gBS->Stall (30);
+    gBS->Stall (ATAPI_STATUS_POLL_INTERVAL);
     //
     // Loop infinitely if not meeting expected condition
     //
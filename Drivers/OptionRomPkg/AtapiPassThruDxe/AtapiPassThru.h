@@ -68,6 +68,7 @@ typedef enum {
 #define IDE_PRIMARY_PROGRAMMABLE_INDICATOR    BIT1
 #define IDE_SECONDARY_OPERATING_MODE          BIT2
 #define IDE_SECONDARY_PROGRAMMABLE_INDICATOR  BIT3
+#define IDE_BUS_MASTER_CAPABLE                BIT7
 
 
 #define ATAPI_MAX_CHANNEL 2
@@ -86,8 +87,23 @@ typedef struct {
   IDE_CMD_OR_STATUS               Reg;
   IDE_AltStatus_OR_DeviceControl  Alt;
   UINT16                          DriveAddress;
+  ///
+  /// Bus Master IDE registers, all zero when the channel cannot do DMA
+  ///
+  UINT16                          BusMasterCommand;
+  UINT16                          BusMasterStatus;
+  UINT16                          BusMasterPrdTable;
 } IDE_BASE_REGISTERS;
 
+///
+/// Physical Region Descriptor used by the Bus Master IDE engine
+///
+typedef struct {
+  UINT32  RegionBaseAddr;
+  UINT16  ByteCount;      ///< 0 means 64KB
+  UINT16  EndOfTable;
+} ATAPI_PRD;
+
 #define ATAPI_SCSI_PASS_THRU_DEV_SIGNATURE  SIGNATURE_32 ('a', 's', 'p', 't')
 
 typedef struct {
@@ -104,6 +120,12 @@ typedef struct {
   IDE_BASE_REGISTERS               AtapiIoPortRegisters[2];
   UINT32                           LatestTargetId;
   UINT64                           LatestLun;
+  //
+  // PRD table shared by both channels, NULL if DMA is not available
+  //
+  ATAPI_PRD                        *PrdTable;
+  EFI_PHYSICAL_ADDRESS             PrdTableDeviceAddr;
+  VOID                             *PrdTableMapping;
 } ATAPI_SCSI_PASS_THRU_DEV;
 
 //
@@ -112,6 +134,7 @@ typedef struct {
 typedef struct {
   UINT16  CommandBlockBaseAddr;
   UINT16  ControlBlockBaseAddr;
+  UINT16  BusMasterBaseAddr;
 } IDE_REGISTERS_BASE_ADDR;
 
 #define ATAPI_SCSI_PASS_THRU_DEV_FROM_THIS(a) \
@@ -256,6 +279,36 @@ typedef struct {
 #define OVERLAP BIT1
 #define DMA     BIT0
 
+//
+// Bus Master IDE registers, offsets from the channel base in BAR4
+//
+#define BMIC_OFFSET           0x00  ///< Bus Master IDE Command register
+#define BMIS_OFFSET           0x02  ///< Bus Master IDE Status register
+#define BMID_OFFSET           0x04  ///< Bus Master IDE Descriptor Table Pointer register
+#define BM_SECONDARY_OFFSET   0x08
+
+//
+// Bus Master IDE Command Reg
+//
+#define BMIC_START  BIT0
+#define BMIC_NREAD  BIT3  ///< The engine writes to memory (device to host)
+
+//
+// Bus Master IDE Status Reg
+//
+#define BMIS_ACTIVE         BIT0
+#define BMIS_ERROR          BIT1
+#define BMIS_INTERRUPT      BIT2
+#define BMIS_DRV0_DMA_CAPABLE BIT5
+#define BMIS_DRV1_DMA_CAPABLE BIT6
+
+//
+// PRD table layout: one page, regions must not cross a 64KB boundary
+//
+#define PRD_EOT               BIT15
+#define MAX_PRD_ENTRIES       (EFI_PAGE_SIZE / sizeof (ATAPI_PRD))
+#define PRD_REGION_BOUNDARY   0x10000
+
 //
 // ATAPI Interrupt Reason Reson Reg (ATA Sector Count Register)
 //
@@ -272,6 +325,12 @@ typedef struct {
 #define DEFAULT_CTL           (0x0a)
 #define MAX_ATAPI_BYTE_COUNT  (0xfffe)
 
+//
+// Interval, in microseconds, between two reads of the status register while
+// waiting for the device
+//
+#define ATAPI_STATUS_POLL_INTERVAL  10
+
 //
 // function prototype
 //
@@ -1276,6 +1335,31 @@ Returns:
 --*/
 ;
 
+VOID
+WritePortDW (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT16                Port,
+  IN  UINT32                Data
+  )
+/*++
+
+Routine Description:
+
+  Write one dword to a specified I/O port.
+
+Arguments:
+
+  PciIo      - The pointer of EFI_PCI_IO_PROTOCOL
+  Port       - IO port
+  Data       - The data to write
+
+Returns:
+
+  NONE
+
+--*/
+;
+
 EFI_STATUS
 StatusDRQClear (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate,
@@ -1526,6 +1610,104 @@ Arguments:
 --*/
 ;
 
+BOOLEAN
+AtapiPassThruDmaSupported (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  UINT32                    Target,
+  UINT8                     *PacketCommand,
+  VOID                      *Buffer,
+  UINT32                    ByteCount,
+  DATA_DIRECTION            Direction
+  )
+/*++
+
+Routine Description:
+
+  Check whether the data phase of an ATAPI command can use bus master DMA.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Target:             The device on the channel, 0 for master, 1 for slave.
+  PacketCommand:      Points to the ATAPI command packet.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The size of Buffer in bytes.
+  Direction:          Indicates the data transfer direction.
+
+Returns:
+
+  TRUE if the command can be sent with the DMA bit set, FALSE otherwise.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaSetup (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Buffer,
+  UINT32                    ByteCount,
+  DATA_DIRECTION            Direction,
+  VOID                      **Mapping
+  )
+/*++
+
+Routine Description:
+
+  Map the caller's buffer, describe it in the PRD table and program the
+  Bus Master IDE engine. The engine is started by AtapiPassThruDmaReadWriteData()
+  once the command packet has been sent.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Buffer:             Points to the transferred data.
+  ByteCount:          The size of Buffer in bytes.
+  Direction:          Indicates the data transfer direction.
+  Mapping:            Returns the PCI I/O mapping of Buffer.
+
+Returns:
+
+  EFI_SUCCESS       - The engine is ready to be started.
+  EFI_UNSUPPORTED   - The buffer cannot be described for the engine, use PIO.
+  Others            - Mapping the buffer failed.
+
+--*/
+;
+
+EFI_STATUS
+AtapiPassThruDmaReadWriteData (
+  ATAPI_SCSI_PASS_THRU_DEV  *AtapiScsiPrivate,
+  VOID                      *Mapping,
+  UINT32                    *ByteCount,
+  UINT64                    TimeoutInMicroSeconds
+  )
+/*++
+
+Routine Description:
+
+  Performs the DMA data transfer between ATAPI device and host after the
+  ATAPI command packet is sent, then releases the buffer mapping.
+
+Arguments:
+
+  AtapiScsiPrivate:   Private data structure for the specified channel.
+  Mapping:            The mapping returned by AtapiPassThruDmaSetup().
+  ByteCount:          When input, indicates the buffer size; when output,
+                      indicates the actually transferred data size.
+  TimeoutInMicroSeconds:
+                      The timeout, in micro second units, to use for the
+                      execution of this ATAPI command.
+                      A TimeoutInMicroSeconds value of 0 means that
+                      this function will wait indefinitely for the ATAPI
+                      command to execute.
+
+Returns:
+
+  EFI_STATUS
+
+--*/
+;
+
 EFI_STATUS
 AtapiPassThruCheckErrorStatus (
   ATAPI_SCSI_PASS_THRU_DEV        *AtapiScsiPrivate
@@ -38,6 +38,12 @@ EFI_DRIVER_BINDING_PROTOCOL  gUsbSerialDriverBinding = {
   NULL
 };
 
+//
+// Number of USB serial devices started so far, used to name the statistics
+// variable of each device
+//
+UINTN mUsbSerialInstance = 0;
+
 //
 // Table with the nearest power of 2 for the numbers 0-15
 //
@@ -204,109 +210,386 @@ SetStatusInternal (
 }
 
 /**
-  Initiates a read operation on the Usb Serial Device.
+  Raises the TPL to TPL_CALLBACK, the TPL of the polling loop, unless the
+  caller already runs at a higher TPL.
+
+  @return The TPL to pass to RestoreTPL().
+
+**/
+EFI_TPL
+RaiseTplToCallback (
+  VOID
+  )
+{
+  EFI_TPL  Tpl;
+
+  Tpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  gBS->RestoreTPL (Tpl);
+
+  return gBS->RaiseTPL (MAX (Tpl, TPL_CALLBACK));
+}
+
+/**
+  Moves data from the bulk-in endpoint into the receive FIFO.
+
+  Bulk-in transfers are issued back to back until the device has nothing more
+  to send, the FIFO cannot take another packet or FTDI_MAX_READS_PER_POLL
+  transfers have been done. Data the FIFO cannot take stays in the device,
+  where hardware flow control can hold it back.
+
+  The transfers are done at TPL_CALLBACK, so the polling loop never runs
+  while a Serial IO call reads and the firmware is not held at TPL_NOTIFY while
+  the device sits on an IN token. A caller at a higher TPL that comes in
+  during a read finds the device busy and gets no new data. The TPL is raised
+  to TPL_NOTIFY only to move the data into the FIFO and publish
+  DataBufferTail, which is only moved here.
 
   @param  UsbSerialDevice[in]        Handle to the USB device to read
-  @param  BufferSize[in, out]        On input, the size of the Buffer. On output,
-                                     the amount of data returned in Buffer.
-                                     Setting this to zero will initiate a read
-                                     and store all data returned in the internal
-                                     buffer.
-  @param  Buffer [out]               The buffer to return the data into.
 
   @retval EFI_SUCCESS                The data was read.
   @retval EFI_DEVICE_ERROR           The device reported an error.
-  @retval EFI_TIMEOUT                The data write was stopped due to a timeout.
+  @retval EFI_TIMEOUT                The data read was stopped due to a timeout.
 
 **/
 EFI_STATUS
 EFIAPI
 ReadDataFromUsb (
-  IN USB_SER_DEV  *UsbSerialDevice,
-  IN OUT UINTN    *BufferSize,
-  OUT VOID        *Buffer
+  IN USB_SER_DEV  *UsbSerialDevice
   )
 {
   EFI_STATUS  Status;
   UINTN       ReadBufferSize;
   UINT8       *ReadBuffer;
-  UINTN       Index;
+  UINTN       MaxPacketSize;
+  UINTN       PacketCount;
+  UINTN       PacketLength;
+  UINTN       Offset;
+  UINTN       DataLength;
+  UINTN       Received;
+  UINT32      Free;
+  UINT32      Tail;
+  UINT32      Mask;
+  UINT32      Chunk;
+  UINTN       Transfer;
   EFI_TPL     Tpl;
-  UINT8       StatusBuffer[2]; // buffer to store the status bytes
-
-  ReadBufferSize = 512;
-  ReadBuffer     = &(UsbSerialDevice->ReadBuffer[0]);
+  EFI_TPL     NotifyTpl;
 
   if (UsbSerialDevice->Shutdown) {
     return EFI_DEVICE_ERROR;
   }
 
-  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ReadBuffer    = &(UsbSerialDevice->ReadBuffer[0]);
+  MaxPacketSize = UsbSerialDevice->InEndpointDescriptor.MaxPacketSize;
+  if (MaxPacketSize <= FTDI_STATUS_SIZE || MaxPacketSize > FTDI_READ_BUFFER_SIZE) {
+    return EFI_DEVICE_ERROR;
+  }
 
-  Status = UsbSerialDataTransfer (
-             UsbSerialDevice,
-             EfiUsbDataIn,
-             ReadBuffer,
-             &ReadBufferSize,
-             FTDI_TIMEOUT*2  //Padded because timers won't be exactly aligned
-             );
-  if (EFI_ERROR (Status)) {
+  Tpl = RaiseTplToCallback ();
+  if (UsbSerialDevice->Reading) {
     gBS->RestoreTPL (Tpl);
-    if (Status == EFI_TIMEOUT) {
-      return EFI_TIMEOUT;
-    } else {
-      return EFI_DEVICE_ERROR;
-    }
+    return EFI_SUCCESS;
   }
+  UsbSerialDevice->Reading = TRUE;
 
-  //
-  // Store the status bytes in the status buffer
-  //
-  for (Index = 0; Index < 2; Index++) {//only the first 2 bytes are status bytes
-    StatusBuffer[Index] = ReadBuffer[Index];
-  }
-  //
-  // update the statusvalue field of the usbserialdevice
-  //
-  Status = SetStatusInternal (UsbSerialDevice, StatusBuffer);
-  if (Status != EFI_SUCCESS) {
-  }
+  Status = EFI_SUCCESS;
 
-  //
-  // Store the read data in the read buffer, start at 2 to ignore status bytes
-  //
-  for (Index = 2; Index < ReadBufferSize; Index++) {
-    if (((UsbSerialDevice->DataBufferTail + 1) % SW_FIFO_DEPTH) == UsbSerialDevice->DataBufferHead) {
+  for (Transfer = 0; Transfer < FTDI_MAX_READS_PER_POLL; Transfer++) {
+    //
+    // Only ask for as many packets as the FIFO can take
+    //
+    Free        = UsbSerialDevice->DataBufferSize -
+                  (UsbSerialDevice->DataBufferTail - UsbSerialDevice->DataBufferHead);
+    PacketCount = MIN (Free / (MaxPacketSize - FTDI_STATUS_SIZE), FTDI_READ_BUFFER_SIZE / MaxPacketSize);
+    if (PacketCount == 0) {
       break;
     }
-    if (ReadBuffer[Index] == 0x00) {
-      //
-      // This is null, do not add
-      //
-    } else {
-      UsbSerialDevice->DataBuffer[UsbSerialDevice->DataBufferTail] = ReadBuffer[Index];
-      UsbSerialDevice->DataBufferTail = (UsbSerialDevice->DataBufferTail + 1) % SW_FIFO_DEPTH;
+
+    ReadBufferSize = PacketCount * MaxPacketSize;
+    Status = UsbSerialDataTransfer (
+               UsbSerialDevice,
+               EfiUsbDataIn,
+               ReadBuffer,
+               &ReadBufferSize,
+               FTDI_TIMEOUT*2  //Padded because timers won't be exactly aligned
+               );
+    if (EFI_ERROR (Status)) {
+      if (Transfer > 0) {
+        //
+        // Keep what the previous transfers got, the device is just drained
+        //
+        Status = EFI_SUCCESS;
+      } else if (Status != EFI_TIMEOUT) {
+        Status = EFI_DEVICE_ERROR;
+      }
+      break;
+    }
+
+    //
+    // Strip the status bytes from the start of every packet and append the
+    // payload to the FIFO. SetAttributes() may have resized or reset the FIFO
+    // during the transfer, so look at it again; what no longer fits is lost.
+    //
+    NotifyTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    UsbSerialDevice->Statistics.RxTransfers++;
+    Received = 0;
+    Tail     = UsbSerialDevice->DataBufferTail;
+    Mask     = UsbSerialDevice->DataBufferSize - 1;
+    Free     = UsbSerialDevice->DataBufferSize - (Tail - UsbSerialDevice->DataBufferHead);
+    for (Offset = 0; Offset < ReadBufferSize; Offset += MaxPacketSize) {
+      PacketLength = MIN (MaxPacketSize, ReadBufferSize - Offset);
+      if (PacketLength < FTDI_STATUS_SIZE) {
+        break;
+      }
+
+      SetStatusInternal (UsbSerialDevice, &ReadBuffer[Offset]);
+      if ((ReadBuffer[Offset + 1] & OE_MASK) != 0) {
+        UsbSerialDevice->Statistics.RxOverruns++;
+      }
+
+      DataLength = PacketLength - FTDI_STATUS_SIZE;
+      if (DataLength > Free - Received) {
+        DataLength = Free - Received;
+        UsbSerialDevice->Statistics.RxOverruns++;
+      }
+
+      Chunk = (UINT32) MIN (DataLength, UsbSerialDevice->DataBufferSize - (Tail & Mask));
+      CopyMem (
+        &UsbSerialDevice->DataBuffer[Tail & Mask],
+        &ReadBuffer[Offset + FTDI_STATUS_SIZE],
+        Chunk
+        );
+      CopyMem (
+        UsbSerialDevice->DataBuffer,
+        &ReadBuffer[Offset + FTDI_STATUS_SIZE + Chunk],
+        DataLength - Chunk
+        );
+      Tail     += (UINT32) DataLength;
+      Received += DataLength;
+    }
+
+    //
+    // Publish the data only once it is in the FIFO
+    //
+    MemoryFence ();
+    UsbSerialDevice->DataBufferTail  = Tail;
+    UsbSerialDevice->Statistics.RxBytes += Received;
+    gBS->RestoreTPL (NotifyTpl);
+
+    //
+    // A short transfer means the device had no more data
+    //
+    if (ReadBufferSize < PacketCount * MaxPacketSize || Received == 0) {
+      break;
     }
   }
 
+  UsbSerialDevice->Reading = FALSE;
+  gBS->RestoreTPL (Tpl);
+  return Status;
+}
+
+/**
+  Copies data out of the receive FIFO.
+
+  This is the consumer side of the FIFO; it only moves DataBufferHead.
+
+  @param  UsbSerialDevice[in]        Handle to the USB device to read
+  @param  BufferSize[in]             The size of Buffer.
+  @param  Buffer[out]                The buffer to return the data into.
+
+  @return The number of bytes copied to Buffer.
+
+**/
+UINTN
+ReadDataFromFifo (
+  IN  USB_SER_DEV  *UsbSerialDevice,
+  IN  UINTN        BufferSize,
+  OUT UINT8        *Buffer
+  )
+{
+  UINT32  Head;
+  UINT32  Mask;
+  UINTN   Length;
+  UINTN   Chunk;
+
+  Head   = UsbSerialDevice->DataBufferHead;
+  Mask   = UsbSerialDevice->DataBufferSize - 1;
+  Length = MIN (BufferSize, (UINTN) (UsbSerialDevice->DataBufferTail - Head));
+  if (Length == 0) {
+    return 0;
+  }
+
   //
-  // Read characters out of the buffer to satisfy caller's request.
+  // Make sure the data is read after the tail that covers it
   //
-  for (Index = 0; Index < *BufferSize; Index++) {
-    if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
-      break;
-    }
+  MemoryFence ();
+
+  Chunk = MIN (Length, UsbSerialDevice->DataBufferSize - (Head & Mask));
+  CopyMem (Buffer, &UsbSerialDevice->DataBuffer[Head & Mask], Chunk);
+  CopyMem (Buffer + Chunk, UsbSerialDevice->DataBuffer, Length - Chunk);
+
+  MemoryFence ();
+  UsbSerialDevice->DataBufferHead = Head + (UINT32) Length;
+
+  return Length;
+}
+
+/**
+  Sends the coalesced writes to the device.
+
+  The transfer is done at TPL_CALLBACK, or at the caller's TPL if that is
+  higher. Callers at a higher TPL may still append to WriteBuffer meanwhile;
+  what they append is kept for the next flush. A flush that comes in while
+  another one waits for the device does nothing.
+
+  @param  UsbSerialDevice[in]  Handle to the USB device to write to
+
+  @retval EFI_SUCCESS          The buffered data was written.
+  @retval EFI_DEVICE_ERROR     The device reported an error, the buffered data
+                               was dropped.
+  @retval EFI_TIMEOUT          The data write was stopped due to a timeout, the
+                               buffered data was dropped.
+
+**/
+EFI_STATUS
+FlushWriteBuffer (
+  IN USB_SER_DEV  *UsbSerialDevice
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Length;
+  EFI_TPL     Tpl;
+  EFI_TPL     NotifyTpl;
+
+  Tpl       = RaiseTplToCallback ();
+  NotifyTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (UsbSerialDevice->Flushing || UsbSerialDevice->WriteBufferLength == 0) {
+    gBS->RestoreTPL (NotifyTpl);
+    gBS->RestoreTPL (Tpl);
+    return EFI_SUCCESS;
+  }
+  UsbSerialDevice->Flushing = TRUE;
+  Length                    = UsbSerialDevice->WriteBufferLength;
+  gBS->RestoreTPL (NotifyTpl);
+
+  Status = UsbSerialDataTransfer (
+             UsbSerialDevice,
+             EfiUsbDataOut,
+             UsbSerialDevice->WriteBuffer,
+             &Length,
+             FTDI_TIMEOUT
+             );
+
+  NotifyTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (EFI_ERROR (Status)) {
+    UsbSerialDevice->WriteBufferLength = 0;
+    Status = (Status == EFI_TIMEOUT) ? EFI_TIMEOUT : EFI_DEVICE_ERROR;
+  } else {
+    UsbSerialDevice->Statistics.TxTransfers++;
+    UsbSerialDevice->Statistics.TxBytes += Length;
+
     //
-    // Still have characters in the buffer to return
+    // Keep whatever the device did not take, and whatever was appended
+    // during the transfer, for the next flush. A reset may have dropped the
+    // buffer meanwhile.
     //
-    ((UINT8 *)Buffer)[Index]        = UsbSerialDevice->DataBuffer[UsbSerialDevice->DataBufferHead];
-    UsbSerialDevice->DataBufferHead = (UsbSerialDevice->DataBufferHead + 1) % SW_FIFO_DEPTH;
+    Length                              = MIN (Length, UsbSerialDevice->WriteBufferLength);
+    UsbSerialDevice->WriteBufferLength -= Length;
+    CopyMem (
+      UsbSerialDevice->WriteBuffer,
+      &UsbSerialDevice->WriteBuffer[Length],
+      UsbSerialDevice->WriteBufferLength
+      );
+  }
+  UsbSerialDevice->Flushing = FALSE;
+  gBS->RestoreTPL (NotifyTpl);
+  gBS->RestoreTPL (Tpl);
+
+  return Status;
+}
+
+/**
+  Sets the receive poll interval of the device.
+
+  @param  UsbSerialDevice[in]  Handle to the USB device
+  @param  PollInterval[in]     The new interval in ms
+
+**/
+VOID
+SetPollInterval (
+  IN USB_SER_DEV  *UsbSerialDevice,
+  IN UINTN        PollInterval
+  )
+{
+  if (UsbSerialDevice->PollInterval == PollInterval) {
+    return;
+  }
+
+  UsbSerialDevice->PollInterval = PollInterval;
+  gBS->SetTimer (
+         UsbSerialDevice->PollingLoop,
+         TimerPeriodic,
+         EFI_TIMER_PERIOD_MILLISECONDS (PollInterval)
+         );
+}
+
+/**
+  Resizes the receive FIFO to match the requested receive FIFO depth.
+
+  The FIFO contents are discarded when its size changes. The caller must be at
+  TPL_NOTIFY.
+
+  @param  UsbSerialDevice[in]   Handle to the USB device
+  @param  ReceiveFifoDepth[in]  The requested depth, 0 for the default
+
+  @retval EFI_SUCCESS           The FIFO has the requested depth.
+  @retval EFI_INVALID_PARAMETER ReceiveFifoDepth is too large.
+  @retval EFI_OUT_OF_RESOURCES  The FIFO could not be allocated.
+
+**/
+EFI_STATUS
+SetReceiveFifoDepthInternal (
+  IN USB_SER_DEV  *UsbSerialDevice,
+  IN UINT32       ReceiveFifoDepth
+  )
+{
+  UINT32  Depth;
+  UINT8   *DataBuffer;
+
+  if (ReceiveFifoDepth > SW_FIFO_MAX_DEPTH) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (ReceiveFifoDepth == 0) {
+    Depth = SW_FIFO_DEPTH;
+  } else {
+    Depth = GetPowerOfTwo32 (MAX (ReceiveFifoDepth, SW_FIFO_MIN_DEPTH));
+    if (Depth < ReceiveFifoDepth) {
+      Depth <<= 1;
+    }
+  }
+
+  if (UsbSerialDevice->DataBuffer != NULL && UsbSerialDevice->DataBufferSize == Depth) {
+    return EFI_SUCCESS;
   }
+
+  DataBuffer = AllocateZeroPool (Depth);
+  if (DataBuffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (UsbSerialDevice->DataBuffer != NULL) {
+    FreePool (UsbSerialDevice->DataBuffer);
+  }
+
   //
-  // Return actual number of bytes returned.
+  // Head==Tail = true means buffer is empty.
   //
-  *BufferSize = Index;
-  gBS->RestoreTPL (Tpl);
+  UsbSerialDevice->DataBuffer     = DataBuffer;
+  UsbSerialDevice->DataBufferSize = Depth;
+  UsbSerialDevice->DataBufferHead = 0;
+  UsbSerialDevice->DataBufferTail = 0;
+
   return EFI_SUCCESS;
 }
 
@@ -363,7 +646,8 @@ SetInitialStatus (
 /**
   UsbSerialDriverCheckInput.
   attempts to read data in from the device periodically, stores any read data
-  and updates the control attributes.
+  and updates the control attributes. Also sends the writes coalesced since
+  the previous poll.
 
   @param  Event[in]
   @param  Context[in]....The current instance of the USB serial device
@@ -376,38 +660,98 @@ UsbSerialDriverCheckInput (
   IN  VOID       *Context
   )
 {
-  UINTN        BufferSize;
   USB_SER_DEV  *UsbSerialDevice;
+  UINT64       RxBytes;
+  UINTN        WriteBufferLength;
 
   UsbSerialDevice = (USB_SER_DEV*)Context;
 
+  if (UsbSerialDevice->Shutdown) {
+    return;
+  }
+
+  RxBytes           = UsbSerialDevice->Statistics.RxBytes;
+  WriteBufferLength = UsbSerialDevice->WriteBufferLength;
+
+  ReadDataFromUsb (UsbSerialDevice);
+  FlushWriteBuffer (UsbSerialDevice);
+
+  //
+  // A device with nothing to send only returns its status bytes, after its
+  // latency timer expired; poll it less and less often until data moves again
+  //
+  if (UsbSerialDevice->Statistics.RxBytes != RxBytes || WriteBufferLength != 0) {
+    SetPollInterval (UsbSerialDevice, FTDI_POLL_INTERVAL);
+  } else {
+    SetPollInterval (
+      UsbSerialDevice,
+      MIN (UsbSerialDevice->PollInterval * 2, FTDI_POLL_INTERVAL_MAX)
+      );
+  }
+
   if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
     //
-    // Data buffer is empty, try to read from device
+    // Data buffer still has no data, set the EFI_SERIAL_INPUT_BUFFER_EMPTY
+    // flag
     //
-    BufferSize = 0;
-    ReadDataFromUsb (UsbSerialDevice, &BufferSize, NULL);
-    if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
-      //
-      // Data buffer still has no data, set the EFI_SERIAL_INPUT_BUFFER_EMPTY
-      // flag
-      //
-      UsbSerialDevice->ControlBits |= EFI_SERIAL_INPUT_BUFFER_EMPTY;
-    } else {
-      //
-      // Read has returned some data, clear the EFI_SERIAL_INPUT_BUFFER_EMPTY
-      // flag
-      //
-      UsbSerialDevice->ControlBits &= ~(EFI_SERIAL_INPUT_BUFFER_EMPTY);
-    }
+    UsbSerialDevice->ControlBits |= EFI_SERIAL_INPUT_BUFFER_EMPTY;
   } else {
     //
-    // Data buffer has data, no read attempt required
+    // Read has returned some data, clear the EFI_SERIAL_INPUT_BUFFER_EMPTY
+    // flag
     //
     UsbSerialDevice->ControlBits &= ~(EFI_SERIAL_INPUT_BUFFER_EMPTY);
   }
 }
 
+/**
+  Publishes the transfer statistics of the USB serial device in a volatile
+  variable, along with the throughput over the last interval.
+
+  @param  Event[in]
+  @param  Context[in]....The current instance of the USB serial device
+
+**/
+VOID
+EFIAPI
+UsbSerialDriverUpdateStatistics (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  USB_SER_DEV                 *UsbSerialDevice;
+  FTDI_USB_SERIAL_STATISTICS  Statistics;
+  EFI_TPL                     Tpl;
+
+  UsbSerialDevice = (USB_SER_DEV*)Context;
+
+  //
+  // Take a consistent snapshot, the counters are updated at TPL_NOTIFY
+  //
+  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  CopyMem (&Statistics, &UsbSerialDevice->Statistics, sizeof (Statistics));
+  gBS->RestoreTPL (Tpl);
+
+  Statistics.RxBytesPerSecond = (UINT32) DivU64x32 (
+                                           MultU64x32 (Statistics.RxBytes - UsbSerialDevice->LastRxBytes, 1000),
+                                           FTDI_STATISTICS_INTERVAL
+                                           );
+  Statistics.TxBytesPerSecond = (UINT32) DivU64x32 (
+                                           MultU64x32 (Statistics.TxBytes - UsbSerialDevice->LastTxBytes, 1000),
+                                           FTDI_STATISTICS_INTERVAL
+                                           );
+  UsbSerialDevice->LastRxBytes = Statistics.RxBytes;
+  UsbSerialDevice->LastTxBytes = Statistics.TxBytes;
+
+  gRT->SetVariable (
+         UsbSerialDevice->StatisticsVariableName,
+         &gFtdiUsbSerialStatisticsGuid,
+         EFI_VARIABLE_BOOTSERVICE_ACCESS,
+         sizeof (Statistics),
+         &Statistics
+         );
+}
+
 /**
   Encodes the baud rate into the format expected by the Ftdi device.
 
@@ -856,9 +1200,18 @@ SetAttributesInternal (
   // check for invalid combinations of parameters
   //
   if (((DataBits >= 6) && (DataBits <= 8)) && (StopBits == OneFiveStopBits)) {
+    gBS->RestoreTPL (Tpl);
     return  EFI_INVALID_PARAMETER;
   }
 
+  //
+  // size the receive FIFO
+  //
+  Status = SetReceiveFifoDepthInternal (UsbSerialDevice, ReceiveFifoDepth);
+  if (EFI_ERROR (Status)) {
+    goto StatusError;
+  }
+
   //
   // set data bits, parity and stop bits
   //
@@ -895,8 +1248,9 @@ SetAttributesInternal (
     UsbSerialDevice->SerialIo.Mode->BaudRate = BaudRate;
   }
 
-  UsbSerialDevice->LastSettings.Timeout          = FTDI_TIMEOUT;
-  UsbSerialDevice->LastSettings.ReceiveFifoDepth = FTDI_MAX_RECEIVE_FIFO_DEPTH;
+  UsbSerialDevice->LastSettings.Timeout            = FTDI_TIMEOUT;
+  UsbSerialDevice->LastSettings.ReceiveFifoDepth   = UsbSerialDevice->DataBufferSize;
+  UsbSerialDevice->SerialIo.Mode->ReceiveFifoDepth = UsbSerialDevice->DataBufferSize;
 
   if (Parity == DefaultParity) {
     UsbSerialDevice->LastSettings.Parity   = UsbSerialDevice->LastSettings.Parity;
@@ -1344,13 +1698,14 @@ GetControlBitsInternal (
     *Control |= EFI_SERIAL_HARDWARE_FLOW_CONTROL_ENABLE;
   }
   //
-  // check if the buffer is empty since only one is being used if it is empty
-  // set both the receive and transmit buffers to empty
+  // the receive FIFO and the coalesced writes are the only buffers
   //
   if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
-    *Control |= EFI_SERIAL_OUTPUT_BUFFER_EMPTY;
     *Control |= EFI_SERIAL_INPUT_BUFFER_EMPTY;
   }
+  if (UsbSerialDevice->WriteBufferLength == 0) {
+    *Control |= EFI_SERIAL_OUTPUT_BUFFER_EMPTY;
+  }
   //
   // check for software loopback enable in UsbSerialDevice->ControlValues
   //
@@ -1383,6 +1738,7 @@ ResetInternal (
   EFI_USB_DEVICE_REQUEST  DevReq;
   UINT8                   ConfigurationValue;
   UINT32                  ReturnValue;
+  EFI_TPL                 Tpl;
 
   DevReq.Request     = FTDI_COMMAND_RESET_PORT;
   DevReq.RequestType = USB_REQ_TYPE_VENDOR;
@@ -1421,6 +1777,58 @@ ResetInternal (
   if (EFI_ERROR (Status)) {
     return EFI_DEVICE_ERROR;
   }
+
+  //
+  // Drop the data the driver still holds as well
+  //
+  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  UsbSerialDevice->DataBufferHead    = UsbSerialDevice->DataBufferTail;
+  UsbSerialDevice->WriteBufferLength = 0;
+  gBS->RestoreTPL (Tpl);
+
+  return Status;
+}
+
+/**
+  Internal function that performs a Usb Control Transfer to set the latency
+  timer of the Usb Serial Device.
+
+  @param  UsbIo[in]                  Usb Io Protocol instance pointer
+  @param  Latency[in]                The latency timer value in milliseconds
+
+  @retval EFI_SUCCESS                The latency timer was set
+  @retval EFI_DEVICE_ERROR           The device is not functioning correctly
+
+**/
+EFI_STATUS
+EFIAPI
+SetLatencyTimerInternal (
+  IN EFI_USB_IO_PROTOCOL  *UsbIo,
+  IN UINT8                Latency
+  )
+{
+  EFI_STATUS              Status;
+  EFI_USB_DEVICE_REQUEST  DevReq;
+  UINT32                  ReturnValue;
+  UINT8                   ConfigurationValue;
+
+  DevReq.Request     = FTDI_COMMAND_SET_LATENCY_TIMER;
+  DevReq.RequestType = USB_REQ_TYPE_VENDOR;
+  DevReq.Value       = Latency;
+  DevReq.Index       = FTDI_PORT_IDENTIFIER;
+  DevReq.Length      = 0; // indicates that this transfer has no data phase
+  Status             = UsbIo->UsbControlTransfer (
+                                UsbIo,
+                                &DevReq,
+                                EfiUsbDataOut,
+                                WDR_TIMEOUT,
+                                &ConfigurationValue,
+                                1,
+                                &ReturnValue
+                                );
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
   return Status;
 }
 
@@ -1881,6 +2289,9 @@ UsbSerialDriverBindingStart (
     Status = EFI_UNSUPPORTED;
     goto ErrorExit;
   }
+
+  UsbSerialDevice->SerialIo.Mode = &UsbSerialDevice->SerialIoMode;
+
   //
   // set the initial values of UsbSerialDevice->LastSettings to the default
   // values
@@ -1888,7 +2299,7 @@ UsbSerialDriverBindingStart (
   UsbSerialDevice->LastSettings.BaudRate         = 115200;
   UsbSerialDevice->LastSettings.DataBits         = 8;
   UsbSerialDevice->LastSettings.Parity           = NoParity;
-  UsbSerialDevice->LastSettings.ReceiveFifoDepth = FTDI_MAX_RECEIVE_FIFO_DEPTH;
+  UsbSerialDevice->LastSettings.ReceiveFifoDepth = SW_FIFO_DEPTH;
   UsbSerialDevice->LastSettings.StopBits         = OneStopBit;
   UsbSerialDevice->LastSettings.Timeout          = FTDI_TIMEOUT;
 
@@ -1936,6 +2347,16 @@ UsbSerialDriverBindingStart (
 
   ASSERT_EFI_ERROR (Status);
 
+  //
+  // Have the device return data after FTDI_LATENCY_TIMER ms rather than after
+  // the default 16 ms, so each poll drains its FIFO quickly. Failing to do so
+  // only costs latency.
+  //
+  Status = SetLatencyTimerInternal (UsbSerialDevice->UsbIo, FTDI_LATENCY_TIMER);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "FtdiUsbSerial: failed to set the latency timer - %r\n", Status));
+  }
+
   //
   // Publish Serial GUID and protocol
   //
@@ -1963,18 +2384,6 @@ UsbSerialDriverBindingStart (
   UsbSerialDevice->ControllerHandle = NULL;
   FlowControl                       = NULL;
 
-  //
-  // Allocate space for the receive buffer
-  //
-  UsbSerialDevice->DataBuffer = AllocateZeroPool (SW_FIFO_DEPTH);
-
-  //
-  // Initialize data buffer pointers.
-  // Head==Tail = true means buffer is empty.
-  //
-  UsbSerialDevice->DataBufferHead = 0;
-  UsbSerialDevice->DataBufferTail = 0;
-
   UsbSerialDevice->ControllerNameTable = NULL;
   AddUnicodeString2 (
     "eng",
@@ -1995,7 +2404,9 @@ UsbSerialDriverBindingStart (
   ASSERT_EFI_ERROR (Status);
 
   //
-  // Create a polling loop to check for input
+  // Create a polling loop to check for input. UsbIo has no asynchronous bulk
+  // transfers, so the receive FIFO is kept filled by polling the device well
+  // within the time its own FIFO takes to fill at high baud rates.
   //
 
   gBS->CreateEvent (
@@ -2005,14 +2416,33 @@ UsbSerialDriverBindingStart (
          UsbSerialDevice,
          &(UsbSerialDevice->PollingLoop)
          );
+  UsbSerialDevice->PollInterval = FTDI_POLL_INTERVAL;
+  gBS->SetTimer (
+         UsbSerialDevice->PollingLoop,
+         TimerPeriodic,
+         EFI_TIMER_PERIOD_MILLISECONDS (FTDI_POLL_INTERVAL)
+         );
+
   //
-  // add code to set trigger time based on baud rate
-  // setting to 0.5s for now
+  // Publish the transfer statistics for the shell
   //
+  UnicodeSPrint (
+    UsbSerialDevice->StatisticsVariableName,
+    sizeof (UsbSerialDevice->StatisticsVariableName),
+    L"FtdiUsbSerial%d",
+    mUsbSerialInstance++
+    );
+  gBS->CreateEvent (
+         EVT_TIMER | EVT_NOTIFY_SIGNAL,
+         TPL_CALLBACK,
+         UsbSerialDriverUpdateStatistics,
+         UsbSerialDevice,
+         &(UsbSerialDevice->StatisticsTimer)
+         );
   gBS->SetTimer (
-         UsbSerialDevice->PollingLoop,
+         UsbSerialDevice->StatisticsTimer,
          TimerPeriodic,
-         EFI_TIMER_PERIOD_MILLISECONDS (500)
+         EFI_TIMER_PERIOD_MILLISECONDS (FTDI_STATISTICS_INTERVAL)
          );
 
   //
@@ -2101,7 +2531,15 @@ ErrorExit:
     goto ErrorExit1;
   }
 
-  FreePool (UsbSerialDevice->DataBuffer);
+  if (UsbSerialDevice->PollingLoop != NULL) {
+    gBS->CloseEvent (UsbSerialDevice->PollingLoop);
+  }
+  if (UsbSerialDevice->StatisticsTimer != NULL) {
+    gBS->CloseEvent (UsbSerialDevice->StatisticsTimer);
+  }
+  if (UsbSerialDevice->DataBuffer != NULL) {
+    FreePool (UsbSerialDevice->DataBuffer);
+  }
   FreePool (UsbSerialDevice);
 
   UsbSerialDevice = NULL;
@@ -2218,6 +2656,18 @@ UsbSerialDriverBindingStop (
                0
                );
         gBS->CloseEvent (UsbSerialDevice->PollingLoop);
+        gBS->CloseEvent (UsbSerialDevice->StatisticsTimer);
+        gRT->SetVariable (
+               UsbSerialDevice->StatisticsVariableName,
+               &gFtdiUsbSerialStatisticsGuid,
+               0,
+               0,
+               NULL
+               );
+        //
+        // Send what is left of the coalesced writes before going away
+        //
+        FlushWriteBuffer (UsbSerialDevice);
         UsbSerialDevice->Shutdown = TRUE;
         FreeUnicodeStringTable (UsbSerialDevice->ControllerNameTable);
         FreePool (UsbSerialDevice->DataBuffer);
@@ -2462,7 +2912,6 @@ ReadSerialIo (
   )
 {
   UINTN        Index;
-  UINTN        RemainingCallerBufferSize;
   USB_SER_DEV  *UsbSerialDevice;
   EFI_STATUS   Status;
 
@@ -2481,17 +2930,7 @@ ReadSerialIo (
   //
   // Clear out any data that we already have in our internal buffer
   //
-  for (Index = 0; Index < *BufferSize; Index++) {
-    if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
-      break;
-    }
-
-    //
-    // Still have characters in the buffer to return
-    //
-    ((UINT8 *)Buffer)[Index] = UsbSerialDevice->DataBuffer[UsbSerialDevice->DataBufferHead];
-    UsbSerialDevice->DataBufferHead = (UsbSerialDevice->DataBufferHead + 1) % SW_FIFO_DEPTH;
-  }
+  Index = ReadDataFromFifo (UsbSerialDevice, *BufferSize, Buffer);
 
   //
   // If we haven't filled the caller's buffer using data that we already had on
@@ -2499,17 +2938,15 @@ ReadSerialIo (
   // caller's buffer
   //
   if (Index != *BufferSize) {
-    RemainingCallerBufferSize = *BufferSize - Index;
-    Status = ReadDataFromUsb (
-               UsbSerialDevice,
-               &RemainingCallerBufferSize,
-               (VOID *)(((CHAR8 *)Buffer) + Index)
-               );
+    Status = ReadDataFromUsb (UsbSerialDevice);
     if (!EFI_ERROR (Status)) {
-      *BufferSize = RemainingCallerBufferSize + Index;
-    } else {
-      *BufferSize = Index;
+      Index += ReadDataFromFifo (
+                 UsbSerialDevice,
+                 *BufferSize - Index,
+                 ((UINT8 *) Buffer) + Index
+                 );
     }
+    *BufferSize = Index;
   }
 
   if (UsbSerialDevice->DataBufferHead == UsbSerialDevice->DataBufferTail) {
@@ -2550,6 +2987,8 @@ WriteSerialIo (
   EFI_STATUS   Status;
   USB_SER_DEV  *UsbSerialDevice;
   EFI_TPL      Tpl;
+  EFI_TPL      NotifyTpl;
+  BOOLEAN      Queued;
 
   UsbSerialDevice = USB_SER_DEV_FROM_THIS (This);
 
@@ -2557,15 +2996,57 @@ WriteSerialIo (
     return EFI_DEVICE_ERROR;
   }
 
-  Tpl = gBS->RaiseTPL (TPL_NOTIFY);
+  Tpl = RaiseTplToCallback ();
 
-  Status = UsbSerialDataTransfer (
-             UsbSerialDevice,
-             EfiUsbDataOut,
-             Buffer,
-             BufferSize,
-             FTDI_TIMEOUT
-             );
+  //
+  // Small writes are coalesced and sent by the next poll; make room first if
+  // this one does not fit, and send large writes straight away. The buffer
+  // is appended to at TPL_NOTIFY as a flush may be waiting for the device.
+  //
+  Status = EFI_SUCCESS;
+  if (UsbSerialDevice->WriteBufferLength + *BufferSize > FTDI_WRITE_BUFFER_SIZE) {
+    Status = FlushWriteBuffer (UsbSerialDevice);
+  }
+
+  NotifyTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  Queued    = (BOOLEAN) (!EFI_ERROR (Status) &&
+                         *BufferSize <= FTDI_WRITE_BUFFER_SIZE - UsbSerialDevice->WriteBufferLength);
+  if (Queued) {
+    CopyMem (
+      &UsbSerialDevice->WriteBuffer[UsbSerialDevice->WriteBufferLength],
+      Buffer,
+      *BufferSize
+      );
+    UsbSerialDevice->WriteBufferLength += *BufferSize;
+  }
+  gBS->RestoreTPL (NotifyTpl);
+
+  if (EFI_ERROR (Status)) {
+    *BufferSize = 0;
+  } else if (Queued) {
+    //
+    // Don't let an idle poll interval hold the write back
+    //
+    SetPollInterval (UsbSerialDevice, FTDI_POLL_INTERVAL);
+  } else if (UsbSerialDevice->WriteBufferLength == 0 && !UsbSerialDevice->Flushing) {
+    Status = UsbSerialDataTransfer (
+               UsbSerialDevice,
+               EfiUsbDataOut,
+               Buffer,
+               BufferSize,
+               FTDI_TIMEOUT
+               );
+    if (!EFI_ERROR (Status)) {
+      UsbSerialDevice->Statistics.TxTransfers++;
+      UsbSerialDevice->Statistics.TxBytes += *BufferSize;
+    }
+  } else {
+    //
+    // The device did not take all of the buffered data, don't reorder
+    //
+    *BufferSize = 0;
+    Status      = EFI_TIMEOUT;
+  }
 
   gBS->RestoreTPL (Tpl);
   if (EFI_ERROR (Status)) {
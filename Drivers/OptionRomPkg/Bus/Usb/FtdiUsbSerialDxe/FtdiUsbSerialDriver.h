@@ -10,12 +10,17 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #ifndef _FTDI_USB_SERIAL_DRIVER_H_
 #define _FTDI_USB_SERIAL_DRIVER_H_
 
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include <Guid/FtdiUsbSerialStatistics.h>
 
 #include <Protocol/DevicePath.h>
 #include <Protocol/UsbIo.h>
@@ -131,6 +136,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define SET_RTS_HIGH                     (BIT9 | BIT1)
 #define SET_RTS_LOW                      (BIT9)
 
+//
+// SET_LATENCY_TIMER
+// The device returns a short packet once this many milliseconds have passed
+// since the last bulk-in, whether or not its FIFO is full.
+//
+#define FTDI_LATENCY_TIMER               2
+
 //
 // MODEM_STATUS
 //
@@ -140,6 +152,16 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define SD_MASK                          BIT7
 #define MSR_MASK                         (CTS_MASK | DSR_MASK | RI_MASK | SD_MASK)
 
+//
+// LINE_STATUS
+//
+#define OE_MASK                          BIT1
+
+//
+// Every bulk-in packet starts with the modem status and line status bytes
+//
+#define FTDI_STATUS_SIZE                 2
+
 //
 // Macro used to check for USB transfer errors
 //
@@ -156,11 +178,6 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 //
 #define FTDI_TIMEOUT       16
 
-//
-// FTDI FIFO depth
-//
-#define FTDI_MAX_RECEIVE_FIFO_DEPTH  384
-
 //
 // FTDI Endpoint Descriptors
 //
@@ -168,9 +185,39 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define FTDI_ENDPOINT_ADDRESS_OUT  0x02 //the endpoint address for the out endpoint generated by the device
 
 //
-// Max buffer size for USB transfers
+// Software receive FIFO depth. SW_FIFO_DEPTH is used when ReceiveFifoDepth is
+// 0, other requests are rounded up to a power of two within the limits.
+//
+#define SW_FIFO_DEPTH      8192
+#define SW_FIFO_MIN_DEPTH  64
+#define SW_FIFO_MAX_DEPTH  0x10000
+
+//
+// Buffer sizes for a single bulk-in transfer and for coalescing writes
+//
+#define FTDI_READ_BUFFER_SIZE   4096
+#define FTDI_WRITE_BUFFER_SIZE  512
+
+//
+// Bulk-in transfers issued by one poll before giving up the CPU
+//
+#define FTDI_MAX_READS_PER_POLL  8
+
+//
+// Receive poll interval in ms, also bounds how long writes stay coalesced
+//
+#define FTDI_POLL_INTERVAL  2
+
+//
+// Longest poll interval in ms. The interval doubles on every poll that finds
+// the device idle and drops back to FTDI_POLL_INTERVAL once data moves.
+//
+#define FTDI_POLL_INTERVAL_MAX  64
+
+//
+// Interval in ms between two updates of the statistics variable
 //
-#define SW_FIFO_DEPTH 1024
+#define FTDI_STATISTICS_INTERVAL  1000
 
 //
 // struct to define a usb device as a vendor and product id pair
@@ -234,17 +281,39 @@ typedef struct {
   EFI_USB_ENDPOINT_DESCRIPTOR   InEndpointDescriptor;
   EFI_USB_ENDPOINT_DESCRIPTOR   OutEndpointDescriptor;
   EFI_UNICODE_STRING_TABLE      *ControllerNameTable;
-  UINT32                        DataBufferHead;
-  UINT32                        DataBufferTail;
+  //
+  // Receive FIFO. The indices run freely and are masked with
+  // DataBufferSize - 1; only ReadDataFromUsb() moves the tail, at
+  // TPL_NOTIFY, and only the consumer moves the head, so reading does not
+  // need to raise the TPL.
+  //
+  volatile UINT32               DataBufferHead;
+  volatile UINT32               DataBufferTail;
+  UINT32                        DataBufferSize;
   UINT8                         *DataBuffer;
   EFI_SERIAL_IO_PROTOCOL        SerialIo;
+  EFI_SERIAL_IO_MODE            SerialIoMode;
   BOOLEAN                       Shutdown;
   EFI_EVENT                     PollingLoop;
+  UINTN                         PollInterval;
+  EFI_EVENT                     StatisticsTimer;
   UINT32                        ControlBits;
   PREVIOUS_ATTRIBUTES           LastSettings;
   CONTROL_BITS                  ControlValues;
   STATUS_BITS                   StatusValues;
-  UINT8                         ReadBuffer[512];
+  //
+  // Set while a read or a flush waits for the device at TPL_CALLBACK, so a
+  // caller running at a higher TPL does not start another one meanwhile
+  //
+  BOOLEAN                       Reading;
+  BOOLEAN                       Flushing;
+  UINT8                         ReadBuffer[FTDI_READ_BUFFER_SIZE];
+  UINTN                         WriteBufferLength;
+  UINT8                         WriteBuffer[FTDI_WRITE_BUFFER_SIZE];
+  FTDI_USB_SERIAL_STATISTICS    Statistics;
+  UINT64                        LastRxBytes;
+  UINT64                        LastTxBytes;
+  CHAR16                        StatisticsVariableName[32];
 } USB_SER_DEV;
 
 #define USB_SER_DEV_FROM_THIS(a) \
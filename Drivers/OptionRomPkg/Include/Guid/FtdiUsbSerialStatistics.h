@@ -0,0 +1,34 @@
+/** @file
+  Transfer statistics published by the FTDI USB Serial driver.
+
+  Each serial device started by the driver publishes a volatile variable
+  named L"FtdiUsbSerial<n>" under this GUID, so the counters can be read from
+  the shell with "dmpstore -guid". The variable is refreshed once per second
+  and deleted when the device is stopped.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __FTDI_USB_SERIAL_STATISTICS_H__
+#define __FTDI_USB_SERIAL_STATISTICS_H__
+
+#define FTDI_USB_SERIAL_STATISTICS_GUID \
+  { \
+    0x0fb9ce0f, 0x26f7, 0x42b2, { 0x98, 0x32, 0x86, 0xaf, 0xba, 0x7f, 0x16, 0xe8 } \
+  }
+
+typedef struct {
+  UINT64  RxBytes;            ///< Payload bytes received from the device
+  UINT64  TxBytes;            ///< Payload bytes sent to the device
+  UINT64  RxTransfers;        ///< Bulk-in transfers completed
+  UINT64  TxTransfers;        ///< Bulk-out transfers completed
+  UINT64  RxOverruns;         ///< Packets whose line status reported an overrun
+  UINT32  RxBytesPerSecond;   ///< Receive throughput over the last second
+  UINT32  TxBytesPerSecond;   ///< Transmit throughput over the last second
+} FTDI_USB_SERIAL_STATISTICS;
+
+extern EFI_GUID  gFtdiUsbSerialStatisticsGuid;
+
+#endif
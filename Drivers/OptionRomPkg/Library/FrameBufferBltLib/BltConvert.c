@@ -0,0 +1,92 @@
+/** @file
+  Portable pixel conversion routines of FrameBufferBltLib.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "PiDxe.h"
+#include "FrameBufferBltLibInternal.h"
+
+/**
+  Converts pixels between the BGRX layout of EFI_GRAPHICS_OUTPUT_BLT_PIXEL and
+  the RGBX layout by swapping the red and blue bytes. The reserved byte of the
+  result is cleared.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltSwapRedBlue32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  )
+{
+  UINT32  Pixel;
+
+  while (Count-- > 0) {
+    Pixel = *Source++;
+    *Destination++ = (Pixel & 0x0000ff00) |
+                     ((Pixel << 16) & 0x00ff0000) |
+                     ((Pixel >> 16) & 0x000000ff);
+  }
+}
+
+/**
+  Converts BGRX pixels to the 16 bit 5:6:5 RGB layout, dropping the low bits
+  of each color.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltBgrxToRgb565 (
+  OUT UINT16        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  )
+{
+  UINT32  Pixel;
+
+  while (Count-- > 0) {
+    Pixel = *Source++;
+    *Destination++ = (UINT16) (((Pixel >> 8) & 0xf800) |
+                               ((Pixel >> 5) & 0x07e0) |
+                               ((Pixel >> 3) & 0x001f));
+  }
+}
+
+/**
+  Converts 16 bit 5:6:5 RGB pixels to the BGRX layout. The low bits of each
+  color and the reserved byte of the result are cleared.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltRgb565ToBgrx (
+  OUT UINT32        *Destination,
+  IN  CONST UINT16  *Source,
+  IN  UINTN         Count
+  )
+{
+  UINT32  Pixel;
+
+  while (Count-- > 0) {
+    Pixel = *Source++;
+    *Destination++ = ((Pixel & 0xf800) << 8) |
+                     ((Pixel & 0x07e0) << 5) |
+                     ((Pixel & 0x001f) << 3);
+  }
+}
@@ -12,6 +12,8 @@
 #include <Library/BltLib.h>
 #include <Library/DebugLib.h>
 
+#include "FrameBufferBltLibInternal.h"
+
 #if 0
 #define VDEBUG DEBUG
 #else
@@ -20,6 +22,17 @@
 
 #define MAX_LINE_BUFFER_SIZE (SIZE_4KB * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL))
 
+//
+// How pixels are converted between EFI_GRAPHICS_OUTPUT_BLT_PIXEL and the
+// frame buffer. Everything but BltConvertGeneric has a dedicated routine.
+//
+typedef enum {
+  BltConvertNone,           // BGRX, same layout as EFI_GRAPHICS_OUTPUT_BLT_PIXEL
+  BltConvertSwapRedBlue,    // RGBX
+  BltConvertRgb565,         // 16 bit 5:6:5 RGB
+  BltConvertGeneric         // Any other bit mask, converted with mPixelShl/Shr
+} BLT_LIB_CONVERSION;
+
 UINTN                           mBltLibColorDepth;
 UINTN                           mBltLibWidthInBytes;
 UINTN                           mBltLibBytesPerPixel;
@@ -31,6 +44,7 @@ EFI_GRAPHICS_PIXEL_FORMAT       mPixelFormat;
 EFI_PIXEL_BITMASK               mPixelBitMasks;
 INTN                            mPixelShl[4]; // R-G-B-Rsvd
 INTN                            mPixelShr[4]; // R-G-B-Rsvd
+BLT_LIB_CONVERSION              mBltLibConversion;
 
 
 VOID
@@ -65,6 +79,27 @@ ConfigurePixelBitMaskFormat (
   DEBUG ((EFI_D_INFO, "Bytes per pixel: %d\n", mBltLibBytesPerPixel));
 
   CopyMem (&mPixelBitMasks, BitMask, sizeof (*BitMask));
+
+  if ((mBltLibBytesPerPixel == sizeof (UINT32)) &&
+      (BitMask->RedMask == 0x00ff0000) &&
+      (BitMask->GreenMask == 0x0000ff00) &&
+      (BitMask->BlueMask == 0x000000ff)) {
+    mBltLibConversion = BltConvertNone;
+  } else if ((mBltLibBytesPerPixel == sizeof (UINT32)) &&
+             (BitMask->RedMask == 0x000000ff) &&
+             (BitMask->GreenMask == 0x0000ff00) &&
+             (BitMask->BlueMask == 0x00ff0000)) {
+    mBltLibConversion = BltConvertSwapRedBlue;
+  } else if ((mBltLibBytesPerPixel == sizeof (UINT16)) &&
+             (BitMask->RedMask == 0xf800) &&
+             (BitMask->GreenMask == 0x07e0) &&
+             (BitMask->BlueMask == 0x001f)) {
+    mBltLibConversion = BltConvertRgb565;
+  } else {
+    mBltLibConversion = BltConvertGeneric;
+  }
+
+  DEBUG ((EFI_D_INFO, "Pixel conversion: %d\n", mBltLibConversion));
 }
 
 
@@ -304,12 +339,17 @@ BltLibVideoFill (
     Offset = mBltLibBytesPerPixel * Offset;
     BltMemDst = (VOID*) (mBltLibFrameBuffer + Offset);
     SizeInBytes = WidthInBytes * Height;
-    if (SizeInBytes >= 8) {
-      SetMem32 (BltMemDst, SizeInBytes & ~3, (UINT32) WideFill);
-      SizeInBytes = SizeInBytes & 3;
-    }
-    if (SizeInBytes > 0) {
-      SetMem (BltMemDst, SizeInBytes, (UINT8)(UINTN) WideFill);
+    //
+    // Fill in units of a pixel, so neither the alignment of the first
+    // pixel nor the size of the area matters. Wide fills of other pixel
+    // sizes have the same value in every byte.
+    //
+    if (mBltLibBytesPerPixel == sizeof (UINT32)) {
+      SetMem32 (BltMemDst, SizeInBytes, (UINT32) WideFill);
+    } else if (mBltLibBytesPerPixel == sizeof (UINT16)) {
+      SetMem16 (BltMemDst, SizeInBytes, (UINT16) WideFill);
+    } else {
+      SetMem (BltMemDst, SizeInBytes, (UINT8) WideFill);
     }
   } else {
     LineBufferReady = FALSE;
@@ -318,11 +358,22 @@ BltLibVideoFill (
       Offset = mBltLibBytesPerPixel * Offset;
       BltMemDst = (VOID*) (mBltLibFrameBuffer + Offset);
 
-      if (UseWideFill && (((UINTN) BltMemDst & 7) == 0)) {
+      //
+      // 32 and 16 bit pixels are always naturally aligned, so the row can be
+      // handed to the (possibly SIMD optimized) BaseMemoryLib in one call.
+      //
+      if (mBltLibBytesPerPixel == sizeof (UINT32)) {
+        VDEBUG ((EFI_D_INFO, "VideoFill (32 bit)\n"));
+        SetMem32 (BltMemDst, WidthInBytes, (UINT32) WideFill);
+      } else if (mBltLibBytesPerPixel == sizeof (UINT16)) {
+        VDEBUG ((EFI_D_INFO, "VideoFill (16 bit)\n"));
+        SetMem16 (BltMemDst, WidthInBytes, (UINT16) WideFill);
+      } else if (UseWideFill && (((UINTN) BltMemDst & 7) == 0)) {
         VDEBUG ((EFI_D_INFO, "VideoFill (wide)\n"));
         SizeInBytes = WidthInBytes;
         if (SizeInBytes >= 8) {
           SetMem64 (BltMemDst, SizeInBytes & ~7, WideFill);
+          BltMemDst = (UINT8 *) BltMemDst + (SizeInBytes & ~7);
           SizeInBytes = SizeInBytes & 7;
         }
         if (SizeInBytes > 0) {
@@ -463,21 +514,31 @@ BltLibVideoToBltBufferEx (
     Offset = (SrcY * mBltLibWidthInPixels) + SourceX;
     Offset = mBltLibBytesPerPixel * Offset;
     BltMemSrc = (VOID *) (mBltLibFrameBuffer + Offset);
-
-    if (mPixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
-      BltMemDst =
-        (VOID *) (
-            (UINT8 *) BltBuffer +
-            (DstY * Delta) +
-            (DestinationX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL))
-          );
-    } else {
-      BltMemDst = (VOID *) mBltLibLineBuffer;
+    BltMemDst =
+      (VOID *) (
+          (UINT8 *) BltBuffer +
+          (DstY * Delta) +
+          (DestinationX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL))
+        );
+
+    if (mBltLibConversion == BltConvertNone) {
+      CopyMem (BltMemDst, BltMemSrc, WidthInBytes);
+      continue;
     }
 
-    CopyMem (BltMemDst, BltMemSrc, WidthInBytes);
-
-    if (mPixelFormat != PixelBlueGreenRedReserved8BitPerColor) {
+    //
+    // Read the row with one bulk copy, frame buffer reads are slow
+    //
+    CopyMem (mBltLibLineBuffer, BltMemSrc, WidthInBytes);
+
+    switch (mBltLibConversion) {
+    case BltConvertSwapRedBlue:
+      InternalBltSwapRedBlue32 ((UINT32 *) BltMemDst, (UINT32 *) mBltLibLineBuffer, Width);
+      break;
+    case BltConvertRgb565:
+      InternalBltRgb565ToBgrx ((UINT32 *) BltMemDst, (UINT16 *) mBltLibLineBuffer, Width);
+      break;
+    default:
       for (X = 0; X < Width; X++) {
         Blt         = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (DstY * Delta) + (DestinationX + X) * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
         Uint32 = *(UINT32*) (mBltLibLineBuffer + (X * mBltLibBytesPerPixel));
@@ -488,6 +549,7 @@ BltLibVideoToBltBufferEx (
               (((Uint32 & mPixelBitMasks.BlueMask)  >> mPixelShl[2]) << mPixelShr[2])
             );
       }
+      break;
     }
   }
 
@@ -604,10 +666,28 @@ BltLibBufferToVideoEx (
     Offset = (DstY * mBltLibWidthInPixels) + DestinationX;
     Offset = mBltLibBytesPerPixel * Offset;
     BltMemDst = (VOID*) (mBltLibFrameBuffer + Offset);
-
-    if (mPixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
-      BltMemSrc = (VOID *) ((UINT8 *) BltBuffer + (SrcY * Delta));
-    } else {
+    BltMemSrc =
+      (VOID *) (
+          (UINT8 *) BltBuffer +
+          (SrcY * Delta) +
+          (SourceX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL))
+        );
+
+    switch (mBltLibConversion) {
+    case BltConvertNone:
+      CopyMem (BltMemDst, BltMemSrc, WidthInBytes);
+      break;
+    case BltConvertSwapRedBlue:
+      InternalBltSwapRedBlue32 ((UINT32 *) BltMemDst, (UINT32 *) BltMemSrc, Width);
+      break;
+    case BltConvertRgb565:
+      InternalBltBgrxToRgb565 ((UINT16 *) BltMemDst, (UINT32 *) BltMemSrc, Width);
+      break;
+    default:
+      //
+      // The generic conversion stores 32 bits per pixel, so build the row in
+      // the line buffer to avoid writing past its end in the frame buffer.
+      //
       for (X = 0; X < Width; X++) {
         Blt =
           (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) (
@@ -623,10 +703,9 @@ BltLibBufferToVideoEx (
               (((Uint32 << mPixelShl[2]) >> mPixelShr[2]) & mPixelBitMasks.BlueMask)
             );
       }
-      BltMemSrc = (VOID *) mBltLibLineBuffer;
+      CopyMem (BltMemDst, mBltLibLineBuffer, WidthInBytes);
+      break;
     }
-
-    CopyMem (BltMemDst, BltMemSrc, WidthInBytes);
   }
 
   return EFI_SUCCESS;
@@ -0,0 +1,67 @@
+/** @file
+  Internal pixel conversion routines of FrameBufferBltLib.
+
+  X64 and AARCH64 implement them with SSE2 and NEON, the other architectures
+  use the portable versions in BltConvert.c.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __FRAME_BUFFER_BLT_LIB_INTERNAL__
+#define __FRAME_BUFFER_BLT_LIB_INTERNAL__
+
+/**
+  Converts pixels between the BGRX layout of EFI_GRAPHICS_OUTPUT_BLT_PIXEL and
+  the RGBX layout by swapping the red and blue bytes. The reserved byte of the
+  result is cleared.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltSwapRedBlue32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+/**
+  Converts BGRX pixels to the 16 bit 5:6:5 RGB layout, dropping the low bits
+  of each color.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltBgrxToRgb565 (
+  OUT UINT16        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+/**
+  Converts 16 bit 5:6:5 RGB pixels to the BGRX layout. The low bits of each
+  color and the reserved byte of the result are cleared.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+InternalBltRgb565ToBgrx (
+  OUT UINT32        *Destination,
+  IN  CONST UINT16  *Source,
+  IN  UINTN         Count
+  );
+
+#endif
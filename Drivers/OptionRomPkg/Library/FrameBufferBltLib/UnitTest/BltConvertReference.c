@@ -0,0 +1,13 @@
+/** @file
+  Builds BltConvert.c under the names declared in BltConvertReference.h.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#define InternalBltSwapRedBlue32  ReferenceBltSwapRedBlue32
+#define InternalBltBgrxToRgb565   ReferenceBltBgrxToRgb565
+#define InternalBltRgb565ToBgrx   ReferenceBltRgb565ToBgrx
+
+#include "../BltConvert.c"
@@ -0,0 +1,62 @@
+/** @file
+  The portable pixel conversion routines of FrameBufferBltLib, built under
+  other names so the host tests can compare them with the routines the
+  library uses, which are SSE2 on X64 and NEON on AARCH64.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __BLT_CONVERT_REFERENCE__
+#define __BLT_CONVERT_REFERENCE__
+
+/**
+  BltConvert.c version of InternalBltSwapRedBlue32.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+ReferenceBltSwapRedBlue32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+/**
+  BltConvert.c version of InternalBltBgrxToRgb565.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+ReferenceBltBgrxToRgb565 (
+  OUT UINT16        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+/**
+  BltConvert.c version of InternalBltRgb565ToBgrx.
+
+  @param[out] Destination  Pointer to the converted pixels
+  @param[in]  Source       Pointer to the pixels to convert
+  @param[in]  Count        Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+ReferenceBltRgb565ToBgrx (
+  OUT UINT32        *Destination,
+  IN  CONST UINT16  *Source,
+  IN  UINTN         Count
+  );
+
+#endif
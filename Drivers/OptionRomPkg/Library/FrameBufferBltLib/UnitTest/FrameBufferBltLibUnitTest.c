@@ -0,0 +1,621 @@
+/** @file
+  Host based unit tests for FrameBufferBltLib.
+
+  The pixel conversion routines the library is built with (SSE2 on X64, NEON
+  on AARCH64) are compared with the portable ones in BltConvert.c, for every
+  count up to a few vector widths so each row tail is covered. Fills and
+  copies to and from an RGBX, BGRX and 5:6:5 frame buffer are then checked
+  pixel by pixel against the same portable routines, and with a 24 bit frame
+  buffer, which takes the generic path.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiDxe.h>
+#include <Library/UnitTestLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BltLib.h>
+#include <Library/DebugLib.h>
+
+#include "../FrameBufferBltLibInternal.h"
+#include "BltConvertReference.h"
+
+#define UNIT_TEST_NAME     "FrameBufferBltLib Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Counts up to a few times the widest vector loop (16 pixels on AARCH64)
+//
+#define BLT_TEST_MAX_COUNT  69
+
+//
+// Guard pixels after the converted ones, which must be left alone
+//
+#define BLT_TEST_GUARD      8
+
+//
+// An odd sized screen, so rows end in a partial vector
+//
+#define BLT_TEST_WIDTH      37
+#define BLT_TEST_HEIGHT     7
+
+typedef struct {
+  CHAR8                      *Name;
+  EFI_GRAPHICS_PIXEL_FORMAT  PixelFormat;
+  EFI_PIXEL_BITMASK          PixelInformation;
+  UINTN                      BytesPerPixel;
+} BLT_TEST_FORMAT;
+
+STATIC BLT_TEST_FORMAT  mRgbx = {
+  "RGBX", PixelRedGreenBlueReserved8BitPerColor, { 0, 0, 0, 0 }, 4
+};
+
+STATIC BLT_TEST_FORMAT  mBgrx = {
+  "BGRX", PixelBlueGreenRedReserved8BitPerColor, { 0, 0, 0, 0 }, 4
+};
+
+STATIC BLT_TEST_FORMAT  mRgb565 = {
+  "RGB565", PixelBitMask, { 0xf800, 0x07e0, 0x001f, 0 }, 2
+};
+
+STATIC BLT_TEST_FORMAT  mBgr888 = {
+  "BGR888", PixelBitMask, { 0x00ff0000, 0x0000ff00, 0x000000ff, 0 }, 3
+};
+
+//
+// Rectangles of the fill and copy tests: full rows (one shot fills), single
+// pixels at both edges and widths around the vector sizes
+//
+typedef struct {
+  UINTN  X;
+  UINTN  Y;
+  UINTN  Width;
+  UINTN  Height;
+} BLT_TEST_RECT;
+
+STATIC CONST BLT_TEST_RECT  mRects[] = {
+  { 0,  0,  BLT_TEST_WIDTH, BLT_TEST_HEIGHT },
+  { 0,  2,  BLT_TEST_WIDTH, 3               },
+  { 0,  1,  1,              1               },
+  { 36, 6,  1,              1               },
+  { 1,  1,  3,              2               },
+  { 3,  0,  17,             4               },
+  { 5,  3,  32,             4               },
+  { 2,  1,  35,             5               },
+  { 20, 2,  15,             1               }
+};
+
+STATIC UINT32  mSeed;
+
+STATIC UINT32  mSource[BLT_TEST_MAX_COUNT + 1];
+STATIC UINT32  mResult[BLT_TEST_MAX_COUNT + 1 + BLT_TEST_GUARD];
+STATIC UINT32  mExpected[BLT_TEST_MAX_COUNT + 1 + BLT_TEST_GUARD];
+
+STATIC UINT32                         mFrameBuffer[BLT_TEST_WIDTH * BLT_TEST_HEIGHT];
+STATIC UINT32                         mExpectedFrameBuffer[BLT_TEST_WIDTH * BLT_TEST_HEIGHT];
+STATIC EFI_GRAPHICS_OUTPUT_BLT_PIXEL  mBltBuffer[BLT_TEST_WIDTH * BLT_TEST_HEIGHT];
+STATIC EFI_GRAPHICS_OUTPUT_BLT_PIXEL  mExpectedBltBuffer[BLT_TEST_WIDTH * BLT_TEST_HEIGHT];
+
+/**
+  Returns the next value of a fixed pseudo random sequence, so a failure
+  repeats from run to run.
+
+  @return A pseudo random number.
+
+**/
+STATIC
+UINT32
+BltTestRandom (
+  VOID
+  )
+{
+  mSeed = mSeed * 1103515245 + 12345;
+  return (mSeed >> 16) | (mSeed << 16);
+}
+
+/**
+  Fills a buffer with pseudo random bytes.
+
+  @param[out] Buffer  The buffer to fill.
+  @param[in]  Size    The size of Buffer in bytes.
+
+**/
+STATIC
+VOID
+BltTestFill (
+  OUT VOID   *Buffer,
+  IN  UINTN  Size
+  )
+{
+  UINT8  *Bytes;
+
+  for (Bytes = Buffer; Size > 0; Size--) {
+    *Bytes++ = (UINT8) BltTestRandom ();
+  }
+}
+
+/**
+  Converts pixels to the frame buffer format the way the library should.
+
+  @param[in]  Format       The frame buffer format.
+  @param[out] Destination  Frame buffer pixels.
+  @param[in]  Source       EFI_GRAPHICS_OUTPUT_BLT_PIXEL pixels.
+  @param[in]  Count        Number of pixels to convert.
+
+**/
+STATIC
+VOID
+BltTestToVideo (
+  IN  BLT_TEST_FORMAT  *Format,
+  OUT VOID             *Destination,
+  IN  CONST UINT32     *Source,
+  IN  UINTN            Count
+  )
+{
+  UINTN  Index;
+
+  switch (Format->PixelFormat) {
+  case PixelRedGreenBlueReserved8BitPerColor:
+    ReferenceBltSwapRedBlue32 (Destination, Source, Count);
+    break;
+  case PixelBlueGreenRedReserved8BitPerColor:
+    CopyMem (Destination, Source, Count * sizeof (UINT32));
+    break;
+  default:
+    if (Format->BytesPerPixel == 2) {
+      ReferenceBltBgrxToRgb565 (Destination, Source, Count);
+    } else {
+      for (Index = 0; Index < Count; Index++) {
+        CopyMem ((UINT8 *) Destination + Index * 3, &Source[Index], 3);
+      }
+    }
+    break;
+  }
+}
+
+/**
+  Converts frame buffer pixels to EFI_GRAPHICS_OUTPUT_BLT_PIXEL the way the
+  library should.
+
+  @param[in]  Format       The frame buffer format.
+  @param[out] Destination  EFI_GRAPHICS_OUTPUT_BLT_PIXEL pixels.
+  @param[in]  Source       Frame buffer pixels.
+  @param[in]  Count        Number of pixels to convert.
+
+**/
+STATIC
+VOID
+BltTestFromVideo (
+  IN  BLT_TEST_FORMAT  *Format,
+  OUT UINT32           *Destination,
+  IN  CONST VOID       *Source,
+  IN  UINTN            Count
+  )
+{
+  UINTN  Index;
+
+  switch (Format->PixelFormat) {
+  case PixelRedGreenBlueReserved8BitPerColor:
+    ReferenceBltSwapRedBlue32 (Destination, Source, Count);
+    break;
+  case PixelBlueGreenRedReserved8BitPerColor:
+    CopyMem (Destination, Source, Count * sizeof (UINT32));
+    break;
+  default:
+    if (Format->BytesPerPixel == 2) {
+      ReferenceBltRgb565ToBgrx (Destination, Source, Count);
+    } else {
+      for (Index = 0; Index < Count; Index++) {
+        Destination[Index] = 0;
+        CopyMem (&Destination[Index], (UINT8 *) Source + Index * 3, 3);
+      }
+    }
+    break;
+  }
+}
+
+/**
+  Points the library at mFrameBuffer, in the given format.
+
+  @param[in]  Format  The frame buffer format.
+
+  @return Result of BltLibConfigure.
+
+**/
+STATIC
+EFI_STATUS
+BltTestConfigure (
+  IN BLT_TEST_FORMAT  *Format
+  )
+{
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  Info;
+
+  ZeroMem (&Info, sizeof (Info));
+  Info.HorizontalResolution = BLT_TEST_WIDTH;
+  Info.VerticalResolution   = BLT_TEST_HEIGHT;
+  Info.PixelFormat          = Format->PixelFormat;
+  Info.PixelInformation     = Format->PixelInformation;
+  Info.PixelsPerScanLine    = BLT_TEST_WIDTH;
+  return BltLibConfigure (mFrameBuffer, &Info);
+}
+
+/**
+  Compares InternalBltSwapRedBlue32 with the BltConvert.c version, for every
+  count up to BLT_TEST_MAX_COUNT and both 16 byte aligned and unaligned
+  buffers.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestSwapRedBlue32 (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Count;
+  UINTN  Offset;
+
+  mSeed = 1;
+  for (Offset = 0; Offset < 2; Offset++) {
+    for (Count = 0; Count <= BLT_TEST_MAX_COUNT - Offset; Count++) {
+      BltTestFill (mSource, sizeof (mSource));
+      SetMem (mResult, sizeof (mResult), 0xA5);
+      SetMem (mExpected, sizeof (mExpected), 0xA5);
+
+      InternalBltSwapRedBlue32 (mResult + Offset, mSource + Offset, Count);
+      ReferenceBltSwapRedBlue32 (mExpected + Offset, mSource + Offset, Count);
+
+      UT_ASSERT_MEM_EQUAL (mResult, mExpected, sizeof (mResult));
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Compares InternalBltBgrxToRgb565 with the BltConvert.c version, for every
+  count up to BLT_TEST_MAX_COUNT and both aligned and unaligned buffers.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestBgrxToRgb565 (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Count;
+  UINTN  Offset;
+
+  mSeed = 2;
+  for (Offset = 0; Offset < 2; Offset++) {
+    for (Count = 0; Count <= BLT_TEST_MAX_COUNT - Offset; Count++) {
+      BltTestFill (mSource, sizeof (mSource));
+      SetMem (mResult, sizeof (mResult), 0xA5);
+      SetMem (mExpected, sizeof (mExpected), 0xA5);
+
+      InternalBltBgrxToRgb565 ((UINT16 *) mResult + Offset, mSource + Offset, Count);
+      ReferenceBltBgrxToRgb565 ((UINT16 *) mExpected + Offset, mSource + Offset, Count);
+
+      UT_ASSERT_MEM_EQUAL (mResult, mExpected, sizeof (mResult));
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Compares InternalBltRgb565ToBgrx with the BltConvert.c version, for every
+  count up to BLT_TEST_MAX_COUNT and both aligned and unaligned buffers.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestRgb565ToBgrx (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Count;
+  UINTN  Offset;
+
+  mSeed = 3;
+  for (Offset = 0; Offset < 2; Offset++) {
+    for (Count = 0; Count <= BLT_TEST_MAX_COUNT - Offset; Count++) {
+      BltTestFill (mSource, sizeof (mSource));
+      SetMem (mResult, sizeof (mResult), 0xA5);
+      SetMem (mExpected, sizeof (mExpected), 0xA5);
+
+      InternalBltRgb565ToBgrx (mResult + Offset, (UINT16 *) mSource + Offset, Count);
+      ReferenceBltRgb565ToBgrx (mExpected + Offset, (UINT16 *) mSource + Offset, Count);
+
+      UT_ASSERT_MEM_EQUAL (mResult, mExpected, sizeof (mResult));
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fills each of mRects with a random color and checks that exactly the
+  pixels of the rectangle changed, to the converted color. Every other color
+  is a gray, whose pixels have the same value in each byte, so the wide fills
+  are used for any pixel size.
+
+  @param[in]  Context  The BLT_TEST_FORMAT of the frame buffer.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestVideoFill (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BLT_TEST_FORMAT  *Format;
+  EFI_STATUS       Status;
+  UINTN            Index;
+  UINTN            X;
+  UINTN            Y;
+  UINT32           Color;
+  UINT32           Pixel;
+
+  Format = (BLT_TEST_FORMAT *) Context;
+  Status = BltTestConfigure (Format);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  mSeed = 4;
+  for (Index = 0; Index < ARRAY_SIZE (mRects); Index++) {
+    BltTestFill (mFrameBuffer, sizeof (mFrameBuffer));
+    CopyMem (mExpectedFrameBuffer, mFrameBuffer, sizeof (mFrameBuffer));
+
+    //
+    // The reserved byte of the color is not meant to reach the frame buffer
+    //
+    Color = BltTestRandom ();
+    if ((Index & 1) != 0) {
+      Color = (Color & 0xff) * 0x01010101;
+    }
+    if (Format->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
+      Pixel = Color & 0x00ffffff;
+    } else {
+      BltTestToVideo (Format, &Pixel, &Color, 1);
+    }
+
+    for (Y = mRects[Index].Y; Y < mRects[Index].Y + mRects[Index].Height; Y++) {
+      for (X = mRects[Index].X; X < mRects[Index].X + mRects[Index].Width; X++) {
+        CopyMem (
+          (UINT8 *) mExpectedFrameBuffer + (Y * BLT_TEST_WIDTH + X) * Format->BytesPerPixel,
+          &Pixel,
+          Format->BytesPerPixel
+          );
+      }
+    }
+
+    Status = BltLibVideoFill (
+               (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) &Color,
+               mRects[Index].X,
+               mRects[Index].Y,
+               mRects[Index].Width,
+               mRects[Index].Height
+               );
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_MEM_EQUAL (mFrameBuffer, mExpectedFrameBuffer, sizeof (mFrameBuffer));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Copies a random BltBuffer to each of mRects, taking the pixels from
+  another position of the BltBuffer, and checks the whole frame buffer.
+
+  @param[in]  Context  The BLT_TEST_FORMAT of the frame buffer.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestBufferToVideo (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BLT_TEST_FORMAT  *Format;
+  EFI_STATUS       Status;
+  UINTN            Index;
+  UINTN            SourceX;
+  UINTN            SourceY;
+  UINTN            Y;
+
+  Format = (BLT_TEST_FORMAT *) Context;
+  Status = BltTestConfigure (Format);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  mSeed = 5;
+  for (Index = 0; Index < ARRAY_SIZE (mRects); Index++) {
+    BltTestFill (mFrameBuffer, sizeof (mFrameBuffer));
+    BltTestFill (mBltBuffer, sizeof (mBltBuffer));
+    CopyMem (mExpectedFrameBuffer, mFrameBuffer, sizeof (mFrameBuffer));
+
+    SourceX = BLT_TEST_WIDTH - mRects[Index].Width;
+    SourceY = BLT_TEST_HEIGHT - mRects[Index].Height;
+    for (Y = 0; Y < mRects[Index].Height; Y++) {
+      BltTestToVideo (
+        Format,
+        (UINT8 *) mExpectedFrameBuffer + ((mRects[Index].Y + Y) * BLT_TEST_WIDTH + mRects[Index].X) * Format->BytesPerPixel,
+        (UINT32 *) &mBltBuffer[(SourceY + Y) * BLT_TEST_WIDTH + SourceX],
+        mRects[Index].Width
+        );
+    }
+
+    Status = BltLibBufferToVideoEx (
+               mBltBuffer,
+               SourceX,
+               SourceY,
+               mRects[Index].X,
+               mRects[Index].Y,
+               mRects[Index].Width,
+               mRects[Index].Height,
+               BLT_TEST_WIDTH * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)
+               );
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_MEM_EQUAL (mFrameBuffer, mExpectedFrameBuffer, sizeof (mFrameBuffer));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Copies each of mRects of a random frame buffer to another position of a
+  BltBuffer, and checks the whole BltBuffer.
+
+  @param[in]  Context  The BLT_TEST_FORMAT of the frame buffer.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BltTestVideoToBltBuffer (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BLT_TEST_FORMAT  *Format;
+  EFI_STATUS       Status;
+  UINTN            Index;
+  UINTN            DestinationX;
+  UINTN            DestinationY;
+  UINTN            Y;
+
+  Format = (BLT_TEST_FORMAT *) Context;
+  Status = BltTestConfigure (Format);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  mSeed = 6;
+  for (Index = 0; Index < ARRAY_SIZE (mRects); Index++) {
+    BltTestFill (mFrameBuffer, sizeof (mFrameBuffer));
+    BltTestFill (mBltBuffer, sizeof (mBltBuffer));
+    CopyMem (mExpectedBltBuffer, mBltBuffer, sizeof (mBltBuffer));
+
+    DestinationX = BLT_TEST_WIDTH - mRects[Index].Width;
+    DestinationY = BLT_TEST_HEIGHT - mRects[Index].Height;
+    for (Y = 0; Y < mRects[Index].Height; Y++) {
+      BltTestFromVideo (
+        Format,
+        (UINT32 *) &mExpectedBltBuffer[(DestinationY + Y) * BLT_TEST_WIDTH + DestinationX],
+        (UINT8 *) mFrameBuffer + ((mRects[Index].Y + Y) * BLT_TEST_WIDTH + mRects[Index].X) * Format->BytesPerPixel,
+        mRects[Index].Width
+        );
+    }
+
+    Status = BltLibVideoToBltBufferEx (
+               mBltBuffer,
+               mRects[Index].X,
+               mRects[Index].Y,
+               DestinationX,
+               DestinationY,
+               mRects[Index].Width,
+               mRects[Index].Height,
+               BLT_TEST_WIDTH * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)
+               );
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_MEM_EQUAL (mBltBuffer, mExpectedBltBuffer, sizeof (mBltBuffer));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the
+  FrameBufferBltLib and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+  BLT_TEST_FORMAT             *Formats[4];
+  UINTN                       Index;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Pixel conversion", "OptionRomPkg.FrameBufferBltLib.Convert", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Swap red and blue", "SwapRedBlue32", BltTestSwapRedBlue32, NULL, NULL, NULL);
+  AddTestCase (Suite, "BGRX to 5:6:5", "BgrxToRgb565", BltTestBgrxToRgb565, NULL, NULL, NULL);
+  AddTestCase (Suite, "5:6:5 to BGRX", "Rgb565ToBgrx", BltTestRgb565ToBgrx, NULL, NULL, NULL);
+
+  Formats[0] = &mRgbx;
+  Formats[1] = &mBgrx;
+  Formats[2] = &mRgb565;
+  Formats[3] = &mBgr888;
+  for (Index = 0; Index < ARRAY_SIZE (Formats); Index++) {
+    Status = CreateUnitTestSuite (&Suite, Framework, Formats[Index]->Name, "OptionRomPkg.FrameBufferBltLib.Blt", NULL, NULL);
+    if (EFI_ERROR (Status)) {
+      goto EXIT;
+    }
+
+    AddTestCase (Suite, "Video fill", "VideoFill", BltTestVideoFill, NULL, NULL, Formats[Index]);
+    AddTestCase (Suite, "Buffer to video", "BufferToVideo", BltTestBufferToVideo, NULL, NULL, Formats[Index]);
+    AddTestCase (Suite, "Video to buffer", "VideoToBltBuffer", BltTestVideoToBltBuffer, NULL, NULL, Formats[Index]);
+  }
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
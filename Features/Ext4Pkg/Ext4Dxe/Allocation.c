@@ -0,0 +1,888 @@
+/** @file
+  Block and inode allocation routines
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Blocks and inodes are allocated from the block and inode bitmaps of each block
+  group, and the free counts kept in the block group descriptors and in the
+  superblock are updated along with them. Every change goes through the running
+  transaction. Allocations start at the block group of a goal (e.g the file's
+  last block, or its parent directory) and take the first free run, which keeps
+  files mostly contiguous without the bookkeeping of a real allocator.
+**/
+
+#include "Ext4Dxe.h"
+
+/**
+   Gets the first block of a block group.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  BlockGroup     Block group number.
+
+   @return The first block of the group.
+**/
+STATIC
+EXT4_BLOCK_NR
+Ext4BlockGroupStart (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT32                BlockGroup
+  )
+{
+  return Partition->SuperBlock.s_first_data_block +
+         MultU64x32 (BlockGroup, Partition->SuperBlock.s_blocks_per_group);
+}
+
+/**
+   Gets the number of blocks in a block group. Only the last one may be partial.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  BlockGroup     Block group number.
+
+   @return The number of blocks in the group.
+**/
+STATIC
+UINT32
+Ext4BlocksInGroup (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT32                BlockGroup
+  )
+{
+  return (UINT32)MIN (
+                   Partition->SuperBlock.s_blocks_per_group,
+                   Partition->NumberBlocks - Ext4BlockGroupStart (Partition, BlockGroup)
+                   );
+}
+
+/**
+   Checks if a block group has a copy of the superblock and of the descriptor table.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  BlockGroup     Block group number.
+
+   @return TRUE if it has a copy.
+**/
+STATIC
+BOOLEAN
+Ext4GroupHasSuper (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT32                BlockGroup
+  )
+{
+  UINT32  Power;
+
+  if (BlockGroup == 0) {
+    return TRUE;
+  }
+
+  if (EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_SPARSE_SUPER2)) {
+    return BlockGroup == Partition->SuperBlock.s_backup_bgs[0] ||
+           BlockGroup == Partition->SuperBlock.s_backup_bgs[1];
+  }
+
+  if (!EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER) || (BlockGroup == 1)) {
+    return TRUE;
+  }
+
+  // Otherwise, only powers of 3, 5 and 7 have one
+  for (Power = 3; Power <= BlockGroup; Power *= 3) {
+    if (Power == BlockGroup) {
+      return TRUE;
+    }
+  }
+
+  for (Power = 5; Power <= BlockGroup; Power *= 5) {
+    if (Power == BlockGroup) {
+      return TRUE;
+    }
+  }
+
+  for (Power = 7; Power <= BlockGroup; Power *= 7) {
+    if (Power == BlockGroup) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+   Reads one of the counts of a block group descriptor, which are split in two halves.
+   The high half only exists in 64-byte descriptors.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Lo             Low half of the count.
+   @param[in]  Hi             High half of the count.
+
+   @return The count.
+**/
+STATIC
+UINT32
+Ext4GetDescCount (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT16                Lo,
+  IN UINT16                Hi
+  )
+{
+  if (Partition->DescSize < EXT4_64BIT_BLOCK_DESC_SIZE) {
+    return Lo;
+  }
+
+  return Lo | ((UINT32)Hi << 16);
+}
+
+/**
+   Writes one of the counts of a block group descriptor.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[out] Lo             Low half of the count.
+   @param[out] Hi             High half of the count.
+   @param[in]  Count          The count.
+**/
+STATIC
+VOID
+Ext4SetDescCount (
+  IN  CONST EXT4_PARTITION  *Partition,
+  OUT UINT16                *Lo,
+  OUT UINT16                *Hi,
+  IN  UINT32                Count
+  )
+{
+  *Lo = (UINT16)Count;
+
+  if (Partition->DescSize >= EXT4_64BIT_BLOCK_DESC_SIZE) {
+    *Hi = (UINT16)(Count >> 16);
+  }
+}
+
+/**
+   Adds to the superblock's count of free blocks.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Delta          Number of blocks to add. Negative to subtract.
+**/
+STATIC
+VOID
+Ext4AddFreeBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     INT64           Delta
+  )
+{
+  EXT4_SUPERBLOCK  *Sb;
+  UINT64           Free;
+
+  Sb   = &Partition->SuperBlock;
+  Free = EXT4_BLOCK_NR_FROM_HALFS (Partition, Sb->s_free_blocks_count, Sb->s_free_blocks_count_hi);
+  Free = (UINT64)((INT64)Free + Delta);
+
+  Sb->s_free_blocks_count = (UINT32)Free;
+
+  if (EXT4_IS_64_BIT (Partition)) {
+    Sb->s_free_blocks_count_hi = (UINT32)RShiftU64 (Free, 32);
+  }
+
+  Ext4DirtySuperblock (Partition);
+}
+
+/**
+   Updates the checksum of a block bitmap, in its block group descriptor.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Desc           Pointer to the block group descriptor.
+   @param[in]      Bitmap         Pointer to the bitmap.
+**/
+STATIC
+VOID
+Ext4UpdateBlockBitmapChecksum (
+  IN     CONST EXT4_PARTITION   *Partition,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  IN     CONST UINT8            *Bitmap
+  )
+{
+  UINT32  Csum;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  Csum = Ext4CalculateChecksum (
+           Partition,
+           Bitmap,
+           Partition->SuperBlock.s_blocks_per_group / 8,
+           Partition->InitialSeed
+           );
+
+  Desc->bg_block_bitmap_csum_lo = (UINT16)Csum;
+
+  if (Partition->DescSize >= EXT4_64BIT_BLOCK_DESC_SIZE) {
+    Desc->bg_block_bitmap_csum_hi = (UINT16)(Csum >> 16);
+  }
+}
+
+/**
+   Updates the checksum of an inode bitmap, in its block group descriptor.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Desc           Pointer to the block group descriptor.
+   @param[in]      Bitmap         Pointer to the bitmap.
+**/
+STATIC
+VOID
+Ext4UpdateInodeBitmapChecksum (
+  IN     CONST EXT4_PARTITION   *Partition,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  IN     CONST UINT8            *Bitmap
+  )
+{
+  UINT32  Csum;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  Csum = Ext4CalculateChecksum (
+           Partition,
+           Bitmap,
+           Partition->SuperBlock.s_inodes_per_group / 8,
+           Partition->InitialSeed
+           );
+
+  Desc->bg_inode_bitmap_csum_lo = (UINT16)Csum;
+
+  if (Partition->DescSize >= EXT4_64BIT_BLOCK_DESC_SIZE) {
+    Desc->bg_inode_bitmap_csum_hi = (UINT16)(Csum >> 16);
+  }
+}
+
+/**
+   Marks a block as used in a block group's bitmap, if it belongs to the group.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+   @param[in out]  Bitmap         Pointer to the block group's block bitmap.
+   @param[in]      Block          Block number.
+   @param[in]      Count          Number of blocks, starting at Block.
+**/
+STATIC
+VOID
+Ext4MarkGroupBlocks (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN     UINT32                BlockGroup,
+  IN OUT UINT8                 *Bitmap,
+  IN     EXT4_BLOCK_NR         Block,
+  IN     UINT64                Count
+  )
+{
+  EXT4_BLOCK_NR  Start;
+  UINT32         BlocksInGroup;
+
+  Start         = Ext4BlockGroupStart (Partition, BlockGroup);
+  BlocksInGroup = Ext4BlocksInGroup (Partition, BlockGroup);
+
+  for ( ; Count != 0; Count--, Block++) {
+    if ((Block >= Start) && (Block - Start < BlocksInGroup)) {
+      EXT4_BITMAP_SET (Bitmap, (UINTN)(Block - Start));
+    }
+  }
+}
+
+/**
+   Gets a block group's block bitmap ready to be modified by the running transaction.
+   Groups marked BLOCK_UNINIT don't have one on the disk yet: it's built from the group's
+   layout, the way Linux does it, and the flag is cleared.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+   @param[in out]  Desc           Pointer to the block group's descriptor.
+   @param[out]     Bitmap         Pointer to the bitmap.
+
+   @return Status of reading the bitmap.
+**/
+STATIC
+EFI_STATUS
+Ext4ModifyBlockBitmap (
+  IN OUT EXT4_PARTITION         *Partition,
+  IN     UINT32                 BlockGroup,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  OUT    UINT8                  **Bitmap
+  )
+{
+  EXT4_BLOCK_NR  BitmapBlock;
+  EXT4_BLOCK_NR  GroupStart;
+  UINT64         GdtBlocks;
+  UINT64         InodeTableBlocks;
+  UINT32         Bit;
+  BOOLEAN        Uninit;
+  EFI_STATUS     Status;
+
+  BitmapBlock = EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_block_bitmap_lo, Desc->bg_block_bitmap_hi);
+  Uninit      = (Desc->bg_flags & EXT4_BG_BLOCK_UNINIT) != 0;
+
+  Status = Ext4ModifyBlock (Partition, BitmapBlock, Uninit, (VOID **)Bitmap);
+
+  if (EFI_ERROR (Status) || !Uninit) {
+    return Status;
+  }
+
+  GroupStart = Ext4BlockGroupStart (Partition, BlockGroup);
+
+  if (Ext4GroupHasSuper (Partition, BlockGroup)) {
+    GdtBlocks = DivU64x32 (
+                  MultU64x32 (Partition->NumberBlockGroups, Partition->DescSize) + Partition->BlockSize - 1,
+                  Partition->BlockSize
+                  );
+    Ext4MarkGroupBlocks (
+      Partition,
+      BlockGroup,
+      *Bitmap,
+      GroupStart,
+      1 + GdtBlocks + Partition->SuperBlock.s_reserved_gdt_blocks
+      );
+  }
+
+  InodeTableBlocks = DivU64x32 (
+                       MultU64x32 (Partition->SuperBlock.s_inodes_per_group, Partition->InodeSize) +
+                       Partition->BlockSize - 1,
+                       Partition->BlockSize
+                       );
+
+  Ext4MarkGroupBlocks (Partition, BlockGroup, *Bitmap, BitmapBlock, 1);
+  Ext4MarkGroupBlocks (
+    Partition,
+    BlockGroup,
+    *Bitmap,
+    EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_inode_bitmap_lo, Desc->bg_inode_bitmap_hi),
+    1
+    );
+  Ext4MarkGroupBlocks (
+    Partition,
+    BlockGroup,
+    *Bitmap,
+    EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_inode_table_lo, Desc->bg_inode_table_hi),
+    InodeTableBlocks
+    );
+
+  // Blocks past the end of the filesystem (in the last group) are always in use
+  for (Bit = Ext4BlocksInGroup (Partition, BlockGroup); Bit < Partition->BlockSize * 8; Bit++) {
+    EXT4_BITMAP_SET (*Bitmap, Bit);
+  }
+
+  Desc->bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+  Ext4UpdateBlockBitmapChecksum (Partition, Desc, *Bitmap);
+
+  return Ext4DirtyBlockGroupDesc (Partition, BlockGroup);
+}
+
+/**
+   Looks for a run of free blocks in a block group.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+   @param[in]      Bitmap         Pointer to the block group's block bitmap.
+   @param[in]      StartBit       Bit to start looking at.
+   @param[in]      MaxCount       Maximum length of the run.
+   @param[out]     RunStart       First bit of the run.
+
+   @return Length of the run, or 0 if there are no free blocks from StartBit onwards.
+**/
+STATIC
+UINT32
+Ext4FindFreeRun (
+  IN  CONST EXT4_PARTITION  *Partition,
+  IN  UINT32                BlockGroup,
+  IN  CONST UINT8           *Bitmap,
+  IN  UINT32                StartBit,
+  IN  UINT32                MaxCount,
+  OUT UINT32                *RunStart
+  )
+{
+  EXT4_BLOCK_NR  GroupStart;
+  EXT4_BLOCK_NR  FreedEnd;
+  UINT32         BlocksInGroup;
+  UINT32         Bit;
+  UINT32         Length;
+
+  GroupStart    = Ext4BlockGroupStart (Partition, BlockGroup);
+  BlocksInGroup = Ext4BlocksInGroup (Partition, BlockGroup);
+  Bit           = StartBit;
+
+  while (Bit < BlocksInGroup) {
+    // Skip whole used bytes
+    if (((Bit % 8) == 0) && (Bitmap[Bit / 8] == 0xFF)) {
+      Bit += 8;
+      continue;
+    }
+
+    if (EXT4_BITMAP_TEST (Bitmap, Bit)) {
+      Bit++;
+      continue;
+    }
+
+    // Blocks freed by the running transaction can't be reused until it's committed
+    if (Ext4BlockWasFreed (Partition, GroupStart + Bit, &FreedEnd)) {
+      Bit = (UINT32)MIN (FreedEnd - GroupStart, BlocksInGroup);
+      continue;
+    }
+
+    for (Length = 1; Length < MaxCount && Bit + Length < BlocksInGroup; Length++) {
+      if (EXT4_BITMAP_TEST (Bitmap, Bit + Length) ||
+          Ext4BlockWasFreed (Partition, GroupStart + Bit + Length, &FreedEnd))
+      {
+        break;
+      }
+    }
+
+    *RunStart = Bit;
+    return Length;
+  }
+
+  return 0;
+}
+
+/**
+   Allocates a run of contiguous blocks, as close as possible to a goal block.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Goal           Block the run should start at, ideally.
+   @param[in out]  Count          On input, the number of blocks wanted. On output,
+                                  the number of blocks allocated, which may be less.
+   @param[out]     Start          First block of the allocated run.
+
+   @retval EFI_SUCCESS           At least one block was allocated.
+   @retval EFI_VOLUME_FULL       There are no free blocks.
+   @retval EFI_VOLUME_CORRUPTED  The free block accounting is corrupted.
+**/
+EFI_STATUS
+Ext4AllocateBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Goal,
+  IN OUT UINT32          *Count,
+  OUT    EXT4_BLOCK_NR   *Start
+  )
+{
+  EXT4_SUPERBLOCK        *Sb;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  UINT32                 GoalGroup;
+  UINT32                 BlockGroup;
+  UINT32                 Free;
+  UINT32                 StartBit;
+  UINT32                 RunStart;
+  UINT32                 Length;
+  UINT32                 Bit;
+  UINT64                 Try;
+  EFI_STATUS             Status;
+
+  Sb = &Partition->SuperBlock;
+
+  ASSERT (*Count != 0);
+
+  if ((Goal < Sb->s_first_data_block) || (Goal >= Partition->NumberBlocks)) {
+    Goal = Sb->s_first_data_block;
+  }
+
+  GoalGroup = (UINT32)DivU64x32 (Goal - Sb->s_first_data_block, Sb->s_blocks_per_group);
+
+  // The goal's group is tried twice: from the goal onwards first, and then from its start
+  for (Try = 0; Try <= Partition->NumberBlockGroups; Try++) {
+    BlockGroup = (UINT32)(((UINT64)GoalGroup + Try) % Partition->NumberBlockGroups);
+
+    Status = Ext4GetBlockGroupDesc (Partition, BlockGroup, &Desc);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Free = Ext4GetDescCount (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi);
+
+    if (Free == 0) {
+      continue;
+    }
+
+    Status = Ext4ModifyBlockBitmap (Partition, BlockGroup, Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    StartBit = (Try == 0) ? (UINT32)(Goal - Ext4BlockGroupStart (Partition, BlockGroup)) : 0;
+    Length   = Ext4FindFreeRun (Partition, BlockGroup, Bitmap, StartBit, MIN (*Count, Free), &RunStart);
+
+    if (Length == 0) {
+      continue;
+    }
+
+    for (Bit = RunStart; Bit < RunStart + Length; Bit++) {
+      EXT4_BITMAP_SET (Bitmap, Bit);
+    }
+
+    Ext4SetDescCount (
+      Partition,
+      &Desc->bg_free_blocks_count_lo,
+      &Desc->bg_free_blocks_count_hi,
+      Free - Length
+      );
+    Ext4UpdateBlockBitmapChecksum (Partition, Desc, Bitmap);
+
+    Status = Ext4DirtyBlockGroupDesc (Partition, BlockGroup);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Ext4AddFreeBlocks (Partition, -(INT64)Length);
+
+    *Start = Ext4BlockGroupStart (Partition, BlockGroup) + RunStart;
+    *Count = Length;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_VOLUME_FULL;
+}
+
+/**
+   Frees a range of blocks.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Start          First block of the range.
+   @param[in]      Count          Number of blocks.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_VOLUME_CORRUPTED  The range isn't valid, or some block wasn't in use.
+**/
+EFI_STATUS
+Ext4FreeBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Start,
+  IN     UINT64          Count
+  )
+{
+  EXT4_SUPERBLOCK        *Sb;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  UINT32                 BlockGroup;
+  UINT32                 StartBit;
+  UINT32                 Length;
+  UINT32                 Bit;
+  UINT32                 Free;
+  EFI_STATUS             Status;
+
+  Sb = &Partition->SuperBlock;
+
+  if ((Start < Sb->s_first_data_block) || (Start >= Partition->NumberBlocks) ||
+      (Count > Partition->NumberBlocks - Start))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Tried to free invalid blocks [%lu, +%lu)\n", Start, Count));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  while (Count != 0) {
+    BlockGroup = (UINT32)DivU64x32Remainder (Start - Sb->s_first_data_block, Sb->s_blocks_per_group, &StartBit);
+    Length     = (UINT32)MIN (Count, Sb->s_blocks_per_group - StartBit);
+
+    Status = Ext4GetBlockGroupDesc (Partition, BlockGroup, &Desc);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if ((Desc->bg_flags & EXT4_BG_BLOCK_UNINIT) != 0) {
+      // Nothing but metadata can be in use in such a group
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Status = Ext4ModifyBlockBitmap (Partition, BlockGroup, Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    for (Bit = StartBit; Bit < StartBit + Length; Bit++) {
+      if (!EXT4_BITMAP_TEST (Bitmap, Bit)) {
+        DEBUG ((DEBUG_ERROR, "[ext4] Tried to free free block %lu\n", Start + (Bit - StartBit)));
+        return EFI_VOLUME_CORRUPTED;
+      }
+
+      EXT4_BITMAP_CLEAR (Bitmap, Bit);
+    }
+
+    Free = Ext4GetDescCount (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi);
+    Ext4SetDescCount (
+      Partition,
+      &Desc->bg_free_blocks_count_lo,
+      &Desc->bg_free_blocks_count_hi,
+      Free + Length
+      );
+    Ext4UpdateBlockBitmapChecksum (Partition, Desc, Bitmap);
+
+    Status = Ext4DirtyBlockGroupDesc (Partition, BlockGroup);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Ext4AddFreeBlocks (Partition, Length);
+
+    Status = Ext4ForgetBlocks (Partition, Start, Length);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Start += Length;
+    Count -= Length;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets a block group's inode bitmap ready to be modified by the running transaction.
+   Groups marked INODE_UNINIT don't have one on the disk yet: it starts out empty, and
+   the flag is cleared.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+   @param[in out]  Desc           Pointer to the block group's descriptor.
+   @param[out]     Bitmap         Pointer to the bitmap.
+
+   @return Status of reading the bitmap.
+**/
+STATIC
+EFI_STATUS
+Ext4ModifyInodeBitmap (
+  IN OUT EXT4_PARTITION         *Partition,
+  IN     UINT32                 BlockGroup,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  OUT    UINT8                  **Bitmap
+  )
+{
+  EXT4_BLOCK_NR  BitmapBlock;
+  UINT32         Bit;
+  BOOLEAN        Uninit;
+  EFI_STATUS     Status;
+
+  BitmapBlock = EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_inode_bitmap_lo, Desc->bg_inode_bitmap_hi);
+  Uninit      = (Desc->bg_flags & EXT4_BG_INODE_UNINIT) != 0;
+
+  Status = Ext4ModifyBlock (Partition, BitmapBlock, Uninit, (VOID **)Bitmap);
+
+  if (EFI_ERROR (Status) || !Uninit) {
+    return Status;
+  }
+
+  // Bits past the end of the group's inodes are always set
+  for (Bit = Partition->SuperBlock.s_inodes_per_group; Bit < Partition->BlockSize * 8; Bit++) {
+    EXT4_BITMAP_SET (*Bitmap, Bit);
+  }
+
+  Desc->bg_flags &= ~EXT4_BG_INODE_UNINIT;
+  Ext4UpdateInodeBitmapChecksum (Partition, Desc, *Bitmap);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Allocates an inode number.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Goal           Inode whose block group is tried first (e.g the parent directory).
+   @param[in]      IsDir          TRUE if the inode is going to be a directory.
+   @param[out]     InodeNum       Number of the allocated inode.
+
+   @retval EFI_SUCCESS           The inode was allocated.
+   @retval EFI_VOLUME_FULL       There are no free inodes.
+   @retval EFI_VOLUME_CORRUPTED  The free inode accounting is corrupted.
+**/
+EFI_STATUS
+Ext4AllocateInodeNumber (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     Goal,
+  IN     BOOLEAN         IsDir,
+  OUT    EXT4_INO_NR     *InodeNum
+  )
+{
+  EXT4_SUPERBLOCK        *Sb;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  UINT8                  *BlockBitmap;
+  UINT32                 GoalGroup;
+  UINT32                 BlockGroup;
+  UINT32                 Free;
+  UINT32                 Unused;
+  UINT32                 Bit;
+  UINT64                 Try;
+  EFI_STATUS             Status;
+
+  Sb        = &Partition->SuperBlock;
+  GoalGroup = (Goal != 0) ? (Goal - 1) / Sb->s_inodes_per_group : 0;
+
+  for (Try = 0; Try < Partition->NumberBlockGroups; Try++) {
+    BlockGroup = (UINT32)(((UINT64)GoalGroup + Try) % Partition->NumberBlockGroups);
+
+    Status = Ext4GetBlockGroupDesc (Partition, BlockGroup, &Desc);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Free = Ext4GetDescCount (Partition, Desc->bg_free_inodes_count_lo, Desc->bg_free_inodes_count_hi);
+
+    if (Free == 0) {
+      continue;
+    }
+
+    Status = Ext4ModifyInodeBitmap (Partition, BlockGroup, Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    // The reserved inodes live in the first group
+    Bit = (BlockGroup == 0) ? EXT4_FIRST_INO (Partition) - 1 : 0;
+
+    while ((Bit < Sb->s_inodes_per_group) && EXT4_BITMAP_TEST (Bitmap, Bit)) {
+      Bit++;
+    }
+
+    if (Bit == Sb->s_inodes_per_group) {
+      continue;
+    }
+
+    // Linux initializes the block bitmap of a group along with its first inode
+    if ((Desc->bg_flags & EXT4_BG_BLOCK_UNINIT) != 0) {
+      Status = Ext4ModifyBlockBitmap (Partition, BlockGroup, Desc, &BlockBitmap);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    EXT4_BITMAP_SET (Bitmap, Bit);
+
+    Ext4SetDescCount (
+      Partition,
+      &Desc->bg_free_inodes_count_lo,
+      &Desc->bg_free_inodes_count_hi,
+      Free - 1
+      );
+
+    if (IsDir) {
+      Ext4SetDescCount (
+        Partition,
+        &Desc->bg_used_dirs_count_lo,
+        &Desc->bg_used_dirs_count_hi,
+        Ext4GetDescCount (Partition, Desc->bg_used_dirs_count_lo, Desc->bg_used_dirs_count_hi) + 1
+        );
+    }
+
+    // Checksummed filesystems keep track of the part of the inode table that was never used
+    if (EXT4_HAS_GDT_CSUM (Partition) || EXT4_HAS_METADATA_CSUM (Partition)) {
+      Unused = Ext4GetDescCount (Partition, Desc->bg_itable_unused_lo, Desc->bg_itable_unused_hi);
+
+      if (Bit + 1 > Sb->s_inodes_per_group - Unused) {
+        Ext4SetDescCount (
+          Partition,
+          &Desc->bg_itable_unused_lo,
+          &Desc->bg_itable_unused_hi,
+          Sb->s_inodes_per_group - (Bit + 1)
+          );
+      }
+    }
+
+    Ext4UpdateInodeBitmapChecksum (Partition, Desc, Bitmap);
+
+    Status = Ext4DirtyBlockGroupDesc (Partition, BlockGroup);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Sb->s_free_inodes_count--;
+    Ext4DirtySuperblock (Partition);
+
+    *InodeNum = BlockGroup * Sb->s_inodes_per_group + Bit + 1;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_VOLUME_FULL;
+}
+
+/**
+   Frees an inode number.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      InodeNum       Number of the inode.
+   @param[in]      IsDir          TRUE if the inode was a directory.
+
+   @retval EFI_SUCCESS           The inode was freed.
+   @retval EFI_VOLUME_CORRUPTED  The inode wasn't in use.
+**/
+EFI_STATUS
+Ext4FreeInodeNumber (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     InodeNum,
+  IN     BOOLEAN         IsDir
+  )
+{
+  EXT4_SUPERBLOCK        *Sb;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  UINT32                 BlockGroup;
+  UINT32                 Bit;
+  UINT32                 Count;
+  EFI_STATUS             Status;
+
+  Sb = &Partition->SuperBlock;
+
+  if ((InodeNum < EXT4_FIRST_INO (Partition)) || (InodeNum > Sb->s_inodes_count)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  BlockGroup = (InodeNum - 1) / Sb->s_inodes_per_group;
+  Bit        = (InodeNum - 1) % Sb->s_inodes_per_group;
+
+  Status = Ext4GetBlockGroupDesc (Partition, BlockGroup, &Desc);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Desc->bg_flags & EXT4_BG_INODE_UNINIT) != 0) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Status = Ext4ModifyInodeBitmap (Partition, BlockGroup, Desc, &Bitmap);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (!EXT4_BITMAP_TEST (Bitmap, Bit)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Tried to free free inode %u\n", InodeNum));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  EXT4_BITMAP_CLEAR (Bitmap, Bit);
+
+  Count = Ext4GetDescCount (Partition, Desc->bg_free_inodes_count_lo, Desc->bg_free_inodes_count_hi);
+  Ext4SetDescCount (Partition, &Desc->bg_free_inodes_count_lo, &Desc->bg_free_inodes_count_hi, Count + 1);
+
+  if (IsDir) {
+    Count = Ext4GetDescCount (Partition, Desc->bg_used_dirs_count_lo, Desc->bg_used_dirs_count_hi);
+    Ext4SetDescCount (Partition, &Desc->bg_used_dirs_count_lo, &Desc->bg_used_dirs_count_hi, Count - 1);
+  }
+
+  Ext4UpdateInodeBitmapChecksum (Partition, Desc, Bitmap);
+
+  Status = Ext4DirtyBlockGroupDesc (Partition, BlockGroup);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Sb->s_free_inodes_count++;
+  Ext4DirtySuperblock (Partition);
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,488 @@
+/** @file
+  Block cache routines
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Most of the driver's small reads (inodes, extent tree nodes, directory blocks)
+  hit the same few blocks over and over again, and the underlying media
+  (USB sticks, emulated disks) can be quite slow. Therefore, we keep a small,
+  bounded, per-partition cache of whole filesystem blocks.
+**/
+
+#include "Ext4Dxe.h"
+
+// Reads that span more blocks than this are bulk data reads, and would just
+// thrash the cache.
+#define EXT4_BLOCK_CACHE_MAX_READ_BLOCKS  4
+
+typedef struct {
+  LIST_ENTRY       HashNode;
+  LIST_ENTRY       LruNode;
+  EXT4_BLOCK_NR    Block;
+  // Followed by Partition->BlockSize bytes of block data
+} EXT4_BLOCK_CACHE_ENTRY;
+
+#define EXT4_BLOCK_CACHE_ENTRY_DATA(Entry)      ((UINT8 *)((EXT4_BLOCK_CACHE_ENTRY *)(Entry) + 1))
+#define EXT4_BLOCK_CACHE_ENTRY_FROM_HASH(Node)  BASE_CR (Node, EXT4_BLOCK_CACHE_ENTRY, HashNode)
+#define EXT4_BLOCK_CACHE_ENTRY_FROM_LRU(Node)   BASE_CR (Node, EXT4_BLOCK_CACHE_ENTRY, LruNode)
+
+/**
+   Initialises the partition's block cache.
+   Needs to be called after Partition->BlockSize is known.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The cache was initialised (or is disabled).
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4InitBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE  *Cache;
+  UINTN             Index;
+
+  Cache = &Partition->BlockCache;
+
+  InitializeListHead (&Cache->LruList);
+  Cache->NumEntries = 0;
+  Cache->MaxEntries = PcdGet32 (PcdExt4BlockCacheSize);
+  Cache->MediaId    = EXT4_MEDIA_ID (Partition);
+  Cache->Hits       = 0;
+  Cache->Misses     = 0;
+  Cache->Buckets    = NULL;
+  Cache->NumBuckets = 0;
+
+  if (Cache->MaxEntries == 0) {
+    // Disabled
+    return EFI_SUCCESS;
+  }
+
+  // Keep the number of buckets a power of two, with an average load of at most 2
+  Cache->NumBuckets = GetPowerOfTwo32 ((UINT32)Cache->MaxEntries);
+  Cache->Buckets    = AllocatePool (Cache->NumBuckets * sizeof (LIST_ENTRY));
+
+  if (Cache->Buckets == NULL) {
+    Cache->NumBuckets = 0;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Cache->NumBuckets; Index++) {
+    InitializeListHead (&Cache->Buckets[Index]);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops every block from the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4InvalidateBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE        *Cache;
+  LIST_ENTRY              *Node;
+  LIST_ENTRY              *NextNode;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  BASE_LIST_FOR_EACH_SAFE (Node, NextNode, &Cache->LruList) {
+    Entry = EXT4_BLOCK_CACHE_ENTRY_FROM_LRU (Node);
+    RemoveEntryList (&Entry->HashNode);
+    RemoveEntryList (&Entry->LruNode);
+    FreePool (Entry);
+  }
+
+  Cache->NumEntries = 0;
+}
+
+/**
+   Drops a range of blocks from the partition's block cache.
+   Needed when the blocks get written without going through the cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          First block of the range.
+   @param[in]      Count          Number of blocks in the range.
+**/
+VOID
+Ext4InvalidateBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     UINT64          Count
+  )
+{
+  EXT4_BLOCK_CACHE        *Cache;
+  LIST_ENTRY              *Node;
+  LIST_ENTRY              *NextNode;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  // The cache is small, while ranges can be huge (e.g the blocks of a deleted file),
+  // so check every entry instead of looking every block up.
+  BASE_LIST_FOR_EACH_SAFE (Node, NextNode, &Cache->LruList) {
+    Entry = EXT4_BLOCK_CACHE_ENTRY_FROM_LRU (Node);
+
+    if ((Entry->Block >= Block) && (Entry->Block - Block < Count)) {
+      RemoveEntryList (&Entry->HashNode);
+      RemoveEntryList (&Entry->LruNode);
+      FreePool (Entry);
+      Cache->NumEntries--;
+    }
+  }
+}
+
+/**
+   Frees the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE  *Cache;
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  Ext4InvalidateBlockCache (Partition);
+
+  FreePool (Cache->Buckets);
+  Cache->Buckets    = NULL;
+  Cache->NumBuckets = 0;
+}
+
+/**
+   Gets the hash bucket of a block.
+
+   @param[in]  Cache      Pointer to the block cache.
+   @param[in]  Block      Block number.
+
+   @return Pointer to the head of the bucket's list.
+**/
+STATIC
+LIST_ENTRY *
+Ext4BlockCacheBucket (
+  IN EXT4_BLOCK_CACHE  *Cache,
+  IN EXT4_BLOCK_NR     Block
+  )
+{
+  UINT32  Hash;
+
+  // Fibonacci hashing; metadata block numbers tend to be clustered together
+  Hash  = ((UINT32)Block ^ (UINT32)RShiftU64 (Block, 32)) * 0x9E3779B9U;
+  Hash ^= Hash >> 16;
+
+  return &Cache->Buckets[Hash & (Cache->NumBuckets - 1)];
+}
+
+/**
+   Looks a block up in the cache.
+
+   @param[in]  Cache      Pointer to the block cache.
+   @param[in]  Block      Block number.
+
+   @return Pointer to the cache entry holding the block, or NULL if it isn't cached.
+**/
+STATIC
+EXT4_BLOCK_CACHE_ENTRY *
+Ext4BlockCacheFind (
+  IN EXT4_BLOCK_CACHE  *Cache,
+  IN EXT4_BLOCK_NR     Block
+  )
+{
+  LIST_ENTRY              *Node;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+
+  BASE_LIST_FOR_EACH (Node, Ext4BlockCacheBucket (Cache, Block)) {
+    Entry = EXT4_BLOCK_CACHE_ENTRY_FROM_HASH (Node);
+
+    if (Entry->Block == Block) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Gets a block from the cache, reading it from the disk if needed.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Block          Block number.
+   @param[out] OutEntry       Pointer to the cache entry holding the block.
+
+   @return Success status of the read.
+**/
+STATIC
+EFI_STATUS
+Ext4BlockCacheGet (
+  IN  EXT4_PARTITION          *Partition,
+  IN  EXT4_BLOCK_NR           Block,
+  OUT EXT4_BLOCK_CACHE_ENTRY  **OutEntry
+  )
+{
+  EXT4_BLOCK_CACHE        *Cache;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+  EFI_STATUS              Status;
+
+  Cache = &Partition->BlockCache;
+  Entry = Ext4BlockCacheFind (Cache, Block);
+
+  if (Entry != NULL) {
+    Cache->Hits++;
+
+    // Move it to the head of the LRU list
+    RemoveEntryList (&Entry->LruNode);
+    InsertHeadList (&Cache->LruList, &Entry->LruNode);
+
+    *OutEntry = Entry;
+    return EFI_SUCCESS;
+  }
+
+  Cache->Misses++;
+
+  Entry = NULL;
+
+  if (Cache->NumEntries < Cache->MaxEntries) {
+    Entry = AllocatePool (sizeof (EXT4_BLOCK_CACHE_ENTRY) + Partition->BlockSize);
+
+    if (Entry != NULL) {
+      Cache->NumEntries++;
+    }
+  }
+
+  if (Entry == NULL) {
+    if (IsListEmpty (&Cache->LruList)) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    // Recycle the least recently used entry
+    Entry = EXT4_BLOCK_CACHE_ENTRY_FROM_LRU (GetPreviousNode (&Cache->LruList, &Cache->LruList));
+    RemoveEntryList (&Entry->HashNode);
+    RemoveEntryList (&Entry->LruNode);
+  }
+
+  Status = Ext4ReadBlocks (Partition, EXT4_BLOCK_CACHE_ENTRY_DATA (Entry), 1, Block);
+
+  if (EFI_ERROR (Status)) {
+    Cache->NumEntries--;
+    FreePool (Entry);
+    return Status;
+  }
+
+  Entry->Block = Block;
+  InsertHeadList (Ext4BlockCacheBucket (Cache, Block), &Entry->HashNode);
+  InsertHeadList (&Cache->LruList, &Entry->LruNode);
+
+  *OutEntry = Entry;
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads what's on the disk, going through the block cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  Length         Length of the destination buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to read.
+
+   @return Success status of the read.
+**/
+STATIC
+EFI_STATUS
+Ext4ReadDiskIoThroughCache (
+  IN EXT4_PARTITION  *Partition,
+  OUT VOID           *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  EXT4_BLOCK_CACHE        *Cache;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+  EXT4_BLOCK_NR           Block;
+  EXT4_BLOCK_NR           LastBlock;
+  UINT32                  BlockOff;
+  UINTN                   ToCopy;
+  EFI_STATUS              Status;
+
+  Cache = &Partition->BlockCache;
+
+  if ((Cache->Buckets == NULL) || (Length == 0) || (Offset + Length < Offset)) {
+    return Ext4ReadDiskIo (Partition, Buffer, Length, Offset);
+  }
+
+  // The media was changed under us, so everything we have cached is stale.
+  if (Cache->MediaId != EXT4_MEDIA_ID (Partition)) {
+    Ext4InvalidateBlockCache (Partition);
+    Cache->MediaId = EXT4_MEDIA_ID (Partition);
+  }
+
+  Block     = DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOff);
+  LastBlock = DivU64x32 (Offset + Length - 1, Partition->BlockSize);
+
+  if (LastBlock - Block >= EXT4_BLOCK_CACHE_MAX_READ_BLOCKS) {
+    return Ext4ReadDiskIo (Partition, Buffer, Length, Offset);
+  }
+
+  while (Length != 0) {
+    Status = Ext4BlockCacheGet (Partition, Block, &Entry);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    ToCopy = MIN (Length, Partition->BlockSize - BlockOff);
+    CopyMem (Buffer, EXT4_BLOCK_CACHE_ENTRY_DATA (Entry) + BlockOff, ToCopy);
+
+    Buffer   = (UINT8 *)Buffer + ToCopy;
+    Length  -= ToCopy;
+    BlockOff = 0;
+    Block++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads from the partition's disk, going through the block cache.
+   Reads that span more than a few blocks bypass the cache and go directly to the disk.
+   Blocks modified by the running transaction are read as modified.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  Length         Length of the destination buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to read.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  OUT VOID           *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Ext4ReadDiskIoThroughCache (Partition, Buffer, Length, Offset);
+
+  if (!EFI_ERROR (Status) && (Partition->Transaction != NULL)) {
+    Ext4TransactionOverlay (Partition, Buffer, Length, Offset);
+  }
+
+  return Status;
+}
+
+/**
+   Writes to the partition's disk, updating the blocks the block cache holds.
+   Blocks that aren't cached are written straight to the disk, without being cached.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  EXT4_BLOCK_CACHE        *Cache;
+  EXT4_BLOCK_CACHE_ENTRY  *Entry;
+  EXT4_BLOCK_NR           Block;
+  UINT32                  BlockOff;
+  UINTN                   ToCopy;
+  EFI_STATUS              Status;
+
+  Status = Ext4WriteDiskIo (Partition, Buffer, Length, Offset);
+
+  Cache = &Partition->BlockCache;
+
+  if ((Cache->Buckets == NULL) || (Length == 0)) {
+    return Status;
+  }
+
+  // Whether the write made it to the disk or not, we can't tell what's there anymore.
+  if (EFI_ERROR (Status) || (Cache->MediaId != EXT4_MEDIA_ID (Partition))) {
+    Ext4InvalidateBlockCache (Partition);
+    Cache->MediaId = EXT4_MEDIA_ID (Partition);
+    return Status;
+  }
+
+  Block = DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOff);
+
+  while (Length != 0) {
+    ToCopy = MIN (Length, Partition->BlockSize - BlockOff);
+    Entry  = Ext4BlockCacheFind (Cache, Block);
+
+    if (Entry != NULL) {
+      CopyMem (EXT4_BLOCK_CACHE_ENTRY_DATA (Entry) + BlockOff, Buffer, ToCopy);
+    }
+
+    Buffer   = (CONST UINT8 *)Buffer + ToCopy;
+    Length  -= ToCopy;
+    BlockOff = 0;
+    Block++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Retrieves the statistics of the partition's block cache.
+
+   @param[in]   This   Pointer to the EXT4_DEBUG_PROTOCOL instance.
+   @param[out]  Stats  Pointer to the destination statistics structure.
+
+   @retval EFI_SUCCESS            The statistics were retrieved.
+   @retval EFI_INVALID_PARAMETER  This or Stats is NULL.
+**/
+EFI_STATUS
+EFIAPI
+Ext4DebugGetBlockCacheStats (
+  IN  EXT4_DEBUG_PROTOCOL           *This,
+  OUT EXT4_DEBUG_BLOCK_CACHE_STATS  *Stats
+  )
+{
+  EXT4_BLOCK_CACHE  *Cache;
+
+  if ((This == NULL) || (Stats == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Cache = &EXT4_PARTITION_FROM_DEBUG_INTERFACE (This)->BlockCache;
+
+  Stats->Hits       = Cache->Hits;
+  Stats->Misses     = Cache->Misses;
+  Stats->NumEntries = (UINT32)Cache->NumEntries;
+  Stats->MaxEntries = (UINT32)Cache->MaxEntries;
+
+  return EFI_SUCCESS;
+}
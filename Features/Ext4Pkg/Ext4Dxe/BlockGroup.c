@@ -9,43 +9,295 @@
 
 #include "Ext4Dxe.h"
 
+// The block group descriptor table starts in the block after the superblock
+#define EXT4_BLOCK_GROUP_DESC_TABLE_START(Partition)  ((Partition)->BlockSize == 1024 ? 2 : 1)
+
+/**
+   Gets the number of blocks taken by the block group descriptor table.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+
+   @return The number of blocks.
+**/
+STATIC
+UINTN
+Ext4BlockGroupDescTableBlocks (
+  IN CONST EXT4_PARTITION  *Partition
+  )
+{
+  UINT32  NrBlocksRem;
+  UINTN   NrBlocks;
+
+  NrBlocks = (UINTN)DivU64x32Remainder (
+                      MultU64x32 (Partition->NumberBlockGroups, Partition->DescSize),
+                      Partition->BlockSize,
+                      &NrBlocksRem
+                      );
+
+  if (NrBlocksRem != 0) {
+    NrBlocks++;
+  }
+
+  return NrBlocks;
+}
+
+/**
+   Sets up the partition's block group descriptors.
+
+   Unless PcdExt4LazyBlockGroupDescs is set, the whole descriptor table is read and verified
+   right away. Otherwise, each block of the table is only read when one of its descriptors is
+   first needed, and each descriptor is only verified when it's first needed.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The descriptors were set up.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+   @retval EFI_VOLUME_CORRUPTED  A descriptor has an invalid checksum.
+**/
+EFI_STATUS
+Ext4LoadBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  UINT32                 Index;
+  UINTN                  NrBlocks;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+
+  NrBlocks = Ext4BlockGroupDescTableBlocks (Partition);
+
+  if (!FeaturePcdGet (PcdExt4LazyBlockGroupDescs)) {
+    Partition->BlockGroups = Ext4AllocAndReadBlocks (Partition, NrBlocks, EXT4_BLOCK_GROUP_DESC_TABLE_START (Partition));
+
+    if (Partition->BlockGroups == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (Index = 0; Index < Partition->NumberBlockGroups; Index++) {
+      Desc = (EXT4_BLOCK_GROUP_DESC *)((CHAR8 *)Partition->BlockGroups + Index * Partition->DescSize);
+      if (!Ext4VerifyBlockGroupDescChecksum (Partition, Desc, Index)) {
+        DEBUG ((DEBUG_ERROR, "[ext4] Block group descriptor %u has an invalid checksum\n", Index));
+        Ext4FreeBlockGroupDescs (Partition);
+        return EFI_VOLUME_CORRUPTED;
+      }
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  if (NrBlocks > (UINTN)- 1 / Partition->BlockSize) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Partition->BlockGroups         = AllocatePool (NrBlocks * Partition->BlockSize);
+  Partition->BlockGroupsLoaded   = AllocateZeroPool ((NrBlocks + 7) / 8);
+  Partition->BlockGroupsVerified = AllocateZeroPool ((UINTN)DivU64x32 (Partition->NumberBlockGroups + 7, 8));
+
+  if ((Partition->BlockGroups == NULL) || (Partition->BlockGroupsLoaded == NULL) ||
+      (Partition->BlockGroupsVerified == NULL))
+  {
+    Ext4FreeBlockGroupDescs (Partition);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Throws away the in-memory block group descriptors, so that they're read again from
+   the disk. Used when a transaction that modified them is aborted.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @return Status of reading the descriptors again.
+**/
+EFI_STATUS
+Ext4ReloadBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  UINT32                 Index;
+  UINTN                  NrBlocks;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  EFI_STATUS             Status;
+
+  NrBlocks = Ext4BlockGroupDescTableBlocks (Partition);
+
+  // Lazily loaded tables just need to forget what was loaded
+  if (Partition->BlockGroupsVerified != NULL) {
+    ZeroMem (Partition->BlockGroupsLoaded, (NrBlocks + 7) / 8);
+    ZeroMem (Partition->BlockGroupsVerified, (UINTN)DivU64x32 (Partition->NumberBlockGroups + 7, 8));
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4ReadBlocks (Partition, Partition->BlockGroups, NrBlocks, EXT4_BLOCK_GROUP_DESC_TABLE_START (Partition));
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < Partition->NumberBlockGroups; Index++) {
+    Desc = (EXT4_BLOCK_GROUP_DESC *)((CHAR8 *)Partition->BlockGroups + Index * Partition->DescSize);
+    if (!Ext4VerifyBlockGroupDescChecksum (Partition, Desc, Index)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Block group descriptor %u has an invalid checksum\n", Index));
+      return EFI_VOLUME_CORRUPTED;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees the partition's block group descriptors.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  if (Partition->BlockGroups != NULL) {
+    FreePool (Partition->BlockGroups);
+    Partition->BlockGroups = NULL;
+  }
+
+  if (Partition->BlockGroupsLoaded != NULL) {
+    FreePool (Partition->BlockGroupsLoaded);
+    Partition->BlockGroupsLoaded = NULL;
+  }
+
+  if (Partition->BlockGroupsVerified != NULL) {
+    FreePool (Partition->BlockGroupsVerified);
+    Partition->BlockGroupsVerified = NULL;
+  }
+}
+
 /**
    Retrieves a block group descriptor of the ext4 filesystem.
+   If the descriptor hasn't been used before, it's read and verified first.
 
    @param[in]  Partition      Pointer to the opened ext4 partition.
-   @param[in]  BlockGroup    Block group number.
+   @param[in]  BlockGroup     Block group number.
+   @param[out] Desc           Pointer to where the pointer to the block group descriptor is stored.
 
-   @return A pointer to the block group descriptor.
+   @retval EFI_SUCCESS           The descriptor was retrieved.
+   @retval EFI_VOLUME_CORRUPTED  The block group doesn't exist, or its descriptor has an
+                                 invalid checksum.
+   @return Any error from reading the descriptor table.
 **/
-EXT4_BLOCK_GROUP_DESC *
+EFI_STATUS
 Ext4GetBlockGroupDesc (
-  IN EXT4_PARTITION  *Partition,
-  IN UINT32          BlockGroup
+  IN  EXT4_PARTITION         *Partition,
+  IN  UINT32                 BlockGroup,
+  OUT EXT4_BLOCK_GROUP_DESC  **Desc
   )
 {
-  // Maybe assert that the block group nr isn't a nonsense number?
-  return (EXT4_BLOCK_GROUP_DESC *)((CHAR8 *)Partition->BlockGroups + BlockGroup * Partition->DescSize);
+  UINTN       TableBlock;
+  EFI_STATUS  Status;
+
+  if (BlockGroup >= Partition->NumberBlockGroups) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  *Desc = (EXT4_BLOCK_GROUP_DESC *)((CHAR8 *)Partition->BlockGroups + BlockGroup * Partition->DescSize);
+
+  // Eagerly loaded, or already verified
+  if ((Partition->BlockGroupsVerified == NULL) || EXT4_BITMAP_TEST (Partition->BlockGroupsVerified, BlockGroup)) {
+    return EFI_SUCCESS;
+  }
+
+  TableBlock = (BlockGroup * Partition->DescSize) / Partition->BlockSize;
+
+  if (!EXT4_BITMAP_TEST (Partition->BlockGroupsLoaded, TableBlock)) {
+    Status = Ext4ReadBlocks (
+               Partition,
+               (CHAR8 *)Partition->BlockGroups + TableBlock * Partition->BlockSize,
+               1,
+               EXT4_BLOCK_GROUP_DESC_TABLE_START (Partition) + TableBlock
+               );
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    EXT4_BITMAP_SET (Partition->BlockGroupsLoaded, TableBlock);
+  }
+
+  if (!Ext4VerifyBlockGroupDescChecksum (Partition, *Desc, BlockGroup)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Block group descriptor %u has an invalid checksum\n", BlockGroup));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  EXT4_BITMAP_SET (Partition->BlockGroupsVerified, BlockGroup);
+
+  return EFI_SUCCESS;
 }
 
 /**
-   Reads an inode from disk.
+   Writes a modified block group descriptor to the running transaction, updating its
+   checksum first.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+
+   @return Status of getting the descriptor table block ready to be modified.
+**/
+EFI_STATUS
+Ext4DirtyBlockGroupDesc (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     UINT32          BlockGroup
+  )
+{
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT64                 TableOffset;
+  UINT32                 BlockOffset;
+  UINT8                  *Data;
+  EFI_STATUS             Status;
+
+  ASSERT (BlockGroup < Partition->NumberBlockGroups);
+
+  Desc        = (EXT4_BLOCK_GROUP_DESC *)((CHAR8 *)Partition->BlockGroups + BlockGroup * Partition->DescSize);
+  TableOffset = MultU64x32 (BlockGroup, Partition->DescSize);
+
+  if (EXT4_HAS_METADATA_CSUM (Partition) || EXT4_HAS_GDT_CSUM (Partition)) {
+    Desc->bg_checksum = Ext4CalculateBlockGroupDescChecksum (Partition, Desc, BlockGroup);
+  }
+
+  Status = Ext4ModifyBlock (
+             Partition,
+             EXT4_BLOCK_GROUP_DESC_TABLE_START (Partition) + DivU64x32Remainder (TableOffset, Partition->BlockSize, &BlockOffset),
+             FALSE,
+             (VOID **)&Data
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CopyMem (Data + BlockOffset, Desc, Partition->DescSize);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Finds where an inode is on the disk.
 
    @param[in]    Partition  Pointer to the opened partition.
-   @param[in]    InodeNum   Number of the desired Inode
-   @param[out]   OutIno     Pointer to where it will be stored a pointer to the read inode.
+   @param[in]    InodeNum   Number of the inode.
+   @param[out]   Offset     Offset of the inode on the disk, in bytes.
 
-   @return Status of the inode read.
+   @return Status of the block group descriptor lookup.
 **/
+STATIC
 EFI_STATUS
-Ext4ReadInode (
-  IN EXT4_PARTITION  *Partition,
-  IN EXT4_INO_NR     InodeNum,
-  OUT EXT4_INODE     **OutIno
+Ext4GetInodeDiskOffset (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  OUT UINT64          *Offset
   )
 {
   UINT64                 InodeOffset;
   UINT32                 BlockGroupNumber;
-  EXT4_INODE             *Inode;
   EXT4_BLOCK_GROUP_DESC  *BlockGroup;
   EXT4_BLOCK_NR          InodeTableStart;
   EFI_STATUS             Status;
@@ -56,20 +308,15 @@ Ext4ReadInode (
                                &InodeOffset
                                );
 
-  // Check for the block group number's correctness
-  if (BlockGroupNumber >= Partition->NumberBlockGroups) {
-    return EFI_VOLUME_CORRUPTED;
-  }
+  // This also checks for the block group number's correctness
+  Status = Ext4GetBlockGroupDesc (Partition, BlockGroupNumber, &BlockGroup);
 
-  Inode = Ext4AllocateInode (Partition);
-
-  if (Inode == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  BlockGroup = Ext4GetBlockGroupDesc (Partition, BlockGroupNumber);
-
-  // Note: We'll need to check INODE_UNINIT and friends when/if we add write support
+  // Inodes of groups marked INODE_UNINIT are never in use, so nothing should point at them.
+  // The table might not have been zeroed either, so new inodes are always written in full.
 
   InodeTableStart = EXT4_BLOCK_NR_FROM_HALFS (
                       Partition,
@@ -77,22 +324,52 @@ Ext4ReadInode (
                       BlockGroup->bg_inode_table_hi
                       );
 
-  Status = Ext4ReadDiskIo (
-             Partition,
-             Inode,
-             Partition->InodeSize,
-             EXT4_BLOCK_TO_BYTES (Partition, InodeTableStart) + MultU64x32 (InodeOffset, Partition->InodeSize)
-             );
+  *Offset = EXT4_BLOCK_TO_BYTES (Partition, InodeTableStart) + MultU64x32 (InodeOffset, Partition->InodeSize);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads an inode from disk.
+
+   @param[in]    Partition  Pointer to the opened partition.
+   @param[in]    InodeNum   Number of the desired Inode
+   @param[out]   OutIno     Pointer to where it will be stored a pointer to the read inode.
+
+   @return Status of the inode read.
+**/
+EFI_STATUS
+Ext4ReadInode (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum,
+  OUT EXT4_INODE     **OutIno
+  )
+{
+  UINT64      Offset;
+  EXT4_INODE  *Inode;
+  EFI_STATUS  Status;
+
+  Status = Ext4GetInodeDiskOffset (Partition, InodeNum, &Offset);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Inode = Ext4AllocateInode (Partition);
+
+  if (Inode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4ReadDiskIoCached (Partition, Inode, Partition->InodeSize, Offset);
 
   if (EFI_ERROR (Status)) {
     DEBUG ((
       DEBUG_ERROR,
-      "[ext4] Error reading inode: status %x; inode offset %lx"
-      " inode table start %lu block group %lu\n",
+      "[ext4] Error reading inode %lu: status %x; offset %lx\n",
+      InodeNum,
       Status,
-      InodeOffset,
-      InodeTableStart,
-      BlockGroupNumber
+      Offset
       ));
     FreePool (Inode);
     return Status;
@@ -113,6 +390,78 @@ Ext4ReadInode (
   return EFI_SUCCESS;
 }
 
+/**
+   Writes an inode to the running transaction (or to a transaction of its own, if there's
+   none), updating its checksum first. The other open handles of the inode get the new copy.
+
+   @param[in]      Partition  Pointer to the opened partition.
+   @param[in]      InodeNum   Number of the inode.
+   @param[in out]  Inode      Pointer to the inode.
+
+   @return Status of the inode write.
+**/
+EFI_STATUS
+Ext4WriteInode (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     InodeNum,
+  IN OUT EXT4_INODE      *Inode
+  )
+{
+  UINT64      Offset;
+  UINT32      BlockOffset;
+  UINT32      Csum;
+  UINT8       *Data;
+  LIST_ENTRY  *Entry;
+  EXT4_FILE   *Other;
+  EFI_STATUS  Status;
+
+  Status = Ext4GetInodeDiskOffset (Partition, InodeNum, &Offset);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Csum = Ext4CalculateInodeChecksum (Partition, Inode, InodeNum);
+
+    Inode->i_osd2.data_linux.l_i_checksum_lo = (UINT16)Csum;
+
+    if (EXT4_INODE_HAS_FIELD (Inode, i_checksum_hi)) {
+      Inode->i_checksum_hi = (UINT16)(Csum >> 16);
+    }
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ModifyBlock (
+             Partition,
+             DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOffset),
+             FALSE,
+             (VOID **)&Data
+             );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Error writing inode %lu: status %x\n", InodeNum, Status));
+    return Ext4EndTransaction (Partition, Status);
+  }
+
+  CopyMem (Data + BlockOffset, Inode, Partition->InodeSize);
+
+  BASE_LIST_FOR_EACH (Entry, &Partition->OpenFiles) {
+    Other = EXT4_FILE_FROM_OPEN_FILES_NODE (Entry);
+
+    if ((Other->InodeNum == InodeNum) && (Other->Inode != Inode)) {
+      CopyMem (Other->Inode, Inode, Partition->InodeSize);
+    }
+  }
+
+  return Ext4EndTransaction (Partition, EFI_SUCCESS);
+}
+
 /**
    Calculates the checksum of the block group descriptor for METADATA_CSUM enabled filesystems.
    @param[in]      Partition       Pointer to the opened EXT4 partition.
@@ -164,21 +513,23 @@ Ext4CalculateBlockGroupDescChecksumGdtCsum (
   )
 {
   UINT16  Csum;
-  UINT16  Dummy;
-
-  Dummy = 0;
 
+  // Linux's crc16 neither inverts its seed nor its result, unlike CalculateCrc16.
+  // The checksum field itself is skipped, not replaced by zeroes.
   Csum = CalculateCrc16 (Partition->SuperBlock.s_uuid, 16, 0);
   Csum = CalculateCrc16 (&BlockGroupNum, sizeof (BlockGroupNum), Csum);
   Csum = CalculateCrc16 (BlockGroupDesc, OFFSET_OF (EXT4_BLOCK_GROUP_DESC, bg_checksum), Csum);
-  Csum = CalculateCrc16 (&Dummy, sizeof (Dummy), Csum);
-  Csum =
-    CalculateCrc16 (
-      &BlockGroupDesc->bg_block_bitmap_hi,
-      Partition->DescSize - OFFSET_OF (EXT4_BLOCK_GROUP_DESC, bg_block_bitmap_hi),
-      Csum
-      );
-  return Csum;
+
+  if (EXT4_IS_64_BIT (Partition)) {
+    Csum =
+      CalculateCrc16 (
+        &BlockGroupDesc->bg_block_bitmap_hi,
+        Partition->DescSize - OFFSET_OF (EXT4_BLOCK_GROUP_DESC, bg_block_bitmap_hi),
+        Csum
+        );
+  }
+
+  return (UINT16) ~Csum;
 }
 
 /**
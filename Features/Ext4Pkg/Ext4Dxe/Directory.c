@@ -82,610 +82,3601 @@ Ext4ValidDirent (
 }
 
 /**
-   Retrieves a directory entry.
+   Searches a single directory block for a directory entry.
 
-   @param[in]      Directory   Pointer to the opened directory.
-   @param[in]      NameUnicode Pointer to the UCS-2 formatted filename.
    @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block, of size Partition->BlockSize.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
    @param[out]     Result      Pointer to the destination directory entry.
 
-   @return The result of the operation.
+   @retval EFI_SUCCESS           The entry was found and copied to Result.
+   @retval EFI_NOT_FOUND         The entry is not present in this block.
+   @retval EFI_VOLUME_CORRUPTED  The directory block is corrupted.
 **/
+STATIC
 EFI_STATUS
-Ext4RetrieveDirent (
-  IN EXT4_FILE        *Directory,
-  IN CONST CHAR16     *Name,
-  IN EXT4_PARTITION   *Partition,
+Ext4SearchDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Block,
+  IN  CONST CHAR16    *Name,
   OUT EXT4_DIR_ENTRY  *Result
   )
 {
   EFI_STATUS      Status;
-  CHAR8           *Buf;
-  UINT64          Off;
-  EXT4_INODE      *Inode;
-  UINT64          DirInoSize;
-  UINT32          BlockRemainder;
-  UINTN           Length;
   EXT4_DIR_ENTRY  *Entry;
   UINTN           RemainingBlock;
   CHAR16          DirentUcs2Name[EXT4_NAME_MAX + 1];
   UINTN           ToCopy;
   UINTN           BlockOffset;
 
-  Status = EFI_NOT_FOUND;
-  Buf    = AllocatePool (Partition->BlockSize);
+  for (BlockOffset = 0; BlockOffset < Partition->BlockSize; ) {
+    Entry = (EXT4_DIR_ENTRY *)(Block + BlockOffset);
+    RemainingBlock = Partition->BlockSize - BlockOffset;
+    // Check if the minimum directory entry fits inside [BlockOffset, EndOfBlock]
+    if (RemainingBlock < EXT4_MIN_DIR_ENTRY_LEN) {
+      return EFI_VOLUME_CORRUPTED;
+    }
 
-  if (Buf == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
+    if (!Ext4ValidDirent (Entry)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
 
-  Off = 0;
+    if (Entry->name_len > RemainingBlock || Entry->rec_len > RemainingBlock) {
+      // Corrupted filesystem
+      return EFI_VOLUME_CORRUPTED;
+    }
 
-  Inode = Directory->Inode;
-  DirInoSize = EXT4_INODE_SIZE (Inode);
+    // Ignore names bigger than our limit.
 
-  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
-  if (BlockRemainder != 0) {
-    // Directory inodes need to have block aligned sizes
-    return EFI_VOLUME_CORRUPTED;
-  }
+    /* Note: I think having a limit is sane because:
+      1) It's nicer to work with.
+      2) Linux and a number of BSDs also have a filename limit of 255.
+    */
+    if (Entry->name_len > EXT4_NAME_MAX) {
+      BlockOffset += Entry->rec_len;
+      continue;
+    }
 
-  while (Off < DirInoSize) {
-    Length = Partition->BlockSize;
+    // Unused entry
+    if (Entry->inode == 0) {
+      BlockOffset += Entry->rec_len;
+      continue;
+    }
 
-    Status = Ext4Read (Partition, Directory, Buf, Off, &Length);
+    Status = Ext4GetUcs2DirentName (Entry, DirentUcs2Name);
 
-    if (Status != EFI_SUCCESS) {
-      FreePool (Buf);
-      return Status;
+    /* In theory, this should never fail.
+     * In reality, it's quite possible that it can fail, considering filenames in
+     * Linux (and probably other nixes) are just null-terminated bags of bytes, and don't
+     * need to form valid ASCII/UTF-8 sequences.
+     */
+    if (EFI_ERROR (Status)) {
+      // If we error out, skip this entry
+      // I'm not sure if this is correct behaviour, but I don't think there's a precedent here.
+      BlockOffset += Entry->rec_len;
+      continue;
     }
 
-    for (BlockOffset = 0; BlockOffset < Partition->BlockSize; ) {
-      Entry = (EXT4_DIR_ENTRY *)(Buf + BlockOffset);
-      RemainingBlock = Partition->BlockSize - BlockOffset;
-      // Check if the minimum directory entry fits inside [BlockOffset, EndOfBlock]
-      if (RemainingBlock < EXT4_MIN_DIR_ENTRY_LEN) {
-        FreePool (Buf);
-        return EFI_VOLUME_CORRUPTED;
-      }
-
-      if (!Ext4ValidDirent (Entry)) {
-        FreePool (Buf);
-        return EFI_VOLUME_CORRUPTED;
-      }
+    if (Entry->name_len == StrLen (Name) &&
+        !Ext4StrCmpInsensitive (DirentUcs2Name, (CHAR16 *)Name)) {
+      ToCopy = MIN (Entry->rec_len, sizeof (EXT4_DIR_ENTRY));
 
-      if (Entry->name_len > RemainingBlock || Entry->rec_len > RemainingBlock) {
-        // Corrupted filesystem
-        FreePool (Buf);
-        return EFI_VOLUME_CORRUPTED;
-      }
+      CopyMem (Result, Entry, ToCopy);
+      return EFI_SUCCESS;
+    }
 
-      // Ignore names bigger than our limit.
+    BlockOffset += Entry->rec_len;
+  }
 
-      /* Note: I think having a limit is sane because:
-        1) It's nicer to work with.
-        2) Linux and a number of BSDs also have a filename limit of 255.
-      */
-      if (Entry->name_len > EXT4_NAME_MAX) {
-        BlockOffset += Entry->rec_len;
-        continue;
-      }
+  return EFI_NOT_FOUND;
+}
 
-      // Unused entry
-      if (Entry->inode == 0) {
-        BlockOffset += Entry->rec_len;
-        continue;
-      }
+/**
+   Reads a whole directory block.
 
-      Status = Ext4GetUcs2DirentName (Entry, DirentUcs2Name);
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[out]     Buffer      Pointer to the destination buffer, of size Partition->BlockSize.
+   @param[in]      Block       Logical block number inside the directory.
 
-      /* In theory, this should never fail.
-       * In reality, it's quite possible that it can fail, considering filenames in
-       * Linux (and probably other nixes) are just null-terminated bags of bytes, and don't
-       * need to form valid ASCII/UTF-8 sequences.
-       */
-      if (EFI_ERROR (Status)) {
-        // If we error out, skip this entry
-        // I'm not sure if this is correct behaviour, but I don't think there's a precedent here.
-        BlockOffset += Entry->rec_len;
-        continue;
-      }
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ReadDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT VOID            *Buffer,
+  IN  UINT32          Block
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Length;
 
-      if (Entry->name_len == StrLen (Name) &&
-          !Ext4StrCmpInsensitive (DirentUcs2Name, (CHAR16 *)Name)) {
-        ToCopy = MIN (Entry->rec_len, sizeof (EXT4_DIR_ENTRY));
+  Length = Partition->BlockSize;
 
-        CopyMem (Result, Entry, ToCopy);
-        FreePool (Buf);
-        return EFI_SUCCESS;
-      }
+  Status = Ext4Read (Partition, Directory, Buffer, EXT4_BLOCK_TO_BYTES (Partition, Block), &Length);
 
-      BlockOffset += Entry->rec_len;
-    }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-    Off += Partition->BlockSize;
+  // Short reads mean the index points past the end of the directory
+  if (Length != Partition->BlockSize) {
+    return EFI_VOLUME_CORRUPTED;
   }
 
-  FreePool (Buf);
-  return EFI_NOT_FOUND;
+  return EFI_SUCCESS;
 }
 
 /**
-   Opens a file using a directory entry.
+   Calculates the checksum of an htree index block.
+   The block's limit must leave room for the EXT4_DX_TAIL.
 
    @param[in]      Partition   Pointer to the ext4 partition.
-   @param[in]      OpenMode    Mode in which the file is supposed to be open.
-   @param[out]     OutFile     Pointer to the newly opened file.
-   @param[in]      Entry       Directory entry to be used.
    @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Block       Pointer to the index block.
+   @param[in]      CountOffset Offset of the EXT4_DX_COUNT_LIMIT inside the block.
 
-   @retval EFI_STATUS          Result of the operation
+   @return The checksum.
 **/
-EFI_STATUS
-Ext4OpenDirent (
-  IN  EXT4_PARTITION  *Partition,
-  IN  UINT64          OpenMode,
-  OUT EXT4_FILE       **OutFile,
-  IN  EXT4_DIR_ENTRY  *Entry,
-  IN  EXT4_FILE       *Directory
+STATIC
+UINT32
+Ext4CalculateDxChecksum (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN CONST EXT4_FILE       *Directory,
+  IN CONST CHAR8           *Block,
+  IN UINTN                 CountOffset
   )
 {
-  EFI_STATUS  Status;
-  CHAR16      FileName[EXT4_NAME_MAX + 1];
-  EXT4_FILE   *File;
+  CONST EXT4_DX_COUNT_LIMIT  *CountLimit;
+  CONST EXT4_DX_TAIL         *Tail;
+  UINT32                     Csum;
+  UINT32                     Dummy;
+
+  CountLimit = (CONST EXT4_DX_COUNT_LIMIT *)(Block + CountOffset);
+  Tail       = (CONST EXT4_DX_TAIL *)(Block + CountOffset + CountLimit->limit * sizeof (EXT4_DX_ENTRY));
+  Dummy      = 0;
+
+  Csum = Ext4CalculateChecksum (Partition, &Directory->InodeNum, sizeof (EXT4_INO_NR), Partition->InitialSeed);
+  Csum = Ext4CalculateChecksum (Partition, &Directory->Inode->i_generation, sizeof (Directory->Inode->i_generation), Csum);
+  Csum = Ext4CalculateChecksum (Partition, Block, CountOffset + CountLimit->count * sizeof (EXT4_DX_ENTRY), Csum);
+  Csum = Ext4CalculateChecksum (Partition, Tail, OFFSET_OF (EXT4_DX_TAIL, dt_checksum), Csum);
+  Csum = Ext4CalculateChecksum (Partition, &Dummy, sizeof (Dummy), Csum);
+
+  return Csum;
+}
 
-  File = AllocateZeroPool (sizeof (EXT4_FILE));
+/**
+   Checks if the checksum of an htree index block is correct.
 
-  if (File == NULL) {
-    Status = EFI_OUT_OF_RESOURCES;
-    goto Error;
-  }
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Block       Pointer to the index block.
+   @param[in]      CountOffset Offset of the EXT4_DX_COUNT_LIMIT inside the block.
 
-  Status = Ext4GetUcs2DirentName (Entry, FileName);
+   @return TRUE if the checksum is correct, FALSE if there is corruption.
+**/
+STATIC
+BOOLEAN
+Ext4CheckDxChecksum (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN CONST EXT4_FILE       *Directory,
+  IN CONST CHAR8           *Block,
+  IN UINTN                 CountOffset
+  )
+{
+  CONST EXT4_DX_COUNT_LIMIT  *CountLimit;
+  CONST EXT4_DX_TAIL         *Tail;
 
-  if (EFI_ERROR (Status)) {
-    goto Error;
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return TRUE;
   }
 
-  if (StrCmp (FileName, L".") == 0) {
-    // We're using the parent directory's dentry
-    File->Dentry = Directory->Dentry;
+  CountLimit = (CONST EXT4_DX_COUNT_LIMIT *)(Block + CountOffset);
 
-    ASSERT (File->Dentry != NULL);
+  if (CountOffset + CountLimit->limit * sizeof (EXT4_DX_ENTRY) + sizeof (EXT4_DX_TAIL) > Partition->BlockSize) {
+    return FALSE;
+  }
 
-    Ext4RefDentry (File->Dentry);
-  } else if (StrCmp (FileName, L"..") == 0) {
-    // Using the parent's parent's dentry
-    File->Dentry = Directory->Dentry->Parent;
+  Tail = (CONST EXT4_DX_TAIL *)(Block + CountOffset + CountLimit->limit * sizeof (EXT4_DX_ENTRY));
 
-    ASSERT (File->Dentry != NULL);
+  return Tail->dt_checksum == Ext4CalculateDxChecksum (Partition, Directory, Block, CountOffset);
+}
 
-    Ext4RefDentry (File->Dentry);
-  } else {
-    File->Dentry = Ext4CreateDentry (FileName, Directory->Dentry);
+/**
+   Calculates how many entries fit in an htree index node (or in the root's index).
 
-    if (!File->Dentry) {
-      goto Error;
-    }
-  }
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      CountOffset Offset of the EXT4_DX_COUNT_LIMIT inside the block.
 
-  Status = Ext4InitExtentsMap (File);
+   @return The node's limit.
+**/
+STATIC
+UINTN
+Ext4DxNodeLimit (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINTN                 CountOffset
+  )
+{
+  UINTN  Limit;
 
-  if (EFI_ERROR (Status)) {
-    goto Error;
-  }
+  Limit = Partition->BlockSize - CountOffset;
 
-  File->InodeNum = Entry->inode;
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Limit -= sizeof (EXT4_DX_TAIL);
+  }
 
-  Ext4SetupFile (File, Partition);
+  return Limit / sizeof (EXT4_DX_ENTRY);
+}
 
-  Status = Ext4ReadInode (Partition, Entry->inode, &File->Inode);
+/**
+   Validates an htree index node (or the root's index) and finds the entry that covers a hash.
 
-  if (EFI_ERROR (Status)) {
-    goto Error;
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Block       Pointer to the index block.
+   @param[in]      CountOffset Offset of the EXT4_DX_COUNT_LIMIT inside the block.
+   @param[in]      Hash        Hash of the name we're looking up.
+   @param[out]     Entry       Pointer to the index entry that covers Hash.
+   @param[out]     End         Pointer to the end of the index entry array.
+
+   @retval EFI_SUCCESS           The entry was found.
+   @retval EFI_VOLUME_CORRUPTED  The index node is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4DxProbeNode (
+  IN  CONST EXT4_PARTITION  *Partition,
+  IN  CONST EXT4_FILE       *Directory,
+  IN  CONST CHAR8           *Block,
+  IN  UINTN                 CountOffset,
+  IN  UINT32                Hash,
+  OUT CONST EXT4_DX_ENTRY   **Entry,
+  OUT CONST EXT4_DX_ENTRY   **End
+  )
+{
+  CONST EXT4_DX_COUNT_LIMIT  *CountLimit;
+  CONST EXT4_DX_ENTRY        *Entries;
+  CONST EXT4_DX_ENTRY        *l;
+  CONST EXT4_DX_ENTRY        *r;
+  CONST EXT4_DX_ENTRY        *m;
+  UINTN                      ExpectedLimit;
+
+  if (CountOffset + sizeof (EXT4_DX_ENTRY) > Partition->BlockSize) {
+    return EFI_VOLUME_CORRUPTED;
   }
 
-  *OutFile = File;
+  CountLimit    = (CONST EXT4_DX_COUNT_LIMIT *)(Block + CountOffset);
+  Entries       = (CONST EXT4_DX_ENTRY *)CountLimit;
+  ExpectedLimit = Ext4DxNodeLimit (Partition, CountOffset);
 
-  InsertTailList (&Partition->OpenFiles, &File->OpenFilesListNode);
+  if (CountLimit->limit != ExpectedLimit || CountLimit->count > CountLimit->limit || CountLimit->count == 0) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad htree node count %u limit %u\n", CountLimit->count, CountLimit->limit));
+    return EFI_VOLUME_CORRUPTED;
+  }
 
-  return EFI_SUCCESS;
+  if (!Ext4CheckDxChecksum (Partition, Directory, Block, CountOffset)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad htree node checksum\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
 
-Error:
-  if (File != NULL) {
-    if (File->Dentry != NULL) {
-      Ext4UnrefDentry (File->Dentry);
-    }
+  // Entry 0 holds the count and limit in place of its hash, and covers every hash
+  // smaller than entry 1's. The rest of the array is sorted by hash.
+  l = Entries + 1;
+  r = Entries + CountLimit->count - 1;
 
-    if (File->ExtentsMap != NULL) {
-      OrderedCollectionUninit (File->ExtentsMap);
-    }
+  while (l <= r) {
+    m = l + (r - l) / 2;
 
-    FreePool (File);
+    if (m->hash > Hash) {
+      r = m - 1;
+    } else {
+      l = m + 1;
+    }
   }
 
-  return Status;
-}
+  *Entry = l - 1;
+  *End   = Entries + CountLimit->count;
 
-/**
-   Opens a file.
+  return EFI_SUCCESS;
+}
 
-   @param[in]      Directory   Pointer to the opened directory.
-   @param[in]      Name        Pointer to the UCS-2 formatted filename.
-   @param[in]      Partition   Pointer to the ext4 partition.
-   @param[in]      OpenMode    Mode in which the file is supposed to be open.
-   @param[out]     OutFile     Pointer to the newly opened file.
+// One level of an htree lookup: an index node and the entry being followed in it
+typedef struct {
+  CHAR8                  *Block;
+  UINT32                 LogicalBlock;
+  CONST EXT4_DX_ENTRY    *Entry;
+  CONST EXT4_DX_ENTRY    *End;
+} EXT4_DX_FRAME;
 
-   @return Result of the operation.
+/**
+   Walks down the htree index, from the entry followed at a level to the last
+   level of the index. At each level below it, the entry that covers Hash is followed.
+
+   @param[in]      Partition      Pointer to the ext4 partition.
+   @param[in]      Directory      Pointer to the opened directory.
+   @param[in, out] Frames         Frames of the lookup, one per level. The frames below Level are filled in.
+   @param[in]      Level          Level to start from.
+   @param[in]      IndirectLevels Number of index levels under the root.
+   @param[in]      Hash           Hash of the name we're looking up.
+
+   @retval EFI_SUCCESS           Frames[IndirectLevels] points to a leaf block.
+   @retval EFI_VOLUME_CORRUPTED  An index node is corrupted.
 **/
+STATIC
 EFI_STATUS
-Ext4OpenFile (
-  IN  EXT4_FILE       *Directory,
-  IN  CONST CHAR16    *Name,
-  IN  EXT4_PARTITION  *Partition,
-  IN  UINT64          OpenMode,
-  OUT EXT4_FILE       **OutFile
+Ext4DxDescend (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *Directory,
+  IN OUT EXT4_DX_FRAME   *Frames,
+  IN     UINT32          Level,
+  IN     UINT32          IndirectLevels,
+  IN     UINT32          Hash
   )
 {
-  EXT4_DIR_ENTRY  Entry;
-  EFI_STATUS      Status;
+  EFI_STATUS  Status;
 
-  Status = Ext4RetrieveDirent (Directory, Name, Partition, &Entry);
+  for ( ; Level < IndirectLevels; Level++) {
+    Frames[Level + 1].LogicalBlock = Frames[Level].Entry->block & EXT4_DX_BLOCK_MASK;
 
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
+    Status = Ext4ReadDirBlock (Partition, Directory, Frames[Level + 1].Block, Frames[Level + 1].LogicalBlock);
 
-  // EFI requires us to error out on ".." opens for the root directory
-  if (Entry.inode == Directory->InodeNum) {
-    return EFI_NOT_FOUND;
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    // Interior nodes start with an empty dirent covering the whole block
+    if (((EXT4_DX_NODE *)Frames[Level + 1].Block)->fake.inode != 0) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Status = Ext4DxProbeNode (
+               Partition,
+               Directory,
+               Frames[Level + 1].Block,
+               sizeof (EXT4_DX_NODE),
+               Hash,
+               &Frames[Level + 1].Entry,
+               &Frames[Level + 1].End
+               );
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
-  return Ext4OpenDirent (Partition, OpenMode, OutFile, &Entry, Directory);
+  return EFI_SUCCESS;
 }
 
 /**
-  Open the root directory on a volume.
+   Frees the blocks of an htree lookup's frames.
 
-  @param[in]   This A pointer to the volume to open the root directory.
-  @param[out]  Root A pointer to the location to return the opened file handle for the
-                    root directory.
+   @param[in out]  Frames         Frames of the lookup, EXT4_DX_HTREE_LEVEL of them.
+**/
+STATIC
+VOID
+Ext4DxFreeFrames (
+  IN OUT EXT4_DX_FRAME  *Frames
+  )
+{
+  UINTN  Level;
 
-  @retval EFI_SUCCESS          The device was opened.
-  @retval EFI_UNSUPPORTED      This volume does not support the requested file system type.
-  @retval EFI_NO_MEDIA         The device has no medium.
-  @retval EFI_DEVICE_ERROR     The device reported an error.
-  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
-  @retval EFI_ACCESS_DENIED    The service denied access to the file.
-  @retval EFI_OUT_OF_RESOURCES The volume was not opened due to lack of resources.
-  @retval EFI_MEDIA_CHANGED    The device has a different medium in it or the medium is no
-                               longer supported. Any existing file handles for this volume are
-                               no longer valid. To access the files on the new medium, the
-                               volume must be reopened with OpenVolume().
+  for (Level = 0; Level < EXT4_DX_HTREE_LEVEL; Level++) {
+    if (Frames[Level].Block != NULL) {
+      FreePool (Frames[Level].Block);
+      Frames[Level].Block = NULL;
+    }
+  }
+}
 
+/**
+   Walks an htree directory's index down from the root, following the entries
+   that cover the hash of a name.
+
+   @param[in]      Partition      Pointer to the ext4 partition.
+   @param[in]      Directory      Pointer to the opened directory.
+   @param[in]      Utf8Name       Pointer to the UTF-8 name.
+   @param[out]     Frames         Frames of the lookup, EXT4_DX_HTREE_LEVEL of them. They need
+                                  to be freed with Ext4DxFreeFrames, even if the walk fails.
+   @param[out]     IndirectLevels Number of index levels under the root.
+   @param[out]     HashVersion    Hash algorithm of the index, with the signedness resolved.
+   @param[out]     Hash           Hash of the name.
+
+   @retval EFI_SUCCESS           Frames[*IndirectLevels] points to the leaf the name belongs in.
+   @retval EFI_UNSUPPORTED       The index uses an unsupported hash or format.
+   @retval EFI_VOLUME_CORRUPTED  The index is corrupted.
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-Ext4OpenVolume (
-  IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *This,
-  OUT EFI_FILE_PROTOCOL               **Root
+Ext4DxLookupPath (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR8     *Utf8Name,
+  OUT EXT4_DX_FRAME   *Frames,
+  OUT UINT32          *IndirectLevels,
+  OUT UINT8           *HashVersion,
+  OUT UINT32          *Hash
   )
 {
-  EXT4_INODE      *RootInode;
-  EFI_STATUS      Status;
-  EXT4_FILE       *RootDir;
-  EXT4_PARTITION  *Partition;
+  EFI_STATUS    Status;
+  EXT4_DX_ROOT  *Root;
+  UINT32        Level;
+  UINT32        MaxLevels;
 
-  Partition = (EXT4_PARTITION *)This;
+  ZeroMem (Frames, EXT4_DX_HTREE_LEVEL * sizeof (EXT4_DX_FRAME));
 
-  Status = Ext4ReadInode (Partition, EXT4_ROOT_INODE_NR, &RootInode);
+  Frames[0].Block = AllocatePool (Partition->BlockSize);
+
+  if (Frames[0].Block == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4ReadDirBlock (Partition, Directory, Frames[0].Block, 0);
 
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "[ext4] Could not open root inode - error %r\n", Status));
     return Status;
   }
 
-  RootDir = AllocateZeroPool (sizeof (EXT4_FILE));
+  Root = (EXT4_DX_ROOT *)Frames[0].Block;
 
-  if (RootDir == NULL) {
-    FreePool (RootInode);
-    return EFI_OUT_OF_RESOURCES;
+  MaxLevels = EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_LARGEDIR) ?
+              EXT4_DX_HTREE_LEVEL : EXT4_DX_HTREE_LEVEL_COMPAT;
+
+  if ((Root->info.reserved_zero != 0) ||
+      (Root->info.info_length != sizeof (EXT4_DX_ROOT_INFO)) ||
+      (Root->info.indirect_levels >= MaxLevels))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad htree root in inode %u\n", Directory->InodeNum));
+    return EFI_VOLUME_CORRUPTED;
   }
 
-  RootDir->Inode    = RootInode;
-  RootDir->InodeNum = EXT4_ROOT_INODE_NR;
+  // Linux marks unfinished indexes with this bit; we should never see them.
+  if ((Root->info.unused_flags & 1) != 0) {
+    return EFI_UNSUPPORTED;
+  }
 
-  Status = Ext4InitExtentsMap (RootDir);
+  *IndirectLevels = Root->info.indirect_levels;
+  *HashVersion    = Root->info.hash_version;
 
-  if (EFI_ERROR (Status)) {
-    FreePool (RootInode);
-    FreePool (RootDir);
-    return EFI_OUT_OF_RESOURCES;
+  if ((*HashVersion <= EXT4_DX_HASH_TEA) &&
+      ((Partition->SuperBlock.s_flags & EXT4_FLAGS_UNSIGNED_HASH) != 0))
+  {
+    *HashVersion += EXT4_DX_HASH_UNSIGNED_DELTA;
   }
 
-  Ext4SetupFile (RootDir, Partition);
-  *Root = &RootDir->Protocol;
+  Status = Ext4DirHash (Partition, *HashVersion, Utf8Name, AsciiStrLen (Utf8Name), Hash);
 
-  InsertTailList (&Partition->OpenFiles, &RootDir->OpenFilesListNode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-  ASSERT (Partition->RootDentry != NULL);
-  RootDir->Dentry = Partition->RootDentry;
+  for (Level = 1; Level <= *IndirectLevels; Level++) {
+    Frames[Level].Block = AllocatePool (Partition->BlockSize);
 
-  Ext4RefDentry (RootDir->Dentry);
+    if (Frames[Level].Block == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
 
-  return EFI_SUCCESS;
+  Status = Ext4DxProbeNode (
+             Partition,
+             Directory,
+             Frames[0].Block,
+             OFFSET_OF (EXT4_DX_ROOT, info) + Root->info.info_length,
+             *Hash,
+             &Frames[0].Entry,
+             &Frames[0].End
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Walk down the interior nodes until we get to the last level of the index,
+  // which points to the leaf (regular directory entry) blocks.
+  return Ext4DxDescend (Partition, Directory, Frames, 0, *IndirectLevels, *Hash);
 }
 
 /**
-   Reads a directory entry.
+   Retrieves a directory entry using the directory's hash tree index.
 
+   Note that the on-disk hash is calculated over the exact name, while EFI
+   file name lookups are case-insensitive. Therefore, EFI_NOT_FOUND only means
+   there's no exact match, and the caller needs to fall back to a linear scan
+   of the directory if the name has anything to case-fold.
+
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
    @param[in]      Partition   Pointer to the ext4 partition.
-   @param[in]      File        Pointer to the open directory.
-   @param[out]     Buffer      Pointer to the output buffer.
-   @param[in]      Offset      Initial directory position.
-   @param[in out] OutLength    Pointer to a UINTN that contains the length of the buffer,
-                               and the length of the actual EFI_FILE_INFO after the call.
+   @param[in]      Buffer      Pointer to a scratch buffer, of size Partition->BlockSize.
+   @param[out]     Result      Pointer to the destination directory entry.
 
-   @return Result of the operation.
+   @retval EFI_SUCCESS           The entry was found.
+   @retval EFI_NOT_FOUND         The entry was not found in the index.
+   @retval EFI_UNSUPPORTED       The index uses an unsupported hash or format.
+   @retval EFI_VOLUME_CORRUPTED  The index is corrupted.
 **/
+STATIC
 EFI_STATUS
-Ext4ReadDir (
-  IN EXT4_PARTITION  *Partition,
-  IN EXT4_FILE       *File,
-  OUT VOID           *Buffer,
-  IN UINT64          Offset,
-  IN OUT UINTN       *OutLength
+Ext4HtreeLookup (
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  EXT4_PARTITION  *Partition,
+  IN  CHAR8           *Buffer,
+  OUT EXT4_DIR_ENTRY  *Result
   )
 {
-  EXT4_INODE      *DirIno;
-  EFI_STATUS      Status;
-  UINT64          DirInoSize;
-  UINTN           Len;
-  UINT32          BlockRemainder;
-  EXT4_DIR_ENTRY  Entry;
-  EXT4_FILE       *TempFile;
-  BOOLEAN         ShouldSkip;
-  BOOLEAN         IsDotOrDotDot;
+  EFI_STATUS           Status;
+  CHAR8                *Utf8Name;
+  EXT4_DX_FRAME        Frames[EXT4_DX_HTREE_LEVEL];
+  UINT8                HashVersion;
+  UINT32               Hash;
+  UINT32               Level;
+  UINT32               IndirectLevels;
+  CONST EXT4_DX_ENTRY  *Entry;
+  UINT32               LeafBlock;
 
-  DirIno     = File->Inode;
-  Status     = EFI_SUCCESS;
-  DirInoSize = EXT4_INODE_SIZE (DirIno);
+  Utf8Name = NULL;
+  ZeroMem (Frames, sizeof (Frames));
 
-  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
-  if (BlockRemainder != 0) {
-    // Directory inodes need to have block aligned sizes
-    return EFI_VOLUME_CORRUPTED;
+  Status = UCS2StrToUTF8 ((CHAR16 *)Name, &Utf8Name);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  while (TRUE) {
-    TempFile = NULL;
+  if (AsciiStrLen (Utf8Name) > EXT4_NAME_MAX) {
+    Status = EFI_NOT_FOUND;
+    goto Out;
+  }
 
-    // We (try to) read the maximum size of a directory entry at a time
-    // Note that we don't need to read any padding that may exist after it.
-    Len    = sizeof (Entry);
-    Status = Ext4Read (Partition, File, &Entry, Offset, &Len);
+  Status = Ext4DxLookupPath (Partition, Directory, Utf8Name, Frames, &IndirectLevels, &HashVersion, &Hash);
 
-    if (EFI_ERROR (Status)) {
-      goto Out;
-    }
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
 
-    if (Len == 0) {
-      *OutLength = 0;
-      Status     = EFI_SUCCESS;
-      goto Out;
-    }
+  while (TRUE) {
+    LeafBlock = Frames[IndirectLevels].Entry->block & EXT4_DX_BLOCK_MASK;
 
-    if (Len < EXT4_MIN_DIR_ENTRY_LEN) {
-      Status = EFI_VOLUME_CORRUPTED;
-      goto Out;
-    }
+    Status = Ext4ReadDirBlock (Partition, Directory, Buffer, LeafBlock);
 
-    // Invalid directory entry length
-    if (!Ext4ValidDirent (&Entry)) {
-      DEBUG ((DEBUG_ERROR, "[ext4] Invalid dirent at offset %lu\n", Offset));
-      Status = EFI_VOLUME_CORRUPTED;
+    if (EFI_ERROR (Status)) {
       goto Out;
     }
 
-    // Check if the entire dir entry length fits in Len
-    if (Len < (UINTN)(EXT4_MIN_DIR_ENTRY_LEN + Entry.name_len)) {
-      Status = EFI_VOLUME_CORRUPTED;
+    Status = Ext4SearchDirBlock (Partition, Buffer, Name, Result);
+
+    if (Status != EFI_NOT_FOUND) {
       goto Out;
     }
 
-    // We don't care about passing . or .. entries to the caller of ReadDir(),
-    // since they're generally useless entries *and* may break things if too
-    // many callers assume FAT32.
+    // If the next leaf starts with the same hash (marked with the collision bit),
+    // the names we're looking for may have spilled over to it. Like Linux's
+    // ext4_htree_next_block, go up to the parent when the run reaches the end of
+    // an index node; the parent's next entry then carries the collision bit.
+    Level = IndirectLevels;
 
-    // Entry.name_len may be 0 if it's a nameless entry, like an unused entry
-    // or a checksum at the end of the directory block.
-    // memcmp (and CompareMem) return 0 when the passed length is 0.
+    while (++Frames[Level].Entry >= Frames[Level].End) {
+      if (Level == 0) {
+        Status = EFI_NOT_FOUND;
+        goto Out;
+      }
 
-    IsDotOrDotDot = Entry.name_len != 0 &&
-                    (CompareMem (Entry.name, ".", Entry.name_len) == 0 ||
-                     CompareMem (Entry.name, "..", Entry.name_len) == 0);
+      Level--;
+    }
 
-    // When inode = 0, it's unused.
-    ShouldSkip = Entry.inode == 0 || IsDotOrDotDot;
+    Entry = Frames[Level].Entry;
 
-    if (ShouldSkip) {
-      Offset += Entry.rec_len;
-      continue;
+    if (((Entry->hash & 1) == 0) || ((Entry->hash & ~1U) != Hash)) {
+      Status = EFI_NOT_FOUND;
+      goto Out;
     }
 
-    Status = Ext4OpenDirent (Partition, EFI_FILE_MODE_READ, &TempFile, &Entry, File);
+    // Every hash in the nodes below is at least Entry->hash, so the probes
+    // follow their first entries to the next leaf.
+    Status = Ext4DxDescend (Partition, Directory, Frames, Level, IndirectLevels, Hash);
 
     if (EFI_ERROR (Status)) {
       goto Out;
     }
+  }
 
-    Status = Ext4GetFileInfo (TempFile, Buffer, OutLength);
-    if (!EFI_ERROR (Status)) {
-      File->Position = Offset + Entry.rec_len;
-    }
-
-    Ext4CloseInternal (TempFile);
+Out:
+  Ext4DxFreeFrames (Frames);
 
-    goto Out;
+  if (Utf8Name != NULL) {
+    FreePool (Utf8Name);
   }
 
-  Status = EFI_SUCCESS;
-Out:
   return Status;
 }
 
 /**
-   Removes a dentry from the other's list.
+   Checks if a name could match a differently-cased name, in a case-insensitive comparison.
 
-   @param[in out]            Parent       Pointer to the parent EXT4_DENTRY.
-   @param[in out]            ToBeRemoved  Pointer to the child EXT4_DENTRY.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+
+   @return TRUE if the name has ASCII letters or non-ASCII characters, FALSE otherwise.
 **/
 STATIC
-VOID
-Ext4RemoveDentry (
-  IN OUT EXT4_DENTRY  *Parent,
-  IN OUT EXT4_DENTRY  *ToBeRemoved
+BOOLEAN
+Ext4NameHasFoldableCase (
+  IN CONST CHAR16  *Name
   )
 {
-  EXT4_DENTRY  *D;
-  LIST_ENTRY   *Entry;
-  LIST_ENTRY   *NextEntry;
-
-  BASE_LIST_FOR_EACH_SAFE (Entry, NextEntry, &Parent->Children) {
-    D = EXT4_DENTRY_FROM_DENTRY_LIST (Entry);
-
-    if (D == ToBeRemoved) {
-      RemoveEntryList (Entry);
-      return;
+  for ( ; *Name != L'\0'; Name++) {
+    // Be conservative with anything outside of ASCII, since the collation
+    // protocol may fold it
+    if ((*Name >= 0x80) || ((*Name >= L'a') && (*Name <= L'z')) || ((*Name >= L'A') && (*Name <= L'Z'))) {
+      return TRUE;
     }
   }
 
-  DEBUG ((DEBUG_ERROR, "[ext4] Ext4RemoveDentry did not find the asked-for dentry\n"));
+  return FALSE;
 }
 
 /**
-   Adds a dentry to the other's list.
+   Retrieves a directory entry.
 
-   The dentry that is added to the other one's list gets ->Parent set to Parent,
-   and the parent gets its reference count incremented.
+   Indexed directories are looked up through their hash tree first. The on-disk
+   hash is calculated over the exact name, so when that misses, names that
+   could match with different case still need a linear scan of the directory;
+   Ext4OpenFile's negative dentries keep repeated misses from paying for it twice.
+   Names without any foldable characters (e.g "1234.bin") can only match
+   exactly, and are reported as missing right away.
 
-   @param[in out]            Parent       Pointer to the parent EXT4_DENTRY.
-   @param[in out]            ToBeAdded    Pointer to the child EXT4_DENTRY.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      NameUnicode Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @return The result of the operation.
 **/
-STATIC
-VOID
-Ext4AddDentry (
-  IN OUT EXT4_DENTRY  *Parent,
-  IN OUT EXT4_DENTRY  *ToBeAdded
+EFI_STATUS
+Ext4RetrieveDirent (
+  IN EXT4_FILE        *Directory,
+  IN CONST CHAR16     *Name,
+  IN EXT4_PARTITION   *Partition,
+  OUT EXT4_DIR_ENTRY  *Result
   )
 {
-  ToBeAdded->Parent = Parent;
-  InsertTailList (&Parent->Children, &ToBeAdded->ListNode);
-  Ext4RefDentry (Parent);
-}
+  EFI_STATUS  Status;
+  CHAR8       *Buf;
+  UINT64      Off;
+  EXT4_INODE  *Inode;
+  UINT64      DirInoSize;
+  UINT32      BlockRemainder;
+  UINTN       Length;
 
-/**
-   Creates a new dentry object.
+  Off = 0;
 
-   @param[in]              Name        Name of the dentry.
-   @param[in out opt]      Parent      Parent dentry, if it's not NULL.
+  Inode      = Directory->Inode;
+  DirInoSize = EXT4_INODE_SIZE (Inode);
 
-   @return The new allocated and initialised dentry.
-           The ref count will be set to 1.
-**/
-EXT4_DENTRY *
-Ext4CreateDentry (
-  IN CONST CHAR16              *Name,
-  IN OUT EXT4_DENTRY  *Parent  OPTIONAL
-  )
-{
-  EXT4_DENTRY  *Dentry;
-  EFI_STATUS   Status;
+  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
+  if (BlockRemainder != 0) {
+    // Directory inodes need to have block aligned sizes
+    return EFI_VOLUME_CORRUPTED;
+  }
 
-  Dentry = AllocateZeroPool (sizeof (EXT4_DENTRY));
+  Buf = AllocatePool (Partition->BlockSize);
 
-  if (Dentry == NULL) {
-    return NULL;
+  if (Buf == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  Dentry->RefCount = 1;
-
-  // This StrCpyS should not fail.
-  Status = StrCpyS (Dentry->Name, ARRAY_SIZE (Dentry->Name), Name);
+  // "." and ".." aren't in the index; they're in front of it, at the start of the first block
+  if (EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_DIR_INDEX) &&
+      ((Inode->i_flags & EXT4_INDEX_FL) != 0) &&
+      (StrCmp (Name, L".") != 0) && (StrCmp (Name, L"..") != 0))
+  {
+    Status = Ext4HtreeLookup (Directory, Name, Partition, Buf, Result);
 
-  ASSERT_EFI_ERROR (Status);
+    if ((Status == EFI_SUCCESS) || (Status == EFI_OUT_OF_RESOURCES) || (Status == EFI_DEVICE_ERROR)) {
+      FreePool (Buf);
+      return Status;
+    }
 
-  InitializeListHead (&Dentry->Children);
+    // Without anything to case-fold, the index already had the only possible match
+    if ((Status == EFI_NOT_FOUND) && !Ext4NameHasFoldableCase (Name)) {
+      FreePool (Buf);
+      return Status;
+    }
 
-  if (Parent != NULL) {
-    Ext4AddDentry (Parent, Dentry);
+    // Like Linux, treat a bad index as if it didn't exist; the directory's
+    // blocks are still valid linear directory blocks. EFI_NOT_FOUND also gets
+    // here, since we may still have a case-insensitive match.
+    if (Status != EFI_NOT_FOUND) {
+      DEBUG ((DEBUG_WARN, "[ext4] htree lookup failed (%r), falling back to a linear scan\n", Status));
+    }
   }
 
-  DEBUG ((DEBUG_FS, "[ext4] Created dentry %s\n", Name));
+  while (Off < DirInoSize) {
+    Length = Partition->BlockSize;
 
-  return Dentry;
-}
+    Status = Ext4Read (Partition, Directory, Buf, Off, &Length);
 
-/**
-   Increments the ref count of the dentry.
+    if (Status != EFI_SUCCESS) {
+      FreePool (Buf);
+      return Status;
+    }
 
-   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
-**/
-VOID
-Ext4RefDentry (
-  IN OUT EXT4_DENTRY  *Dentry
-  )
-{
-  UINTN  OldRef;
+    Status = Ext4SearchDirBlock (Partition, Buf, Name, Result);
 
-  OldRef = Dentry->RefCount;
+    if (Status != EFI_NOT_FOUND) {
+      FreePool (Buf);
+      return Status;
+    }
 
-  Dentry->RefCount++;
+    Off += Partition->BlockSize;
+  }
 
-  // I'm not sure if this (Refcount overflow) is a valid concern,
-  // but it's better to be safe than sorry.
-  ASSERT (OldRef < Dentry->RefCount);
+  FreePool (Buf);
+  return EFI_NOT_FOUND;
 }
 
 /**
-   Deletes the dentry.
+   Opens a file using a dentry.
 
-   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      OpenMode    Mode in which the file is supposed to be open.
+   @param[out]     OutFile     Pointer to the newly opened file.
+   @param[in]      Dentry      Referenced dentry of the file. The reference is
+                               consumed, even if the open fails.
+   @param[in]      InodeNum    Inode number of the file.
+
+   @retval EFI_STATUS          Result of the operation
 **/
 STATIC
-VOID
-Ext4DeleteDentry (
-  IN OUT EXT4_DENTRY  *Dentry
+EFI_STATUS
+Ext4OpenDentry (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT64          OpenMode,
+  OUT EXT4_FILE       **OutFile,
+  IN  EXT4_DENTRY     *Dentry,
+  IN  EXT4_INO_NR     InodeNum
   )
 {
-  if (Dentry->Parent) {
-    Ext4RemoveDentry (Dentry->Parent, Dentry);
-    Ext4UnrefDentry (Dentry->Parent);
-  }
+  EFI_STATUS  Status;
+  EXT4_FILE   *File;
 
-  DEBUG ((DEBUG_FS, "[ext4] Deleted dentry %s\n", Dentry->Name));
-  FreePool (Dentry);
-}
+  File = AllocateZeroPool (sizeof (EXT4_FILE));
+
+  if (File == NULL) {
+    Ext4UnrefDentry (Dentry);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  File->Dentry   = Dentry;
+  File->InodeNum = InodeNum;
+
+  Ext4SetupFile (File, Partition);
+
+  Status = Ext4InitExtentsMap (File);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  Status = Ext4ReadInode (Partition, InodeNum, &File->Inode);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  *OutFile = File;
+
+  InsertTailList (&Partition->OpenFiles, &File->OpenFilesListNode);
+
+  return EFI_SUCCESS;
+
+Error:
+  Ext4UnrefDentry (File->Dentry);
+
+  Ext4FreeExtentsMap (File);
+
+  FreePool (File);
+
+  return Status;
+}
+
+/**
+   Opens a file using a directory entry.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      OpenMode    Mode in which the file is supposed to be open.
+   @param[out]     OutFile     Pointer to the newly opened file.
+   @param[in]      Entry       Directory entry to be used.
+   @param[in]      Directory   Pointer to the opened directory.
+
+   @retval EFI_STATUS          Result of the operation
+**/
+EFI_STATUS
+Ext4OpenDirent (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT64          OpenMode,
+  OUT EXT4_FILE       **OutFile,
+  IN  EXT4_DIR_ENTRY  *Entry,
+  IN  EXT4_FILE       *Directory
+  )
+{
+  EFI_STATUS   Status;
+  CHAR16       FileName[EXT4_NAME_MAX + 1];
+  EXT4_DENTRY  *Dentry;
+
+  Status = Ext4GetUcs2DirentName (Entry, FileName);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (StrCmp (FileName, L".") == 0) {
+    // We're using the parent directory's dentry
+    Dentry = Directory->Dentry;
+
+    ASSERT (Dentry != NULL);
+
+    Ext4RefDentry (Dentry);
+  } else if (StrCmp (FileName, L"..") == 0) {
+    // Using the parent's parent's dentry
+    Dentry = Directory->Dentry->Parent;
+
+    ASSERT (Dentry != NULL);
+
+    Ext4RefDentry (Dentry);
+  } else {
+    Dentry = Ext4GetDentry (Partition, Directory->Dentry, FileName, Entry->inode);
+
+    if (Dentry == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  return Ext4OpenDentry (Partition, OpenMode, OutFile, Dentry, Entry->inode);
+}
+
+/**
+   Opens a file.
+
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      OpenMode    Mode in which the file is supposed to be open.
+   @param[out]     OutFile     Pointer to the newly opened file.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4OpenFile (
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT64          OpenMode,
+  OUT EXT4_FILE       **OutFile
+  )
+{
+  EXT4_DIR_ENTRY  Entry;
+  EFI_STATUS      Status;
+  EXT4_DENTRY     *Dentry;
+  BOOLEAN         Cacheable;
+
+  // "." and ".." don't name new dentries, so they don't go through the dentry cache
+  Cacheable = StrCmp (Name, L".") != 0 && StrCmp (Name, L"..") != 0;
+
+  if (Cacheable) {
+    Dentry = Ext4LookupDentry (Directory->Dentry, Name);
+
+    if (Dentry != NULL) {
+      if (Dentry->Inode == 0) {
+        // Negative dentry, we already know the file doesn't exist
+        Ext4UnrefDentry (Dentry);
+        return EFI_NOT_FOUND;
+      }
+
+      return Ext4OpenDentry (Partition, OpenMode, OutFile, Dentry, Dentry->Inode);
+    }
+  }
+
+  Status = Ext4RetrieveDirent (Directory, Name, Partition, &Entry);
+
+  if (EFI_ERROR (Status)) {
+    if ((Status == EFI_NOT_FOUND) && Cacheable) {
+      // Remember the miss, so that probing for the same file again (e.g optional
+      // configuration files) doesn't need to scan the directory. Failing to do so is harmless.
+      Dentry = Ext4CreateDentry (Partition, Name, 0, Directory->Dentry);
+
+      if (Dentry != NULL) {
+        Ext4UnrefDentry (Dentry);
+      }
+    }
+
+    return Status;
+  }
+
+  // EFI requires us to error out on ".." opens for the root directory
+  if (Entry.inode == Directory->InodeNum) {
+    return EFI_NOT_FOUND;
+  }
+
+  return Ext4OpenDirent (Partition, OpenMode, OutFile, &Entry, Directory);
+}
+
+/**
+  Open the root directory on a volume.
+
+  @param[in]   This A pointer to the volume to open the root directory.
+  @param[out]  Root A pointer to the location to return the opened file handle for the
+                    root directory.
+
+  @retval EFI_SUCCESS          The device was opened.
+  @retval EFI_UNSUPPORTED      This volume does not support the requested file system type.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_ACCESS_DENIED    The service denied access to the file.
+  @retval EFI_OUT_OF_RESOURCES The volume was not opened due to lack of resources.
+  @retval EFI_MEDIA_CHANGED    The device has a different medium in it or the medium is no
+                               longer supported. Any existing file handles for this volume are
+                               no longer valid. To access the files on the new medium, the
+                               volume must be reopened with OpenVolume().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4OpenVolume (
+  IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL               **Root
+  )
+{
+  EXT4_INODE      *RootInode;
+  EFI_STATUS      Status;
+  EXT4_FILE       *RootDir;
+  EXT4_PARTITION  *Partition;
+
+  Partition = (EXT4_PARTITION *)This;
+
+  Status = Ext4ReadInode (Partition, EXT4_ROOT_INODE_NR, &RootInode);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Could not open root inode - error %r\n", Status));
+    return Status;
+  }
+
+  // Everything else assumes the root is a directory
+  if ((RootInode->i_mode & EXT4_INO_TYPE_MASK) != EXT4_INO_TYPE_DIR) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Root inode is not a directory\n"));
+    FreePool (RootInode);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  RootDir = AllocateZeroPool (sizeof (EXT4_FILE));
+
+  if (RootDir == NULL) {
+    FreePool (RootInode);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  RootDir->Inode    = RootInode;
+  RootDir->InodeNum = EXT4_ROOT_INODE_NR;
+
+  Ext4SetupFile (RootDir, Partition);
+
+  Status = Ext4InitExtentsMap (RootDir);
+
+  if (EFI_ERROR (Status)) {
+    FreePool (RootInode);
+    FreePool (RootDir);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *Root = &RootDir->Protocol;
+
+  InsertTailList (&Partition->OpenFiles, &RootDir->OpenFilesListNode);
+
+  ASSERT (Partition->RootDentry != NULL);
+  RootDir->Dentry = Partition->RootDentry;
+
+  Ext4RefDentry (RootDir->Dentry);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads a directory entry.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      File        Pointer to the open directory.
+   @param[out]     Buffer      Pointer to the output buffer.
+   @param[in]      Offset      Initial directory position.
+   @param[in out] OutLength    Pointer to a UINTN that contains the length of the buffer,
+                               and the length of the actual EFI_FILE_INFO after the call.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ReadDir (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  OUT VOID           *Buffer,
+  IN UINT64          Offset,
+  IN OUT UINTN       *OutLength
+  )
+{
+  EXT4_INODE      *DirIno;
+  EFI_STATUS      Status;
+  UINT64          DirInoSize;
+  UINTN           Len;
+  UINT32          BlockRemainder;
+  EXT4_DIR_ENTRY  Entry;
+  EXT4_FILE       *TempFile;
+  BOOLEAN         ShouldSkip;
+  BOOLEAN         IsDotOrDotDot;
+
+  DirIno     = File->Inode;
+  Status     = EFI_SUCCESS;
+  DirInoSize = EXT4_INODE_SIZE (DirIno);
+
+  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
+  if (BlockRemainder != 0) {
+    // Directory inodes need to have block aligned sizes
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  while (TRUE) {
+    TempFile = NULL;
+
+    // We (try to) read the maximum size of a directory entry at a time
+    // Note that we don't need to read any padding that may exist after it.
+    Len    = sizeof (Entry);
+    Status = Ext4Read (Partition, File, &Entry, Offset, &Len);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    if (Len == 0) {
+      *OutLength = 0;
+      Status     = EFI_SUCCESS;
+      goto Out;
+    }
+
+    if (Len < EXT4_MIN_DIR_ENTRY_LEN) {
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Out;
+    }
+
+    // Invalid directory entry length
+    if (!Ext4ValidDirent (&Entry)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Invalid dirent at offset %lu\n", Offset));
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Out;
+    }
+
+    // Check if the entire dir entry length fits in Len
+    if (Len < (UINTN)(EXT4_MIN_DIR_ENTRY_LEN + Entry.name_len)) {
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Out;
+    }
+
+    // We don't care about passing . or .. entries to the caller of ReadDir(),
+    // since they're generally useless entries *and* may break things if too
+    // many callers assume FAT32.
+
+    // Entry.name_len may be 0 if it's a nameless entry, like an unused entry
+    // or a checksum at the end of the directory block.
+    // Compare the exact lengths, so we never read past the end of the "." or ".." literals.
+
+    IsDotOrDotDot = (Entry.name_len == 1 && Entry.name[0] == '.') ||
+                    (Entry.name_len == 2 && CompareMem (Entry.name, "..", 2) == 0);
+
+    // When inode = 0, it's unused.
+    ShouldSkip = Entry.inode == 0 || IsDotOrDotDot;
+
+    if (ShouldSkip) {
+      Offset += Entry.rec_len;
+      continue;
+    }
+
+    Status = Ext4OpenDirent (Partition, EFI_FILE_MODE_READ, &TempFile, &Entry, File);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    Status = Ext4GetFileInfo (TempFile, Buffer, OutLength);
+    if (!EFI_ERROR (Status)) {
+      File->Position = Offset + Entry.rec_len;
+    }
+
+    Ext4CloseInternal (TempFile);
+
+    goto Out;
+  }
+
+  Status = EFI_SUCCESS;
+Out:
+  return Status;
+}
+
+/**
+   Calculates the hash of a dentry name, used to index the parent's children.
+   The hash is case-insensitive, as EFI file name lookups are.
+
+   @param[in]                Name         Pointer to the name.
+
+   @return The index of the hash bucket.
+**/
+STATIC
+UINTN
+Ext4DentryHash (
+  IN CONST CHAR16  *Name
+  )
+{
+  UINT32  Hash;
+
+  // FNV-1a over the upper-cased name
+  Hash = 0x811C9DC5;
+
+  while (*Name != L'\0') {
+    Hash ^= CharToUpper (*Name);
+    Hash *= 0x01000193;
+    Name++;
+  }
+
+  return Hash % EXT4_DENTRY_HASH_BUCKETS;
+}
+
+/**
+   Removes a dentry from the other's list.
+
+   @param[in out]            Parent       Pointer to the parent EXT4_DENTRY.
+   @param[in out]            ToBeRemoved  Pointer to the child EXT4_DENTRY.
+**/
+STATIC
+VOID
+Ext4RemoveDentry (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN OUT EXT4_DENTRY  *ToBeRemoved
+  )
+{
+  EXT4_DENTRY  *D;
+  LIST_ENTRY   *Entry;
+  LIST_ENTRY   *NextEntry;
+
+  if (Parent->Children != NULL) {
+    BASE_LIST_FOR_EACH_SAFE (Entry, NextEntry, &Parent->Children[Ext4DentryHash (ToBeRemoved->Name)]) {
+      D = EXT4_DENTRY_FROM_DENTRY_LIST (Entry);
+
+      if (D == ToBeRemoved) {
+        RemoveEntryList (Entry);
+        return;
+      }
+    }
+  }
+
+  DEBUG ((DEBUG_ERROR, "[ext4] Ext4RemoveDentry did not find the asked-for dentry\n"));
+}
+
+/**
+   Adds a dentry to the other's list.
+
+   The dentry that is added to the other one's list gets ->Parent set to Parent,
+   and the parent gets its reference count incremented.
+
+   @param[in out]            Parent       Pointer to the parent EXT4_DENTRY.
+   @param[in out]            ToBeAdded    Pointer to the child EXT4_DENTRY.
+
+   @retval EFI_SUCCESS           The dentry was added.
+   @retval EFI_OUT_OF_RESOURCES  The parent's hash table could not be allocated.
+**/
+STATIC
+EFI_STATUS
+Ext4AddDentry (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN OUT EXT4_DENTRY  *ToBeAdded
+  )
+{
+  UINTN  Index;
+
+  if (Parent->Children == NULL) {
+    Parent->Children = AllocatePool (EXT4_DENTRY_HASH_BUCKETS * sizeof (LIST_ENTRY));
+
+    if (Parent->Children == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (Index = 0; Index < EXT4_DENTRY_HASH_BUCKETS; Index++) {
+      InitializeListHead (&Parent->Children[Index]);
+    }
+  }
+
+  ToBeAdded->Parent = Parent;
+  InsertHeadList (&Parent->Children[Ext4DentryHash (ToBeAdded->Name)], &ToBeAdded->ListNode);
+  Ext4RefDentry (Parent);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Creates a new dentry object.
+
+   @param[in]              Partition   Pointer to the opened partition.
+   @param[in]              Name        Name of the dentry.
+   @param[in]              Inode       Inode number of the dentry, or 0 if it's a negative dentry.
+   @param[in out opt]      Parent      Parent dentry, if it's not NULL.
+
+   @return The new allocated and initialised dentry.
+           The ref count will be set to 1.
+**/
+EXT4_DENTRY *
+Ext4CreateDentry (
+  IN EXT4_PARTITION            *Partition,
+  IN CONST CHAR16              *Name,
+  IN EXT4_INO_NR               Inode,
+  IN OUT EXT4_DENTRY  *Parent  OPTIONAL
+  )
+{
+  EXT4_DENTRY  *Dentry;
+  EFI_STATUS   Status;
+
+  Dentry = AllocateZeroPool (sizeof (EXT4_DENTRY));
+
+  if (Dentry == NULL) {
+    return NULL;
+  }
+
+  Dentry->RefCount  = 1;
+  Dentry->Inode     = Inode;
+  Dentry->Partition = Partition;
+
+  // This StrCpyS should not fail.
+  Status = StrCpyS (Dentry->Name, ARRAY_SIZE (Dentry->Name), Name);
+
+  ASSERT_EFI_ERROR (Status);
+
+  if (Parent != NULL) {
+    Status = Ext4AddDentry (Parent, Dentry);
+
+    if (EFI_ERROR (Status)) {
+      FreePool (Dentry);
+      return NULL;
+    }
+  }
+
+  DEBUG ((DEBUG_FS, "[ext4] Created dentry %s\n", Name));
+
+  return Dentry;
+}
+
+/**
+   Increments the ref count of the dentry.
+
+   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
+**/
+VOID
+Ext4RefDentry (
+  IN OUT EXT4_DENTRY  *Dentry
+  )
+{
+  UINTN  OldRef;
+
+  OldRef = Dentry->RefCount;
+
+  // Unused dentries get taken out of the cache's LRU list once they're used again
+  if (OldRef == 0) {
+    RemoveEntryList (&Dentry->UnusedNode);
+    Dentry->Partition->DentryCache.NumUnused--;
+  }
+
+  Dentry->RefCount++;
+
+  // I'm not sure if this (Refcount overflow) is a valid concern,
+  // but it's better to be safe than sorry.
+  ASSERT (OldRef < Dentry->RefCount);
+}
+
+/**
+   Looks up a name in the dentry cache.
+
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Name to look up, compared case-insensitively.
+
+   @return A referenced dentry (which may be negative), or NULL if the name isn't cached.
+**/
+EXT4_DENTRY *
+Ext4LookupDentry (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name
+  )
+{
+  EXT4_DENTRY  *D;
+  EXT4_DENTRY  *Found;
+  LIST_ENTRY   *Entry;
+
+  if (Parent->Children == NULL) {
+    return NULL;
+  }
+
+  Found = NULL;
+
+  // Prefer an exact match, if there's one. Otherwise, any case-insensitive match
+  // is as good as the one a directory scan would return.
+  BASE_LIST_FOR_EACH (Entry, &Parent->Children[Ext4DentryHash (Name)]) {
+    D = EXT4_DENTRY_FROM_DENTRY_LIST (Entry);
+
+    if (StrCmp (D->Name, Name) == 0) {
+      Found = D;
+      break;
+    }
+
+    if ((Found == NULL) && (Ext4StrCmpInsensitive (D->Name, (CHAR16 *)Name) == 0)) {
+      Found = D;
+    }
+  }
+
+  if (Found != NULL) {
+    Ext4RefDentry (Found);
+  }
+
+  return Found;
+}
+
+/**
+   Gets the positive dentry for a name, creating it if it isn't cached yet.
+
+   @param[in]              Partition   Pointer to the opened partition.
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Exact (on-disk) name of the dentry.
+   @param[in]              Inode       Inode number the name points to.
+
+   @return A referenced dentry, or NULL if we ran out of memory.
+**/
+EXT4_DENTRY *
+Ext4GetDentry (
+  IN EXT4_PARTITION   *Partition,
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name,
+  IN EXT4_INO_NR      Inode
+  )
+{
+  EXT4_DENTRY  *D;
+  LIST_ENTRY   *Entry;
+
+  if (Parent->Children != NULL) {
+    BASE_LIST_FOR_EACH (Entry, &Parent->Children[Ext4DentryHash (Name)]) {
+      D = EXT4_DENTRY_FROM_DENTRY_LIST (Entry);
+
+      if (StrCmp (D->Name, Name) == 0) {
+        // Negative dentries for this exact name are now stale.
+        D->Inode = Inode;
+        Ext4RefDentry (D);
+        return D;
+      }
+    }
+  }
+
+  return Ext4CreateDentry (Partition, Name, Inode, Parent);
+}
+
+/**
+   Deletes the dentry.
+
+   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
+**/
+STATIC
+VOID
+Ext4DeleteDentry (
+  IN OUT EXT4_DENTRY  *Dentry
+  )
+{
+  if (Dentry->Parent) {
+    // Detached dentries were already taken out of the parent's list
+    if (!IsListEmpty (&Dentry->ListNode)) {
+      Ext4RemoveDentry (Dentry->Parent, Dentry);
+    }
+
+    Ext4UnrefDentry (Dentry->Parent);
+  }
+
+  DEBUG ((DEBUG_FS, "[ext4] Deleted dentry %s\n", Dentry->Name));
+
+  if (Dentry->Children != NULL) {
+    FreePool (Dentry->Children);
+  }
+
+  FreePool (Dentry);
+}
+
+/**
+   Evicts the least recently used dentry from the partition's dentry cache.
+
+   @param[in out]          Partition   Pointer to the opened partition.
+**/
+STATIC
+VOID
+Ext4EvictDentry (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_DENTRY_CACHE  *Cache;
+  EXT4_DENTRY        *Dentry;
+
+  Cache = &Partition->DentryCache;
+
+  ASSERT (!IsListEmpty (&Cache->UnusedList));
+
+  Dentry = EXT4_DENTRY_FROM_UNUSED_LIST (GetPreviousNode (&Cache->UnusedList, &Cache->UnusedList));
+  RemoveEntryList (&Dentry->UnusedNode);
+  Cache->NumUnused--;
+
+  // Note that unused dentries never have children, since those hold a reference.
+  // This may put the parent in the unused list.
+  Ext4DeleteDentry (Dentry);
+}
+
+/**
+   Frees every unused dentry in the partition's dentry cache.
+
+   @param[in out]          Partition   Pointer to the opened partition.
+**/
+VOID
+Ext4PurgeDentryCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  while (!IsListEmpty (&Partition->DentryCache.UnusedList)) {
+    Ext4EvictDentry (Partition);
+  }
+}
+
+/**
+   Decrements the ref count of the dentry.
+   If the ref count is 0, it's moved to the partition's dentry cache, or
+   destroyed if it can't be cached.
+
+   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
+
+   @retval True if it was destroyed, false if it's alive.
+**/
+BOOLEAN
+Ext4UnrefDentry (
+  IN OUT EXT4_DENTRY  *Dentry
+  )
+{
+  EXT4_DENTRY_CACHE  *Cache;
+
+  Cache = &Dentry->Partition->DentryCache;
+
+  Dentry->RefCount--;
+
+  if (Dentry->RefCount != 0) {
+    return FALSE;
+  }
+
+  // The root dentry is owned by the partition, detached dentries can't be looked up
+  // anymore, and nothing gets cached while we're tearing everything down.
+  if ((Dentry->Parent == NULL) || IsListEmpty (&Dentry->ListNode) ||
+      (Cache->MaxUnused == 0) || Dentry->Partition->Unmounting)
+  {
+    Ext4DeleteDentry (Dentry);
+    return TRUE;
+  }
+
+  InsertHeadList (&Cache->UnusedList, &Dentry->UnusedNode);
+  Cache->NumUnused++;
+
+  while (Cache->NumUnused > Cache->MaxUnused) {
+    Ext4EvictDentry (Dentry->Partition);
+  }
+
+  return FALSE;
+}
+
+/**
+   Takes a dentry out of its parent's list, so it can't be looked up anymore.
+   It keeps its reference to the parent until it's deleted.
+
+   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY, which has a parent.
+**/
+STATIC
+VOID
+Ext4DetachDentry (
+  IN OUT EXT4_DENTRY  *Dentry
+  )
+{
+  if (IsListEmpty (&Dentry->ListNode)) {
+    return;
+  }
+
+  Ext4RemoveDentry (Dentry->Parent, Dentry);
+  InitializeListHead (&Dentry->ListNode);
+}
+
+/**
+   Drops the negative dentries of a name, after a file with that name was created.
+
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Name of the new file, compared case-insensitively.
+**/
+VOID
+Ext4DropNegativeDentries (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name
+  )
+{
+  EXT4_DENTRY  *D;
+  LIST_ENTRY   *Entry;
+  LIST_ENTRY   *NextEntry;
+
+  if (Parent->Children == NULL) {
+    return;
+  }
+
+  BASE_LIST_FOR_EACH_SAFE (Entry, NextEntry, &Parent->Children[Ext4DentryHash (Name)]) {
+    D = EXT4_DENTRY_FROM_DENTRY_LIST (Entry);
+
+    if ((D->Inode != 0) || (Ext4StrCmpInsensitive (D->Name, (CHAR16 *)Name) != 0)) {
+      continue;
+    }
+
+    Ext4DetachDentry (D);
+
+    // Unused dentries are only kept alive by the cache
+    if (D->RefCount == 0) {
+      RemoveEntryList (&D->UnusedNode);
+      D->Partition->DentryCache.NumUnused--;
+      Ext4DeleteDentry (D);
+    }
+  }
+}
+
+/**
+   Moves a dentry to a new parent and name, after its file was renamed.
+
+   @param[in out]          Dentry      Dentry of the renamed file.
+   @param[in out]          NewParent   Dentry of the file's new parent directory.
+   @param[in]              NewName     New name of the file.
+
+   @retval EFI_SUCCESS           The dentry was moved.
+   @retval EFI_OUT_OF_RESOURCES  The new parent's hash table could not be allocated. The
+                                 dentry was detached instead.
+**/
+EFI_STATUS
+Ext4RenameDentry (
+  IN OUT EXT4_DENTRY  *Dentry,
+  IN OUT EXT4_DENTRY  *NewParent,
+  IN CONST CHAR16     *NewName
+  )
+{
+  EFI_STATUS   Status;
+  EXT4_DENTRY  *OldParent;
+
+  Ext4DropNegativeDentries (NewParent, NewName);
+
+  OldParent = Dentry->Parent;
+
+  ASSERT (OldParent != NULL);
+
+  Ext4DetachDentry (Dentry);
+
+  // This StrCpyS should not fail.
+  Status = StrCpyS (Dentry->Name, ARRAY_SIZE (Dentry->Name), NewName);
+
+  ASSERT_EFI_ERROR (Status);
+
+  Status = Ext4AddDentry (NewParent, Dentry);
+
+  if (EFI_ERROR (Status)) {
+    // Stay detached, still holding on to the old parent
+    return Status;
+  }
+
+  Ext4UnrefDentry (OldParent);
+
+  return EFI_SUCCESS;
+}
+
+// Length a directory entry with a name of NameLength bytes needs
+#define EXT4_DIR_REC_LEN(NameLength)  ALIGN_VALUE (EXT4_MIN_DIR_ENTRY_LEN + (NameLength), 4)
+
+// New files get rw-r--r--, and new directories rwxr-xr-x
+#define EXT4_NEW_FILE_MODE  0644
+#define EXT4_NEW_DIR_MODE   0755
+
+// Directories with more links than this (or with an unknown number of them, on
+// filesystems with dir_nlink) have i_links set to 1
+#define EXT4_LINK_MAX  65000
+
+/**
+   Checks if a directory is indexed by an htree.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+
+   @return TRUE if the directory is indexed.
+**/
+STATIC
+BOOLEAN
+Ext4DirIsIndexed (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN CONST EXT4_FILE       *Directory
+  )
+{
+  return EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_DIR_INDEX) &&
+         ((Directory->Inode->i_flags & EXT4_INDEX_FL) != 0);
+}
+
+/**
+   Checks if a block of an indexed directory is an index node, rather than a leaf.
+   Index nodes start with an unused dirent covering the whole block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+
+   @return TRUE if the block is an index node.
+**/
+STATIC
+BOOLEAN
+Ext4IsDxNodeBlock (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN CONST CHAR8           *Block
+  )
+{
+  CONST EXT4_DIR_ENTRY  *Entry;
+
+  Entry = (CONST EXT4_DIR_ENTRY *)Block;
+
+  return Entry->inode == 0 && Entry->rec_len == Partition->BlockSize;
+}
+
+/**
+   Gets the end of the directory entries of a linear directory block, where
+   the EXT4_DIR_ENTRY_TAIL starts on metadata_csum filesystems.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+
+   @return The offset of the end of the entries.
+**/
+STATIC
+UINTN
+Ext4DirBlockEnd (
+  IN CONST EXT4_PARTITION  *Partition
+  )
+{
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    return Partition->BlockSize - sizeof (EXT4_DIR_ENTRY_TAIL);
+  }
+
+  return Partition->BlockSize;
+}
+
+/**
+   Initialises an empty linear directory block: a single unused entry, and the tail.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Block       Pointer to the directory block.
+**/
+STATIC
+VOID
+Ext4InitDirBlock (
+  IN  CONST EXT4_PARTITION  *Partition,
+  OUT CHAR8                 *Block
+  )
+{
+  EXT4_DIR_ENTRY       *Entry;
+  EXT4_DIR_ENTRY_TAIL  *Tail;
+  UINTN                End;
+
+  End = Ext4DirBlockEnd (Partition);
+
+  ZeroMem (Block, Partition->BlockSize);
+
+  Entry          = (EXT4_DIR_ENTRY *)Block;
+  Entry->rec_len = (UINT16)End;
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Tail                  = (EXT4_DIR_ENTRY_TAIL *)(Block + End);
+    Tail->det_rec_len     = sizeof (EXT4_DIR_ENTRY_TAIL);
+    Tail->det_reserved_ft = EXT4_DIR_ENTRY_TAIL_FT;
+  }
+}
+
+/**
+   Validates a linear directory block before it's modified: the entries need to
+   cover the block exactly, and the tail needs to be there.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+
+   @retval EFI_SUCCESS           The block is valid.
+   @retval EFI_VOLUME_CORRUPTED  The block is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4CheckDirBlock (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN CONST CHAR8           *Block
+  )
+{
+  CONST EXT4_DIR_ENTRY       *Entry;
+  CONST EXT4_DIR_ENTRY_TAIL  *Tail;
+  UINTN                      Offset;
+  UINTN                      End;
+
+  End = Ext4DirBlockEnd (Partition);
+
+  for (Offset = 0; Offset < End; Offset += Entry->rec_len) {
+    Entry = (CONST EXT4_DIR_ENTRY *)(Block + Offset);
+
+    if ((End - Offset < EXT4_MIN_DIR_ENTRY_LEN) || !Ext4ValidDirent (Entry) || (Entry->rec_len > End - Offset)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+  }
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Tail = (CONST EXT4_DIR_ENTRY_TAIL *)(Block + End);
+
+    if ((Tail->det_reserved_zero1 != 0) || (Tail->det_rec_len != sizeof (EXT4_DIR_ENTRY_TAIL)) ||
+        (Tail->det_reserved_zero2 != 0) || (Tail->det_reserved_ft != EXT4_DIR_ENTRY_TAIL_FT))
+    {
+      DEBUG ((DEBUG_ERROR, "[ext4] Directory block is missing its tail\n"));
+      return EFI_VOLUME_CORRUPTED;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Updates the checksum in a linear directory block's tail, after it was modified.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in out]  Block       Pointer to the directory block.
+**/
+STATIC
+VOID
+Ext4UpdateDirBlockChecksum (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN     CONST EXT4_FILE       *Directory,
+  IN OUT CHAR8                 *Block
+  )
+{
+  EXT4_DIR_ENTRY_TAIL  *Tail;
+  UINTN                End;
+  UINT32               Csum;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  End  = Ext4DirBlockEnd (Partition);
+  Tail = (EXT4_DIR_ENTRY_TAIL *)(Block + End);
+
+  Csum = Ext4CalculateChecksum (Partition, &Directory->InodeNum, sizeof (EXT4_INO_NR), Partition->InitialSeed);
+  Csum = Ext4CalculateChecksum (Partition, &Directory->Inode->i_generation, sizeof (Directory->Inode->i_generation), Csum);
+  Csum = Ext4CalculateChecksum (Partition, Block, End, Csum);
+
+  Tail->det_checksum = Csum;
+}
+
+/**
+   Updates the checksum of an htree index block, after it was modified.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in out]  Block       Pointer to the index block.
+   @param[in]      CountOffset Offset of the EXT4_DX_COUNT_LIMIT inside the block.
+**/
+STATIC
+VOID
+Ext4UpdateDxChecksum (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN     CONST EXT4_FILE       *Directory,
+  IN OUT CHAR8                 *Block,
+  IN     UINTN                 CountOffset
+  )
+{
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  EXT4_DX_TAIL         *Tail;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  CountLimit = (EXT4_DX_COUNT_LIMIT *)(Block + CountOffset);
+  Tail       = (EXT4_DX_TAIL *)(Block + CountOffset + CountLimit->limit * sizeof (EXT4_DX_ENTRY));
+
+  Tail->dt_checksum = Ext4CalculateDxChecksum (Partition, Directory, Block, CountOffset);
+}
+
+/**
+   Finds room for a new entry in a (validated) linear directory block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+   @param[in]      NameLength  Length of the new entry's name.
+   @param[out]     Offset      Offset of the entry the new one can be carved out of.
+
+   @return TRUE if there's room.
+**/
+STATIC
+BOOLEAN
+Ext4DirBlockFindSpace (
+  IN  CONST EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8           *Block,
+  IN  UINTN                 NameLength,
+  OUT UINTN                 *Offset
+  )
+{
+  CONST EXT4_DIR_ENTRY  *Entry;
+  UINTN                 End;
+  UINTN                 Used;
+
+  End = Ext4DirBlockEnd (Partition);
+
+  for (*Offset = 0; *Offset < End; *Offset += Entry->rec_len) {
+    Entry = (CONST EXT4_DIR_ENTRY *)(Block + *Offset);
+    Used  = Entry->inode != 0 ? EXT4_DIR_REC_LEN (Entry->name_len) : 0;
+
+    if (Entry->rec_len - Used >= EXT4_DIR_REC_LEN (NameLength)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+   Puts a new entry in a directory block, in the room found by Ext4DirBlockFindSpace.
+   Used entries get split, unused ones get reused.
+
+   @param[in out]  Block       Pointer to the directory block.
+   @param[in]      Offset      Offset of the entry to carve the new one out of.
+   @param[in]      NewEntry    Pointer to the new entry. Its rec_len is ignored.
+**/
+STATIC
+VOID
+Ext4DirBlockInsert (
+  IN OUT CHAR8                 *Block,
+  IN     UINTN                 Offset,
+  IN     CONST EXT4_DIR_ENTRY  *NewEntry
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  EXT4_DIR_ENTRY  *Split;
+  UINT16          Used;
+
+  Entry = (EXT4_DIR_ENTRY *)(Block + Offset);
+
+  if (Entry->inode != 0) {
+    Used           = (UINT16)EXT4_DIR_REC_LEN (Entry->name_len);
+    Split          = (EXT4_DIR_ENTRY *)(Block + Offset + Used);
+    Split->rec_len = Entry->rec_len - Used;
+    Entry->rec_len = Used;
+    Entry          = Split;
+  }
+
+  Entry->inode     = NewEntry->inode;
+  Entry->name_len  = NewEntry->name_len;
+  Entry->file_type = NewEntry->file_type;
+  CopyMem (Entry->name, NewEntry->name, NewEntry->name_len);
+}
+
+/**
+   Gets a block of a directory ready to be modified by the running transaction.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      Directory     Pointer to the opened directory.
+   @param[in]      LogicalBlock  Logical block number inside the directory.
+   @param[out]     Data          Pointer to where the pointer to the block's data is stored.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ModifyDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  UINT32          LogicalBlock,
+  OUT CHAR8           **Data
+  )
+{
+  EFI_STATUS   Status;
+  EXT4_EXTENT  Extent;
+
+  Status = Ext4GetExtent (Partition, Directory, LogicalBlock, &Extent, NULL);
+
+  // Directories can't have holes, and their blocks are always initialized
+  if ((Status == EFI_NO_MAPPING) || (!EFI_ERROR (Status) && EXT4_EXTENT_IS_UNINITIALIZED (&Extent))) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4ModifyBlock (
+           Partition,
+           (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + (LogicalBlock - Extent.ee_block),
+           FALSE,
+           (VOID **)Data
+           );
+}
+
+/**
+   Adds a block to the end of a directory, as part of the running transaction.
+   The directory's inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      Directory     Pointer to the opened directory.
+   @param[out]     LogicalBlock  Logical block number of the new block.
+   @param[out]     Data          Pointer to where the pointer to the (zeroed) block's data is stored.
+
+   @retval EFI_SUCCESS           The block was added.
+   @retval EFI_VOLUME_FULL       There's no space left, or the directory can't get any bigger.
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AppendDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT UINT32          *LogicalBlock,
+  OUT CHAR8           **Data
+  )
+{
+  EFI_STATUS     Status;
+  UINT64         Size;
+  UINT64         Block;
+  UINT32         Count;
+  EXT4_BLOCK_NR  Physical;
+  EXT4_EXTENT    Extent;
+
+  Size  = EXT4_INODE_SIZE (Directory->Inode) + Partition->BlockSize;
+  Block = DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+
+  // Without largedir, directories are limited to 2GiB. Either way, the index
+  // can't point to blocks past EXT4_DX_BLOCK_MASK.
+  if ((Block > EXT4_DX_BLOCK_MASK) ||
+      ((Size > MAX_INT32) && !EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_LARGEDIR)))
+  {
+    return EFI_VOLUME_FULL;
+  }
+
+  Count  = 1;
+  Status = Ext4AllocateBlocks (Partition, Ext4FileAllocationGoal (Partition, Directory, Block), &Count, &Physical);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ModifyBlock (Partition, Physical, TRUE, (VOID **)Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Extent.ee_block    = (UINT32)Block;
+  Extent.ee_len      = 1;
+  Extent.ee_start_hi = (UINT16)RShiftU64 (Physical, 32);
+  Extent.ee_start_lo = (UINT32)Physical;
+
+  Status = Ext4InodeAddBlocks (Partition, Directory->Inode, 1);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4InsertExtent (Partition, Directory, &Extent);
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Directory->Inode->i_size_lo = (UINT32)Size;
+  Directory->Inode->i_size_hi = (UINT32)RShiftU64 (Size, 32);
+
+  *LogicalBlock = (UINT32)Block;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds a directory entry to a linear directory, as part of the running transaction.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      NewEntry    Pointer to the new entry.
+   @param[in]      Buffer      Pointer to a scratch buffer, of size Partition->BlockSize.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4LinearAddDirent (
+  IN EXT4_PARTITION        *Partition,
+  IN EXT4_FILE             *Directory,
+  IN CONST EXT4_DIR_ENTRY  *NewEntry,
+  IN CHAR8                 *Buffer
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      NumBlocks;
+  UINT32      Block;
+  UINTN       Offset;
+  CHAR8       *Data;
+
+  NumBlocks = (UINT32)DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+
+  for (Block = 0; Block < NumBlocks; Block++) {
+    Status = Ext4ReadDirBlock (Partition, Directory, Buffer, Block);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4CheckDirBlock (Partition, Buffer);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Ext4DirBlockFindSpace (Partition, Buffer, NewEntry->name_len, &Offset)) {
+      Status = Ext4ModifyDirBlock (Partition, Directory, Block, &Data);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Ext4DirBlockInsert (Data, Offset, NewEntry);
+      Ext4UpdateDirBlockChecksum (Partition, Directory, Data);
+      return EFI_SUCCESS;
+    }
+  }
+
+  Status = Ext4AppendDirBlock (Partition, Directory, &Block, &Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Ext4InitDirBlock (Partition, Data);
+  Ext4DirBlockInsert (Data, 0, NewEntry);
+  Ext4UpdateDirBlockChecksum (Partition, Directory, Data);
+
+  return EFI_SUCCESS;
+}
+
+// One level of the index path an insertion goes through, as the transaction's copy of the node
+typedef struct {
+  CHAR8     *Node;
+  UINT32    LogicalBlock;
+  UINTN     CountOffset;
+  UINTN     Index;
+} EXT4_DX_PATH;
+
+#define EXT4_DX_PATH_COUNT_LIMIT(Path)  ((EXT4_DX_COUNT_LIMIT *)((Path)->Node + (Path)->CountOffset))
+#define EXT4_DX_PATH_ENTRIES(Path)      ((EXT4_DX_ENTRY *)((Path)->Node + (Path)->CountOffset))
+#define EXT4_DX_PATH_IS_FULL(Path)      (EXT4_DX_PATH_COUNT_LIMIT (Path)->count >= EXT4_DX_PATH_COUNT_LIMIT (Path)->limit)
+
+// A live entry of a leaf that's being split
+typedef struct {
+  UINT32    Hash;
+  UINT32    Offset;
+  UINT32    Size;
+} EXT4_DX_MAP_ENTRY;
+
+// EXT4_DX_MAP_ENTRY.Offset of the entry being added
+#define EXT4_DX_MAP_NEW_ENTRY  MAX_UINT32
+
+/**
+   Initialises a new htree interior node.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  Node        Pointer to the node, with its entries already in place.
+   @param[in]      Count       Number of entries in the node.
+**/
+STATIC
+VOID
+Ext4DxInitNode (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT CHAR8                 *Node,
+  IN     UINTN                 Count
+  )
+{
+  EXT4_DX_NODE         *Header;
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+
+  Header                 = (EXT4_DX_NODE *)Node;
+  Header->fake.inode     = 0;
+  Header->fake.rec_len   = (UINT16)Partition->BlockSize;
+  Header->fake.name_len  = 0;
+  Header->fake.file_type = 0;
+
+  CountLimit        = (EXT4_DX_COUNT_LIMIT *)(Node + sizeof (EXT4_DX_NODE));
+  CountLimit->limit = (UINT16)Ext4DxNodeLimit (Partition, sizeof (EXT4_DX_NODE));
+  CountLimit->count = (UINT16)Count;
+}
+
+/**
+   Inserts an entry into an htree index node, right after the entry the path follows.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in out]  Path        Level of the path the node is at. It must have room.
+   @param[in]      Hash        Smallest hash the new entry covers.
+   @param[in]      Block       Logical block the new entry points to.
+**/
+STATIC
+VOID
+Ext4DxInsertEntry (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN     CONST EXT4_FILE       *Directory,
+  IN OUT EXT4_DX_PATH          *Path,
+  IN     UINT32                Hash,
+  IN     UINT32                Block
+  )
+{
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  EXT4_DX_ENTRY        *Entries;
+  UINTN                Index;
+
+  CountLimit = EXT4_DX_PATH_COUNT_LIMIT (Path);
+  Entries    = EXT4_DX_PATH_ENTRIES (Path);
+  Index      = Path->Index + 1;
+
+  ASSERT (CountLimit->count < CountLimit->limit);
+
+  CopyMem (&Entries[Index + 1], &Entries[Index], (CountLimit->count - Index) * sizeof (EXT4_DX_ENTRY));
+
+  Entries[Index].hash  = Hash;
+  Entries[Index].block = Block;
+  CountLimit->count++;
+
+  Ext4UpdateDxChecksum (Partition, Directory, Path->Node, Path->CountOffset);
+}
+
+/**
+   Adds a level to an htree index whose root is full, moving the root's entries
+   to a new interior node.
+
+   @param[in]      Partition      Pointer to the ext4 partition.
+   @param[in]      Directory      Pointer to the opened directory.
+   @param[in out]  Path           Path of the insertion, which gets the new level.
+   @param[in out]  IndirectLevels Number of index levels under the root.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4DxAddLevel (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *Directory,
+  IN OUT EXT4_DX_PATH    *Path,
+  IN OUT UINT32          *IndirectLevels
+  )
+{
+  EFI_STATUS           Status;
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  UINT32               NewBlock;
+  CHAR8                *NewNode;
+  UINT32               Level;
+
+  Status = Ext4AppendDirBlock (Partition, Directory, &NewBlock, &NewNode);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CountLimit = EXT4_DX_PATH_COUNT_LIMIT (&Path[0]);
+
+  CopyMem (NewNode + sizeof (EXT4_DX_NODE), CountLimit, CountLimit->count * sizeof (EXT4_DX_ENTRY));
+  Ext4DxInitNode (Partition, NewNode, CountLimit->count);
+  Ext4UpdateDxChecksum (Partition, Directory, NewNode, sizeof (EXT4_DX_NODE));
+
+  CountLimit->count                       = 1;
+  EXT4_DX_PATH_ENTRIES (&Path[0])[0].block = NewBlock;
+  ((EXT4_DX_ROOT *)Path[0].Node)->info.indirect_levels++;
+  Ext4UpdateDxChecksum (Partition, Directory, Path[0].Node, Path[0].CountOffset);
+
+  for (Level = *IndirectLevels; Level > 0; Level--) {
+    Path[Level + 1] = Path[Level];
+  }
+
+  Path[1].Node         = NewNode;
+  Path[1].LogicalBlock = NewBlock;
+  Path[1].CountOffset  = sizeof (EXT4_DX_NODE);
+  Path[1].Index        = Path[0].Index;
+  Path[0].Index        = 0;
+
+  (*IndirectLevels)++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Splits a full htree interior node in two, adding an entry for the new one to its parent.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in out]  Path        Path of the insertion. It's updated to go through whichever
+                               half has the entry it was following.
+   @param[in]      Level       Level of the node. The level above it must have room.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4DxSplitNode (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *Directory,
+  IN OUT EXT4_DX_PATH    *Path,
+  IN     UINT32          Level
+  )
+{
+  EFI_STATUS           Status;
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  EXT4_DX_ENTRY        *Entries;
+  UINTN                Half;
+  UINT32               NewBlock;
+  CHAR8                *NewNode;
+
+  Status = Ext4AppendDirBlock (Partition, Directory, &NewBlock, &NewNode);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CountLimit = EXT4_DX_PATH_COUNT_LIMIT (&Path[Level]);
+  Entries    = EXT4_DX_PATH_ENTRIES (&Path[Level]);
+  Half       = CountLimit->count / 2;
+
+  // The first entry's hash gets overwritten by the count and limit, but it lives on in the parent
+  CopyMem (NewNode + sizeof (EXT4_DX_NODE), &Entries[Half], (CountLimit->count - Half) * sizeof (EXT4_DX_ENTRY));
+  Ext4DxInitNode (Partition, NewNode, CountLimit->count - Half);
+  Ext4UpdateDxChecksum (Partition, Directory, NewNode, sizeof (EXT4_DX_NODE));
+
+  CountLimit->count = (UINT16)Half;
+  Ext4UpdateDxChecksum (Partition, Directory, Path[Level].Node, Path[Level].CountOffset);
+
+  Ext4DxInsertEntry (Partition, Directory, &Path[Level - 1], Entries[Half].hash, NewBlock);
+
+  if (Path[Level].Index >= Half) {
+    Path[Level].Node         = NewNode;
+    Path[Level].LogicalBlock = NewBlock;
+    Path[Level].Index       -= Half;
+    Path[Level - 1].Index++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Packs directory entries into an empty linear directory block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Source      Pointer to the block the entries come from.
+   @param[in]      NewEntry    Pointer to the entry being added.
+   @param[in]      Map         Pointer to the entries to pack.
+   @param[in]      Count       Number of entries to pack. Must not be 0.
+   @param[out]     Block       Pointer to the destination block.
+**/
+STATIC
+VOID
+Ext4DxPackDirents (
+  IN  CONST EXT4_PARTITION     *Partition,
+  IN  CONST CHAR8              *Source,
+  IN  CONST EXT4_DIR_ENTRY     *NewEntry,
+  IN  CONST EXT4_DX_MAP_ENTRY  *Map,
+  IN  UINTN                    Count,
+  OUT CHAR8                    *Block
+  )
+{
+  CONST EXT4_DIR_ENTRY  *From;
+  EXT4_DIR_ENTRY        *Entry;
+  UINTN                 Index;
+  UINTN                 Offset;
+
+  Ext4InitDirBlock (Partition, Block);
+
+  Entry  = NULL;
+  Offset = 0;
+
+  for (Index = 0; Index < Count; Index++) {
+    if (Map[Index].Offset == EXT4_DX_MAP_NEW_ENTRY) {
+      From = NewEntry;
+    } else {
+      From = (CONST EXT4_DIR_ENTRY *)(Source + Map[Index].Offset);
+    }
+
+    Entry = (EXT4_DIR_ENTRY *)(Block + Offset);
+    CopyMem (Entry, From, EXT4_MIN_DIR_ENTRY_LEN + From->name_len);
+    Entry->rec_len = (UINT16)Map[Index].Size;
+    Offset        += Map[Index].Size;
+  }
+
+  // The last entry takes up the rest of the block
+  Entry->rec_len += (UINT16)(Ext4DirBlockEnd (Partition) - Offset);
+}
+
+/**
+   Splits a full htree leaf in two, adding the new entry to whichever half it belongs in.
+
+   The leaf's entries (and the new one) are sorted by hash, and the ones with the biggest
+   hashes, about half of them by size, are moved to a new leaf. If entries with the same
+   hash end up on both sides, the new leaf's index entry gets the collision bit, so lookups
+   keep going into it.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in out]  Parent      Last level of the insertion's path. It must have room.
+   @param[in]      HashVersion Hash algorithm of the index.
+   @param[in]      NewEntry    Pointer to the new entry.
+   @param[in]      Hash        Hash of the new entry's name.
+   @param[in]      Leaf        Pointer to a (validated) copy of the leaf.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4DxSplitLeaf (
+  IN     EXT4_PARTITION        *Partition,
+  IN     EXT4_FILE             *Directory,
+  IN OUT EXT4_DX_PATH          *Parent,
+  IN     UINT8                 HashVersion,
+  IN     CONST EXT4_DIR_ENTRY  *NewEntry,
+  IN     UINT32                Hash,
+  IN     CONST CHAR8           *Leaf
+  )
+{
+  EFI_STATUS            Status;
+  EXT4_DX_MAP_ENTRY     *Map;
+  EXT4_DX_MAP_ENTRY     Item;
+  CONST EXT4_DIR_ENTRY  *Entry;
+  UINTN                 Offset;
+  UINTN                 End;
+  UINTN                 Count;
+  UINTN                 Index;
+  UINTN                 Total;
+  UINTN                 Moved;
+  UINTN                 Split;
+  UINT32                SplitHash;
+  CHAR8                 *Data;
+  CHAR8                 *NewData;
+  UINT32                NewBlock;
+
+  End = Ext4DirBlockEnd (Partition);
+
+  // Entries take up at least EXT4_MIN_DIR_ENTRY_LEN bytes, and there's the new one
+  Map = AllocatePool ((End / EXT4_MIN_DIR_ENTRY_LEN + 1) * sizeof (EXT4_DX_MAP_ENTRY));
+
+  if (Map == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Count = 0;
+  Total = 0;
+
+  for (Offset = 0; Offset <= End; Offset += Entry->rec_len) {
+    // The new entry goes in last, after every live entry of the leaf
+    if (Offset == End) {
+      Entry       = NewEntry;
+      Item.Hash   = Hash;
+      Item.Offset = EXT4_DX_MAP_NEW_ENTRY;
+    } else {
+      Entry = (CONST EXT4_DIR_ENTRY *)(Leaf + Offset);
+
+      if (Entry->inode == 0) {
+        continue;
+      }
+
+      Status = Ext4DirHash (Partition, HashVersion, Entry->name, Entry->name_len, &Item.Hash);
+
+      if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+
+      Item.Offset = (UINT32)Offset;
+    }
+
+    Item.Size = EXT4_DIR_REC_LEN (Entry->name_len);
+    Total    += Item.Size;
+
+    // Insertion sort, which keeps entries with the same hash in order
+    for (Index = Count; (Index > 0) && (Map[Index - 1].Hash > Item.Hash); Index--) {
+      Map[Index] = Map[Index - 1];
+    }
+
+    Map[Index] = Item;
+    Count++;
+
+    if (Item.Offset == EXT4_DX_MAP_NEW_ENTRY) {
+      break;
+    }
+  }
+
+  if (Count < 2) {
+    Status = EFI_VOLUME_CORRUPTED;
+    goto Out;
+  }
+
+  Split = Count;
+  Moved = 0;
+
+  while ((Split > 1) && (Moved < Total / 2)) {
+    Split--;
+    Moved += Map[Split].Size;
+  }
+
+  SplitHash = Map[Split].Hash;
+
+  if (Map[Split - 1].Hash == SplitHash) {
+    SplitHash |= 1;
+  }
+
+  Status = Ext4ModifyDirBlock (Partition, Directory, EXT4_DX_PATH_ENTRIES (Parent)[Parent->Index].block & EXT4_DX_BLOCK_MASK, &Data);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4AppendDirBlock (Partition, Directory, &NewBlock, &NewData);
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Ext4DxPackDirents (Partition, Leaf, NewEntry, Map, Split, Data);
+  Ext4DxPackDirents (Partition, Leaf, NewEntry, Map + Split, Count - Split, NewData);
+  Ext4UpdateDirBlockChecksum (Partition, Directory, Data);
+  Ext4UpdateDirBlockChecksum (Partition, Directory, NewData);
+
+  Ext4DxInsertEntry (Partition, Directory, Parent, SplitHash, NewBlock);
+
+Out:
+  FreePool (Map);
+  return Status;
+}
+
+/**
+   Adds a directory entry to an htree directory, as part of the running transaction.
+   Full leaves get split, along with the full index nodes above them; a full root
+   gets the index a new level.
+
+   @param[in]      Partition      Pointer to the ext4 partition.
+   @param[in]      Directory      Pointer to the opened directory.
+   @param[in]      Frames         Frames of the lookup of the new entry's name.
+   @param[in]      IndirectLevels Number of index levels under the root.
+   @param[in]      HashVersion    Hash algorithm of the index.
+   @param[in]      Hash           Hash of the new entry's name.
+   @param[in]      NewEntry       Pointer to the new entry.
+   @param[in]      Buffer         Pointer to a scratch buffer, of size Partition->BlockSize.
+
+   @retval EFI_SUCCESS           The entry was added.
+   @retval EFI_VOLUME_FULL       There's no space left, or the index can't grow any further.
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4DxAddDirent (
+  IN EXT4_PARTITION        *Partition,
+  IN EXT4_FILE             *Directory,
+  IN CONST EXT4_DX_FRAME   *Frames,
+  IN UINT32                IndirectLevels,
+  IN UINT8                 HashVersion,
+  IN UINT32                Hash,
+  IN CONST EXT4_DIR_ENTRY  *NewEntry,
+  IN CHAR8                 *Buffer
+  )
+{
+  EFI_STATUS    Status;
+  EXT4_DX_PATH  Path[EXT4_DX_HTREE_LEVEL];
+  UINT32        Level;
+  UINT32        MaxLevels;
+  UINT32        LeafBlock;
+  UINTN         Offset;
+  CHAR8         *Data;
+
+  LeafBlock = Frames[IndirectLevels].Entry->block & EXT4_DX_BLOCK_MASK;
+
+  Status = Ext4ReadDirBlock (Partition, Directory, Buffer, LeafBlock);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4CheckDirBlock (Partition, Buffer);
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Ext4DirBlockFindSpace (Partition, Buffer, NewEntry->name_len, &Offset)) {
+    Status = Ext4ModifyDirBlock (Partition, Directory, LeafBlock, &Data);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Ext4DirBlockInsert (Data, Offset, NewEntry);
+    Ext4UpdateDirBlockChecksum (Partition, Directory, Data);
+    return EFI_SUCCESS;
+  }
+
+  for (Level = 0; Level <= IndirectLevels; Level++) {
+    Status = Ext4ModifyDirBlock (Partition, Directory, Frames[Level].LogicalBlock, &Path[Level].Node);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Path[Level].LogicalBlock = Frames[Level].LogicalBlock;
+    Path[Level].CountOffset  = Level == 0 ? OFFSET_OF (EXT4_DX_ROOT, info) + sizeof (EXT4_DX_ROOT_INFO) : sizeof (EXT4_DX_NODE);
+    Path[Level].Index        = Frames[Level].Entry - (CONST EXT4_DX_ENTRY *)(Frames[Level].Block + Path[Level].CountOffset);
+  }
+
+  // Every full node under the lowest one with room gets split, top-down
+  Level = IndirectLevels;
+
+  while ((Level > 0) && EXT4_DX_PATH_IS_FULL (&Path[Level])) {
+    Level--;
+  }
+
+  if (EXT4_DX_PATH_IS_FULL (&Path[0])) {
+    MaxLevels = EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_LARGEDIR) ?
+                EXT4_DX_HTREE_LEVEL : EXT4_DX_HTREE_LEVEL_COMPAT;
+
+    if (IndirectLevels + 1 >= MaxLevels) {
+      DEBUG ((DEBUG_ERROR, "[ext4] The index of directory inode %u is full\n", Directory->InodeNum));
+      return EFI_VOLUME_FULL;
+    }
+
+    Status = Ext4DxAddLevel (Partition, Directory, Path, &IndirectLevels);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Level = 1;
+  }
+
+  for (Level++; Level <= IndirectLevels; Level++) {
+    Status = Ext4DxSplitNode (Partition, Directory, Path, Level);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return Ext4DxSplitLeaf (Partition, Directory, &Path[IndirectLevels], HashVersion, NewEntry, Hash, Buffer);
+}
+
+/**
+   Converts a name to the UTF-8 name of a directory entry.
+
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[out]     Entry       Pointer to the directory entry, which gets the name.
+
+   @retval EFI_SUCCESS           The name was converted.
+   @retval EFI_INVALID_PARAMETER The name is empty, too long, or can't be a directory entry.
+**/
+STATIC
+EFI_STATUS
+Ext4SetDirentName (
+  IN  CONST CHAR16    *Name,
+  OUT EXT4_DIR_ENTRY  *Entry
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       *Utf8Name;
+  UINTN       Length;
+
+  Status = UCS2StrToUTF8 ((CHAR16 *)Name, &Utf8Name);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Length = AsciiStrLen (Utf8Name);
+
+  if ((Length == 0) || (Length > EXT4_NAME_MAX) || (AsciiStrStr (Utf8Name, "/") != NULL) ||
+      (AsciiStrCmp (Utf8Name, ".") == 0) || (AsciiStrCmp (Utf8Name, "..") == 0))
+  {
+    FreePool (Utf8Name);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Entry->name_len = (UINT8)Length;
+  CopyMem (Entry->name, Utf8Name, Length);
+
+  FreePool (Utf8Name);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds a directory entry to a directory, as part of the running transaction.
+   Linear directories get a new block if none has enough space, and full leaves of
+   indexed ones get split.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Name        Exact (on-disk) name of the entry.
+   @param[in]      InodeNum    Inode number the entry points to.
+   @param[in]      FileType    File type of the inode (EXT4_FT_*).
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4AddDirent (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *Directory,
+  IN CONST CHAR16    *Name,
+  IN EXT4_INO_NR     InodeNum,
+  IN UINT8           FileType
+  )
+{
+  EFI_STATUS      Status;
+  EXT4_DIR_ENTRY  NewEntry;
+  CHAR8           *Buffer;
+  CHAR8           Utf8Name[EXT4_NAME_MAX + 1];
+  EXT4_DX_FRAME   Frames[EXT4_DX_HTREE_LEVEL];
+  UINT32          IndirectLevels;
+  UINT8           HashVersion;
+  UINT32          Hash;
+
+  ZeroMem (&NewEntry, sizeof (NewEntry));
+
+  Status = Ext4SetDirentName (Name, &NewEntry);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  NewEntry.inode = InodeNum;
+
+  // Without the filetype feature, the field is the high byte of name_len
+  if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_FILETYPE)) {
+    NewEntry.file_type = FileType;
+  }
+
+  Buffer = AllocatePool (Partition->BlockSize);
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Buffer);
+    return Status;
+  }
+
+  if (Ext4DirIsIndexed (Partition, Directory)) {
+    CopyMem (Utf8Name, NewEntry.name, NewEntry.name_len);
+    Utf8Name[NewEntry.name_len] = '\0';
+
+    Status = Ext4DxLookupPath (Partition, Directory, Utf8Name, Frames, &IndirectLevels, &HashVersion, &Hash);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4DxAddDirent (Partition, Directory, Frames, IndirectLevels, HashVersion, Hash, &NewEntry, Buffer);
+    } else if ((Status == EFI_VOLUME_CORRUPTED) || (Status == EFI_UNSUPPORTED)) {
+      // Like Linux, drop an index we can't use; the directory's blocks are still
+      // valid linear directory blocks, and fsck can rebuild it.
+      DEBUG ((DEBUG_WARN, "[ext4] Dropping the htree index of directory inode %u (%r)\n", Directory->InodeNum, Status));
+      Directory->Inode->i_flags &= ~EXT4_INDEX_FL;
+    }
+
+    Ext4DxFreeFrames (Frames);
+  }
+
+  if (!Ext4DirIsIndexed (Partition, Directory)) {
+    Status = Ext4LinearAddDirent (Partition, Directory, &NewEntry, Buffer);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Ext4FileTouch (Directory);
+    Status = Ext4WriteInode (Partition, Directory->InodeNum, Directory->Inode);
+  }
+
+  FreePool (Buffer);
+
+  return Ext4EndTransaction (Partition, Status);
+}
+
+/**
+   Removes a directory entry from a directory, as part of the running transaction.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Name        Exact (on-disk) name of the entry.
+
+   @retval EFI_SUCCESS           The entry was removed.
+   @retval EFI_NOT_FOUND         There's no entry with that name.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4RemoveDirent (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *Directory,
+  IN CONST CHAR16    *Name
+  )
+{
+  EFI_STATUS      Status;
+  EXT4_DIR_ENTRY  Target;
+  EXT4_DIR_ENTRY  *Entry;
+  EXT4_DIR_ENTRY  *Prev;
+  CHAR8           *Buffer;
+  CHAR8           *Data;
+  UINT32          NumBlocks;
+  UINT32          Block;
+  UINTN           Offset;
+  UINTN           PrevOffset;
+  UINTN           End;
+  BOOLEAN         Indexed;
+
+  Status = Ext4SetDirentName (Name, &Target);
+
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Buffer = AllocatePool (Partition->BlockSize);
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  End       = Ext4DirBlockEnd (Partition);
+  Indexed   = Ext4DirIsIndexed (Partition, Directory);
+  NumBlocks = (UINT32)DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+  Status    = EFI_NOT_FOUND;
+
+  // Removing entries doesn't change the index, so the leaves can simply be searched in order.
+  // The root only has "." and "..".
+  for (Block = Indexed ? 1 : 0; Block < NumBlocks; Block++) {
+    Status = Ext4ReadDirBlock (Partition, Directory, Buffer, Block);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    if (Indexed && Ext4IsDxNodeBlock (Partition, Buffer)) {
+      Status = EFI_NOT_FOUND;
+      continue;
+    }
+
+    Status = Ext4CheckDirBlock (Partition, Buffer);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    PrevOffset = MAX_UINTN;
+    Status     = EFI_NOT_FOUND;
+
+    for (Offset = 0; Offset < End; Offset += Entry->rec_len) {
+      Entry = (EXT4_DIR_ENTRY *)(Buffer + Offset);
+
+      if ((Entry->inode != 0) && (Entry->name_len == Target.name_len) &&
+          (CompareMem (Entry->name, Target.name, Target.name_len) == 0))
+      {
+        Status = EFI_SUCCESS;
+        break;
+      }
+
+      PrevOffset = Offset;
+    }
+
+    if (Status != EFI_NOT_FOUND) {
+      break;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Buffer);
+    return Status;
+  }
+
+  FreePool (Buffer);
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ModifyDirBlock (Partition, Directory, Block, &Data);
+
+  if (!EFI_ERROR (Status)) {
+    // Merge the entry into the one before it, or mark it as unused if it's the first one
+    Entry = (EXT4_DIR_ENTRY *)(Data + Offset);
+
+    if (PrevOffset != MAX_UINTN) {
+      Prev           = (EXT4_DIR_ENTRY *)(Data + PrevOffset);
+      Prev->rec_len += Entry->rec_len;
+    } else {
+      Entry->inode = 0;
+    }
+
+    Ext4UpdateDirBlockChecksum (Partition, Directory, Data);
+
+    Ext4FileTouch (Directory);
+    Status = Ext4WriteInode (Partition, Directory->InodeNum, Directory->Inode);
+  }
+
+  return Ext4EndTransaction (Partition, Status);
+}
+
+/**
+   Checks if a directory has no entries, other than "." and "..".
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[out]     IsEmpty     Pointer to the result.
+
+   @return Status of reading the directory.
+**/
+EFI_STATUS
+Ext4DirIsEmpty (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT BOOLEAN         *IsEmpty
+  )
+{
+  EFI_STATUS      Status;
+  CHAR8           *Buffer;
+  EXT4_DIR_ENTRY  *Entry;
+  UINT32          NumBlocks;
+  UINT32          Block;
+  UINTN           Offset;
+  BOOLEAN         Indexed;
+
+  Buffer = AllocatePool (Partition->BlockSize);
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *IsEmpty  = TRUE;
+  Status    = EFI_SUCCESS;
+  Indexed   = Ext4DirIsIndexed (Partition, Directory);
+  NumBlocks = (UINT32)DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+
+  for (Block = Indexed ? 1 : 0; (Block < NumBlocks) && *IsEmpty; Block++) {
+    Status = Ext4ReadDirBlock (Partition, Directory, Buffer, Block);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    if (Indexed && Ext4IsDxNodeBlock (Partition, Buffer)) {
+      continue;
+    }
+
+    for (Offset = 0; Offset < Partition->BlockSize; Offset += Entry->rec_len) {
+      Entry = (EXT4_DIR_ENTRY *)(Buffer + Offset);
+
+      if ((Partition->BlockSize - Offset < EXT4_MIN_DIR_ENTRY_LEN) || !Ext4ValidDirent (Entry) ||
+          (Entry->rec_len > Partition->BlockSize - Offset))
+      {
+        Status = EFI_VOLUME_CORRUPTED;
+        break;
+      }
+
+      if ((Entry->inode != 0) &&
+          !((Entry->name_len == 1) && (Entry->name[0] == '.')) &&
+          !((Entry->name_len == 2) && (CompareMem (Entry->name, "..", 2) == 0)))
+      {
+        *IsEmpty = FALSE;
+        break;
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  FreePool (Buffer);
+
+  return Status;
+}
+
+/**
+   Adds a link to a directory's link count, for a new subdirectory's "..".
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  Directory   Pointer to the opened directory.
+
+   @retval EFI_SUCCESS           The link was added.
+   @retval EFI_VOLUME_FULL       The directory has too many subdirectories.
+**/
+STATIC
+EFI_STATUS
+Ext4DirAddLink (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT EXT4_FILE             *Directory
+  )
+{
+  EXT4_INODE  *Inode;
+
+  Inode = Directory->Inode;
+
+  // A link count of 1 means the directory has too many subdirectories to count
+  if (Inode->i_links == 1) {
+    return EFI_SUCCESS;
+  }
+
+  if (Inode->i_links + 1 >= EXT4_LINK_MAX) {
+    if (!EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_DIR_NLINK)) {
+      return EFI_VOLUME_FULL;
+    }
+
+    Inode->i_links = 1;
+    return EFI_SUCCESS;
+  }
+
+  Inode->i_links++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops a link from a directory's link count, after a subdirectory went away.
+   The inode still has to be written back to the disk.
+
+   @param[in out]  Directory   Pointer to the opened directory.
+**/
+STATIC
+VOID
+Ext4DirDropLink (
+  IN OUT EXT4_FILE  *Directory
+  )
+{
+  // Overflowed counts stay that way, and "." and the parent's entry are always there
+  if (Directory->Inode->i_links > 2) {
+    Directory->Inode->i_links--;
+  }
+}
+
+/**
+   Opens a file's parent directory, through the dentry cache.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      File        Pointer to the opened file.
+   @param[out]     Parent      Pointer to the opened parent directory.
+
+   @retval EFI_SUCCESS           The parent was opened.
+   @retval EFI_ACCESS_DENIED     The file is the root directory.
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4OpenParent (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  OUT EXT4_FILE       **Parent
+  )
+{
+  EXT4_DENTRY  *Dentry;
+
+  Dentry = File->Dentry->Parent;
+
+  if (Dentry == NULL) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Ext4RefDentry (Dentry);
+
+  return Ext4OpenDentry (Partition, EFI_FILE_MODE_READ, Parent, Dentry, Dentry->Inode);
+}
+
+/**
+   Gets the directory entry file type of a file.
+
+   @param[in]      File        Pointer to the opened file.
+
+   @return The file type (EXT4_FT_*).
+**/
+STATIC
+UINT8
+Ext4DirentFileType (
+  IN CONST EXT4_FILE  *File
+  )
+{
+  switch (File->Inode->i_mode & EXT4_INO_TYPE_MASK) {
+    case EXT4_INO_TYPE_REGFILE:
+      return EXT4_FT_REG_FILE;
+    case EXT4_INO_TYPE_DIR:
+      return EXT4_FT_DIR;
+    case EXT4_INO_TYPE_SYMLINK:
+      return EXT4_FT_SYMLINK;
+    case EXT4_INO_TYPE_CHARDEV:
+      return EXT4_FT_CHRDEV;
+    case EXT4_INO_TYPE_BLOCKDEV:
+      return EXT4_FT_BLKDEV;
+    case EXT4_INO_TYPE_FIFO:
+      return EXT4_FT_FIFO;
+    case EXT4_INO_TYPE_UNIX_SOCK:
+      return EXT4_FT_SOCK;
+    default:
+      return EXT4_FT_UNKNOWN;
+  }
+}
+
+/**
+   Sets up the inode and the first block of a new file, as part of the running transaction.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  File        Pointer to the new file, with its inode number already allocated.
+   @param[in]      Directory   Pointer to the opened parent directory.
+   @param[in]      Attributes  EFI file attributes of the new file.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4InitNewInode (
+  IN     EXT4_PARTITION  *Partition,
+  IN OUT EXT4_FILE       *File,
+  IN     EXT4_FILE       *Directory,
+  IN     UINT64          Attributes
+  )
+{
+  EFI_STATUS          Status;
+  EXT4_INODE          *Inode;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_DIR_ENTRY      Entry;
+  UINT32              Block;
+  CHAR8               *Data;
+
+  Inode = File->Inode;
+
+  if ((Attributes & EFI_FILE_DIRECTORY) != 0) {
+    Inode->i_mode  = EXT4_INO_TYPE_DIR | EXT4_NEW_DIR_MODE;
+    Inode->i_links = 2;
+  } else {
+    Inode->i_mode  = EXT4_INO_TYPE_REGFILE | EXT4_NEW_FILE_MODE;
+    Inode->i_links = 1;
+  }
+
+  if ((Attributes & EFI_FILE_READ_ONLY) != 0) {
+    Inode->i_mode &= (UINT16)~EXT4_INO_PERM_WRITE_ALL;
+  }
+
+  if (Partition->InodeSize > EXT4_GOOD_OLD_INODE_SIZE) {
+    Inode->i_extra_isize = (UINT16)(MIN (Partition->InodeSize, sizeof (EXT4_INODE)) - EXT4_GOOD_OLD_INODE_SIZE);
+  }
+
+  Inode->i_flags = EXT4_EXTENTS_FL;
+
+  Header             = (EXT4_EXTENT_HEADER *)Inode->i_data;
+  Header->eh_magic   = EXT4_EXTENT_HEADER_MAGIC;
+  Header->eh_entries = 0;
+  Header->eh_max     = EXT4_INODE_EXTENT_ENTRIES;
+  Header->eh_depth   = 0;
+
+  // If the current time can't be read, the times are left zeroed
+  Ext4SetInodeTimes (Inode, NULL, EXT4_INODE_ATIME | EXT4_INODE_MTIME | EXT4_INODE_CTIME | EXT4_INODE_CRTIME);
+
+  if ((Attributes & EFI_FILE_DIRECTORY) != 0) {
+    Status = Ext4AppendDirBlock (Partition, File, &Block, &Data);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    ZeroMem (&Entry, sizeof (Entry));
+
+    Ext4InitDirBlock (Partition, Data);
+
+    // The first entry takes the whole block, and ".." is then carved out of it
+    Entry.inode    = File->InodeNum;
+    Entry.name_len = 1;
+    Entry.name[0]  = '.';
+
+    if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_FILETYPE)) {
+      Entry.file_type = EXT4_FT_DIR;
+    }
+
+    Ext4DirBlockInsert (Data, 0, &Entry);
+
+    Entry.inode    = Directory->InodeNum;
+    Entry.name_len = 2;
+    Entry.name[1]  = '.';
+
+    Ext4DirBlockInsert (Data, 0, &Entry);
+
+    Ext4UpdateDirBlockChecksum (Partition, File, Data);
+
+    Status = Ext4DirAddLink (Partition, Directory);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return Ext4WriteInode (Partition, File->InodeNum, Inode);
+}
+
+/**
+   Creates a file or directory, and opens it.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open parent directory.
+   @param[in]      Name        Name of the new file.
+   @param[in]      Attributes  EFI file attributes of the new file.
+   @param[in]      OpenMode    Mode in which the file is supposed to be open.
+   @param[out]     OutFile     Pointer to the newly opened file.
+
+   @retval EFI_SUCCESS           The file was created.
+   @retval EFI_VOLUME_FULL       There's no space for the file.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4CreateFile (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  UINT64          Attributes,
+  IN  UINT64          OpenMode,
+  OUT EXT4_FILE       **OutFile
+  )
+{
+  EFI_STATUS  Status;
+  EXT4_FILE   *File;
+  BOOLEAN     IsDir;
+
+  IsDir = (Attributes & EFI_FILE_DIRECTORY) != 0;
+
+  File = AllocateZeroPool (sizeof (EXT4_FILE));
+
+  if (File == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Ext4SetupFile (File, Partition);
+
+  File->Inode = Ext4AllocateInode (Partition);
+
+  // The dentry only gets attached to the parent once the file exists
+  File->Dentry = Ext4CreateDentry (Partition, Name, 0, NULL);
+
+  if ((File->Inode == NULL) || (File->Dentry == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Error;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  Status = Ext4AllocateInodeNumber (Partition, Directory->InodeNum, IsDir, &File->InodeNum);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4InitExtentsMap (File);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4InitNewInode (Partition, File, Directory, Attributes);
+  }
+
+  // This writes the directory's inode, along with the link InitNewInode may have added
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4AddDirent (Partition, Directory, Name, File->InodeNum, IsDir ? EXT4_FT_DIR : EXT4_FT_REG_FILE);
+  }
+
+  Status = Ext4EndTransaction (Partition, Status);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  Ext4DropNegativeDentries (Directory->Dentry, Name);
+
+  File->Dentry->Inode = File->InodeNum;
+
+  // If the dentry can't be attached, it stays unattached; the file still exists.
+  Ext4AddDentry (Directory->Dentry, File->Dentry);
+
+  File->OpenMode = OpenMode;
+  InsertTailList (&Partition->OpenFiles, &File->OpenFilesListNode);
+
+  *OutFile = File;
+
+  DEBUG ((DEBUG_FS, "[ext4] Created %s (inode %u)\n", Name, File->InodeNum));
+
+  return EFI_SUCCESS;
+
+Error:
+  Ext4FreeExtentsMap (File);
+
+  if (File->Dentry != NULL) {
+    Ext4UnrefDentry (File->Dentry);
+  }
+
+  if (File->Inode != NULL) {
+    FreePool (File->Inode);
+  }
+
+  FreePool (File);
+
+  return Status;
+}
 
 /**
-   Decrements the ref count of the dentry.
-   If the ref count is 0, it's destroyed.
+   Removes a file's name from its parent directory, and frees the file once it has no
+   names left.
 
-   @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file. It must be the only handle of the inode.
 
-   @retval True if it was destroyed, false if it's alive.
+   @return Status of the operation.
 **/
-BOOLEAN
-Ext4UnrefDentry (
-  IN OUT EXT4_DENTRY  *Dentry
+EFI_STATUS
+Ext4UnlinkFile (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File
   )
 {
-  Dentry->RefCount--;
+  EFI_STATUS  Status;
+  EXT4_FILE   *Parent;
+  EXT4_FILE   *Other;
+  LIST_ENTRY  *Entry;
+  BOOLEAN     IsDir;
+  BOOLEAN     IsEmpty;
 
-  if (Dentry->RefCount == 0) {
-    Ext4DeleteDentry (Dentry);
-    return TRUE;
+  IsDir = Ext4FileIsDir (File);
+
+  // Deleted files can't stay open, so don't delete files that are in use elsewhere
+  BASE_LIST_FOR_EACH (Entry, &Partition->OpenFiles) {
+    Other = EXT4_FILE_FROM_OPEN_FILES_NODE (Entry);
+
+    if ((Other != File) && (Other->InodeNum == File->InodeNum)) {
+      return EFI_ACCESS_DENIED;
+    }
   }
 
-  return FALSE;
+  if (IsDir) {
+    Status = Ext4DirIsEmpty (Partition, File, &IsEmpty);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (!IsEmpty) {
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  Status = Ext4OpenParent (Partition, File, &Parent);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    Ext4CloseInternal (Parent);
+    return Status;
+  }
+
+  Status = Ext4RemoveDirent (Partition, Parent, File->Dentry->Name);
+
+  if (!EFI_ERROR (Status) && IsDir) {
+    // The directory's "." and its entry in the parent are both gone, and so is
+    // the parent's link from "..".
+    File->Inode->i_links = 0;
+
+    Ext4DirDropLink (Parent);
+    Status = Ext4WriteInode (Partition, Parent->InodeNum, Parent->Inode);
+  } else if (!EFI_ERROR (Status) && (File->Inode->i_links != 0)) {
+    File->Inode->i_links--;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Ext4SetInodeTimes (File->Inode, NULL, EXT4_INODE_CTIME);
+
+    if (File->Inode->i_links == 0) {
+      Status = Ext4TruncateExtents (Partition, File, 0);
+
+      if (!EFI_ERROR (Status)) {
+        File->Inode->i_size_lo = 0;
+        File->Inode->i_size_hi = 0;
+        File->Inode->i_dtime   = File->Inode->i_ctime;
+
+        Status = Ext4FreeInodeNumber (Partition, File->InodeNum, IsDir);
+      }
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4WriteInode (Partition, File->InodeNum, File->Inode);
+  }
+
+  Status = Ext4EndTransaction (Partition, Status);
+
+  if (!EFI_ERROR (Status)) {
+    Ext4DetachDentry (File->Dentry);
+  }
+
+  Ext4CloseInternal (Parent);
+
+  return Status;
+}
+
+/**
+   Points a moved directory's ".." entry to its new parent, as part of the running transaction.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      File        Pointer to the opened directory.
+   @param[in]      NewParent   Pointer to the opened new parent directory.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4SetDotDot (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_FILE       *NewParent
+  )
+{
+  EFI_STATUS      Status;
+  EXT4_DIR_ENTRY  *Dot;
+  EXT4_DIR_ENTRY  *DotDot;
+  CHAR8           *Data;
+
+  Status = Ext4ModifyDirBlock (Partition, File, 0, &Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // "." and ".." always are the first two entries of the first block, even in an htree root
+  Dot = (EXT4_DIR_ENTRY *)Data;
+
+  if ((Dot->rec_len < EXT4_DIR_REC_LEN (1)) || (Dot->rec_len > Partition->BlockSize - EXT4_DIR_REC_LEN (2))) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  DotDot = (EXT4_DIR_ENTRY *)(Data + Dot->rec_len);
+
+  if ((DotDot->name_len != 2) || (CompareMem (DotDot->name, "..", 2) != 0)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  DotDot->inode = NewParent->InodeNum;
+
+  if (Ext4DirIsIndexed (Partition, File)) {
+    Ext4UpdateDxChecksum (Partition, File, Data, OFFSET_OF (EXT4_DX_ROOT, info) + sizeof (EXT4_DX_ROOT_INFO));
+  } else {
+    Ext4UpdateDirBlockChecksum (Partition, File, Data);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Opens the directory a path leads to, and finds its last segment.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Base        Pointer to the opened directory relative paths start at.
+   @param[in]      Path        Pointer to the path.
+   @param[out]     Directory   Pointer to the opened directory the path's last segment is in.
+   @param[out]     Name        Last segment of the path, EXT4_NAME_MAX + 1 long.
+
+   @retval EFI_SUCCESS           The directory was opened.
+   @retval EFI_INVALID_PARAMETER The path is empty, or goes through something that isn't a directory.
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4OpenPathParent (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Base,
+  IN  CONST CHAR16    *Path,
+  OUT EXT4_FILE       **Directory,
+  OUT CHAR16          *Name
+  )
+{
+  EFI_STATUS    Status;
+  EXT4_FILE     *Current;
+  EXT4_FILE     *Next;
+  CONST CHAR16  *End;
+  CONST CHAR16  *Rest;
+
+  if (Path[0] == L'\\') {
+    Ext4RefDentry (Partition->RootDentry);
+    Status = Ext4OpenDentry (Partition, EFI_FILE_MODE_READ, &Current, Partition->RootDentry, EXT4_ROOT_INODE_NR);
+  } else {
+    Ext4RefDentry (Base->Dentry);
+    Status = Ext4OpenDentry (Partition, EFI_FILE_MODE_READ, &Current, Base->Dentry, Base->InodeNum);
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (TRUE) {
+    while (Path[0] == L'\\') {
+      Path++;
+    }
+
+    for (End = Path; *End != L'\0' && *End != L'\\'; End++) {
+    }
+
+    if ((End == Path) || (End - Path > EXT4_NAME_MAX)) {
+      Status = EFI_INVALID_PARAMETER;
+      break;
+    }
+
+    Status = StrnCpyS (Name, EXT4_NAME_MAX + 1, Path, End - Path);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    for (Rest = End; *Rest == L'\\'; Rest++) {
+    }
+
+    if (*Rest == L'\0') {
+      *Directory = Current;
+      return EFI_SUCCESS;
+    }
+
+    Path = End;
+
+    if (StrCmp (Name, L".") == 0) {
+      continue;
+    }
+
+    Status = Ext4OpenFile (Current, Name, Partition, EFI_FILE_MODE_READ, &Next);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Ext4CloseInternal (Current);
+    Current = Next;
+
+    if (!Ext4FileIsDir (Current)) {
+      Status = EFI_INVALID_PARAMETER;
+      break;
+    }
+  }
+
+  Ext4CloseInternal (Current);
+
+  return Status;
+}
+
+/**
+   Renames a file, possibly moving it to another directory.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file.
+   @param[in]      NewPath     New name of the file. If it has path separators, it's relative
+                               to the file's parent directory (or to the root, if it starts
+                               with one).
+
+   @retval EFI_SUCCESS           The file was renamed.
+   @retval EFI_ACCESS_DENIED     A file with the new name already exists, or a directory
+                                 would be moved inside of itself.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4RenameFile (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN CONST CHAR16    *NewPath
+  )
+{
+  EFI_STATUS      Status;
+  EXT4_FILE       *OldParent;
+  EXT4_FILE       *NewParent;
+  EXT4_DENTRY     *D;
+  EXT4_DIR_ENTRY  Entry;
+  CHAR16          NewName[EXT4_NAME_MAX + 1];
+  BOOLEAN         IsDir;
+  BOOLEAN         Moved;
+
+  IsDir = Ext4FileIsDir (File);
+
+  Status = Ext4OpenParent (Partition, File, &OldParent);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4OpenPathParent (Partition, OldParent, NewPath, &NewParent, NewName);
+
+  if (EFI_ERROR (Status)) {
+    Ext4CloseInternal (OldParent);
+    return Status;
+  }
+
+  Moved = NewParent->InodeNum != OldParent->InodeNum;
+
+  if (!Moved && (StrCmp (NewName, File->Dentry->Name) == 0)) {
+    Status = EFI_SUCCESS;
+    goto Out;
+  }
+
+  if ((StrCmp (NewName, L".") == 0) || (StrCmp (NewName, L"..") == 0)) {
+    Status = EFI_ACCESS_DENIED;
+    goto Out;
+  }
+
+  // Only the file's own name may match, when it's just changing case
+  Status = Ext4RetrieveDirent (NewParent, NewName, Partition, &Entry);
+
+  if (Status == EFI_SUCCESS) {
+    if (Moved || (Entry.inode != File->InodeNum) ||
+        (Ext4StrCmpInsensitive (NewName, File->Dentry->Name) != 0))
+    {
+      Status = EFI_ACCESS_DENIED;
+      goto Out;
+    }
+  } else if (Status != EFI_NOT_FOUND) {
+    goto Out;
+  }
+
+  if (IsDir && Moved) {
+    for (D = NewParent->Dentry; D != NULL; D = D->Parent) {
+      if (D->Inode == File->InodeNum) {
+        Status = EFI_ACCESS_DENIED;
+        goto Out;
+      }
+    }
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Status = Ext4RemoveDirent (Partition, OldParent, File->Dentry->Name);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4AddDirent (Partition, NewParent, NewName, File->InodeNum, Ext4DirentFileType (File));
+  }
+
+  if (!EFI_ERROR (Status) && IsDir && Moved) {
+    Status = Ext4SetDotDot (Partition, File, NewParent);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4DirAddLink (Partition, NewParent);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Ext4DirDropLink (OldParent);
+
+      Status = Ext4WriteInode (Partition, NewParent->InodeNum, NewParent->Inode);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4WriteInode (Partition, OldParent->InodeNum, OldParent->Inode);
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Ext4SetInodeTimes (File->Inode, NULL, EXT4_INODE_CTIME);
+    Status = Ext4WriteInode (Partition, File->InodeNum, File->Inode);
+  }
+
+  Status = Ext4EndTransaction (Partition, Status);
+
+  if (!EFI_ERROR (Status)) {
+    // If the dentry can't be moved, it's left detached; the rename itself went through.
+    Ext4RenameDentry (File->Dentry, NewParent->Dentry, NewName);
+  }
+
+Out:
+  Ext4CloseInternal (NewParent);
+  Ext4CloseInternal (OldParent);
+
+  return Status;
 }
@@ -33,6 +33,33 @@ Ext4ReadDiskIo (
                                      );
 }
 
+/**
+   Writes to the partition's disk using the DISK_IO protocol.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the disk write.
+**/
+EFI_STATUS
+Ext4WriteDiskIo (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  return EXT4_DISK_IO (Partition)->WriteDisk (
+                                     EXT4_DISK_IO (Partition),
+                                     EXT4_MEDIA_ID (Partition),
+                                     Offset,
+                                     Length,
+                                     (VOID *)Buffer
+                                     );
+}
+
 /**
    Reads blocks from the partition's disk using the DISK_IO protocol.
 
@@ -68,12 +68,18 @@
           mostly-list of EXT4_DIR_ENTRY.
        2) Hash tree directories: These are used for larger directories, with
           hundreds of entries, and are designed in a backwards compatible way.
-          These are not yet implemented in the Ext4Dxe driver.
+          The index lives in otherwise-unused directory entries, so that
+          implementations that don't understand it can do a linear scan.
 
   7) Journal
      Ext3/4 filesystems have a journal to help protect the filesystem against
-     system crashes. This is not yet implemented in Ext4Dxe but is described
-     in detail in the Linux kernel's documentation.
+     system crashes. The journal (JBD2) is a circular log, usually stored in
+     inode 8, where metadata blocks are first written as part of a
+     transaction, then marked as committed, and only then written to their
+     final location (checkpointed). A crash before the commit block hits the
+     disk loses the whole transaction; a crash after it is fixed by replaying
+     the log on the next mount. Ext4Dxe logs its metadata updates in the
+     journal when writing, and replays it when mounting.
 **/
 
 #ifndef EXT4_DISK_H_
@@ -85,6 +91,10 @@
 
 #define EXT4_SIGNATURE  0xEF53U
 
+// Block sizes go from 1KiB (2^10) up to 64KiB (2^16)
+#define EXT4_MIN_BLOCK_LOG_SIZE  10
+#define EXT4_MAX_BLOCK_LOG_SIZE  16
+
 #define EXT4_FS_STATE_UNMOUNTED           0x1
 #define EXT4_FS_STATE_ERRORS_DETECTED     0x2
 #define EXT4_FS_STATE_RECOVERING_ORPHANS  0x4
@@ -102,6 +112,8 @@
 #define EXT4_GOOD_OLD_REV  0
 #define EXT4_DYNAMIC_REV   1
 
+#define EXT4_GOOD_OLD_FIRST_INO  11
+
 #define EXT4_CHECKSUM_CRC32C  0x1
 
 #define EXT4_FEATURE_COMPAT_DIR_PREALLOC   0x01
@@ -110,6 +122,7 @@
 #define EXT4_FEATURE_COMPAT_EXT_ATTR       0x08
 #define EXT4_FEATURE_COMPAT_RESIZE_INO     0x10
 #define EXT4_FEATURE_COMPAT_DIR_INDEX      0x20
+#define EXT4_FEATURE_COMPAT_SPARSE_SUPER2  0x200
 
 #define EXT4_FEATURE_INCOMPAT_COMPRESSION  0x00001
 #define EXT4_FEATURE_INCOMPAT_FILETYPE     0x00002
@@ -159,6 +172,17 @@
 #define EXT4_INO_TYPE_SYMLINK    0xA000
 #define EXT4_INO_TYPE_UNIX_SOCK  0xC000
 
+// Mask of the i_mode bits that hold the inode type
+#define EXT4_INO_TYPE_MASK  0xF000
+
+// Permission bits of i_mode
+#define EXT4_INO_PERM_READ_OWNER   0400
+#define EXT4_INO_PERM_WRITE_OWNER  0200
+#define EXT4_INO_PERM_EXEC_OWNER   0100
+
+// Write permission for the owner, the group and everyone else
+#define EXT4_INO_PERM_WRITE_ALL  0222
+
 /* Inode flags */
 #define EXT4_SECRM_FL         0x00000001
 #define EXT4_UNRM_FL          0x00000002
@@ -173,7 +197,8 @@
 #define EXT4_NOCOMPR_FL       0x00000400
 #define EXT4_ECOMPR_FL        0x00000800
 #define EXT4_BTREE_FL         0x00001000
-#define EXT4_INDEX_FL         0x00002000
+#define EXT4_INDEX_FL         0x00001000
+#define EXT4_IMAGIC_FL        0x00002000
 #define EXT4_JOURNAL_DATA_FL  0x00004000
 #define EXT4_NOTAIL_FL        0x00008000
 #define EXT4_DIRSYNC_FL       0x00010000
@@ -235,7 +260,7 @@ typedef struct {
   UINT32    s_algo_bitmap;
   UINT8     s_prealloc_blocks;
   UINT8     s_prealloc_dir_blocks;
-  UINT16    unused;
+  UINT16    s_reserved_gdt_blocks;
   UINT8     s_journal_uuid[16];
   UINT32    s_journal_inum;
   UINT32    s_journal_dev;
@@ -321,8 +346,14 @@ typedef struct {
   UINT32    bg_reserved;
 } EXT4_BLOCK_GROUP_DESC;
 
+// bg_flags bits
+#define EXT4_BG_INODE_UNINIT  0x0001
+#define EXT4_BG_BLOCK_UNINIT  0x0002
+#define EXT4_BG_INODE_ZEROED  0x0004
+
 #define EXT4_OLD_BLOCK_DESC_SIZE    32
 #define EXT4_64BIT_BLOCK_DESC_SIZE  64
+#define EXT4_MAX_BLOCK_DESC_SIZE    1024
 
 STATIC_ASSERT (
   sizeof (EXT4_BLOCK_GROUP_DESC) == EXT4_64BIT_BLOCK_DESC_SIZE,
@@ -402,6 +433,91 @@ typedef struct {
 
 #define EXT4_MIN_DIR_ENTRY_LEN  8
 
+// Hash tree (htree) directory indexing structures.
+// Block 0 of an indexed directory starts with a fake "." and ".." entry (the
+// latter covering the rest of the block), followed by EXT4_DX_ROOT_INFO and
+// an array of EXT4_DX_ENTRY. The first EXT4_DX_ENTRY slot doubles as an
+// EXT4_DX_COUNT_LIMIT, and its block field is used for hash 0.
+typedef struct {
+  UINT32    inode;
+  UINT16    rec_len;
+  UINT8     name_len;
+  UINT8     file_type;
+} EXT4_DX_FAKE_DIRENT;
+
+typedef struct {
+  UINT32    reserved_zero;
+  UINT8     hash_version;
+  UINT8     info_length;
+  UINT8     indirect_levels;
+  UINT8     unused_flags;
+} EXT4_DX_ROOT_INFO;
+
+typedef struct {
+  EXT4_DX_FAKE_DIRENT    dot;
+  CHAR8                  dot_name[4];
+  EXT4_DX_FAKE_DIRENT    dotdot;
+  CHAR8                  dotdot_name[4];
+  EXT4_DX_ROOT_INFO      info;
+} EXT4_DX_ROOT;
+
+// Interior nodes are a single fake (unused) dirent covering the whole block
+typedef struct {
+  EXT4_DX_FAKE_DIRENT    fake;
+} EXT4_DX_NODE;
+
+typedef struct {
+  UINT16    limit;
+  UINT16    count;
+} EXT4_DX_COUNT_LIMIT;
+
+typedef struct {
+  UINT32    hash;
+  UINT32    block;
+} EXT4_DX_ENTRY;
+
+// Only the low 28 bits of EXT4_DX_ENTRY.block are the block number; Linux
+// ignores (and reserves) the rest
+#define EXT4_DX_BLOCK_MASK  0x0fffffff
+
+// Present at the end of linear directory blocks on metadata_csum filesystems.
+// It looks like an unused dirent, so readers that don't know about it skip it.
+typedef struct {
+  UINT32    det_reserved_zero1;
+  UINT16    det_rec_len;
+  UINT8     det_reserved_zero2;
+  UINT8     det_reserved_ft;
+  UINT32    det_checksum;
+} EXT4_DIR_ENTRY_TAIL;
+
+#define EXT4_DIR_ENTRY_TAIL_FT  0xDE
+
+// Present after the last EXT4_DX_ENTRY slot (limit) on metadata_csum filesystems
+typedef struct {
+  UINT32    dt_reserved;
+  UINT32    dt_checksum;
+} EXT4_DX_TAIL;
+
+#define EXT4_DX_HASH_LEGACY             0
+#define EXT4_DX_HASH_HALF_MD4           1
+#define EXT4_DX_HASH_TEA                2
+#define EXT4_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT4_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT4_DX_HASH_TEA_UNSIGNED       5
+#define EXT4_DX_HASH_SIPHASH            6
+
+// Offset between the signed and unsigned variants of the hash functions
+#define EXT4_DX_HASH_UNSIGNED_DELTA  3
+
+// Maximum depth of the tree, counting the root. indirect_levels must be smaller
+// than these (the larger limit only applies with the largedir feature).
+#define EXT4_DX_HTREE_LEVEL_COMPAT  2
+#define EXT4_DX_HTREE_LEVEL         3
+
+// s_flags bits
+#define EXT4_FLAGS_SIGNED_HASH    0x0001
+#define EXT4_FLAGS_UNSIGNED_HASH  0x0002
+
 // This on-disk structure is present at the bottom of the extent tree
 typedef struct {
   // First logical block
@@ -443,6 +559,11 @@ typedef struct {
 // Specified by ext4 docs and backed by a bunch of math
 #define EXT4_EXTENT_TREE_MAX_DEPTH  5
 
+// Number of entries (extents or indices, which are the same size) that fit in
+// the root of the extent tree, in i_data, or in a tree block
+#define EXT4_INODE_EXTENT_ENTRIES  ((EXT4_NR_BLOCKS * sizeof (UINT32) - sizeof (EXT4_EXTENT_HEADER)) / sizeof (EXT4_EXTENT))
+#define EXT4_BLOCK_EXTENT_ENTRIES(BlockSize)  (((BlockSize) - sizeof (EXT4_EXTENT_HEADER)) / sizeof (EXT4_EXTENT))
+
 typedef struct {
   // CRC32C of UUID + inode number + igeneration + extent block
   UINT32    eb_checksum;
@@ -462,4 +583,107 @@ typedef UINT32  EXT4_INO_NR;
 // 2 is always the root inode number in ext4
 #define EXT4_ROOT_INODE_NR  2
 
+// Inode number of the journal, when it lives inside the filesystem
+#define EXT4_JOURNAL_INODE_NR  8
+
+/* JBD2 journal structures
+ * Unlike the rest of the filesystem, every field of the journal is big-endian.
+ * Every journal block starts with a JBD2_HEADER.
+**/
+
+#define JBD2_MAGIC  0xC03B3998U
+
+#define JBD2_DESCRIPTOR_BLOCK  1
+#define JBD2_COMMIT_BLOCK      2
+#define JBD2_SUPERBLOCK_V1     3
+#define JBD2_SUPERBLOCK_V2     4
+#define JBD2_REVOKE_BLOCK      5
+
+typedef struct {
+  UINT32    h_magic;
+  UINT32    h_blocktype;
+  UINT32    h_sequence;
+} JBD2_HEADER;
+
+#define JBD2_FEATURE_COMPAT_CHECKSUM  0x1
+
+#define JBD2_FEATURE_INCOMPAT_REVOKE        0x1
+#define JBD2_FEATURE_INCOMPAT_64BIT         0x2
+#define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT  0x4
+#define JBD2_FEATURE_INCOMPAT_CSUM_V2       0x8
+#define JBD2_FEATURE_INCOMPAT_CSUM_V3       0x10
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT   0x20
+
+#define JBD2_CRC32C_CHKSUM  4
+
+typedef struct {
+  JBD2_HEADER    s_header;
+  UINT32         s_blocksize;
+  UINT32         s_maxlen;
+  UINT32         s_first;
+  UINT32         s_sequence;
+  UINT32         s_start;
+  UINT32         s_errno;
+  UINT32         s_feature_compat;
+  UINT32         s_feature_incompat;
+  UINT32         s_feature_ro_compat;
+  UINT8          s_uuid[16];
+  UINT32         s_nr_users;
+  UINT32         s_dynsuper;
+  UINT32         s_max_transaction;
+  UINT32         s_max_trans_data;
+  UINT8          s_checksum_type;
+  UINT8          s_padding2[3];
+  UINT32         s_num_fc_blks;
+  UINT32         s_head;
+  UINT32         s_padding[40];
+  UINT32         s_checksum;
+  UINT8          s_users[16 * 48];
+} JBD2_SUPERBLOCK;
+
+STATIC_ASSERT (sizeof (JBD2_SUPERBLOCK) == 1024, "jbd2 superblock struct has incorrect size");
+
+// Descriptor block tags. Which of these is used depends on the CSUM_V3
+// feature; without it, t_checksum is only present with CSUM_V2 and
+// t_blocknr_high only with 64BIT.
+typedef struct {
+  UINT32    t_blocknr;
+  UINT32    t_flags;
+  UINT32    t_blocknr_high;
+  UINT32    t_checksum;
+} JBD2_BLOCK_TAG3;
+
+typedef struct {
+  UINT32    t_blocknr;
+  UINT16    t_checksum;
+  UINT16    t_flags;
+  UINT32    t_blocknr_high;
+} JBD2_BLOCK_TAG;
+
+#define JBD2_FLAG_ESCAPE     0x1
+#define JBD2_FLAG_SAME_UUID  0x2
+#define JBD2_FLAG_DELETED    0x4
+#define JBD2_FLAG_LAST_TAG   0x8
+
+// Present at the end of descriptor and revoke blocks with CSUM_V2/V3
+typedef struct {
+  UINT32    t_checksum;
+} JBD2_BLOCK_TAIL;
+
+typedef struct {
+  JBD2_HEADER    h_header;
+  UINT8          h_chksum_type;
+  UINT8          h_chksum_size;
+  UINT8          h_padding[2];
+  UINT32         h_chksum[8];
+  UINT64         h_commit_sec;
+  UINT32         h_commit_nsec;
+} JBD2_COMMIT_HEADER;
+
+typedef struct {
+  JBD2_HEADER    r_header;
+  // Number of bytes used in the block, including this header
+  UINT32         r_count;
+} JBD2_REVOKE_HEADER;
+
 #endif
@@ -455,6 +455,17 @@ Ext4Stop (
     return Status;
   }
 
+  // Only now that the partition is really gone, so that a failed unmount leaves it
+  // inspectable. This may fail if the protocol couldn't be installed in the first place.
+  if (FeaturePcdGet (PcdExt4InstallDebugProtocol)) {
+    gBS->UninstallMultipleProtocolInterfaces (
+           ControllerHandle,
+           &gExt4DebugProtocolGuid,
+           &Partition->DebugInterface,
+           NULL
+           );
+  }
+
   // Close all open protocols (DiskIo, DiskIo2, BlockIo)
 
   Status = gBS->CloseProtocol (
@@ -17,6 +17,7 @@
 #include <Protocol/DiskIo.h>
 #include <Protocol/DiskIo2.h>
 #include <Protocol/SimpleFileSystem.h>
+#include <Protocol/Ext4Debug.h>
 
 #include <Library/PcdLib.h>
 #include <Library/DebugLib.h>
@@ -27,7 +28,6 @@
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
-#include <Library/OrderedCollectionLib.h>
 
 #include "Ext4Disk.h"
 
@@ -57,8 +57,100 @@ Ext4OpenPartition (
 typedef struct _Ext4File EXT4_FILE;
 typedef struct _Ext4_Dentry EXT4_DENTRY;
 
+/**
+   Partition-wide cache of filesystem blocks, used for metadata and small reads.
+   Blocks are indexed by a hash table of Buckets, and evicted in LRU order
+   once MaxEntries blocks are cached.
+ */
+typedef struct {
+  LIST_ENTRY    *Buckets;
+  UINTN         NumBuckets;
+  // Most recently used entries are at the head
+  LIST_ENTRY    LruList;
+  UINTN         NumEntries;
+  UINTN         MaxEntries;
+  // Media ID the cached blocks belong to
+  UINT32        MediaId;
+  UINT64        Hits;
+  UINT64        Misses;
+} EXT4_BLOCK_CACHE;
+
+/**
+   Partition-wide bookkeeping for the directory entry cache.
+   Dentries that aren't referenced by an open file or by a child stay cached
+   in an LRU list, and are only freed once more than MaxUnused of them exist.
+ */
+typedef struct {
+  // Least recently used dentries are at the tail
+  LIST_ENTRY    UnusedList;
+  UINTN         NumUnused;
+  UINTN         MaxUnused;
+} EXT4_DENTRY_CACHE;
+
+#define EXT4_TRANSACTION_BUCKETS  64
+
+/**
+   A filesystem block modified by the running transaction, followed by its data.
+ */
+typedef struct {
+  LIST_ENTRY       HashNode;
+  LIST_ENTRY       ListNode;
+  EXT4_BLOCK_NR    Block;
+} EXT4_BUFFER;
+
+#define EXT4_BUFFER_FROM_HASH_NODE(Node)  BASE_CR (Node, EXT4_BUFFER, HashNode)
+#define EXT4_BUFFER_FROM_LIST_NODE(Node)  BASE_CR (Node, EXT4_BUFFER, ListNode)
+#define EXT4_BUFFER_DATA(Buffer)          ((VOID *)((EXT4_BUFFER *)(Buffer) + 1))
+
+// A range of blocks freed by the running transaction
+typedef struct {
+  EXT4_BLOCK_NR    Start;
+  UINT64           Count;
+} EXT4_FREED_RANGE;
+
+/**
+   The metadata updates of a single filesystem operation (e.g a write or a file creation).
+   Metadata blocks are modified in buffers held by the transaction, which reads going
+   through the block cache see, and only reach the disk (through the journal, if there's
+   one) once the transaction is committed. If it's aborted instead, they're dropped.
+   Transactions nest: only the outermost Ext4EndTransaction commits.
+ */
+typedef struct {
+  LIST_ENTRY          Buckets[EXT4_TRANSACTION_BUCKETS];
+  // Sorted by block number, so the commit can merge adjacent blocks into a single write
+  LIST_ENTRY          Buffers;
+  UINTN               NumBuffers;
+  // Blocks freed by the transaction can't be reused before it's committed, since the
+  // data written to them doesn't go through the journal.
+  EXT4_FREED_RANGE    *Freed;
+  UINTN               NumFreed;
+  UINTN               MaxFreed;
+  BOOLEAN             SuperblockDirty;
+  UINTN               Depth;
+  // Set when a nested part of the transaction fails, which aborts all of it
+  BOOLEAN             Failed;
+} EXT4_TRANSACTION;
+
+/**
+   The partition's JBD2 journal, kept in the journal inode.
+ */
+typedef struct {
+  EXT4_FILE          *File;
+  // On-disk (big-endian) copy of the journal superblock
+  JBD2_SUPERBLOCK    SuperBlock;
+  UINT32             First;
+  UINT32             MaxLen;
+  UINT32             Incompat;
+  // ID of the next transaction, and the log block it's going to start at
+  UINT32             Sequence;
+  UINT32             Head;
+  UINTN              TagSize;
+  UINT32             CsumSeed;
+} EXT4_JOURNAL;
+
 typedef struct _Ext4_PARTITION {
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL    Interface;
+  EXT4_DEBUG_PROTOCOL                DebugInterface;
   EFI_DISK_IO_PROTOCOL               *DiskIo;
   EFI_DISK_IO2_PROTOCOL              *DiskIo2;
   EFI_BLOCK_IO_PROTOCOL              *BlockIo;
@@ -77,6 +169,10 @@ typedef struct _Ext4_PARTITION {
 
   EXT4_BLOCK_GROUP_DESC              *BlockGroups;
   UINT32                             DescSize;
+  // Bitmaps of the descriptor table blocks that were read, and of the descriptors that were
+  // verified. Only used when descriptors are loaded lazily (PcdExt4LazyBlockGroupDescs).
+  UINT8                              *BlockGroupsLoaded;
+  UINT8                              *BlockGroupsVerified;
   EXT4_FILE                          *Root;
 
   UINT32                             InitialSeed;
@@ -84,32 +180,51 @@ typedef struct _Ext4_PARTITION {
   LIST_ENTRY                         OpenFiles;
 
   EXT4_DENTRY                        *RootDentry;
+
+  EXT4_BLOCK_CACHE                   BlockCache;
+  EXT4_DENTRY_CACHE                  DentryCache;
+
+  // Running transaction, if any
+  EXT4_TRANSACTION                   *Transaction;
+  // Journal, if the filesystem has one
+  EXT4_JOURNAL                       *Journal;
 } EXT4_PARTITION;
 
+#define EXT4_PARTITION_FROM_DEBUG_INTERFACE(This)  BASE_CR (This, EXT4_PARTITION, DebugInterface)
+
 /**
-   This structure represents a directory entry inside our directory entry tree.
-   For now, it will be used as a way to track file names inside our opening code,
-   but it may very well be used as a directory cache in the future.
-   Because it's not being used as a directory cache right now,
-   an EXT4_DENTRY structure is not necessarily unique name-wise in the list of
-   children. Therefore, the dentry tree does not accurately reflect the filesystem
-   structure.
+   This structure represents a directory entry inside our directory entry tree,
+   which doubles as a directory cache.
+   Positive dentries are unique name-wise (using the exact, on-disk name) in
+   their parent's list of children. Negative dentries (Inode == 0) record names
+   that were looked up and didn't exist in the parent directory.
+   Children are kept in a small hash table, indexed by the case-folded name,
+   since EFI file name lookups are case-insensitive.
  */
 struct _Ext4_Dentry {
   UINTN                  RefCount;
   CHAR16                 Name[EXT4_NAME_MAX + 1];
   EXT4_INO_NR            Inode;
   struct _Ext4_Dentry    *Parent;
-  LIST_ENTRY             Children;
+  EXT4_PARTITION         *Partition;
+  // Array of EXT4_DENTRY_HASH_BUCKETS lists, allocated on the first child
+  LIST_ENTRY             *Children;
   LIST_ENTRY             ListNode;
+  // Linked into the partition's EXT4_DENTRY_CACHE when RefCount == 0
+  LIST_ENTRY             UnusedNode;
 };
 
+#define EXT4_DENTRY_HASH_BUCKETS  32
+
 #define EXT4_DENTRY_FROM_DENTRY_LIST(Node)  BASE_CR (Node, EXT4_DENTRY, ListNode)
+#define EXT4_DENTRY_FROM_UNUSED_LIST(Node)  BASE_CR (Node, EXT4_DENTRY, UnusedNode)
 
 /**
    Creates a new dentry object.
 
+   @param[in]              Partition   Pointer to the opened partition.
    @param[in]              Name        Name of the dentry.
+   @param[in]              Inode       Inode number of the dentry, or 0 if it's a negative dentry.
    @param[in out opt]      Parent      Parent dentry, if it's not NULL.
 
    @return The new allocated and initialised dentry.
@@ -117,10 +232,84 @@ struct _Ext4_Dentry {
 **/
 EXT4_DENTRY *
 Ext4CreateDentry (
+  IN EXT4_PARTITION   *Partition,
   IN CONST CHAR16     *Name,
+  IN EXT4_INO_NR      Inode,
   IN OUT EXT4_DENTRY  *Parent  OPTIONAL
   );
 
+/**
+   Looks up a name in the dentry cache.
+
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Name to look up, compared case-insensitively.
+
+   @return A referenced dentry (which may be negative), or NULL if the name isn't cached.
+**/
+EXT4_DENTRY *
+Ext4LookupDentry (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name
+  );
+
+/**
+   Gets the positive dentry for a name, creating it if it isn't cached yet.
+
+   @param[in]              Partition   Pointer to the opened partition.
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Exact (on-disk) name of the dentry.
+   @param[in]              Inode       Inode number the name points to.
+
+   @return A referenced dentry, or NULL if we ran out of memory.
+**/
+EXT4_DENTRY *
+Ext4GetDentry (
+  IN EXT4_PARTITION   *Partition,
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name,
+  IN EXT4_INO_NR      Inode
+  );
+
+/**
+   Frees every unused dentry in the partition's dentry cache.
+
+   @param[in out]          Partition   Pointer to the opened partition.
+**/
+VOID
+Ext4PurgeDentryCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Drops the cached negative dentries that a name matches, case-insensitively.
+   Needed once a file of that name is created.
+
+   @param[in out]          Parent      Parent dentry.
+   @param[in]              Name        Name of the new file.
+**/
+VOID
+Ext4DropNegativeDentries (
+  IN OUT EXT4_DENTRY  *Parent,
+  IN CONST CHAR16     *Name
+  );
+
+/**
+   Renames a positive dentry, and moves it to a new parent.
+
+   @param[in out]          Dentry      Dentry to rename.
+   @param[in out]          NewParent   New parent dentry. It may be the current one.
+   @param[in]              NewName     New (exact) name.
+
+   @retval EFI_SUCCESS           The dentry was renamed.
+   @retval EFI_OUT_OF_RESOURCES  The new parent's hash table could not be allocated.
+**/
+EFI_STATUS
+Ext4RenameDentry (
+  IN OUT EXT4_DENTRY  *Dentry,
+  IN OUT EXT4_DENTRY  *NewParent,
+  IN CONST CHAR16     *NewName
+  );
+
 /**
    Increments the ref count of the dentry.
 
@@ -133,7 +322,8 @@ Ext4RefDentry (
 
 /**
    Decrements the ref count of the dentry.
-   If the ref count is 0, it's destroyed.
+   If the ref count is 0, it's moved to the partition's dentry cache, or
+   destroyed if it can't be cached.
 
    @param[in out]            Dentry    Pointer to a valid EXT4_DENTRY.
 
@@ -207,6 +397,24 @@ Ext4ReadDiskIo (
   IN UINT64          Offset
   );
 
+/**
+   Writes to the partition's disk using the DISK_IO protocol.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the disk write.
+**/
+EFI_STATUS
+Ext4WriteDiskIo (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  );
+
 /**
    Reads blocks from the partition's disk using the DISK_IO protocol.
 
@@ -243,6 +451,109 @@ Ext4AllocAndReadBlocks (
   IN EXT4_BLOCK_NR   BlockNumber
   );
 
+/**
+   Reads from the partition's disk, going through the block cache.
+   Reads that span more than a few blocks bypass the cache and go directly to the disk.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  Length         Length of the destination buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to read.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  OUT VOID           *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  );
+
+/**
+   Writes to the partition's disk, updating the blocks the block cache holds.
+   Blocks that aren't cached are written straight to the disk, without being cached.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  );
+
+/**
+   Drops a range of blocks from the partition's block cache.
+   Needed when the blocks get written without going through the cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          First block of the range.
+   @param[in]      Count          Number of blocks in the range.
+**/
+VOID
+Ext4InvalidateBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     UINT64          Count
+  );
+
+/**
+   Initialises the partition's block cache.
+   Needs to be called after Partition->BlockSize is known.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The cache was initialised (or is disabled).
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4InitBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Drops every block from the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4InvalidateBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Frees the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Retrieves the statistics of the partition's block cache.
+
+   @param[in]   This   Pointer to the EXT4_DEBUG_PROTOCOL instance.
+   @param[out]  Stats  Pointer to the destination statistics structure.
+
+   @retval EFI_SUCCESS            The statistics were retrieved.
+   @retval EFI_INVALID_PARAMETER  This or Stats is NULL.
+**/
+EFI_STATUS
+EFIAPI
+Ext4DebugGetBlockCacheStats (
+  IN  EXT4_DEBUG_PROTOCOL           *This,
+  OUT EXT4_DEBUG_BLOCK_CACHE_STATS  *Stats
+  );
+
 /**
    Checks if the opened partition has the 64-bit feature (see EXT4_FEATURE_INCOMPAT_64BIT).
 
@@ -262,20 +573,363 @@ Ext4AllocAndReadBlocks (
    @return The block number formed by Low, and if 64 bit is enabled, High.
 **/
 #define EXT4_BLOCK_NR_FROM_HALFS(Partition, Low, High) \
-  EXT4_IS_64_BIT (Partition) ? (Low | LShiftU64 (High, 32)) : Low
+  (EXT4_IS_64_BIT (Partition) ? ((Low) | LShiftU64 (High, 32)) : (Low))
+
+/**
+   Gets the first inode number that isn't reserved by the filesystem.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+
+   @return The first non-reserved inode number.
+**/
+#define EXT4_FIRST_INO(Partition)                                          \
+  ((Partition)->SuperBlock.s_rev_level == EXT4_GOOD_OLD_REV ?              \
+   EXT4_GOOD_OLD_FIRST_INO : (Partition)->SuperBlock.s_first_ino)
+
+#define EXT4_BITMAP_TEST(Bitmap, Index)   (((Bitmap)[(Index) / 8] & (1 << ((Index) % 8))) != 0)
+#define EXT4_BITMAP_SET(Bitmap, Index)    ((Bitmap)[(Index) / 8] |= (UINT8)(1 << ((Index) % 8)))
+#define EXT4_BITMAP_CLEAR(Bitmap, Index)  ((Bitmap)[(Index) / 8] &= (UINT8) ~(1 << ((Index) % 8)))
+
+/**
+   Starts a transaction, or nests in the running one.
+   Every change to the filesystem's metadata needs to be done inside a transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The transaction was started.
+   @retval EFI_WRITE_PROTECTED   The partition is read-only.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4StartTransaction (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Ends (a nested level of) the running transaction.
+   When the outermost level ends, the transaction is committed if all of it succeeded, and
+   aborted otherwise. Aborting it reloads the metadata kept in memory (the superblock, the
+   block group descriptors and the inodes of the open files) from the disk.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Status         Result of the work done in this level of the transaction.
+
+   @return Status if it's an error, or the result of the commit.
+**/
+EFI_STATUS
+Ext4EndTransaction (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EFI_STATUS      Status
+  );
+
+/**
+   Gets a filesystem block ready to be modified by the running transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          Block number.
+   @param[in]      IsNew          If TRUE, the block's current contents don't matter (e.g it was
+                                  just allocated); it's zeroed instead of being read.
+   @param[out]     Data           Pointer to where the pointer to the block's data is stored.
+                                  It stays valid until the transaction ends, or the block is
+                                  forgotten.
+
+   @return Status of reading the block.
+**/
+EFI_STATUS
+Ext4ModifyBlock (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     BOOLEAN         IsNew,
+  OUT    VOID            **Data
+  );
+
+/**
+   Drops any changes the running transaction made to a range of blocks, and forgets
+   about them, since they were freed. Cached copies are dropped as well.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          First block of the range.
+   @param[in]      Count          Number of blocks in the range.
+
+   @retval EFI_SUCCESS           The blocks were forgotten.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4ForgetBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     UINT64          Count
+  );
+
+/**
+   Checks if a block was freed by the running transaction, and can't be reused yet.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          Block number.
+   @param[out]     End            If the block was freed, the block after the end of the
+                                  freed range it's in.
+
+   @return TRUE if the block was freed by the running transaction.
+**/
+BOOLEAN
+Ext4BlockWasFreed (
+  IN  CONST EXT4_PARTITION  *Partition,
+  IN  EXT4_BLOCK_NR         Block,
+  OUT EXT4_BLOCK_NR         *End
+  );
+
+/**
+   Marks the in-memory superblock as modified by the running transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4DirtySuperblock (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Applies the running transaction's changes to data read from the disk.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Buffer         Pointer to the data.
+   @param[in]      Length         Length of the data.
+   @param[in]      Offset         Offset, in bytes, of the data on the disk.
+**/
+VOID
+Ext4TransactionOverlay (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT VOID                  *Buffer,
+  IN     UINTN                 Length,
+  IN     UINT64                Offset
+  );
+
+/**
+   Computes the checksum of the superblock, and stores it in the superblock.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Sb             Pointer to the superblock.
+**/
+VOID
+Ext4UpdateSuperblockChecksum (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT EXT4_SUPERBLOCK       *Sb
+  );
+
+/**
+   Opens the partition's journal, and checks if Ext4Dxe can use it.
+   If it can't, the partition is made read-only.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The journal was opened, or the partition was made read-only.
+   @return Any error from reading the journal.
+**/
+EFI_STATUS
+Ext4OpenJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Closes the partition's journal.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4CloseJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Replays the committed transactions in the journal, and marks the journal as empty.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The journal was replayed.
+   @return Any error from replaying it.
+**/
+EFI_STATUS
+Ext4RecoverJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Writes the running transaction's blocks to the journal, followed by the commit block.
+   Once this succeeds, the transaction survives a power loss.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The transaction was committed to the journal.
+   @retval EFI_VOLUME_FULL       The transaction doesn't fit in the journal.
+   @return Any error from writing to the disk.
+**/
+EFI_STATUS
+Ext4JournalCommit (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Marks the journal as empty, once the committed transaction was written to its final
+   location (checkpointed).
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @return Status of updating the journal.
+**/
+EFI_STATUS
+Ext4JournalCheckpointed (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Allocates a run of contiguous blocks, as close as possible to a goal block.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Goal           Block the run should start at, ideally.
+   @param[in out]  Count          On input, the number of blocks wanted. On output,
+                                  the number of blocks allocated, which may be less.
+   @param[out]     Start          First block of the allocated run.
+
+   @retval EFI_SUCCESS           At least one block was allocated.
+   @retval EFI_VOLUME_FULL       There are no free blocks.
+   @retval EFI_VOLUME_CORRUPTED  The free block accounting is corrupted.
+**/
+EFI_STATUS
+Ext4AllocateBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Goal,
+  IN OUT UINT32          *Count,
+  OUT    EXT4_BLOCK_NR   *Start
+  );
+
+/**
+   Frees a range of blocks.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Start          First block of the range.
+   @param[in]      Count          Number of blocks.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_VOLUME_CORRUPTED  The range isn't valid, or some block wasn't in use.
+**/
+EFI_STATUS
+Ext4FreeBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Start,
+  IN     UINT64          Count
+  );
+
+/**
+   Allocates an inode number.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Goal           Inode whose block group is tried first (e.g the parent directory).
+   @param[in]      IsDir          TRUE if the inode is going to be a directory.
+   @param[out]     InodeNum       Number of the allocated inode.
+
+   @retval EFI_SUCCESS           The inode was allocated.
+   @retval EFI_VOLUME_FULL       There are no free inodes.
+   @retval EFI_VOLUME_CORRUPTED  The free inode accounting is corrupted.
+**/
+EFI_STATUS
+Ext4AllocateInodeNumber (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     Goal,
+  IN     BOOLEAN         IsDir,
+  OUT    EXT4_INO_NR     *InodeNum
+  );
+
+/**
+   Frees an inode number.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      InodeNum       Number of the inode.
+   @param[in]      IsDir          TRUE if the inode was a directory.
+
+   @retval EFI_SUCCESS           The inode was freed.
+   @retval EFI_VOLUME_CORRUPTED  The inode wasn't in use.
+**/
+EFI_STATUS
+Ext4FreeInodeNumber (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     InodeNum,
+  IN     BOOLEAN         IsDir
+  );
+
+/**
+   Sets up the partition's block group descriptors.
+
+   Unless PcdExt4LazyBlockGroupDescs is set, the whole descriptor table is read and verified
+   right away. Otherwise, each block of the table is only read when one of its descriptors is
+   first needed, and each descriptor is only verified when it's first needed.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The descriptors were set up.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+   @retval EFI_VOLUME_CORRUPTED  A descriptor has an invalid checksum.
+**/
+EFI_STATUS
+Ext4LoadBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Frees the partition's block group descriptors.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
+  );
 
 /**
    Retrieves a block group descriptor of the ext4 filesystem.
+   If the descriptor hasn't been used before, it's read and verified first.
 
    @param[in]  Partition      Pointer to the opened ext4 partition.
-   @param[in]  BlockGroup    Block group number.
+   @param[in]  BlockGroup     Block group number.
+   @param[out] Desc           Pointer to where the pointer to the block group descriptor is stored.
+
+   @retval EFI_SUCCESS           The descriptor was retrieved.
+   @retval EFI_VOLUME_CORRUPTED  The block group doesn't exist, or its descriptor has an
+                                 invalid checksum.
+   @return Any error from reading the descriptor table.
+**/
+EFI_STATUS
+Ext4GetBlockGroupDesc (
+  IN  EXT4_PARTITION         *Partition,
+  IN  UINT32                 BlockGroup,
+  OUT EXT4_BLOCK_GROUP_DESC  **Desc
+  );
+
+/**
+   Writes a modified block group descriptor to the running transaction, updating its
+   checksum first.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      BlockGroup     Block group number.
+
+   @return Status of getting the descriptor table block ready to be modified.
+**/
+EFI_STATUS
+Ext4DirtyBlockGroupDesc (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     UINT32          BlockGroup
+  );
+
+/**
+   Throws away the in-memory block group descriptors, so that they're read again from
+   the disk. Used when a transaction that modified them is aborted.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
 
-   @return A pointer to the block group descriptor.
+   @return Status of reading the descriptors again.
 **/
-EXT4_BLOCK_GROUP_DESC *
-Ext4GetBlockGroupDesc (
-  IN EXT4_PARTITION  *Partition,
-  IN UINT32          BlockGroup
+EFI_STATUS
+Ext4ReloadBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition
   );
 
 /**
@@ -294,6 +948,23 @@ Ext4ReadInode (
   OUT EXT4_INODE      **OutIno
   );
 
+/**
+   Writes an inode to the running transaction (or to a transaction of its own, if there's
+   none), updating its checksum first. The other open handles of the inode get the new copy.
+
+   @param[in]      Partition  Pointer to the opened partition.
+   @param[in]      InodeNum   Number of the inode.
+   @param[in out]  Inode      Pointer to the inode.
+
+   @return Status of the inode write.
+**/
+EFI_STATUS
+Ext4WriteInode (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_INO_NR     InodeNum,
+  IN OUT EXT4_INODE      *Inode
+  );
+
 /**
    Converts blocks to bytes.
 
@@ -324,6 +995,94 @@ Ext4Read (
   IN OUT UINTN           *Length
   );
 
+/**
+   Writes to an EXT4 inode, and updates its modification time.
+   Holes (and the end of the file) get blocks allocated, and uninitialized extents are
+   converted. The metadata changes are done in a single transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the data to write.
+   @param[in]      Offset        Offset of the write.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @retval EFI_SUCCESS           The whole buffer was written.
+   @retval EFI_UNSUPPORTED       The file doesn't use extents.
+   @retval EFI_VOLUME_FULL       There's no space left. The file wasn't changed.
+   @return Status of the write operation.
+**/
+EFI_STATUS
+Ext4Write (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN CONST VOID      *Buffer,
+  IN UINT64          Offset,
+  IN UINTN           Length
+  );
+
+/**
+   Changes the size of an EXT4 inode. Blocks past the new end of the file are freed, and
+   extending the file leaves a hole.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Size          New size, in bytes.
+
+   @retval EFI_SUCCESS           The size was changed.
+   @retval EFI_UNSUPPORTED       The file doesn't use extents.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4SetFileSize (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN UINT64          Size
+  );
+
+/**
+   Picks the block a file's new blocks should ideally be allocated at: right after
+   the block that comes before them in the file, or else in the inode's block group.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      LogicalBlock  First logical block that's going to be allocated.
+
+   @return The goal block.
+**/
+EXT4_BLOCK_NR
+Ext4FileAllocationGoal (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock
+  );
+
+/**
+   Reads from an EXT4 inode asynchronously, using DISK_IO2.
+   Every extent covered by the read gets its own disk request, and the caller's
+   token is signalled once all of them complete.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the read.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 After a succesful submission, it's updated to the number
+                                 of bytes that are going to be read.
+   @param[in out]  Token         Pointer to the caller's token, which is signalled on completion.
+
+   @retval EFI_SUCCESS           The read was submitted; Token will be signalled on completion.
+   @retval !EFI_SUCCESS          The read failed to be submitted, and Token will not be signalled.
+**/
+EFI_STATUS
+Ext4ReadAsync (
+  IN     EXT4_PARTITION     *Partition,
+  IN     EXT4_FILE          *File,
+  OUT    VOID               *Buffer,
+  IN     UINT64             Offset,
+  IN OUT UINTN              *Length,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
 /**
    Retrieves the size of the inode.
 
@@ -333,24 +1092,49 @@ Ext4Read (
 **/
 #define EXT4_INODE_SIZE(Inode)  (LShiftU64 (Inode->i_size_hi, 32) | Inode->i_size_lo)
 
+/**
+   Retrieves the maximum size of a file that uses extents, which map 32-bit logical blocks.
+
+   @param[in]    Partition  Pointer to the opened partition.
+
+   @return The maximum size of a file, in bytes.
+**/
+#define EXT4_MAX_FILE_SIZE(Partition)  MultU64x32 (MAX_UINT32, (Partition)->BlockSize)
+
 /**
    Retrieves an extent from an EXT4 inode.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
    @param[in]      File          Pointer to the opened file.
    @param[in]      LogicalBlock  Block number which the returned extent must cover.
    @param[out]     Extent        Pointer to the output buffer, where the extent will be copied to.
+   @param[out]     HoleLength    If the block has no mapping, the number of blocks until the
+                                 next mapped block (or the end of the file's address space).
+                                 Optional.
 
    @retval EFI_SUCCESS        Retrieval was succesful.
    @retval EFI_NO_MAPPING     Block has no mapping.
 **/
 EFI_STATUS
 Ext4GetExtent (
-  IN  EXT4_PARTITION  *Partition,
-  IN  EXT4_FILE       *File,
-  IN  EXT4_BLOCK_NR   LogicalBlock,
-  OUT EXT4_EXTENT     *Extent
+  IN  EXT4_PARTITION          *Partition,
+  IN  EXT4_FILE               *File,
+  IN  EXT4_BLOCK_NR           LogicalBlock,
+  OUT EXT4_EXTENT             *Extent,
+  OUT OPTIONAL EXT4_BLOCK_NR  *HoleLength
   );
 
+// Number of extents the extents map is first allocated with
+#define EXT4_EXTENT_MAP_CHUNK  64
+
+// Cache of a file's extents, shared between all the open handles of an inode
+typedef struct {
+  // Sorted by logical block, and non-overlapping
+  EXT4_EXTENT    *Extents;
+  UINTN          NumExtents;
+  UINTN          MaxExtents;
+  UINTN          RefCount;
+} EXT4_EXTENT_MAP;
+
 struct _Ext4File {
   EFI_FILE_PROTOCOL     Protocol;
   EXT4_INODE            *Inode;
@@ -361,7 +1145,7 @@ struct _Ext4File {
 
   EXT4_PARTITION        *Partition;
 
-  ORDERED_COLLECTION    *ExtentsMap;
+  EXT4_EXTENT_MAP       *ExtentsMap;
 
   LIST_ENTRY            OpenFilesListNode;
 
@@ -736,6 +1520,143 @@ Ext4SetInfo (
   IN VOID               *Buffer
   );
 
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]  This             A pointer to the EFI_FILE_PROTOCOL instance that is the file
+                               handle to flush.
+
+  @retval EFI_SUCCESS          The data was flushed.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED    The file was opened read-only.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4Flush (
+  IN EFI_FILE_PROTOCOL  *This
+  );
+
+/**
+  Opens a new file relative to the source directory's location.
+
+  @param[in]      This        A pointer to the EFI_FILE_PROTOCOL instance that is the file
+                              handle to the source location.
+  @param[out]     NewHandle   A pointer to the location to return the opened handle for the new
+                              file.
+  @param[in]      FileName    The Null-terminated string of the name of the file to be opened.
+                              The file name may contain the following path modifiers: "\", ".",
+                              and "..".
+  @param[in]      OpenMode    The mode to open the file. The only valid combinations that the
+                              file may be opened with are: Read, Read/Write, or Create/Read/Write.
+  @param[in]      Attributes  Only valid for EFI_FILE_MODE_CREATE, in which case these are the
+                              attribute bits for the newly created file.
+  @param[in out]  Token       A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          If Event is NULL (blocking I/O): The file was opened.
+                               If Event is not NULL (asynchronous I/O): The request was
+                               successfully queued for processing.
+  @retval EFI_NOT_FOUND        The specified file could not be found on the device.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_MEDIA_CHANGED    The device has a different medium in it or the medium is no
+                               longer supported.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  An attempt was made to create a file, or open a file for write
+                               when the media is write-protected.
+  @retval EFI_ACCESS_DENIED    The service denied access to the file.
+  @retval EFI_OUT_OF_RESOURCES Not enough resources were available to open the file.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4OpenEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  OUT EFI_FILE_PROTOCOL     **NewHandle,
+  IN CHAR16                 *FileName,
+  IN UINT64                 OpenMode,
+  IN UINT64                 Attributes,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Reads data from a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to read data from.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was read successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_DEVICE_ERROR      An attempt was made to read from a deleted file.
+  @retval EFI_DEVICE_ERROR      On entry, the current file position is beyond the end of the file.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4ReadEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Writes data to a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to write data to.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was written successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_UNSUPPORTED       Writes to open directory files are not supported.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_DEVICE_ERROR      An attempt was made to write to a deleted file.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED   The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED     The file was opened read only.
+  @retval EFI_VOLUME_FULL       The volume is full.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4WriteEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to flush.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was flushed successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED   The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED     The file was opened read-only.
+  @retval EFI_VOLUME_FULL       The volume is full.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4FlushEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
 // EFI_FILE_PROTOCOL implementation ends here.
 
 /**
@@ -811,6 +1732,43 @@ Ext4FileMTime (
   OUT EFI_TIME  *Time
   );
 
+// Which of an inode's timestamps Ext4SetInodeTimes sets
+#define EXT4_INODE_ATIME   BIT0
+#define EXT4_INODE_MTIME   BIT1
+#define EXT4_INODE_CTIME   BIT2
+#define EXT4_INODE_CRTIME  BIT3
+
+/**
+   Sets some of an inode's timestamps.
+   The inode still has to be written back to the disk.
+
+   @param[in out]  Inode    Pointer to the inode.
+   @param[in]      Time     Time to set, or NULL to use the current time.
+   @param[in]      Fields   Timestamps to set (EXT4_INODE_*TIME).
+
+   @retval EFI_SUCCESS            The times were set.
+   @retval EFI_INVALID_PARAMETER  Time isn't valid.
+   @return The current time couldn't be read.
+**/
+EFI_STATUS
+Ext4SetInodeTimes (
+  IN OUT EXT4_INODE      *Inode,
+  IN     CONST EFI_TIME  *Time  OPTIONAL,
+  IN     UINT32          Fields
+  );
+
+/**
+   Sets the file's last modification and change times to the current time.
+   If the current time can't be read, the times are left alone.
+   The inode still has to be written back to the disk.
+
+   @param[in]      File   Pointer to the opened file.
+**/
+VOID
+Ext4FileTouch (
+  IN EXT4_FILE  *File
+  );
+
 /**
    Gets the file's creation time, if possible.
    @param[in]      File   Pointer to the opened file.
@@ -908,7 +1866,9 @@ Ext4ReadDir (
   );
 
 /**
-   Initialises the (empty) extents map, that will work as a cache of extents.
+   Initialises the extents map, that will work as a cache of extents.
+   If another handle of the same inode is open, its map gets shared instead.
+   Needs File->Partition and File->InodeNum to be set.
 
    @param[in]      File        Pointer to the open file.
 
@@ -920,7 +1880,7 @@ Ext4InitExtentsMap (
   );
 
 /**
-   Frees the extents map, deleting every extent stored.
+   Releases the file's reference to the extents map, freeing it if it was the last one.
 
    @param[in]      File        Pointer to the open file.
 **/
@@ -929,6 +1889,210 @@ Ext4FreeExtentsMap (
   IN EXT4_FILE  *File
   );
 
+/**
+   Drops the cached extents of the file (and of the other handles of the inode), after
+   its extent tree was changed.
+
+   @param[in]      File        Pointer to the open file.
+**/
+VOID
+Ext4ResetExtentsMap (
+  IN EXT4_FILE  *File
+  );
+
+/**
+   Inserts an extent into the file's extent tree, as part of the running transaction.
+   The extent's blocks must not be mapped yet. It's merged with its neighbours when
+   possible, and the tree grows as needed, allocating blocks for it.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file.
+   @param[in]      Extent      Pointer to the extent to insert.
+
+   @retval EFI_SUCCESS           The extent was inserted.
+   @retval EFI_VOLUME_FULL       No blocks could be allocated to grow the tree.
+   @retval EFI_VOLUME_CORRUPTED  The extent tree is corrupted.
+**/
+EFI_STATUS
+Ext4InsertExtent (
+  IN EXT4_PARTITION     *Partition,
+  IN EXT4_FILE          *File,
+  IN CONST EXT4_EXTENT  *Extent
+  );
+
+/**
+   Marks a range of blocks of a file as initialized, as part of the running transaction.
+   Every block of the range must be mapped by an uninitialized extent, which gets split
+   if the range doesn't cover all of it.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      LogicalBlock  First block of the range.
+   @param[in]      Count         Number of blocks in the range.
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4MarkExtentsInitialized (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock,
+  IN EXT4_BLOCK_NR   Count
+  );
+
+/**
+   Frees every block of a file from a logical block onwards, as part of the running
+   transaction, along with the extent tree blocks that end up empty.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      LogicalBlock  First block to free.
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4TruncateExtents (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock
+  );
+
+/**
+   Adds to (or subtracts from) the number of blocks an inode uses.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Blocks        Number of filesystem blocks to add. Negative to subtract.
+
+   @retval EFI_SUCCESS           The count was updated.
+   @retval EFI_VOLUME_FULL       The count doesn't fit in the inode.
+**/
+EFI_STATUS
+Ext4InodeAddBlocks (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT EXT4_INODE            *Inode,
+  IN     INT64                 Blocks
+  );
+
+/**
+   Adds a directory entry to a directory, as part of the running transaction.
+   Linear directories get a new block if none has enough space, and full leaves of
+   indexed ones get split.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Name        Exact (on-disk) name of the entry.
+   @param[in]      InodeNum    Inode number the entry points to.
+   @param[in]      FileType    File type of the inode (EXT4_FT_*).
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4AddDirent (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *Directory,
+  IN CONST CHAR16    *Name,
+  IN EXT4_INO_NR     InodeNum,
+  IN UINT8           FileType
+  );
+
+/**
+   Removes a directory entry from a directory, as part of the running transaction.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Name        Exact (on-disk) name of the entry.
+
+   @retval EFI_SUCCESS           The entry was removed.
+   @retval EFI_NOT_FOUND         There's no entry with that name.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4RemoveDirent (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *Directory,
+  IN CONST CHAR16    *Name
+  );
+
+/**
+   Checks if a directory has no entries, other than "." and "..".
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[out]     IsEmpty     Pointer to the result.
+
+   @return Status of reading the directory.
+**/
+EFI_STATUS
+Ext4DirIsEmpty (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT BOOLEAN         *IsEmpty
+  );
+
+/**
+   Creates a file or directory, and opens it.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      Directory   Pointer to the open parent directory.
+   @param[in]      Name        Name of the new file.
+   @param[in]      Attributes  EFI file attributes of the new file.
+   @param[in]      OpenMode    Mode in which the file is supposed to be open.
+   @param[out]     OutFile     Pointer to the newly opened file.
+
+   @retval EFI_SUCCESS           The file was created.
+   @retval EFI_VOLUME_FULL       There's no space for the file.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4CreateFile (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  UINT64          Attributes,
+  IN  UINT64          OpenMode,
+  OUT EXT4_FILE       **OutFile
+  );
+
+/**
+   Removes a file's name from its parent directory, and frees the file once it has no
+   names left.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file. It must be the only handle of the inode.
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4UnlinkFile (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File
+  );
+
+/**
+   Renames a file, possibly moving it to another directory.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file.
+   @param[in]      NewPath     New name of the file. If it has path separators, it's relative
+                               to the file's parent directory (or to the root, if it starts
+                               with one).
+
+   @retval EFI_SUCCESS           The file was renamed.
+   @retval EFI_ACCESS_DENIED     A file with the new name already exists, or a directory
+                                 would be moved inside of itself.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4RenameFile (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN CONST CHAR16    *NewPath
+  );
+
 /**
    Calculates the CRC32c checksum of the given buffer.
 
@@ -961,6 +2125,27 @@ CalculateCrc16 (
   IN UINT16      InitialValue
   );
 
+/**
+   Calculates the directory hash of a name, as stored in an htree directory index.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      HashVersion   Hash algorithm (EXT4_DX_HASH_*), with the signedness already resolved.
+   @param[in]      Name          Pointer to the UTF-8 name.
+   @param[in]      Length        Length of the name, in bytes.
+   @param[out]     Hash          Pointer to the resulting (major) hash.
+
+   @retval EFI_SUCCESS        The hash was calculated.
+   @retval EFI_UNSUPPORTED    The hash algorithm is not supported.
+**/
+EFI_STATUS
+Ext4DirHash (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT8                 HashVersion,
+  IN CONST CHAR8           *Name,
+  IN UINTN                 Length,
+  OUT UINT32               *Hash
+  );
+
 /**
    Calculates the checksum of the given buffer.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -1098,7 +2283,7 @@ Ext4CalculateBlockGroupDescChecksum (
    @return TRUE if the gdt_csum is supported, else FALSE.
 **/
 #define EXT4_HAS_GDT_CSUM(Partition) \
-  EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_METADATA_CSUM)
+  EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_GDT_CSUM)
 
 /**
    Retrieves the volume name.
@@ -7,6 +7,13 @@
 
 #include "Ext4Dxe.h"
 
+// The checksum of an extent tree block comes right after the eh_max entries it has room for
+#define EXT4_EXTENT_TAIL_OFFSET(Header) \
+  (sizeof (EXT4_EXTENT_HEADER) + sizeof (EXT4_EXTENT) * (Header)->eh_max)
+
+#define EXT4_FIRST_EXTENT(Header)  ((EXT4_EXTENT *)((EXT4_EXTENT_HEADER *)(Header) + 1))
+#define EXT4_FIRST_INDEX(Header)   ((EXT4_EXTENT_INDEX *)((EXT4_EXTENT_HEADER *)(Header) + 1))
+
 /**
    Checks if the checksum of the extent data block is correct.
    @param[in]      ExtHeader     Pointer to the EXT4_EXTENT_HEADER.
@@ -34,7 +41,7 @@ Ext4CalculateExtentChecksum (
   );
 
 /**
-   Caches a range of extents, by allocating pool memory for each extent and adding it to the tree.
+   Caches a range of extents, by inserting them into the file's sorted extent array.
 
    @param[in]      File        Pointer to the open file.
    @param[in]      Extents     Pointer to an array of extents.
@@ -80,13 +87,15 @@ Ext4GetInoExtentHeader (
 /**
    Checks if an extent header is valid.
    @param[in]      Header         Pointer to the EXT4_EXTENT_HEADER structure.
+   @param[in]      MaxEntries     Number of entries that fit in the tree node.
 
    @return TRUE if valid, FALSE if not.
 **/
 STATIC
 BOOLEAN
 Ext4ExtentHeaderValid (
-  IN CONST EXT4_EXTENT_HEADER  *Header
+  IN CONST EXT4_EXTENT_HEADER  *Header,
+  IN UINTN                     MaxEntries
   )
 {
   if (Header->eh_depth > EXT4_EXTENT_TREE_MAX_DEPTH) {
@@ -109,6 +118,18 @@ Ext4ExtentHeaderValid (
     return FALSE;
   }
 
+  // eh_max can't claim more room than the node has, or we'd walk off its end
+  if (Header->eh_max > MaxEntries) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Invalid extent header max entries %u\n", Header->eh_max));
+    return FALSE;
+  }
+
+  // Index nodes always point to something
+  if ((Header->eh_depth != 0) && (Header->eh_entries == 0)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Empty extent index node\n"));
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -218,16 +239,20 @@ Ext4ExtentIdxLeafBlock (
    @param[in]      File          Pointer to the opened file.
    @param[in]      LogicalBlock  Block number which the returned extent must cover.
    @param[out]     Extent        Pointer to the output buffer, where the extent will be copied to.
+   @param[out]     HoleLength    If the block has no mapping, the number of blocks until the
+                                 next mapped block (or the end of the file's address space).
+                                 Optional.
 
    @retval EFI_SUCCESS        Retrieval was succesful.
    @retval EFI_NO_MAPPING     Block has no mapping.
 **/
 EFI_STATUS
 Ext4GetExtent (
-  IN  EXT4_PARTITION  *Partition,
-  IN  EXT4_FILE       *File,
-  IN  EXT4_BLOCK_NR   LogicalBlock,
-  OUT EXT4_EXTENT     *Extent
+  IN  EXT4_PARTITION          *Partition,
+  IN  EXT4_FILE               *File,
+  IN  EXT4_BLOCK_NR           LogicalBlock,
+  OUT EXT4_EXTENT             *Extent,
+  OUT OPTIONAL EXT4_BLOCK_NR  *HoleLength
   )
 {
   EXT4_INODE          *Inode;
@@ -237,6 +262,7 @@ Ext4GetExtent (
   EXT4_EXTENT_HEADER  *ExtHeader;
   EXT4_EXTENT_INDEX   *Index;
   EFI_STATUS          Status;
+  EXT4_BLOCK_NR       NextMapped;
 
   Inode  = File->Inode;
   Ext    = NULL;
@@ -250,6 +276,10 @@ Ext4GetExtent (
 
   // ext4 does not have support for logical block numbers bigger than UINT32_MAX
   if (LogicalBlock > (UINT32)- 1) {
+    if (HoleLength != NULL) {
+      *HoleLength = (UINT32)- 1;
+    }
+
     return EFI_NO_MAPPING;
   }
 
@@ -265,12 +295,16 @@ Ext4GetExtent (
 
   ExtHeader = Ext4GetInoExtentHeader (Inode);
 
-  if (!Ext4ExtentHeaderValid (ExtHeader)) {
+  if (!Ext4ExtentHeaderValid (ExtHeader, EXT4_INODE_EXTENT_ENTRIES)) {
     return EFI_VOLUME_CORRUPTED;
   }
 
   CurrentDepth = ExtHeader->eh_depth;
 
+  // Upper bound of the hole LogicalBlock may be in, narrowed down as we go down the tree.
+  // It starts out as one past the last possible logical block.
+  NextMapped = (EXT4_BLOCK_NR)(UINT32)- 1 + 1;
+
   while (ExtHeader->eh_depth != 0) {
     CurrentDepth--;
     // While depth != 0, we're traversing the tree itself and not any leaves
@@ -281,6 +315,10 @@ Ext4GetExtent (
 
     Index = Ext4BinsearchExtentIndex (ExtHeader, LogicalBlock);
 
+    if (Index + 1 < (EXT4_EXTENT_INDEX *)(ExtHeader + 1) + ExtHeader->eh_entries) {
+      NextMapped = Index[1].ei_block;
+    }
+
     if (Buffer == NULL) {
       Buffer = AllocatePool (Partition->BlockSize);
       if (Buffer == NULL) {
@@ -290,7 +328,12 @@ Ext4GetExtent (
 
     // Read the leaf block onto the previously-allocated buffer.
 
-    Status = Ext4ReadBlocks (Partition, Buffer, 1, Ext4ExtentIdxLeafBlock (Index));
+    Status = Ext4ReadDiskIoCached (
+               Partition,
+               Buffer,
+               Partition->BlockSize,
+               EXT4_BLOCK_TO_BYTES (Partition, Ext4ExtentIdxLeafBlock (Index))
+               );
     if (EFI_ERROR (Status)) {
       FreePool (Buffer);
       return Status;
@@ -298,7 +341,7 @@ Ext4GetExtent (
 
     ExtHeader = Buffer;
 
-    if (!Ext4ExtentHeaderValid (ExtHeader)) {
+    if (!Ext4ExtentHeaderValid (ExtHeader, EXT4_BLOCK_EXTENT_ENTRIES (Partition->BlockSize))) {
       FreePool (Buffer);
       return EFI_VOLUME_CORRUPTED;
     }
@@ -329,11 +372,27 @@ Ext4GetExtent (
       FreePool (Buffer);
     }
 
+    if (HoleLength != NULL) {
+      *HoleLength = NextMapped > LogicalBlock ? NextMapped - LogicalBlock : 1;
+    }
+
     return EFI_NO_MAPPING;
   }
 
   if (!(LogicalBlock >= Ext->ee_block && Ext->ee_block + Ext4GetExtentLength (Ext) > LogicalBlock)) {
-    // This extent does not cover the block
+    // This extent does not cover the block. The hole ends at the next extent in the leaf,
+    // or at the next index if this is the last one.
+    if (LogicalBlock < Ext->ee_block) {
+      NextMapped = Ext->ee_block;
+    } else if (Ext + 1 < (EXT4_EXTENT *)(ExtHeader + 1) + ExtHeader->eh_entries) {
+      NextMapped = Ext[1].ee_block;
+    }
+
+    if (HoleLength != NULL) {
+      // Guard against unsorted (corrupted) trees; we'll just look the next block up again.
+      *HoleLength = NextMapped > LogicalBlock ? NextMapped - LogicalBlock : 1;
+    }
+
     if (Buffer != NULL) {
       FreePool (Buffer);
     }
@@ -351,127 +410,174 @@ Ext4GetExtent (
 }
 
 /**
-  Compare two EXT4_EXTENT structs.
-  Used in the extent map's ORDERED_COLLECTION.
-
-  @param[in] UserStruct1  Pointer to the first user structure.
-
-  @param[in] UserStruct2  Pointer to the second user structure.
+   Finds the first extent in the map that starts after a given logical block.
 
-  @retval <0  If UserStruct1 compares less than UserStruct2.
+   @param[in]      Map           Pointer to the extents map.
+   @param[in]      Block         Logical block.
 
-  @retval  0  If UserStruct1 compares equal to UserStruct2.
-
-  @retval >0  If UserStruct1 compares greater than UserStruct2.
+   @return Index of the extent, or Map->NumExtents if there's none.
 **/
 STATIC
-INTN
-EFIAPI
-Ext4ExtentsMapStructCompare (
-  IN CONST VOID  *UserStruct1,
-  IN CONST VOID  *UserStruct2
+UINTN
+Ext4ExtentsMapUpperBound (
+  IN CONST EXT4_EXTENT_MAP  *Map,
+  IN UINT32                 Block
   )
 {
-  CONST EXT4_EXTENT  *Extent1;
-  CONST EXT4_EXTENT  *Extent2;
-
-  Extent1 = UserStruct1;
-  Extent2 = UserStruct2;
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
 
-  return Extent1->ee_block < Extent2->ee_block ? - 1 :
-         Extent1->ee_block > Extent2->ee_block ? 1 : 0;
-}
+  Low  = 0;
+  High = Map->NumExtents;
 
-/**
-  Compare a standalone key against a EXT4_EXTENT containing an embedded key.
-  Used in the extent map's ORDERED_COLLECTION.
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
 
-  @param[in] StandaloneKey  Pointer to the bare key.
+    if (Block < Map->Extents[Middle].ee_block) {
+      High = Middle;
+    } else {
+      Low = Middle + 1;
+    }
+  }
 
-  @param[in] UserStruct     Pointer to the user structure with the embedded
-                            key.
+  return Low;
+}
 
-  @retval <0  If StandaloneKey compares less than UserStruct's key.
+/**
+   Initialises the extents map, that will work as a cache of extents.
+   If another handle of the same inode is open, its map gets shared instead.
+   Needs File->Partition and File->InodeNum to be set.
 
-  @retval  0  If StandaloneKey compares equal to UserStruct's key.
+   @param[in]      File        Pointer to the open file.
 
-  @retval >0  If StandaloneKey compares greater than UserStruct's key.
+   @return Result of the operation.
 **/
-STATIC
-INTN
-EFIAPI
-Ext4ExtentsMapKeyCompare (
-  IN CONST VOID  *StandaloneKey,
-  IN CONST VOID  *UserStruct
+EFI_STATUS
+Ext4InitExtentsMap (
+  IN EXT4_FILE  *File
   )
 {
-  CONST EXT4_EXTENT  *Extent;
-  UINT32             Block;
+  LIST_ENTRY  *Entry;
+  EXT4_FILE   *Other;
+
+  // There are only ever a handful of open files, so a linear search is fine.
+  BASE_LIST_FOR_EACH (Entry, &File->Partition->OpenFiles) {
+    Other = EXT4_FILE_FROM_OPEN_FILES_NODE (Entry);
 
-  // Note that logical blocks are 32-bits in size so no truncation can happen here
-  // with regards to 32-bit architectures.
-  Extent = UserStruct;
-  Block  = (UINT32)(UINTN)StandaloneKey;
+    if ((Other != File) && (Other->InodeNum == File->InodeNum) && (Other->ExtentsMap != NULL)) {
+      File->ExtentsMap = Other->ExtentsMap;
+      File->ExtentsMap->RefCount++;
+      return EFI_SUCCESS;
+    }
+  }
 
-  if (Block >= Extent->ee_block && Block < Extent->ee_block + Ext4GetExtentLength (Extent)) {
-    return 0;
+  File->ExtentsMap = AllocateZeroPool (sizeof (EXT4_EXTENT_MAP));
+  if (File->ExtentsMap == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  return Block < Extent->ee_block ? - 1 :
-         Block > Extent->ee_block ? 1 : 0;
+  File->ExtentsMap->RefCount = 1;
+
+  return EFI_SUCCESS;
 }
 
 /**
-   Initialises the (empty) extents map, that will work as a cache of extents.
+   Releases the file's reference to the extents map, freeing it if it was the last one.
 
    @param[in]      File        Pointer to the open file.
-
-   @return Result of the operation.
 **/
-EFI_STATUS
-Ext4InitExtentsMap (
+VOID
+Ext4FreeExtentsMap (
   IN EXT4_FILE  *File
   )
 {
-  File->ExtentsMap = OrderedCollectionInit (Ext4ExtentsMapStructCompare, Ext4ExtentsMapKeyCompare);
-  if (!File->ExtentsMap) {
-    return EFI_OUT_OF_RESOURCES;
+  EXT4_EXTENT_MAP  *Map;
+
+  Map              = File->ExtentsMap;
+  File->ExtentsMap = NULL;
+
+  if (Map == NULL) {
+    return;
   }
 
-  return EFI_SUCCESS;
+  ASSERT (Map->RefCount != 0);
+
+  if (--Map->RefCount != 0) {
+    return;
+  }
+
+  if (Map->Extents != NULL) {
+    FreePool (Map->Extents);
+  }
+
+  FreePool (Map);
 }
 
 /**
-   Frees the extents map, deleting every extent stored.
+   Drops the cached extents of the file (and of the other handles of the inode), after
+   its extent tree was changed.
 
    @param[in]      File        Pointer to the open file.
 **/
 VOID
-Ext4FreeExtentsMap (
+Ext4ResetExtentsMap (
   IN EXT4_FILE  *File
   )
 {
-  // Keep calling Min(), so we get an arbitrary node we can delete.
-  // If Min() returns NULL, it's empty.
+  EXT4_EXTENT_MAP  *Map;
 
-  ORDERED_COLLECTION_ENTRY  *MinEntry;
-  EXT4_EXTENT               *Ext;
+  Map = File->ExtentsMap;
 
-  MinEntry = NULL;
+  if (Map == NULL) {
+    return;
+  }
 
-  while ((MinEntry = OrderedCollectionMin (File->ExtentsMap)) != NULL) {
-    OrderedCollectionDelete (File->ExtentsMap, MinEntry, (VOID **)&Ext);
-    FreePool (Ext);
+  if (Map->Extents != NULL) {
+    FreePool (Map->Extents);
   }
 
-  ASSERT (OrderedCollectionIsEmpty (File->ExtentsMap));
+  Map->Extents    = NULL;
+  Map->NumExtents = 0;
+  Map->MaxExtents = 0;
+}
 
-  OrderedCollectionUninit (File->ExtentsMap);
-  File->ExtentsMap = NULL;
+/**
+   Grows the extents map so it can fit at least one more extent.
+
+   @param[in]      Map           Pointer to the extents map.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4GrowExtentsMap (
+  IN EXT4_EXTENT_MAP  *Map
+  )
+{
+  UINTN        NewMax;
+  EXT4_EXTENT  *NewExtents;
+
+  NewMax = MAX (Map->MaxExtents * 2, EXT4_EXTENT_MAP_CHUNK);
+
+  NewExtents = ReallocatePool (
+                 Map->MaxExtents * sizeof (EXT4_EXTENT),
+                 NewMax * sizeof (EXT4_EXTENT),
+                 Map->Extents
+                 );
+
+  if (NewExtents == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Map->Extents    = NewExtents;
+  Map->MaxExtents = NewMax;
+
+  return EFI_SUCCESS;
 }
 
 /**
-   Caches a range of extents, by allocating pool memory for each extent and adding it to the tree.
+   Caches a range of extents, by inserting them into the file's sorted extent array.
 
    @param[in]      File        Pointer to the open file.
    @param[in]      Extents     Pointer to an array of extents.
@@ -484,34 +590,49 @@ Ext4CacheExtents (
   IN UINT16             NumberExtents
   )
 {
-  UINT16       Idx;
-  EXT4_EXTENT  *Extent;
-  EFI_STATUS   Status;
+  EXT4_EXTENT_MAP  *Map;
+  UINT16           Idx;
+  UINTN            Pos;
+  UINT64           End;
+
+  Map = File->ExtentsMap;
 
-  /* Note that any out of memory condition might mean we don't get to cache a whole leaf of extents
-   * in which case, future insertions might fail.
+  /* Note that any out of memory condition might mean we don't get to cache a whole leaf of extents.
+   * That's fine, the missing ones will be looked up in the extent tree again.
    */
 
   for (Idx = 0; Idx < NumberExtents; Idx++, Extents++) {
-    Extent = AllocatePool (sizeof (EXT4_EXTENT));
+    End = (UINT64)Extents->ee_block + Ext4GetExtentLength (Extents);
 
-    if (Extent == NULL) {
-      return;
+    if (End == Extents->ee_block) {
+      continue;
     }
 
-    CopyMem (Extent, Extents, sizeof (EXT4_EXTENT));
-    Status = OrderedCollectionInsert (File->ExtentsMap, NULL, Extent);
+    // Leaves are usually cached in order, so this is almost always an append.
+    Pos = Ext4ExtentsMapUpperBound (Map, Extents->ee_block);
 
-    // EFI_ALREADY_STARTED = already exists in the tree.
-    if (EFI_ERROR (Status)) {
-      FreePool (Extent);
+    // Skip extents we already have (or that overlap others, which means corruption).
+    if ((Pos != 0) &&
+        ((UINT64)Map->Extents[Pos - 1].ee_block + Ext4GetExtentLength (&Map->Extents[Pos - 1]) > Extents->ee_block))
+    {
+      continue;
+    }
 
-      if (Status == EFI_ALREADY_STARTED) {
-        continue;
-      }
+    if ((Pos != Map->NumExtents) && (End > Map->Extents[Pos].ee_block)) {
+      continue;
+    }
 
+    if ((Map->NumExtents == Map->MaxExtents) && EFI_ERROR (Ext4GrowExtentsMap (Map))) {
       return;
     }
+
+    CopyMem (
+      &Map->Extents[Pos + 1],
+      &Map->Extents[Pos],
+      (Map->NumExtents - Pos) * sizeof (EXT4_EXTENT)
+      );
+    CopyMem (&Map->Extents[Pos], Extents, sizeof (EXT4_EXTENT));
+    Map->NumExtents++;
   }
 }
 
@@ -529,15 +650,25 @@ Ext4GetExtentFromMap (
   IN UINT32     Block
   )
 {
-  ORDERED_COLLECTION_ENTRY  *Entry;
+  EXT4_EXTENT_MAP  *Map;
+  EXT4_EXTENT      *Extent;
+  UINTN            Pos;
 
-  Entry = OrderedCollectionFind (File->ExtentsMap, (CONST VOID *)(UINTN)Block);
+  Map = File->ExtentsMap;
+  Pos = Ext4ExtentsMapUpperBound (Map, Block);
 
-  if (Entry == NULL) {
+  // The candidate is the last extent that starts at or before Block
+  if (Pos == 0) {
     return NULL;
   }
 
-  return OrderedCollectionUserStruct (Entry);
+  Extent = &Map->Extents[Pos - 1];
+
+  if ((UINT64)Extent->ee_block + Ext4GetExtentLength (Extent) <= Block) {
+    return NULL;
+  }
+
+  return Extent;
 }
 
 /**
@@ -562,7 +693,7 @@ Ext4CalculateExtentChecksum (
 
   Csum = Ext4CalculateChecksum (Partition, &File->InodeNum, sizeof (EXT4_INO_NR), Partition->InitialSeed);
   Csum = Ext4CalculateChecksum (Partition, &Inode->i_generation, sizeof (Inode->i_generation), Csum);
-  Csum = Ext4CalculateChecksum (Partition, ExtHeader, Partition->BlockSize - sizeof (EXT4_EXTENT_TAIL), Csum);
+  Csum = Ext4CalculateChecksum (Partition, ExtHeader, EXT4_EXTENT_TAIL_OFFSET (ExtHeader), Csum);
 
   return Csum;
 }
@@ -589,7 +720,7 @@ Ext4CheckExtentChecksum (
     return TRUE;
   }
 
-  Tail = (EXT4_EXTENT_TAIL *)((CONST CHAR8 *)ExtHeader + (Partition->BlockSize - 4));
+  Tail = (EXT4_EXTENT_TAIL *)((CONST CHAR8 *)ExtHeader + EXT4_EXTENT_TAIL_OFFSET (ExtHeader));
 
   return Tail->eb_checksum == Ext4CalculateExtentChecksum (ExtHeader, File);
 }
@@ -613,3 +744,717 @@ Ext4GetExtentLength (
 
   return Extent->ee_len;
 }
+
+/**
+   Retrieves the physical block an extent starts at.
+
+   @param[in] Extent      Pointer to the EXT4_EXTENT
+
+   @returns Physical block number.
+**/
+STATIC
+EXT4_BLOCK_NR
+Ext4ExtentPhysicalBlock (
+  IN CONST EXT4_EXTENT  *Extent
+  )
+{
+  return LShiftU64 (Extent->ee_start_hi, 32) | Extent->ee_start_lo;
+}
+
+/**
+   Updates the checksum of an extent tree block, after it was modified.
+
+   @param[in out]  Header        Pointer to the block's EXT4_EXTENT_HEADER.
+   @param[in]      File          Pointer to the file.
+**/
+STATIC
+VOID
+Ext4UpdateExtentChecksum (
+  IN OUT EXT4_EXTENT_HEADER  *Header,
+  IN     CONST EXT4_FILE     *File
+  )
+{
+  EXT4_EXTENT_TAIL  *Tail;
+
+  if (!EXT4_HAS_METADATA_CSUM (File->Partition)) {
+    return;
+  }
+
+  Tail              = (EXT4_EXTENT_TAIL *)((CHAR8 *)Header + EXT4_EXTENT_TAIL_OFFSET (Header));
+  Tail->eb_checksum = Ext4CalculateExtentChecksum (Header, File);
+}
+
+// A node of the extent tree on the way down to a leaf
+typedef struct {
+  EXT4_EXTENT_HEADER    *Header;
+  // Block the node is kept in, or 0 for the root, which is kept in the inode
+  EXT4_BLOCK_NR         Block;
+  // Entry followed down to the next level, for index nodes
+  EXT4_EXTENT_INDEX     *Index;
+} EXT4_EXTENT_PATH;
+
+/**
+   Walks the extent tree down to the leaf a logical block belongs in, getting every node
+   on the way ready to be modified by the running transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      LogicalBlock  Logical block.
+   @param[out]     Path          Array of EXT4_EXTENT_TREE_MAX_DEPTH + 1 nodes, from the root
+                                 (Path[0]) down to the leaf (Path[Depth]).
+
+   @return Status of reading the nodes.
+**/
+STATIC
+EFI_STATUS
+Ext4FindExtentPath (
+  IN  EXT4_PARTITION    *Partition,
+  IN  EXT4_FILE         *File,
+  IN  EXT4_BLOCK_NR     LogicalBlock,
+  OUT EXT4_EXTENT_PATH  *Path
+  )
+{
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_BLOCK_NR       Block;
+  UINT16              Depth;
+  UINT16              Level;
+  EFI_STATUS          Status;
+
+  Header = Ext4GetInoExtentHeader (File->Inode);
+
+  if (!Ext4ExtentHeaderValid (Header, EXT4_INODE_EXTENT_ENTRIES)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Depth = Header->eh_depth;
+
+  Path[0].Header = Header;
+  Path[0].Block  = 0;
+  Path[0].Index  = NULL;
+
+  for (Level = 0; Level < Depth; Level++) {
+    Path[Level].Index = Ext4BinsearchExtentIndex (Path[Level].Header, LogicalBlock);
+    Block             = Ext4ExtentIdxLeafBlock (Path[Level].Index);
+
+    Status = Ext4ModifyBlock (Partition, Block, FALSE, (VOID **)&Header);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (!Ext4ExtentHeaderValid (Header, EXT4_BLOCK_EXTENT_ENTRIES (Partition->BlockSize)) ||
+        (Header->eh_depth != Depth - Level - 1) || !Ext4CheckExtentChecksum (Header, File))
+    {
+      DEBUG ((DEBUG_ERROR, "[ext4] Corrupted extent tree block %lu\n", Block));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Path[Level + 1].Header = Header;
+    Path[Level + 1].Block  = Block;
+    Path[Level + 1].Index  = NULL;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Makes the index entries pointing to a node agree with its new first key.
+
+   @param[in]      File          Pointer to the open file.
+   @param[in out]  Path          Path to the node.
+   @param[in]      Level         Level of the node whose first key changed.
+   @param[in]      Key           New first key of the node.
+**/
+STATIC
+VOID
+Ext4FixExtentIndexes (
+  IN     EXT4_FILE         *File,
+  IN OUT EXT4_EXTENT_PATH  *Path,
+  IN     UINT16            Level,
+  IN     UINT32            Key
+  )
+{
+  EXT4_EXTENT_PATH  *Parent;
+
+  for ( ; Level > 0; Level--) {
+    Parent = &Path[Level - 1];
+
+    Parent->Index->ei_block = Key;
+
+    if (Parent->Block != 0) {
+      Ext4UpdateExtentChecksum (Parent->Header, File);
+    }
+
+    // Only the first entry of a node is the key of the node itself
+    if (Parent->Index != EXT4_FIRST_INDEX (Parent->Header)) {
+      break;
+    }
+  }
+}
+
+/**
+   Allocates a new block for the extent tree.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      Goal          Block to allocate the node close to.
+   @param[in]      Depth         Depth of the new node.
+   @param[out]     Block         Block number of the new node.
+   @param[out]     Header        Pointer to the new node, which has no entries.
+
+   @return Status of the allocation.
+**/
+STATIC
+EFI_STATUS
+Ext4NewExtentNode (
+  IN  EXT4_PARTITION      *Partition,
+  IN  EXT4_FILE           *File,
+  IN  EXT4_BLOCK_NR       Goal,
+  IN  UINT16              Depth,
+  OUT EXT4_BLOCK_NR       *Block,
+  OUT EXT4_EXTENT_HEADER  **Header
+  )
+{
+  UINT32      Count;
+  EFI_STATUS  Status;
+
+  Count  = 1;
+  Status = Ext4AllocateBlocks (Partition, Goal, &Count, Block);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4InodeAddBlocks (Partition, File->Inode, 1);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ModifyBlock (Partition, *Block, TRUE, (VOID **)Header);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  (*Header)->eh_magic      = EXT4_EXTENT_HEADER_MAGIC;
+  (*Header)->eh_entries    = 0;
+  (*Header)->eh_max        = (UINT16)EXT4_BLOCK_EXTENT_ENTRIES (Partition->BlockSize);
+  (*Header)->eh_depth      = Depth;
+  (*Header)->eh_generation = 0;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Makes room in the extent tree for a new extent, when the leaf it belongs in is full.
+   The deepest full node that has room in its parent is split in two, or, if every node
+   on the way is full, the tree grows a level. Either way, the caller has to look for the
+   leaf again, since it may still be full.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in out]  Path          Path to the full leaf.
+   @param[in]      Extent        Extent that's being inserted.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4SplitExtentTree (
+  IN     EXT4_PARTITION     *Partition,
+  IN     EXT4_FILE          *File,
+  IN OUT EXT4_EXTENT_PATH   *Path,
+  IN     CONST EXT4_EXTENT  *Extent
+  )
+{
+  EXT4_EXTENT_HEADER  *Root;
+  EXT4_EXTENT_HEADER  *Node;
+  EXT4_EXTENT_HEADER  *NewNode;
+  EXT4_EXTENT_INDEX   *Index;
+  EXT4_EXTENT_PATH    *Parent;
+  EXT4_BLOCK_NR       NewBlock;
+  EXT4_BLOCK_NR       Goal;
+  UINT16              Level;
+  UINT16              Keep;
+  UINT32              NewKey;
+  EFI_STATUS          Status;
+
+  Root  = Path[0].Header;
+  Level = Root->eh_depth;
+  Goal  = Ext4ExtentPhysicalBlock (Extent);
+
+  while ((Level > 0) && (Path[Level - 1].Header->eh_entries == Path[Level - 1].Header->eh_max)) {
+    Level--;
+  }
+
+  if (Level == 0) {
+    // Move the root's entries to a new block, and point the root at it
+    if (Root->eh_depth == EXT4_EXTENT_TREE_MAX_DEPTH) {
+      return EFI_VOLUME_FULL;
+    }
+
+    Status = Ext4NewExtentNode (Partition, File, Goal, Root->eh_depth, &NewBlock, &NewNode);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    CopyMem (NewNode + 1, Root + 1, Root->eh_entries * sizeof (EXT4_EXTENT));
+    NewNode->eh_entries = Root->eh_entries;
+    Ext4UpdateExtentChecksum (NewNode, File);
+
+    // Both extents and indexes start with their key
+    NewKey = (Root->eh_entries != 0) ? EXT4_FIRST_INDEX (Root)->ei_block : 0;
+
+    Root->eh_depth++;
+    Root->eh_entries = 1;
+    Root->eh_max     = EXT4_INODE_EXTENT_ENTRIES;
+
+    Index             = EXT4_FIRST_INDEX (Root);
+    Index->ei_block   = NewKey;
+    Index->ei_leaf_lo = (UINT32)NewBlock;
+    Index->ei_leaf_hi = (UINT16)RShiftU64 (NewBlock, 32);
+    Index->ei_unused  = 0;
+    return EFI_SUCCESS;
+  }
+
+  Node   = Path[Level].Header;
+  Parent = &Path[Level - 1];
+
+  Status = Ext4NewExtentNode (Partition, File, Path[Level].Block, Node->eh_depth, &NewBlock, &NewNode);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Node->eh_depth == 0) &&
+      (Extent->ee_block > EXT4_FIRST_EXTENT (Node)[Node->eh_entries - 1].ee_block))
+  {
+    // Appending to the file: keep the full leaf as it is, and start a new one
+    Keep   = Node->eh_entries;
+    NewKey = Extent->ee_block;
+  } else {
+    Keep = Node->eh_entries / 2;
+    CopyMem (
+      NewNode + 1,
+      EXT4_FIRST_EXTENT (Node) + Keep,
+      (Node->eh_entries - Keep) * sizeof (EXT4_EXTENT)
+      );
+    NewNode->eh_entries = Node->eh_entries - Keep;
+    NewKey              = EXT4_FIRST_INDEX (NewNode)->ei_block;
+  }
+
+  Node->eh_entries = Keep;
+  Ext4UpdateExtentChecksum (Node, File);
+  Ext4UpdateExtentChecksum (NewNode, File);
+
+  Index = Parent->Index + 1;
+  CopyMem (
+    Index + 1,
+    Index,
+    (EXT4_FIRST_INDEX (Parent->Header) + Parent->Header->eh_entries - Index) * sizeof (EXT4_EXTENT_INDEX)
+    );
+
+  Index->ei_block   = NewKey;
+  Index->ei_leaf_lo = (UINT32)NewBlock;
+  Index->ei_leaf_hi = (UINT16)RShiftU64 (NewBlock, 32);
+  Index->ei_unused  = 0;
+  Parent->Header->eh_entries++;
+
+  if (Parent->Block != 0) {
+    Ext4UpdateExtentChecksum (Parent->Header, File);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Checks if two extents can be merged into one.
+
+   @param[in]      Left          Pointer to the first extent.
+   @param[in]      Right         Pointer to the extent that comes right after it.
+
+   @return TRUE if they're contiguous, both logically and physically, and of the same kind.
+**/
+STATIC
+BOOLEAN
+Ext4CanMergeExtents (
+  IN CONST EXT4_EXTENT  *Left,
+  IN CONST EXT4_EXTENT  *Right
+  )
+{
+  EXT4_BLOCK_NR  LeftLength;
+  EXT4_BLOCK_NR  MaxLength;
+
+  if (EXT4_EXTENT_IS_UNINITIALIZED (Left) != EXT4_EXTENT_IS_UNINITIALIZED (Right)) {
+    return FALSE;
+  }
+
+  LeftLength = Ext4GetExtentLength (Left);
+  MaxLength  = EXT4_EXTENT_IS_UNINITIALIZED (Left) ? EXT4_EXTENT_MAX_INITIALIZED - 1 : EXT4_EXTENT_MAX_INITIALIZED;
+
+  return (UINT64)Left->ee_block + LeftLength == Right->ee_block &&
+         Ext4ExtentPhysicalBlock (Left) + LeftLength == Ext4ExtentPhysicalBlock (Right) &&
+         LeftLength + Ext4GetExtentLength (Right) <= MaxLength;
+}
+
+/**
+   Inserts an extent into the file's extent tree, as part of the running transaction.
+   The extent's blocks must not be mapped yet. It's merged with its neighbours when
+   possible, and the tree grows as needed, allocating blocks for it.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition   Pointer to the opened EXT4 partition.
+   @param[in]      File        Pointer to the open file.
+   @param[in]      Extent      Pointer to the extent to insert.
+
+   @retval EFI_SUCCESS           The extent was inserted.
+   @retval EFI_VOLUME_FULL       No blocks could be allocated to grow the tree.
+   @retval EFI_VOLUME_CORRUPTED  The extent tree is corrupted.
+**/
+EFI_STATUS
+Ext4InsertExtent (
+  IN EXT4_PARTITION     *Partition,
+  IN EXT4_FILE          *File,
+  IN CONST EXT4_EXTENT  *Extent
+  )
+{
+  EXT4_EXTENT_PATH    Path[EXT4_EXTENT_TREE_MAX_DEPTH + 1];
+  EXT4_EXTENT_HEADER  *Leaf;
+  EXT4_EXTENT         *First;
+  EXT4_EXTENT         *Prev;
+  EXT4_EXTENT         *Next;
+  EXT4_EXTENT         *Pos;
+  UINT16              Depth;
+  EFI_STATUS          Status;
+
+  if ((File->Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for ( ; ; ) {
+    Status = Ext4FindExtentPath (Partition, File, Extent->ee_block, Path);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Depth = Path[0].Header->eh_depth;
+    Leaf  = Path[Depth].Header;
+    First = EXT4_FIRST_EXTENT (Leaf);
+    Prev  = Ext4BinsearchExtentExt (Leaf, Extent->ee_block);
+
+    if ((Prev != NULL) && (Prev->ee_block > Extent->ee_block)) {
+      Prev = NULL;
+    }
+
+    Next = (Prev != NULL) ? Prev + 1 : First;
+
+    if (Next == First + Leaf->eh_entries) {
+      Next = NULL;
+    }
+
+    if ((Prev != NULL) && Ext4CanMergeExtents (Prev, Extent)) {
+      Prev->ee_len += (UINT16)Ext4GetExtentLength (Extent);
+      break;
+    }
+
+    if ((Next != NULL) && Ext4CanMergeExtents (Extent, Next)) {
+      Next->ee_len     += (UINT16)Ext4GetExtentLength (Extent);
+      Next->ee_block    = Extent->ee_block;
+      Next->ee_start_hi = Extent->ee_start_hi;
+      Next->ee_start_lo = Extent->ee_start_lo;
+
+      if (Next == First) {
+        Ext4FixExtentIndexes (File, Path, Depth, Extent->ee_block);
+      }
+
+      break;
+    }
+
+    if (Leaf->eh_entries < Leaf->eh_max) {
+      Pos = (Next != NULL) ? Next : First + Leaf->eh_entries;
+      CopyMem (Pos + 1, Pos, (First + Leaf->eh_entries - Pos) * sizeof (EXT4_EXTENT));
+      CopyMem (Pos, Extent, sizeof (EXT4_EXTENT));
+      Leaf->eh_entries++;
+
+      if (Pos == First) {
+        Ext4FixExtentIndexes (File, Path, Depth, Extent->ee_block);
+      }
+
+      break;
+    }
+
+    Status = Ext4SplitExtentTree (Partition, File, Path, Extent);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (Path[Depth].Block != 0) {
+    Ext4UpdateExtentChecksum (Leaf, File);
+  }
+
+  Ext4ResetExtentsMap (File);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Marks a range of blocks of a file as initialized, as part of the running transaction.
+   Every block of the range must be mapped by an uninitialized extent, which gets split
+   if the range doesn't cover all of it.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      LogicalBlock  First block of the range.
+   @param[in]      Count         Number of blocks in the range.
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4MarkExtentsInitialized (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock,
+  IN EXT4_BLOCK_NR   Count
+  )
+{
+  EXT4_EXTENT_PATH    Path[EXT4_EXTENT_TREE_MAX_DEPTH + 1];
+  EXT4_EXTENT_HEADER  *Leaf;
+  EXT4_EXTENT         *Ext;
+  EXT4_EXTENT         Piece;
+  EXT4_BLOCK_NR       Start;
+  EXT4_BLOCK_NR       End;
+  EXT4_BLOCK_NR       ExtentEnd;
+  EXT4_BLOCK_NR       Physical;
+  UINT16              Depth;
+  EFI_STATUS          Status;
+
+  while (Count != 0) {
+    Status = Ext4FindExtentPath (Partition, File, LogicalBlock, Path);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Depth = Path[0].Header->eh_depth;
+    Leaf  = Path[Depth].Header;
+    Ext   = Ext4BinsearchExtentExt (Leaf, LogicalBlock);
+
+    if ((Ext == NULL) || !EXT4_EXTENT_IS_UNINITIALIZED (Ext) || (Ext->ee_block > LogicalBlock) ||
+        ((UINT64)Ext->ee_block + Ext4GetExtentLength (Ext) <= LogicalBlock))
+    {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Start     = Ext->ee_block;
+    ExtentEnd = Start + Ext4GetExtentLength (Ext);
+    End       = MIN (LogicalBlock + Count, ExtentEnd);
+    Physical  = Ext4ExtentPhysicalBlock (Ext);
+
+    // The extent keeps its head, and the rest of it gets inserted back as new extents
+    if (LogicalBlock == Start) {
+      Ext->ee_len = (UINT16)(End - Start);
+    } else {
+      Ext->ee_len = (UINT16)(LogicalBlock - Start + EXT4_EXTENT_MAX_INITIALIZED);
+    }
+
+    if (Path[Depth].Block != 0) {
+      Ext4UpdateExtentChecksum (Leaf, File);
+    }
+
+    if (LogicalBlock != Start) {
+      Piece.ee_block    = (UINT32)LogicalBlock;
+      Piece.ee_len      = (UINT16)(End - LogicalBlock);
+      Piece.ee_start_hi = (UINT16)RShiftU64 (Physical + (LogicalBlock - Start), 32);
+      Piece.ee_start_lo = (UINT32)(Physical + (LogicalBlock - Start));
+
+      Status = Ext4InsertExtent (Partition, File, &Piece);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    if (End != ExtentEnd) {
+      Piece.ee_block    = (UINT32)End;
+      Piece.ee_len      = (UINT16)(ExtentEnd - End + EXT4_EXTENT_MAX_INITIALIZED);
+      Piece.ee_start_hi = (UINT16)RShiftU64 (Physical + (End - Start), 32);
+      Piece.ee_start_lo = (UINT32)(Physical + (End - Start));
+
+      Status = Ext4InsertExtent (Partition, File, &Piece);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    Count       -= End - LogicalBlock;
+    LogicalBlock = End;
+  }
+
+  Ext4ResetExtentsMap (File);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees every block a node of the extent tree maps from a logical block onwards,
+   along with the nodes under it that end up empty.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in out]  Header        Pointer to the node.
+   @param[in]      LogicalBlock  First block to free.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4TruncateExtentNode (
+  IN     EXT4_PARTITION      *Partition,
+  IN     EXT4_FILE           *File,
+  IN OUT EXT4_EXTENT_HEADER  *Header,
+  IN     EXT4_BLOCK_NR       LogicalBlock
+  )
+{
+  EXT4_EXTENT         *Ext;
+  EXT4_EXTENT_INDEX   *Index;
+  EXT4_EXTENT_HEADER  *Child;
+  EXT4_BLOCK_NR       ChildBlock;
+  EXT4_BLOCK_NR       Length;
+  EXT4_BLOCK_NR       Keep;
+  EFI_STATUS          Status;
+
+  if (Header->eh_depth == 0) {
+    while (Header->eh_entries != 0) {
+      Ext    = &EXT4_FIRST_EXTENT (Header)[Header->eh_entries - 1];
+      Length = Ext4GetExtentLength (Ext);
+
+      if ((UINT64)Ext->ee_block + Length <= LogicalBlock) {
+        break;
+      }
+
+      Keep = (Ext->ee_block < LogicalBlock) ? LogicalBlock - Ext->ee_block : 0;
+
+      Status = Ext4FreeBlocks (Partition, Ext4ExtentPhysicalBlock (Ext) + Keep, Length - Keep);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Status = Ext4InodeAddBlocks (Partition, File->Inode, -(INT64)(Length - Keep));
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      if (Keep != 0) {
+        Ext->ee_len -= (UINT16)(Length - Keep);
+        break;
+      }
+
+      Header->eh_entries--;
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  while (Header->eh_entries != 0) {
+    Index      = &EXT4_FIRST_INDEX (Header)[Header->eh_entries - 1];
+    ChildBlock = Ext4ExtentIdxLeafBlock (Index);
+
+    Status = Ext4ModifyBlock (Partition, ChildBlock, FALSE, (VOID **)&Child);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (!Ext4ExtentHeaderValid (Child, EXT4_BLOCK_EXTENT_ENTRIES (Partition->BlockSize)) ||
+        (Child->eh_depth != Header->eh_depth - 1) || !Ext4CheckExtentChecksum (Child, File))
+    {
+      DEBUG ((DEBUG_ERROR, "[ext4] Corrupted extent tree block %lu\n", ChildBlock));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Status = Ext4TruncateExtentNode (Partition, File, Child, LogicalBlock);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Child->eh_entries == 0) {
+      // Freeing the block drops the transaction's copy of it, which Child points to
+      Status = Ext4FreeBlocks (Partition, ChildBlock, 1);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Status = Ext4InodeAddBlocks (Partition, File->Inode, -1);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Header->eh_entries--;
+    } else {
+      Ext4UpdateExtentChecksum (Child, File);
+    }
+
+    // Earlier children only map blocks below this one's key
+    if (Index->ei_block <= LogicalBlock) {
+      break;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees every block of a file from a logical block onwards, as part of the running
+   transaction, along with the extent tree blocks that end up empty.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[in]      LogicalBlock  First block to free.
+
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4TruncateExtents (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock
+  )
+{
+  EXT4_EXTENT_HEADER  *Root;
+  EFI_STATUS          Status;
+
+  if ((File->Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Root = Ext4GetInoExtentHeader (File->Inode);
+
+  if (!Ext4ExtentHeaderValid (Root, EXT4_INODE_EXTENT_ENTRIES)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Status = Ext4TruncateExtentNode (Partition, File, Root, LogicalBlock);
+
+  if (!EFI_ERROR (Status) && (Root->eh_entries == 0)) {
+    // Nothing is left, so the root goes back to being an empty leaf
+    Root->eh_depth = 0;
+    Root->eh_max   = EXT4_INODE_EXTENT_ENTRIES;
+  }
+
+  Ext4ResetExtentsMap (File);
+
+  return Status;
+}
@@ -75,10 +75,6 @@ Ext4IsLastPathSegment (
   return Path[0] == '\0';
 }
 
-#define EXT4_INO_PERM_READ_OWNER   0400
-#define EXT4_INO_PERM_WRITE_OWNER  0200
-#define EXT4_INO_PERM_EXEC_OWNER   0100
-
 /**
    Detects if we have permissions to open the file on the desired mode.
 
@@ -180,10 +176,16 @@ Ext4Open (
   UINTN           Length;
   EXT4_FILE       *File;
   EFI_STATUS      Status;
+  BOOLEAN         Created;
 
   Current   = (EXT4_FILE *)This;
   Partition = Current->Partition;
   Level     = 0;
+  Created   = FALSE;
+
+  if ((Attributes & ~EFI_FILE_VALID_ATTR) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
 
   DEBUG ((DEBUG_FS, "[ext4] Ext4Open %s\n", FileName));
   // If the path starts with a backslash, we treat the root directory as the base directory
@@ -228,11 +230,25 @@ Ext4Open (
 
     Status = Ext4OpenFile (Current, PathSegment, Partition, EFI_FILE_MODE_READ, &File);
 
-    if (EFI_ERROR (Status) && Status != EFI_NOT_FOUND) {
-      return Status;
-    } else if (Status == EFI_NOT_FOUND) {
-      // We explicitly ignore the EFI_FILE_MODE_CREATE flag, since we don't have write support
-      /// If/ we add write support, this should be changed.
+    // Only the last segment of the path gets created
+    if ((Status == EFI_NOT_FOUND) && ((OpenMode & EFI_FILE_MODE_CREATE) != 0) && Ext4IsLastPathSegment (FileName)) {
+      if (Partition->ReadOnly) {
+        Status = EFI_WRITE_PROTECTED;
+      } else if ((Current->Inode->i_mode & EXT4_INO_PERM_WRITE_OWNER) == 0) {
+        // Adding an entry to a directory needs write permission on it
+        Status = EFI_ACCESS_DENIED;
+      } else {
+        Status  = Ext4CreateFile (Partition, Current, PathSegment, Attributes, OpenMode, &File);
+        Created = !EFI_ERROR (Status);
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      if (Level != 0) {
+        // Careful not to close the base directory
+        Ext4CloseInternal (Current);
+      }
+
       return Status;
     }
 
@@ -267,7 +283,13 @@ Ext4Open (
     }
   }
 
-  if (!Ext4ApplyPermissions (Current, OpenMode)) {
+  if (((OpenMode & EFI_FILE_MODE_WRITE) != 0) && Partition->ReadOnly) {
+    Ext4CloseInternal (Current);
+    return EFI_WRITE_PROTECTED;
+  }
+
+  // New files are opened in the requested mode, even if they were created read-only
+  if (!Created && !Ext4ApplyPermissions (Current, OpenMode)) {
     Ext4CloseInternal (Current);
     return EFI_ACCESS_DENIED;
   }
@@ -337,9 +359,23 @@ Ext4Delete (
   IN EFI_FILE_PROTOCOL  *This
   )
 {
-  // We do a regular close here since we don't have write support.
+  EXT4_FILE   *File;
+  EFI_STATUS  Status;
+
+  File   = (EXT4_FILE *)This;
+  Status = EFI_WRITE_PROTECTED;
+
+  if (!File->Partition->ReadOnly && ((File->OpenMode & EFI_FILE_MODE_WRITE) != 0)) {
+    Status = Ext4UnlinkFile (File->Partition, File);
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_FS, "[ext4] Could not delete %s: %r\n", File->Dentry->Name, Status));
+  }
+
   Ext4Close (This);
-  return EFI_WARN_DELETE_FAILURE;
+
+  return EFI_ERROR (Status) ? EFI_WARN_DELETE_FAILURE : EFI_SUCCESS;
 }
 
 /**
@@ -422,6 +458,58 @@ Ext4WriteFile (
   IN OUT UINTN          *BufferSize,
   IN VOID               *Buffer
   )
+{
+  EXT4_FILE   *File;
+  EFI_STATUS  Status;
+
+  File = (EXT4_FILE *)This;
+
+  if (!(File->OpenMode & EFI_FILE_MODE_WRITE)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (File->Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (Ext4FileIsDir (File)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  // The write is a single transaction: if it fails, the file's size and blocks are left
+  // as they were, though part of its existing data may have been overwritten.
+  Status = Ext4Write (File->Partition, File, Buffer, File->Position, *BufferSize);
+
+  if (EFI_ERROR (Status)) {
+    *BufferSize = 0;
+    return Status;
+  }
+
+  File->Position += *BufferSize;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]  This             A pointer to the EFI_FILE_PROTOCOL instance that is the file
+                               handle to flush.
+
+  @retval EFI_SUCCESS          The data was flushed.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED    The file was opened read-only.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4Flush (
+  IN EFI_FILE_PROTOCOL  *This
+  )
 {
   EXT4_FILE  *File;
 
@@ -431,7 +519,189 @@ Ext4WriteFile (
     return EFI_ACCESS_DENIED;
   }
 
-  return EFI_WRITE_PROTECTED;
+  if (File->Partition->ReadOnly) {
+    return EFI_SUCCESS;
+  }
+
+  // Every transaction is committed before the call that made it returns, so all that's
+  // left is flushing the device's own caches.
+  return File->Partition->BlockIo->FlushBlocks (File->Partition->BlockIo);
+}
+
+/**
+  Signals the completion of an Ex request that was done synchronously.
+
+  @param[in out]  Token        Pointer to the caller's token.
+  @param[in]      Status       Status of the request.
+
+  @return Status.
+**/
+STATIC
+EFI_STATUS
+Ext4CompleteToken (
+  IN OUT EFI_FILE_IO_TOKEN  *Token,
+  IN     EFI_STATUS         Status
+  )
+{
+  // Requests that fail synchronously aren't signalled, as per the UEFI spec.
+  if (!EFI_ERROR (Status) && (Token->Event != NULL)) {
+    Token->Status = Status;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+/**
+  Opens a new file relative to the source directory's location.
+
+  @param[in]      This        A pointer to the EFI_FILE_PROTOCOL instance that is the file
+                              handle to the source location.
+  @param[out]     NewHandle   A pointer to the location to return the opened handle for the new
+                              file.
+  @param[in]      FileName    The Null-terminated string of the name of the file to be opened.
+                              The file name may contain the following path modifiers: "\", ".",
+                              and "..".
+  @param[in]      OpenMode    The mode to open the file. The only valid combinations that the
+                              file may be opened with are: Read, Read/Write, or Create/Read/Write.
+  @param[in]      Attributes  Only valid for EFI_FILE_MODE_CREATE, in which case these are the
+                              attribute bits for the newly created file.
+  @param[in out]  Token       A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          If Event is NULL (blocking I/O): The file was opened.
+                               If Event is not NULL (asynchronous I/O): The request was
+                               successfully queued for processing.
+  @retval EFI_NOT_FOUND        The specified file could not be found on the device.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_MEDIA_CHANGED    The device has a different medium in it or the medium is no
+                               longer supported.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  An attempt was made to create a file, or open a file for write
+                               when the media is write-protected.
+  @retval EFI_ACCESS_DENIED    The service denied access to the file.
+  @retval EFI_OUT_OF_RESOURCES Not enough resources were available to open the file.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4OpenEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  OUT EFI_FILE_PROTOCOL     **NewHandle,
+  IN CHAR16                 *FileName,
+  IN UINT64                 OpenMode,
+  IN UINT64                 Attributes,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  // Opens only touch metadata, which is (mostly) cached, so they're done synchronously.
+  return Ext4CompleteToken (Token, Ext4Open (This, NewHandle, FileName, OpenMode, Attributes));
+}
+
+/**
+  Reads data from a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to read data from.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was read successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_DEVICE_ERROR      An attempt was made to read from a deleted file.
+  @retval EFI_DEVICE_ERROR      On entry, the current file position is beyond the end of the file.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4ReadEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EXT4_FILE       *File;
+  EXT4_PARTITION  *Partition;
+  EFI_STATUS      Status;
+  UINTN           Length;
+
+  File      = (EXT4_FILE *)This;
+  Partition = File->Partition;
+
+  // Only regular file data goes through the asynchronous path. Directory reads
+  // are small and need to be parsed, and without DISK_IO2 we can't do better anyway.
+  if ((Token->Event == NULL) || (EXT4_DISK_IO2 (Partition) == NULL) || !Ext4FileIsReg (File)) {
+    return Ext4CompleteToken (Token, Ext4ReadFile (This, &Token->BufferSize, Token->Buffer));
+  }
+
+  Length = Token->BufferSize;
+
+  Status = Ext4ReadAsync (Partition, File, Token->Buffer, File->Position, &Length, Token);
+
+  if (Status == EFI_SUCCESS) {
+    // Advance the position right away, so that the caller can queue up consecutive reads
+    File->Position += Length;
+  }
+
+  return Status;
+}
+
+/**
+  Writes data to a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to write data to.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was written successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_UNSUPPORTED       Writes to open directory files are not supported.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_DEVICE_ERROR      An attempt was made to write to a deleted file.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED   The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED     The file was opened read only.
+  @retval EFI_VOLUME_FULL       The volume is full.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4WriteEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return Ext4CompleteToken (Token, Ext4WriteFile (This, &Token->BufferSize, Token->Buffer));
+}
+
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is the file handle to flush.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS           If Event is NULL (blocking I/O): The data was flushed successfully.
+                                If Event is not NULL (asynchronous I/O): The request was successfully
+                                queued for processing.
+  @retval EFI_NO_MEDIA          The device has no medium.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED  The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED   The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED     The file was opened read-only.
+  @retval EFI_VOLUME_FULL       The volume is full.
+  @retval EFI_OUT_OF_RESOURCES  Unable to queue the request due to lack of resources.
+**/
+EFI_STATUS
+EFIAPI
+Ext4FlushEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return Ext4CompleteToken (Token, Ext4Flush (This));
 }
 
 /**
@@ -547,7 +817,7 @@ Ext4GetFileInfo (
   Info->PhysicalSize = Ext4FilePhysicalSpace (File);
   Ext4FileATime (File, &Info->LastAccessTime);
   Ext4FileMTime (File, &Info->ModificationTime);
-  Ext4FileCreateTime (File, &Info->LastAccessTime);
+  Ext4FileCreateTime (File, &Info->CreateTime);
   Info->Attribute = 0;
   Info->Size = NeededLength;
 
@@ -555,6 +825,12 @@ Ext4GetFileInfo (
     Info->Attribute |= EFI_FILE_DIRECTORY;
   }
 
+  // EFI_FILE_READ_ONLY maps to the owner's write permission, which is what
+  // Ext4ApplyPermissions checks
+  if ((File->Inode->i_mode & EXT4_INO_PERM_WRITE_OWNER) == 0) {
+    Info->Attribute |= EFI_FILE_READ_ONLY;
+  }
+
   *BufferSize = NeededLength;
 
   return StrCpyS (Info->FileName, FileNameLen + 1, FileName);
@@ -825,6 +1101,210 @@ Ext4DuplicateFile (
   return File;
 }
 
+/**
+   Checks if an EFI_TIME is zeroed, which means "don't change this time" in an EFI_FILE_INFO.
+
+   @param[in]      Time           Pointer to the time.
+
+   @return TRUE if the time is zeroed.
+**/
+STATIC
+BOOLEAN
+Ext4TimeIsZero (
+  IN CONST EFI_TIME  *Time
+  )
+{
+  return IsZeroBuffer (Time, sizeof (EFI_TIME));
+}
+
+/**
+   Changes a file's name, size, times and attributes, as described by an EFI_FILE_INFO.
+
+   @param[in]      File           Pointer to an opened file.
+   @param[in]      Info           Pointer to the new EFI_FILE_INFO.
+   @param[in]      BufferSize     Size of the buffer Info is in.
+
+   @return Status of the operation. See Ext4SetInfo.
+**/
+STATIC
+EFI_STATUS
+Ext4SetFileInfo (
+  IN EXT4_FILE            *File,
+  IN CONST EFI_FILE_INFO  *Info,
+  IN UINTN                BufferSize
+  )
+{
+  EFI_STATUS      Status;
+  EXT4_PARTITION  *Partition;
+  CONST CHAR16    *FileName;
+  EFI_TIME        Time;
+  BOOLEAN         IsDir;
+  BOOLEAN         NameChanged;
+  BOOLEAN         SizeChanged;
+  BOOLEAN         TimesChanged;
+  UINT16          Mode;
+
+  Partition = File->Partition;
+  IsDir     = Ext4FileIsDir (File);
+
+  if ((BufferSize < SIZE_OF_EFI_FILE_INFO) || (Info->Size < SIZE_OF_EFI_FILE_INFO) || (Info->Size > BufferSize)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  // The name needs to be null-terminated within the structure
+  if (StrnLenS (Info->FileName, (UINTN)(Info->Size - SIZE_OF_EFI_FILE_INFO) / sizeof (CHAR16)) ==
+      (UINTN)(Info->Size - SIZE_OF_EFI_FILE_INFO) / sizeof (CHAR16))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Info->Attribute & ~EFI_FILE_VALID_ATTR) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (((Info->Attribute & EFI_FILE_DIRECTORY) != 0) != IsDir) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (IsDir && (Info->FileSize != EXT4_INODE_SIZE (File->Inode))) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  // Like Ext4GetFileInfo, the root directory is nameless
+  FileName    = File->InodeNum == EXT4_ROOT_INODE_NR ? L"" : File->Dentry->Name;
+  NameChanged = StrCmp (Info->FileName, FileName) != 0;
+  SizeChanged = Info->FileSize != EXT4_INODE_SIZE (File->Inode);
+
+  // Times that are zeroed are left alone, and the others only count as changes if they differ
+  TimesChanged = FALSE;
+
+  Ext4FileCreateTime (File, &Time);
+  TimesChanged |= !Ext4TimeIsZero (&Info->CreateTime) && (CompareMem (&Info->CreateTime, &Time, sizeof (Time)) != 0);
+  Ext4FileATime (File, &Time);
+  TimesChanged |= !Ext4TimeIsZero (&Info->LastAccessTime) && (CompareMem (&Info->LastAccessTime, &Time, sizeof (Time)) != 0);
+  Ext4FileMTime (File, &Time);
+  TimesChanged |= !Ext4TimeIsZero (&Info->ModificationTime) && (CompareMem (&Info->ModificationTime, &Time, sizeof (Time)) != 0);
+
+  // Files opened read-only can only have their attributes changed
+  if (((File->OpenMode & EFI_FILE_MODE_WRITE) == 0) && (NameChanged || SizeChanged || TimesChanged)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (NameChanged) {
+    Status = Ext4RenameFile (Partition, File, Info->FileName);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Mode = File->Inode->i_mode;
+
+  if ((Info->Attribute & EFI_FILE_READ_ONLY) != 0) {
+    Mode &= (UINT16) ~EXT4_INO_PERM_WRITE_ALL;
+  } else if ((Mode & EXT4_INO_PERM_WRITE_OWNER) == 0) {
+    Mode |= EXT4_INO_PERM_WRITE_OWNER;
+  }
+
+  if (!SizeChanged && !TimesChanged && (Mode == File->Inode->i_mode)) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (SizeChanged) {
+    Status = Ext4SetFileSize (Partition, File, Info->FileSize);
+  }
+
+  if (!EFI_ERROR (Status) && !Ext4TimeIsZero (&Info->CreateTime)) {
+    Status = Ext4SetInodeTimes (File->Inode, &Info->CreateTime, EXT4_INODE_CRTIME);
+  }
+
+  if (!EFI_ERROR (Status) && !Ext4TimeIsZero (&Info->LastAccessTime)) {
+    Status = Ext4SetInodeTimes (File->Inode, &Info->LastAccessTime, EXT4_INODE_ATIME);
+  }
+
+  if (!EFI_ERROR (Status) && !Ext4TimeIsZero (&Info->ModificationTime)) {
+    Status = Ext4SetInodeTimes (File->Inode, &Info->ModificationTime, EXT4_INODE_MTIME);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    File->Inode->i_mode = Mode;
+
+    // If the current time can't be read, the change time is left alone
+    Ext4SetInodeTimes (File->Inode, NULL, EXT4_INODE_CTIME);
+
+    Status = Ext4WriteInode (Partition, File->InodeNum, File->Inode);
+  }
+
+  return Ext4EndTransaction (Partition, Status);
+}
+
+/**
+   Changes the volume label.
+
+   @param[in]      Partition      Pointer to the opened partition.
+   @param[in]      Label          Pointer to the new label.
+   @param[in]      LabelSize      Size of the buffer Label is in, in bytes.
+
+   @retval EFI_SUCCESS            The label was changed.
+   @retval EFI_INVALID_PARAMETER  The label isn't null-terminated, or doesn't fit in the superblock.
+   @retval EFI_UNSUPPORTED        The filesystem doesn't have a label.
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4SetVolumeLabel (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST CHAR16    *Label,
+  IN UINTN           LabelSize
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       *Utf8Label;
+  UINTN       Length;
+
+  if (StrnLenS (Label, LabelSize / sizeof (CHAR16)) == LabelSize / sizeof (CHAR16)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  // See Ext4GetVolumeName
+  if (Partition->SuperBlock.s_rev_level != EXT4_DYNAMIC_REV) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = UCS2StrToUTF8 ((CHAR16 *)Label, &Utf8Label);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Length = AsciiStrLen (Utf8Label);
+
+  if (Length > sizeof (Partition->SuperBlock.s_volume_name)) {
+    FreePool (Utf8Label);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (!EFI_ERROR (Status)) {
+    ZeroMem (Partition->SuperBlock.s_volume_name, sizeof (Partition->SuperBlock.s_volume_name));
+    CopyMem (Partition->SuperBlock.s_volume_name, Utf8Label, Length);
+    Ext4DirtySuperblock (Partition);
+
+    Status = Ext4EndTransaction (Partition, EFI_SUCCESS);
+  }
+
+  FreePool (Utf8Label);
+
+  return Status;
+}
+
 /**
   Sets information about a file.
 
@@ -878,6 +1358,25 @@ Ext4SetInfo (
     return EFI_WRITE_PROTECTED;
   }
 
-  // There's no write support just yet.
+  if (CompareGuid (InformationType, &gEfiFileInfoGuid)) {
+    return Ext4SetFileInfo (File, Buffer, BufferSize);
+  }
+
+  if (CompareGuid (InformationType, &gEfiFileSystemInfoGuid)) {
+    if (BufferSize < SIZE_OF_EFI_FILE_SYSTEM_INFO) {
+      return EFI_BAD_BUFFER_SIZE;
+    }
+
+    return Ext4SetVolumeLabel (
+             Part,
+             ((EFI_FILE_SYSTEM_INFO *)Buffer)->VolumeLabel,
+             BufferSize - SIZE_OF_EFI_FILE_SYSTEM_INFO
+             );
+  }
+
+  if (CompareGuid (InformationType, &gEfiFileSystemVolumeLabelInfoIdGuid)) {
+    return Ext4SetVolumeLabel (Part, ((EFI_FILE_SYSTEM_VOLUME_LABEL *)Buffer)->VolumeLabel, BufferSize);
+  }
+
   return EFI_UNSUPPORTED;
 }
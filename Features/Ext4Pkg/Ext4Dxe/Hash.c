@@ -0,0 +1,305 @@
+/** @file
+  Directory hashing routines, used for hash tree (htree) directory lookups
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The hash functions below need to be bit-for-bit compatible with the ones used
+  by Linux (fs/ext4/hash.c), since the hashes are stored on disk.
+**/
+
+#include "Ext4Dxe.h"
+
+#define EXT4_TEA_DELTA  0x9E3779B9U
+
+/**
+   TEA (Tiny Encryption Algorithm) transform, as used by the ext4 TEA hash.
+
+   @param[in out]  Buf     Pointer to the 4-word hash state.
+   @param[in]      In      Pointer to 4 words of input.
+**/
+STATIC
+VOID
+Ext4TeaTransform (
+  IN OUT UINT32     Buf[4],
+  IN CONST UINT32  In[4]
+  )
+{
+  UINT32  Sum;
+  UINT32  B0;
+  UINT32  B1;
+  UINTN   Round;
+
+  Sum = 0;
+  B0  = Buf[0];
+  B1  = Buf[1];
+
+  for (Round = 0; Round < 16; Round++) {
+    Sum += EXT4_TEA_DELTA;
+    B0  += ((B1 << 4) + In[0]) ^ (B1 + Sum) ^ ((B1 >> 5) + In[1]);
+    B1  += ((B0 << 4) + In[2]) ^ (B0 + Sum) ^ ((B0 >> 5) + In[3]);
+  }
+
+  Buf[0] += B0;
+  Buf[1] += B1;
+}
+
+#define HALF_MD4_F(x, y, z)  ((z) ^ ((x) & ((y) ^ (z))))
+#define HALF_MD4_G(x, y, z)  (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define HALF_MD4_H(x, y, z)  ((x) ^ (y) ^ (z))
+
+#define HALF_MD4_ROUND(f, a, b, c, d, x, s) \
+  do {                                      \
+    (a) += f ((b), (c), (d)) + (x);         \
+    (a)  = LRotU32 ((a), (s));              \
+  } while (FALSE)
+
+#define HALF_MD4_K1  0U
+#define HALF_MD4_K2  013240474631U
+#define HALF_MD4_K3  015666365641U
+
+/**
+   Reduced MD4 transform, as used by the ext4 half-MD4 hash.
+
+   @param[in out]  Buf     Pointer to the 4-word hash state.
+   @param[in]      In      Pointer to 8 words of input.
+**/
+STATIC
+VOID
+Ext4HalfMd4Transform (
+  IN OUT UINT32     Buf[4],
+  IN CONST UINT32  In[8]
+  )
+{
+  UINT32  A;
+  UINT32  B;
+  UINT32  C;
+  UINT32  D;
+
+  A = Buf[0];
+  B = Buf[1];
+  C = Buf[2];
+  D = Buf[3];
+
+  // Round 1
+  HALF_MD4_ROUND (HALF_MD4_F, A, B, C, D, In[0] + HALF_MD4_K1, 3);
+  HALF_MD4_ROUND (HALF_MD4_F, D, A, B, C, In[1] + HALF_MD4_K1, 7);
+  HALF_MD4_ROUND (HALF_MD4_F, C, D, A, B, In[2] + HALF_MD4_K1, 11);
+  HALF_MD4_ROUND (HALF_MD4_F, B, C, D, A, In[3] + HALF_MD4_K1, 19);
+  HALF_MD4_ROUND (HALF_MD4_F, A, B, C, D, In[4] + HALF_MD4_K1, 3);
+  HALF_MD4_ROUND (HALF_MD4_F, D, A, B, C, In[5] + HALF_MD4_K1, 7);
+  HALF_MD4_ROUND (HALF_MD4_F, C, D, A, B, In[6] + HALF_MD4_K1, 11);
+  HALF_MD4_ROUND (HALF_MD4_F, B, C, D, A, In[7] + HALF_MD4_K1, 19);
+
+  // Round 2
+  HALF_MD4_ROUND (HALF_MD4_G, A, B, C, D, In[1] + HALF_MD4_K2, 3);
+  HALF_MD4_ROUND (HALF_MD4_G, D, A, B, C, In[3] + HALF_MD4_K2, 5);
+  HALF_MD4_ROUND (HALF_MD4_G, C, D, A, B, In[5] + HALF_MD4_K2, 9);
+  HALF_MD4_ROUND (HALF_MD4_G, B, C, D, A, In[7] + HALF_MD4_K2, 13);
+  HALF_MD4_ROUND (HALF_MD4_G, A, B, C, D, In[0] + HALF_MD4_K2, 3);
+  HALF_MD4_ROUND (HALF_MD4_G, D, A, B, C, In[2] + HALF_MD4_K2, 5);
+  HALF_MD4_ROUND (HALF_MD4_G, C, D, A, B, In[4] + HALF_MD4_K2, 9);
+  HALF_MD4_ROUND (HALF_MD4_G, B, C, D, A, In[6] + HALF_MD4_K2, 13);
+
+  // Round 3
+  HALF_MD4_ROUND (HALF_MD4_H, A, B, C, D, In[3] + HALF_MD4_K3, 3);
+  HALF_MD4_ROUND (HALF_MD4_H, D, A, B, C, In[7] + HALF_MD4_K3, 9);
+  HALF_MD4_ROUND (HALF_MD4_H, C, D, A, B, In[2] + HALF_MD4_K3, 11);
+  HALF_MD4_ROUND (HALF_MD4_H, B, C, D, A, In[6] + HALF_MD4_K3, 15);
+  HALF_MD4_ROUND (HALF_MD4_H, A, B, C, D, In[1] + HALF_MD4_K3, 3);
+  HALF_MD4_ROUND (HALF_MD4_H, D, A, B, C, In[5] + HALF_MD4_K3, 9);
+  HALF_MD4_ROUND (HALF_MD4_H, C, D, A, B, In[0] + HALF_MD4_K3, 11);
+  HALF_MD4_ROUND (HALF_MD4_H, B, C, D, A, In[4] + HALF_MD4_K3, 15);
+
+  Buf[0] += A;
+  Buf[1] += B;
+  Buf[2] += C;
+  Buf[3] += D;
+}
+
+/**
+   Legacy ("dx_hack") directory hash.
+
+   @param[in]      Name        Pointer to the name.
+   @param[in]      Length      Length of the name, in bytes.
+   @param[in]      Unsigned    TRUE if the name's bytes are to be treated as unsigned.
+
+   @return The hash.
+**/
+STATIC
+UINT32
+Ext4LegacyHash (
+  IN CONST CHAR8  *Name,
+  IN UINTN        Length,
+  IN BOOLEAN      Unsigned
+  )
+{
+  UINT32  Hash;
+  UINT32  Hash0;
+  UINT32  Hash1;
+  INT32   Char;
+
+  Hash0 = 0x12a3fe2d;
+  Hash1 = 0x37abe8f9;
+
+  while (Length-- != 0) {
+    Char = Unsigned ? (INT32)*(CONST UINT8 *)Name : (INT32)*(CONST INT8 *)Name;
+    Name++;
+
+    Hash = Hash1 + (Hash0 ^ (UINT32)(Char * 7152373));
+
+    if ((Hash & 0x80000000) != 0) {
+      Hash -= 0x7fffffff;
+    }
+
+    Hash1 = Hash0;
+    Hash0 = Hash;
+  }
+
+  return Hash0 << 1;
+}
+
+/**
+   Packs (part of) a name into the input words of the TEA and half-MD4 transforms.
+
+   @param[in]      Name        Pointer to the name.
+   @param[in]      Length      Remaining length of the name, in bytes.
+   @param[out]     Buf         Pointer to the destination words.
+   @param[in]      NumWords    Number of words to fill.
+   @param[in]      Unsigned    TRUE if the name's bytes are to be treated as unsigned.
+**/
+STATIC
+VOID
+Ext4StrToHashBuf (
+  IN CONST CHAR8  *Name,
+  IN UINTN        Length,
+  OUT UINT32      *Buf,
+  IN UINTN        NumWords,
+  IN BOOLEAN      Unsigned
+  )
+{
+  UINT32  Pad;
+  UINT32  Val;
+  UINTN   Index;
+  INT32   Char;
+
+  Pad  = (UINT32)Length | ((UINT32)Length << 8);
+  Pad |= Pad << 16;
+
+  Val = Pad;
+
+  if (Length > NumWords * 4) {
+    Length = NumWords * 4;
+  }
+
+  for (Index = 0; Index < Length; Index++) {
+    Char = Unsigned ? (INT32)((CONST UINT8 *)Name)[Index] : (INT32)((CONST INT8 *)Name)[Index];
+    Val  = (UINT32)Char + (Val << 8);
+
+    if ((Index % 4) == 3) {
+      *Buf++ = Val;
+      Val    = Pad;
+      NumWords--;
+    }
+  }
+
+  if (NumWords != 0) {
+    *Buf++ = Val;
+    NumWords--;
+  }
+
+  while (NumWords-- != 0) {
+    *Buf++ = Pad;
+  }
+}
+
+/**
+   Calculates the directory hash of a name, as stored in an htree directory index.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      HashVersion   Hash algorithm (EXT4_DX_HASH_*), with the signedness already resolved.
+   @param[in]      Name          Pointer to the UTF-8 name.
+   @param[in]      Length        Length of the name, in bytes.
+   @param[out]     Hash          Pointer to the resulting (major) hash.
+
+   @retval EFI_SUCCESS        The hash was calculated.
+   @retval EFI_UNSUPPORTED    The hash algorithm is not supported.
+**/
+EFI_STATUS
+Ext4DirHash (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT8                 HashVersion,
+  IN CONST CHAR8           *Name,
+  IN UINTN                 Length,
+  OUT UINT32               *Hash
+  )
+{
+  UINT32       Buf[4];
+  UINT32       In[8];
+  UINT32       Result;
+  UINTN        Index;
+  BOOLEAN      Unsigned;
+  CONST CHAR8  *Ptr;
+  INTN         Remaining;
+
+  // Default seed, used when s_hash_seed is all zeroes
+  Buf[0] = 0x67452301;
+  Buf[1] = 0xefcdab89;
+  Buf[2] = 0x98badcfe;
+  Buf[3] = 0x10325476;
+
+  for (Index = 0; Index < ARRAY_SIZE (Partition->SuperBlock.s_hash_seed); Index++) {
+    if (Partition->SuperBlock.s_hash_seed[Index] != 0) {
+      CopyMem (Buf, Partition->SuperBlock.s_hash_seed, sizeof (Buf));
+      break;
+    }
+  }
+
+  Ptr       = Name;
+  Remaining = (INTN)Length;
+
+  switch (HashVersion) {
+    case EXT4_DX_HASH_LEGACY:
+    case EXT4_DX_HASH_LEGACY_UNSIGNED:
+      Result = Ext4LegacyHash (Name, Length, HashVersion == EXT4_DX_HASH_LEGACY_UNSIGNED);
+      break;
+    case EXT4_DX_HASH_HALF_MD4:
+    case EXT4_DX_HASH_HALF_MD4_UNSIGNED:
+      Unsigned = HashVersion == EXT4_DX_HASH_HALF_MD4_UNSIGNED;
+      while (Remaining > 0) {
+        Ext4StrToHashBuf (Ptr, (UINTN)Remaining, In, 8, Unsigned);
+        Ext4HalfMd4Transform (Buf, In);
+        Remaining -= 32;
+        Ptr       += 32;
+      }
+
+      Result = Buf[1];
+      break;
+    case EXT4_DX_HASH_TEA:
+    case EXT4_DX_HASH_TEA_UNSIGNED:
+      Unsigned = HashVersion == EXT4_DX_HASH_TEA_UNSIGNED;
+      while (Remaining > 0) {
+        Ext4StrToHashBuf (Ptr, (UINTN)Remaining, In, 4, Unsigned);
+        Ext4TeaTransform (Buf, In);
+        Remaining -= 16;
+        Ptr       += 16;
+      }
+
+      Result = Buf[0];
+      break;
+    default:
+      // SipHash is only used for casefolded + encrypted directories, which we don't support.
+      return EFI_UNSUPPORTED;
+  }
+
+  // The lowest bit is reserved to mark hash collisions in the index
+  Result &= ~1U;
+
+  // 0x7fffffff << 1 is reserved as an EOF marker for 32-bit readdir cookies
+  if (Result == (0x7fffffffU << 1)) {
+    Result = (0x7fffffffU - 1) << 1;
+  }
+
+  *Hash = Result;
+  return EFI_SUCCESS;
+}
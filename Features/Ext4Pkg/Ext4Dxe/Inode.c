@@ -4,7 +4,7 @@
   Copyright (c) 2021 Pedro Falcato All rights reserved.
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
-  EpochToEfiTime copied from EmbeddedPkg/Library/TimeBaseLib.c
+  EpochToEfiTime and EfiTimeToEpoch copied from EmbeddedPkg/Library/TimeBaseLib.c
   Copyright (c) 2016, Hisilicon Limited. All rights reserved.
   Copyright (c) 2016-2019, Linaro Limited. All rights reserved.
   Copyright (c) 2021, Ampere Computing LLC. All rights reserved.
@@ -69,6 +69,130 @@ Ext4CalculateInodeChecksum (
   return Crc;
 }
 
+// A run of file data that is either a single contiguous range of the disk, or a hole
+typedef struct {
+  // Offset of the data on the disk, in bytes. Only valid if !IsHole.
+  UINT64     DiskOffset;
+  // Length of the run, in bytes
+  UINT64     Length;
+  // Holes (and uninitialized extents) read back as zeroes, and have no disk blocks
+  BOOLEAN    IsHole;
+  // Uninitialized extents are holes that do have disk blocks, at DiskOffset
+  BOOLEAN    IsUnwritten;
+} EXT4_DATA_RUN;
+
+/**
+   Maps a file offset to the extent (or hole) it falls in.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset into the file, in bytes.
+   @param[out]     Run           Pointer to the run that starts at Offset and ends
+                                 at the end of its extent or hole.
+
+   @return Status of the extent lookup.
+**/
+STATIC
+EFI_STATUS
+Ext4MapFileOffset (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  OUT EXT4_DATA_RUN   *Run
+  )
+{
+  EXT4_EXTENT    Extent;
+  EXT4_BLOCK_NR  HoleLength;
+  UINT32         BlockOff;
+  UINT64         ExtentOffset;
+  EFI_STATUS     Status;
+
+  Status = Ext4GetExtent (
+             Partition,
+             File,
+             DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOff),
+             &Extent,
+             &HoleLength
+             );
+
+  if (Status == EFI_NO_MAPPING) {
+    Run->IsHole      = TRUE;
+    Run->IsUnwritten = FALSE;
+    Run->DiskOffset  = 0;
+    Run->Length      = MultU64x32 (HoleLength, Partition->BlockSize) - BlockOff;
+    return EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ExtentOffset = Offset - MultU64x32 (Extent.ee_block, Partition->BlockSize);
+
+  // Uninitialized extents read exactly the same as file holes.
+  Run->IsHole      = EXT4_EXTENT_IS_UNINITIALIZED (&Extent);
+  Run->IsUnwritten = Run->IsHole;
+  Run->DiskOffset  = MultU64x32 (
+                       LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo,
+                       Partition->BlockSize
+                       ) + ExtentOffset;
+  Run->Length = MultU64x32 (Ext4GetExtentLength (&Extent), Partition->BlockSize) - ExtentOffset;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Plans the next run of a read or write. Starting at Offset, it gathers the following
+   extents for as long as they're physically contiguous on the disk (or, for holes, for
+   as long as they're holes), so that the whole run can be transferred in one go.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset into the file, in bytes.
+   @param[in]      MaxLength     Maximum length of the run, in bytes.
+   @param[out]     Run           Pointer to the planned run.
+
+   @return Status of the extent lookups.
+**/
+STATIC
+EFI_STATUS
+Ext4PlanDataRun (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  IN  UINTN           MaxLength,
+  OUT EXT4_DATA_RUN   *Run
+  )
+{
+  EXT4_DATA_RUN  Next;
+  EFI_STATUS     Status;
+
+  Status = Ext4MapFileOffset (Partition, File, Offset, Run);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (Run->Length < MaxLength) {
+    // If this lookup fails, we leave it to the next run to report the error.
+    Status = Ext4MapFileOffset (Partition, File, Offset + Run->Length, &Next);
+
+    if (EFI_ERROR (Status) || (Next.IsHole != Run->IsHole) || (Next.IsUnwritten != Run->IsUnwritten)) {
+      break;
+    }
+
+    if ((!Run->IsHole || Run->IsUnwritten) && (Next.DiskOffset != Run->DiskOffset + Run->Length)) {
+      break;
+    }
+
+    Run->Length += Next.Length;
+  }
+
+  Run->Length = MIN (Run->Length, MaxLength);
+
+  return EFI_SUCCESS;
+}
+
 /**
    Reads from an EXT4 inode.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -89,25 +213,14 @@ Ext4Read (
   IN OUT UINTN           *Length
   )
 {
-  EXT4_INODE   *Inode;
-  UINT64       InodeSize;
-  UINT64       CurrentSeek;
-  UINTN        RemainingRead;
-  UINTN        BeenRead;
-  UINTN        WasRead;
-  EXT4_EXTENT  Extent;
-  UINT32       BlockOff;
-  EFI_STATUS   Status;
-  BOOLEAN      HasBackingExtent;
-  UINT32       HoleOff;
-  UINTN        HoleLen;
-  UINT64       ExtentStartBytes;
-  UINT64       ExtentLengthBytes;
-  UINT64       ExtentLogicalBytes;
-
-  // Our extent offset is the difference between CurrentSeek and ExtentLogicalBytes
-  UINT64  ExtentOffset;
-  UINTN   ExtentMayRead;
+  EXT4_INODE     *Inode;
+  UINT64         InodeSize;
+  UINT64         CurrentSeek;
+  UINTN          RemainingRead;
+  UINTN          BeenRead;
+  UINTN          WasRead;
+  EXT4_DATA_RUN  Run;
+  EFI_STATUS     Status;
 
   Inode         = File->Inode;
   InodeSize     = EXT4_INODE_SIZE (Inode);
@@ -126,73 +239,755 @@ Ext4Read (
   }
 
   while (RemainingRead != 0) {
-    WasRead = 0;
+    // Plan the biggest run we can do in one go (contiguous extents are merged together,
+    // and so are holes), and then read or zero it.
+    Status = Ext4PlanDataRun (Partition, File, CurrentSeek, RemainingRead, &Run);
 
-    // The algorithm here is to get the extent corresponding to the current block
-    // and then read as much as we can from the current extent.
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
-    Status = Ext4GetExtent (
-               Partition,
-               File,
-               DivU64x32Remainder (CurrentSeek, Partition->BlockSize, &BlockOff),
-               &Extent
-               );
+    WasRead = (UINTN)Run.Length;
 
-    if (Status != EFI_SUCCESS && Status != EFI_NO_MAPPING) {
+    if (Run.IsHole) {
+      SetMem (Buffer, WasRead, 0);
+    } else if (Ext4FileIsDir (File)) {
+      // Directory blocks get looked at over and over, so they go through the block cache
+      Status = Ext4ReadDiskIoCached (Partition, Buffer, WasRead, Run.DiskOffset);
+    } else {
+      // File data is usually read just once; keep it from evicting metadata from the cache.
+      Status = Ext4ReadDiskIo (Partition, Buffer, WasRead, Run.DiskOffset);
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "[ext4] Error %x reading [%lu, %lu]\n",
+        Status,
+        Run.DiskOffset,
+        Run.DiskOffset + WasRead - 1
+        ));
       return Status;
     }
 
-    HasBackingExtent = Status != EFI_NO_MAPPING;
+    RemainingRead -= WasRead;
+    Buffer       = (VOID *)((CHAR8 *)Buffer + WasRead);
+    BeenRead    += WasRead;
+    CurrentSeek += WasRead;
+  }
+
+  *Length = BeenRead;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes zeroes to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Offset        Offset on the disk, in bytes.
+   @param[in]      Length        Number of bytes to zero.
+
+   @return Status of the write operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ZeroDisk (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT64          Offset,
+  IN UINT64          Length
+  )
+{
+  VOID        *Zeroes;
+  UINTN       ChunkSize;
+  UINTN       ToWrite;
+  EFI_STATUS  Status;
+
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+
+  ChunkSize = (UINTN)MIN (Length, SIZE_64KB);
+  Zeroes    = AllocateZeroPool (ChunkSize);
+
+  if (Zeroes == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+
+  while (Length != 0) {
+    ToWrite = (UINTN)MIN (Length, ChunkSize);
+    Status  = Ext4WriteDiskIo (Partition, Zeroes, ToWrite, Offset);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Offset += ToWrite;
+    Length -= ToWrite;
+  }
+
+  FreePool (Zeroes);
+  return Status;
+}
+
+/**
+   Zeroes the parts of a range of a file that are on the disk, leaving holes and
+   uninitialized extents (which already read back as zeroes) alone.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset into the file, in bytes.
+   @param[in]      Length        Length of the range, in bytes.
+
+   @return Status of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ZeroFileRange (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN UINT64          Offset,
+  IN UINT64          Length
+  )
+{
+  EXT4_DATA_RUN  Run;
+  EFI_STATUS     Status;
+
+  while (Length != 0) {
+    Status = Ext4MapFileOffset (Partition, File, Offset, &Run);
 
-    if (!HasBackingExtent || EXT4_EXTENT_IS_UNINITIALIZED (&Extent)) {
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
-      HoleOff = BlockOff;
+    Run.Length = MIN (Run.Length, Length);
 
-      if (!HasBackingExtent) {
-        HoleLen = Partition->BlockSize - HoleOff;
-      } else {
-        // Uninitialized extents behave exactly the same as file holes.
-        HoleLen = Ext4GetExtentLength (&Extent) - HoleOff;
+    if (!Run.IsHole) {
+      Status = Ext4ZeroDisk (Partition, Run.DiskOffset, Run.Length);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
       }
+    }
 
-      WasRead = HoleLen > RemainingRead ? RemainingRead : HoleLen;
-      // Potential improvement: In the future, we could get the file hole's total
-      // size and memset all that
-      SetMem (Buffer, WasRead, 0);
-    } else {
-      ExtentStartBytes = MultU64x32 (
-                           LShiftU64 (Extent.ee_start_hi, 32) |
-                           Extent.ee_start_lo,
-                           Partition->BlockSize
-                           );
-      ExtentLengthBytes  = Extent.ee_len * Partition->BlockSize;
-      ExtentLogicalBytes = (UINT64)Extent.ee_block * Partition->BlockSize;
-      ExtentOffset  = CurrentSeek - ExtentLogicalBytes;
-      ExtentMayRead = (UINTN)(ExtentLengthBytes - ExtentOffset);
+    Offset += Run.Length;
+    Length -= Run.Length;
+  }
 
-      WasRead = ExtentMayRead > RemainingRead ? RemainingRead : ExtentMayRead;
+  return EFI_SUCCESS;
+}
 
-      Status = Ext4ReadDiskIo (Partition, Buffer, WasRead, ExtentStartBytes + ExtentOffset);
+/**
+   Writes a range of blocks that was just allocated (or that reads back as zeroes), filling
+   in the parts of its first and last blocks that the data doesn't cover with zeroes.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      DiskOffset    Offset of the first block on the disk, in bytes.
+   @param[in]      BlocksLength  Length of the range of blocks, in bytes.
+   @param[in]      DataOffset    Offset of the data from the start of the first block.
+   @param[in]      Buffer        Pointer to the data.
+   @param[in]      DataLength    Length of the data, in bytes.
+
+   @return Status of the write operation.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteNewBlocks (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT64          DiskOffset,
+  IN UINT64          BlocksLength,
+  IN UINT64          DataOffset,
+  IN CONST VOID      *Buffer,
+  IN UINTN           DataLength
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Ext4ZeroDisk (Partition, DiskOffset, DataOffset);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4WriteDiskIo (Partition, Buffer, DataLength, DiskOffset + DataOffset);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4ZeroDisk (
+           Partition,
+           DiskOffset + DataOffset + DataLength,
+           BlocksLength - DataOffset - DataLength
+           );
+}
+
+/**
+   Picks the block a file's new blocks should ideally be allocated at: right after
+   the block that comes before them in the file, or else in the inode's block group.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      LogicalBlock  First logical block that's going to be allocated.
+
+   @return The goal block.
+**/
+EXT4_BLOCK_NR
+Ext4FileAllocationGoal (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN EXT4_BLOCK_NR   LogicalBlock
+  )
+{
+  EXT4_EXTENT  Extent;
+
+  if ((LogicalBlock != 0) &&
+      (Ext4GetExtent (Partition, File, LogicalBlock - 1, &Extent, NULL) == EFI_SUCCESS))
+  {
+    return (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + (LogicalBlock - 1 - Extent.ee_block) + 1;
+  }
+
+  return Partition->SuperBlock.s_first_data_block +
+         MultU64x32 (
+           (File->InodeNum - 1) / Partition->SuperBlock.s_inodes_per_group,
+           Partition->SuperBlock.s_blocks_per_group
+           );
+}
+
+/**
+   Sets the size of an inode, turning on the LARGE_FILE feature when it's needed.
+   The inode still has to be written back to the disk.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Size          New size, in bytes.
+**/
+STATIC
+VOID
+Ext4SetInodeSize (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN UINT64          Size
+  )
+{
+  File->Inode->i_size_lo = (UINT32)Size;
+  File->Inode->i_size_hi = (UINT32)RShiftU64 (Size, 32);
+
+  // Files of 2GiB and over need LARGE_FILE, which mke2fs enables anyway
+  if ((Size > MAX_INT32) && !EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_LARGE_FILE)) {
+    Partition->SuperBlock.s_feature_ro_compat |= EXT4_FEATURE_RO_COMPAT_LARGE_FILE;
+    Partition->FeaturesRoCompat                = Partition->SuperBlock.s_feature_ro_compat;
+    Ext4DirtySuperblock (Partition);
+  }
+}
+
+/**
+   Does the work of Ext4Write, in the running transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the data to write.
+   @param[in]      Offset        Offset of the write.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @return Status of the write operation.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteInTransaction (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN CONST VOID      *Buffer,
+  IN UINT64          Offset,
+  IN UINTN           Length
+  )
+{
+  UINT64         OldSize;
+  UINT64         CurrentSeek;
+  UINT64         End;
+  UINTN          WasWritten;
+  UINT32         BlockOff;
+  UINT32         Count;
+  EXT4_BLOCK_NR  LogicalBlock;
+  EXT4_BLOCK_NR  LastBlock;
+  EXT4_BLOCK_NR  Physical;
+  EXT4_EXTENT    Extent;
+  EXT4_DATA_RUN  Run;
+  EFI_STATUS     Status;
+
+  OldSize     = EXT4_INODE_SIZE (File->Inode);
+  CurrentSeek = Offset;
+  End         = Offset + Length;
+
+  // Whatever is between the old end of the file and the write must read back as zeroes
+  if (Offset > OldSize) {
+    Status = Ext4ZeroFileRange (Partition, File, OldSize, Offset - OldSize);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  while (CurrentSeek < End) {
+    Status = Ext4PlanDataRun (Partition, File, CurrentSeek, (UINTN)(End - CurrentSeek), &Run);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    LogicalBlock = DivU64x32Remainder (CurrentSeek, Partition->BlockSize, &BlockOff);
+
+    if (!Run.IsHole) {
+      WasWritten = (UINTN)Run.Length;
+
+      // Regular file data never goes through the block cache, so there's nothing to invalidate.
+      Status = Ext4WriteDiskIo (Partition, Buffer, WasWritten, Run.DiskOffset);
+    } else if (Run.IsUnwritten) {
+      // The parts of the first and last blocks the write doesn't cover must keep reading
+      // back as zeroes, once the blocks are marked as initialized.
+      WasWritten = (UINTN)Run.Length;
+      LastBlock  = DivU64x32 (CurrentSeek + WasWritten + Partition->BlockSize - 1, Partition->BlockSize);
+
+      Status = Ext4WriteNewBlocks (
+                 Partition,
+                 Run.DiskOffset - BlockOff,
+                 EXT4_BLOCK_TO_BYTES (Partition, LastBlock - LogicalBlock),
+                 BlockOff,
+                 Buffer,
+                 WasWritten
+                 );
+
+      if (!EFI_ERROR (Status)) {
+        Status = Ext4MarkExtentsInitialized (Partition, File, LogicalBlock, LastBlock - LogicalBlock);
+      }
+    } else {
+      LastBlock = DivU64x32 (CurrentSeek + Run.Length + Partition->BlockSize - 1, Partition->BlockSize);
+      Count     = (UINT32)MIN (LastBlock - LogicalBlock, EXT4_EXTENT_MAX_INITIALIZED);
+
+      Status = Ext4AllocateBlocks (
+                 Partition,
+                 Ext4FileAllocationGoal (Partition, File, LogicalBlock),
+                 &Count,
+                 &Physical
+                 );
 
       if (EFI_ERROR (Status)) {
-        DEBUG ((
-          DEBUG_ERROR,
-          "[ext4] Error %x reading [%lu, %lu]\n",
-          Status,
-          ExtentStartBytes + ExtentOffset,
-          ExtentStartBytes + ExtentOffset + WasRead - 1
-          ));
         return Status;
       }
+
+      WasWritten = (UINTN)MIN (Run.Length, EXT4_BLOCK_TO_BYTES (Partition, Count) - BlockOff);
+
+      Status = Ext4WriteNewBlocks (
+                 Partition,
+                 EXT4_BLOCK_TO_BYTES (Partition, Physical),
+                 EXT4_BLOCK_TO_BYTES (Partition, Count),
+                 BlockOff,
+                 Buffer,
+                 WasWritten
+                 );
+
+      if (!EFI_ERROR (Status)) {
+        Extent.ee_block    = (UINT32)LogicalBlock;
+        Extent.ee_len      = (UINT16)Count;
+        Extent.ee_start_hi = (UINT16)RShiftU64 (Physical, 32);
+        Extent.ee_start_lo = (UINT32)Physical;
+
+        Status = Ext4InodeAddBlocks (Partition, File->Inode, Count);
+      }
+
+      if (!EFI_ERROR (Status)) {
+        Status = Ext4InsertExtent (Partition, File, &Extent);
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Error %r writing to %s at offset %lu\n", Status, File->Dentry->Name, CurrentSeek));
+      return Status;
+    }
+
+    Buffer       = (CONST VOID *)((CONST CHAR8 *)Buffer + WasWritten);
+    CurrentSeek += WasWritten;
+  }
+
+  if (End > OldSize) {
+    Ext4SetInodeSize (Partition, File, End);
+  }
+
+  Ext4FileTouch (File);
+
+  return Ext4WriteInode (Partition, File->InodeNum, File->Inode);
+}
+
+/**
+   Writes to an EXT4 inode, and updates its modification time.
+   Holes (and the end of the file) get blocks allocated, and uninitialized extents are
+   converted. The metadata changes are done in a single transaction.
+
+   The data itself is written straight to its blocks, before the transaction is committed,
+   so the metadata never points at blocks whose data isn't on the disk yet.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the data to write.
+   @param[in]      Offset        Offset of the write.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @retval EFI_SUCCESS           The whole buffer was written.
+   @retval EFI_UNSUPPORTED       The file doesn't use extents.
+   @retval EFI_VOLUME_FULL       There's no space left. The file wasn't changed.
+   @return Status of the write operation.
+**/
+EFI_STATUS
+Ext4Write (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN CONST VOID      *Buffer,
+  IN UINT64          Offset,
+  IN UINTN           Length
+  )
+{
+  EFI_STATUS  Status;
+
+  DEBUG ((DEBUG_FS, "[ext4] Ext4Write(%s, Offset %lu, Length %lu)\n", File->Dentry->Name, Offset, Length));
+
+  if ((File->Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Only files that use extents can be written to\n"));
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // Extents can only map 32-bit logical block numbers
+  if ((Offset > EXT4_MAX_FILE_SIZE (Partition)) || (Length > EXT4_MAX_FILE_SIZE (Partition) - Offset)) {
+    return EFI_VOLUME_FULL;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4WriteInTransaction (Partition, File, Buffer, Offset, Length);
+
+  return Ext4EndTransaction (Partition, Status);
+}
+
+/**
+   Changes the size of an EXT4 inode. Blocks past the new end of the file are freed, and
+   extending the file leaves a hole.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Size          New size, in bytes.
+
+   @retval EFI_SUCCESS           The size was changed.
+   @retval EFI_UNSUPPORTED       The file doesn't use extents.
+   @return Status of the operation.
+**/
+EFI_STATUS
+Ext4SetFileSize (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  IN UINT64          Size
+  )
+{
+  UINT64      OldSize;
+  EFI_STATUS  Status;
+
+  OldSize = EXT4_INODE_SIZE (File->Inode);
+
+  if (Size == OldSize) {
+    return EFI_SUCCESS;
+  }
+
+  if ((File->Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Only files that use extents can be resized\n"));
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Size > EXT4_MAX_FILE_SIZE (Partition)) {
+    return EFI_VOLUME_FULL;
+  }
+
+  Status = Ext4StartTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Size < OldSize) {
+    Status = Ext4TruncateExtents (
+               Partition,
+               File,
+               DivU64x32 (Size + Partition->BlockSize - 1, Partition->BlockSize)
+               );
+  } else {
+    // The rest of the last block may have stale data in it
+    Status = Ext4ZeroFileRange (Partition, File, OldSize, Size - OldSize);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Ext4SetInodeSize (Partition, File, Size);
+    Ext4FileTouch (File);
+
+    Status = Ext4WriteInode (Partition, File->InodeNum, File->Inode);
+  }
+
+  return Ext4EndTransaction (Partition, Status);
+}
+
+// State of an asynchronous read (see Ext4ReadAsync)
+typedef struct {
+  EFI_FILE_IO_TOKEN    *Token;
+  EFI_STATUS           Status;
+  UINTN                Length;
+  // Number of disk requests in flight
+  UINTN                Pending;
+  // Set once every disk request has been submitted
+  BOOLEAN              Submitted;
+} EXT4_ASYNC_READ;
+
+// A single disk request that is part of an asynchronous read
+typedef struct {
+  EFI_DISK_IO2_TOKEN    DiskToken;
+  EXT4_ASYNC_READ       *Read;
+} EXT4_ASYNC_READ_REQUEST;
+
+/**
+   Completes an asynchronous read, signalling the caller's token.
+
+   @param[in]      Read          Pointer to the asynchronous read, which is freed.
+**/
+STATIC
+VOID
+Ext4CompleteAsyncRead (
+  IN EXT4_ASYNC_READ  *Read
+  )
+{
+  Read->Token->Status     = Read->Status;
+  Read->Token->BufferSize = EFI_ERROR (Read->Status) ? 0 : Read->Length;
+
+  gBS->SignalEvent (Read->Token->Event);
+
+  FreePool (Read);
+}
+
+/**
+   Notification function for the disk requests of an asynchronous read.
+
+   @param[in]      Event         Event of the disk request.
+   @param[in]      Context       Pointer to the EXT4_ASYNC_READ_REQUEST.
+**/
+STATIC
+VOID
+EFIAPI
+Ext4AsyncReadNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EXT4_ASYNC_READ_REQUEST  *Request;
+  EXT4_ASYNC_READ          *Read;
+
+  Request = Context;
+  Read    = Request->Read;
+
+  if (EFI_ERROR (Request->DiskToken.TransactionStatus) && !EFI_ERROR (Read->Status)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Async read failed: %r\n", Request->DiskToken.TransactionStatus));
+    Read->Status = Request->DiskToken.TransactionStatus;
+  }
+
+  gBS->CloseEvent (Event);
+  FreePool (Request);
+
+  Read->Pending--;
+
+  if ((Read->Pending == 0) && Read->Submitted) {
+    Ext4CompleteAsyncRead (Read);
+  }
+}
+
+/**
+   Submits a disk request for (part of) an asynchronous read.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Read          Pointer to the asynchronous read.
+   @param[out]     Buffer        Pointer to the destination buffer.
+   @param[in]      Length        Length of the request, in bytes.
+   @param[in]      Offset        Offset of the request on the disk, in bytes.
+
+   @return Status of the submission.
+**/
+STATIC
+EFI_STATUS
+Ext4SubmitAsyncReadRequest (
+  IN     EXT4_PARTITION   *Partition,
+  IN OUT EXT4_ASYNC_READ  *Read,
+  OUT    VOID             *Buffer,
+  IN     UINTN            Length,
+  IN     UINT64           Offset
+  )
+{
+  EXT4_ASYNC_READ_REQUEST  *Request;
+  EFI_STATUS               Status;
+
+  Request = AllocateZeroPool (sizeof (EXT4_ASYNC_READ_REQUEST));
+
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Request->Read = Read;
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  Ext4AsyncReadNotify,
+                  Request,
+                  &Request->DiskToken.Event
+                  );
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Request);
+    return Status;
+  }
+
+  Status = EXT4_DISK_IO2 (Partition)->ReadDiskEx (
+                                        EXT4_DISK_IO2 (Partition),
+                                        EXT4_MEDIA_ID (Partition),
+                                        Offset,
+                                        &Request->DiskToken,
+                                        Length,
+                                        Buffer
+                                        );
+
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (Request->DiskToken.Event);
+    FreePool (Request);
+    return Status;
+  }
+
+  Read->Pending++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads from an EXT4 inode asynchronously, using DISK_IO2.
+   Every extent covered by the read gets its own disk request, and the caller's
+   token is signalled once all of them complete.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the read.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 After a succesful submission, it's updated to the number
+                                 of bytes that are going to be read.
+   @param[in out]  Token         Pointer to the caller's token, which is signalled on completion.
+
+   @retval EFI_SUCCESS           The read was submitted; Token will be signalled on completion.
+   @retval !EFI_SUCCESS          The read failed to be submitted, and Token will not be signalled.
+**/
+EFI_STATUS
+Ext4ReadAsync (
+  IN     EXT4_PARTITION     *Partition,
+  IN     EXT4_FILE          *File,
+  OUT    VOID               *Buffer,
+  IN     UINT64             Offset,
+  IN OUT UINTN              *Length,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EXT4_ASYNC_READ  *Read;
+  EFI_TPL          OldTpl;
+  EXT4_INODE       *Inode;
+  UINT64           InodeSize;
+  UINT64           CurrentSeek;
+  UINTN            RemainingRead;
+  UINTN            WasRead;
+  EXT4_DATA_RUN    Run;
+  EFI_STATUS       Status;
+
+  Inode       = File->Inode;
+  InodeSize   = EXT4_INODE_SIZE (Inode);
+  CurrentSeek = Offset;
+
+  if (Offset > InodeSize) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  RemainingRead = *Length;
+
+  if (RemainingRead > InodeSize - Offset) {
+    RemainingRead = (UINTN)(InodeSize - Offset);
+  }
+
+  Read = AllocateZeroPool (sizeof (EXT4_ASYNC_READ));
+
+  if (Read == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Read->Token  = Token;
+  Read->Status = EFI_SUCCESS;
+  Read->Length = RemainingRead;
+
+  // Keep the disk requests' notification functions from running until we're done submitting.
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Status = EFI_SUCCESS;
+
+  while (RemainingRead != 0) {
+    Status = Ext4PlanDataRun (Partition, File, CurrentSeek, RemainingRead, &Run);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    WasRead = (UINTN)Run.Length;
+
+    if (Run.IsHole) {
+      // Holes don't need any I/O
+      SetMem (Buffer, WasRead, 0);
+    } else {
+      Status = Ext4SubmitAsyncReadRequest (Partition, Read, Buffer, WasRead, Run.DiskOffset);
+
+      if (EFI_ERROR (Status)) {
+        break;
+      }
     }
 
     RemainingRead -= WasRead;
-    Buffer       = (VOID *)((CHAR8 *)Buffer + WasRead);
-    BeenRead    += WasRead;
-    CurrentSeek += WasRead;
+    Buffer         = (VOID *)((CHAR8 *)Buffer + WasRead);
+    CurrentSeek   += WasRead;
   }
 
-  *Length = BeenRead;
+  if (EFI_ERROR (Status) && (Read->Pending == 0)) {
+    // Nothing is in flight, so we can fail synchronously
+    gBS->RestoreTPL (OldTpl);
+    FreePool (Read);
+    return Status;
+  }
+
+  // If some requests were already submitted, the error gets reported through the token.
+  if (EFI_ERROR (Status)) {
+    Read->Status = Status;
+  }
+
+  Read->Submitted = TRUE;
+  *Length         = Read->Length;
+
+  if (Read->Pending == 0) {
+    Ext4CompleteAsyncRead (Read);
+  }
+
+  gBS->RestoreTPL (OldTpl);
 
   return EFI_SUCCESS;
 }
@@ -252,7 +1047,7 @@ Ext4FileIsDir (
   IN CONST EXT4_FILE  *File
   )
 {
-  return (File->Inode->i_mode & EXT4_INO_TYPE_DIR) == EXT4_INO_TYPE_DIR;
+  return (File->Inode->i_mode & EXT4_INO_TYPE_MASK) == EXT4_INO_TYPE_DIR;
 }
 
 /**
@@ -266,7 +1061,7 @@ Ext4FileIsReg (
   IN CONST EXT4_FILE  *File
   )
 {
-  return (File->Inode->i_mode & EXT4_INO_TYPE_REGFILE) == EXT4_INO_TYPE_REGFILE;
+  return (File->Inode->i_mode & EXT4_INO_TYPE_MASK) == EXT4_INO_TYPE_REGFILE;
 }
 
 /**
@@ -300,6 +1095,64 @@ Ext4FilePhysicalSpace (
   return MultU64x32 (Blocks, 512);
 }
 
+/**
+   Adds to (or subtracts from) the number of blocks an inode uses.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Blocks        Number of filesystem blocks to add. Negative to subtract.
+
+   @retval EFI_SUCCESS           The count was updated.
+   @retval EFI_VOLUME_FULL       The count doesn't fit in the inode.
+**/
+EFI_STATUS
+Ext4InodeAddBlocks (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT EXT4_INODE            *Inode,
+  IN     INT64                 Blocks
+  )
+{
+  BOOLEAN  HugeFile;
+  UINT64   Count;
+  UINT64   Max;
+  INT64    Units;
+
+  HugeFile = EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_HUGE_FILE);
+  Count    = Inode->i_blocks;
+  Max      = MAX_UINT32;
+
+  if (HugeFile) {
+    Count |= LShiftU64 (Inode->i_osd2.data_linux.l_i_blocks_high, 32);
+    Max    = LShiftU64 (1, 48) - 1;
+  }
+
+  // See Ext4FilePhysicalSpace for the units of i_blocks
+  if (HugeFile && ((Inode->i_flags & EXT4_HUGE_FILE_FL) != 0)) {
+    Units = Blocks;
+  } else {
+    Units = MultS64x64 (Blocks, Partition->BlockSize / 512);
+  }
+
+  if ((Units < 0) && ((UINT64)-Units > Count)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Inode block count underflow\n"));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Count = (UINT64)((INT64)Count + Units);
+
+  if (Count > Max) {
+    return EFI_VOLUME_FULL;
+  }
+
+  Inode->i_blocks = (UINT32)Count;
+
+  if (HugeFile) {
+    Inode->i_osd2.data_linux.l_i_blocks_high = (UINT16)RShiftU64 (Count, 32);
+  }
+
+  return EFI_SUCCESS;
+}
+
 // Copied from EmbeddedPkg at my mentor's request.
 // The lack of comments and good variable names is frightening...
 
@@ -437,6 +1290,139 @@ Ext4FileCreateTime (
   Ext4FileCrTime (File, Time);
 }
 
+/**
+  Converts EFI_TIME to Epoch seconds (elapsed since 1970 JANUARY 01, 00:00:00 UTC).
+  Times before the Epoch are clamped to it.
+
+  @param[in]  Time  Pointer to an EFI_TIME structure, in UTC.
+
+  @return Epoch seconds.
+**/
+STATIC
+UINT64
+EFIAPI
+EfiTimeToEpoch (
+  IN  CONST EFI_TIME  *Time
+  )
+{
+  UINTN  a;
+  UINTN  y;
+  UINTN  m;
+  UINTN  JulianDate;
+
+  a = (14 - Time->Month) / 12;
+  y = Time->Year + 4800 - a;
+  m = Time->Month + (12 * a) - 3;
+
+  JulianDate = Time->Day + ((153 * m + 2) / 5) + (365 * y) + (y / 4) - (y / 100) + (y / 400) - 32045;
+
+  if (JulianDate < 2440588) {
+    return 0;
+  }
+
+  return MultU64x32 (JulianDate - 2440588, 86400) +
+         (UINTN)Time->Hour * 3600 + (UINTN)Time->Minute * 60 + Time->Second;
+}
+
+/**
+   Sets some of an inode's timestamps.
+   The inode still has to be written back to the disk.
+
+   @param[in out]  Inode    Pointer to the inode.
+   @param[in]      Time     Time to set, or NULL to use the current time.
+   @param[in]      Fields   Timestamps to set (EXT4_INODE_*TIME).
+
+   @retval EFI_SUCCESS            The times were set.
+   @retval EFI_INVALID_PARAMETER  Time isn't valid.
+   @return The current time couldn't be read.
+**/
+EFI_STATUS
+Ext4SetInodeTimes (
+  IN OUT EXT4_INODE      *Inode,
+  IN     CONST EFI_TIME  *Time  OPTIONAL,
+  IN     UINT32          Fields
+  )
+{
+  EFI_TIME    Now;
+  UINT64      SecondsEpoch;
+  UINT32      Extra;
+  EFI_STATUS  Status;
+
+  if (Time == NULL) {
+    Status = gRT->GetTime (&Now, NULL);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Time = &Now;
+  }
+
+  if ((Time->Month < 1) || (Time->Month > 12) || (Time->Day < 1) || (Time->Day > 31) ||
+      (Time->Hour > 23) || (Time->Minute > 59) || (Time->Second > 59) || (Time->Nanosecond > 999999999))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SecondsEpoch = EfiTimeToEpoch (Time);
+
+  // Local time is UTC - TimeZone (in minutes)
+  if ((Time->TimeZone != EFI_UNSPECIFIED_TIMEZONE) && ((INT64)SecondsEpoch + Time->TimeZone * 60 >= 0)) {
+    SecondsEpoch = (UINT64)((INT64)SecondsEpoch + Time->TimeZone * 60);
+  }
+
+  // The seconds get decoded as the sign extended 32-bit field, plus the epoch bits << 32
+  Extra = (UINT32)RShiftU64 (SecondsEpoch - (UINT64)(INT64)(INT32)(UINT32)SecondsEpoch, 32);
+  Extra = (Time->Nanosecond << 2) | (Extra & EXT4_EXTRA_TIMESTAMP_MASK);
+
+  if ((Fields & EXT4_INODE_ATIME) != 0) {
+    Inode->i_atime = (UINT32)SecondsEpoch;
+
+    if (EXT4_INODE_HAS_FIELD (Inode, i_atime_extra)) {
+      Inode->i_atime_extra = Extra;
+    }
+  }
+
+  if ((Fields & EXT4_INODE_MTIME) != 0) {
+    Inode->i_mtime = (UINT32)SecondsEpoch;
+
+    if (EXT4_INODE_HAS_FIELD (Inode, i_mtime_extra)) {
+      Inode->i_mtime_extra = Extra;
+    }
+  }
+
+  if ((Fields & EXT4_INODE_CTIME) != 0) {
+    Inode->i_ctime = (UINT32)SecondsEpoch;
+
+    if (EXT4_INODE_HAS_FIELD (Inode, i_ctime_extra)) {
+      Inode->i_ctime_extra = Extra;
+    }
+  }
+
+  // Only big enough inodes have a creation time
+  if (((Fields & EXT4_INODE_CRTIME) != 0) && EXT4_INODE_HAS_FIELD (Inode, i_crtime_extra)) {
+    Inode->i_crtime       = (UINT32)SecondsEpoch;
+    Inode->i_crtime_extra = Extra;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Sets the file's last modification and change times to the current time.
+   If the current time can't be read, the times are left alone.
+   The inode still has to be written back to the disk.
+
+   @param[in]      File   Pointer to the opened file.
+**/
+VOID
+Ext4FileTouch (
+  IN EXT4_FILE  *File
+  )
+{
+  Ext4SetInodeTimes (File->Inode, NULL, EXT4_INODE_MTIME | EXT4_INODE_CTIME);
+}
+
 /**
    Checks if the checksum of the inode is correct.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
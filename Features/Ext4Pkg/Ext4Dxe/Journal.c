@@ -0,0 +1,1363 @@
+/** @file
+  JBD2 journal routines
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Ext4Dxe writes every transaction to the journal before writing it to its final
+  location (checkpointing it), and empties the journal right after. There's never
+  more than one transaction in the log, which starts at the first log block, so
+  no revoke records are ever needed. Journals left behind by Linux are replayed
+  at mount time, the same way jbd2 does it: a scan pass finds the last committed
+  transaction, a revoke pass collects the revoked blocks, and a replay pass writes
+  the logged blocks that weren't revoked to their final location.
+**/
+
+#include "Ext4Dxe.h"
+
+// Every field of the journal is big-endian
+#define JBD2_BE16(Value)  SwapBytes16 (Value)
+#define JBD2_BE32(Value)  SwapBytes32 (Value)
+#define JBD2_BE64(Value)  SwapBytes64 (Value)
+
+#define JBD2_SUPPORTED_INCOMPAT  (JBD2_FEATURE_INCOMPAT_REVOKE | JBD2_FEATURE_INCOMPAT_64BIT | \
+                                  JBD2_FEATURE_INCOMPAT_CSUM_V2 | JBD2_FEATURE_INCOMPAT_CSUM_V3)
+
+#define JBD2_HAS_CSUM(Journal)  \
+  (((Journal)->Incompat & (JBD2_FEATURE_INCOMPAT_CSUM_V2 | JBD2_FEATURE_INCOMPAT_CSUM_V3)) != 0)
+
+// Biggest run of logged blocks written in one go
+#define EXT4_JOURNAL_MAX_RUN  SIZE_128KB
+
+#define EXT4_REVOKE_BUCKETS  64
+
+// A block revoked by a transaction: older copies of it in the log must not be replayed
+typedef struct {
+  LIST_ENTRY       Node;
+  EXT4_BLOCK_NR    Block;
+  UINT32           Sequence;
+} EXT4_REVOKED_BLOCK;
+
+#define EXT4_REVOKED_BLOCK_FROM_NODE(Node)  BASE_CR (Node, EXT4_REVOKED_BLOCK, Node)
+
+// Journal recovery passes
+typedef enum {
+  Ext4JournalPassScan,
+  Ext4JournalPassRevoke,
+  Ext4JournalPassReplay
+} EXT4_JOURNAL_PASS;
+
+// State of a journal recovery
+typedef struct {
+  LIST_ENTRY    Revoked[EXT4_REVOKE_BUCKETS];
+  // First transaction that wasn't committed, found by the scan pass
+  UINT32        EndSequence;
+} EXT4_JOURNAL_RECOVERY;
+
+/**
+   Calculates a journal checksum (crc32c, not inverted, like the rest of ext4's).
+
+   @param[in]  Seed           Seed of the checksum.
+   @param[in]  Buffer         Pointer to the buffer.
+   @param[in]  Length         Length of the buffer, in bytes.
+
+   @return The checksum.
+**/
+STATIC
+UINT32
+Ext4JournalChecksum (
+  IN UINT32      Seed,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  return ~CalculateCrc32c (Buffer, Length, ~Seed);
+}
+
+/**
+   Calculates the checksum of the journal superblock.
+
+   @param[in]  JournalSb      Pointer to the journal superblock.
+
+   @return The checksum, in big-endian.
+**/
+STATIC
+UINT32
+Ext4JournalSuperblockChecksum (
+  IN CONST JBD2_SUPERBLOCK  *JournalSb
+  )
+{
+  JBD2_SUPERBLOCK  Copy;
+
+  CopyMem (&Copy, JournalSb, sizeof (JBD2_SUPERBLOCK));
+  Copy.s_checksum = 0;
+
+  return JBD2_BE32 (Ext4JournalChecksum (~0U, &Copy, sizeof (JBD2_SUPERBLOCK)));
+}
+
+/**
+   Calculates the checksum of a descriptor or revoke block, kept in its tail.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Block          Pointer to the block.
+
+   @return The checksum, in big-endian.
+**/
+STATIC
+UINT32
+Ext4JournalBlockTailChecksum (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN VOID                  *Block
+  )
+{
+  JBD2_BLOCK_TAIL  *Tail;
+  UINT32           Saved;
+  UINT32           Csum;
+
+  Tail             = (JBD2_BLOCK_TAIL *)((UINT8 *)Block + Partition->BlockSize - sizeof (JBD2_BLOCK_TAIL));
+  Saved            = Tail->t_checksum;
+  Tail->t_checksum = 0;
+  Csum             = Ext4JournalChecksum (Partition->Journal->CsumSeed, Block, Partition->BlockSize);
+  Tail->t_checksum = Saved;
+
+  return JBD2_BE32 (Csum);
+}
+
+/**
+   Calculates the checksum of a commit block.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Block          Pointer to the commit block.
+
+   @return The checksum, in big-endian.
+**/
+STATIC
+UINT32
+Ext4JournalCommitChecksum (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN VOID                  *Block
+  )
+{
+  JBD2_COMMIT_HEADER  *Commit;
+  UINT32              Saved;
+  UINT32              Csum;
+
+  Commit              = Block;
+  Saved               = Commit->h_chksum[0];
+  Commit->h_chksum[0] = 0;
+  Csum                = Ext4JournalChecksum (Partition->Journal->CsumSeed, Block, Partition->BlockSize);
+  Commit->h_chksum[0] = Saved;
+
+  return JBD2_BE32 (Csum);
+}
+
+/**
+   Calculates the checksum of a logged block, as kept in its descriptor tag.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Sequence       Sequence number of the block's transaction.
+   @param[in]  Block          Pointer to the logged (escaped) block.
+
+   @return The checksum.
+**/
+STATIC
+UINT32
+Ext4JournalTagChecksum (
+  IN CONST EXT4_PARTITION  *Partition,
+  IN UINT32                Sequence,
+  IN CONST VOID            *Block
+  )
+{
+  UINT32  Csum;
+
+  Sequence = JBD2_BE32 (Sequence);
+  Csum     = Ext4JournalChecksum (Partition->Journal->CsumSeed, &Sequence, sizeof (Sequence));
+  return Ext4JournalChecksum (Csum, Block, Partition->BlockSize);
+}
+
+/**
+   Reads or writes contiguous blocks of the log.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      LogBlock       First block of the log.
+   @param[in]      Count          Number of blocks.
+   @param[in out]  Buffer         Pointer to the data.
+   @param[in]      Write          TRUE to write, FALSE to read.
+
+   @retval EFI_SUCCESS           The blocks were transferred.
+   @retval EFI_VOLUME_CORRUPTED  The journal inode doesn't map the blocks.
+   @return Any error from the transfer.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalTransfer (
+  IN     EXT4_PARTITION  *Partition,
+  IN     UINT32          LogBlock,
+  IN     UINT32          Count,
+  IN OUT VOID            *Buffer,
+  IN     BOOLEAN         Write
+  )
+{
+  EXT4_EXTENT    Extent;
+  EXT4_BLOCK_NR  Physical;
+  UINT32         Length;
+  UINTN          Bytes;
+  EFI_STATUS     Status;
+
+  while (Count != 0) {
+    Status = Ext4GetExtent (Partition, Partition->Journal->File, LogBlock, &Extent, NULL);
+
+    if (Status == EFI_NO_MAPPING) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (EXT4_EXTENT_IS_UNINITIALIZED (&Extent)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Physical = (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + (LogBlock - Extent.ee_block);
+    Length   = MIN (Count, Extent.ee_block + Ext4GetExtentLength (&Extent) - LogBlock);
+    Bytes    = (UINTN)EXT4_BLOCK_TO_BYTES (Partition, Length);
+
+    if (Physical + Length > Partition->NumberBlocks) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (Write) {
+      Status = Ext4WriteDiskIo (Partition, Buffer, Bytes, EXT4_BLOCK_TO_BYTES (Partition, Physical));
+    } else {
+      Status = Ext4ReadDiskIo (Partition, Buffer, Bytes, EXT4_BLOCK_TO_BYTES (Partition, Physical));
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Buffer    = (UINT8 *)Buffer + Bytes;
+    LogBlock += Length;
+    Count    -= Length;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes the journal superblock, updating its checksum first.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+
+   @return Status of the write.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteJournalSuperblock (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL  *Journal;
+  UINT8         *Block;
+  EFI_STATUS    Status;
+
+  Journal = Partition->Journal;
+
+  if (JBD2_HAS_CSUM (Journal)) {
+    Journal->SuperBlock.s_checksum = Ext4JournalSuperblockChecksum (&Journal->SuperBlock);
+  }
+
+  // The superblock is at the start of the first block of the log, whatever its size
+  Block = AllocateZeroPool (Partition->BlockSize);
+
+  if (Block == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4JournalTransfer (Partition, 0, 1, Block, FALSE);
+
+  if (!EFI_ERROR (Status)) {
+    CopyMem (Block, &Journal->SuperBlock, sizeof (JBD2_SUPERBLOCK));
+    Status = Ext4JournalTransfer (Partition, 0, 1, Block, TRUE);
+  }
+
+  FreePool (Block);
+  return Status;
+}
+
+/**
+   Gets the block of the log that comes after another, wrapping around at the end.
+
+   @param[in]      Journal        Pointer to the journal.
+   @param[in]      LogBlock       Block of the log.
+
+   @return The next block.
+**/
+STATIC
+UINT32
+Ext4JournalNextBlock (
+  IN CONST EXT4_JOURNAL  *Journal,
+  IN UINT32              LogBlock
+  )
+{
+  LogBlock++;
+
+  return LogBlock >= Journal->MaxLen ? Journal->First : LogBlock;
+}
+
+/**
+   Opens the partition's journal, and checks if Ext4Dxe can use it.
+   If it can't, the partition is made read-only.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The journal was opened, or the partition was made read-only.
+   @return Any error from reading the journal.
+**/
+EFI_STATUS
+Ext4OpenJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL     *Journal;
+  EXT4_FILE        *File;
+  JBD2_SUPERBLOCK  *JournalSb;
+  UINT8            *Block;
+  UINT32           BlockType;
+  EFI_STATUS       Status;
+
+  if (Partition->SuperBlock.s_journal_inum == 0) {
+    DEBUG ((DEBUG_WARN, "[ext4] External journals are not supported, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  Journal = AllocateZeroPool (sizeof (EXT4_JOURNAL));
+
+  if (Journal == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Partition->Journal = Journal;
+  Block              = NULL;
+
+  // The journal inode isn't in OpenFiles: it's never looked up, nor written to as a file
+  File = AllocateZeroPool (sizeof (EXT4_FILE));
+
+  if (File == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Error;
+  }
+
+  Journal->File  = File;
+  File->InodeNum = Partition->SuperBlock.s_journal_inum;
+  Ext4SetupFile (File, Partition);
+
+  Status = Ext4InitExtentsMap (File);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  Status = Ext4ReadInode (Partition, File->InodeNum, &File->Inode);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  if ((File->Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    DEBUG ((DEBUG_WARN, "[ext4] The journal doesn't use extents, mounting read-only\n"));
+    goto ReadOnly;
+  }
+
+  Block = AllocatePool (Partition->BlockSize);
+
+  if (Block == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Error;
+  }
+
+  Status = Ext4JournalTransfer (Partition, 0, 1, Block, FALSE);
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  JournalSb = &Journal->SuperBlock;
+  CopyMem (JournalSb, Block, sizeof (JBD2_SUPERBLOCK));
+
+  BlockType = JBD2_BE32 (JournalSb->s_header.h_blocktype);
+
+  if ((JBD2_BE32 (JournalSb->s_header.h_magic) != JBD2_MAGIC) ||
+      ((BlockType != JBD2_SUPERBLOCK_V1) && (BlockType != JBD2_SUPERBLOCK_V2)) ||
+      (JBD2_BE32 (JournalSb->s_blocksize) != Partition->BlockSize))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad journal superblock\n"));
+    Status = EFI_VOLUME_CORRUPTED;
+    goto Error;
+  }
+
+  Journal->First    = JBD2_BE32 (JournalSb->s_first);
+  Journal->MaxLen   = JBD2_BE32 (JournalSb->s_maxlen);
+  Journal->Sequence = JBD2_BE32 (JournalSb->s_sequence);
+  Journal->Head     = Journal->First;
+
+  if ((Journal->First == 0) || (Journal->First >= Journal->MaxLen) ||
+      (Journal->MaxLen > DivU64x32 (EXT4_INODE_SIZE (File->Inode), Partition->BlockSize)))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad journal geometry\n"));
+    Status = EFI_VOLUME_CORRUPTED;
+    goto Error;
+  }
+
+  // Version 1 superblocks have no features at all
+  if (BlockType == JBD2_SUPERBLOCK_V2) {
+    Journal->Incompat = JBD2_BE32 (JournalSb->s_feature_incompat);
+
+    if ((Journal->Incompat & ~JBD2_SUPPORTED_INCOMPAT) != 0) {
+      DEBUG ((DEBUG_WARN, "[ext4] Unsupported journal features %x, mounting read-only\n", Journal->Incompat));
+      goto ReadOnly;
+    }
+
+    // The old checksums only cover commit blocks, and can't be used along with v2 or v3 ones
+    if ((JBD2_BE32 (JournalSb->s_feature_compat) & JBD2_FEATURE_COMPAT_CHECKSUM) != 0) {
+      DEBUG ((DEBUG_WARN, "[ext4] Unsupported journal checksums, mounting read-only\n"));
+      goto ReadOnly;
+    }
+  }
+
+  if (JBD2_HAS_CSUM (Journal)) {
+    if (((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V2) != 0) &&
+        ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V3) != 0))
+    {
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Error;
+    }
+
+    if ((JournalSb->s_checksum_type != JBD2_CRC32C_CHKSUM) ||
+        (JournalSb->s_checksum != Ext4JournalSuperblockChecksum (JournalSb)))
+    {
+      DEBUG ((DEBUG_ERROR, "[ext4] Bad journal superblock checksum\n"));
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Error;
+    }
+
+    Journal->CsumSeed = Ext4JournalChecksum (~0U, JournalSb->s_uuid, sizeof (JournalSb->s_uuid));
+  }
+
+  // Without 64-bit tags, blocks past 2^32 can't be logged
+  if ((Partition->NumberBlocks > MAX_UINT32) && ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) == 0)) {
+    DEBUG ((DEBUG_WARN, "[ext4] The journal can't log every block, mounting read-only\n"));
+    goto ReadOnly;
+  }
+
+  // See jbd2's journal_tag_bytes
+  if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V3) != 0) {
+    Journal->TagSize = sizeof (JBD2_BLOCK_TAG3);
+  } else {
+    Journal->TagSize = sizeof (JBD2_BLOCK_TAG);
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V2) != 0) {
+      Journal->TagSize += sizeof (UINT16);
+    }
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) == 0) {
+      Journal->TagSize -= sizeof (UINT32);
+    }
+  }
+
+  FreePool (Block);
+  return EFI_SUCCESS;
+
+ReadOnly:
+  Partition->ReadOnly = TRUE;
+  Status              = EFI_SUCCESS;
+
+Error:
+  if (Block != NULL) {
+    FreePool (Block);
+  }
+
+  Ext4CloseJournal (Partition);
+  return Status;
+}
+
+/**
+   Closes the partition's journal.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4CloseJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL  *Journal;
+
+  Journal            = Partition->Journal;
+  Partition->Journal = NULL;
+
+  if (Journal == NULL) {
+    return;
+  }
+
+  if (Journal->File != NULL) {
+    Ext4FreeExtentsMap (Journal->File);
+
+    if (Journal->File->Inode != NULL) {
+      FreePool (Journal->File->Inode);
+    }
+
+    FreePool (Journal->File);
+  }
+
+  FreePool (Journal);
+}
+
+/**
+   Looks a block up in the revoke table of a journal recovery.
+
+   @param[in]  Recovery       Pointer to the recovery state.
+   @param[in]  Block          Block number.
+
+   @return Pointer to the revoke record, or NULL if the block wasn't revoked.
+**/
+STATIC
+EXT4_REVOKED_BLOCK *
+Ext4FindRevokedBlock (
+  IN EXT4_JOURNAL_RECOVERY  *Recovery,
+  IN EXT4_BLOCK_NR          Block
+  )
+{
+  LIST_ENTRY          *Bucket;
+  LIST_ENTRY          *Node;
+  EXT4_REVOKED_BLOCK  *Revoked;
+
+  Bucket = &Recovery->Revoked[(UINTN)(Block % EXT4_REVOKE_BUCKETS)];
+
+  BASE_LIST_FOR_EACH (Node, Bucket) {
+    Revoked = EXT4_REVOKED_BLOCK_FROM_NODE (Node);
+
+    if (Revoked->Block == Block) {
+      return Revoked;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Records the blocks revoked by a revoke block.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Recovery       Pointer to the recovery state.
+   @param[in]      Data           Pointer to the revoke block.
+   @param[in]      Sequence       Sequence number of the revoke block's transaction.
+
+   @retval EFI_SUCCESS           The blocks were recorded.
+   @retval EFI_VOLUME_CORRUPTED  The revoke block is invalid.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+STATIC
+EFI_STATUS
+Ext4RecordRevokedBlocks (
+  IN     EXT4_PARTITION         *Partition,
+  IN OUT EXT4_JOURNAL_RECOVERY  *Recovery,
+  IN     CONST UINT8            *Data,
+  IN     UINT32                 Sequence
+  )
+{
+  EXT4_JOURNAL        *Journal;
+  EXT4_REVOKED_BLOCK  *Revoked;
+  UINT32              Count;
+  UINT32              Offset;
+  UINT32              RecordSize;
+  UINT32              Block32;
+  UINT64              Block64;
+  EXT4_BLOCK_NR       Block;
+
+  Journal    = Partition->Journal;
+  Count      = JBD2_BE32 (((CONST JBD2_REVOKE_HEADER *)Data)->r_count);
+  RecordSize = ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) != 0) ? sizeof (UINT64) : sizeof (UINT32);
+
+  if (Count > Partition->BlockSize - (JBD2_HAS_CSUM (Journal) ? sizeof (JBD2_BLOCK_TAIL) : 0)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  for (Offset = sizeof (JBD2_REVOKE_HEADER); Offset + RecordSize <= Count; Offset += RecordSize) {
+    if (RecordSize == sizeof (UINT64)) {
+      CopyMem (&Block64, Data + Offset, sizeof (Block64));
+      Block = JBD2_BE64 (Block64);
+    } else {
+      CopyMem (&Block32, Data + Offset, sizeof (Block32));
+      Block = JBD2_BE32 (Block32);
+    }
+
+    Revoked = Ext4FindRevokedBlock (Recovery, Block);
+
+    if (Revoked != NULL) {
+      // Sequence numbers wrap around, like jbd2's tid_gt
+      if ((INT32)(Sequence - Revoked->Sequence) > 0) {
+        Revoked->Sequence = Sequence;
+      }
+
+      continue;
+    }
+
+    Revoked = AllocatePool (sizeof (EXT4_REVOKED_BLOCK));
+
+    if (Revoked == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Revoked->Block    = Block;
+    Revoked->Sequence = Sequence;
+    InsertTailList (&Recovery->Revoked[(UINTN)(Block % EXT4_REVOKE_BUCKETS)], &Revoked->Node);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes a logged block to its final location, unless a later transaction revoked it.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      Recovery       Pointer to the recovery state.
+   @param[in]      LogBlock       Block of the log the block was logged in.
+   @param[in]      Target         Final location of the block.
+   @param[in]      Flags          Flags of the block's tag.
+   @param[in]      Checksum       Checksum of the block's tag.
+   @param[in]      Sequence       Sequence number of the block's transaction.
+   @param[out]     Data           Pointer to a scratch block.
+
+   @return Status of the replay. Blocks with bad checksums or block numbers are skipped.
+**/
+STATIC
+EFI_STATUS
+Ext4ReplayBlock (
+  IN  EXT4_PARTITION         *Partition,
+  IN  EXT4_JOURNAL_RECOVERY  *Recovery,
+  IN  UINT32                 LogBlock,
+  IN  EXT4_BLOCK_NR          Target,
+  IN  UINT32                 Flags,
+  IN  UINT32                 Checksum,
+  IN  UINT32                 Sequence,
+  OUT UINT8                  *Data
+  )
+{
+  EXT4_JOURNAL        *Journal;
+  EXT4_REVOKED_BLOCK  *Revoked;
+  UINT32              Csum;
+  EFI_STATUS          Status;
+
+  Journal = Partition->Journal;
+  Revoked = Ext4FindRevokedBlock (Recovery, Target);
+
+  if ((Revoked != NULL) && ((INT32)(Sequence - Revoked->Sequence) <= 0)) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4JournalTransfer (Partition, LogBlock, 1, Data, FALSE);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (JBD2_HAS_CSUM (Journal)) {
+    Csum = Ext4JournalTagChecksum (Partition, Sequence, Data);
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V2) != 0) {
+      Csum &= 0xFFFF;
+    }
+
+    if (Csum != Checksum) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Bad checksum of logged block %lu, skipping it\n", Target));
+      return EFI_SUCCESS;
+    }
+  }
+
+  if (Target >= Partition->NumberBlocks) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Logged block %lu is out of range, skipping it\n", Target));
+    return EFI_SUCCESS;
+  }
+
+  if ((Flags & JBD2_FLAG_ESCAPE) != 0) {
+    *(UINT32 *)Data = JBD2_BE32 (JBD2_MAGIC);
+  }
+
+  return Ext4WriteDiskIoCached (Partition, Data, Partition->BlockSize, EXT4_BLOCK_TO_BYTES (Partition, Target));
+}
+
+/**
+   Goes through the tags of a descriptor block, replaying the blocks they describe if
+   this is the replay pass.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      Recovery       Pointer to the recovery state.
+   @param[in]      Pass           Recovery pass.
+   @param[in]      Descriptor     Pointer to the descriptor block.
+   @param[in]      Sequence       Sequence number of the descriptor block's transaction.
+   @param[in out]  LogBlock       On input, the block of the log the descriptor block is in.
+                                  On output, the block of the log the last tag describes.
+   @param[out]     Data           Pointer to a scratch block.
+
+   @return Status of the replay.
+**/
+STATIC
+EFI_STATUS
+Ext4ReplayDescriptor (
+  IN     EXT4_PARTITION         *Partition,
+  IN     EXT4_JOURNAL_RECOVERY  *Recovery,
+  IN     EXT4_JOURNAL_PASS      Pass,
+  IN     CONST UINT8            *Descriptor,
+  IN     UINT32                 Sequence,
+  IN OUT UINT32                 *LogBlock,
+  OUT    UINT8                  *Data
+  )
+{
+  EXT4_JOURNAL     *Journal;
+  JBD2_BLOCK_TAG3  Tag3;
+  JBD2_BLOCK_TAG   *Tag;
+  UINTN            Offset;
+  UINTN            End;
+  UINT32           Flags;
+  UINT32           Checksum;
+  EXT4_BLOCK_NR    Target;
+  EFI_STATUS       Status;
+
+  Journal = Partition->Journal;
+  Offset  = sizeof (JBD2_HEADER);
+  End     = Partition->BlockSize - (JBD2_HAS_CSUM (Journal) ? sizeof (JBD2_BLOCK_TAIL) : 0);
+  Tag     = (JBD2_BLOCK_TAG *)&Tag3;
+
+  while (Offset + Journal->TagSize <= End) {
+    ZeroMem (&Tag3, sizeof (Tag3));
+    CopyMem (&Tag3, Descriptor + Offset, Journal->TagSize);
+
+    // Both kinds of tags start with the low half of the block number
+    Target = JBD2_BE32 (Tag3.t_blocknr);
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V3) != 0) {
+      Flags    = JBD2_BE32 (Tag3.t_flags);
+      Checksum = JBD2_BE32 (Tag3.t_checksum);
+
+      if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) != 0) {
+        Target |= LShiftU64 (JBD2_BE32 (Tag3.t_blocknr_high), 32);
+      }
+    } else {
+      Flags    = JBD2_BE16 (Tag->t_flags);
+      Checksum = JBD2_BE16 (Tag->t_checksum);
+
+      if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) != 0) {
+        Target |= LShiftU64 (JBD2_BE32 (Tag->t_blocknr_high), 32);
+      }
+    }
+
+    *LogBlock = Ext4JournalNextBlock (Journal, *LogBlock);
+
+    if (Pass == Ext4JournalPassReplay) {
+      Status = Ext4ReplayBlock (Partition, Recovery, *LogBlock, Target, Flags, Checksum, Sequence, Data);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    Offset += Journal->TagSize;
+
+    if ((Flags & JBD2_FLAG_SAME_UUID) == 0) {
+      Offset += sizeof (Journal->SuperBlock.s_uuid);
+    }
+
+    if ((Flags & JBD2_FLAG_LAST_TAG) != 0) {
+      break;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Does one pass of the journal recovery, going through the log from its start.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Recovery       Pointer to the recovery state. The scan pass sets
+                                  EndSequence, which the other passes stop at.
+   @param[in]      Pass           Recovery pass.
+   @param[out]     Block          Pointer to a scratch block.
+   @param[out]     Data           Pointer to another scratch block.
+
+   @return Status of the pass.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalRecoveryPass (
+  IN     EXT4_PARTITION         *Partition,
+  IN OUT EXT4_JOURNAL_RECOVERY  *Recovery,
+  IN     EXT4_JOURNAL_PASS      Pass,
+  OUT    UINT8                  *Block,
+  OUT    UINT8                  *Data
+  )
+{
+  EXT4_JOURNAL  *Journal;
+  JBD2_HEADER   *Header;
+  UINT32        LogBlock;
+  UINT32        Sequence;
+  UINT32        Steps;
+  BOOLEAN       Valid;
+  EFI_STATUS    Status;
+
+  Journal  = Partition->Journal;
+  LogBlock = JBD2_BE32 (Journal->SuperBlock.s_start);
+  Sequence = JBD2_BE32 (Journal->SuperBlock.s_sequence);
+  Header   = (JBD2_HEADER *)Block;
+
+  // A log that never ends is corrupted; stop after going around it once
+  for (Steps = 0; Steps < Journal->MaxLen; Steps++) {
+    if ((Pass != Ext4JournalPassScan) && (Sequence == Recovery->EndSequence)) {
+      break;
+    }
+
+    Status = Ext4JournalTransfer (Partition, LogBlock, 1, Block, FALSE);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    // The log ends at the first block that isn't part of the next transaction
+    if ((JBD2_BE32 (Header->h_magic) != JBD2_MAGIC) || (JBD2_BE32 (Header->h_sequence) != Sequence)) {
+      break;
+    }
+
+    switch (JBD2_BE32 (Header->h_blocktype)) {
+      case JBD2_DESCRIPTOR_BLOCK:
+        Valid = !JBD2_HAS_CSUM (Journal) ||
+                (((JBD2_BLOCK_TAIL *)(Block + Partition->BlockSize - sizeof (JBD2_BLOCK_TAIL)))->t_checksum ==
+                 Ext4JournalBlockTailChecksum (Partition, Block));
+
+        if (Valid) {
+          Status = Ext4ReplayDescriptor (Partition, Recovery, Pass, Block, Sequence, &LogBlock, Data);
+        }
+
+        break;
+
+      case JBD2_COMMIT_BLOCK:
+        Valid = !JBD2_HAS_CSUM (Journal) ||
+                (((JBD2_COMMIT_HEADER *)Block)->h_chksum[0] == Ext4JournalCommitChecksum (Partition, Block));
+
+        if (Valid) {
+          Sequence++;
+        }
+
+        break;
+
+      case JBD2_REVOKE_BLOCK:
+        Valid = !JBD2_HAS_CSUM (Journal) ||
+                (((JBD2_BLOCK_TAIL *)(Block + Partition->BlockSize - sizeof (JBD2_BLOCK_TAIL)))->t_checksum ==
+                 Ext4JournalBlockTailChecksum (Partition, Block));
+
+        if (Valid && (Pass == Ext4JournalPassRevoke)) {
+          Status = Ext4RecordRevokedBlocks (Partition, Recovery, Block, Sequence);
+        }
+
+        break;
+
+      default:
+        Valid = FALSE;
+        break;
+    }
+
+    // A block that fails its checksum ends the log, as far as the scan pass is concerned
+    if (!Valid) {
+      if (Pass == Ext4JournalPassScan) {
+        break;
+      }
+
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    LogBlock = Ext4JournalNextBlock (Journal, LogBlock);
+  }
+
+  if (Pass == Ext4JournalPassScan) {
+    Recovery->EndSequence = Sequence;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Replays the committed transactions in the journal, and marks the journal as empty.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The journal was replayed.
+   @return Any error from replaying it.
+**/
+EFI_STATUS
+Ext4RecoverJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL           *Journal;
+  EXT4_JOURNAL_RECOVERY  *Recovery;
+  EXT4_REVOKED_BLOCK     *Revoked;
+  EXT4_SUPERBLOCK        *Sb;
+  LIST_ENTRY             *Node;
+  LIST_ENTRY             *Next;
+  UINT8                  *Block;
+  UINT8                  *Data;
+  UINTN                  Index;
+  EFI_STATUS             Status;
+
+  Journal  = Partition->Journal;
+  Recovery = AllocateZeroPool (sizeof (EXT4_JOURNAL_RECOVERY));
+  Block    = AllocatePool (Partition->BlockSize);
+  Data     = AllocatePool (Partition->BlockSize);
+  Sb       = AllocatePool (sizeof (EXT4_SUPERBLOCK));
+
+  if ((Recovery == NULL) || (Block == NULL) || (Data == NULL) || (Sb == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  for (Index = 0; Index < EXT4_REVOKE_BUCKETS; Index++) {
+    InitializeListHead (&Recovery->Revoked[Index]);
+  }
+
+  Status = EFI_SUCCESS;
+
+  // A journal that starts at 0 is empty
+  if (Journal->SuperBlock.s_start != 0) {
+    Status = Ext4JournalRecoveryPass (Partition, Recovery, Ext4JournalPassScan, Block, Data);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4JournalRecoveryPass (Partition, Recovery, Ext4JournalPassRevoke, Block, Data);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4JournalRecoveryPass (Partition, Recovery, Ext4JournalPassReplay, Block, Data);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Error %r replaying the journal\n", Status));
+      goto Out;
+    }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "[ext4] Replayed journal transactions %u to %u\n",
+      JBD2_BE32 (Journal->SuperBlock.s_sequence),
+      Recovery->EndSequence - 1
+      ));
+
+    // Like jbd2, skip a sequence number, in case a later transaction made it to the log
+    Journal->Sequence = Recovery->EndSequence + 1;
+  }
+
+  Journal->SuperBlock.s_start    = 0;
+  Journal->SuperBlock.s_sequence = JBD2_BE32 (Journal->Sequence);
+
+  Status = Ext4WriteJournalSuperblock (Partition);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  // The replayed blocks may have included the superblock, so it's read again
+  Status = Ext4ReadDiskIo (Partition, Sb, sizeof (EXT4_SUPERBLOCK), EXT4_SUPERBLOCK_OFFSET);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Sb->s_feature_incompat &= ~EXT4_FEATURE_INCOMPAT_RECOVER;
+  Ext4UpdateSuperblockChecksum (Partition, Sb);
+
+  Status = Ext4WriteDiskIoCached (Partition, Sb, sizeof (EXT4_SUPERBLOCK), EXT4_SUPERBLOCK_OFFSET);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+  }
+
+Out:
+  if (Recovery != NULL) {
+    for (Index = 0; Index < EXT4_REVOKE_BUCKETS; Index++) {
+      BASE_LIST_FOR_EACH_SAFE (Node, Next, &Recovery->Revoked[Index]) {
+        Revoked = EXT4_REVOKED_BLOCK_FROM_NODE (Node);
+        RemoveEntryList (Node);
+        FreePool (Revoked);
+      }
+    }
+
+    FreePool (Recovery);
+  }
+
+  if (Block != NULL) {
+    FreePool (Block);
+  }
+
+  if (Data != NULL) {
+    FreePool (Data);
+  }
+
+  if (Sb != NULL) {
+    FreePool (Sb);
+  }
+
+  return Status;
+}
+
+/**
+   Fills in a descriptor block tag.
+
+   @param[in]      Journal        Pointer to the journal.
+   @param[out]     Tag            Pointer to where the tag goes.
+   @param[in]      Target         Final location of the logged block.
+   @param[in]      Flags          Flags of the tag.
+   @param[in]      Checksum       Checksum of the logged block.
+**/
+STATIC
+VOID
+Ext4FillJournalTag (
+  IN  CONST EXT4_JOURNAL  *Journal,
+  OUT UINT8               *Tag,
+  IN  EXT4_BLOCK_NR       Target,
+  IN  UINT32              Flags,
+  IN  UINT32              Checksum
+  )
+{
+  JBD2_BLOCK_TAG3  Tag3;
+  JBD2_BLOCK_TAG   *OldTag;
+
+  ZeroMem (&Tag3, sizeof (Tag3));
+  OldTag = (JBD2_BLOCK_TAG *)&Tag3;
+
+  Tag3.t_blocknr = JBD2_BE32 ((UINT32)Target);
+
+  if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V3) != 0) {
+    Tag3.t_flags        = JBD2_BE32 (Flags);
+    Tag3.t_blocknr_high = JBD2_BE32 ((UINT32)RShiftU64 (Target, 32));
+    Tag3.t_checksum     = JBD2_BE32 (Checksum);
+  } else {
+    OldTag->t_flags = JBD2_BE16 ((UINT16)Flags);
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V2) != 0) {
+      OldTag->t_checksum = JBD2_BE16 ((UINT16)Checksum);
+    }
+
+    if ((Journal->Incompat & JBD2_FEATURE_INCOMPAT_64BIT) != 0) {
+      OldTag->t_blocknr_high = JBD2_BE32 ((UINT32)RShiftU64 (Target, 32));
+    }
+  }
+
+  CopyMem (Tag, &Tag3, Journal->TagSize);
+}
+
+/**
+   Writes the running transaction's blocks to the log, each descriptor block followed by
+   the blocks it describes.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      TagsPerDesc    Number of tags that fit in a descriptor block.
+   @param[out]     LogBlock       Block of the log that comes after the transaction's blocks.
+
+   @return Status of the writes.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalWriteBlocks (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINTN           TagsPerDesc,
+  OUT UINT32          *LogBlock
+  )
+{
+  EXT4_JOURNAL      *Journal;
+  EXT4_TRANSACTION  *Transaction;
+  EXT4_BUFFER       *Buffer;
+  LIST_ENTRY        *Node;
+  JBD2_HEADER       *Header;
+  JBD2_BLOCK_TAIL   *Tail;
+  UINT8             *Desc;
+  UINT8             *Run;
+  UINT8             *Slot;
+  UINTN             RunBlocks;
+  UINTN             InRun;
+  UINTN             Tags;
+  UINTN             Offset;
+  UINT32            DescBlock;
+  UINT32            RunStart;
+  UINT32            Flags;
+  UINT32            Checksum;
+  EFI_STATUS        Status;
+
+  Journal     = Partition->Journal;
+  Transaction = Partition->Transaction;
+  RunBlocks   = MAX (EXT4_JOURNAL_MAX_RUN / Partition->BlockSize, 1);
+  Desc        = AllocatePool (Partition->BlockSize);
+  Run         = AllocatePool (RunBlocks * Partition->BlockSize);
+  Status      = EFI_SUCCESS;
+
+  if ((Desc == NULL) || (Run == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  *LogBlock = Journal->Head;
+  Node      = GetFirstNode (&Transaction->Buffers);
+
+  while (!IsNull (&Transaction->Buffers, Node)) {
+    ZeroMem (Desc, Partition->BlockSize);
+    Header              = (JBD2_HEADER *)Desc;
+    Header->h_magic     = JBD2_BE32 (JBD2_MAGIC);
+    Header->h_blocktype = JBD2_BE32 (JBD2_DESCRIPTOR_BLOCK);
+    Header->h_sequence  = JBD2_BE32 (Journal->Sequence);
+
+    DescBlock = (*LogBlock)++;
+    RunStart  = *LogBlock;
+    Offset    = sizeof (JBD2_HEADER);
+    InRun     = 0;
+
+    for (Tags = 0; Tags < TagsPerDesc && !IsNull (&Transaction->Buffers, Node); Tags++) {
+      Buffer = EXT4_BUFFER_FROM_LIST_NODE (Node);
+      Slot   = Run + InRun * Partition->BlockSize;
+      CopyMem (Slot, EXT4_BUFFER_DATA (Buffer), Partition->BlockSize);
+
+      // Blocks that look like journal blocks get escaped, so the log stays unambiguous
+      Flags = (Tags != 0) ? JBD2_FLAG_SAME_UUID : 0;
+
+      if (*(UINT32 *)Slot == JBD2_BE32 (JBD2_MAGIC)) {
+        *(UINT32 *)Slot = 0;
+        Flags          |= JBD2_FLAG_ESCAPE;
+      }
+
+      Node = GetNextNode (&Transaction->Buffers, Node);
+
+      if ((Tags + 1 == TagsPerDesc) || IsNull (&Transaction->Buffers, Node)) {
+        Flags |= JBD2_FLAG_LAST_TAG;
+      }
+
+      Checksum = JBD2_HAS_CSUM (Journal) ? Ext4JournalTagChecksum (Partition, Journal->Sequence, Slot) : 0;
+
+      Ext4FillJournalTag (Journal, Desc + Offset, Buffer->Block, Flags, Checksum);
+      Offset += Journal->TagSize;
+
+      if (Tags == 0) {
+        CopyMem (Desc + Offset, Journal->SuperBlock.s_uuid, sizeof (Journal->SuperBlock.s_uuid));
+        Offset += sizeof (Journal->SuperBlock.s_uuid);
+      }
+
+      if (++InRun == RunBlocks) {
+        Status = Ext4JournalTransfer (Partition, RunStart, (UINT32)InRun, Run, TRUE);
+
+        if (EFI_ERROR (Status)) {
+          goto Out;
+        }
+
+        RunStart += (UINT32)InRun;
+        InRun     = 0;
+      }
+
+      (*LogBlock)++;
+    }
+
+    if (InRun != 0) {
+      Status = Ext4JournalTransfer (Partition, RunStart, (UINT32)InRun, Run, TRUE);
+
+      if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+    }
+
+    if (JBD2_HAS_CSUM (Journal)) {
+      Tail             = (JBD2_BLOCK_TAIL *)(Desc + Partition->BlockSize - sizeof (JBD2_BLOCK_TAIL));
+      Tail->t_checksum = Ext4JournalBlockTailChecksum (Partition, Desc);
+    }
+
+    Status = Ext4JournalTransfer (Partition, DescBlock, 1, Desc, TRUE);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+  }
+
+Out:
+  if (Desc != NULL) {
+    FreePool (Desc);
+  }
+
+  if (Run != NULL) {
+    FreePool (Run);
+  }
+
+  return Status;
+}
+
+/**
+   Writes the running transaction's blocks to the journal, followed by the commit block.
+   Once this succeeds, the transaction survives a power loss.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The transaction was committed to the journal.
+   @retval EFI_VOLUME_FULL       The transaction doesn't fit in the journal.
+   @return Any error from writing to the disk.
+**/
+EFI_STATUS
+Ext4JournalCommit (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL        *Journal;
+  EXT4_SUPERBLOCK     *Sb;
+  JBD2_COMMIT_HEADER  *Commit;
+  UINT8               *Block;
+  UINTN               Space;
+  UINTN               TagsPerDesc;
+  UINTN               NumBuffers;
+  UINT64              Needed;
+  UINT32              LogBlock;
+  EFI_STATUS          Status;
+
+  Journal    = Partition->Journal;
+  NumBuffers = Partition->Transaction->NumBuffers;
+
+  // The first tag of each descriptor block is followed by the journal's UUID
+  Space       = Partition->BlockSize - sizeof (JBD2_HEADER) - sizeof (Journal->SuperBlock.s_uuid);
+  Space      -= JBD2_HAS_CSUM (Journal) ? sizeof (JBD2_BLOCK_TAIL) : 0;
+  TagsPerDesc = Space / Journal->TagSize;
+  Needed      = DivU64x32 (NumBuffers + TagsPerDesc - 1, (UINT32)TagsPerDesc) + NumBuffers + 1;
+
+  if (Needed > Journal->MaxLen - Journal->First) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Transaction of %lu blocks doesn't fit in the journal\n", (UINT64)NumBuffers));
+    return EFI_VOLUME_FULL;
+  }
+
+  Block = AllocatePool (MAX (Partition->BlockSize, sizeof (EXT4_SUPERBLOCK)));
+
+  if (Block == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4JournalWriteBlocks (Partition, TagsPerDesc, &LogBlock);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Journal->SuperBlock.s_start    = JBD2_BE32 (Journal->First);
+  Journal->SuperBlock.s_sequence = JBD2_BE32 (Journal->Sequence);
+
+  Status = Ext4WriteJournalSuperblock (Partition);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  // Make the next mount replay the journal, until the transaction is checkpointed.
+  // This goes to the disk directly, since the transaction was already logged.
+  Sb     = (EXT4_SUPERBLOCK *)Block;
+  Status = Ext4ReadDiskIo (Partition, Sb, sizeof (EXT4_SUPERBLOCK), EXT4_SUPERBLOCK_OFFSET);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  if ((Sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_RECOVER) == 0) {
+    Sb->s_feature_incompat |= EXT4_FEATURE_INCOMPAT_RECOVER;
+    Ext4UpdateSuperblockChecksum (Partition, Sb);
+
+    Status = Ext4WriteDiskIoCached (Partition, Sb, sizeof (EXT4_SUPERBLOCK), EXT4_SUPERBLOCK_OFFSET);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+  }
+
+  // The commit block may only reach the disk after everything else, including the data
+  Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  ZeroMem (Block, Partition->BlockSize);
+  Commit                       = (JBD2_COMMIT_HEADER *)Block;
+  Commit->h_header.h_magic     = JBD2_BE32 (JBD2_MAGIC);
+  Commit->h_header.h_blocktype = JBD2_BE32 (JBD2_COMMIT_BLOCK);
+  Commit->h_header.h_sequence  = JBD2_BE32 (Journal->Sequence);
+
+  if (JBD2_HAS_CSUM (Journal)) {
+    Commit->h_chksum[0] = Ext4JournalCommitChecksum (Partition, Block);
+  }
+
+  Status = Ext4JournalTransfer (Partition, LogBlock, 1, Block, TRUE);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Journal->Head = Ext4JournalNextBlock (Journal, LogBlock);
+  }
+
+Out:
+  FreePool (Block);
+  return Status;
+}
+
+/**
+   Marks the journal as empty, once the committed transaction was written to its final
+   location (checkpointed).
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @return Status of updating the journal.
+**/
+EFI_STATUS
+Ext4JournalCheckpointed (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL  *Journal;
+  EFI_STATUS    Status;
+
+  Journal = Partition->Journal;
+
+  Journal->Sequence++;
+  Journal->Head                  = Journal->First;
+  Journal->SuperBlock.s_start    = 0;
+  Journal->SuperBlock.s_sequence = JBD2_BE32 (Journal->Sequence);
+
+  Status = Ext4WriteJournalSuperblock (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Ext4UpdateSuperblockChecksum (Partition, &Partition->SuperBlock);
+
+  Status = Ext4WriteDiskIoCached (
+             Partition,
+             &Partition->SuperBlock,
+             sizeof (EXT4_SUPERBLOCK),
+             EXT4_SUPERBLOCK_OFFSET
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // The next transaction reuses the log, which must not happen while this one could
+  // still be replayed from it.
+  return Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+}
@@ -62,6 +62,22 @@ Ext4OpenPartition (
     return Status;
   }
 
+  if (FeaturePcdGet (PcdExt4InstallDebugProtocol)) {
+    Part->DebugInterface.Revision           = EXT4_DEBUG_PROTOCOL_REVISION;
+    Part->DebugInterface.GetBlockCacheStats = Ext4DebugGetBlockCacheStats;
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                    &DeviceHandle,
+                    &gExt4DebugProtocolGuid,
+                    &Part->DebugInterface,
+                    NULL
+                    );
+
+    // The debug protocol is purely informational, so don't fail the mount over it
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "[ext4] Failed to install the debug protocol: %r\n", Status));
+    }
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -77,9 +93,9 @@ Ext4SetupFile (
   IN EXT4_PARTITION  *Partition
   )
 {
-  // Note: We don't yet support revision 2 of the file protocol
-  // (needs DISK_IO2 + asynchronous IO)
-  File->Protocol.Revision    = EFI_FILE_PROTOCOL_REVISION;
+  // Note: Revision 2 calls only complete asynchronously for file reads on
+  // disks that support DISK_IO2; everything else completes before returning.
+  File->Protocol.Revision    = EFI_FILE_PROTOCOL_REVISION2;
   File->Protocol.Open        = Ext4Open;
   File->Protocol.Close       = Ext4Close;
   File->Protocol.Delete      = Ext4Delete;
@@ -89,6 +105,11 @@ Ext4SetupFile (
   File->Protocol.GetPosition = Ext4GetPosition;
   File->Protocol.GetInfo     = Ext4GetInfo;
   File->Protocol.SetInfo     = Ext4SetInfo;
+  File->Protocol.Flush       = Ext4Flush;
+  File->Protocol.OpenEx      = Ext4OpenEx;
+  File->Protocol.ReadEx      = Ext4ReadEx;
+  File->Protocol.WriteEx     = Ext4WriteEx;
+  File->Protocol.FlushEx     = Ext4FlushEx;
 
   File->Partition = Partition;
 }
@@ -111,6 +132,13 @@ Ext4UnmountAndFreePartition (
   BOOLEAN     DeletedRootDentry;
 
   Partition->Unmounting = TRUE;
+
+  // Abort any asynchronous reads that are still in flight; their tokens get signalled
+  // with EFI_ABORTED.
+  if (EXT4_DISK_IO2 (Partition) != NULL) {
+    EXT4_DISK_IO2 (Partition)->Cancel (EXT4_DISK_IO2 (Partition));
+  }
+
   Ext4CloseInternal (Partition->Root);
 
   BASE_LIST_FOR_EACH_SAFE (Entry, NextEntry, &Partition->OpenFiles) {
@@ -119,13 +147,18 @@ Ext4UnmountAndFreePartition (
     Ext4CloseInternal (File);
   }
 
+  // Cached dentries hold references to their parents, all the way up to the root
+  Ext4PurgeDentryCache (Partition);
+
   DeletedRootDentry = Ext4UnrefDentry (Partition->RootDentry);
 
   if (!DeletedRootDentry) {
     DEBUG ((DEBUG_ERROR, "[ext4] Failed to delete root dentry - resource leak present.\n"));
   }
 
-  FreePool (Partition->BlockGroups);
+  Ext4CloseJournal (Partition);
+  Ext4FreeBlockCache (Partition);
+  Ext4FreeBlockGroupDescs (Partition);
   FreePool (Partition);
 
   return EFI_SUCCESS;
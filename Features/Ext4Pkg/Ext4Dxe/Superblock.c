@@ -7,7 +7,8 @@
 
 #include "Ext4Dxe.h"
 
-STATIC CONST UINT32  gSupportedCompatFeat = EXT4_FEATURE_COMPAT_EXT_ATTR;
+STATIC CONST UINT32  gSupportedCompatFeat =
+  EXT4_FEATURE_COMPAT_EXT_ATTR | EXT4_FEATURE_COMPAT_DIR_INDEX | EXT3_FEATURE_COMPAT_HAS_JOURNAL;
 
 STATIC CONST UINT32  gSupportedRoCompatFeat =
   EXT4_FEATURE_RO_COMPAT_DIR_NLINK | EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE |
@@ -21,11 +22,12 @@ STATIC CONST UINT32  gSupportedIncompatFeat =
   EXT4_FEATURE_INCOMPAT_MMP | EXT4_FEATURE_INCOMPAT_RECOVER;
 
 // Future features that may be nice additions in the future:
-// 1) Btree support: Required for write support and would speed up lookups in large directories.
-// 2) meta_bg: Required to mount meta_bg-enabled partitions.
+// 1) meta_bg: Required to mount meta_bg-enabled partitions.
+// 2) Indexing linear directories once they outgrow a block, like Linux does.
 
 // Note: We ignore MMP because it's impossible that it's mapped elsewhere,
 // I think (unless there's some sort of network setup where we're accessing a remote partition).
+// We don't update the MMP block, though, so such partitions are only mounted read-only.
 
 // Note on corruption signaling:
 // We (Ext4Dxe) could signal corruption by setting s_state to |= EXT4_FS_STATE_ERRORS_DETECTED.
@@ -107,7 +109,7 @@ Ext4SuperblockValidate (
 STATIC
 UINT32
 Ext4CalculateSuperblockChecksum (
-  EXT4_PARTITION         *Partition,
+  CONST EXT4_PARTITION   *Partition,
   CONST EXT4_SUPERBLOCK  *Sb
   )
 {
@@ -147,6 +149,23 @@ Ext4VerifySuperblockChecksum (
   return Sb->s_checksum == Ext4CalculateSuperblockChecksum (Partition, Sb);
 }
 
+/**
+   Computes the checksum of the superblock, and stores it in the superblock.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Sb             Pointer to the superblock.
+**/
+VOID
+Ext4UpdateSuperblockChecksum (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT EXT4_SUPERBLOCK       *Sb
+  )
+{
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Sb->s_checksum = Ext4CalculateSuperblockChecksum (Partition, Sb);
+  }
+}
+
 /**
    Opens and parses the superblock.
 
@@ -159,13 +178,9 @@ Ext4OpenSuperblock (
   OUT EXT4_PARTITION  *Partition
   )
 {
-  UINT32                 Index;
-  EFI_STATUS             Status;
-  EXT4_SUPERBLOCK        *Sb;
-  UINT32                 NrBlocksRem;
-  UINTN                  NrBlocks;
-  UINT32                 UnsupportedRoCompat;
-  EXT4_BLOCK_GROUP_DESC  *Desc;
+  EFI_STATUS       Status;
+  EXT4_SUPERBLOCK  *Sb;
+  UINT32           UnsupportedRoCompat;
 
   Status = Ext4ReadDiskIo (
              Partition,
@@ -213,13 +228,8 @@ Ext4OpenSuperblock (
     return EFI_UNSUPPORTED;
   }
 
-  if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_RECOVER)) {
-    DEBUG ((DEBUG_WARN, "[ext4] Needs journal recovery, mounting read-only\n"));
-    Partition->ReadOnly = TRUE;
-  }
-
   // At the time of writing, it's the only supported checksum.
-  if (Partition->FeaturesCompat & EXT4_FEATURE_RO_COMPAT_METADATA_CSUM &&
+  if (EXT4_HAS_METADATA_CSUM (Partition) &&
       Sb->s_checksum_type != EXT4_CHECKSUM_CRC32C) {
     return EFI_UNSUPPORTED;
   }
@@ -230,6 +240,22 @@ Ext4OpenSuperblock (
     Partition->InitialSeed = Ext4CalculateChecksum (Partition, Sb->s_uuid, 16, ~0U);
   }
 
+  // Write support has to be opted into.
+  if (!FeaturePcdGet (PcdExt4EnableWrite) || Partition->BlockIo->Media->ReadOnly) {
+    Partition->ReadOnly = TRUE;
+  }
+
+  // Neither the MMP block nor directory entries with extra data are kept up to date
+  if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_MMP) || EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_DIRDATA)) {
+    DEBUG ((DEBUG_WARN, "[ext4] Can't write to MMP or dirdata partitions, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+  }
+
+  if ((Sb->s_state & EXT4_FS_STATE_ERRORS_DETECTED) != 0) {
+    DEBUG ((DEBUG_WARN, "[ext4] Filesystem has errors, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+  }
+
   UnsupportedRoCompat = Partition->FeaturesRoCompat & ~gSupportedRoCompatFeat;
 
   if (UnsupportedRoCompat != 0) {
@@ -243,15 +269,46 @@ Ext4OpenSuperblock (
 
   DEBUG ((DEBUG_FS, "Read only = %u\n", Partition->ReadOnly));
 
+  if (Sb->s_log_block_size > EXT4_MAX_BLOCK_LOG_SIZE - EXT4_MIN_BLOCK_LOG_SIZE) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad block size log %u\n", Sb->s_log_block_size));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
   Partition->BlockSize = (UINT32)LShiftU64 (1024, Sb->s_log_block_size);
 
+  // Directory entries of 64KiB blocks store their length differently
+  if (Partition->BlockSize > SIZE_32KB) {
+    Partition->ReadOnly = TRUE;
+  }
+
+  // Inodes need to be at least as big as the original ext2 inode, and they can't straddle blocks
+  if ((Partition->InodeSize < EXT4_GOOD_OLD_INODE_SIZE) || (Partition->InodeSize > Partition->BlockSize) ||
+      ((Partition->InodeSize & (Partition->InodeSize - 1)) != 0))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad inode size %u\n", Partition->InodeSize));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (Sb->s_inodes_per_group == 0) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
   // The size of a block group can also be calculated as 8 * Partition->BlockSize
   if (Sb->s_blocks_per_group != 8 * Partition->BlockSize) {
     return EFI_UNSUPPORTED;
   }
 
   Partition->NumberBlocks = EXT4_BLOCK_NR_FROM_HALFS (Partition, Sb->s_blocks_count, Sb->s_blocks_count_hi);
-  Partition->NumberBlockGroups = DivU64x32 (Partition->NumberBlocks, Sb->s_blocks_per_group);
+
+  if (Sb->s_first_data_block >= Partition->NumberBlocks) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  // Block groups start at s_first_data_block, and the last one may be partial
+  Partition->NumberBlockGroups = DivU64x32 (
+                                   Partition->NumberBlocks - Sb->s_first_data_block + Sb->s_blocks_per_group - 1,
+                                   Sb->s_blocks_per_group
+                                   );
 
   DEBUG ((
     DEBUG_FS,
@@ -271,41 +328,70 @@ Ext4OpenSuperblock (
     return EFI_VOLUME_CORRUPTED;
   }
 
+  // Descriptors can't straddle blocks either
+  if ((Partition->DescSize > EXT4_MAX_BLOCK_DESC_SIZE) || ((Partition->DescSize & (Partition->DescSize - 1)) != 0)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
   if (!Ext4VerifySuperblockChecksum (Partition, Sb)) {
     DEBUG ((DEBUG_ERROR, "[ext4] Bad superblock checksum %lx\n", Ext4CalculateSuperblockChecksum (Partition, Sb)));
     return EFI_VOLUME_CORRUPTED;
   }
 
-  NrBlocks = (UINTN)DivU64x32Remainder (
-                      MultU64x32 (Partition->NumberBlockGroups, Partition->DescSize),
-                      Partition->BlockSize,
-                      &NrBlocksRem
-                      );
+  Status = Ext4LoadBlockGroupDescs (Partition);
 
-  if (NrBlocksRem != 0) {
-    NrBlocks++;
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  Partition->BlockGroups = Ext4AllocAndReadBlocks (Partition, NrBlocks, Partition->BlockSize == 1024 ? 2 : 1);
+  Status = Ext4InitBlockCache (Partition);
 
-  if (Partition->BlockGroups == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  if (EFI_ERROR (Status)) {
+    Ext4FreeBlockGroupDescs (Partition);
+    return Status;
   }
 
-  for (Index = 0; Index < Partition->NumberBlockGroups; Index++) {
-    Desc = Ext4GetBlockGroupDesc (Partition, Index);
-    if (!Ext4VerifyBlockGroupDescChecksum (Partition, Desc, Index)) {
-      DEBUG ((DEBUG_ERROR, "[ext4] Block group descriptor %u has an invalid checksum\n", Index));
-      FreePool (Partition->BlockGroups);
-      return EFI_VOLUME_CORRUPTED;
+  if (!Partition->ReadOnly && EXT4_HAS_COMPAT (Partition, EXT3_FEATURE_COMPAT_HAS_JOURNAL)) {
+    Status = Ext4OpenJournal (Partition);
+
+    if (EFI_ERROR (Status)) {
+      Ext4FreeBlockCache (Partition);
+      Ext4FreeBlockGroupDescs (Partition);
+      return Status;
+    }
+  }
+
+  if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_RECOVER)) {
+    if (Partition->Journal == NULL) {
+      DEBUG ((DEBUG_WARN, "[ext4] Needs journal recovery, mounting read-only\n"));
+      Partition->ReadOnly = TRUE;
+    } else {
+      Status = Ext4RecoverJournal (Partition);
+      Ext4CloseJournal (Partition);
+      Ext4FreeBlockCache (Partition);
+      Ext4FreeBlockGroupDescs (Partition);
+
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "[ext4] Journal recovery failed, mounting read-only\n"));
+        Partition->ReadOnly = TRUE;
+      }
+
+      // The replay may have changed any of the metadata read so far, so start over.
+      // RECOVER is clear by now, unless the partition was made read-only.
+      return Ext4OpenSuperblock (Partition);
     }
   }
 
-  // RootDentry will serve as the basis of our directory entry tree.
-  Partition->RootDentry = Ext4CreateDentry (L"\\", NULL);
+  InitializeListHead (&Partition->DentryCache.UnusedList);
+  Partition->DentryCache.MaxUnused = PcdGet32 (PcdExt4DentryCacheSize);
+
+  // RootDentry will serve as the basis of our directory entry tree (and cache).
+  Partition->RootDentry = Ext4CreateDentry (Partition, L"\\", EXT4_ROOT_INODE_NR, NULL);
 
   if (Partition->RootDentry == NULL) {
-    FreePool (Partition->BlockGroups);
+    Ext4CloseJournal (Partition);
+    Ext4FreeBlockCache (Partition);
+    Ext4FreeBlockGroupDescs (Partition);
     return EFI_OUT_OF_RESOURCES;
   }
 
@@ -314,7 +400,9 @@ Ext4OpenSuperblock (
 
   if (EFI_ERROR (Status)) {
     Ext4UnrefDentry (Partition->RootDentry);
-    FreePool (Partition->BlockGroups);
+    Ext4CloseJournal (Partition);
+    Ext4FreeBlockCache (Partition);
+    Ext4FreeBlockGroupDescs (Partition);
   }
 
   return Status;
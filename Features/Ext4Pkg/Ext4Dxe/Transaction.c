@@ -0,0 +1,739 @@
+/** @file
+  Transaction routines
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Every change to the filesystem's metadata (bitmaps, block group descriptors,
+  inodes, extent tree and directory blocks, the superblock) is done to copies
+  of the blocks held by the running transaction. Reads going through the block
+  cache see the modified copies, so the rest of the driver doesn't need to know
+  about them. Once the operation is done, the transaction is committed: its
+  blocks go through the journal (if the filesystem has one) and are then
+  written to their final location. If the operation fails halfway, the
+  transaction is aborted and the disk is left untouched.
+**/
+
+#include "Ext4Dxe.h"
+
+// Biggest run of adjacent blocks written in one go when checkpointing
+#define EXT4_TRANSACTION_MAX_RUN  SIZE_128KB
+
+/**
+   Gets the hash bucket of a block of the transaction.
+
+   @param[in]  Transaction    Pointer to the transaction.
+   @param[in]  Block          Block number.
+
+   @return Pointer to the head of the bucket's list.
+**/
+STATIC
+LIST_ENTRY *
+Ext4TransactionBucket (
+  IN EXT4_TRANSACTION  *Transaction,
+  IN EXT4_BLOCK_NR     Block
+  )
+{
+  UINT32  Hash;
+
+  Hash  = ((UINT32)Block ^ (UINT32)RShiftU64 (Block, 32)) * 0x9E3779B9U;
+  Hash ^= Hash >> 16;
+
+  return &Transaction->Buckets[Hash % EXT4_TRANSACTION_BUCKETS];
+}
+
+/**
+   Looks a block up in the transaction.
+
+   @param[in]  Transaction    Pointer to the transaction.
+   @param[in]  Block          Block number.
+
+   @return Pointer to the buffer holding the block, or NULL if the transaction didn't modify it.
+**/
+STATIC
+EXT4_BUFFER *
+Ext4TransactionFind (
+  IN EXT4_TRANSACTION  *Transaction,
+  IN EXT4_BLOCK_NR     Block
+  )
+{
+  LIST_ENTRY   *Node;
+  EXT4_BUFFER  *Buffer;
+
+  BASE_LIST_FOR_EACH (Node, Ext4TransactionBucket (Transaction, Block)) {
+    Buffer = EXT4_BUFFER_FROM_HASH_NODE (Node);
+
+    if (Buffer->Block == Block) {
+      return Buffer;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Frees a transaction and every buffer it holds.
+
+   @param[in]  Transaction    Pointer to the transaction.
+**/
+STATIC
+VOID
+Ext4FreeTransaction (
+  IN EXT4_TRANSACTION  *Transaction
+  )
+{
+  LIST_ENTRY   *Node;
+  LIST_ENTRY   *NextNode;
+  EXT4_BUFFER  *Buffer;
+
+  BASE_LIST_FOR_EACH_SAFE (Node, NextNode, &Transaction->Buffers) {
+    Buffer = EXT4_BUFFER_FROM_LIST_NODE (Node);
+    FreePool (Buffer);
+  }
+
+  if (Transaction->Freed != NULL) {
+    FreePool (Transaction->Freed);
+  }
+
+  FreePool (Transaction);
+}
+
+/**
+   Starts a transaction, or nests in the running one.
+   Every change to the filesystem's metadata needs to be done inside a transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The transaction was started.
+   @retval EFI_WRITE_PROTECTED   The partition is read-only.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4StartTransaction (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+  UINTN             Index;
+
+  if (Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (Partition->Transaction != NULL) {
+    Partition->Transaction->Depth++;
+    return EFI_SUCCESS;
+  }
+
+  Transaction = AllocateZeroPool (sizeof (EXT4_TRANSACTION));
+
+  if (Transaction == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < EXT4_TRANSACTION_BUCKETS; Index++) {
+    InitializeListHead (&Transaction->Buckets[Index]);
+  }
+
+  InitializeListHead (&Transaction->Buffers);
+  Transaction->Depth = 1;
+
+  Partition->Transaction = Transaction;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets a filesystem block ready to be modified by the running transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          Block number.
+   @param[in]      IsNew          If TRUE, the block's current contents don't matter (e.g it was
+                                  just allocated); it's zeroed instead of being read.
+   @param[out]     Data           Pointer to where the pointer to the block's data is stored.
+                                  It stays valid until the transaction ends, or the block is
+                                  forgotten.
+
+   @return Status of reading the block.
+**/
+EFI_STATUS
+Ext4ModifyBlock (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     BOOLEAN         IsNew,
+  OUT    VOID            **Data
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+  EXT4_BUFFER       *Buffer;
+  EXT4_BUFFER       *Prev;
+  LIST_ENTRY        *Node;
+  EFI_STATUS        Status;
+
+  Transaction = Partition->Transaction;
+  ASSERT (Transaction != NULL);
+
+  if (Block >= Partition->NumberBlocks) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Tried to modify block %lu past the end of the filesystem\n", Block));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Buffer = Ext4TransactionFind (Transaction, Block);
+
+  if (Buffer != NULL) {
+    if (IsNew) {
+      ZeroMem (EXT4_BUFFER_DATA (Buffer), Partition->BlockSize);
+    }
+
+    *Data = EXT4_BUFFER_DATA (Buffer);
+    return EFI_SUCCESS;
+  }
+
+  Buffer = AllocatePool (sizeof (EXT4_BUFFER) + Partition->BlockSize);
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (IsNew) {
+    ZeroMem (EXT4_BUFFER_DATA (Buffer), Partition->BlockSize);
+  } else {
+    Status = Ext4ReadDiskIoCached (
+               Partition,
+               EXT4_BUFFER_DATA (Buffer),
+               Partition->BlockSize,
+               MultU64x32 (Block, Partition->BlockSize)
+               );
+
+    if (EFI_ERROR (Status)) {
+      FreePool (Buffer);
+      return Status;
+    }
+  }
+
+  Buffer->Block = Block;
+  InsertHeadList (Ext4TransactionBucket (Transaction, Block), &Buffer->HashNode);
+
+  // Keep the list sorted. Blocks tend to be modified in increasing order, so look
+  // for the spot starting from the end.
+  for (Node = GetPreviousNode (&Transaction->Buffers, &Transaction->Buffers);
+       Node != &Transaction->Buffers;
+       Node = GetPreviousNode (&Transaction->Buffers, Node))
+  {
+    Prev = EXT4_BUFFER_FROM_LIST_NODE (Node);
+
+    if (Prev->Block < Block) {
+      break;
+    }
+  }
+
+  // Inserting at the tail of a node's "list" inserts right after the node
+  InsertHeadList (Node, &Buffer->ListNode);
+  Transaction->NumBuffers++;
+
+  *Data = EXT4_BUFFER_DATA (Buffer);
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops any changes the running transaction made to a range of blocks, and forgets
+   about them, since they were freed. Cached copies are dropped as well.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          First block of the range.
+   @param[in]      Count          Number of blocks in the range.
+
+   @retval EFI_SUCCESS           The blocks were forgotten.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4ForgetBlocks (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EXT4_BLOCK_NR   Block,
+  IN     UINT64          Count
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+  EXT4_FREED_RANGE  *Freed;
+  EXT4_FREED_RANGE  *Last;
+  LIST_ENTRY        *Node;
+  LIST_ENTRY        *NextNode;
+  EXT4_BUFFER       *Buffer;
+
+  Transaction = Partition->Transaction;
+  ASSERT (Transaction != NULL);
+
+  if (Transaction->NumFreed != 0) {
+    Last = &Transaction->Freed[Transaction->NumFreed - 1];
+  } else {
+    Last = NULL;
+  }
+
+  if ((Last != NULL) && (Last->Start + Last->Count == Block)) {
+    Last->Count += Count;
+  } else {
+    if (Transaction->NumFreed == Transaction->MaxFreed) {
+      Freed = ReallocatePool (
+                Transaction->MaxFreed * sizeof (EXT4_FREED_RANGE),
+                (Transaction->MaxFreed + 16) * sizeof (EXT4_FREED_RANGE),
+                Transaction->Freed
+                );
+
+      if (Freed == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+
+      Transaction->Freed     = Freed;
+      Transaction->MaxFreed += 16;
+    }
+
+    Transaction->Freed[Transaction->NumFreed].Start = Block;
+    Transaction->Freed[Transaction->NumFreed].Count = Count;
+    Transaction->NumFreed++;
+  }
+
+  // The transaction usually holds a lot less blocks than files have, so check every buffer.
+  BASE_LIST_FOR_EACH_SAFE (Node, NextNode, &Transaction->Buffers) {
+    Buffer = EXT4_BUFFER_FROM_LIST_NODE (Node);
+
+    if ((Buffer->Block >= Block) && (Buffer->Block - Block < Count)) {
+      RemoveEntryList (&Buffer->HashNode);
+      RemoveEntryList (&Buffer->ListNode);
+      Transaction->NumBuffers--;
+      FreePool (Buffer);
+    }
+  }
+
+  Ext4InvalidateBlocks (Partition, Block, Count);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Checks if a block was freed by the running transaction, and can't be reused yet.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in]      Block          Block number.
+   @param[out]     End            If the block was freed, the block after the end of the
+                                  freed range it's in.
+
+   @return TRUE if the block was freed by the running transaction.
+**/
+BOOLEAN
+Ext4BlockWasFreed (
+  IN  CONST EXT4_PARTITION  *Partition,
+  IN  EXT4_BLOCK_NR         Block,
+  OUT EXT4_BLOCK_NR         *End
+  )
+{
+  CONST EXT4_TRANSACTION  *Transaction;
+  UINTN                   Index;
+
+  Transaction = Partition->Transaction;
+
+  if (Transaction == NULL) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < Transaction->NumFreed; Index++) {
+    if ((Block >= Transaction->Freed[Index].Start) &&
+        (Block - Transaction->Freed[Index].Start < Transaction->Freed[Index].Count))
+    {
+      *End = Transaction->Freed[Index].Start + Transaction->Freed[Index].Count;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+   Marks the in-memory superblock as modified by the running transaction.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4DirtySuperblock (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  ASSERT (Partition->Transaction != NULL);
+  Partition->Transaction->SuperblockDirty = TRUE;
+}
+
+/**
+   Applies the running transaction's changes to data read from the disk.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Buffer         Pointer to the data.
+   @param[in]      Length         Length of the data.
+   @param[in]      Offset         Offset, in bytes, of the data on the disk.
+**/
+VOID
+Ext4TransactionOverlay (
+  IN     CONST EXT4_PARTITION  *Partition,
+  IN OUT VOID                  *Buffer,
+  IN     UINTN                 Length,
+  IN     UINT64                Offset
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+  EXT4_BUFFER       *Modified;
+  LIST_ENTRY        *Node;
+  EXT4_BLOCK_NR     Block;
+  EXT4_BLOCK_NR     LastBlock;
+  UINT64            BlockStart;
+  UINT64            CopyStart;
+  UINT64            CopyEnd;
+
+  Transaction = Partition->Transaction;
+
+  if ((Transaction == NULL) || (Transaction->NumBuffers == 0) || (Length == 0)) {
+    return;
+  }
+
+  Block     = DivU64x32 (Offset, Partition->BlockSize);
+  LastBlock = DivU64x32 (Offset + Length - 1, Partition->BlockSize);
+
+  // Big reads are better off walking the (sorted) list of modified blocks
+  // than looking every block up.
+  if (LastBlock - Block >= Transaction->NumBuffers) {
+    Node = GetFirstNode (&Transaction->Buffers);
+    Modified = NULL;
+  } else {
+    Node     = NULL;
+    Modified = Ext4TransactionFind (Transaction, Block);
+  }
+
+  while (Block <= LastBlock) {
+    if (Node != NULL) {
+      if (Node == &Transaction->Buffers) {
+        break;
+      }
+
+      Modified = EXT4_BUFFER_FROM_LIST_NODE (Node);
+      Node     = GetNextNode (&Transaction->Buffers, Node);
+
+      if (Modified->Block < Block) {
+        continue;
+      }
+
+      if (Modified->Block > LastBlock) {
+        break;
+      }
+
+      Block = Modified->Block;
+    }
+
+    if (Modified != NULL) {
+      BlockStart = MultU64x32 (Block, Partition->BlockSize);
+      CopyStart  = MAX (BlockStart, Offset);
+      CopyEnd    = MIN (BlockStart + Partition->BlockSize, Offset + Length);
+
+      CopyMem (
+        (UINT8 *)Buffer + (CopyStart - Offset),
+        (UINT8 *)EXT4_BUFFER_DATA (Modified) + (CopyStart - BlockStart),
+        (UINTN)(CopyEnd - CopyStart)
+        );
+    }
+
+    Block++;
+
+    if ((Node == NULL) && (Block <= LastBlock)) {
+      Modified = Ext4TransactionFind (Transaction, Block);
+    }
+  }
+}
+
+/**
+   Writes the in-memory superblock to the running transaction, if it was modified.
+   With a journal, the copy that's written says it needs recovery: the transaction is
+   written to its final location before the journal is marked empty, and a crash in
+   between must still get it replayed.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @return Status of getting the superblock's block ready to be modified.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteSuperblockToTransaction (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EFI_STATUS       Status;
+  UINT8            *Data;
+  EXT4_SUPERBLOCK  *Sb;
+
+  if (!Partition->Transaction->SuperblockDirty) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4ModifyBlock (
+             Partition,
+             EXT4_SUPERBLOCK_OFFSET / Partition->BlockSize,
+             FALSE,
+             (VOID **)&Data
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Sb = (EXT4_SUPERBLOCK *)(Data + EXT4_SUPERBLOCK_OFFSET % Partition->BlockSize);
+
+  Ext4UpdateSuperblockChecksum (Partition, &Partition->SuperBlock);
+  CopyMem (Sb, &Partition->SuperBlock, sizeof (EXT4_SUPERBLOCK));
+
+  if (Partition->Journal != NULL) {
+    Sb->s_feature_incompat |= EXT4_FEATURE_INCOMPAT_RECOVER;
+    Ext4UpdateSuperblockChecksum (Partition, Sb);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes the running transaction's blocks to their final location on the disk.
+   Adjacent blocks are merged into a single write.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @return Status of the writes.
+**/
+STATIC
+EFI_STATUS
+Ext4CheckpointTransaction (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+  LIST_ENTRY        *Node;
+  EXT4_BUFFER       *Buffer;
+  UINT8             *Run;
+  UINTN             MaxRunBlocks;
+  UINTN             RunBlocks;
+  EXT4_BLOCK_NR     RunStart;
+  EFI_STATUS        Status;
+
+  Transaction  = Partition->Transaction;
+  MaxRunBlocks = MAX (EXT4_TRANSACTION_MAX_RUN / Partition->BlockSize, 1);
+  Run          = AllocatePool (MaxRunBlocks * Partition->BlockSize);
+
+  if (Run == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  RunBlocks = 0;
+  RunStart  = 0;
+  Status    = EFI_SUCCESS;
+
+  for (Node = GetFirstNode (&Transaction->Buffers); ; Node = GetNextNode (&Transaction->Buffers, Node)) {
+    Buffer = (Node != &Transaction->Buffers) ? EXT4_BUFFER_FROM_LIST_NODE (Node) : NULL;
+
+    // Flush the run when it can't grow anymore
+    if ((RunBlocks != 0) &&
+        ((Buffer == NULL) || (Buffer->Block != RunStart + RunBlocks) || (RunBlocks == MaxRunBlocks)))
+    {
+      Status = Ext4WriteDiskIoCached (
+                 Partition,
+                 Run,
+                 RunBlocks * Partition->BlockSize,
+                 MultU64x32 (RunStart, Partition->BlockSize)
+                 );
+
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      RunBlocks = 0;
+    }
+
+    if (Buffer == NULL) {
+      break;
+    }
+
+    if (RunBlocks == 0) {
+      RunStart = Buffer->Block;
+    }
+
+    CopyMem (Run + RunBlocks * Partition->BlockSize, EXT4_BUFFER_DATA (Buffer), Partition->BlockSize);
+    RunBlocks++;
+  }
+
+  FreePool (Run);
+  return Status;
+}
+
+/**
+   Throws away the metadata kept in memory, and reads it again from the disk.
+   Needed when a transaction is aborted, since the in-memory copies of the superblock,
+   the block group descriptors and the open files' inodes were modified along with it.
+   If something can't be read again, the partition is made read-only.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+STATIC
+VOID
+Ext4ReloadMetadata (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  LIST_ENTRY  *Entry;
+  EXT4_FILE   *File;
+  EXT4_INODE  *Inode;
+  EFI_STATUS  Status;
+
+  Status = Ext4ReadDiskIoCached (
+             Partition,
+             &Partition->SuperBlock,
+             sizeof (EXT4_SUPERBLOCK),
+             EXT4_SUPERBLOCK_OFFSET
+             );
+
+  if (!EFI_ERROR (Status)) {
+    Partition->FeaturesRoCompat = Partition->SuperBlock.s_feature_ro_compat;
+    Status = Ext4ReloadBlockGroupDescs (Partition);
+  }
+
+  BASE_LIST_FOR_EACH (Entry, &Partition->OpenFiles) {
+    File = EXT4_FILE_FROM_OPEN_FILES_NODE (Entry);
+
+    Ext4ResetExtentsMap (File);
+
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Status = Ext4ReadInode (Partition, File->InodeNum, &Inode);
+
+    if (!EFI_ERROR (Status)) {
+      CopyMem (File->Inode, Inode, Partition->InodeSize);
+      FreePool (Inode);
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Error %r reloading metadata, making the partition read-only\n", Status));
+    Partition->ReadOnly = TRUE;
+  }
+}
+
+/**
+   Commits the running transaction: it goes through the journal, if there's one, and is
+   then written to its final location.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS           The transaction was committed.
+   @return Status of the failed write. If the disk may have been left half updated (or
+           with the transaction in the journal), the partition is made read-only.
+**/
+STATIC
+EFI_STATUS
+Ext4CommitTransaction (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Ext4WriteSuperblockToTransaction (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Partition->Transaction->NumBuffers == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if (Partition->Journal != NULL) {
+    Status = Ext4JournalCommit (Partition);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  } else {
+    // Without a journal, at least make sure the metadata never points at data that
+    // isn't on the disk.
+    Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Status = Ext4CheckpointTransaction (Partition);
+
+  if (!EFI_ERROR (Status) && (Partition->Journal != NULL)) {
+    Status = Partition->BlockIo->FlushBlocks (Partition->BlockIo);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4JournalCheckpointed (Partition);
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    // With a journal, the transaction gets replayed on the next mount.
+    DEBUG ((DEBUG_ERROR, "[ext4] Error %r checkpointing, making the partition read-only\n", Status));
+    Partition->ReadOnly = TRUE;
+  }
+
+  return Status;
+}
+
+/**
+   Ends (a nested level of) the running transaction.
+   When the outermost level ends, the transaction is committed if all of it succeeded, and
+   aborted otherwise. Aborting it reloads the metadata kept in memory (the superblock, the
+   block group descriptors and the inodes of the open files) from the disk.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Status         Result of the work done in this level of the transaction.
+
+   @return Status if it's an error, or the result of the commit.
+**/
+EFI_STATUS
+Ext4EndTransaction (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN     EFI_STATUS      Status
+  )
+{
+  EXT4_TRANSACTION  *Transaction;
+
+  Transaction = Partition->Transaction;
+  ASSERT (Transaction != NULL);
+
+  if (EFI_ERROR (Status)) {
+    Transaction->Failed = TRUE;
+  }
+
+  if (--Transaction->Depth != 0) {
+    return Status;
+  }
+
+  if (Transaction->Failed) {
+    // A nested part failed, even if the caller carried on
+    if (!EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+    }
+  } else {
+    Status = Ext4CommitTransaction (Partition);
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Error %r committing transaction\n", Status));
+      Transaction->Failed = TRUE;
+    }
+  }
+
+  Partition->Transaction = NULL;
+
+  if (Transaction->Failed) {
+    Ext4FreeTransaction (Transaction);
+    Ext4ReloadMetadata (Partition);
+  } else {
+    Ext4FreeTransaction (Transaction);
+  }
+
+  return Status;
+}
@@ -0,0 +1,125 @@
+/** @file
+  Host benchmark for Ext4Dxe's CRC32c implementations.
+
+  Reports the throughput of every implementation the CPU supports, for
+  buffers the size of the metadata the driver checksums (inodes, block group
+  descriptors, directory and extent blocks) and for larger ones.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Crc32cHostSupport.h"
+
+// Each measurement runs for at least this long
+#define CRC32C_BENCH_MIN_NS  (200ULL * 1000 * 1000)
+
+#define CRC32C_BENCH_MAX_LENGTH  SIZE_64KB
+
+STATIC CONST UINTN  mLengths[] = { 32, 128, 256, 1024, 4096, CRC32C_BENCH_MAX_LENGTH };
+
+// Keep the buffer misaligned by one, like a field in the middle of a structure
+STATIC UINT8  mBuffer[CRC32C_BENCH_MAX_LENGTH + 1];
+
+/**
+   Reads the host clock.
+
+   @return Current time, in nanoseconds.
+**/
+STATIC
+UINT64
+Crc32cBenchGetTimeNs (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+/**
+   Measures the throughput of an implementation.
+
+   @param[in]      Implementation  Pointer to the implementation.
+   @param[in]      Buffer          Pointer to the data.
+   @param[in]      Length          Length of the data.
+
+   @return Throughput, in MiB/s.
+**/
+STATIC
+double
+Crc32cBenchMeasure (
+  IN CONST CRC32C_HOST_IMPLEMENTATION  *Implementation,
+  IN CONST UINT8                       *Buffer,
+  IN UINTN                             Length
+  )
+{
+  volatile UINT32  Sink;
+  UINT64           Start;
+  UINT64           Elapsed;
+  UINT64           Iterations;
+  UINT64           Index;
+
+  Sink       = 0;
+  Iterations = 1;
+
+  // Double the iterations until the measurement takes long enough
+  while (TRUE) {
+    Start = Crc32cBenchGetTimeNs ();
+
+    for (Index = 0; Index < Iterations; Index++) {
+      Sink = Implementation->Update (Sink, Buffer, Length);
+    }
+
+    Elapsed = Crc32cBenchGetTimeNs () - Start;
+
+    if (Elapsed >= CRC32C_BENCH_MIN_NS) {
+      break;
+    }
+
+    Iterations *= 2;
+  }
+
+  return (double)Iterations * Length * 1e9 / SIZE_1MB / Elapsed;
+}
+
+/**
+   Standard POSIX C entry point.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  CONST CRC32C_HOST_IMPLEMENTATION  *Implementations;
+  UINTN                             Count;
+  UINTN                             Index;
+  UINTN                             Length;
+
+  Count = Crc32cHostGetImplementations (&Implementations);
+  Crc32cHostFillBuffer (mBuffer, sizeof (mBuffer));
+
+  printf ("%-12s", "bytes");
+  for (Index = 0; Index < Count; Index++) {
+    printf ("%14s", Implementations[Index].Name);
+  }
+
+  printf ("   (MiB/s)\n");
+
+  for (Length = 0; Length < ARRAY_SIZE (mLengths); Length++) {
+    printf ("%-12u", (UINT32)mLengths[Length]);
+
+    for (Index = 0; Index < Count; Index++) {
+      printf ("%14.1f", Crc32cBenchMeasure (&Implementations[Index], mBuffer + 1, mLengths[Length]));
+    }
+
+    printf ("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+/** @file
+  Access to Ext4Dxe's CRC32c implementations, for the host based tests and
+  benchmark. Crc32c.c is included directly, so that its STATIC
+  implementations can be called.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "Crc32cHostSupport.h"
+
+#include "../Crc32c.c"
+
+STATIC CRC32C_HOST_IMPLEMENTATION  mImplementations[3];
+
+/**
+   Updates a (non-inverted) CRC32c one byte at a time.
+
+   @param[in]      Crc           Current value of the CRC.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @return The updated CRC.
+**/
+STATIC
+UINT32
+EFIAPI
+Crc32cHostUpdateBytes (
+  IN UINT32       Crc,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  return Crc32cUpdateBytes (Crc, Buffer, Length);
+}
+
+/**
+   Gets the CRC32c implementations the CPU supports.
+
+   @param[out]     Implementations  Pointer to the array of implementations.
+
+   @return Number of implementations.
+**/
+UINTN
+Crc32cHostGetImplementations (
+  OUT CONST CRC32C_HOST_IMPLEMENTATION  **Implementations
+  )
+{
+  UINTN  Count;
+
+  // CalculateCrc32c only sets these up when there's no CRC32c instruction
+  Crc32cInitializeSliceTables ();
+
+  Count = 0;
+
+  mImplementations[Count].Name     = "bytewise";
+  mImplementations[Count++].Update = Crc32cHostUpdateBytes;
+  mImplementations[Count].Name     = "slice-by-8";
+  mImplementations[Count++].Update = Crc32cUpdateSlice8;
+
+ #if defined (MDE_CPU_X64)
+  if (Crc32cSse42IsSupported ()) {
+    mImplementations[Count].Name     = "SSE4.2";
+    mImplementations[Count++].Update = Crc32cSse42;
+  }
+
+ #elif defined (MDE_CPU_AARCH64) && defined (__GNUC__)
+  if (Crc32cArm64IsSupported ()) {
+    mImplementations[Count].Name     = "ARMv8";
+    mImplementations[Count++].Update = Crc32cArm64;
+  }
+
+ #endif
+
+  *Implementations = mImplementations;
+  return Count;
+}
+
+/**
+   Fills a buffer with pseudo-random bytes, the same ones on every run.
+
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+**/
+VOID
+Crc32cHostFillBuffer (
+  OUT UINT8  *Buffer,
+  IN  UINTN  Length
+  )
+{
+  UINT32  State;
+
+  State = 0x2545F491;
+
+  while (Length-- != 0) {
+    // xorshift32
+    State      ^= State << 13;
+    State      ^= State >> 17;
+    State      ^= State << 5;
+    *(Buffer++) = (UINT8)State;
+  }
+}
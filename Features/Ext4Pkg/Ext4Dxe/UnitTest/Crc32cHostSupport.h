@@ -0,0 +1,78 @@
+/** @file
+  Access to Ext4Dxe's CRC32c implementations, for the host based tests and
+  benchmark.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef CRC32C_HOST_SUPPORT_H_
+#define CRC32C_HOST_SUPPORT_H_
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+/**
+   Updates a (non-inverted) CRC32c with the contents of a buffer.
+
+   @param[in]      Crc           Current value of the CRC.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @return The updated CRC.
+**/
+typedef
+UINT32
+(EFIAPI *CRC32C_HOST_UPDATE)(
+  IN UINT32       Crc,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  );
+
+typedef struct {
+  CONST CHAR8           *Name;
+  CRC32C_HOST_UPDATE    Update;
+} CRC32C_HOST_IMPLEMENTATION;
+
+/**
+   Gets the CRC32c implementations the CPU supports.
+
+   @param[out]     Implementations  Pointer to the array of implementations.
+
+   @return Number of implementations.
+**/
+UINTN
+Crc32cHostGetImplementations (
+  OUT CONST CRC32C_HOST_IMPLEMENTATION  **Implementations
+  );
+
+/**
+   Fills a buffer with pseudo-random bytes, the same ones on every run.
+
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+**/
+VOID
+Crc32cHostFillBuffer (
+  OUT UINT8  *Buffer,
+  IN  UINTN  Length
+  );
+
+/**
+   Calculates the CRC32c checksum of the given buffer, the way the driver does.
+
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+   @param[in]      InitialValue  Initial value of the CRC.
+
+   @return The CRC32c checksum.
+**/
+UINT32
+CalculateCrc32c (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length,
+  IN UINT32      InitialValue
+  );
+
+#endif
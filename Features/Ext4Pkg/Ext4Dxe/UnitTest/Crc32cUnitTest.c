@@ -0,0 +1,262 @@
+/** @file
+  Host based unit tests for Ext4Dxe's CRC32c implementations.
+
+  Every implementation the CPU supports (bytewise, slice-by-8, SSE4.2 and
+  ARMv8) is checked against a bit at a time reference, at every alignment
+  and at odd lengths. Crc32c.c is included directly, so that its STATIC
+  implementations can be called.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/UnitTestLib.h>
+#include <Library/DebugLib.h>
+
+#include "Crc32cHostSupport.h"
+
+#define UNIT_TEST_NAME     "Ext4Dxe CRC32c Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+// Largest length checked, and the buffer size (with room to misalign it)
+#define CRC32C_TEST_MAX_LENGTH   4099
+#define CRC32C_TEST_BUFFER_SIZE  (CRC32C_TEST_MAX_LENGTH + 16)
+
+// Lengths checked past the small ones, which are all checked
+#define CRC32C_TEST_SMALL_LENGTHS  300
+
+STATIC CONST UINTN  mLargeLengths[] = { 511, 512, 513, 1021, 1024, 4095, 4096, CRC32C_TEST_MAX_LENGTH };
+
+STATIC UINT8  mBuffer[CRC32C_TEST_BUFFER_SIZE];
+
+/**
+   Updates a (non-inverted) CRC32c one bit at a time, straight from the
+   definition of the polynomial.
+
+   @param[in]      Crc           Current value of the CRC.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+
+   @return The updated CRC.
+**/
+STATIC
+UINT32
+Crc32cTestReference (
+  IN UINT32       Crc,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINTN  Bit;
+
+  while (Length-- != 0) {
+    Crc ^= *(Buffer++);
+
+    for (Bit = 0; Bit < 8; Bit++) {
+      // Reflected Castagnoli polynomial
+      Crc = (Crc >> 1) ^ (((Crc & 1) != 0) ? 0x82F63B78 : 0);
+    }
+  }
+
+  return Crc;
+}
+
+/**
+   Checks an implementation against the reference.
+
+   @param[in]      Implementation  Pointer to the implementation.
+   @param[in]      Length          Length of the data.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+Crc32cTestLength (
+  IN CONST CRC32C_HOST_IMPLEMENTATION  *Implementation,
+  IN UINTN                             Length
+  )
+{
+  UINTN   Align;
+  UINT32  Seed;
+  UINT32  Expected;
+
+  for (Align = 0; Align < 16; Align++) {
+    // Vary the initial value too, so a CRC that ignores it doesn't pass
+    Seed     = 0x12345678 * (UINT32)(Align + 1);
+    Expected = Crc32cTestReference (Seed, mBuffer + Align, Length);
+
+    if (Implementation->Update (Seed, mBuffer + Align, Length) != Expected) {
+      UT_LOG_ERROR ("%a: mismatch at alignment %u, length %u\n", Implementation->Name, (UINT32)Align, (UINT32)Length);
+      return UNIT_TEST_ERROR_TEST_FAILED;
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks every supported implementation against the reference, at every
+   alignment, for all small lengths and a few larger ones.
+
+   @param[in]      Context       Unused.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Crc32cTestImplementations (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CRC32C_HOST_IMPLEMENTATION  *Implementations;
+  UINTN                             Count;
+  UINTN                             Index;
+  UINTN                             Length;
+  UNIT_TEST_STATUS                  Result;
+
+  Count = Crc32cHostGetImplementations (&Implementations);
+
+  // The bytewise and slice-by-8 implementations work everywhere
+  UT_ASSERT_TRUE (Count >= 2);
+
+  for (Index = 0; Index < Count; Index++) {
+    UT_LOG_INFO ("Checking %a\n", Implementations[Index].Name);
+
+    for (Length = 0; Length <= CRC32C_TEST_SMALL_LENGTHS; Length++) {
+      Result = Crc32cTestLength (&Implementations[Index], Length);
+      UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+    }
+
+    for (Length = 0; Length < ARRAY_SIZE (mLargeLengths); Length++) {
+      Result = Crc32cTestLength (&Implementations[Index], mLargeLengths[Length]);
+      UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that a CRC can be calculated in pieces, split at any point.
+
+   @param[in]      Context       Unused.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Crc32cTestSplit (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CRC32C_HOST_IMPLEMENTATION  *Implementations;
+  UINTN                             Count;
+  UINTN                             Index;
+  UINTN                             Split;
+  UINT32                            Expected;
+  UINT32                            Crc;
+
+  Count    = Crc32cHostGetImplementations (&Implementations);
+  Expected = Crc32cTestReference (0xFFFFFFFF, mBuffer + 3, 100);
+
+  for (Index = 0; Index < Count; Index++) {
+    for (Split = 0; Split <= 100; Split++) {
+      Crc = Implementations[Index].Update (0xFFFFFFFF, mBuffer + 3, Split);
+      Crc = Implementations[Index].Update (Crc, mBuffer + 3 + Split, 100 - Split);
+      UT_ASSERT_EQUAL (Crc, Expected);
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks CalculateCrc32c, which the driver uses, against known values.
+
+   @param[in]      Context       Unused.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Crc32cTestKnownValues (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8  Zeroes[32];
+
+  // The standard check value, and the iSCSI test vector (RFC 3720, B.4)
+  UT_ASSERT_EQUAL (CalculateCrc32c ("123456789", 9, 0), 0xE3069283);
+
+  ZeroMem (Zeroes, sizeof (Zeroes));
+  UT_ASSERT_EQUAL (CalculateCrc32c (Zeroes, sizeof (Zeroes), 0), 0x8A9136AA);
+
+  // Calculating in pieces, the way the driver chains checksums
+  UT_ASSERT_EQUAL (CalculateCrc32c ("56789", 5, CalculateCrc32c ("1234", 4, 0)), 0xE3069283);
+
+  UT_ASSERT_EQUAL (CalculateCrc32c (mBuffer + 1, 1000, 0), ~Crc32cTestReference (0xFFFFFFFF, mBuffer + 1, 1000));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Sets up and runs the unit tests.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Crc32cHostFillBuffer (mBuffer, sizeof (mBuffer));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "CRC32c", "Ext4Dxe.Crc32c", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Known values", "KnownValues", Crc32cTestKnownValues, NULL, NULL, NULL);
+  AddTestCase (Suite, "Implementations match the reference", "Implementations", Crc32cTestImplementations, NULL, NULL, NULL);
+  AddTestCase (Suite, "Split calculations", "Split", Crc32cTestSplit, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+   Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
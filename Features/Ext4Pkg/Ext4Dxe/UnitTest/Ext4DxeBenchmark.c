@@ -0,0 +1,441 @@
+/** @file
+  Host benchmark for Ext4Dxe.
+
+  Reports how long a mount takes, how long opening a file takes, how fast
+  directories can be listed and how fast files can be read sequentially.
+  Each image given on the command line is benchmarked; these are meant to be
+  made by mke2fs, e.g.:
+
+    mke2fs -t ext4 -d <directory with the test files> ext4.img 512M
+
+  Without any arguments, an image made by Ext4ImageBuilder is used instead.
+
+  Files called large.bin and fragmented.bin at the root of the image are also
+  read on their own, to compare sequential read throughput on a contiguous
+  and a fragmented file. A fragmented file can be made on a mounted image by
+  e.g. appending to it a little at a time while other files grow. With the
+  built-in image, which lives in memory, the number of disk reads tells more
+  than the throughput does.
+
+  Everything is measured twice: once right after mounting (so the driver's
+  caches are cold, though the host's page cache may not be) and once more
+  on the same mount.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <stdio.h>
+
+#include "Ext4HostSupport.h"
+#include "Ext4ImageBuilder.h"
+
+#define EXT4_BENCH_MOUNTS      20
+#define EXT4_BENCH_READ_CHUNK  SIZE_1MB
+#define EXT4_BENCH_MAX_DEPTH   32
+
+// Large enough for any file's EFI_FILE_INFO
+#define EXT4_BENCH_INFO_SIZE  (SIZE_OF_EFI_FILE_INFO + (EXT4_NAME_MAX + 1) * sizeof (CHAR16))
+
+// Geometry of the built-in image: 4KiB blocks, 128MiB
+#define EXT4_BENCH_BLOCK_SIZE     4096
+#define EXT4_BENCH_NUMBER_BLOCKS  32768
+#define EXT4_BENCH_NUMBER_INODES  4096
+#define EXT4_BENCH_SMALL_FILES    2000
+#define EXT4_BENCH_LARGE_FILE     (64 * SIZE_1MB)
+
+// fragmented.bin in the built-in image: 32KiB extents, with a free block between
+// each of them (1024 extents, so an extent tree one level deep)
+#define EXT4_BENCH_FRAGMENTED_FILE    (32 * SIZE_1MB)
+#define EXT4_BENCH_FRAGMENT_BLOCKS    8
+#define EXT4_BENCH_FILE_READS         5
+
+typedef struct {
+  UINT64    Entries;
+  UINT64    ReadDirNs;
+
+  UINT64    Opens;
+  UINT64    OpenNs;
+
+  UINT64    Bytes;
+  UINT64    ReadNs;
+} EXT4_BENCH_STATS;
+
+STATIC UINT8  *mReadBuffer;
+
+/**
+   Reads a file from start to end.
+
+   @param[in]      File          Pointer to the file.
+   @param[in out]  Stats         Statistics to update.
+**/
+STATIC
+VOID
+Ext4BenchReadFile (
+  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT EXT4_BENCH_STATS   *Stats
+  )
+{
+  UINT64      Start;
+  UINTN       Length;
+  EFI_STATUS  Status;
+
+  Start = Ext4HostGetTimeNs ();
+
+  do {
+    Length = EXT4_BENCH_READ_CHUNK;
+    Status = File->Read (File, &Length, mReadBuffer);
+    if (EFI_ERROR (Status)) {
+      fprintf (stderr, "read failed\n");
+      break;
+    }
+
+    Stats->Bytes += Length;
+  } while (Length != 0);
+
+  Stats->ReadNs += Ext4HostGetTimeNs () - Start;
+}
+
+/**
+   Lists a directory and opens every entry in it, recursively.
+   Regular files are read in full.
+
+   @param[in]      Dir           Pointer to the directory.
+   @param[in]      Depth         How deep Dir is in the directory tree.
+   @param[in out]  Stats         Statistics to update.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4BenchWalkDir (
+  IN     EFI_FILE_PROTOCOL  *Dir,
+  IN     UINTN              Depth,
+  IN OUT EXT4_BENCH_STATS   *Stats
+  )
+{
+  EFI_FILE_PROTOCOL  *Child;
+  EFI_FILE_INFO      *Info;
+  UINT64             Start;
+  UINTN              Length;
+  EFI_STATUS         Status;
+
+  Info = AllocatePool (EXT4_BENCH_INFO_SIZE);
+  if (Info == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  while (TRUE) {
+    Length = EXT4_BENCH_INFO_SIZE;
+    Start  = Ext4HostGetTimeNs ();
+    Status = Dir->Read (Dir, &Length, Info);
+    Stats->ReadDirNs += Ext4HostGetTimeNs () - Start;
+
+    if (EFI_ERROR (Status) || (Length == 0)) {
+      break;
+    }
+
+    Stats->Entries++;
+
+    Start  = Ext4HostGetTimeNs ();
+    Status = Dir->Open (Dir, &Child, Info->FileName, EFI_FILE_MODE_READ, 0);
+    Stats->OpenNs += Ext4HostGetTimeNs () - Start;
+
+    if (EFI_ERROR (Status)) {
+      // Symlinks and special files can't be opened
+      if (Status == EFI_ACCESS_DENIED) {
+        continue;
+      }
+
+      break;
+    }
+
+    Stats->Opens++;
+
+    if ((Info->Attribute & EFI_FILE_DIRECTORY) == 0) {
+      Ext4BenchReadFile (Child, Stats);
+    } else if (Depth < EXT4_BENCH_MAX_DEPTH) {
+      Status = Ext4BenchWalkDir (Child, Depth + 1, Stats);
+    }
+
+    Child->Close (Child);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  FreePool (Info);
+  return Status;
+}
+
+/**
+   Prints the results of one walk over the filesystem.
+
+   @param[in]      Name          Name of the walk.
+   @param[in]      Stats         Statistics of the walk.
+**/
+STATIC
+VOID
+Ext4BenchReport (
+  IN CONST CHAR8             *Name,
+  IN CONST EXT4_BENCH_STATS  *Stats
+  )
+{
+  printf ("  %s:\n", Name);
+  printf (
+    "    readdir:  %llu entries, %.0f entries/s\n",
+    (unsigned long long)Stats->Entries,
+    Stats->ReadDirNs != 0 ? Stats->Entries * 1e9 / Stats->ReadDirNs : 0.0
+    );
+  printf (
+    "    open:     %llu files, %.2f us per open\n",
+    (unsigned long long)Stats->Opens,
+    Stats->Opens != 0 ? Stats->OpenNs / 1e3 / Stats->Opens : 0.0
+    );
+  printf (
+    "    read:     %.1f MiB, %.1f MiB/s\n",
+    Stats->Bytes / (double)SIZE_1MB,
+    Stats->ReadNs != 0 ? Stats->Bytes * 1e9 / SIZE_1MB / Stats->ReadNs : 0.0
+    );
+}
+
+/**
+   Reads a file at the root of the filesystem a few times, and reports its read
+   throughput. Files that don't exist are skipped.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      Disk          Pointer to the disk.
+   @param[in]      Path          Path of the file.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4BenchReadPath (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_HOST_DISK  *Disk,
+  IN CONST CHAR8     *Path
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EXT4_BENCH_STATS   Stats;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  ZeroMem (&Stats, sizeof (Stats));
+  Disk->ReadCalls = 0;
+
+  for (Index = 0; Index < EXT4_BENCH_FILE_READS; Index++) {
+    Status = Ext4HostOpen (Partition, Path, EFI_FILE_MODE_READ, &File);
+    if (Status == EFI_NOT_FOUND) {
+      return EFI_SUCCESS;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Ext4BenchReadFile (File, &Stats);
+    File->Close (File);
+  }
+
+  printf (
+    "  %s:\n    read:     %.1f MiB, %.1f MiB/s, %.1f disk reads per pass\n",
+    Path,
+    Stats.Bytes / (double)SIZE_1MB / EXT4_BENCH_FILE_READS,
+    Stats.ReadNs != 0 ? Stats.Bytes * 1e9 / SIZE_1MB / Stats.ReadNs : 0.0,
+    Disk->ReadCalls / (double)EXT4_BENCH_FILE_READS
+    );
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Benchmarks a disk.
+
+   @param[in]      Name          Name of the disk, to report.
+   @param[in]      Disk          Pointer to the disk.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4BenchDisk (
+  IN CONST CHAR8     *Name,
+  IN EXT4_HOST_DISK  *Disk
+  )
+{
+  EXT4_PARTITION     *Partition;
+  EFI_FILE_PROTOCOL  *Root;
+  EXT4_BENCH_STATS   Stats;
+  UINT64             Start;
+  UINT64             MountNs;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  printf ("%s (%llu MiB):\n", Name, (unsigned long long)(Disk->Size / SIZE_1MB));
+
+  MountNs = 0;
+  for (Index = 0; Index < EXT4_BENCH_MOUNTS; Index++) {
+    Start  = Ext4HostGetTimeNs ();
+    Status = Ext4HostMount (Disk, &Partition);
+    MountNs += Ext4HostGetTimeNs () - Start;
+
+    if (EFI_ERROR (Status)) {
+      fprintf (stderr, "%s: mount failed\n", Name);
+      return Status;
+    }
+
+    Ext4UnmountAndFreePartition (Partition);
+  }
+
+  printf ("  mount:    %.2f us\n", MountNs / 1e3 / EXT4_BENCH_MOUNTS);
+
+  Status = Ext4HostMount (Disk, &Partition);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < 2; Index++) {
+    ZeroMem (&Stats, sizeof (Stats));
+    Disk->ReadCalls = 0;
+    Disk->ReadBytes = 0;
+
+    Status = Ext4HostOpen (Partition, "", EFI_FILE_MODE_READ, &Root);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Status = Ext4BenchWalkDir (Root, 0, &Stats);
+    Root->Close (Root);
+
+    if (EFI_ERROR (Status)) {
+      fprintf (stderr, "%s: walk failed\n", Name);
+      break;
+    }
+
+    Ext4BenchReport (Index == 0 ? "cold" : "warm", &Stats);
+    printf (
+      "    disk:     %llu reads, %.1f MiB\n",
+      (unsigned long long)Disk->ReadCalls,
+      Disk->ReadBytes / (double)SIZE_1MB
+      );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4BenchReadPath (Partition, Disk, "large.bin");
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4BenchReadPath (Partition, Disk, "fragmented.bin");
+  }
+
+  Ext4UnmountAndFreePartition (Partition);
+  return Status;
+}
+
+/**
+   Builds the image used when none is given: a directory with many small files,
+   a large file and a fragmented one.
+
+   @param[out]     Builder       Pointer to the image builder.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4BenchBuildImage (
+  OUT EXT4_IMAGE_BUILDER  **Builder
+  )
+{
+  EXT4_INO_NR  Dir;
+  CHAR8        Name[16];
+  UINTN        Index;
+  EFI_STATUS   Status;
+
+  Status = Ext4ImageCreate (EXT4_BENCH_BLOCK_SIZE, EXT4_BENCH_NUMBER_BLOCKS, EXT4_BENCH_NUMBER_INODES, Builder);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ImageAddFile (*Builder, EXT4_ROOT_INODE_NR, "large.bin", EXT4_BENCH_LARGE_FILE, NULL);
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFragmentedFile (
+               *Builder,
+               EXT4_ROOT_INODE_NR,
+               "fragmented.bin",
+               EXT4_BENCH_FRAGMENTED_FILE,
+               EXT4_BENCH_FRAGMENT_BLOCKS,
+               EXT4_IMAGE_FRAGMENT_GAPS,
+               NULL
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirectory (*Builder, EXT4_ROOT_INODE_NR, "small", &Dir);
+  }
+
+  for (Index = 0; Index < EXT4_BENCH_SMALL_FILES && !EFI_ERROR (Status); Index++) {
+    snprintf (Name, sizeof (Name), "file%04u", (UINT32)Index);
+    Status = Ext4ImageAddFile (*Builder, Dir, Name, (Index % 16) * 512, NULL);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageFinish (*Builder);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Ext4ImageFree (*Builder);
+  }
+
+  return Status;
+}
+
+/**
+   Standard POSIX C entry point.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  EXT4_IMAGE_BUILDER  *Builder;
+  EXT4_HOST_DISK      *Disk;
+  int                 Index;
+  EFI_STATUS          Status;
+
+  mReadBuffer = AllocatePool (EXT4_BENCH_READ_CHUNK);
+  if (mReadBuffer == NULL) {
+    return 1;
+  }
+
+  if (argc < 2) {
+    Status = Ext4BenchBuildImage (&Builder);
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4HostCreateDisk (Builder->Image, Builder->Size, TRUE, &Disk);
+      if (!EFI_ERROR (Status)) {
+        Status = Ext4BenchDisk ("built-in image", Disk);
+        Ext4HostFreeDisk (Disk);
+      }
+
+      Ext4ImageFree (Builder);
+    }
+  } else {
+    Status = EFI_SUCCESS;
+    for (Index = 1; Index < argc && !EFI_ERROR (Status); Index++) {
+      Status = Ext4HostOpenDiskImage (argv[Index], TRUE, &Disk);
+      if (EFI_ERROR (Status)) {
+        fprintf (stderr, "%s: can't open\n", argv[Index]);
+        break;
+      }
+
+      Status = Ext4BenchDisk (argv[Index], Disk);
+      Ext4HostFreeDisk (Disk);
+    }
+  }
+
+  FreePool (mReadBuffer);
+  return EFI_ERROR (Status) ? 1 : 0;
+}
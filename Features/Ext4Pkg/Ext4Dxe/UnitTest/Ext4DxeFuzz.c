@@ -0,0 +1,336 @@
+/** @file
+  Fuzzer for Ext4Dxe's on-disk structure parsing.
+
+  Every input is treated as a disk image: it gets mounted (Ext4OpenSuperblock),
+  its directories are walked and looked up into (Ext4ReadDir, Ext4RetrieveDirent)
+  and its files are read.
+
+  With clang, define EXT4_LIBFUZZER and link with -fsanitize=fuzzer to get a
+  libFuzzer binary. Otherwise, main() replays the inputs given on the command
+  line or, without any, fuzzes an image made by Ext4ImageBuilder with random
+  byte mutations.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ext4HostSupport.h"
+#include "Ext4ImageBuilder.h"
+
+// Limits that keep a single input from running for too long
+#define EXT4_FUZZ_MAX_DEPTH    4
+#define EXT4_FUZZ_MAX_ENTRIES  256
+#define EXT4_FUZZ_MAX_READ     SIZE_64KB
+#define EXT4_FUZZ_READ_CHUNK   4096
+
+// Large enough for any file's EFI_FILE_INFO
+#define EXT4_FUZZ_INFO_SIZE  (SIZE_OF_EFI_FILE_INFO + (EXT4_NAME_MAX + 1) * sizeof (CHAR16))
+
+// Number of mutated images the stand-alone fuzzer tries
+#define EXT4_FUZZ_ITERATIONS  2000
+
+STATIC CONST CHAR16  *mLookupNames[] = {
+  L"lost+found",
+  L"LOST+FOUND",
+  L"file000",
+  L"does-not-exist",
+  L".",
+  L".."
+};
+
+/**
+   Reads a file until its end, or until EXT4_FUZZ_MAX_READ bytes.
+
+   @param[in]      File          Pointer to the file.
+**/
+STATIC
+VOID
+Ext4FuzzReadFile (
+  IN EFI_FILE_PROTOCOL  *File
+  )
+{
+  UINT8       Buffer[EXT4_FUZZ_READ_CHUNK];
+  UINTN       Length;
+  UINTN       Total;
+  EFI_STATUS  Status;
+
+  for (Total = 0; Total < EXT4_FUZZ_MAX_READ; Total += Length) {
+    Length = sizeof (Buffer);
+    Status = File->Read (File, &Length, Buffer);
+    if (EFI_ERROR (Status) || (Length == 0)) {
+      break;
+    }
+  }
+}
+
+/**
+   Opens and goes through every entry of a directory, recursively.
+
+   @param[in]      Dir           Pointer to the directory.
+   @param[in]      Info          Buffer of EXT4_FUZZ_INFO_SIZE bytes, for the entries.
+   @param[in]      Depth         How deep Dir is in the directory tree.
+**/
+STATIC
+VOID
+Ext4FuzzWalkDir (
+  IN EFI_FILE_PROTOCOL  *Dir,
+  IN EFI_FILE_INFO      *Info,
+  IN UINTN              Depth
+  )
+{
+  EFI_FILE_PROTOCOL  *Child;
+  UINTN              Length;
+  UINTN              Entries;
+  BOOLEAN            IsDir;
+  EFI_STATUS         Status;
+
+  for (Entries = 0; Entries < EXT4_FUZZ_MAX_ENTRIES; Entries++) {
+    Length = EXT4_FUZZ_INFO_SIZE;
+    Status = Dir->Read (Dir, &Length, Info);
+    if (EFI_ERROR (Status) || (Length == 0)) {
+      return;
+    }
+
+    Status = Dir->Open (Dir, &Child, Info->FileName, EFI_FILE_MODE_READ, 0);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    // Corrupt directories can have several entries with the same name, so the
+    // file we opened isn't necessarily the entry we just read
+    Length = EXT4_FUZZ_INFO_SIZE;
+    Status = Child->GetInfo (Child, &gEfiFileInfoGuid, &Length, Info);
+    if (EFI_ERROR (Status)) {
+      Child->Close (Child);
+      continue;
+    }
+
+    IsDir = (Info->Attribute & EFI_FILE_DIRECTORY) != 0;
+
+    if (!IsDir) {
+      Ext4FuzzReadFile (Child);
+    } else if (Depth < EXT4_FUZZ_MAX_DEPTH) {
+      // Info gets reused by the recursion, which is fine since we're done with it
+      Ext4FuzzWalkDir (Child, Info, Depth + 1);
+    }
+
+    Child->Close (Child);
+  }
+}
+
+/**
+   libFuzzer entry point.
+
+   @param[in]      Data          Input, used as a disk image.
+   @param[in]      Size          Size of the input, in bytes.
+
+   @return Always 0.
+**/
+int
+LLVMFuzzerTestOneInput (
+  CONST UINT8  *Data,
+  UINTN        Size
+  )
+{
+  EXT4_HOST_DISK     *Disk;
+  EXT4_PARTITION     *Partition;
+  EFI_FILE_PROTOCOL  *Root;
+  EFI_FILE_INFO      *Info;
+  EXT4_DIR_ENTRY     Entry;
+  VOID               *Buffer;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  // The disk has to be made of whole sectors, and fit a superblock
+  Size &= ~(UINTN)511;
+  if (Size < EXT4_SUPERBLOCK_OFFSET + sizeof (EXT4_SUPERBLOCK)) {
+    return 0;
+  }
+
+  Buffer = AllocateCopyPool (Size, Data);
+  if (Buffer == NULL) {
+    return 0;
+  }
+
+  Info = AllocatePool (EXT4_FUZZ_INFO_SIZE);
+
+  Status = Ext4HostCreateDisk (Buffer, Size, TRUE, &Disk);
+  if (EFI_ERROR (Status) || (Info == NULL)) {
+    goto FREE_BUFFER;
+  }
+
+  Status = Ext4HostMount (Disk, &Partition);
+  if (EFI_ERROR (Status)) {
+    goto FREE_DISK;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mLookupNames); Index++) {
+    Ext4RetrieveDirent (Partition->Root, mLookupNames[Index], Partition, &Entry);
+  }
+
+  Status = Ext4HostOpen (Partition, "", EFI_FILE_MODE_READ, &Root);
+  if (!EFI_ERROR (Status)) {
+    Ext4FuzzWalkDir (Root, Info, 0);
+    Root->Close (Root);
+  }
+
+  Ext4UnmountAndFreePartition (Partition);
+
+FREE_DISK:
+  Ext4HostFreeDisk (Disk);
+FREE_BUFFER:
+  if (Info != NULL) {
+    FreePool (Info);
+  }
+
+  FreePool (Buffer);
+  return 0;
+}
+
+#ifndef EXT4_LIBFUZZER
+
+/**
+   Runs an input from a file.
+
+   @param[in]      Path          Path of the input.
+
+   @return 0 if the input ran, 1 if it couldn't be read.
+**/
+STATIC
+int
+Ext4FuzzReplay (
+  IN CONST CHAR8  *Path
+  )
+{
+  FILE   *File;
+  UINT8  *Data;
+  long   Size;
+
+  File = fopen (Path, "rb");
+  if (File == NULL) {
+    fprintf (stderr, "%s: can't open\n", Path);
+    return 1;
+  }
+
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+
+  Data = AllocatePool (Size > 0 ? Size : 1);
+  if ((Size < 0) || (Data == NULL) || (fread (Data, 1, Size, File) != (size_t)Size)) {
+    fprintf (stderr, "%s: can't read\n", Path);
+    fclose (File);
+    if (Data != NULL) {
+      FreePool (Data);
+    }
+
+    return 1;
+  }
+
+  fclose (File);
+
+  LLVMFuzzerTestOneInput (Data, Size);
+  FreePool (Data);
+  return 0;
+}
+
+/**
+   Builds a small image to use as a seed, and fuzzes it with random mutations.
+   Corrupting random bytes mostly hits data blocks, so the mutations are weighted
+   towards the metadata at the start of the image.
+
+   @return 0 on success, 1 if the seed couldn't be built.
+**/
+STATIC
+int
+Ext4FuzzMutateSeed (
+  VOID
+  )
+{
+  EXT4_IMAGE_BUILDER  *Builder;
+  EXT4_INO_NR         Dir;
+  UINT8               *Data;
+  CHAR8               Name[32];
+  UINTN               Iteration;
+  UINTN               Mutations;
+  UINTN               Offset;
+  UINTN               Index;
+  EFI_STATUS          Status;
+
+  Status = Ext4ImageCreate (1024, 512, 64, &Builder);
+  if (EFI_ERROR (Status)) {
+    return 1;
+  }
+
+  Ext4ImageAddFile (Builder, EXT4_ROOT_INODE_NR, "file000", 3000, NULL);
+  Ext4ImageAddFragmentedFile (Builder, EXT4_ROOT_INODE_NR, "fragmented", 40 * 1024, 1, EXT4_IMAGE_FRAGMENT_GAPS | EXT4_IMAGE_FRAGMENT_HOLES, NULL);
+  Ext4ImageAddDirectory (Builder, EXT4_ROOT_INODE_NR, "dir", &Dir);
+  Ext4ImageIndexDirectory (Builder, Dir);
+  for (Index = 0; Index < 40; Index++) {
+    // Long enough names to need a few leaves
+    snprintf (Name, sizeof (Name), "indexed-file-%02u", (UINT32)Index);
+    Ext4ImageAddFile (Builder, Dir, Name, Index * 300, NULL);
+  }
+
+  Status = Ext4ImageFinish (Builder);
+  if (EFI_ERROR (Status)) {
+    Ext4ImageFree (Builder);
+    return 1;
+  }
+
+  Data = AllocatePool (Builder->Size);
+  if (Data == NULL) {
+    Ext4ImageFree (Builder);
+    return 1;
+  }
+
+  srand (0);
+
+  for (Iteration = 0; Iteration < EXT4_FUZZ_ITERATIONS; Iteration++) {
+    CopyMem (Data, Builder->Image, Builder->Size);
+
+    Mutations = 1 + rand () % 8;
+    for (Index = 0; Index < Mutations; Index++) {
+      // First 32 blocks hold the superblock, descriptors, bitmaps, inodes and directories
+      Offset       = (rand () % 4 == 0) ? rand () % Builder->Size : rand () % (32 * 1024);
+      Data[Offset] = (UINT8)rand ();
+    }
+
+    LLVMFuzzerTestOneInput (Data, Builder->Size);
+  }
+
+  printf ("%u mutated images ran\n", (UINT32)EXT4_FUZZ_ITERATIONS);
+
+  FreePool (Data);
+  Ext4ImageFree (Builder);
+  return 0;
+}
+
+/**
+   Stand-alone entry point, for when the fuzzer isn't built with libFuzzer.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  int  Index;
+  int  Result;
+
+  if (argc < 2) {
+    return Ext4FuzzMutateSeed ();
+  }
+
+  Result = 0;
+  for (Index = 1; Index < argc; Index++) {
+    Result |= Ext4FuzzReplay (argv[Index]);
+  }
+
+  return Result;
+}
+
+#endif
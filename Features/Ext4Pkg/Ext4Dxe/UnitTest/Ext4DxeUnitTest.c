@@ -0,0 +1,2196 @@
+/** @file
+  Host based unit tests for Ext4Dxe.
+
+  Each test mounts an image made by Ext4ImageBuilder, and goes through
+  EFI_FILE_PROTOCOL the way a UEFI application would.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/UnitTestLib.h>
+#include <Library/PrintLib.h>
+
+#include "Ext4HostSupport.h"
+#include "Ext4ImageBuilder.h"
+
+#define UNIT_TEST_NAME     "Ext4Dxe Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+// Number of files in the "many" directory of the test image
+#define EXT4_TEST_MANY_FILES  200
+
+// Number of files in the "indexed" directory, and the length of their names.
+// With 1KiB blocks, these need more leaves than the htree root can point to.
+#define EXT4_TEST_INDEXED_FILES        2000
+#define EXT4_TEST_INDEXED_NAME_LENGTH  60
+
+// Number of files the write tests add to the "indexed" directory
+#define EXT4_TEST_INDEXED_NEW_FILES  300
+
+// Size of "fragmented.bin" and "coalesced.bin", in blocks, and the length of their extents.
+// They have more extents than fit in the inode.
+#define EXT4_TEST_FRAGMENTED_BLOCKS  300
+#define EXT4_TEST_FRAGMENT_BLOCKS    2
+
+// Size of "prealloc.bin" and "prealloc-tree.bin", in blocks, and the length of their
+// uninitialized extents. The first has its extents in the inode, the second in a tree.
+#define EXT4_TEST_PREALLOC_BLOCKS         6
+#define EXT4_TEST_PREALLOC_EXTENT_BLOCKS  2
+#define EXT4_TEST_PREALLOC_TREE_BLOCKS    20
+
+// Time the fake real time clock reads during the write tests: 2022-03-04 05:06:07.000000123 UTC
+#define EXT4_TEST_WRITE_EPOCH        1646370367
+#define EXT4_TEST_WRITE_NANOSECONDS  123
+
+// Large enough for any file's EFI_FILE_INFO
+#define EXT4_TEST_INFO_SIZE  (SIZE_OF_EFI_FILE_INFO + (EXT4_NAME_MAX + 1) * sizeof (CHAR16))
+
+typedef struct {
+  UINT32                BlockSize;
+  UINT32                NumberBlocks;
+
+  EXT4_IMAGE_BUILDER    *Builder;
+  EXT4_HOST_DISK        *Disk;
+  EXT4_PARTITION        *Partition;
+
+  EXT4_INO_NR           SmallInode;
+  EXT4_INO_NR           EmptyInode;
+  EXT4_INO_NR           NestedInode;
+  EXT4_INO_NR           ManyInode;
+  EXT4_INO_NR           IndexedInode;
+  EXT4_INO_NR           IndexedFirstInode;
+  EXT4_INO_NR           FragmentedInode;
+  EXT4_INO_NR           CoalescedInode;
+  EXT4_INO_NR           PreallocInode;
+  EXT4_INO_NR           PreallocTreeInode;
+} EXT4_TEST_CONTEXT;
+
+/**
+   Gets the size of a file in the test image called "many/fileNNN".
+
+   @param[in]      Index         Number of the file.
+
+   @return Size of the file, in bytes.
+**/
+STATIC
+UINT64
+Ext4TestManyFileSize (
+  IN UINTN  Index
+  )
+{
+  return (Index % 7) * 100;
+}
+
+/**
+   Gets the name of a file in the test image called "indexed/<name>". Even
+   files have letters in their names, odd ones only have digits and dashes.
+
+   @param[in]      Index         Number of the file.
+   @param[out]     Name          Buffer for the name, of EXT4_TEST_INDEXED_NAME_LENGTH + 1 characters.
+**/
+STATIC
+VOID
+Ext4TestIndexedName (
+  IN  UINTN  Index,
+  OUT CHAR8  *Name
+  )
+{
+  UINTN  Length;
+
+  if ((Index % 2) == 0) {
+    Length = AsciiSPrint (Name, EXT4_TEST_INDEXED_NAME_LENGTH + 1, "entry%04u", (UINT32)Index);
+  } else {
+    Length = AsciiSPrint (Name, EXT4_TEST_INDEXED_NAME_LENGTH + 1, "%04u", (UINT32)Index);
+  }
+
+  for ( ; Length < EXT4_TEST_INDEXED_NAME_LENGTH; Length++) {
+    Name[Length] = ((Index % 2) == 0) ? 'x' : '-';
+  }
+
+  Name[Length] = '\0';
+}
+
+/**
+   Converts an ASCII name to UCS-2.
+
+   @param[in]      Name          ASCII name.
+   @param[out]     UnicodeName   Buffer for the UCS-2 name, large enough for all of Name.
+**/
+STATIC
+VOID
+Ext4TestUnicodeName (
+  IN  CONST CHAR8  *Name,
+  OUT CHAR16       *UnicodeName
+  )
+{
+  do {
+    *UnicodeName++ = (CHAR16)(UINT8)*Name;
+  } while (*Name++ != '\0');
+}
+
+/**
+   Builds the test image:
+     /small.txt          100 bytes
+     /empty              0 bytes
+     /dir/nested.bin     3 blocks and a bit
+     /many/fileNNN       EXT4_TEST_MANY_FILES files of different sizes
+     /indexed/<name>     EXT4_TEST_INDEXED_FILES empty files, in an htree directory
+     /fragmented.bin     Small extents, with holes and gaps between them
+     /coalesced.bin      Small extents, all physically contiguous
+     /prealloc.bin       Uninitialized extents, all in the inode
+     /prealloc-tree.bin  Uninitialized extents, in an extent tree
+   and mounts it.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @retval UNIT_TEST_PASSED                  The image is mounted.
+   @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  The image couldn't be built or mounted.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestMountImage (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EXT4_INO_NR        Dir;
+  CHAR8              Name[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  Status = Ext4ImageCreate (Test->BlockSize, Test->NumberBlocks, 2560, &Test->Builder);
+  if (EFI_ERROR (Status)) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  Status = Ext4ImageAddFile (Test->Builder, EXT4_ROOT_INODE_NR, "small.txt", 100, &Test->SmallInode);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFile (Test->Builder, EXT4_ROOT_INODE_NR, "empty", 0, &Test->EmptyInode);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirectory (Test->Builder, EXT4_ROOT_INODE_NR, "dir", &Dir);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFile (Test->Builder, Dir, "nested.bin", 3 * Test->BlockSize + 17, &Test->NestedInode);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirectory (Test->Builder, EXT4_ROOT_INODE_NR, "many", &Test->ManyInode);
+  }
+
+  for (Index = 0; !EFI_ERROR (Status) && Index < EXT4_TEST_MANY_FILES; Index++) {
+    AsciiSPrint (Name, sizeof (Name), "file%03u", (UINT32)Index);
+    Status = Ext4ImageAddFile (Test->Builder, Test->ManyInode, Name, Ext4TestManyFileSize (Index), NULL);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFragmentedFile (
+               Test->Builder,
+               EXT4_ROOT_INODE_NR,
+               "fragmented.bin",
+               EXT4_TEST_FRAGMENTED_BLOCKS * Test->BlockSize - 123,
+               EXT4_TEST_FRAGMENT_BLOCKS,
+               EXT4_IMAGE_FRAGMENT_GAPS | EXT4_IMAGE_FRAGMENT_HOLES,
+               &Test->FragmentedInode
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFragmentedFile (
+               Test->Builder,
+               EXT4_ROOT_INODE_NR,
+               "coalesced.bin",
+               EXT4_TEST_FRAGMENTED_BLOCKS * Test->BlockSize,
+               EXT4_TEST_FRAGMENT_BLOCKS,
+               0,
+               &Test->CoalescedInode
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFragmentedFile (
+               Test->Builder,
+               EXT4_ROOT_INODE_NR,
+               "prealloc.bin",
+               EXT4_TEST_PREALLOC_BLOCKS * Test->BlockSize - 50,
+               EXT4_TEST_PREALLOC_EXTENT_BLOCKS,
+               EXT4_IMAGE_FRAGMENT_GAPS | EXT4_IMAGE_FRAGMENT_UNWRITTEN,
+               &Test->PreallocInode
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddFragmentedFile (
+               Test->Builder,
+               EXT4_ROOT_INODE_NR,
+               "prealloc-tree.bin",
+               EXT4_TEST_PREALLOC_TREE_BLOCKS * Test->BlockSize,
+               1,
+               EXT4_IMAGE_FRAGMENT_GAPS | EXT4_IMAGE_FRAGMENT_UNWRITTEN,
+               &Test->PreallocTreeInode
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirectory (Test->Builder, EXT4_ROOT_INODE_NR, "indexed", &Test->IndexedInode);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageIndexDirectory (Test->Builder, Test->IndexedInode);
+  }
+
+  // Files get consecutive inode numbers
+  for (Index = 0; !EFI_ERROR (Status) && Index < EXT4_TEST_INDEXED_FILES; Index++) {
+    Ext4TestIndexedName (Index, Name);
+    Status = Ext4ImageAddFile (Test->Builder, Test->IndexedInode, Name, 0, (Index == 0) ? &Test->IndexedFirstInode : NULL);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageFinish (Test->Builder);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4HostCreateDisk (Test->Builder->Image, Test->Builder->Size, FALSE, &Test->Disk);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4HostMount (Test->Disk, &Test->Partition);
+  }
+
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Failed to set up the test image: %r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Unmounts and frees the test image.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+**/
+STATIC
+VOID
+EFIAPI
+Ext4TestUnmountImage (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+
+  Test = Context;
+
+  if (Test->Partition != NULL) {
+    Ext4UnmountAndFreePartition (Test->Partition);
+    Test->Partition = NULL;
+  }
+
+  if (Test->Disk != NULL) {
+    Ext4HostFreeDisk (Test->Disk);
+    Test->Disk = NULL;
+  }
+
+  if (Test->Builder != NULL) {
+    Ext4ImageFree (Test->Builder);
+    Test->Builder = NULL;
+  }
+}
+
+/**
+   Checks the geometry the driver works out from the superblock.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestMountGeometry (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+
+  Test = Context;
+
+  UT_ASSERT_EQUAL (Test->Partition->BlockSize, Test->BlockSize);
+  UT_ASSERT_EQUAL (Test->Partition->NumberBlocks, Test->NumberBlocks);
+  // A single, partial block group
+  UT_ASSERT_EQUAL (Test->Partition->NumberBlockGroups, 1);
+  UT_ASSERT_FALSE (Test->Partition->ReadOnly);
+  UT_ASSERT_NOT_NULL (Test->Partition->Root);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Reads a file in odd sized chunks, and checks its contents.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestReadFile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  UINT8              Buffer[1000];
+  UINT64             Offset;
+  UINT64             Size;
+  UINTN              Length;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Test = Context;
+  Size = 3 * Test->BlockSize + 17;
+
+  Status = Ext4HostOpen (Test->Partition, "dir/nested.bin", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Offset = 0; Offset < Size; Offset += Length) {
+    Length = sizeof (Buffer);
+    Status = File->Read (File, &Length, Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (Length, MIN (sizeof (Buffer), Size - Offset));
+
+    for (Index = 0; Index < Length; Index++) {
+      UT_ASSERT_EQUAL (Buffer[Index], Ext4ImagePatternByte (Test->NestedInode, Offset + Index));
+    }
+  }
+
+  // At the end of the file, reads succeed without reading anything
+  Length = sizeof (Buffer);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, 0);
+
+  // Reads that straddle blocks, from the middle of the file
+  Status = File->SetPosition (File, Test->BlockSize - 3);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = 6;
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, 6);
+
+  for (Index = 0; Index < Length; Index++) {
+    UT_ASSERT_EQUAL (Buffer[Index], Ext4ImagePatternByte (Test->NestedInode, Test->BlockSize - 3 + Index));
+  }
+
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "empty", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Buffer);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, 0);
+
+  File->Close (File);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Reads a whole file, in chunks of ChunkSize bytes, and checks its contents
+   against the image. Holes must read as zeroes.
+
+   @param[in]      Test          Pointer to the EXT4_TEST_CONTEXT.
+   @param[in]      Path          Path of the file.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Size          Size of the file.
+   @param[in]      ChunkSize     Size of every read.
+   @param[out]     ReadCalls     Number of disk reads the file took.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+Ext4TestReadWholeFile (
+  IN  EXT4_TEST_CONTEXT  *Test,
+  IN  CONST CHAR8        *Path,
+  IN  EXT4_INO_NR        Inode,
+  IN  UINT64             Size,
+  IN  UINTN              ChunkSize,
+  OUT UINT64             *ReadCalls
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  UINT8              *Buffer;
+  UINT8              *Expected;
+  UINT64             Offset;
+  UINTN              Length;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Buffer = AllocatePool (ChunkSize);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = Ext4HostOpen (Test->Partition, Path, EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Test->Disk->ReadCalls = 0;
+
+  for (Offset = 0; Offset < Size; Offset += Length) {
+    Length = ChunkSize;
+    Status = File->Read (File, &Length, Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (Length, MIN (ChunkSize, Size - Offset));
+
+    for (Index = 0; Index < Length; Index++) {
+      Expected = Ext4ImageFileData (Test->Builder, Inode, Offset + Index);
+      UT_ASSERT_EQUAL (Buffer[Index], (Expected != NULL) ? *Expected : 0);
+    }
+  }
+
+  *ReadCalls = Test->Disk->ReadCalls;
+
+  File->Close (File);
+  FreePool (Buffer);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Reads files made of many small extents, with a one level deep extent tree.
+   Physically contiguous extents must be read with a single disk read.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestReadFragmentedFile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT   *Test;
+  EXT4_EXTENT_HEADER  *Header;
+  UINT64              Size;
+  UINT64              ReadCalls;
+  UINT64              Extents;
+  UNIT_TEST_STATUS    Result;
+
+  Test    = Context;
+  Extents = EXT4_TEST_FRAGMENTED_BLOCKS / EXT4_TEST_FRAGMENT_BLOCKS;
+
+  Header = (EXT4_EXTENT_HEADER *)Ext4ImageInode (Test->Builder, Test->FragmentedInode)->i_data;
+  UT_ASSERT_EQUAL (Header->eh_depth, 1);
+
+  // Odd sized reads, that start and end in the middle of extents and holes
+  Size   = EXT4_TEST_FRAGMENTED_BLOCKS * Test->BlockSize - 123;
+  Result = Ext4TestReadWholeFile (Test, "fragmented.bin", Test->FragmentedInode, Size, 1000, &ReadCalls);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  // At most a read per mapped extent, and one per extent tree leaf
+  Result = Ext4TestReadWholeFile (Test, "fragmented.bin", Test->FragmentedInode, Size, (UINTN)Size, &ReadCalls);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_TRUE (ReadCalls <= Extents - Extents / 3 + 2);
+
+  // Contiguous extents are read all at once
+  Size   = EXT4_TEST_FRAGMENTED_BLOCKS * Test->BlockSize;
+  Result = Ext4TestReadWholeFile (Test, "coalesced.bin", Test->CoalescedInode, Size, (UINTN)Size, &ReadCalls);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_TRUE (ReadCalls <= 3);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Lists a directory, and checks every entry comes up exactly once.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestReadDir (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *Dir;
+  EFI_FILE_INFO      *Info;
+  BOOLEAN            Seen[EXT4_TEST_MANY_FILES];
+  UINTN              Found;
+  UINTN              Length;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Test = Context;
+  ZeroMem (Seen, sizeof (Seen));
+  Found = 0;
+
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+
+  Status = Ext4HostOpen (Test->Partition, "many", EFI_FILE_MODE_READ, &Dir);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  while (TRUE) {
+    Length = EXT4_TEST_INFO_SIZE;
+    Status = Dir->Read (Dir, &Length, Info);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    if (Length == 0) {
+      break;
+    }
+
+    // "." and ".." are never returned
+    UT_ASSERT_EQUAL (StrLen (Info->FileName), 7);
+    UT_ASSERT_MEM_EQUAL (Info->FileName, L"file", 4 * sizeof (CHAR16));
+
+    Index = (Info->FileName[4] - L'0') * 100 + (Info->FileName[5] - L'0') * 10 + (Info->FileName[6] - L'0');
+    UT_ASSERT_TRUE (Index < EXT4_TEST_MANY_FILES);
+    UT_ASSERT_FALSE (Seen[Index]);
+    UT_ASSERT_EQUAL (Info->FileSize, Ext4TestManyFileSize (Index));
+    UT_ASSERT_EQUAL (Info->Attribute & EFI_FILE_DIRECTORY, 0);
+
+    Seen[Index] = TRUE;
+    Found++;
+  }
+
+  UT_ASSERT_EQUAL (Found, EXT4_TEST_MANY_FILES);
+
+  Dir->Close (Dir);
+  FreePool (Info);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Looks names up, including ones that don't exist or differ in case.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestLookup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  Status = Ext4HostOpen (Test->Partition, "many/file123", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "MANY/FILE042", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "many/../dir/./nested.bin", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "many/file200", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  // Twice, so the negative dentry gets used
+  Status = Ext4HostOpen (Test->Partition, "many/file200", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt/file", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_TRUE (EFI_ERROR (Status));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that corrupt superblocks, and roots that aren't directories, are
+   refused instead of crashing the driver.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestCorruptSuperblock (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  UINT8              *Copy;
+  EXT4_SUPERBLOCK    *Sb;
+  EXT4_INODE         *RootInode;
+  EXT4_HOST_DISK     *Disk;
+  EXT4_PARTITION     *Partition;
+  UINTN              Corruption;
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  Copy = AllocatePool ((UINTN)Test->Builder->Size);
+  UT_ASSERT_NOT_NULL (Copy);
+
+  for (Corruption = 0; Corruption < 7; Corruption++) {
+    CopyMem (Copy, Test->Builder->Image, (UINTN)Test->Builder->Size);
+    Sb        = (EXT4_SUPERBLOCK *)(Copy + EXT4_SUPERBLOCK_OFFSET);
+    RootInode = (EXT4_INODE *)(Copy + ((UINT8 *)Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR) - Test->Builder->Image));
+
+    switch (Corruption) {
+      case 0:
+        Sb->s_log_block_size = 40;
+        break;
+      case 1:
+        Sb->s_inodes_per_group = 0;
+        break;
+      case 2:
+        Sb->s_inode_size = 100;
+        break;
+      case 3:
+        Sb->s_inode_size = (UINT16)(Test->BlockSize * 2);
+        break;
+      case 4:
+        Sb->s_first_data_block = Sb->s_blocks_count;
+        break;
+      case 5:
+        Sb->s_magic = 0;
+        break;
+      case 6:
+        // Sockets used to pass for directories
+        RootInode->i_mode = EXT4_INO_TYPE_UNIX_SOCK | 0755;
+        break;
+    }
+
+    Status = Ext4HostCreateDisk (Copy, Test->Builder->Size, TRUE, &Disk);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    Status = Ext4HostMount (Disk, &Partition);
+    if (!EFI_ERROR (Status)) {
+      Ext4UnmountAndFreePartition (Partition);
+    }
+
+    Ext4HostFreeDisk (Disk);
+
+    UT_LOG_INFO ("Corruption %u: %r\n", (UINT32)Corruption, Status);
+    UT_ASSERT_TRUE (EFI_ERROR (Status));
+  }
+
+  FreePool (Copy);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that a directory entry with a bad length is reported, instead of
+   looping or reading out of bounds.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestCorruptDirent (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *Dir;
+  EFI_FILE_INFO      *Info;
+  EXT4_DIR_ENTRY     *Entry;
+  UINTN              Length;
+  UINTN              Entries;
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  // Nothing has been read from "many" yet, so its blocks aren't cached.
+  // Break the third entry (the first one after "." and ".."); the rest of the
+  // block can't be reached without it.
+  Entry          = (EXT4_DIR_ENTRY *)Ext4ImageFileData (Test->Builder, Test->ManyInode, 0);
+  Entry          = (EXT4_DIR_ENTRY *)((UINT8 *)Entry + Entry->rec_len);
+  Entry          = (EXT4_DIR_ENTRY *)((UINT8 *)Entry + Entry->rec_len);
+  Entry->rec_len = 0;
+
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+
+  Status = Ext4HostOpen (Test->Partition, "many", EFI_FILE_MODE_READ, &Dir);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Entries = 0; Entries < 2 * EXT4_TEST_MANY_FILES; Entries++) {
+    Length = EXT4_TEST_INFO_SIZE;
+    Status = Dir->Read (Dir, &Length, Info);
+    if (EFI_ERROR (Status) || (Length == 0)) {
+      break;
+    }
+  }
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_VOLUME_CORRUPTED);
+
+  Dir->Close (Dir);
+  FreePool (Info);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that sockets and symlinks can't be opened, as they're neither
+   regular files nor directories.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestSpecialFiles (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  Ext4ImageInode (Test->Builder, Test->SmallInode)->i_mode = EXT4_INO_TYPE_UNIX_SOCK | 0644;
+  Ext4ImageInode (Test->Builder, Test->EmptyInode)->i_mode = EXT4_INO_TYPE_SYMLINK | 0777;
+
+  // Their inode table block may have been cached when the root was read, so remount
+  Ext4UnmountAndFreePartition (Test->Partition);
+  Test->Partition = NULL;
+
+  Status = Ext4HostMount (Test->Disk, &Test->Partition);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = Ext4HostOpen (Test->Partition, "empty", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that extent headers claiming more entries than fit in the inode are
+   refused, instead of being walked off the end of the inode.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestCorruptExtents (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT   *Test;
+  EFI_FILE_PROTOCOL   *File;
+  EXT4_EXTENT_HEADER  *Header;
+  UINT8               Buffer[64];
+  UINTN               Length;
+  EFI_STATUS          Status;
+
+  Test = Context;
+
+  Header             = (EXT4_EXTENT_HEADER *)Ext4ImageInode (Test->Builder, Test->NestedInode)->i_data;
+  Header->eh_max     = EXT4_INODE_EXTENT_ENTRIES + 1;
+  Header->eh_entries = EXT4_INODE_EXTENT_ENTRIES + 1;
+
+  // The inode table block may have been cached when the root was read, so remount
+  Ext4UnmountAndFreePartition (Test->Partition);
+  Test->Partition = NULL;
+
+  Status = Ext4HostMount (Test->Disk, &Test->Partition);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "dir/nested.bin", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Buffer);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_VOLUME_CORRUPTED);
+
+  File->Close (File);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Finds a name, made of a prefix padded out to EXT4_TEST_INDEXED_NAME_LENGTH,
+   whose hash is at least MinHash, so that the index puts it in a later leaf
+   than the first one.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      Format        Format of the prefix, taking a number.
+   @param[in]      Padding       Character to pad the name with.
+   @param[in]      MinHash       Smallest hash the name may have.
+   @param[out]     Name          Buffer for the name, of EXT4_TEST_INDEXED_NAME_LENGTH + 1 characters.
+**/
+STATIC
+VOID
+Ext4TestMisplacedName (
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Format,
+  IN  CHAR8           Padding,
+  IN  UINT32          MinHash,
+  OUT CHAR8           *Name
+  )
+{
+  UINT32  Number;
+  UINT32  Hash;
+  UINTN   Length;
+
+  for (Number = 9000; ; Number++) {
+    Length = AsciiSPrint (Name, EXT4_TEST_INDEXED_NAME_LENGTH + 1, Format, Number);
+    for ( ; Length < EXT4_TEST_INDEXED_NAME_LENGTH; Length++) {
+      Name[Length] = Padding;
+    }
+
+    Name[Length] = '\0';
+
+    if (!EFI_ERROR (Ext4DirHash (Partition, EXT4_DX_HASH_HALF_MD4, Name, Length, &Hash)) && (Hash >= MinHash)) {
+      return;
+    }
+  }
+}
+
+/**
+   Looks names up in a large indexed (htree) directory, with and without
+   letters to case-fold, and checks which lookups fall back to a linear scan.
+
+   To tell lookups that went through the index from those that didn't, two
+   entries of the first leaf get renamed to names that hash into a later leaf:
+   the index can't find them, but a linear scan can. Every index entry also gets
+   the top bits of its block number set, which must be ignored.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestIndexedLookup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT    *Test;
+  EFI_FILE_PROTOCOL    *DirProtocol;
+  EXT4_FILE            *Dir;
+  EFI_FILE_INFO        *Info;
+  EXT4_DX_ROOT         *Root;
+  EXT4_DX_ENTRY        *Entries;
+  EXT4_DX_ENTRY        *NodeEntries;
+  EXT4_DIR_ENTRY       *First;
+  EXT4_DIR_ENTRY       *Second;
+  EXT4_DIR_ENTRY       Entry;
+  EXT4_INO_NR          DigitsInode;
+  EXT4_INO_NR          LettersInode;
+  UINT32               FirstLeaf;
+  UINT32               NextHash;
+  UINTN                Node;
+  UINTN                Index;
+  UINTN                Length;
+  CHAR8                Name[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  CHAR8                DigitsName[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  CHAR8                LettersName[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  CHAR16               UnicodeName[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  EFI_STATUS           Status;
+
+  Test = Context;
+
+  UT_ASSERT_NOT_EQUAL (Ext4ImageInode (Test->Builder, Test->IndexedInode)->i_flags & EXT4_INDEX_FL, 0);
+
+  // With 1KiB blocks, the root points to interior nodes
+  Root    = (EXT4_DX_ROOT *)Ext4ImageFileData (Test->Builder, Test->IndexedInode, 0);
+  Entries = (EXT4_DX_ENTRY *)(Root + 1);
+  UT_ASSERT_EQUAL (Root->info.indirect_levels, (Test->BlockSize == 1024) ? 1 : 0);
+
+  NodeEntries = Entries;
+  if (Root->info.indirect_levels != 0) {
+    NodeEntries = (EXT4_DX_ENTRY *)(Ext4ImageFileData (Test->Builder, Test->IndexedInode, Entries[0].block * Test->BlockSize) + sizeof (EXT4_DX_NODE));
+  }
+
+  UT_ASSERT_TRUE (((EXT4_DX_COUNT_LIMIT *)NodeEntries)->count > 1);
+  FirstLeaf = NodeEntries[0].block;
+  NextHash  = NodeEntries[1].hash & ~1U;
+
+  // Nothing has been read from "indexed" yet, so its blocks aren't cached
+  First  = (EXT4_DIR_ENTRY *)Ext4ImageFileData (Test->Builder, Test->IndexedInode, FirstLeaf * Test->BlockSize);
+  Second = (EXT4_DIR_ENTRY *)((UINT8 *)First + First->rec_len);
+  UT_ASSERT_EQUAL (First->name_len, EXT4_TEST_INDEXED_NAME_LENGTH);
+  UT_ASSERT_EQUAL (Second->name_len, EXT4_TEST_INDEXED_NAME_LENGTH);
+
+  Ext4TestMisplacedName (Test->Partition, "%04u", '-', NextHash, DigitsName);
+  Ext4TestMisplacedName (Test->Partition, "moved%04u", 'x', NextHash, LettersName);
+  CopyMem (First->name, DigitsName, EXT4_TEST_INDEXED_NAME_LENGTH);
+  CopyMem (Second->name, LettersName, EXT4_TEST_INDEXED_NAME_LENGTH);
+  DigitsInode  = First->inode;
+  LettersInode = Second->inode;
+
+  for (Index = 0; Index < ((EXT4_DX_COUNT_LIMIT *)Entries)->count; Index++) {
+    if (Root->info.indirect_levels != 0) {
+      NodeEntries = (EXT4_DX_ENTRY *)(Ext4ImageFileData (Test->Builder, Test->IndexedInode, Entries[Index].block * Test->BlockSize) + sizeof (EXT4_DX_NODE));
+      for (Node = 0; Node < ((EXT4_DX_COUNT_LIMIT *)NodeEntries)->count; Node++) {
+        NodeEntries[Node].block |= ~(UINT32)EXT4_DX_BLOCK_MASK;
+      }
+    }
+
+    Entries[Index].block |= ~(UINT32)EXT4_DX_BLOCK_MASK;
+  }
+
+  Status = Ext4HostOpen (Test->Partition, "indexed", EFI_FILE_MODE_READ, &DirProtocol);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Dir = (EXT4_FILE *)DirProtocol;
+
+  for (Index = 0; Index < EXT4_TEST_INDEXED_FILES; Index++) {
+    if ((Test->IndexedFirstInode + Index == DigitsInode) || (Test->IndexedFirstInode + Index == LettersInode)) {
+      continue;
+    }
+
+    Ext4TestIndexedName (Index, Name);
+    Ext4TestUnicodeName (Name, UnicodeName);
+
+    Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (Entry.inode, Test->IndexedFirstInode + Index);
+
+    // Differently-cased names miss the index, and are found by the linear scan
+    if ((Index % 200) == 0) {
+      for (Length = 0; Length < EXT4_TEST_INDEXED_NAME_LENGTH; Length++) {
+        if ((Name[Length] >= 'a') && (Name[Length] <= 'z')) {
+          Name[Length] = Name[Length] - 'a' + 'A';
+        }
+      }
+
+      Ext4TestUnicodeName (Name, UnicodeName);
+
+      Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_EQUAL (Entry.inode, Test->IndexedFirstInode + Index);
+    }
+  }
+
+  // Names with letters fall back to a linear scan, names without them don't
+  Ext4TestUnicodeName (LettersName, UnicodeName);
+  Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Entry.inode, LettersInode);
+
+  Ext4TestUnicodeName (DigitsName, UnicodeName);
+  Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = Ext4RetrieveDirent (Dir, L"does-not-exist", Test->Partition, &Entry);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = Ext4RetrieveDirent (Dir, L"12345", Test->Partition, &Entry);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = Ext4RetrieveDirent (Dir, L"..", Test->Partition, &Entry);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Entry.inode, EXT4_ROOT_INODE_NR);
+
+  // Listing the directory skips the index blocks
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+
+  for (Index = 0; ; Index++) {
+    Length = EXT4_TEST_INFO_SIZE;
+    Status = DirProtocol->Read (DirProtocol, &Length, Info);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    if (Length == 0) {
+      break;
+    }
+
+    UT_ASSERT_EQUAL (StrLen (Info->FileName), EXT4_TEST_INDEXED_NAME_LENGTH);
+  }
+
+  UT_ASSERT_EQUAL (Index, EXT4_TEST_INDEXED_FILES);
+
+  FreePool (Info);
+  DirProtocol->Close (DirProtocol);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Sets the fake real time clock to EXT4_TEST_WRITE_EPOCH.
+**/
+STATIC
+VOID
+Ext4TestSetWriteTime (
+  VOID
+  )
+{
+  EFI_TIME  Time;
+
+  ZeroMem (&Time, sizeof (Time));
+  Time.Year       = 2022;
+  Time.Month      = 3;
+  Time.Day        = 4;
+  Time.Hour       = 5;
+  Time.Minute     = 6;
+  Time.Second     = 7;
+  Time.Nanosecond = EXT4_TEST_WRITE_NANOSECONDS;
+  Time.TimeZone   = EFI_UNSPECIFIED_TIMEZONE;
+
+  Ext4HostSetTime (&Time);
+}
+
+/**
+   Checks that a file of the image had its modification and change times set
+   by a write.
+
+   @param[in]      Test          Pointer to the EXT4_TEST_CONTEXT.
+   @param[in]      Inode         Inode number of the file.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+Ext4TestCheckWriteTimes (
+  IN EXT4_TEST_CONTEXT  *Test,
+  IN EXT4_INO_NR        Inode
+  )
+{
+  EXT4_INODE  *Ino;
+
+  Ino = Ext4ImageInode (Test->Builder, Inode);
+
+  UT_ASSERT_EQUAL (Ino->i_mtime, EXT4_TEST_WRITE_EPOCH);
+  UT_ASSERT_EQUAL (Ino->i_ctime, EXT4_TEST_WRITE_EPOCH);
+  UT_ASSERT_EQUAL (Ino->i_mtime_extra, EXT4_TEST_WRITE_NANOSECONDS << 2);
+  UT_ASSERT_EQUAL (Ino->i_ctime_extra, EXT4_TEST_WRITE_NANOSECONDS << 2);
+  // Only the data changed
+  UT_ASSERT_EQUAL (Ino->i_atime, EXT4_IMAGE_TIME);
+  UT_ASSERT_EQUAL (Ino->i_crtime, EXT4_IMAGE_TIME);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Checks that a range of a file in the image reads back as the expected data.
+
+   @param[in]      Test          Pointer to the EXT4_TEST_CONTEXT.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Offset        Offset of the range.
+   @param[in]      Length        Length of the range.
+   @param[in]      Data          Pointer to the data expected at Offset, or NULL for zeroes.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+Ext4TestCheckImageData (
+  IN EXT4_TEST_CONTEXT  *Test,
+  IN EXT4_INO_NR        Inode,
+  IN UINT64             Offset,
+  IN UINTN              Length,
+  IN CONST UINT8        *Data OPTIONAL
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    UT_ASSERT_EQUAL (*Ext4ImageFileData (Test->Builder, Inode, Offset + Index), (Data != NULL) ? Data[Index] : 0);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Overwrites part of a file in place, and checks the data and the times got
+   to the disk. Writes past the end of the file and into holes allocate blocks,
+   the parts of which the write doesn't cover read back as zeroes.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestWriteFile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_FILE_PROTOCOL  *Other;
+  EFI_FILE_INFO      *Info;
+  UINT8              Data[10];
+  UINT8              Buffer[10];
+  UINT64             Offset;
+  UINT64             Size;
+  UINTN              Length;
+  UINTN              Index;
+  UNIT_TEST_STATUS   Result;
+  EFI_STATUS         Status;
+
+  Test   = Context;
+  Size   = 3 * Test->BlockSize + 17;
+  Offset = Test->BlockSize - 3;
+
+  Ext4TestSetWriteTime ();
+
+  for (Index = 0; Index < sizeof (Data); Index++) {
+    Data[Index] = (UINT8)~Ext4ImagePatternByte (Test->NestedInode, Offset + Index);
+  }
+
+  // Writing needs a handle opened for writing
+  Status = Ext4HostOpen (Test->Partition, "dir/nested.bin", EFI_FILE_MODE_READ, &Other);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = Other->Write (Other, &Length, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = Ext4HostOpen (Test->Partition, "dir/nested.bin", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Straddling two blocks
+  Status = File->SetPosition (File, Offset);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+
+  Status = File->Flush (File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Index = 0; Index < sizeof (Data); Index++) {
+    UT_ASSERT_EQUAL (*Ext4ImageFileData (Test->Builder, Test->NestedInode, Offset + Index), Data[Index]);
+  }
+
+  // The bytes around the write are untouched
+  UT_ASSERT_EQUAL (*Ext4ImageFileData (Test->Builder, Test->NestedInode, Offset - 1), Ext4ImagePatternByte (Test->NestedInode, Offset - 1));
+  UT_ASSERT_EQUAL (
+    *Ext4ImageFileData (Test->Builder, Test->NestedInode, Offset + sizeof (Data)),
+    Ext4ImagePatternByte (Test->NestedInode, Offset + sizeof (Data))
+    );
+
+  Result = Ext4TestCheckWriteTimes (Test, Test->NestedInode);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  // The other handle sees the new data and times
+  Status = Other->SetPosition (Other, Offset);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Buffer);
+  Status = Other->Read (Other, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_MEM_EQUAL (Buffer, Data, sizeof (Data));
+
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+
+  Length = EXT4_TEST_INFO_SIZE;
+  Status = Other->GetInfo (Other, &gEfiFileInfoGuid, &Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Info->ModificationTime.Year, 2022);
+  UT_ASSERT_EQUAL (Info->ModificationTime.Second, 7);
+  UT_ASSERT_EQUAL (Info->FileSize, Size);
+
+  FreePool (Info);
+  Other->Close (Other);
+
+  // Writes that extend the file
+  Status = File->SetPosition (File, Size - 5);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+
+  File->Close (File);
+
+  UT_ASSERT_EQUAL (EXT4_INODE_SIZE (Ext4ImageInode (Test->Builder, Test->NestedInode)), Size + 5);
+  Result = Ext4TestCheckImageData (Test, Test->NestedInode, Size - 5, sizeof (Data), Data);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  // Writes that run into a hole (the third extent of fragmented.bin is one)
+  Offset = 2 * EXT4_TEST_FRAGMENT_BLOCKS * Test->BlockSize;
+  UT_ASSERT_TRUE (Ext4ImageFileData (Test->Builder, Test->FragmentedInode, Offset) == NULL);
+
+  Status = Ext4HostOpen (Test->Partition, "fragmented.bin", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = File->SetPosition (File, Offset - 5);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+
+  File->Close (File);
+
+  Result = Ext4TestCheckImageData (Test, Test->FragmentedInode, Offset - 5, sizeof (Data), Data);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = Ext4TestCheckImageData (Test, Test->FragmentedInode, Offset + 5, Test->BlockSize - 5, NULL);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  Result = Ext4TestCheckWriteTimes (Test, Test->FragmentedInode);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Writes to preallocated (uninitialized) extents. The blocks the writes land in
+   must be split off their extents and marked as initialized, with the rest of
+   them zeroed, and the other blocks must be left alone. This works the same way
+   for extents in an extent tree.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestWriteUnwritten (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT   *Test;
+  EFI_FILE_PROTOCOL   *File;
+  EFI_FILE_PROTOCOL   *Other;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT         *Extent;
+  UINT8               Data[10];
+  UINT8               *Buffer;
+  UINT64              Block;
+  UINT64              Size;
+  UINT64              ExtentSize;
+  UINT64              Offset;
+  UINTN               Length;
+  UINTN               Index;
+  UNIT_TEST_STATUS    Result;
+  EFI_STATUS          Status;
+
+  Test       = Context;
+  Size       = EXT4_TEST_PREALLOC_BLOCKS * Test->BlockSize - 50;
+  ExtentSize = EXT4_TEST_PREALLOC_EXTENT_BLOCKS * Test->BlockSize;
+
+  Header = (EXT4_EXTENT_HEADER *)Ext4ImageInode (Test->Builder, Test->PreallocInode)->i_data;
+  UT_ASSERT_EQUAL (Header->eh_depth, 0);
+  UT_ASSERT_EQUAL (Header->eh_entries, 3);
+
+  Ext4TestSetWriteTime ();
+
+  SetMem (Data, sizeof (Data), 0x5A);
+
+  Buffer = AllocatePool ((UINTN)Size);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = Ext4HostOpen (Test->Partition, "prealloc.bin", EFI_FILE_MODE_READ, &Other);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "prealloc.bin", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Uninitialized extents read back as zeroes, whatever their blocks hold
+  Length = (UINTN)Size;
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, Size);
+
+  for (Index = 0; Index < Length; Index++) {
+    UT_ASSERT_EQUAL (Buffer[Index], 0);
+  }
+
+  // In the middle of the second extent
+  Offset = ExtentSize + 100;
+
+  Status = File->SetPosition (File, Offset);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Test->Disk->FlushCalls = 0;
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+
+  // The data is flushed before the extent is marked as initialized
+  UT_ASSERT_TRUE (Test->Disk->FlushCalls >= 1);
+
+  // Only the written block was split off its extent
+  Block  = EXT4_TEST_PREALLOC_EXTENT_BLOCKS;
+  Extent = Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, Block);
+  UT_ASSERT_NOT_NULL (Extent);
+  UT_ASSERT_FALSE (EXT4_EXTENT_IS_UNINITIALIZED (Extent));
+  UT_ASSERT_EQUAL (Extent->ee_block, Block);
+  UT_ASSERT_EQUAL (Ext4GetExtentLength (Extent), 1);
+
+  UT_ASSERT_EQUAL (Header->eh_entries, 4);
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, 0)));
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, Block + 1)));
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, 2 * Block)));
+
+  // The rest of the block was zeroed on the disk
+  Result = Ext4TestCheckImageData (Test, Test->PreallocInode, ExtentSize, (UINTN)(Offset - ExtentSize), NULL);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = Ext4TestCheckImageData (Test, Test->PreallocInode, Offset, sizeof (Data), Data);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = Ext4TestCheckImageData (
+             Test,
+             Test->PreallocInode,
+             Offset + sizeof (Data),
+             (UINTN)(ExtentSize + Test->BlockSize - Offset - sizeof (Data)),
+             NULL
+             );
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  Result = Ext4TestCheckWriteTimes (Test, Test->PreallocInode);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  // Straddling the first (uninitialized) and second (now initialized) extents
+  Offset = ExtentSize - 4;
+
+  Status = File->SetPosition (File, Offset);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_FALSE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, Block - 1)));
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, 0)));
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocInode, Block + 1)));
+
+  Result = Ext4TestCheckImageData (Test, Test->PreallocInode, ExtentSize - Test->BlockSize, Test->BlockSize - 4, NULL);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  // Another handle, opened before the writes, reads the same thing
+  Length = (UINTN)Size;
+  Status = Other->Read (Other, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, Size);
+
+  for (Index = 0; Index < Length; Index++) {
+    if ((Index >= Offset) && (Index < Offset + sizeof (Data))) {
+      UT_ASSERT_EQUAL (Buffer[Index], Data[0]);
+    } else if ((Index >= ExtentSize + 100) && (Index < ExtentSize + 100 + sizeof (Data))) {
+      UT_ASSERT_EQUAL (Buffer[Index], Data[0]);
+    } else {
+      UT_ASSERT_EQUAL (Buffer[Index], 0);
+    }
+  }
+
+  Other->Close (Other);
+  File->Close (File);
+
+  // Uninitialized extents in a tree get split in their leaf
+  Header = (EXT4_EXTENT_HEADER *)Ext4ImageInode (Test->Builder, Test->PreallocTreeInode)->i_data;
+  UT_ASSERT_EQUAL (Header->eh_depth, 1);
+
+  Status = Ext4HostOpen (Test->Partition, "prealloc-tree.bin", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+
+  UT_ASSERT_FALSE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocTreeInode, 0)));
+  UT_ASSERT_TRUE (EXT4_EXTENT_IS_UNINITIALIZED (Ext4ImageFileExtent (Test->Builder, Test->PreallocTreeInode, 1)));
+
+  Result = Ext4TestCheckImageData (Test, Test->PreallocTreeInode, 0, sizeof (Data), Data);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+
+  Length = sizeof (Data);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Index = 0; Index < Length; Index++) {
+    UT_ASSERT_EQUAL (Buffer[Index], 0);
+  }
+
+  File->Close (File);
+  FreePool (Buffer);
+
+  // What's on the disk mounts and reads back the same
+  Ext4UnmountAndFreePartition (Test->Partition);
+  Test->Partition = NULL;
+
+  Status = Ext4HostMount (Test->Disk, &Test->Partition);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "prealloc.bin", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = File->SetPosition (File, ExtentSize + 100);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Read (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Data[0], 0x5A);
+  UT_ASSERT_EQUAL (Data[sizeof (Data) - 1], 0x5A);
+
+  File->Close (File);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Looks a name up in an indexed (htree) directory when its hash collides with
+   the start of a subtree of the index, so that the lookup has to continue from
+   the last leaf of one subtree into the first leaf of the next. With 1KiB
+   blocks the two leaves hang off different interior nodes.
+
+   The collision is made up by moving the start of the second subtree up to the
+   hash of a name in its first leaf, and marking it as a collision. The name has
+   no letters, so a miss in the index isn't covered by a linear scan.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestIndexedCollision (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *DirProtocol;
+  EXT4_FILE          *Dir;
+  EXT4_DX_ROOT       *Root;
+  EXT4_DX_ENTRY      *Entries;
+  EXT4_DX_ENTRY      *NodeEntries;
+  EXT4_DIR_ENTRY     *Leaf;
+  EXT4_DIR_ENTRY     Entry;
+  UINT32             LeafBlock;
+  UINT32             Hash;
+  UINTN              Offset;
+  CHAR8              Name[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  CHAR16             UnicodeName[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  EFI_STATUS         Status;
+
+  Test = Context;
+
+  Root    = (EXT4_DX_ROOT *)Ext4ImageFileData (Test->Builder, Test->IndexedInode, 0);
+  Entries = (EXT4_DX_ENTRY *)(Root + 1);
+  UT_ASSERT_TRUE (((EXT4_DX_COUNT_LIMIT *)Entries)->count > 1);
+
+  LeafBlock = Entries[1].block;
+  if (Root->info.indirect_levels != 0) {
+    NodeEntries = (EXT4_DX_ENTRY *)(Ext4ImageFileData (Test->Builder, Test->IndexedInode, Entries[1].block * Test->BlockSize) + sizeof (EXT4_DX_NODE));
+    LeafBlock   = NodeEntries[0].block;
+  }
+
+  // Find a name without letters in the first leaf of the second subtree
+  Leaf = NULL;
+  for (Offset = 0; Offset < Test->BlockSize; Offset += Leaf->rec_len) {
+    Leaf = (EXT4_DIR_ENTRY *)(Ext4ImageFileData (Test->Builder, Test->IndexedInode, LeafBlock * Test->BlockSize) + Offset);
+    UT_ASSERT_NOT_EQUAL (Leaf->rec_len, 0);
+
+    if ((Leaf->inode != 0) && (Leaf->name[0] >= '0') && (Leaf->name[0] <= '9')) {
+      break;
+    }
+  }
+
+  UT_ASSERT_TRUE (Offset < Test->BlockSize);
+  UT_ASSERT_EQUAL (Leaf->name_len, EXT4_TEST_INDEXED_NAME_LENGTH);
+  CopyMem (Name, Leaf->name, EXT4_TEST_INDEXED_NAME_LENGTH);
+  Name[EXT4_TEST_INDEXED_NAME_LENGTH] = '\0';
+
+  Status = Ext4DirHash (Test->Partition, EXT4_DX_HASH_HALF_MD4, Name, EXT4_TEST_INDEXED_NAME_LENGTH, &Hash);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (Hash >= (Entries[1].hash & ~1U));
+  Entries[1].hash = Hash | 1;
+
+  Status = Ext4HostOpen (Test->Partition, "indexed", EFI_FILE_MODE_READ, &DirProtocol);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Dir = (EXT4_FILE *)DirProtocol;
+
+  Ext4TestUnicodeName (Name, UnicodeName);
+  Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Entry.inode, Leaf->inode);
+
+  DirProtocol->Close (DirProtocol);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Changes a file's name (and, with path separators, its directory) through SetInfo.
+
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Name          New name of the file.
+
+   @return Status of the SetInfo call.
+**/
+STATIC
+EFI_STATUS
+Ext4TestRename (
+  IN EFI_FILE_PROTOCOL  *File,
+  IN CONST CHAR16       *Name
+  )
+{
+  EFI_FILE_INFO  *Info;
+  UINTN          Length;
+  EFI_STATUS     Status;
+
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  if (Info == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Length = EXT4_TEST_INFO_SIZE;
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &Length, Info);
+
+  if (!EFI_ERROR (Status)) {
+    StrCpyS (Info->FileName, EXT4_NAME_MAX + 1, Name);
+    Info->Size = SIZE_OF_EFI_FILE_INFO + StrSize (Name);
+    Status     = File->SetInfo (File, &gEfiFileInfoGuid, Info->Size, Info);
+  }
+
+  FreePool (Info);
+  return Status;
+}
+
+/**
+   Creates files and directories, and checks they can be read back and
+   looked up. Adding enough entries to a directory gives it new blocks.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestCreateFile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *Root;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_FILE_PROTOCOL  *Dir;
+  EFI_FILE_INFO      *Info;
+  EXT4_INODE         *Ino;
+  EXT4_INO_NR        DirInode;
+  UINT8              Data[100];
+  UINT8              Buffer[100];
+  UINT64             DirSize;
+  UINT32             RootLinks;
+  UINT32             FreeInodes;
+  CHAR8              Name[32];
+  UINTN              Length;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Test       = Context;
+  Root       = &Test->Partition->Root->Protocol;
+  RootLinks  = Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links;
+  FreeInodes = Test->Partition->SuperBlock.s_free_inodes_count;
+
+  Ext4TestSetWriteTime ();
+
+  for (Index = 0; Index < sizeof (Data); Index++) {
+    Data[Index] = (UINT8)(Index * 3 + 1);
+  }
+
+  // Files are only created with EFI_FILE_MODE_CREATE
+  Status = Ext4HostOpen (Test->Partition, "new.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = Ext4HostOpen (Test->Partition, "new.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  File->Close (File);
+
+  UT_ASSERT_EQUAL (Test->Partition->SuperBlock.s_free_inodes_count, FreeInodes - 1);
+
+  // Opening an existing file with EFI_FILE_MODE_CREATE doesn't truncate it
+  Status = Ext4HostOpen (Test->Partition, "new.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Ino = Ext4ImageInode (Test->Builder, ((EXT4_FILE *)File)->InodeNum);
+  UT_ASSERT_EQUAL (Ino->i_mode, EXT4_INO_TYPE_REGFILE | 0644);
+  UT_ASSERT_EQUAL (Ino->i_links, 1);
+  UT_ASSERT_EQUAL (Ino->i_crtime, EXT4_TEST_WRITE_EPOCH);
+  UT_ASSERT_EQUAL (EXT4_INODE_SIZE (Ino), sizeof (Data));
+
+  Length = sizeof (Buffer);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+  UT_ASSERT_MEM_EQUAL (Buffer, Data, sizeof (Data));
+  File->Close (File);
+
+  // Directories need EFI_FILE_DIRECTORY, and start out with "." and ".."
+  Status = Root->Open (Root, &Dir, L"newdir", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, EFI_FILE_DIRECTORY);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  DirInode = ((EXT4_FILE *)Dir)->InodeNum;
+
+  Ino = Ext4ImageInode (Test->Builder, DirInode);
+  UT_ASSERT_EQUAL (Ino->i_mode, EXT4_INO_TYPE_DIR | 0755);
+  UT_ASSERT_EQUAL (Ino->i_links, 2);
+  UT_ASSERT_EQUAL (EXT4_INODE_SIZE (Ino), Test->BlockSize);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links, RootLinks + 1);
+
+  Status = Dir->Open (Dir, &File, L"inner.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, EFI_FILE_READ_ONLY);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // The new handle can write, even though the file is read-only
+  Length = sizeof (Data);
+  Status = File->Write (File, &Length, Data);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, ((EXT4_FILE *)File)->InodeNum)->i_mode & EXT4_INO_PERM_WRITE_ALL, 0);
+  File->Close (File);
+  Dir->Close (Dir);
+
+  Status = Ext4HostOpen (Test->Partition, "newdir/inner.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = Ext4HostOpen (Test->Partition, "newdir/../newdir/./inner.txt", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Info   = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+  Length = EXT4_TEST_INFO_SIZE;
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Info->FileSize, sizeof (Data));
+  UT_ASSERT_EQUAL (Info->Attribute, EFI_FILE_READ_ONLY);
+  UT_ASSERT_MEM_EQUAL (Info->FileName, L"inner.txt", sizeof (L"inner.txt"));
+  FreePool (Info);
+  File->Close (File);
+
+  // Names that can't be stored
+  Status = Ext4HostOpen (Test->Partition, "..", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+  UT_ASSERT_TRUE (EFI_ERROR (Status));
+  Status = Ext4HostOpen (Test->Partition, "missing/file", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  // Fill "many" up until it needs more blocks
+  DirSize = EXT4_INODE_SIZE (Ext4ImageInode (Test->Builder, Test->ManyInode));
+
+  for (Index = 0; Index < EXT4_TEST_MANY_FILES; Index++) {
+    AsciiSPrint (Name, sizeof (Name), "many/a-longer-new-name-%03u", (UINT32)Index);
+    Status = Ext4HostOpen (Test->Partition, Name, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    File->Close (File);
+  }
+
+  UT_ASSERT_TRUE (EXT4_INODE_SIZE (Ext4ImageInode (Test->Builder, Test->ManyInode)) > DirSize);
+
+  for (Index = 0; Index < EXT4_TEST_MANY_FILES; Index++) {
+    AsciiSPrint (Name, sizeof (Name), "many/A-LONGER-NEW-NAME-%03u", (UINT32)Index);
+    Status = Ext4HostOpen (Test->Partition, Name, EFI_FILE_MODE_READ, &File);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    File->Close (File);
+
+    AsciiSPrint (Name, sizeof (Name), "many/file%03u", (UINT32)Index);
+    Status = Ext4HostOpen (Test->Partition, Name, EFI_FILE_MODE_READ, &File);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    File->Close (File);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Adds entries to the indexed directory until its leaves split, and checks
+   that the index still finds every name.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestIndexedCreate (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *DirProtocol;
+  EFI_FILE_PROTOCOL  *File;
+  EXT4_FILE          *Dir;
+  EXT4_INODE         *Ino;
+  EXT4_DIR_ENTRY     Entry;
+  UINT64             DirSize;
+  UINTN              Index;
+  CHAR8              Name[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  CHAR16             UnicodeName[EXT4_TEST_INDEXED_NAME_LENGTH + 1];
+  EFI_STATUS         Status;
+
+  Test    = Context;
+  Ino     = Ext4ImageInode (Test->Builder, Test->IndexedInode);
+  DirSize = EXT4_INODE_SIZE (Ino);
+
+  Status = Ext4HostOpen (Test->Partition, "indexed", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &DirProtocol);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Dir = (EXT4_FILE *)DirProtocol;
+
+  for (Index = EXT4_TEST_INDEXED_FILES; Index < EXT4_TEST_INDEXED_FILES + EXT4_TEST_INDEXED_NEW_FILES; Index++) {
+    Ext4TestIndexedName (Index, Name);
+    Ext4TestUnicodeName (Name, UnicodeName);
+
+    Status = DirProtocol->Open (DirProtocol, &File, UnicodeName, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    File->Close (File);
+  }
+
+  // The new entries didn't fit in the leaves that were there, and the index was kept
+  UT_ASSERT_TRUE (EXT4_INODE_SIZE (Ino) > DirSize);
+  UT_ASSERT_NOT_EQUAL (Ino->i_flags & EXT4_INDEX_FL, 0);
+
+  // Deleting some of the old entries leaves the others alone
+  for (Index = 1; Index < EXT4_TEST_INDEXED_FILES; Index += 20) {
+    Ext4TestIndexedName (Index, Name);
+    Ext4TestUnicodeName (Name, UnicodeName);
+
+    Status = DirProtocol->Open (DirProtocol, &File, UnicodeName, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    Status = File->Delete (File);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  for (Index = 0; Index < EXT4_TEST_INDEXED_FILES + EXT4_TEST_INDEXED_NEW_FILES; Index++) {
+    Ext4TestIndexedName (Index, Name);
+    Ext4TestUnicodeName (Name, UnicodeName);
+
+    Status = Ext4RetrieveDirent (Dir, UnicodeName, Test->Partition, &Entry);
+
+    if ((Index < EXT4_TEST_INDEXED_FILES) && ((Index % 20) == 1)) {
+      UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+    } else {
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+    }
+  }
+
+  DirProtocol->Close (DirProtocol);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Deletes files and directories. Directories need to be empty, and files can
+   only be deleted through their only open handle, opened for writing.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestDeleteFile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_FILE_PROTOCOL  *Other;
+  EXT4_INODE         *Ino;
+  UINT32             RootLinks;
+  UINT32             FreeInodes;
+  UINT64             FreeBlocks;
+  EFI_STATUS         Status;
+
+  Test       = Context;
+  RootLinks  = Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links;
+  FreeInodes = Test->Partition->SuperBlock.s_free_inodes_count;
+  FreeBlocks = Test->Partition->SuperBlock.s_free_blocks_count;
+
+  Ext4TestSetWriteTime ();
+
+  // Read-only handles can't delete
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_WARN_DELETE_FAILURE);
+
+  // Neither can handles that aren't the only one
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &Other);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_WARN_DELETE_FAILURE);
+  Other->Close (Other);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  // The inode and its block are freed
+  Ino = Ext4ImageInode (Test->Builder, Test->SmallInode);
+  UT_ASSERT_EQUAL (Ino->i_links, 0);
+  UT_ASSERT_EQUAL (Ino->i_dtime, EXT4_TEST_WRITE_EPOCH);
+  UT_ASSERT_EQUAL (EXT4_INODE_SIZE (Ino), 0);
+  UT_ASSERT_EQUAL (Test->Partition->SuperBlock.s_free_inodes_count, FreeInodes + 1);
+  UT_ASSERT_EQUAL (Test->Partition->SuperBlock.s_free_blocks_count, FreeBlocks + 1);
+
+  // Directories have to be empty
+  Status = Ext4HostOpen (Test->Partition, "dir", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_WARN_DELETE_FAILURE);
+
+  Status = Ext4HostOpen (Test->Partition, "dir/nested.bin", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "dir", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "dir", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links, RootLinks - 1);
+
+  // The root can't be deleted
+  Status = Ext4HostOpen (Test->Partition, "", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = File->Delete (File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_WARN_DELETE_FAILURE);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Renames, moves and resizes files, and changes their attributes, through SetInfo.
+
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+
+   @return Result of the test.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Ext4TestSetFileInfo (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EXT4_TEST_CONTEXT  *Test;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_FILE_PROTOCOL  *Dir;
+  EFI_FILE_INFO      *Info;
+  EXT4_DIR_ENTRY     Entry;
+  UINT32             RootLinks;
+  UINT32             ManyLinks;
+  UINT8              Buffer[16];
+  UINTN              Length;
+  EFI_STATUS         Status;
+
+  Test      = Context;
+  RootLinks = Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links;
+  ManyLinks = Ext4ImageInode (Test->Builder, Test->ManyInode)->i_links;
+
+  Ext4TestSetWriteTime ();
+
+  Info = AllocatePool (EXT4_TEST_INFO_SIZE);
+  UT_ASSERT_NOT_NULL (Info);
+
+  // Read-only handles can only change the attributes
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = Ext4TestRename (File, L"renamed.txt");
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Names that are taken can't be reused
+  Status = Ext4TestRename (File, L"empty");
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = Ext4TestRename (File, L"renamed.txt");
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Paths are relative to the file's directory
+  Status = Ext4TestRename (File, L"dir\\moved.txt");
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4HostOpen (Test->Partition, "small.txt", EFI_FILE_MODE_READ, &Dir);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  Status = Ext4HostOpen (Test->Partition, "renamed.txt", EFI_FILE_MODE_READ, &Dir);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  // Shrink the file, then grow it back; the new part reads back as zeroes
+  Length = EXT4_TEST_INFO_SIZE;
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_MEM_EQUAL (Info->FileName, L"moved.txt", sizeof (L"moved.txt"));
+
+  Info->FileSize = 10;
+  Status         = File->SetInfo (File, &gEfiFileInfoGuid, Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (EXT4_INODE_SIZE (Ext4ImageInode (Test->Builder, Test->SmallInode)), 10);
+
+  Info->FileSize = 2 * Test->BlockSize;
+  Status         = File->SetInfo (File, &gEfiFileInfoGuid, Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = File->SetPosition (File, 5);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Length = sizeof (Buffer);
+  Status = File->Read (File, &Length, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Length, sizeof (Buffer));
+  UT_ASSERT_EQUAL (Buffer[4], Ext4ImagePatternByte (Test->SmallInode, 9));
+  UT_ASSERT_TRUE (IsZeroBuffer (Buffer + 5, sizeof (Buffer) - 5));
+
+  // Files can be made read-only, but not into directories
+  Length = EXT4_TEST_INFO_SIZE;
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Info->Attribute |= EFI_FILE_DIRECTORY;
+  Status           = File->SetInfo (File, &gEfiFileInfoGuid, Length, Info);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Info->Attribute = EFI_FILE_READ_ONLY;
+  Status          = File->SetInfo (File, &gEfiFileInfoGuid, Length, Info);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, Test->SmallInode)->i_mode, EXT4_INO_TYPE_REGFILE | 0444);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, Test->SmallInode)->i_ctime, EXT4_TEST_WRITE_EPOCH);
+  File->Close (File);
+
+  Status = Ext4HostOpen (Test->Partition, "dir/moved.txt", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  // Moving a directory updates its ".." and the link counts of both parents
+  Status = Ext4HostOpen (Test->Partition, "dir", EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &Dir);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4TestRename (Dir, L"dir\\inside");
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = Ext4TestRename (Dir, L"\\many\\moved-dir");
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = Ext4RetrieveDirent ((EXT4_FILE *)Dir, L"..", Test->Partition, &Entry);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Entry.inode, Test->ManyInode);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, EXT4_ROOT_INODE_NR)->i_links, RootLinks - 1);
+  UT_ASSERT_EQUAL (Ext4ImageInode (Test->Builder, Test->ManyInode)->i_links, ManyLinks + 1);
+  Dir->Close (Dir);
+
+  Status = Ext4HostOpen (Test->Partition, "many/moved-dir/../moved-dir/nested.bin", EFI_FILE_MODE_READ, &File);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (((EXT4_FILE *)File)->InodeNum, Test->NestedInode);
+  File->Close (File);
+
+  // The volume label lives in the superblock, and is at most 16 bytes of UTF-8
+  Status = Test->Partition->Root->Protocol.SetInfo (
+                                             &Test->Partition->Root->Protocol,
+                                             &gEfiFileSystemVolumeLabelInfoIdGuid,
+                                             sizeof (L"new label"),
+                                             L"new label"
+                                             );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_MEM_EQUAL (Test->Partition->SuperBlock.s_volume_name, "new label\0", 10);
+
+  Status = Test->Partition->Root->Protocol.SetInfo (
+                                             &Test->Partition->Root->Protocol,
+                                             &gEfiFileSystemVolumeLabelInfoIdGuid,
+                                             sizeof (L"a label that is too long"),
+                                             L"a label that is too long"
+                                             );
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  FreePool (Info);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+   Adds the mount and read tests for a block size to the framework.
+
+   @param[in]      Framework     Unit test framework.
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+   @param[in]      Title         Title of the test suite.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AddReadTests (
+  IN UNIT_TEST_FRAMEWORK_HANDLE  Framework,
+  IN EXT4_TEST_CONTEXT           *Context,
+  IN CHAR8                       *Title
+  )
+{
+  UNIT_TEST_SUITE_HANDLE  Suite;
+  EFI_STATUS              Status;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, Title, "Ext4Dxe.Read", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Mount geometry", "Geometry", Ext4TestMountGeometry, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Read a file", "ReadFile", Ext4TestReadFile, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Read fragmented files", "ReadFragmented", Ext4TestReadFragmentedFile, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "List a directory", "ReadDir", Ext4TestReadDir, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Look names up", "Lookup", Ext4TestLookup, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Refuse corrupt superblocks", "CorruptSuperblock", Ext4TestCorruptSuperblock, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Refuse corrupt directory entries", "CorruptDirent", Ext4TestCorruptDirent, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Refuse special files", "SpecialFiles", Ext4TestSpecialFiles, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Refuse corrupt extent headers", "CorruptExtents", Ext4TestCorruptExtents, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Look names up in an indexed directory", "IndexedLookup", Ext4TestIndexedLookup, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Follow hash collisions across index nodes", "IndexedCollision", Ext4TestIndexedCollision, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds the write tests for a block size to the framework.
+
+   @param[in]      Framework     Unit test framework.
+   @param[in]      Context       Pointer to the EXT4_TEST_CONTEXT.
+   @param[in]      Title         Title of the test suite.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AddWriteTests (
+  IN UNIT_TEST_FRAMEWORK_HANDLE  Framework,
+  IN EXT4_TEST_CONTEXT           *Context,
+  IN CHAR8                       *Title
+  )
+{
+  UNIT_TEST_SUITE_HANDLE  Suite;
+  EFI_STATUS              Status;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, Title, "Ext4Dxe.Write", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Overwrite a file in place", "WriteFile", Ext4TestWriteFile, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Write to uninitialized extents", "WriteUnwritten", Ext4TestWriteUnwritten, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Create files and directories", "CreateFile", Ext4TestCreateFile, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Add entries to an indexed directory", "IndexedCreate", Ext4TestIndexedCreate, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Delete files and directories", "DeleteFile", Ext4TestDeleteFile, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+  AddTestCase (Suite, "Rename, move and resize files", "SetFileInfo", Ext4TestSetFileInfo, Ext4TestMountImage, Ext4TestUnmountImage, Context);
+
+  return EFI_SUCCESS;
+}
+
+STATIC EXT4_TEST_CONTEXT  mContext1k = { 1024, 8192 };
+STATIC EXT4_TEST_CONTEXT  mContext4k = { 4096, 4096 };
+
+/**
+   Sets up and runs the unit tests.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = Ext4AddReadTests (Framework, &mContext1k, "Ext4 mount and read, 1KiB blocks");
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = Ext4AddReadTests (Framework, &mContext4k, "Ext4 mount and read, 4KiB blocks");
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = Ext4AddWriteTests (Framework, &mContext1k, "Ext4 write, 1KiB blocks");
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = Ext4AddWriteTests (Framework, &mContext4k, "Ext4 write, 4KiB blocks");
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+   Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
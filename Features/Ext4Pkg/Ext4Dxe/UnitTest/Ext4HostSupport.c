@@ -0,0 +1,585 @@
+/** @file
+  Host support for the Ext4Dxe unit tests, fuzzer and benchmark.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Ext4HostSupport.h"
+
+#if defined (_MSC_VER)
+#define EXT4_HOST_FSEEK  _fseeki64
+#else
+#define EXT4_HOST_FSEEK  fseeko
+#endif
+
+/**
+   Host events only need to call their notification function when signalled.
+ */
+typedef struct {
+  EFI_EVENT_NOTIFY    NotifyFunction;
+  VOID                *NotifyContext;
+} EXT4_HOST_EVENT;
+
+STATIC EFI_BOOT_SERVICES     mHostBootServices;
+STATIC EFI_RUNTIME_SERVICES  mHostRuntimeServices;
+STATIC EFI_TPL               mHostTpl = TPL_APPLICATION;
+
+// What the fake real time clock reads; a fixed time keeps the tests reproducible
+STATIC EFI_TIME  mHostTime = { 2021, 6, 1, 12, 0, 0, 0, 0, EFI_UNSPECIFIED_TIMEZONE, 0, 0 };
+
+EFI_BOOT_SERVICES     *gBS = &mHostBootServices;
+EFI_RUNTIME_SERVICES  *gRT = &mHostRuntimeServices;
+
+/**
+   Raises the task priority level.
+
+   @param[in]      NewTpl        New task priority level.
+
+   @return Previous task priority level.
+**/
+STATIC
+EFI_TPL
+EFIAPI
+Ext4HostRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl   = mHostTpl;
+  mHostTpl = NewTpl;
+  return OldTpl;
+}
+
+/**
+   Restores the task priority level.
+
+   @param[in]      OldTpl        Task priority level to restore.
+**/
+STATIC
+VOID
+EFIAPI
+Ext4HostRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+  mHostTpl = OldTpl;
+}
+
+/**
+   Creates an event.
+
+   @param[in]      Type           Type of the event.
+   @param[in]      NotifyTpl      Task priority level of the notification function.
+   @param[in]      NotifyFunction Notification function, optional.
+   @param[in]      NotifyContext  Context passed to the notification function.
+   @param[out]     Event          Pointer to the new event.
+
+   @retval EFI_SUCCESS           The event was created.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostCreateEvent (
+  IN  UINT32            Type,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction OPTIONAL,
+  IN  VOID              *NotifyContext OPTIONAL,
+  OUT EFI_EVENT         *Event
+  )
+{
+  EXT4_HOST_EVENT  *HostEvent;
+
+  HostEvent = AllocateZeroPool (sizeof (EXT4_HOST_EVENT));
+  if (HostEvent == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  HostEvent->NotifyFunction = NotifyFunction;
+  HostEvent->NotifyContext  = NotifyContext;
+
+  *Event = HostEvent;
+  return EFI_SUCCESS;
+}
+
+/**
+   Signals an event, calling its notification function straight away.
+
+   @param[in]      Event         Event to signal.
+
+   @retval EFI_SUCCESS           The event was signalled.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostSignalEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  EXT4_HOST_EVENT  *HostEvent;
+
+  HostEvent = Event;
+
+  if (HostEvent->NotifyFunction != NULL) {
+    HostEvent->NotifyFunction (Event, HostEvent->NotifyContext);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Closes an event.
+
+   @param[in]      Event         Event to close.
+
+   @retval EFI_SUCCESS           The event was closed.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostCloseEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  FreePool (Event);
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads the fake real time clock.
+
+   @param[out]     Time          Pointer to the current time.
+   @param[out]     Capabilities  Pointer to the clock's capabilities, optional.
+
+   @retval EFI_SUCCESS           The time was read.
+   @retval EFI_INVALID_PARAMETER Time is NULL.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostGetTime (
+  OUT EFI_TIME               *Time,
+  OUT EFI_TIME_CAPABILITIES  *Capabilities OPTIONAL
+  )
+{
+  if (Time == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Time, &mHostTime, sizeof (EFI_TIME));
+
+  if (Capabilities != NULL) {
+    ZeroMem (Capabilities, sizeof (EFI_TIME_CAPABILITIES));
+    Capabilities->Resolution = 1;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Sets what the fake real time clock reads.
+
+   @param[in]      Time          Pointer to the new time.
+**/
+VOID
+Ext4HostSetTime (
+  IN CONST EFI_TIME  *Time
+  )
+{
+  CopyMem (&mHostTime, Time, sizeof (EFI_TIME));
+}
+
+/**
+   Fills in the boot and runtime services Ext4Dxe uses outside of its driver model glue.
+**/
+STATIC
+VOID
+Ext4HostInitServices (
+  VOID
+  )
+{
+  mHostBootServices.RaiseTPL    = Ext4HostRaiseTpl;
+  mHostBootServices.RestoreTPL  = Ext4HostRestoreTpl;
+  mHostBootServices.CreateEvent = Ext4HostCreateEvent;
+  mHostBootServices.SignalEvent = Ext4HostSignalEvent;
+  mHostBootServices.CloseEvent  = Ext4HostCloseEvent;
+
+  mHostRuntimeServices.GetTime = Ext4HostGetTime;
+}
+
+/**
+   Compares two UCS-2 strings, case insensitively. This stands in for the
+   Unicode Collation based version in Collation.c, and only folds ASCII.
+
+   @param[in]      Str1          Pointer to the first string.
+   @param[in]      Str2          Pointer to the second string.
+
+   @return 0 if the strings are equal, non-zero otherwise.
+**/
+INTN
+Ext4StrCmpInsensitive (
+  IN CHAR16  *Str1,
+  IN CHAR16  *Str2
+  )
+{
+  while (*Str1 != L'\0' && CharToUpper (*Str1) == CharToUpper (*Str2)) {
+    Str1++;
+    Str2++;
+  }
+
+  return CharToUpper (*Str1) - CharToUpper (*Str2);
+}
+
+/**
+   Reads from a fake disk.
+
+   @param[in]      This          Pointer to the DiskIo protocol.
+   @param[in]      MediaId       ID of the medium.
+   @param[in]      Offset        Offset of the read, in bytes.
+   @param[in]      BufferSize    Size of the read, in bytes.
+   @param[out]     Buffer        Pointer to the destination buffer.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostReadDisk (
+  IN  EFI_DISK_IO_PROTOCOL  *This,
+  IN  UINT32                MediaId,
+  IN  UINT64                Offset,
+  IN  UINTN                 BufferSize,
+  OUT VOID                  *Buffer
+  )
+{
+  EXT4_HOST_DISK  *Disk;
+
+  Disk = EXT4_HOST_DISK_FROM_DISK_IO (This);
+
+  Disk->ReadCalls++;
+  Disk->ReadBytes += BufferSize;
+
+  if ((Offset > Disk->Size) || (BufferSize > Disk->Size - Offset)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Disk->Buffer != NULL) {
+    CopyMem (Buffer, Disk->Buffer + Offset, BufferSize);
+    return EFI_SUCCESS;
+  }
+
+  if ((EXT4_HOST_FSEEK (Disk->File, Offset, SEEK_SET) != 0) ||
+      (fread (Buffer, 1, BufferSize, Disk->File) != BufferSize))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes to a fake disk.
+
+   @param[in]      This          Pointer to the DiskIo protocol.
+   @param[in]      MediaId       ID of the medium.
+   @param[in]      Offset        Offset of the write, in bytes.
+   @param[in]      BufferSize    Size of the write, in bytes.
+   @param[in]      Buffer        Pointer to the source buffer.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostWriteDisk (
+  IN EFI_DISK_IO_PROTOCOL  *This,
+  IN UINT32                MediaId,
+  IN UINT64                Offset,
+  IN UINTN                 BufferSize,
+  IN VOID                  *Buffer
+  )
+{
+  EXT4_HOST_DISK  *Disk;
+
+  Disk = EXT4_HOST_DISK_FROM_DISK_IO (This);
+
+  if (Disk->Media.ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  Disk->WriteCalls++;
+  Disk->WriteBytes += BufferSize;
+
+  if ((Offset > Disk->Size) || (BufferSize > Disk->Size - Offset)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Disk->Buffer != NULL) {
+    CopyMem (Disk->Buffer + Offset, Buffer, BufferSize);
+    return EFI_SUCCESS;
+  }
+
+  if ((EXT4_HOST_FSEEK (Disk->File, Offset, SEEK_SET) != 0) ||
+      (fwrite (Buffer, 1, BufferSize, Disk->File) != BufferSize))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Flushes a fake disk.
+
+   @param[in]      This          Pointer to the BlockIo protocol.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+Ext4HostFlushBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL  *This
+  )
+{
+  EXT4_HOST_DISK  *Disk;
+
+  Disk = EXT4_HOST_DISK_FROM_BLOCK_IO (This);
+  Disk->FlushCalls++;
+
+  if ((Disk->File != NULL) && (fflush (Disk->File) != 0)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Allocates a fake disk, without its backing store.
+
+   @param[in]      Size          Size of the disk, in bytes.
+   @param[in]      ReadOnly      TRUE if the disk is read-only.
+
+   @return Pointer to the new disk, or NULL if out of memory.
+**/
+STATIC
+EXT4_HOST_DISK *
+Ext4HostAllocateDisk (
+  IN UINT64   Size,
+  IN BOOLEAN  ReadOnly
+  )
+{
+  EXT4_HOST_DISK  *Disk;
+
+  Ext4HostInitServices ();
+
+  Disk = AllocateZeroPool (sizeof (EXT4_HOST_DISK));
+  if (Disk == NULL) {
+    return NULL;
+  }
+
+  Disk->DiskIo.Revision     = EFI_DISK_IO_PROTOCOL_REVISION;
+  Disk->DiskIo.ReadDisk     = Ext4HostReadDisk;
+  Disk->DiskIo.WriteDisk    = Ext4HostWriteDisk;
+  Disk->BlockIo.Revision    = EFI_BLOCK_IO_PROTOCOL_REVISION;
+  Disk->BlockIo.Media       = &Disk->Media;
+  Disk->BlockIo.FlushBlocks = Ext4HostFlushBlocks;
+  Disk->Media.MediaPresent  = TRUE;
+  Disk->Media.ReadOnly      = ReadOnly;
+  Disk->Media.BlockSize     = 512;
+  Disk->Media.LastBlock     = DivU64x32 (Size, 512) - 1;
+  Disk->Size                = Size;
+
+  return Disk;
+}
+
+/**
+   Creates a fake disk backed by a buffer. The buffer is not copied, and
+   must outlive the disk.
+
+   @param[in]      Buffer        Pointer to the disk's contents.
+   @param[in]      Size          Size of the disk, in bytes.
+   @param[in]      ReadOnly      TRUE if the disk is read-only.
+   @param[out]     Disk          Pointer to the new disk.
+
+   @retval EFI_SUCCESS           The disk was created.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4HostCreateDisk (
+  IN  VOID            *Buffer,
+  IN  UINT64          Size,
+  IN  BOOLEAN         ReadOnly,
+  OUT EXT4_HOST_DISK  **Disk
+  )
+{
+  *Disk = Ext4HostAllocateDisk (Size, ReadOnly);
+  if (*Disk == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  (*Disk)->Buffer = Buffer;
+  return EFI_SUCCESS;
+}
+
+/**
+   Creates a fake disk backed by an image file, such as one made by mke2fs.
+
+   @param[in]      Path          Path of the image file.
+   @param[in]      ReadOnly      TRUE if the disk is read-only.
+   @param[out]     Disk          Pointer to the new disk.
+
+   @retval EFI_SUCCESS           The disk was created.
+   @retval EFI_NOT_FOUND         The image couldn't be opened.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4HostOpenDiskImage (
+  IN  CONST CHAR8     *Path,
+  IN  BOOLEAN         ReadOnly,
+  OUT EXT4_HOST_DISK  **Disk
+  )
+{
+  FILE    *File;
+  UINT64  Size;
+
+  File = fopen (Path, ReadOnly ? "rb" : "r+b");
+  if (File == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (EXT4_HOST_FSEEK (File, 0, SEEK_END) != 0) {
+    fclose (File);
+    return EFI_DEVICE_ERROR;
+  }
+
+#if defined (_MSC_VER)
+  Size = _ftelli64 (File);
+#else
+  Size = ftello (File);
+#endif
+
+  *Disk = Ext4HostAllocateDisk (Size, ReadOnly);
+  if (*Disk == NULL) {
+    fclose (File);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  (*Disk)->File = File;
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees a fake disk, closing its image file if it has one.
+
+   @param[in]      Disk          Pointer to the disk.
+**/
+VOID
+Ext4HostFreeDisk (
+  IN EXT4_HOST_DISK  *Disk
+  )
+{
+  if (Disk->File != NULL) {
+    fclose (Disk->File);
+  }
+
+  FreePool (Disk);
+}
+
+/**
+   Mounts the ext4 filesystem on a fake disk. This is what Ext4OpenPartition
+   does, minus installing any protocols.
+
+   @param[in]      Disk          Pointer to the disk.
+   @param[out]     Partition     Pointer to the mounted partition.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4HostMount (
+  IN  EXT4_HOST_DISK  *Disk,
+  OUT EXT4_PARTITION  **Partition
+  )
+{
+  EXT4_PARTITION  *Part;
+  EFI_STATUS      Status;
+
+  Part = AllocateZeroPool (sizeof (*Part));
+  if (Part == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  InitializeListHead (&Part->OpenFiles);
+
+  Part->BlockIo = &Disk->BlockIo;
+  Part->DiskIo  = &Disk->DiskIo;
+
+  Status = Ext4OpenSuperblock (Part);
+  if (EFI_ERROR (Status)) {
+    FreePool (Part);
+    return Status;
+  }
+
+  *Partition = Part;
+  return EFI_SUCCESS;
+}
+
+/**
+   Opens a file, relative to the root directory of a mounted partition.
+
+   @param[in]      Partition     Pointer to the mounted partition.
+   @param[in]      Path          ASCII path of the file. Both '/' and '\\' work as separators.
+   @param[in]      OpenMode      Mode in which the file is opened.
+   @param[out]     File          Pointer to the opened file.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4HostOpen (
+  IN  EXT4_PARTITION     *Partition,
+  IN  CONST CHAR8        *Path,
+  IN  UINT64             OpenMode,
+  OUT EFI_FILE_PROTOCOL  **File
+  )
+{
+  CHAR16      *UnicodePath;
+  UINTN       Index;
+  UINTN       Length;
+  EFI_STATUS  Status;
+
+  Length      = AsciiStrLen (Path);
+  UnicodePath = AllocatePool ((Length + 1) * sizeof (CHAR16));
+  if (UnicodePath == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index <= Length; Index++) {
+    UnicodePath[Index] = (Path[Index] == '/') ? L'\\' : (CHAR16)(UINT8)Path[Index];
+  }
+
+  Status = Partition->Root->Protocol.Open (&Partition->Root->Protocol, File, UnicodePath, OpenMode, 0);
+
+  FreePool (UnicodePath);
+  return Status;
+}
+
+/**
+   Reads the host clock, for the benchmarks.
+
+   @return Current time, in nanoseconds.
+**/
+UINT64
+Ext4HostGetTimeNs (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  timespec_get (&Now, TIME_UTC);
+  return MultU64x32 ((UINT64)Now.tv_sec, 1000000000) + (UINT64)Now.tv_nsec;
+}
@@ -0,0 +1,143 @@
+/** @file
+  Host support for the Ext4Dxe unit tests, fuzzer and benchmark.
+
+  Ext4Dxe is built as a host application without its driver model glue
+  (Ext4Dxe.c) and without the Unicode Collation based name comparisons
+  (Collation.c). Partitions are mounted straight onto a fake disk, backed
+  either by a buffer or by an image file.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef EXT4_HOST_SUPPORT_H_
+#define EXT4_HOST_SUPPORT_H_
+
+#include "../Ext4Dxe.h"
+
+/**
+   Fake disk that produces the DiskIo and BlockIo protocols Ext4Dxe needs.
+   It also counts the I/O it does, so tests can check for it.
+ */
+typedef struct {
+  EFI_DISK_IO_PROTOCOL     DiskIo;
+  EFI_BLOCK_IO_PROTOCOL    BlockIo;
+  EFI_BLOCK_IO_MEDIA       Media;
+
+  // Exactly one of these backs the disk
+  UINT8                    *Buffer;
+  VOID                     *File;
+  UINT64                   Size;
+
+  UINT64                   ReadCalls;
+  UINT64                   ReadBytes;
+  UINT64                   WriteCalls;
+  UINT64                   WriteBytes;
+  UINT64                   FlushCalls;
+} EXT4_HOST_DISK;
+
+#define EXT4_HOST_DISK_FROM_DISK_IO(This)   BASE_CR (This, EXT4_HOST_DISK, DiskIo)
+#define EXT4_HOST_DISK_FROM_BLOCK_IO(This)  BASE_CR (This, EXT4_HOST_DISK, BlockIo)
+
+/**
+   Creates a fake disk backed by a buffer. The buffer is not copied, and
+   must outlive the disk.
+
+   @param[in]      Buffer        Pointer to the disk's contents.
+   @param[in]      Size          Size of the disk, in bytes.
+   @param[in]      ReadOnly      TRUE if the disk is read-only.
+   @param[out]     Disk          Pointer to the new disk.
+
+   @retval EFI_SUCCESS           The disk was created.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4HostCreateDisk (
+  IN  VOID            *Buffer,
+  IN  UINT64          Size,
+  IN  BOOLEAN         ReadOnly,
+  OUT EXT4_HOST_DISK  **Disk
+  );
+
+/**
+   Creates a fake disk backed by an image file, such as one made by mke2fs.
+
+   @param[in]      Path          Path of the image file.
+   @param[in]      ReadOnly      TRUE if the disk is read-only.
+   @param[out]     Disk          Pointer to the new disk.
+
+   @retval EFI_SUCCESS           The disk was created.
+   @retval EFI_NOT_FOUND         The image couldn't be opened.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4HostOpenDiskImage (
+  IN  CONST CHAR8     *Path,
+  IN  BOOLEAN         ReadOnly,
+  OUT EXT4_HOST_DISK  **Disk
+  );
+
+/**
+   Frees a fake disk, closing its image file if it has one.
+
+   @param[in]      Disk          Pointer to the disk.
+**/
+VOID
+Ext4HostFreeDisk (
+  IN EXT4_HOST_DISK  *Disk
+  );
+
+/**
+   Mounts the ext4 filesystem on a fake disk. This is what Ext4OpenPartition
+   does, minus installing any protocols.
+
+   @param[in]      Disk          Pointer to the disk.
+   @param[out]     Partition     Pointer to the mounted partition.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4HostMount (
+  IN  EXT4_HOST_DISK  *Disk,
+  OUT EXT4_PARTITION  **Partition
+  );
+
+/**
+   Opens a file, relative to the root directory of a mounted partition.
+
+   @param[in]      Partition     Pointer to the mounted partition.
+   @param[in]      Path          ASCII path of the file. Both '/' and '\\' work as separators.
+   @param[in]      OpenMode      Mode in which the file is opened.
+   @param[out]     File          Pointer to the opened file.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4HostOpen (
+  IN  EXT4_PARTITION     *Partition,
+  IN  CONST CHAR8        *Path,
+  IN  UINT64             OpenMode,
+  OUT EFI_FILE_PROTOCOL  **File
+  );
+
+/**
+   Sets what the fake real time clock (gRT->GetTime) reads.
+
+   @param[in]      Time          Pointer to the new time.
+**/
+VOID
+Ext4HostSetTime (
+  IN CONST EFI_TIME  *Time
+  );
+
+/**
+   Reads the host clock, for the benchmarks.
+
+   @return Current time, in nanoseconds.
+**/
+UINT64
+Ext4HostGetTimeNs (
+  VOID
+  );
+
+#endif
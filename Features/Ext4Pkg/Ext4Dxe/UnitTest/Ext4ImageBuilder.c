@@ -0,0 +1,1394 @@
+/** @file
+  Builds small ext4 images in memory, for the Ext4Dxe host tests.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "Ext4ImageBuilder.h"
+
+#define EXT4_IMAGE_LOST_FOUND_INODE_NR  11
+
+/**
+   Gets a pointer to a block of the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Block         Block number.
+
+   @return Pointer to the block.
+**/
+STATIC
+UINT8 *
+Ext4ImageBlock (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN UINT32              Block
+  )
+{
+  return Builder->Image + MultU64x32 (Block, Builder->BlockSize);
+}
+
+/**
+   Gets a pointer to an inode of the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number.
+
+   @return Pointer to the inode.
+**/
+EXT4_INODE *
+Ext4ImageInode (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode
+  )
+{
+  return (EXT4_INODE *)(Ext4ImageBlock (Builder, Builder->InodeTable) + (Inode - 1) * EXT4_IMAGE_INODE_SIZE);
+}
+
+/**
+   Marks a bit in a bitmap block as used.
+
+   @param[in]      Bitmap        Pointer to the bitmap.
+   @param[in]      Index         Index of the bit.
+**/
+STATIC
+VOID
+Ext4ImageSetBit (
+  IN UINT8   *Bitmap,
+  IN UINT32  Index
+  )
+{
+  Bitmap[Index / 8] |= (UINT8)(1 << (Index % 8));
+}
+
+/**
+   Counts the bits that are clear in the first Count bits of a bitmap.
+
+   @param[in]      Bitmap        Pointer to the bitmap.
+   @param[in]      Count         Number of bits to look at.
+
+   @return Number of clear bits.
+**/
+STATIC
+UINT32
+Ext4ImageCountFree (
+  IN CONST UINT8  *Bitmap,
+  IN UINT32       Count
+  )
+{
+  UINT32  Index;
+  UINT32  Free;
+
+  Free = 0;
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Bitmap[Index / 8] & (1 << (Index % 8))) == 0) {
+      Free++;
+    }
+  }
+
+  return Free;
+}
+
+/**
+   Allocates contiguous blocks, and marks them as used.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Count         Number of blocks.
+   @param[out]     Block         First allocated block.
+
+   @retval EFI_SUCCESS           The blocks were allocated.
+   @retval EFI_VOLUME_FULL       The image is full.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageAllocateBlocks (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  UINT32              Count,
+  OUT UINT32              *Block
+  )
+{
+  UINT32  Index;
+
+  if (Count > Builder->NumberBlocks - Builder->NextBlock) {
+    return EFI_VOLUME_FULL;
+  }
+
+  *Block = Builder->NextBlock;
+
+  for (Index = 0; Index < Count; Index++) {
+    Ext4ImageSetBit (
+      Ext4ImageBlock (Builder, Builder->BlockBitmap),
+      Builder->NextBlock + Index - Builder->FirstDataBlock
+      );
+  }
+
+  Builder->NextBlock += Count;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Allocates an inode, and fills in the fields every inode has.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Mode          Type and permissions of the inode.
+   @param[out]     Inode         Number of the allocated inode.
+
+   @retval EFI_SUCCESS           The inode was allocated.
+   @retval EFI_VOLUME_FULL       The image has no free inodes.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageAllocateInode (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  UINT16              Mode,
+  OUT EXT4_INO_NR         *Inode
+  )
+{
+  EXT4_INODE          *Ino;
+  EXT4_EXTENT_HEADER  *Header;
+
+  if (Builder->NextInode > Builder->NumberInodes) {
+    return EFI_VOLUME_FULL;
+  }
+
+  *Inode = Builder->NextInode++;
+  Ext4ImageSetBit (Ext4ImageBlock (Builder, Builder->InodeBitmap), *Inode - 1);
+
+  Ino                = Ext4ImageInode (Builder, *Inode);
+  Ino->i_mode        = Mode;
+  Ino->i_links       = 1;
+  Ino->i_atime       = EXT4_IMAGE_TIME;
+  Ino->i_ctime       = EXT4_IMAGE_TIME;
+  Ino->i_mtime       = EXT4_IMAGE_TIME;
+  Ino->i_crtime      = EXT4_IMAGE_TIME;
+  Ino->i_flags       = EXT4_EXTENTS_FL;
+  Ino->i_extra_isize = sizeof (EXT4_INODE) - EXT4_GOOD_OLD_INODE_SIZE;
+
+  Header           = (EXT4_EXTENT_HEADER *)Ino->i_data;
+  Header->eh_magic = EXT4_EXTENT_HEADER_MAGIC;
+  Header->eh_max   = (sizeof (Ino->i_data) - sizeof (EXT4_EXTENT_HEADER)) / sizeof (EXT4_EXTENT);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Maps a run of blocks into an inode, with a single extent.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number.
+   @param[in]      LogicalBlock  First logical block of the run.
+   @param[in]      Block         First physical block of the run.
+   @param[in]      Count         Length of the run, in blocks.
+
+   @retval EFI_SUCCESS           The run was mapped.
+   @retval EFI_OUT_OF_RESOURCES  The inode has no room for another extent.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageMapBlocks (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN UINT32              LogicalBlock,
+  IN UINT32              Block,
+  IN UINT16              Count
+  )
+{
+  EXT4_INODE          *Ino;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT         *Extent;
+
+  ASSERT (Count <= EXT4_EXTENT_MAX_INITIALIZED);
+
+  Ino    = Ext4ImageInode (Builder, Inode);
+  Header = (EXT4_EXTENT_HEADER *)Ino->i_data;
+
+  if (Header->eh_entries == Header->eh_max) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Extent              = (EXT4_EXTENT *)(Header + 1) + Header->eh_entries++;
+  Extent->ee_block    = LogicalBlock;
+  Extent->ee_len      = Count;
+  Extent->ee_start_lo = Block;
+
+  Ino->i_blocks += Count * (Builder->BlockSize / 512);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Finds a directory of the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the directory.
+
+   @return Pointer to the directory, or NULL if there's no such directory.
+**/
+STATIC
+EXT4_IMAGE_DIR *
+Ext4ImageFindDir (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Builder->NumDirs; Index++) {
+    if (Builder->Dirs[Index].Inode == Inode) {
+      return &Builder->Dirs[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Adds an entry to a directory.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the directory.
+   @param[in]      Name          UTF-8 name of the entry.
+   @param[in]      Inode         Inode number the entry points to.
+   @param[in]      FileType      EXT4_FT_* type of the entry.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageAddDirent (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Parent,
+  IN CONST CHAR8         *Name,
+  IN EXT4_INO_NR         Inode,
+  IN UINT8               FileType
+  )
+{
+  EXT4_IMAGE_DIR     *Dir;
+  EXT4_IMAGE_DIRENT  *Entries;
+  EXT4_IMAGE_DIRENT  *Entry;
+  UINTN              NameLength;
+  UINTN              NewMax;
+
+  Dir        = Ext4ImageFindDir (Builder, Parent);
+  NameLength = AsciiStrLen (Name);
+
+  if ((Dir == NULL) || (NameLength == 0) || (NameLength > EXT4_NAME_MAX)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Dir->NumEntries == Dir->MaxEntries) {
+    NewMax  = MAX (Dir->MaxEntries * 2, 16);
+    Entries = ReallocatePool (
+                Dir->MaxEntries * sizeof (EXT4_IMAGE_DIRENT),
+                NewMax * sizeof (EXT4_IMAGE_DIRENT),
+                Dir->Entries
+                );
+    if (Entries == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Dir->Entries    = Entries;
+    Dir->MaxEntries = NewMax;
+  }
+
+  Entry             = &Dir->Entries[Dir->NumEntries++];
+  Entry->Inode      = Inode;
+  Entry->FileType   = FileType;
+  Entry->NameLength = (UINT8)NameLength;
+  CopyMem (Entry->Name, Name, NameLength + 1);
+
+  if (FileType == EXT4_FT_DIR) {
+    Ext4ImageInode (Builder, Parent)->i_links++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Allocates a directory inode, without linking it anywhere.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[out]     Inode         Inode number of the new directory.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageCreateDir (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  OUT EXT4_INO_NR         *Inode
+  )
+{
+  EXT4_IMAGE_DIR  *Dirs;
+  EFI_STATUS      Status;
+
+  Dirs = ReallocatePool (
+           Builder->NumDirs * sizeof (EXT4_IMAGE_DIR),
+           (Builder->NumDirs + 1) * sizeof (EXT4_IMAGE_DIR),
+           Builder->Dirs
+           );
+  if (Dirs == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Builder->Dirs = Dirs;
+
+  Status = Ext4ImageAllocateInode (Builder, EXT4_INO_TYPE_DIR | 0755, Inode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // "." and the parent's entry
+  Ext4ImageInode (Builder, *Inode)->i_links = 2;
+
+  ZeroMem (&Dirs[Builder->NumDirs], sizeof (EXT4_IMAGE_DIR));
+  Dirs[Builder->NumDirs].Inode  = *Inode;
+  Dirs[Builder->NumDirs].Parent = (Parent == 0) ? *Inode : Parent;
+  Builder->NumDirs++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Creates an empty image, with just the root directory and lost+found.
+
+   @param[in]      BlockSize     Block size, from 1KiB to 64KiB.
+   @param[in]      NumberBlocks  Size of the image, in blocks. It must fit in a single block group.
+   @param[in]      NumberInodes  Number of inodes. It must be a multiple of the inodes per block.
+   @param[out]     Builder       Pointer to the new image builder.
+
+   @retval EFI_SUCCESS           The image was created.
+   @retval EFI_INVALID_PARAMETER The geometry is not supported.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4ImageCreate (
+  IN  UINT32              BlockSize,
+  IN  UINT32              NumberBlocks,
+  IN  UINT32              NumberInodes,
+  OUT EXT4_IMAGE_BUILDER  **Builder
+  )
+{
+  EXT4_IMAGE_BUILDER  *Image;
+  UINT32              FirstDataBlock;
+  UINT32              Block;
+  EXT4_INO_NR         Inode;
+  EFI_STATUS          Status;
+
+  FirstDataBlock = (BlockSize == 1024) ? 1 : 0;
+
+  if ((BlockSize < 1024) || (BlockSize > SIZE_64KB) || ((BlockSize & (BlockSize - 1)) != 0) ||
+      (NumberBlocks <= FirstDataBlock) || (NumberBlocks - FirstDataBlock > 8 * BlockSize) ||
+      (NumberInodes < EXT4_IMAGE_LOST_FOUND_INODE_NR) || (NumberInodes > 8 * BlockSize) ||
+      ((NumberInodes % (BlockSize / EXT4_IMAGE_INODE_SIZE)) != 0))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Image = AllocateZeroPool (sizeof (EXT4_IMAGE_BUILDER));
+  if (Image == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Image->Size  = MultU64x32 (NumberBlocks, BlockSize);
+  Image->Image = AllocateZeroPool (Image->Size);
+  if (Image->Image == NULL) {
+    FreePool (Image);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Image->BlockSize      = BlockSize;
+  Image->NumberBlocks   = NumberBlocks;
+  Image->NumberInodes   = NumberInodes;
+  Image->FirstDataBlock = FirstDataBlock;
+
+  // Superblock, then the descriptor table, the bitmaps and the inode table
+  Image->BlockBitmap = FirstDataBlock + 2;
+  Image->InodeBitmap = FirstDataBlock + 3;
+  Image->InodeTable  = FirstDataBlock + 4;
+  Image->NextBlock   = FirstDataBlock;
+  Image->NextInode   = 1;
+
+  Status = Ext4ImageAllocateBlocks (
+             Image,
+             4 + NumberInodes / (BlockSize / EXT4_IMAGE_INODE_SIZE),
+             &Block
+             );
+  if (EFI_ERROR (Status)) {
+    Ext4ImageFree (Image);
+    return Status;
+  }
+
+  // Inodes below the first non-reserved one are never handed out
+  while (Image->NextInode < EXT4_ROOT_INODE_NR) {
+    Ext4ImageSetBit (Ext4ImageBlock (Image, Image->InodeBitmap), Image->NextInode++ - 1);
+  }
+
+  Status = Ext4ImageCreateDir (Image, 0, &Inode);
+  ASSERT (EFI_ERROR (Status) || Inode == EXT4_ROOT_INODE_NR);
+
+  while (!EFI_ERROR (Status) && Image->NextInode < EXT4_IMAGE_LOST_FOUND_INODE_NR) {
+    Ext4ImageSetBit (Ext4ImageBlock (Image, Image->InodeBitmap), Image->NextInode++ - 1);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirectory (Image, EXT4_ROOT_INODE_NR, "lost+found", NULL);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Ext4ImageFree (Image);
+    return Status;
+  }
+
+  *Builder = Image;
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds a directory to the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new directory.
+   @param[out]     Inode         Inode number of the new directory. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddDirectory (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  )
+{
+  EXT4_INO_NR  DirInode;
+  EFI_STATUS   Status;
+
+  if (Ext4ImageFindDir (Builder, Parent) == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Ext4ImageCreateDir (Builder, Parent, &DirInode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4ImageAddDirent (Builder, Parent, Name, DirInode, EXT4_FT_DIR);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Inode != NULL) {
+    *Inode = DirInode;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Makes a directory of the image be laid out with a hash tree index (htree),
+   with a second level of index nodes if the root can't point to every leaf.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the directory.
+
+   @retval EFI_SUCCESS           The directory will be indexed.
+   @retval EFI_INVALID_PARAMETER There's no such directory.
+**/
+EFI_STATUS
+Ext4ImageIndexDirectory (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode
+  )
+{
+  EXT4_IMAGE_DIR  *Dir;
+
+  Dir = Ext4ImageFindDir (Builder, Inode);
+  if (Dir == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dir->Indexed = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds a regular file, stored contiguously, to the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new file.
+   @param[in]      Size          Size of the file, in bytes.
+   @param[out]     Inode         Inode number of the new file. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddFile (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  IN  UINT64              Size,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  )
+{
+  EXT4_INO_NR  FileInode;
+  EXT4_INODE   *Ino;
+  UINT64       NumberBlocks;
+  UINT32       LogicalBlock;
+  UINT32       Block;
+  UINT32       Count;
+  UINT64       Offset;
+  UINT8        *Data;
+  EFI_STATUS   Status;
+
+  NumberBlocks = DivU64x32 (Size + Builder->BlockSize - 1, Builder->BlockSize);
+
+  if ((Ext4ImageFindDir (Builder, Parent) == NULL) || (NumberBlocks > Builder->NumberBlocks)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Ext4ImageAllocateInode (Builder, EXT4_INO_TYPE_REGFILE | 0644, &FileInode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Ino            = Ext4ImageInode (Builder, FileInode);
+  Ino->i_size_lo = (UINT32)Size;
+  Ino->i_size_hi = (UINT32)RShiftU64 (Size, 32);
+
+  for (LogicalBlock = 0; LogicalBlock < NumberBlocks; LogicalBlock += Count) {
+    Count  = (UINT32)MIN (NumberBlocks - LogicalBlock, EXT4_EXTENT_MAX_INITIALIZED);
+    Status = Ext4ImageAllocateBlocks (Builder, Count, &Block);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Status = Ext4ImageMapBlocks (Builder, FileInode, LogicalBlock, Block, (UINT16)Count);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Data   = Ext4ImageBlock (Builder, Block);
+    Offset = MultU64x32 (LogicalBlock, Builder->BlockSize);
+
+    for ( ; Offset < MIN (Size, MultU64x32 (LogicalBlock + Count, Builder->BlockSize)); Offset++) {
+      *Data++ = Ext4ImagePatternByte (FileInode, Offset);
+    }
+  }
+
+  Status = Ext4ImageAddDirent (Builder, Parent, Name, FileInode, EXT4_FT_REG_FILE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Inode != NULL) {
+    *Inode = FileInode;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes a file's extents, in the inode if they fit, or else in extent tree
+   leaf blocks pointed to by the inode.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number.
+   @param[in]      Extents       Pointer to the extents, sorted by logical block.
+   @param[in]      Count         Number of extents.
+
+   @retval EFI_SUCCESS           The extents were written.
+   @retval EFI_OUT_OF_RESOURCES  The extents need a deeper tree than this supports.
+   @retval EFI_VOLUME_FULL       The image is full.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageWriteExtents (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN CONST EXT4_EXTENT   *Extents,
+  IN UINTN               Count
+  )
+{
+  EXT4_INODE          *Ino;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT_HEADER  *LeafHeader;
+  EXT4_EXTENT_INDEX   *Index;
+  UINTN               PerLeaf;
+  UINTN               Leaf;
+  UINTN               InLeaf;
+  UINT32              Block;
+  EFI_STATUS          Status;
+
+  Ino    = Ext4ImageInode (Builder, Inode);
+  Header = (EXT4_EXTENT_HEADER *)Ino->i_data;
+
+  if (Count <= Header->eh_max) {
+    CopyMem (Header + 1, Extents, Count * sizeof (EXT4_EXTENT));
+    Header->eh_entries = (UINT16)Count;
+    return EFI_SUCCESS;
+  }
+
+  PerLeaf = EXT4_BLOCK_EXTENT_ENTRIES (Builder->BlockSize);
+
+  if ((Count + PerLeaf - 1) / PerLeaf > Header->eh_max) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Header->eh_depth = 1;
+  Index            = (EXT4_EXTENT_INDEX *)(Header + 1);
+
+  for (Leaf = 0; Leaf < Count; Leaf += InLeaf) {
+    InLeaf = MIN (PerLeaf, Count - Leaf);
+
+    Status = Ext4ImageAllocateBlocks (Builder, 1, &Block);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    LeafHeader             = (EXT4_EXTENT_HEADER *)Ext4ImageBlock (Builder, Block);
+    LeafHeader->eh_magic   = EXT4_EXTENT_HEADER_MAGIC;
+    LeafHeader->eh_entries = (UINT16)InLeaf;
+    LeafHeader->eh_max     = (UINT16)PerLeaf;
+    CopyMem (LeafHeader + 1, Extents + Leaf, InLeaf * sizeof (EXT4_EXTENT));
+
+    Index[Header->eh_entries].ei_block   = Extents[Leaf].ee_block;
+    Index[Header->eh_entries].ei_leaf_lo = Block;
+    Header->eh_entries++;
+
+    Ino->i_blocks += Builder->BlockSize / 512;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds a regular file, made of many small extents, to the image. Files with
+   more extents than fit in the inode get a one level deep extent tree.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new file.
+   @param[in]      Size          Size of the file, in bytes.
+   @param[in]      ExtentBlocks  Length of every extent, in blocks.
+   @param[in]      Flags         EXT4_IMAGE_FRAGMENT_* flags.
+   @param[out]     Inode         Inode number of the new file. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddFragmentedFile (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  IN  UINT64              Size,
+  IN  UINT32              ExtentBlocks,
+  IN  UINT32              Flags,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  )
+{
+  EXT4_INO_NR  FileInode;
+  EXT4_INODE   *Ino;
+  EXT4_EXTENT  *Extents;
+  UINTN        Count;
+  UINTN        Run;
+  UINT64       NumberBlocks;
+  UINT32       LogicalBlock;
+  UINT32       Block;
+  UINT32       Length;
+  UINT64       Offset;
+  UINT8        *Data;
+  EFI_STATUS   Status;
+
+  NumberBlocks = DivU64x32 (Size + Builder->BlockSize - 1, Builder->BlockSize);
+
+  if ((Ext4ImageFindDir (Builder, Parent) == NULL) || (NumberBlocks > Builder->NumberBlocks) ||
+      (ExtentBlocks == 0) || (ExtentBlocks > EXT4_EXTENT_MAX_INITIALIZED) ||
+      (((Flags & EXT4_IMAGE_FRAGMENT_UNWRITTEN) != 0) && (ExtentBlocks == EXT4_EXTENT_MAX_INITIALIZED)))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Ext4ImageAllocateInode (Builder, EXT4_INO_TYPE_REGFILE | 0644, &FileInode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Ino            = Ext4ImageInode (Builder, FileInode);
+  Ino->i_size_lo = (UINT32)Size;
+  Ino->i_size_hi = (UINT32)RShiftU64 (Size, 32);
+
+  Extents = AllocatePool ((UINTN)(NumberBlocks / ExtentBlocks + 1) * sizeof (EXT4_EXTENT));
+  if (Extents == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Count = 0;
+
+  for (LogicalBlock = 0, Run = 0; LogicalBlock < NumberBlocks; LogicalBlock += Length, Run++) {
+    Length = (UINT32)MIN (NumberBlocks - LogicalBlock, ExtentBlocks);
+
+    if (((Flags & EXT4_IMAGE_FRAGMENT_HOLES) != 0) && ((Run % 3) == 2)) {
+      continue;
+    }
+
+    Status = Ext4ImageAllocateBlocks (Builder, Length, &Block);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    // The gap is left free
+    if (((Flags & EXT4_IMAGE_FRAGMENT_GAPS) != 0) && (Builder->NextBlock < Builder->NumberBlocks)) {
+      Builder->NextBlock++;
+    }
+
+    Extents[Count].ee_block    = LogicalBlock;
+    Extents[Count].ee_len      = (UINT16)Length;
+    Extents[Count].ee_start_hi = 0;
+    Extents[Count].ee_start_lo = Block;
+    Count++;
+
+    Ino->i_blocks += Length * (Builder->BlockSize / 512);
+
+    Data = Ext4ImageBlock (Builder, Block);
+
+    if ((Flags & EXT4_IMAGE_FRAGMENT_UNWRITTEN) != 0) {
+      Extents[Count - 1].ee_len += EXT4_EXTENT_MAX_INITIALIZED;
+      SetMem (Data, Length * Builder->BlockSize, EXT4_IMAGE_UNWRITTEN_BYTE);
+      continue;
+    }
+
+    Offset = MultU64x32 (LogicalBlock, Builder->BlockSize);
+
+    for ( ; Offset < MIN (Size, MultU64x32 (LogicalBlock + Length, Builder->BlockSize)); Offset++) {
+      *Data++ = Ext4ImagePatternByte (FileInode, Offset);
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageWriteExtents (Builder, FileInode, Extents, Count);
+  }
+
+  FreePool (Extents);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAddDirent (Builder, Parent, Name, FileInode, EXT4_FT_REG_FILE);
+  }
+
+  if (!EFI_ERROR (Status) && (Inode != NULL)) {
+    *Inode = FileInode;
+  }
+
+  return Status;
+}
+
+/**
+   Appends an entry to a directory block being laid out. When the entry doesn't
+   fit, the block is closed off and a new one is started.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in out]  Buffer        Pointer to the directory's contents, grown as needed.
+   @param[in out]  Length        Length of the directory's contents, in bytes.
+   @param[in out]  Last          Offset of the last entry in the current block.
+   @param[in]      Name          Name of the entry.
+   @param[in]      NameLength    Length of the name.
+   @param[in]      Inode         Inode number the entry points to.
+   @param[in]      FileType      EXT4_FT_* type of the entry.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageAppendDirent (
+  IN     EXT4_IMAGE_BUILDER  *Builder,
+  IN OUT UINT8               **Buffer,
+  IN OUT UINTN               *Length,
+  IN OUT UINTN               *Last,
+  IN     CONST CHAR8         *Name,
+  IN     UINT8               NameLength,
+  IN     EXT4_INO_NR         Inode,
+  IN     UINT8               FileType
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  UINTN           EntryLength;
+  UINTN           Offset;
+  UINT8           *NewBuffer;
+
+  EntryLength = ALIGN_VALUE (EXT4_MIN_DIR_ENTRY_LEN + NameLength, 4);
+
+  if ((*Length == 0) || ((*Last % Builder->BlockSize) + ((EXT4_DIR_ENTRY *)(*Buffer + *Last))->rec_len + EntryLength >
+                         Builder->BlockSize))
+  {
+    if (*Length != 0) {
+      // The last entry of a block covers the rest of it
+      Entry          = (EXT4_DIR_ENTRY *)(*Buffer + *Last);
+      Entry->rec_len = (UINT16)(*Length - *Last);
+    }
+
+    NewBuffer = ReallocatePool (*Length, *Length + Builder->BlockSize, *Buffer);
+    if (NewBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    *Buffer = NewBuffer;
+    Offset  = *Length;
+    *Length = *Length + Builder->BlockSize;
+  } else {
+    Offset = *Last + ((EXT4_DIR_ENTRY *)(*Buffer + *Last))->rec_len;
+  }
+
+  Entry            = (EXT4_DIR_ENTRY *)(*Buffer + Offset);
+  Entry->inode     = Inode;
+  Entry->rec_len   = (UINT16)EntryLength;
+  Entry->name_len  = NameLength;
+  Entry->file_type = FileType;
+  CopyMem (Entry->name, Name, NameLength);
+
+  *Last = Offset;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Lays out a directory as a linear list of entries.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Dir           Pointer to the directory.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageWriteDir (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_IMAGE_DIR      *Dir
+  )
+{
+  UINT8           *Buffer;
+  UINTN           Length;
+  UINTN           Last;
+  UINTN           Index;
+  UINT32          Block;
+  EXT4_INODE      *Ino;
+  EXT4_DIR_ENTRY  *Entry;
+  EFI_STATUS      Status;
+
+  Buffer = NULL;
+  Length = 0;
+  Last   = 0;
+
+  Status = Ext4ImageAppendDirent (Builder, &Buffer, &Length, &Last, ".", 1, Dir->Inode, EXT4_FT_DIR);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageAppendDirent (Builder, &Buffer, &Length, &Last, "..", 2, Dir->Parent, EXT4_FT_DIR);
+  }
+
+  for (Index = 0; !EFI_ERROR (Status) && Index < Dir->NumEntries; Index++) {
+    Status = Ext4ImageAppendDirent (
+               Builder,
+               &Buffer,
+               &Length,
+               &Last,
+               Dir->Entries[Index].Name,
+               Dir->Entries[Index].NameLength,
+               Dir->Entries[Index].Inode,
+               Dir->Entries[Index].FileType
+               );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Entry          = (EXT4_DIR_ENTRY *)(Buffer + Last);
+    Entry->rec_len = (UINT16)(Length - Last);
+
+    Status = Ext4ImageAllocateBlocks (Builder, (UINT32)(Length / Builder->BlockSize), &Block);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageMapBlocks (Builder, Dir->Inode, 0, Block, (UINT16)(Length / Builder->BlockSize));
+  }
+
+  if (!EFI_ERROR (Status)) {
+    CopyMem (Ext4ImageBlock (Builder, Block), Buffer, Length);
+
+    Ino            = Ext4ImageInode (Builder, Dir->Inode);
+    Ino->i_size_lo = (UINT32)Length;
+  }
+
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  return Status;
+}
+
+/**
+   Fills in an htree index node: its count and limit, and entries pointing to
+   consecutive blocks.
+
+   @param[in]      Entries       Pointer to the node's EXT4_DX_ENTRY array.
+   @param[in]      Limit         Number of entries that fit in the node.
+   @param[in]      Hashes        Pointer to the lowest hash of each block.
+   @param[in]      FirstBlock    Logical block the first entry points to.
+   @param[in]      Count         Number of entries.
+**/
+STATIC
+VOID
+Ext4ImageFillDxNode (
+  IN EXT4_DX_ENTRY  *Entries,
+  IN UINTN          Limit,
+  IN CONST UINT32   *Hashes,
+  IN UINT32         FirstBlock,
+  IN UINTN          Count
+  )
+{
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  UINTN                Index;
+
+  ASSERT (Count != 0 && Count <= Limit);
+
+  // Entry 0 has the count and limit in place of its hash
+  CountLimit        = (EXT4_DX_COUNT_LIMIT *)Entries;
+  CountLimit->limit = (UINT16)Limit;
+  CountLimit->count = (UINT16)Count;
+  Entries[0].block  = FirstBlock;
+
+  for (Index = 1; Index < Count; Index++) {
+    Entries[Index].hash  = Hashes[Index];
+    Entries[Index].block = FirstBlock + (UINT32)Index;
+  }
+}
+
+/**
+   Lays out a directory with a hash tree index: the root in block 0, then the
+   interior index nodes if any, then the leaves, with the entries sorted by hash.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Dir           Pointer to the directory. It must have entries.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ImageWriteIndexedDir (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_IMAGE_DIR      *Dir
+  )
+{
+  EXT4_PARTITION     *Partition;
+  UINT32             *Hashes;
+  UINTN              *Order;
+  UINT32             *LeafHashes;
+  UINT32             *NodeHashes;
+  UINT8              *Leaves;
+  UINT8              *Index;
+  UINTN              Length;
+  UINTN              Last;
+  UINTN              NumLeaves;
+  UINTN              NumNodes;
+  UINTN              RootLimit;
+  UINTN              NodeLimit;
+  UINTN              Entry;
+  UINTN              Other;
+  UINTN              Node;
+  UINTN              IndexLength;
+  UINT32             Block;
+  EXT4_DX_ROOT       *Root;
+  EXT4_DX_NODE       *DxNode;
+  EXT4_IMAGE_DIRENT  *Dirent;
+  EXT4_INODE         *Ino;
+  EFI_STATUS         Status;
+
+  ASSERT (Dir->NumEntries != 0);
+
+  Leaves     = NULL;
+  Index      = NULL;
+  Length     = 0;
+  Last       = 0;
+  NumLeaves  = 0;
+  Partition  = AllocateZeroPool (sizeof (EXT4_PARTITION));
+  Hashes     = AllocatePool (Dir->NumEntries * sizeof (UINT32));
+  Order      = AllocatePool (Dir->NumEntries * sizeof (UINTN));
+  LeafHashes = AllocatePool (Dir->NumEntries * sizeof (UINT32));
+  NodeHashes = AllocatePool (Dir->NumEntries * sizeof (UINT32));
+
+  if ((Partition == NULL) || (Hashes == NULL) || (Order == NULL) || (LeafHashes == NULL) || (NodeHashes == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  // Ext4DirHash only needs the seed out of the partition
+  CopyMem (
+    Partition->SuperBlock.s_hash_seed,
+    ((EXT4_SUPERBLOCK *)(Builder->Image + EXT4_SUPERBLOCK_OFFSET))->s_hash_seed,
+    sizeof (Partition->SuperBlock.s_hash_seed)
+    );
+
+  Status = EFI_SUCCESS;
+
+  // Insertion sort by hash; directories are at most a few thousand entries
+  for (Entry = 0; Entry < Dir->NumEntries && !EFI_ERROR (Status); Entry++) {
+    Dirent = &Dir->Entries[Entry];
+    Status = Ext4DirHash (Partition, EXT4_DX_HASH_HALF_MD4, Dirent->Name, Dirent->NameLength, &Hashes[Entry]);
+
+    for (Other = Entry; Other > 0 && Hashes[Order[Other - 1]] > Hashes[Entry]; Other--) {
+      Order[Other] = Order[Other - 1];
+    }
+
+    Order[Other] = Entry;
+  }
+
+  for (Entry = 0; Entry < Dir->NumEntries && !EFI_ERROR (Status); Entry++) {
+    Dirent = &Dir->Entries[Order[Entry]];
+    Other  = Length;
+    Status = Ext4ImageAppendDirent (
+               Builder,
+               &Leaves,
+               &Length,
+               &Last,
+               Dirent->Name,
+               Dirent->NameLength,
+               Dirent->Inode,
+               Dirent->FileType
+               );
+
+    if (Length != Other) {
+      // A new leaf. If it starts in the middle of a run of equal hashes,
+      // its index entry gets the collision bit.
+      LeafHashes[NumLeaves] = Hashes[Order[Entry]];
+      if ((Entry != 0) && (Hashes[Order[Entry - 1]] == Hashes[Order[Entry]])) {
+        LeafHashes[NumLeaves] |= 1;
+      }
+
+      NumLeaves++;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  ((EXT4_DIR_ENTRY *)(Leaves + Last))->rec_len = (UINT16)(Length - Last);
+
+  RootLimit = (Builder->BlockSize - sizeof (EXT4_DX_ROOT)) / sizeof (EXT4_DX_ENTRY);
+  NodeLimit = (Builder->BlockSize - sizeof (EXT4_DX_NODE)) / sizeof (EXT4_DX_ENTRY);
+  NumNodes  = (NumLeaves <= RootLimit) ? 0 : (NumLeaves + NodeLimit - 1) / NodeLimit;
+
+  if (NumNodes > RootLimit) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  IndexLength = (1 + NumNodes) * Builder->BlockSize;
+  Index       = AllocateZeroPool (IndexLength);
+  if (Index == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  Root                        = (EXT4_DX_ROOT *)Index;
+  Root->dot.inode             = Dir->Inode;
+  Root->dot.rec_len           = OFFSET_OF (EXT4_DX_ROOT, dotdot);
+  Root->dot.name_len          = 1;
+  Root->dot.file_type         = EXT4_FT_DIR;
+  Root->dot_name[0]           = '.';
+  Root->dotdot.inode          = Dir->Parent;
+  Root->dotdot.rec_len        = (UINT16)(Builder->BlockSize - OFFSET_OF (EXT4_DX_ROOT, dotdot));
+  Root->dotdot.name_len       = 2;
+  Root->dotdot.file_type      = EXT4_FT_DIR;
+  Root->dotdot_name[0]        = '.';
+  Root->dotdot_name[1]        = '.';
+  Root->info.hash_version     = EXT4_DX_HASH_HALF_MD4;
+  Root->info.info_length      = sizeof (EXT4_DX_ROOT_INFO);
+  Root->info.indirect_levels  = (NumNodes != 0) ? 1 : 0;
+
+  if (NumNodes == 0) {
+    Ext4ImageFillDxNode ((EXT4_DX_ENTRY *)(Root + 1), RootLimit, LeafHashes, 1, NumLeaves);
+  } else {
+    for (Node = 0; Node < NumNodes; Node++) {
+      DxNode               = (EXT4_DX_NODE *)(Index + (1 + Node) * Builder->BlockSize);
+      DxNode->fake.rec_len = (UINT16)Builder->BlockSize;
+      NodeHashes[Node]     = LeafHashes[Node * NodeLimit];
+
+      Ext4ImageFillDxNode (
+        (EXT4_DX_ENTRY *)(DxNode + 1),
+        NodeLimit,
+        LeafHashes + Node * NodeLimit,
+        (UINT32)(1 + NumNodes + Node * NodeLimit),
+        MIN (NodeLimit, NumLeaves - Node * NodeLimit)
+        );
+    }
+
+    Ext4ImageFillDxNode ((EXT4_DX_ENTRY *)(Root + 1), RootLimit, NodeHashes, 1, NumNodes);
+  }
+
+  Status = Ext4ImageAllocateBlocks (Builder, (UINT32)((IndexLength + Length) / Builder->BlockSize), &Block);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ImageMapBlocks (Builder, Dir->Inode, 0, Block, (UINT16)((IndexLength + Length) / Builder->BlockSize));
+  }
+
+  if (!EFI_ERROR (Status)) {
+    CopyMem (Ext4ImageBlock (Builder, Block), Index, IndexLength);
+    CopyMem (Ext4ImageBlock (Builder, Block) + IndexLength, Leaves, Length);
+
+    Ino            = Ext4ImageInode (Builder, Dir->Inode);
+    Ino->i_size_lo = (UINT32)(IndexLength + Length);
+    Ino->i_flags  |= EXT4_INDEX_FL;
+  }
+
+Out:
+  if (Index != NULL) {
+    FreePool (Index);
+  }
+
+  if (Leaves != NULL) {
+    FreePool (Leaves);
+  }
+
+  if (NodeHashes != NULL) {
+    FreePool (NodeHashes);
+  }
+
+  if (LeafHashes != NULL) {
+    FreePool (LeafHashes);
+  }
+
+  if (Order != NULL) {
+    FreePool (Order);
+  }
+
+  if (Hashes != NULL) {
+    FreePool (Hashes);
+  }
+
+  if (Partition != NULL) {
+    FreePool (Partition);
+  }
+
+  return Status;
+}
+
+/**
+   Lays out the directories, and writes the bitmaps, the block group descriptor
+   and the superblock. Nothing can be added to the image after this.
+
+   @param[in]      Builder       Pointer to the image builder.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageFinish (
+  IN EXT4_IMAGE_BUILDER  *Builder
+  )
+{
+  EXT4_SUPERBLOCK        *Sb;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *BlockBitmap;
+  UINT8                  *InodeBitmap;
+  UINT32                 GroupBlocks;
+  UINT32                 Index;
+  EFI_STATUS             Status;
+
+  Sb = (EXT4_SUPERBLOCK *)(Builder->Image + EXT4_SUPERBLOCK_OFFSET);
+
+  // Indexed directories are hashed with the seed
+  for (Index = 0; Index < ARRAY_SIZE (Sb->s_hash_seed); Index++) {
+    Sb->s_hash_seed[Index] = 0x9E3779B9 * (Index + 1);
+  }
+
+  for (Index = 0; Index < Builder->NumDirs; Index++) {
+    if (Builder->Dirs[Index].Indexed && (Builder->Dirs[Index].NumEntries != 0)) {
+      Status = Ext4ImageWriteIndexedDir (Builder, &Builder->Dirs[Index]);
+    } else {
+      Status = Ext4ImageWriteDir (Builder, &Builder->Dirs[Index]);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  BlockBitmap = Ext4ImageBlock (Builder, Builder->BlockBitmap);
+  InodeBitmap = Ext4ImageBlock (Builder, Builder->InodeBitmap);
+  GroupBlocks = Builder->NumberBlocks - Builder->FirstDataBlock;
+
+  // The bitmaps are padded out with ones, up to the end of the block
+  for (Index = GroupBlocks; Index < 8 * Builder->BlockSize; Index++) {
+    Ext4ImageSetBit (BlockBitmap, Index);
+  }
+
+  for (Index = Builder->NumberInodes; Index < 8 * Builder->BlockSize; Index++) {
+    Ext4ImageSetBit (InodeBitmap, Index);
+  }
+
+  Desc                          = (EXT4_BLOCK_GROUP_DESC *)Ext4ImageBlock (Builder, Builder->FirstDataBlock + 1);
+  Desc->bg_block_bitmap_lo      = Builder->BlockBitmap;
+  Desc->bg_inode_bitmap_lo      = Builder->InodeBitmap;
+  Desc->bg_inode_table_lo       = Builder->InodeTable;
+  Desc->bg_free_blocks_count_lo = (UINT16)Ext4ImageCountFree (BlockBitmap, GroupBlocks);
+  Desc->bg_free_inodes_count_lo = (UINT16)Ext4ImageCountFree (InodeBitmap, Builder->NumberInodes);
+  Desc->bg_used_dirs_count_lo   = (UINT16)Builder->NumDirs;
+
+  Sb->s_inodes_count       = Builder->NumberInodes;
+  Sb->s_blocks_count       = Builder->NumberBlocks;
+  Sb->s_free_blocks_count  = Desc->bg_free_blocks_count_lo;
+  Sb->s_free_inodes_count  = Desc->bg_free_inodes_count_lo;
+  Sb->s_first_data_block   = Builder->FirstDataBlock;
+  Sb->s_log_block_size     = (UINT32)HighBitSet32 (Builder->BlockSize) - EXT4_MIN_BLOCK_LOG_SIZE;
+  Sb->s_log_frag_size      = Sb->s_log_block_size;
+  Sb->s_blocks_per_group   = 8 * Builder->BlockSize;
+  Sb->s_frags_per_group    = 8 * Builder->BlockSize;
+  Sb->s_inodes_per_group   = Builder->NumberInodes;
+  Sb->s_wtime              = EXT4_IMAGE_TIME;
+  Sb->s_max_mnt_count      = 0xFFFF;
+  Sb->s_magic              = EXT4_SIGNATURE;
+  Sb->s_state              = EXT4_FS_STATE_UNMOUNTED;
+  Sb->s_errors             = EXT4_ERRORS_CONTINUE;
+  Sb->s_lastcheck          = EXT4_IMAGE_TIME;
+  Sb->s_rev_level          = EXT4_DYNAMIC_REV;
+  Sb->s_first_ino          = EXT4_IMAGE_LOST_FOUND_INODE_NR;
+  Sb->s_inode_size         = EXT4_IMAGE_INODE_SIZE;
+  Sb->s_feature_compat     = EXT4_FEATURE_COMPAT_DIR_INDEX;
+  Sb->s_feature_incompat   = EXT4_FEATURE_INCOMPAT_FILETYPE | EXT4_FEATURE_INCOMPAT_EXTENTS;
+  Sb->s_feature_ro_compat  = EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER | EXT4_FEATURE_RO_COMPAT_LARGE_FILE |
+                             EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE;
+  Sb->s_mkfs_time          = EXT4_IMAGE_TIME;
+  Sb->s_min_extra_isize    = sizeof (EXT4_INODE) - EXT4_GOOD_OLD_INODE_SIZE;
+  Sb->s_want_extra_isize   = sizeof (EXT4_INODE) - EXT4_GOOD_OLD_INODE_SIZE;
+  Sb->s_def_hash_version   = EXT4_DX_HASH_HALF_MD4;
+  Sb->s_flags              = EXT4_FLAGS_SIGNED_HASH;
+
+  for (Index = 0; Index < sizeof (Sb->s_uuid); Index++) {
+    Sb->s_uuid[Index] = (UINT8)(0x10 + Index);
+  }
+
+  CopyMem (Sb->s_volume_name, "ext4-host-test", sizeof ("ext4-host-test"));
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets the extent that maps a block of a file (or directory) in the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      LogicalBlock  Block of the file.
+
+   @return Pointer to the extent, or NULL if the block isn't mapped.
+**/
+EXT4_EXTENT *
+Ext4ImageFileExtent (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN UINT64              LogicalBlock
+  )
+{
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT_INDEX   *TreeIndex;
+  EXT4_EXTENT         *Extent;
+  UINT16              Index;
+
+  Header = (EXT4_EXTENT_HEADER *)Ext4ImageInode (Builder, Inode)->i_data;
+
+  // Trees are at most one level deep; find the leaf that covers the block
+  if (Header->eh_depth != 0) {
+    TreeIndex = (EXT4_EXTENT_INDEX *)(Header + 1);
+    for (Index = 1; Index < Header->eh_entries; Index++) {
+      if (TreeIndex[Index].ei_block > LogicalBlock) {
+        break;
+      }
+    }
+
+    Header = (EXT4_EXTENT_HEADER *)Ext4ImageBlock (Builder, TreeIndex[Index - 1].ei_leaf_lo);
+  }
+
+  Extent = (EXT4_EXTENT *)(Header + 1);
+
+  for (Index = 0; Index < Header->eh_entries; Index++, Extent++) {
+    if ((LogicalBlock >= Extent->ee_block) && (LogicalBlock < Extent->ee_block + Ext4GetExtentLength (Extent))) {
+      return Extent;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Gets a pointer to the data at an offset of a file (or directory) in the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Offset        Offset in the file.
+
+   @return Pointer into the image, or NULL if the offset isn't mapped.
+**/
+UINT8 *
+Ext4ImageFileData (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN UINT64              Offset
+  )
+{
+  EXT4_EXTENT  *Extent;
+  UINT32       Remainder;
+  UINT64       LogicalBlock;
+
+  LogicalBlock = DivU64x32Remainder (Offset, Builder->BlockSize, &Remainder);
+  Extent       = Ext4ImageFileExtent (Builder, Inode, LogicalBlock);
+
+  if (Extent == NULL) {
+    return NULL;
+  }
+
+  return Ext4ImageBlock (Builder, (UINT32)(Extent->ee_start_lo + LogicalBlock - Extent->ee_block)) + Remainder;
+}
+
+/**
+   Frees an image builder, along with its image.
+
+   @param[in]      Builder       Pointer to the image builder.
+**/
+VOID
+Ext4ImageFree (
+  IN EXT4_IMAGE_BUILDER  *Builder
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Builder->NumDirs; Index++) {
+    if (Builder->Dirs[Index].Entries != NULL) {
+      FreePool (Builder->Dirs[Index].Entries);
+    }
+  }
+
+  if (Builder->Dirs != NULL) {
+    FreePool (Builder->Dirs);
+  }
+
+  FreePool (Builder->Image);
+  FreePool (Builder);
+}
+
+/**
+   Gets a byte of the contents of a file made by the image builder.
+
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Offset        Offset of the byte in the file.
+
+   @return The byte.
+**/
+UINT8
+Ext4ImagePatternByte (
+  IN EXT4_INO_NR  Inode,
+  IN UINT64       Offset
+  )
+{
+  // Mix in the higher bits, so a block that's read from the wrong place doesn't match
+  return (UINT8)(Offset ^ RShiftU64 (Offset, 8) ^ RShiftU64 (Offset, 16) ^ RShiftU64 (Offset, 24) ^ Inode);
+}
@@ -0,0 +1,253 @@
+/** @file
+  Builds small ext4 images in memory, for the Ext4Dxe host tests.
+
+  Images have a single block group, 256 byte inodes, and the filetype,
+  extents and dir_index features. Files get deterministic contents (see
+  Ext4ImagePatternByte), so reads can be checked without keeping a copy of
+  the data around.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef EXT4_IMAGE_BUILDER_H_
+#define EXT4_IMAGE_BUILDER_H_
+
+#include "../Ext4Dxe.h"
+
+#define EXT4_IMAGE_INODE_SIZE  256
+
+// Timestamp given to everything in the image
+#define EXT4_IMAGE_TIME  1600000000U
+
+// Ext4ImageAddFragmentedFile flags
+// Leave a free block after every extent, so that extents aren't physically contiguous
+#define EXT4_IMAGE_FRAGMENT_GAPS       BIT0
+// Leave every third extent's worth of blocks unmapped, as a hole
+#define EXT4_IMAGE_FRAGMENT_HOLES      BIT1
+// Make every extent uninitialized, like fallocate does. Their blocks are filled with
+// EXT4_IMAGE_UNWRITTEN_BYTE, which must never be read back.
+#define EXT4_IMAGE_FRAGMENT_UNWRITTEN  BIT2
+
+#define EXT4_IMAGE_UNWRITTEN_BYTE  0xAA
+
+typedef struct {
+  EXT4_INO_NR    Inode;
+  UINT8          FileType;
+  UINT8          NameLength;
+  CHAR8          Name[EXT4_NAME_MAX + 1];
+} EXT4_IMAGE_DIRENT;
+
+typedef struct {
+  EXT4_INO_NR          Inode;
+  EXT4_INO_NR          Parent;
+  EXT4_IMAGE_DIRENT    *Entries;
+  UINTN                NumEntries;
+  UINTN                MaxEntries;
+  BOOLEAN              Indexed;
+} EXT4_IMAGE_DIR;
+
+typedef struct {
+  UINT8             *Image;
+  UINT64            Size;
+
+  UINT32            BlockSize;
+  UINT32            NumberBlocks;
+  UINT32            NumberInodes;
+  UINT32            FirstDataBlock;
+  UINT32            BlockBitmap;
+  UINT32            InodeBitmap;
+  UINT32            InodeTable;
+
+  // Blocks are handed out in order, starting from this one
+  UINT32            NextBlock;
+  EXT4_INO_NR       NextInode;
+
+  // Directories are laid out by Ext4ImageFinish, once all their entries are known
+  EXT4_IMAGE_DIR    *Dirs;
+  UINTN             NumDirs;
+} EXT4_IMAGE_BUILDER;
+
+/**
+   Creates an empty image, with just the root directory and lost+found.
+
+   @param[in]      BlockSize     Block size, from 1KiB to 64KiB.
+   @param[in]      NumberBlocks  Size of the image, in blocks. It must fit in a single block group.
+   @param[in]      NumberInodes  Number of inodes. It must be a multiple of the inodes per block.
+   @param[out]     Builder       Pointer to the new image builder.
+
+   @retval EFI_SUCCESS           The image was created.
+   @retval EFI_INVALID_PARAMETER The geometry is not supported.
+   @retval EFI_OUT_OF_RESOURCES  Out of memory.
+**/
+EFI_STATUS
+Ext4ImageCreate (
+  IN  UINT32              BlockSize,
+  IN  UINT32              NumberBlocks,
+  IN  UINT32              NumberInodes,
+  OUT EXT4_IMAGE_BUILDER  **Builder
+  );
+
+/**
+   Adds a directory to the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new directory.
+   @param[out]     Inode         Inode number of the new directory. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddDirectory (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  );
+
+/**
+   Makes a directory of the image be laid out with a hash tree index (htree),
+   with a second level of index nodes if the root can't point to every leaf.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the directory.
+
+   @retval EFI_SUCCESS           The directory will be indexed.
+   @retval EFI_INVALID_PARAMETER There's no such directory.
+**/
+EFI_STATUS
+Ext4ImageIndexDirectory (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode
+  );
+
+/**
+   Adds a regular file, stored contiguously, to the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new file.
+   @param[in]      Size          Size of the file, in bytes.
+   @param[out]     Inode         Inode number of the new file. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddFile (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  IN  UINT64              Size,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  );
+
+/**
+   Adds a regular file, made of many small extents, to the image. Files with
+   more extents than fit in the inode get a one level deep extent tree.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      Name          UTF-8 name of the new file.
+   @param[in]      Size          Size of the file, in bytes.
+   @param[in]      ExtentBlocks  Length of every extent, in blocks.
+   @param[in]      Flags         EXT4_IMAGE_FRAGMENT_* flags.
+   @param[out]     Inode         Inode number of the new file. Optional.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageAddFragmentedFile (
+  IN  EXT4_IMAGE_BUILDER  *Builder,
+  IN  EXT4_INO_NR         Parent,
+  IN  CONST CHAR8         *Name,
+  IN  UINT64              Size,
+  IN  UINT32              ExtentBlocks,
+  IN  UINT32              Flags,
+  OUT EXT4_INO_NR         *Inode OPTIONAL
+  );
+
+/**
+   Lays out the directories, and writes the bitmaps, the block group descriptor
+   and the superblock. Nothing can be added to the image after this.
+
+   @param[in]      Builder       Pointer to the image builder.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ImageFinish (
+  IN EXT4_IMAGE_BUILDER  *Builder
+  );
+
+/**
+   Gets the extent that maps a block of a file (or directory) in the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      LogicalBlock  Block of the file.
+
+   @return Pointer to the extent, or NULL if the block isn't mapped (a hole).
+**/
+EXT4_EXTENT *
+Ext4ImageFileExtent (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN UINT64              LogicalBlock
+  );
+
+/**
+   Gets a pointer to the data at an offset of a file (or directory) in the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Offset        Offset in the file.
+
+   @return Pointer into the image, or NULL if the offset isn't mapped (a hole).
+**/
+UINT8 *
+Ext4ImageFileData (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode,
+  IN UINT64              Offset
+  );
+
+/**
+   Gets a pointer to an inode of the image.
+
+   @param[in]      Builder       Pointer to the image builder.
+   @param[in]      Inode         Inode number.
+
+   @return Pointer to the inode.
+**/
+EXT4_INODE *
+Ext4ImageInode (
+  IN EXT4_IMAGE_BUILDER  *Builder,
+  IN EXT4_INO_NR         Inode
+  );
+
+/**
+   Frees an image builder, along with its image.
+
+   @param[in]      Builder       Pointer to the image builder.
+**/
+VOID
+Ext4ImageFree (
+  IN EXT4_IMAGE_BUILDER  *Builder
+  );
+
+/**
+   Gets a byte of the contents of a file made by the image builder.
+
+   @param[in]      Inode         Inode number of the file.
+   @param[in]      Offset        Offset of the byte in the file.
+
+   @return The byte.
+**/
+UINT8
+Ext4ImagePatternByte (
+  IN EXT4_INO_NR  Inode,
+  IN UINT64       Offset
+  );
+
+#endif
@@ -0,0 +1,57 @@
+/** @file
+  Ext4 debug protocol, used to inspect the internal state of a mounted partition.
+
+  It's only installed when PcdExt4InstallDebugProtocol is TRUE, and is meant
+  for tuning the driver (e.g sizing its caches), not as a stable interface.
+
+  Copyright (c) 2026, agent <agent@local>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef EXT4_DEBUG_PROTOCOL_H_
+#define EXT4_DEBUG_PROTOCOL_H_
+
+#define EXT4_DEBUG_PROTOCOL_GUID \
+  { \
+    0x4bd92858, 0x1054, 0x4cc5, { 0xac, 0x72, 0xa3, 0x7a, 0x7b, 0x69, 0x80, 0xc2 } \
+  }
+
+#define EXT4_DEBUG_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EXT4_DEBUG_PROTOCOL EXT4_DEBUG_PROTOCOL;
+
+typedef struct {
+  // Number of block lookups that were served from the cache
+  UINT64    Hits;
+  // Number of block lookups that needed to go to the disk
+  UINT64    Misses;
+  // Number of blocks currently cached
+  UINT32    NumEntries;
+  // Maximum number of blocks that can be cached (PcdExt4BlockCacheSize)
+  UINT32    MaxEntries;
+} EXT4_DEBUG_BLOCK_CACHE_STATS;
+
+/**
+  Retrieves the statistics of the partition's block cache.
+
+  @param[in]   This   Pointer to the EXT4_DEBUG_PROTOCOL instance.
+  @param[out]  Stats  Pointer to the destination statistics structure.
+
+  @retval EFI_SUCCESS            The statistics were retrieved.
+  @retval EFI_INVALID_PARAMETER  This or Stats is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EXT4_DEBUG_GET_BLOCK_CACHE_STATS)(
+  IN  EXT4_DEBUG_PROTOCOL           *This,
+  OUT EXT4_DEBUG_BLOCK_CACHE_STATS  *Stats
+  );
+
+struct _EXT4_DEBUG_PROTOCOL {
+  UINT64                              Revision;
+  EXT4_DEBUG_GET_BLOCK_CACHE_STATS    GetBlockCacheStats;
+};
+
+extern EFI_GUID  gExt4DebugProtocolGuid;
+
+#endif
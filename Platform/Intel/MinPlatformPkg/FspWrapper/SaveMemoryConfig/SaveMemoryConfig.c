@@ -39,14 +39,10 @@ SaveMemoryConfigEntryPoint (
   EFI_STATUS        Status;
   EFI_HOB_GUID_TYPE *GuidHob;
   VOID              *HobData;
-  VOID              *VariableData;
   UINTN             DataSize;
-  UINTN             BufferSize;
   BOOLEAN           DataIsIdentical;
 
   DataSize        = 0;
-  BufferSize      = 0;
-  VariableData    = NULL;
   GuidHob         = NULL;
   HobData         = NULL;
   DataIsIdentical = FALSE;
@@ -76,25 +72,24 @@ SaveMemoryConfigEntryPoint (
     DEBUG ((DEBUG_INFO, "FspNvsHob.NvsDataPtr   : 0x%x\n", HobData));
     if (DataSize > 0) {
       //
-      // Check if the presently saved data is identical to the data given by MRC/FSP
+      // Check if the presently saved data is identical to the data given by MRC/FSP.
+      // The digest stored with the variable answers this without reading the data
+      // back, once the variables it lists are found with the sizes it records.
+      // Without a valid digest the data is written, which also stores the digest.
+      // FspNvsBuffer is only expected to be written through the large variable
+      // library, a same size rewrite by another writer goes unnoticed.
       //
-      Status = GetLargeVariable (L"FspNvsBuffer", &gFspNvsBufferVariableGuid, &BufferSize, NULL);
-      if (Status == EFI_BUFFER_TOO_SMALL) {
-        if (BufferSize == DataSize) {
-          VariableData = AllocatePool (BufferSize);
-          if (VariableData != NULL) {
-            Status = GetLargeVariable (L"FspNvsBuffer", &gFspNvsBufferVariableGuid, &BufferSize, VariableData);
-            if (!EFI_ERROR (Status) && (BufferSize == DataSize) && (0 == CompareMem (HobData, VariableData, DataSize))) {
-              DataIsIdentical = TRUE;
-            }
-            FreePool (VariableData);
-          }
-        }
+      Status = CompareLargeVariableDigest (L"FspNvsBuffer", &gFspNvsBufferVariableGuid, DataSize, HobData, &DataIsIdentical);
+      if (EFI_ERROR (Status)) {
+        DataIsIdentical = FALSE;
       }
       Status = EFI_SUCCESS;
 
       if (!DataIsIdentical) {
-        Status = SetLargeVariable (L"FspNvsBuffer", &gFspNvsBufferVariableGuid, TRUE, DataSize, HobData);
+        //
+        // Only the split variables that changed are rewritten.
+        //
+        Status = UpdateLargeVariable (L"FspNvsBuffer", &gFspNvsBufferVariableGuid, TRUE, DataSize, HobData);
         ASSERT_EFI_ERROR (Status);
         DEBUG ((DEBUG_INFO, "Saved size of FSP / MRC Training Data: 0x%x\n", DataSize));
       } else {
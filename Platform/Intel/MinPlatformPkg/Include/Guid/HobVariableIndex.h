@@ -0,0 +1,49 @@
+/** @file
+  GUID and data structure of the HOB that indexes the default variable HOB.
+
+  PeiHobVariableLibFce builds this HOB next to the default variable HOB, so
+  that looking up a variable by name and GUID does not have to walk the whole
+  variable store. It also keeps lookup statistics, which the test point HOB
+  dump reports.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _HOB_VARIABLE_INDEX_H_
+#define _HOB_VARIABLE_INDEX_H_
+
+#define HOB_VARIABLE_INDEX_GUID \
+  { \
+    0x3f8e6e2a, 0x5b1c, 0x4d07, { 0x9a, 0x61, 0x2e, 0xc4, 0x7b, 0x90, 0x1d, 0x58 } \
+  }
+
+extern EFI_GUID gHobVariableIndexHobGuid;
+
+///
+/// One slot of the open addressing hash table. An Offset of 0 marks an empty
+/// slot, no variable header can start at the variable store header.
+///
+typedef struct {
+  UINT32    Hash;        ///< Hash of the variable name and vendor GUID
+  UINT32    Offset;      ///< Offset of the variable header from the variable store header
+} HOB_VARIABLE_INDEX_ENTRY;
+
+typedef struct {
+  EFI_GUID  StoreSignature;   ///< Signature of the indexed variable store
+  UINT32    StoreSize;        ///< Size of the indexed variable store
+  UINT32    EntryCount;       ///< Number of slots in Entry, a power of two
+  UINT32    VariableCount;    ///< Number of variables in the index
+  //
+  // Lookup statistics
+  //
+  UINT32    LookupCount;      ///< Lookups served from the index
+  UINT32    ProbeCount;       ///< Slots visited by those lookups
+  UINT32    MissCount;        ///< Lookups that found no variable
+  UINT32    LinearScanCount;  ///< Lookups that walked the store because the index did not match it
+  UINT32    Reserved;
+//HOB_VARIABLE_INDEX_ENTRY  Entry[EntryCount];
+} HOB_VARIABLE_INDEX;
+
+#endif
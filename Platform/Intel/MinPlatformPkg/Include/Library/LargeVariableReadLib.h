@@ -27,6 +27,45 @@
 
 #include <Uefi/UefiBaseType.h>
 
+//
+// A digest of the data is stored alongside every large variable, in a variable
+// whose name is the name of the large variable with "Digest" appended. It lets
+// callers detect changes to the data without reading it back, and lets
+// UpdateLargeVariable() rewrite only the split variables that changed. It is
+// also the manifest of the split variables, GetLargeVariable() uses it to get
+// the size of the data and read each split variable exactly once. The digest
+// uses CRC32, it detects changes but offers no protection against deliberate
+// tampering. It only describes data written by this library, see
+// ValidateLargeVariableDigest() for the changes by other writers it catches.
+//
+#define LARGE_VARIABLE_DIGEST_SIGNATURE   SIGNATURE_32 ('L', 'V', 'D', 'G')
+
+//
+// Digests are recorded for at most this many split variables. Larger data sets
+// only get a digest of the whole data.
+//
+#define LARGE_VARIABLE_MAX_CHUNK_DIGESTS  64
+
+typedef struct {
+  UINT32    Size;                 ///< Size of the data in the split variable
+  UINT32    Crc32;                ///< CRC32 of the data in the split variable
+} LARGE_VARIABLE_CHUNK_DIGEST;
+
+typedef struct {
+  UINT32                         Signature;        ///< LARGE_VARIABLE_DIGEST_SIGNATURE
+  UINT32                         Crc32;            ///< CRC32 of the whole data set
+  UINT64                         DataSize;         ///< Size of the whole data set
+  UINT32                         VariableCount;    ///< Number of split variables, 0 if a single variable is used
+  UINT32                         ChunkCount;       ///< Number of valid entries in Chunk, either 0 or VariableCount
+  LARGE_VARIABLE_CHUNK_DIGEST    Chunk[LARGE_VARIABLE_MAX_CHUNK_DIGESTS];
+} LARGE_VARIABLE_DIGEST;
+
+//
+// Only the valid entries of Chunk are stored in the digest variable.
+//
+#define LARGE_VARIABLE_DIGEST_SIZE(ChunkCount) \
+  (OFFSET_OF (LARGE_VARIABLE_DIGEST, Chunk) + (ChunkCount) * sizeof (LARGE_VARIABLE_CHUNK_DIGEST))
+
 /**
   Returns the value of a large variable.
 
@@ -58,4 +97,96 @@ GetLargeVariable (
   OUT    VOID                        *Data           OPTIONAL
   );
 
+/**
+  Returns the digest stored alongside a large variable.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[out]  Digest            The buffer to return the digest in.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          No valid digest was found. The large variable may not exist, or it
+                                 was written by a version of this library that did not store digests.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Digest is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+GetLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  OUT    LARGE_VARIABLE_DIGEST       *Digest
+  );
+
+/**
+  Checks that the variables listed in the digest of a large variable exist,
+  with the sizes the digest records. Only the sizes are probed, no data is read.
+  This costs one GetVariable() call, and so one search of the variable store,
+  for each variable the digest lists.
+
+  A digest can outlive its data, for example when a variable store reset tool
+  deletes the data variables, or when a writer that does not know about digests
+  stores data of another size. Data rewritten with the same sizes by such a
+  writer is not detected, the digest then describes data that is no longer
+  stored.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[in]   Digest            The digest returned by GetLargeVariableDigest().
+
+  @retval EFI_SUCCESS            The variables match the digest.
+  @retval EFI_NOT_FOUND          A variable is missing or has another size.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Digest is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+ValidateLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  IN     LARGE_VARIABLE_DIGEST       *Digest
+  );
+
+/**
+  Checks whether a large variable holds the given data, using the digest stored
+  alongside it instead of reading the data back. The variables the digest lists
+  are checked with ValidateLargeVariableDigest() before the data is reported
+  identical, which adds one variable store search per split variable.
+
+  Only the sizes of the stored variables are checked. If a writer that does not
+  update the digest rewrote them with data of the same sizes, Identical is
+  still TRUE when Data matches the digest, although the stored data differs.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[in]   DataSize          The size in bytes of the Data buffer.
+  @param[in]   Data              The data to compare with the contents of the variable.
+  @param[out]  Identical         TRUE if the digest of Data matches the stored digest.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          No valid digest was found, or the variables don't match it. The
+                                 contents of the variable are unknown.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Identical is NULL.
+  @retval EFI_INVALID_PARAMETER  DataSize is not zero and Data is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+CompareLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  IN     UINTN                       DataSize,
+  IN     VOID                        *Data,
+  OUT    BOOLEAN                     *Identical
+  );
+
 #endif  // _LARGE_VARIABLE_READ_LIB_H_
@@ -51,4 +51,11 @@
 //
 #define MAX_VARIABLE_NAME_PAD_SIZE  3
 
+//
+// The digest of a large variable is stored in a variable named after it with
+// this suffix. The suffix is no longer than MAX_VARIABLE_SPLIT_DIGITS, so any
+// name that is short enough to be split is also short enough to get a digest.
+//
+#define LARGE_VARIABLE_DIGEST_NAME_FORMAT  L"%sDigest"
+
 #endif  // _LARGE_VARIABLE_COMMON_H_
@@ -11,11 +11,16 @@
   will be incremented for each variable as needed to retrieve the entire data
   set.
 
+  The digest stored alongside the data lists the variables and their sizes.
+  When it is present, the data is read without probing the size of each
+  variable first. Data sets stored without a digest are still read.
+
   Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
 
+#include <Library/LargeVariableReadLib.h>
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
@@ -24,6 +29,83 @@
 
 #include "LargeVariableCommon.h"
 
+/**
+  Reads the split variables of a large variable using the list of split
+  variables in its digest. Each split variable is read exactly once, straight
+  into the caller's buffer.
+
+  @param[in]       VariableName  A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]       VendorGuid    A unique identifier for the vendor.
+  @param[in]       Digest        The digest of the large variable.
+  @param[in]       DataSize      The size in bytes of the Data buffer, at least Digest->DataSize.
+  @param[out]      Data          The buffer to return the contents of the variable.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          The split variables don't match the digest.
+  @retval Others                 The variable could not be retrieved.
+
+**/
+EFI_STATUS
+GetLargeVariableUsingDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  IN     LARGE_VARIABLE_DIGEST       *Digest,
+  IN     UINTN                       DataSize,
+  OUT    VOID                        *Data
+  )
+{
+  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+  UINTN         Index;
+  UINTN         VariableSize;
+  UINTN         BytesRemaining;
+  UINT8         *OffsetPtr;
+
+  if (Digest->VariableCount == 0) {
+    VariableSize = DataSize;
+    Status = VarLibGetVariable (VariableName, VendorGuid, NULL, &VariableSize, Data);
+    if ((Status == EFI_BUFFER_TOO_SMALL) || (!EFI_ERROR (Status) && (VariableSize != Digest->DataSize))) {
+      Status = EFI_NOT_FOUND;
+    }
+    return Status;
+  }
+
+  OffsetPtr       = (UINT8 *) Data;
+  BytesRemaining  = (UINTN) Digest->DataSize;
+  for (Index = 0; Index < Digest->VariableCount; Index++) {
+    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+    UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+    if (Index < Digest->ChunkCount) {
+      VariableSize = Digest->Chunk[Index].Size;
+      if (VariableSize > BytesRemaining) {
+        return EFI_NOT_FOUND;
+      }
+    } else {
+      VariableSize = BytesRemaining;
+    }
+
+    Status = VarLibGetVariable (TempVariableName, VendorGuid, NULL, &VariableSize, (VOID *) OffsetPtr);
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      return EFI_NOT_FOUND;
+    } else if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if ((Index < Digest->ChunkCount) && (VariableSize != Digest->Chunk[Index].Size)) {
+      return EFI_NOT_FOUND;
+    }
+    BytesRemaining -= VariableSize;
+    OffsetPtr += VariableSize;
+  }
+
+  if (BytesRemaining != 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Returns the value of a large variable.
 
@@ -55,39 +137,70 @@ GetLargeVariable (
   OUT    VOID                        *Data           OPTIONAL
   )
 {
-  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
-  EFI_STATUS    Status;
-  UINTN         TotalSize;
-  UINTN         VarDataSize;
-  UINTN         Index;
-  UINTN         VariableSize;
-  UINTN         BytesRemaining;
-  UINT8         *OffsetPtr;
+  CHAR16                  TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  LARGE_VARIABLE_DIGEST   Digest;
+  EFI_STATUS              Status;
+  UINTN                   TotalSize;
+  UINTN                   Index;
+  UINTN                   VariableSize;
+  UINTN                   BytesRemaining;
+  UINT8                   *OffsetPtr;
 
-  VarDataSize = 0;
+  if (VariableName == NULL || VendorGuid == NULL || DataSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
 
   //
-  // First check if a variable with the given name exists
+  // The digest lists the split variables and their sizes. With it, the size
+  // is known from a single small read, and each split variable is read once.
   //
-  Status = VarLibGetVariable (VariableName, VendorGuid, NULL, &VarDataSize, NULL);
-  if (Status == EFI_BUFFER_TOO_SMALL) {
-    if (*DataSize >= VarDataSize) {
-      if (Data == NULL) {
-        Status = EFI_INVALID_PARAMETER;
-        goto Done;
-      }
-      DEBUG ((DEBUG_VERBOSE, "GetLargeVariable: Single Variable Found\n"));
-      Status = VarLibGetVariable (VariableName, VendorGuid, NULL, DataSize, Data);
-      goto Done;
-    } else {
-      *DataSize = VarDataSize;
+  Status = GetLargeVariableDigest (VariableName, VendorGuid, &Digest);
+  if (!EFI_ERROR (Status) && (Digest.DataSize <= MAX_UINTN)) {
+    if (*DataSize < Digest.DataSize) {
+      *DataSize = (UINTN) Digest.DataSize;
       Status = EFI_BUFFER_TOO_SMALL;
       goto Done;
     }
+    if (Data == NULL) {
+      Status = EFI_INVALID_PARAMETER;
+      goto Done;
+    }
 
+    Status = GetLargeVariableUsingDigest (VariableName, VendorGuid, &Digest, *DataSize, Data);
+    if (Status != EFI_NOT_FOUND) {
+      if (!EFI_ERROR (Status)) {
+        *DataSize = (UINTN) Digest.DataSize;
+      }
+      goto Done;
+    }
+
+    //
+    // The variables were resized without updating the digest, for example by
+    // an older version of this library. Read them without it.
+    //
+    DEBUG ((DEBUG_WARN, "GetLargeVariable: %s doesn't match its digest\n", VariableName));
+  }
+
+  //
+  // First check if a variable with the given name exists. Reading straight
+  // into the buffer saves probing the size first in the common case.
+  //
+  VariableSize = (Data == NULL) ? 0 : *DataSize;
+  Status = VarLibGetVariable (VariableName, VendorGuid, NULL, &VariableSize, Data);
+  if (!EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_VERBOSE, "GetLargeVariable: Single Variable Found\n"));
+    *DataSize = VariableSize;
+    goto Done;
+  } else if (Status == EFI_BUFFER_TOO_SMALL) {
+    if (*DataSize >= VariableSize) {
+      Status = EFI_INVALID_PARAMETER;
+    } else {
+      *DataSize = VariableSize;
+    }
+    goto Done;
   } else if (Status == EFI_NOT_FOUND) {
     //
-    // Check if the first variable of a multi-variable set exists
+    // Check if a multi-variable set exists
     //
     if (StrLen (VariableName) >= (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
       DEBUG ((DEBUG_ERROR, "GetLargeVariable: Variable name too long\n"));
@@ -95,82 +208,279 @@ GetLargeVariable (
       goto Done;
     }
 
-    VarDataSize = 0;
-    Index       = 0;
-    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
-    UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
-    Status = VarLibGetVariable (TempVariableName, VendorGuid, NULL, &VarDataSize, NULL);
-
-    if (Status == EFI_BUFFER_TOO_SMALL) {
-      //
-      // The first variable exists. Calculate the total size of all the variables.
-      //
-      DEBUG ((DEBUG_VERBOSE, "GetLargeVariable: Multiple Variables Found\n"));
-      TotalSize = 0;
-      for (Index = 0; Index < MAX_VARIABLE_SPLIT; Index++) {
-        VarDataSize = 0;
-        ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
-        UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
-        Status = VarLibGetVariable (TempVariableName, VendorGuid, NULL, &VarDataSize, NULL);
-        if (Status != EFI_BUFFER_TOO_SMALL) {
-          break;
-        }
-        TotalSize += VarDataSize;
+    //
+    // Read the variables in a single pass, straight into the buffer for as
+    // long as the data fits. Once it doesn't, keep going to find the total
+    // size without reading any more data.
+    //
+    TotalSize       = 0;
+    OffsetPtr       = (UINT8 *) Data;
+    BytesRemaining  = (Data == NULL) ? 0 : *DataSize;
+    for (Index = 0; Index < MAX_VARIABLE_SPLIT; Index++) {
+      ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+      UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+      VariableSize = BytesRemaining;
+      Status = VarLibGetVariable (
+                 TempVariableName,
+                 VendorGuid,
+                 NULL,
+                 &VariableSize,
+                 (BytesRemaining == 0) ? NULL : (VOID *) OffsetPtr
+                 );
+      if (!EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_INFO, "Read %s, Guid = %g, Size %d\n", TempVariableName, VendorGuid, VariableSize));
+        BytesRemaining -= VariableSize;
+        OffsetPtr += VariableSize;
+      } else if (Status == EFI_BUFFER_TOO_SMALL) {
+        BytesRemaining = 0;
+      } else {
+        break;
       }
-      DEBUG ((DEBUG_VERBOSE, "TotalSize = %d, NumVariables = %d\n", TotalSize, Index));
+      TotalSize += VariableSize;
+    }   //End of for loop
+    DEBUG ((DEBUG_VERBOSE, "TotalSize = %d, NumVariables = %d\n", TotalSize, Index));
 
+    if (Status != EFI_NOT_FOUND) {
+      goto Done;
+    }
+    if (Index == 0) {
       //
-      // Check if the user provided a large enough buffer
+      // Not even the first variable of a multi-variable set exists
       //
-      if (*DataSize >= TotalSize) {
-        if (Data == NULL) {
-          Status = EFI_INVALID_PARAMETER;
-          goto Done;
-        }
-
-        //
-        // Read the data from all variables
-        //
-        OffsetPtr       = (UINT8 *) Data;
-        BytesRemaining  = *DataSize;
-        for (Index = 0; Index < MAX_VARIABLE_SPLIT; Index++) {
-          VarDataSize = 0;
-          ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
-          UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
-          VariableSize = BytesRemaining;
-          DEBUG ((DEBUG_INFO, "Reading %s, Guid = %g,", TempVariableName, VendorGuid));
-          Status = VarLibGetVariable (TempVariableName, VendorGuid, NULL, &VariableSize, (VOID *) OffsetPtr);
-          DEBUG ((DEBUG_INFO, " Size %d\n", VariableSize));
-          if (EFI_ERROR (Status)) {
-            if (Status == EFI_NOT_FOUND) {
-              DEBUG ((DEBUG_VERBOSE, "No more variables found\n"));
-              Status = EFI_SUCCESS;   // The end has been reached
-            }
-            goto Done;
-          }
-
-          if (VariableSize < BytesRemaining) {
-            BytesRemaining -= VariableSize;
-            OffsetPtr += VariableSize;
-          } else {
-            DEBUG ((DEBUG_VERBOSE, "All data has been read\n"));
-            BytesRemaining = 0;
-            break;
-          }
-        }   //End of for loop
-
-        goto Done;
-      } else {
-        *DataSize = TotalSize;
-        Status = EFI_BUFFER_TOO_SMALL;
-        goto Done;
-      }
+      goto Done;
+    }
+
+    if (*DataSize < TotalSize) {
+      Status = EFI_BUFFER_TOO_SMALL;
+    } else if (Data == NULL) {
+      Status = EFI_INVALID_PARAMETER;
     } else {
-      Status = EFI_NOT_FOUND;
+      DEBUG ((DEBUG_VERBOSE, "All data has been read\n"));
+      Status = EFI_SUCCESS;
     }
+    *DataSize = TotalSize;
   }
 
 Done:
   DEBUG ((DEBUG_ERROR, "GetLargeVariable: Status = %r\n", Status));
   return Status;
 }
+
+/**
+  Returns the digest stored alongside a large variable.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[out]  Digest            The buffer to return the digest in.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          No valid digest was found. The large variable may not exist, or it
+                                 was written by a version of this library that did not store digests.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Digest is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+GetLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  OUT    LARGE_VARIABLE_DIGEST       *Digest
+  )
+{
+  CHAR16        DigestVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+  UINTN         VarDataSize;
+
+  if (VariableName == NULL || VendorGuid == NULL || Digest == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (StrLen (VariableName) >= (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
+    DEBUG ((DEBUG_ERROR, "GetLargeVariableDigest: Variable name too long\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (DigestVariableName, MAX_VARIABLE_NAME_SIZE);
+  UnicodeSPrint (DigestVariableName, MAX_VARIABLE_NAME_SIZE, LARGE_VARIABLE_DIGEST_NAME_FORMAT, VariableName);
+  VarDataSize = sizeof (LARGE_VARIABLE_DIGEST);
+  Status = VarLibGetVariable (DigestVariableName, VendorGuid, NULL, &VarDataSize, Digest);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    //
+    // Larger than any digest this library writes
+    //
+    return EFI_NOT_FOUND;
+  } else if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Ignore anything that is not a well formed digest, the caller then treats
+  // the contents of the large variable as unknown.
+  //
+  if ((VarDataSize < LARGE_VARIABLE_DIGEST_SIZE (0)) ||
+      (Digest->Signature != LARGE_VARIABLE_DIGEST_SIGNATURE) ||
+      (Digest->VariableCount > MAX_VARIABLE_SPLIT) ||
+      ((Digest->ChunkCount != 0) && (Digest->ChunkCount != Digest->VariableCount)) ||
+      (Digest->ChunkCount > LARGE_VARIABLE_MAX_CHUNK_DIGESTS) ||
+      (VarDataSize != LARGE_VARIABLE_DIGEST_SIZE (Digest->ChunkCount))) {
+    DEBUG ((DEBUG_WARN, "GetLargeVariableDigest: Ignoring malformed digest %s\n", DigestVariableName));
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Checks that the variables listed in the digest of a large variable exist,
+  with the sizes the digest records. Only the sizes are probed, no data is read.
+  This costs one GetVariable() call, and so one search of the variable store,
+  for each variable the digest lists.
+
+  A digest can outlive its data, for example when a variable store reset tool
+  deletes the data variables, or when a writer that does not know about digests
+  stores data of another size. Data rewritten with the same sizes by such a
+  writer is not detected, the digest then describes data that is no longer
+  stored.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[in]   Digest            The digest returned by GetLargeVariableDigest().
+
+  @retval EFI_SUCCESS            The variables match the digest.
+  @retval EFI_NOT_FOUND          A variable is missing or has another size.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Digest is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+ValidateLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  IN     LARGE_VARIABLE_DIGEST       *Digest
+  )
+{
+  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+  UINTN         Index;
+  UINTN         VariableSize;
+  UINT64        TotalSize;
+
+  if (VariableName == NULL || VendorGuid == NULL || Digest == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (StrLen (VariableName) >= (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
+    DEBUG ((DEBUG_ERROR, "ValidateLargeVariableDigest: Variable name too long\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // A single variable when the digest lists no split variables
+  //
+  TotalSize = 0;
+  Index     = 0;
+  do {
+    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+    if (Digest->VariableCount == 0) {
+      UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s", VariableName);
+    } else {
+      UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+    }
+
+    VariableSize = 0;
+    Status = VarLibGetVariable (TempVariableName, VendorGuid, NULL, &VariableSize, NULL);
+    if (Status != EFI_BUFFER_TOO_SMALL) {
+      if (!EFI_ERROR (Status) || (Status == EFI_NOT_FOUND)) {
+        DEBUG ((DEBUG_WARN, "ValidateLargeVariableDigest: %s is missing\n", TempVariableName));
+        Status = EFI_NOT_FOUND;
+      }
+      return Status;
+    }
+
+    if ((Index < Digest->ChunkCount) && (VariableSize != Digest->Chunk[Index].Size)) {
+      DEBUG ((DEBUG_WARN, "ValidateLargeVariableDigest: %s doesn't match its digest\n", TempVariableName));
+      return EFI_NOT_FOUND;
+    }
+    TotalSize += VariableSize;
+    Index++;
+  } while (Index < Digest->VariableCount);
+
+  if (TotalSize != Digest->DataSize) {
+    DEBUG ((DEBUG_WARN, "ValidateLargeVariableDigest: %s doesn't match its digest\n", VariableName));
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Checks whether a large variable holds the given data, using the digest stored
+  alongside it instead of reading the data back. The variables the digest lists
+  are checked with ValidateLargeVariableDigest() before the data is reported
+  identical, which adds one variable store search per split variable.
+
+  Only the sizes of the stored variables are checked. If a writer that does not
+  update the digest rewrote them with data of the same sizes, Identical is
+  still TRUE when Data matches the digest, although the stored data differs.
+
+  @param[in]   VariableName      A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]   VendorGuid        A unique identifier for the vendor.
+  @param[in]   DataSize          The size in bytes of the Data buffer.
+  @param[in]   Data              The data to compare with the contents of the variable.
+  @param[out]  Identical         TRUE if the digest of Data matches the stored digest.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          No valid digest was found, or the variables don't match it. The
+                                 contents of the variable are unknown.
+  @retval EFI_INVALID_PARAMETER  VariableName, VendorGuid or Identical is NULL.
+  @retval EFI_INVALID_PARAMETER  DataSize is not zero and Data is NULL.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+
+**/
+EFI_STATUS
+EFIAPI
+CompareLargeVariableDigest (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  IN     UINTN                       DataSize,
+  IN     VOID                        *Data,
+  OUT    BOOLEAN                     *Identical
+  )
+{
+  LARGE_VARIABLE_DIGEST   Digest;
+  EFI_STATUS              Status;
+
+  if (Identical == NULL || (DataSize != 0 && Data == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Identical = FALSE;
+  Status = GetLargeVariableDigest (VariableName, VendorGuid, &Digest);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Skip the CRC when the size alone shows that the data changed. Data that
+  // matches the digest is only as good as the variables behind it, which are
+  // checked by size only.
+  //
+  if ((Digest.DataSize == DataSize) && (Digest.Crc32 == CalculateCrc32 (Data, DataSize))) {
+    Status = ValidateLargeVariableDigest (VariableName, VendorGuid, &Digest);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    *Identical = TRUE;
+  }
+
+  DEBUG ((DEBUG_VERBOSE, "CompareLargeVariableDigest: %s Identical = %d\n", VariableName, *Identical));
+  return EFI_SUCCESS;
+}
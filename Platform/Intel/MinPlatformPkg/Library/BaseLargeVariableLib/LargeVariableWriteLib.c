@@ -10,6 +10,9 @@
   integer number will be added to the end of the variable name. This number
   will be incremented for each variable as needed to store the entire data set.
 
+  A digest of the data is stored in one more variable, which allows callers to
+  check for changes cheaply and allows updates to skip unchanged variables.
+
   Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -19,6 +22,7 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/LargeVariableReadLib.h>
 #include <Library/PrintLib.h>
 #include <Library/VariableReadLib.h>
 #include <Library/VariableWriteLib.h>
@@ -118,6 +122,160 @@ GetVariableSplitSize (
   return VariableSplitSize;
 }
 
+/**
+  Stores or deletes the digest of a large variable.
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the large variable.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  Digest             The digest to store, or NULL to delete the digest.
+
+  @retval EFI_SUCCESS            The digest was stored or deleted, or the name of the large variable
+                                 is too long to have a digest.
+  @retval Others                 The digest could not be stored or deleted.
+
+**/
+EFI_STATUS
+SetLargeVariableDigest (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid,
+  IN  LARGE_VARIABLE_DIGEST        *Digest       OPTIONAL
+  )
+{
+  CHAR16        DigestVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+
+  if (StrLen (VariableName) >= (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
+    DEBUG ((DEBUG_WARN, "SetLargeVariableDigest: Variable name too long, no digest is stored\n"));
+    return EFI_SUCCESS;
+  }
+
+  ZeroMem (DigestVariableName, MAX_VARIABLE_NAME_SIZE);
+  UnicodeSPrint (DigestVariableName, MAX_VARIABLE_NAME_SIZE, LARGE_VARIABLE_DIGEST_NAME_FORMAT, VariableName);
+  Status = VarLibSetVariable (
+             DigestVariableName,
+             VendorGuid,
+             EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+             (Digest == NULL) ? 0 : LARGE_VARIABLE_DIGEST_SIZE (Digest->ChunkCount),
+             Digest
+             );
+  if ((Digest == NULL) && (Status == EFI_NOT_FOUND)) {
+    Status = EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "SetLargeVariableDigest: Error writting %s: Status = %r\n", DigestVariableName, Status));
+  }
+  return Status;
+}
+
+/**
+  Deletes the split variables of a large variable, starting with the given
+  index and ending at the first one that does not exist. This removes split
+  variables left over from an earlier, larger data set.
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the large variable.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  StartIndex         Index of the first split variable to delete.
+
+  @retval EFI_SUCCESS            All split variables starting at StartIndex are deleted.
+  @retval Others                 A split variable could not be deleted.
+
+**/
+EFI_STATUS
+DeleteSplitVariables (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid,
+  IN  UINTN                        StartIndex
+  )
+{
+  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+  UINTN         Index;
+
+  if (StrLen (VariableName) >= (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
+    //
+    // Split variables can't exist for this name
+    //
+    return EFI_SUCCESS;
+  }
+
+  for (Index = StartIndex; Index < MAX_VARIABLE_SPLIT; Index++) {
+    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+    UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+    Status = VarLibSetVariable (
+               TempVariableName,
+               VendorGuid,
+               EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+               0,
+               NULL
+               );
+    if (Status == EFI_NOT_FOUND) {
+      break;
+    } else if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "DeleteSplitVariables: Error deleting %s: Status = %r\n", TempVariableName, Status));
+      return Status;
+    }
+    DEBUG ((DEBUG_INFO, "Deleted stale %s, Guid = %g\n", TempVariableName, VendorGuid));
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Locks all the variables that make up a large variable, including its digest.
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the large variable.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  VariableCount      Number of split variables, 0 if the data is stored in a single variable.
+
+  @retval EFI_SUCCESS            All variables are locked.
+  @retval Others                 A variable could not be locked.
+
+**/
+EFI_STATUS
+LockLargeVariable (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid,
+  IN  UINTN                        VariableCount
+  )
+{
+  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  EFI_STATUS    Status;
+  UINTN         Index;
+
+  if (VariableCount == 0) {
+    Status = VarLibVariableRequestToLock (VariableName, VendorGuid);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error locking variable: Status = %r\n", Status));
+      return Status;
+    }
+  }
+
+  for (Index = 0; Index < VariableCount; Index++) {
+    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+    UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+
+    DEBUG ((DEBUG_INFO, "Locking %s, Guid = %g\n", TempVariableName, VendorGuid));
+    Status = VarLibVariableRequestToLock (TempVariableName, VendorGuid);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error locking variable: Status = %r\n", Status));
+      return Status;
+    }
+  }
+
+  if (StrLen (VariableName) < (MAX_VARIABLE_NAME_SIZE - MAX_VARIABLE_SPLIT_DIGITS)) {
+    ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
+    UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, LARGE_VARIABLE_DIGEST_NAME_FORMAT, VariableName);
+    Status = VarLibVariableRequestToLock (TempVariableName, VendorGuid);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error locking digest: Status = %r\n", Status));
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Deletes a large variable.
 
@@ -154,6 +312,14 @@ DeleteLargeVariableInternal (
 
   VarDataSize = 0;
 
+  //
+  // The digest goes first, so that the data is never described by a stale digest
+  //
+  Status = SetLargeVariableDigest (VariableName, VendorGuid, NULL);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
   //
   // First check if a variable with the given name exists
   //
@@ -220,56 +386,44 @@ Done:
 }
 
 /**
-  Sets the value of a large variable.
+  Sets the value of a large variable and stores its digest.
 
   @param[in]  VariableName       A Null-terminated string that is the name of the vendor's variable.
-                                 Each VariableName is unique for each VendorGuid. VariableName must
-                                 contain 1 or more characters. If VariableName is an empty string,
-                                 then EFI_INVALID_PARAMETER is returned.
   @param[in]  VendorGuid         A unique identifier for the vendor.
   @param[in]  LockVariable       If TRUE, any further writes to the variable will be prevented until the next reset.
-                                 Note: LockVariable must be FALSE when running in SMM or after ExitBootServices.
   @param[in]  DataSize           The size in bytes of the Data buffer. A size of zero causes the variable to be deleted.
-                                 If DataSize is zero, then LockVariable must be FALSE since a variable that does not
-                                 exist cannot be locked.
   @param[in]  Data               The contents for the variable.
+  @param[in]  Delta              If TRUE, split variables whose contents match the stored digest are not rewritten.
 
-  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data as
-                                 defined by the Attributes.
-  @retval EFI_INVALID_PARAMETER  An invalid combination of LockVariable, name, and GUID was supplied, or the
-                                 DataSize exceeds the maximum allowed.
-  @retval EFI_INVALID_PARAMETER  VariableName is an empty string.
-  @retval EFI_INVALID_PARAMETER  DataSize is zero and LockVariable is TRUE
-  @retval EFI_OUT_OF_RESOURCES   Not enough storage is available to hold the variable and its data.
-  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
-  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
-  @retval EFI_WRITE_PROTECTED    The variable in question is read-only.
-  @retval EFI_WRITE_PROTECTED    The variable in question cannot be deleted.
-
-  @retval EFI_NOT_FOUND          The variable trying to be updated or deleted was not found.
+  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data.
+  @retval Others                 See SetLargeVariable().
 
 **/
 EFI_STATUS
-EFIAPI
-SetLargeVariable (
+SetLargeVariableInternal (
   IN  CHAR16                       *VariableName,
   IN  EFI_GUID                     *VendorGuid,
   IN  BOOLEAN                      LockVariable,
   IN  UINTN                        DataSize,
-  IN  VOID                         *Data
+  IN  VOID                         *Data,
+  IN  BOOLEAN                      Delta
   )
 {
-  CHAR16        TempVariableName[MAX_VARIABLE_NAME_SIZE];
-  UINT64        VariableSplitSize;
-  UINT64        RemainingVariableStorage;
-  EFI_STATUS    Status;
-  EFI_STATUS    Status2;
-  UINTN         VariableNameLength;
-  UINTN         Index;
-  UINTN         VariablesSaved;
-  UINT8         *OffsetPtr;
-  UINTN         BytesRemaining;
-  UINTN         SizeToSave;
+  CHAR16                  TempVariableName[MAX_VARIABLE_NAME_SIZE];
+  LARGE_VARIABLE_DIGEST   Digest;
+  LARGE_VARIABLE_DIGEST   OldDigest;
+  BOOLEAN                 HaveOldDigest;
+  UINT64                  VariableSplitSize;
+  UINT64                  RemainingVariableStorage;
+  EFI_STATUS              Status;
+  EFI_STATUS              Status2;
+  UINTN                   VariableNameLength;
+  UINTN                   Index;
+  UINTN                   VariablesSaved;
+  UINT8                   *OffsetPtr;
+  UINTN                   BytesRemaining;
+  UINTN                   SizeToSave;
+  UINT32                  ChunkCrc32;
 
   //
   // Check input parameters.
@@ -303,6 +457,37 @@ SetLargeVariable (
     goto Done;
   }
 
+  ZeroMem (&Digest, sizeof (Digest));
+  Digest.Signature  = LARGE_VARIABLE_DIGEST_SIGNATURE;
+  Digest.DataSize   = DataSize;
+  Digest.Crc32      = CalculateCrc32 (Data, DataSize);
+
+  HaveOldDigest = FALSE;
+  if (Delta) {
+    //
+    // Only trust the old digest to skip writes while its variables still exist
+    //
+    HaveOldDigest = !EFI_ERROR (GetLargeVariableDigest (VariableName, VendorGuid, &OldDigest)) &&
+                    !EFI_ERROR (ValidateLargeVariableDigest (VariableName, VendorGuid, &OldDigest));
+    if (HaveOldDigest && (OldDigest.DataSize == DataSize) && (OldDigest.Crc32 == Digest.Crc32)) {
+      DEBUG ((DEBUG_INFO, "SetLargeVariable: %s is unchanged, nothing to write\n", VariableName));
+      Status = EFI_SUCCESS;
+      if (LockVariable) {
+        Status = LockLargeVariable (VariableName, VendorGuid, OldDigest.VariableCount);
+      }
+      goto Done;
+    }
+  }
+
+  //
+  // Delete the digest until all data is stored, so that a write that gets
+  // interrupted is never taken for valid data.
+  //
+  Status = SetLargeVariableDigest (VariableName, VendorGuid, NULL);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
   VariableNameLength  = StrLen (VariableName);
   VariableSplitSize   = GetVariableSplitSize (VariableNameLength);
   if (DataSize <= VariableSplitSize) {
@@ -321,8 +506,10 @@ SetLargeVariable (
     if (EFI_ERROR (Status)) {
       goto Done;
     }
-    if (LockVariable) {
-      Status = VarLibVariableRequestToLock (VariableName, VendorGuid);
+
+    Status = DeleteSplitVariables (VariableName, VendorGuid, 0);
+    if (EFI_ERROR (Status)) {
+      goto Done;
     }
   } else {
     //
@@ -390,40 +577,78 @@ SetLargeVariable (
       } else {
         SizeToSave = BytesRemaining;
       }
-      DEBUG ((DEBUG_INFO, "Saving %s, Guid = %g, Size %d\n", TempVariableName, VendorGuid, SizeToSave));
-      Status = VarLibSetVariable (
-                TempVariableName,
-                VendorGuid,
-                EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
-                SizeToSave,
-                (VOID *) OffsetPtr
-                );
-      if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error writting variable: Status = %r\n", Status));
-        goto Done;
+
+      ChunkCrc32 = CalculateCrc32 (OffsetPtr, SizeToSave);
+      if (Index < LARGE_VARIABLE_MAX_CHUNK_DIGESTS) {
+        Digest.Chunk[Index].Size  = (UINT32) SizeToSave;
+        Digest.Chunk[Index].Crc32 = ChunkCrc32;
       }
-      VariablesSaved  = Index;
+
+      if (HaveOldDigest &&
+          (Index < OldDigest.ChunkCount) &&
+          (OldDigest.Chunk[Index].Size == SizeToSave) &&
+          (OldDigest.Chunk[Index].Crc32 == ChunkCrc32)) {
+        DEBUG ((DEBUG_INFO, "Skipping unchanged %s, Guid = %g, Size %d\n", TempVariableName, VendorGuid, SizeToSave));
+      } else {
+        DEBUG ((DEBUG_INFO, "Saving %s, Guid = %g, Size %d\n", TempVariableName, VendorGuid, SizeToSave));
+        Status = VarLibSetVariable (
+                  TempVariableName,
+                  VendorGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+                  SizeToSave,
+                  (VOID *) OffsetPtr
+                  );
+        if (EFI_ERROR (Status)) {
+          DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error writting variable: Status = %r\n", Status));
+          goto Done;
+        }
+      }
+      VariablesSaved  = Index + 1;
       BytesRemaining -= SizeToSave;
       OffsetPtr += SizeToSave;
     }   // End of for loop
 
     //
-    // If the user requested that the variables be locked, lock them now that
-    // all data is saved.
+    // Remove variables left over from an earlier data set that was larger, or
+    // that fit in a single variable. Either would be read back with the data.
     //
-    if (LockVariable) {
-      for (Index = 0; Index < VariablesSaved; Index++) {
-        ZeroMem (TempVariableName, MAX_VARIABLE_NAME_SIZE);
-        UnicodeSPrint (TempVariableName, MAX_VARIABLE_NAME_SIZE, L"%s%d", VariableName, Index);
+    Status = DeleteSplitVariables (VariableName, VendorGuid, VariablesSaved);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    Status = VarLibSetVariable (
+               VariableName,
+               VendorGuid,
+               EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+               0,
+               NULL
+               );
+    if (EFI_ERROR (Status) && (Status != EFI_NOT_FOUND)) {
+      goto Done;
+    }
+    Digest.VariableCount = (UINT32) VariablesSaved;
+  }
 
-        DEBUG ((DEBUG_INFO, "Locking %s, Guid = %g\n", TempVariableName, VendorGuid));
-        Status = VarLibVariableRequestToLock (TempVariableName, VendorGuid);
-        if (EFI_ERROR (Status)) {
-          DEBUG ((DEBUG_ERROR, "SetLargeVariable: Error locking variable: Status = %r\n", Status));
-          VariablesSaved = 0;
-          goto Done;
-        }
-      }
+  //
+  // All data is stored, the digest can describe it now.
+  //
+  if (Digest.VariableCount <= LARGE_VARIABLE_MAX_CHUNK_DIGESTS) {
+    Digest.ChunkCount = Digest.VariableCount;
+  }
+  Status = SetLargeVariableDigest (VariableName, VendorGuid, &Digest);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  //
+  // If the user requested that the variables be locked, lock them now that
+  // all data is saved.
+  //
+  if (LockVariable) {
+    Status = LockLargeVariable (VariableName, VendorGuid, Digest.VariableCount);
+    if (EFI_ERROR (Status)) {
+      VariablesSaved = 0;
+      goto Done;
     }
   }
 
@@ -448,3 +673,97 @@ Done:
   DEBUG ((DEBUG_ERROR, "SetLargeVariable: Status = %r\n", Status));
   return Status;
 }
+
+/**
+  Sets the value of a large variable.
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the vendor's variable.
+                                 Each VariableName is unique for each VendorGuid. VariableName must
+                                 contain 1 or more characters. If VariableName is an empty string,
+                                 then EFI_INVALID_PARAMETER is returned.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  LockVariable       If TRUE, any further writes to the variable will be prevented until the next reset.
+                                 Note: LockVariable must be FALSE when running in SMM or after ExitBootServices.
+  @param[in]  DataSize           The size in bytes of the Data buffer. A size of zero causes the variable to be deleted.
+                                 If DataSize is zero, then LockVariable must be FALSE since a variable that does not
+                                 exist cannot be locked.
+  @param[in]  Data               The contents for the variable.
+
+  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data as
+                                 defined by the Attributes.
+  @retval EFI_INVALID_PARAMETER  An invalid combination of LockVariable, name, and GUID was supplied, or the
+                                 DataSize exceeds the maximum allowed.
+  @retval EFI_INVALID_PARAMETER  VariableName is an empty string.
+  @retval EFI_INVALID_PARAMETER  DataSize is zero and LockVariable is TRUE
+  @retval EFI_OUT_OF_RESOURCES   Not enough storage is available to hold the variable and its data.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+  @retval EFI_WRITE_PROTECTED    The variable in question is read-only.
+  @retval EFI_WRITE_PROTECTED    The variable in question cannot be deleted.
+
+  @retval EFI_NOT_FOUND          The variable trying to be updated or deleted was not found.
+
+**/
+EFI_STATUS
+EFIAPI
+SetLargeVariable (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid,
+  IN  BOOLEAN                      LockVariable,
+  IN  UINTN                        DataSize,
+  IN  VOID                         *Data
+  )
+{
+  return SetLargeVariableInternal (VariableName, VendorGuid, LockVariable, DataSize, Data, FALSE);
+}
+
+/**
+  Sets the value of a large variable, rewriting only the parts of it that
+  changed.
+
+  The digest stored by the last write is used to find the split variables
+  whose contents are unchanged, those are not written again. If the whole data
+  set is unchanged, nothing is written. Without a digest, all variables are
+  written like SetLargeVariable() does. The old digest is trusted once its
+  variables are found with the sizes it records, see
+  ValidateLargeVariableDigest().
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the vendor's variable.
+                                 Each VariableName is unique for each VendorGuid. VariableName must
+                                 contain 1 or more characters. If VariableName is an empty string,
+                                 then EFI_INVALID_PARAMETER is returned.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  LockVariable       If TRUE, any further writes to the variable will be prevented until the next reset.
+                                 Note: LockVariable must be FALSE when running in SMM or after ExitBootServices.
+  @param[in]  DataSize           The size in bytes of the Data buffer. A size of zero causes the variable to be deleted.
+                                 If DataSize is zero, then LockVariable must be FALSE since a variable that does not
+                                 exist cannot be locked.
+  @param[in]  Data               The contents for the variable.
+
+  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data as
+                                 defined by the Attributes.
+  @retval EFI_INVALID_PARAMETER  An invalid combination of LockVariable, name, and GUID was supplied, or the
+                                 DataSize exceeds the maximum allowed.
+  @retval EFI_INVALID_PARAMETER  VariableName is an empty string.
+  @retval EFI_INVALID_PARAMETER  DataSize is zero and LockVariable is TRUE
+  @retval EFI_OUT_OF_RESOURCES   Not enough storage is available to hold the variable and its data.
+  @retval EFI_OUT_OF_RESOURCES   The VariableName is longer than 1018 characters
+  @retval EFI_DEVICE_ERROR       The variable could not be retrieved due to a hardware error.
+  @retval EFI_WRITE_PROTECTED    The variable in question is read-only.
+  @retval EFI_WRITE_PROTECTED    The variable in question cannot be deleted.
+
+  @retval EFI_NOT_FOUND          The variable trying to be updated or deleted was not found.
+
+**/
+EFI_STATUS
+EFIAPI
+UpdateLargeVariable (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid,
+  IN  BOOLEAN                      LockVariable,
+  IN  UINTN                        DataSize,
+  IN  VOID                         *Data
+  )
+{
+  return SetLargeVariableInternal (VariableName, VendorGuid, LockVariable, DataSize, Data, TRUE);
+}
@@ -0,0 +1,381 @@
+/** @file
+  In-memory variable store for host based tests of the variable libraries.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "HostVariableLib.h"
+
+typedef struct {
+  CHAR16      *Name;
+  EFI_GUID    Guid;
+  UINT32      Attributes;
+  UINTN       Size;
+  UINT8       *Data;
+  BOOLEAN     Locked;
+} HOST_VARIABLE;
+
+HOST_VARIABLE_COUNTERS  gHostVariableCounters;
+
+STATIC HOST_VARIABLE  mHostVariable[HOST_VARIABLE_MAX_COUNT];
+
+/**
+  Finds a variable.
+
+  @param[in]  VariableName  The name of the variable.
+  @param[in]  VendorGuid    The GUID of the variable.
+
+  @return The variable, or NULL if there is none with that name and GUID.
+
+**/
+STATIC
+HOST_VARIABLE *
+HostVariableFind (
+  IN CHAR16    *VariableName,
+  IN EFI_GUID  *VendorGuid
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < HOST_VARIABLE_MAX_COUNT; Index++) {
+    if ((mHostVariable[Index].Name != NULL) &&
+        (StrCmp (mHostVariable[Index].Name, VariableName) == 0) &&
+        CompareGuid (&mHostVariable[Index].Guid, VendorGuid)) {
+      return &mHostVariable[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Deletes every variable, unlocks the store and clears the counters.
+
+**/
+VOID
+HostVariableReset (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < HOST_VARIABLE_MAX_COUNT; Index++) {
+    if (mHostVariable[Index].Name != NULL) {
+      FreePool (mHostVariable[Index].Name);
+      FreePool (mHostVariable[Index].Data);
+    }
+  }
+
+  ZeroMem (mHostVariable, sizeof (mHostVariable));
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+}
+
+/**
+  Returns the number of variables in the store.
+
+  @return The number of variables.
+
+**/
+UINTN
+HostVariableCount (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Count;
+
+  Count = 0;
+  for (Index = 0; Index < HOST_VARIABLE_MAX_COUNT; Index++) {
+    if (mHostVariable[Index].Name != NULL) {
+      Count++;
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Returns the value of a variable.
+
+  @param[in]       VariableName  A Null-terminated string that is the name of the vendor's
+                                 variable.
+  @param[in]       VendorGuid    A unique identifier for the vendor.
+  @param[out]      Attributes    If not NULL, a pointer to the memory location to return the
+                                 attributes bitmask for the variable.
+  @param[in, out]  DataSize      On input, the size in bytes of the return Data buffer.
+                                 On output the size of data returned in Data.
+  @param[out]      Data          The buffer to return the contents of the variable. May be NULL
+                                 with a zero DataSize in order to determine the size buffer needed.
+
+  @retval EFI_SUCCESS            The function completed successfully.
+  @retval EFI_NOT_FOUND          The variable was not found.
+  @retval EFI_BUFFER_TOO_SMALL   The DataSize is too small for the result.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL, or Data is NULL with a large enough DataSize.
+
+**/
+EFI_STATUS
+EFIAPI
+VarLibGetVariable (
+  IN     CHAR16                      *VariableName,
+  IN     EFI_GUID                    *VendorGuid,
+  OUT    UINT32                      *Attributes,    OPTIONAL
+  IN OUT UINTN                       *DataSize,
+  OUT    VOID                        *Data           OPTIONAL
+  )
+{
+  HOST_VARIABLE  *Variable;
+
+  if ((VariableName == NULL) || (VendorGuid == NULL) || (DataSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  gHostVariableCounters.Reads++;
+
+  Variable = HostVariableFind (VariableName, VendorGuid);
+  if (Variable == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (*DataSize < Variable->Size) {
+    *DataSize = Variable->Size;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (Data == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Attributes != NULL) {
+    *Attributes = Variable->Attributes;
+  }
+
+  *DataSize = Variable->Size;
+  CopyMem (Data, Variable->Data, Variable->Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Enumerates the current variable names.
+
+  @param[in, out]  VariableNameSize  The size of the VariableName buffer.
+  @param[in, out]  VariableName      On input, the name returned by the previous call, or an
+                                     empty string. On output, the name of the next variable.
+  @param[in, out]  VendorGuid        On input, the GUID returned by the previous call. On output,
+                                     the GUID of the next variable.
+
+  @retval EFI_SUCCESS                The function completed successfully.
+  @retval EFI_NOT_FOUND              The next variable was not found.
+  @retval EFI_BUFFER_TOO_SMALL       The VariableNameSize is too small for the result.
+  @retval EFI_INVALID_PARAMETER      A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+VarLibGetNextVariableName (
+  IN OUT UINTN                    *VariableNameSize,
+  IN OUT CHAR16                   *VariableName,
+  IN OUT EFI_GUID                 *VendorGuid
+  )
+{
+  UINTN  Index;
+
+  if ((VariableNameSize == NULL) || (VariableName == NULL) || (VendorGuid == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Index = 0;
+  if (VariableName[0] != L'\0') {
+    while ((Index < HOST_VARIABLE_MAX_COUNT) &&
+           ((mHostVariable[Index].Name == NULL) ||
+            (StrCmp (mHostVariable[Index].Name, VariableName) != 0) ||
+            !CompareGuid (&mHostVariable[Index].Guid, VendorGuid))) {
+      Index++;
+    }
+
+    if (Index == HOST_VARIABLE_MAX_COUNT) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Index++;
+  }
+
+  while ((Index < HOST_VARIABLE_MAX_COUNT) && (mHostVariable[Index].Name == NULL)) {
+    Index++;
+  }
+
+  if (Index == HOST_VARIABLE_MAX_COUNT) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (*VariableNameSize < StrSize (mHostVariable[Index].Name)) {
+    *VariableNameSize = StrSize (mHostVariable[Index].Name);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  *VariableNameSize = StrSize (mHostVariable[Index].Name);
+  CopyMem (VariableName, mHostVariable[Index].Name, *VariableNameSize);
+  CopyGuid (VendorGuid, &mHostVariable[Index].Guid);
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the value of a variable.
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the vendor's variable.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+  @param[in]  Attributes         Attributes bitmask to set for the variable.
+  @param[in]  DataSize           The size in bytes of the Data buffer. A size of zero deletes
+                                 the variable.
+  @param[in]  Data               The contents for the variable.
+
+  @retval EFI_SUCCESS            The variable was stored or deleted.
+  @retval EFI_NOT_FOUND          The variable to delete was not found.
+  @retval EFI_WRITE_PROTECTED    The variable is locked.
+  @retval EFI_INVALID_PARAMETER  The variable is larger than HOST_VARIABLE_MAX_SIZE.
+  @retval EFI_OUT_OF_RESOURCES   The store is full.
+
+**/
+EFI_STATUS
+EFIAPI
+VarLibSetVariable (
+  IN  CHAR16                        *VariableName,
+  IN  EFI_GUID                      *VendorGuid,
+  IN  UINT32                        Attributes,
+  IN  UINTN                         DataSize,
+  IN  VOID                          *Data
+  )
+{
+  HOST_VARIABLE  *Variable;
+  UINT8          *Copy;
+  UINTN          Index;
+
+  if ((VariableName == NULL) || (VariableName[0] == L'\0') || (VendorGuid == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Variable = HostVariableFind (VariableName, VendorGuid);
+  if ((Variable != NULL) && Variable->Locked) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (DataSize == 0) {
+    if (Variable == NULL) {
+      return EFI_NOT_FOUND;
+    }
+
+    FreePool (Variable->Name);
+    FreePool (Variable->Data);
+    ZeroMem (Variable, sizeof (*Variable));
+    gHostVariableCounters.Deletes++;
+    return EFI_SUCCESS;
+  }
+
+  if ((Data == NULL) || (StrSize (VariableName) + DataSize > HOST_VARIABLE_MAX_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Variable == NULL) {
+    for (Index = 0; Index < HOST_VARIABLE_MAX_COUNT; Index++) {
+      if (mHostVariable[Index].Name == NULL) {
+        break;
+      }
+    }
+
+    if (Index == HOST_VARIABLE_MAX_COUNT) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Variable       = &mHostVariable[Index];
+    Variable->Name = AllocateCopyPool (StrSize (VariableName), VariableName);
+    CopyGuid (&Variable->Guid, VendorGuid);
+  }
+
+  Copy = AllocateCopyPool (DataSize, Data);
+  ASSERT ((Variable->Name != NULL) && (Copy != NULL));
+  if (Variable->Data != NULL) {
+    FreePool (Variable->Data);
+  }
+
+  Variable->Attributes = Attributes;
+  Variable->Size       = DataSize;
+  Variable->Data       = Copy;
+
+  gHostVariableCounters.Writes++;
+  gHostVariableCounters.WriteBytes += DataSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns information about the variable store.
+
+  @param[in]   Attributes                    Attributes bitmask of the variables to report on.
+  @param[out]  MaximumVariableStorageSize    The size of the store.
+  @param[out]  RemainingVariableStorageSize  The space left in the store.
+  @param[out]  MaximumVariableSize           The largest variable the store accepts.
+
+  @retval EFI_SUCCESS                        The information was returned.
+
+**/
+EFI_STATUS
+EFIAPI
+VarLibQueryVariableInfo (
+  IN  UINT32                        Attributes,
+  OUT UINT64                        *MaximumVariableStorageSize,
+  OUT UINT64                        *RemainingVariableStorageSize,
+  OUT UINT64                        *MaximumVariableSize
+  )
+{
+  *MaximumVariableStorageSize   = HOST_VARIABLE_MAX_SIZE * HOST_VARIABLE_MAX_COUNT;
+  *RemainingVariableStorageSize = HOST_VARIABLE_MAX_SIZE * (HOST_VARIABLE_MAX_COUNT - HostVariableCount ());
+  *MaximumVariableSize          = HOST_VARIABLE_MAX_SIZE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Indicates if the variable store supports locking variables.
+
+  @retval TRUE   Locking is supported.
+
+**/
+BOOLEAN
+EFIAPI
+VarLibIsVariableRequestToLockSupported (
+  VOID
+  )
+{
+  return TRUE;
+}
+
+/**
+  Locks a variable until the next HostVariableReset().
+
+  @param[in]  VariableName       A Null-terminated string that is the name of the vendor's variable.
+  @param[in]  VendorGuid         A unique identifier for the vendor.
+
+  @retval EFI_SUCCESS            The variable is locked, or will be once it is created.
+
+**/
+EFI_STATUS
+EFIAPI
+VarLibVariableRequestToLock (
+  IN  CHAR16                       *VariableName,
+  IN  EFI_GUID                     *VendorGuid
+  )
+{
+  HOST_VARIABLE  *Variable;
+
+  gHostVariableCounters.Locks++;
+
+  Variable = HostVariableFind (VariableName, VendorGuid);
+  if (Variable != NULL) {
+    Variable->Locked = TRUE;
+  }
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/** @file
+  In-memory variable store for host based tests of the variable libraries.
+
+  It implements the VariableReadLib and VariableWriteLib library classes, and
+  counts the calls made to it so that tests can check how many variable
+  services calls an operation takes.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _HOST_VARIABLE_LIB_H_
+#define _HOST_VARIABLE_LIB_H_
+
+#include <Uefi.h>
+#include <Library/VariableReadLib.h>
+#include <Library/VariableWriteLib.h>
+
+//
+// Largest variable the store accepts, name included, as reported by
+// VarLibQueryVariableInfo(). Small, so that tests split data over many
+// variables without needing much of it.
+//
+#define HOST_VARIABLE_MAX_SIZE     1024
+
+//
+// Number of variables the store holds
+//
+#define HOST_VARIABLE_MAX_COUNT    512
+
+typedef struct {
+  UINTN    Reads;         ///< VarLibGetVariable() calls
+  UINTN    Writes;        ///< VarLibSetVariable() calls that stored data
+  UINTN    WriteBytes;    ///< Bytes stored by those calls
+  UINTN    Deletes;       ///< VarLibSetVariable() calls that deleted a variable
+  UINTN    Locks;         ///< VarLibVariableRequestToLock() calls
+} HOST_VARIABLE_COUNTERS;
+
+extern HOST_VARIABLE_COUNTERS  gHostVariableCounters;
+
+/**
+  Deletes every variable, unlocks the store and clears the counters.
+
+**/
+VOID
+HostVariableReset (
+  VOID
+  );
+
+/**
+  Returns the number of variables in the store.
+
+  @return The number of variables.
+
+**/
+UINTN
+HostVariableCount (
+  VOID
+  );
+
+#endif
@@ -0,0 +1,655 @@
+/** @file
+  Host based unit tests for the large variable libraries.
+
+  The libraries run on an in-memory variable store that only accepts small
+  variables, so that a few KB of data are split over several variables.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/UnitTestLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/LargeVariableReadLib.h>
+#include <Library/LargeVariableWriteLib.h>
+
+#include "HostVariableLib.h"
+
+#define UNIT_TEST_NAME     "Large Variable Lib Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Data sizes that need several split variables, and a single one
+//
+#define LARGE_VARIABLE_TEST_SIZE        8000
+#define LARGE_VARIABLE_TEST_SMALL_SIZE  200
+
+#define LARGE_VARIABLE_TEST_MAX_SIZE    20000
+
+//
+// Fills the gaps the library must not write to
+//
+#define LARGE_VARIABLE_TEST_GUARD       0xA5
+
+STATIC CHAR16    mTestVariableName[] = L"TestVar";
+STATIC CHAR16    mTestDigestName[]   = L"TestVarDigest";
+STATIC EFI_GUID  mTestVendorGuid     = { 0x3f2b8c61, 0x5d0e, 0x4a97, { 0xb1, 0x4c, 0x86, 0xe2, 0x0d, 0x7a, 0x53, 0x19 } };
+
+STATIC UINT8  mData[LARGE_VARIABLE_TEST_MAX_SIZE];
+STATIC UINT8  mReadBack[LARGE_VARIABLE_TEST_MAX_SIZE];
+
+/**
+  Fills mData with a pattern that differs in every split variable.
+
+  @param[in]  Seed  Selects one of several patterns.
+
+**/
+STATIC
+VOID
+LargeVariableTestFillData (
+  IN UINT8  Seed
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < sizeof (mData); Index++) {
+    mData[Index] = (UINT8) (Index * 7 + (Index >> 8) + Seed);
+  }
+}
+
+/**
+  Stores mData and clears the counters.
+
+  @param[in]  DataSize  The number of bytes of mData to store.
+
+  @return The status returned by SetLargeVariable().
+
+**/
+STATIC
+EFI_STATUS
+LargeVariableTestStore (
+  IN UINTN  DataSize
+  )
+{
+  EFI_STATUS  Status;
+
+  LargeVariableTestFillData (0);
+  Status = SetLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, DataSize, mData);
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  return Status;
+}
+
+/**
+  Reads the large variable back and compares it with mData.
+
+  @param[in]  DataSize  The number of bytes of mData the variable should hold.
+
+  @retval TRUE   The variable holds the data.
+  @retval FALSE  It does not, or it could not be read.
+
+**/
+STATIC
+BOOLEAN
+LargeVariableTestReadBack (
+  IN UINTN  DataSize
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  Size   = sizeof (mReadBack);
+  Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, mReadBack);
+  return !EFI_ERROR (Status) && (Size == DataSize) && (CompareMem (mReadBack, mData, DataSize) == 0);
+}
+
+/**
+  Empties the variable store after each test.
+
+  @param[in]  Context  Unused.
+
+**/
+STATIC
+VOID
+EFIAPI
+LargeVariableTestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  HostVariableReset ();
+}
+
+/**
+  Unchanged data is reported identical, using probes of the variable sizes.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestIdentical (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  LARGE_VARIABLE_DIGEST  Digest;
+  BOOLEAN                Identical;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+  UT_ASSERT_TRUE (Digest.VariableCount > 1);
+  UT_ASSERT_EQUAL (Digest.DataSize, LARGE_VARIABLE_TEST_SIZE);
+
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  Identical = FALSE;
+  UT_ASSERT_NOT_EFI_ERROR (CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SIZE, mData, &Identical));
+  UT_ASSERT_TRUE (Identical);
+
+  //
+  // The digest, and one probe per split variable
+  //
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, 1 + Digest.VariableCount);
+
+  mData[LARGE_VARIABLE_TEST_SIZE / 2] ^= 1;
+  UT_ASSERT_NOT_EFI_ERROR (CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SIZE, mData, &Identical));
+  UT_ASSERT_FALSE (Identical);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A deleted split variable makes the digest invalid, and the next update
+  stores every split variable again.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestDeletedSplit (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  LARGE_VARIABLE_DIGEST  Digest;
+  BOOLEAN                Identical;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (L"TestVar3", &mTestVendorGuid, 0, 0, NULL));
+
+  Identical = TRUE;
+  Status = CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SIZE, mData, &Identical);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_FALSE (Identical);
+  Status = ValidateLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  //
+  // Every split variable and the digest are written, none is skipped
+  //
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SIZE, mData));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Writes, Digest.VariableCount + 1);
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SIZE));
+
+  UT_ASSERT_NOT_EFI_ERROR (CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SIZE, mData, &Identical));
+  UT_ASSERT_TRUE (Identical);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A split variable rewritten with another size, as a version of the library
+  that doesn't store digests would, makes the digest invalid.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestResizedSplit (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Identical;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (L"TestVar2", &mTestVendorGuid, 0, 16, mData));
+
+  Identical = TRUE;
+  Status = CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SIZE, mData, &Identical);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_FALSE (Identical);
+
+  UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SIZE, mData));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SIZE));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Data stored in a single variable is checked the same way.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestSingleVariable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  LARGE_VARIABLE_DIGEST  Digest;
+  BOOLEAN                Identical;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SMALL_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+  UT_ASSERT_EQUAL (Digest.VariableCount, 0);
+  UT_ASSERT_NOT_EFI_ERROR (CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SMALL_SIZE, mData, &Identical));
+  UT_ASSERT_TRUE (Identical);
+
+  //
+  // Deleted
+  //
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestVariableName, &mTestVendorGuid, 0, 0, NULL));
+  Status = CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SMALL_SIZE, mData, &Identical);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_FALSE (Identical);
+
+  UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SMALL_SIZE, mData));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SMALL_SIZE));
+
+  //
+  // Rewritten with another size
+  //
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestVariableName, &mTestVendorGuid, 0, LARGE_VARIABLE_TEST_SMALL_SIZE / 2, mData));
+  Status = CompareLargeVariableDigest (mTestVariableName, &mTestVendorGuid, LARGE_VARIABLE_TEST_SMALL_SIZE, mData, &Identical);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_FALSE (Identical);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  UpdateLargeVariable() writes nothing for unchanged data, and only the split
+  variable that changed otherwise.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestDeltaWrites (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SIZE));
+
+  UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SIZE, mData));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Writes, 0);
+  UT_ASSERT_EQUAL (gHostVariableCounters.Deletes, 0);
+
+  //
+  // One byte in the middle: that split variable and the digest
+  //
+  mData[LARGE_VARIABLE_TEST_SIZE / 2] ^= 0x80;
+  UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SIZE, mData));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Writes, 2);
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SIZE));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Data that shrinks and grows reads back whole, with no variables left over.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestResize (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST UINTN     Sizes[] = {
+    LARGE_VARIABLE_TEST_SIZE, 3000, LARGE_VARIABLE_TEST_SMALL_SIZE, LARGE_VARIABLE_TEST_MAX_SIZE, 3000
+  };
+  LARGE_VARIABLE_DIGEST  Digest;
+  UINTN                  Index;
+
+  LargeVariableTestFillData (0);
+  for (Index = 0; Index < ARRAY_SIZE (Sizes); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (UpdateLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, Sizes[Index], mData));
+    UT_ASSERT_TRUE (LargeVariableTestReadBack (Sizes[Index]));
+    UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+
+    //
+    // The data variables and the digest
+    //
+    UT_ASSERT_EQUAL (HostVariableCount (), MAX (Digest.VariableCount, 1) + 1);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (SetLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, 0, NULL));
+  UT_ASSERT_EQUAL (HostVariableCount (), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  With a digest, the size is found with one read, and the data with one read
+  of each split variable.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestReadWithDigest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  LARGE_VARIABLE_DIGEST  Digest;
+  UINTN                  Size;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_MAX_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+  UT_ASSERT_TRUE (Digest.VariableCount > 1);
+
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  Size   = 0;
+  Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Size, LARGE_VARIABLE_TEST_MAX_SIZE);
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, 1);
+
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_MAX_SIZE));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, 1 + Digest.VariableCount);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Without a digest, as stored by older versions of the library, the size and
+  the data are each found in a single pass over the split variables.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestReadWithoutDigest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  LARGE_VARIABLE_DIGEST  Digest;
+  UINTN                  Size;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_MAX_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (GetLargeVariableDigest (mTestVariableName, &mTestVendorGuid, &Digest));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, 0, NULL));
+
+  //
+  // The digest, the single variable, each split variable and the one after
+  // the last
+  //
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  Size   = 0;
+  Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Size, LARGE_VARIABLE_TEST_MAX_SIZE);
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, Digest.VariableCount + 3);
+
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_MAX_SIZE));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, Digest.VariableCount + 3);
+
+  //
+  // A single variable is read without probing its size first
+  //
+  HostVariableReset ();
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SMALL_SIZE));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, 0, NULL));
+  ZeroMem (&gHostVariableCounters, sizeof (gHostVariableCounters));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SMALL_SIZE));
+  UT_ASSERT_EQUAL (gHostVariableCounters.Reads, 2);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A digest left behind by an older version of the library, which rewrote the
+  data without updating it, is not trusted.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestReadStaleDigest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  LARGE_VARIABLE_DIGEST  OldDigest;
+  UINTN                  OldDigestSize;
+  UINTN                  NewSize;
+  UINTN                  Size;
+
+  //
+  // Keep the digest of the first data set, store another larger one, then
+  // put the old digest back.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SIZE));
+  OldDigestSize = sizeof (OldDigest);
+  UT_ASSERT_NOT_EFI_ERROR (VarLibGetVariable (mTestDigestName, &mTestVendorGuid, NULL, &OldDigestSize, &OldDigest));
+
+  NewSize = LARGE_VARIABLE_TEST_SIZE + 1000;
+  LargeVariableTestFillData (1);
+  UT_ASSERT_NOT_EFI_ERROR (SetLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, NewSize, mData));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, OldDigestSize, &OldDigest));
+
+  //
+  // The size comes from the digest, the read that follows finds the real one
+  //
+  Size   = 0;
+  Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Size, LARGE_VARIABLE_TEST_SIZE);
+
+  Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, mReadBack);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Size, NewSize);
+
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (NewSize));
+
+  //
+  // Data that got smaller is read back whole as well
+  //
+  UT_ASSERT_NOT_EFI_ERROR (SetLargeVariable (mTestVariableName, &mTestVendorGuid, FALSE, LARGE_VARIABLE_TEST_SIZE / 2, mData));
+  UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, OldDigestSize, &OldDigest));
+  UT_ASSERT_TRUE (LargeVariableTestReadBack (LARGE_VARIABLE_TEST_SIZE / 2));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A buffer that is too small gets the size of the data, and nothing is written
+  past its end.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LargeVariableTestReadBufferTooSmall (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+  UINTN       Pass;
+  UINTN       Index;
+
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_MAX_SIZE));
+
+  //
+  // With the digest, then without it
+  //
+  for (Pass = 0; Pass < 2; Pass++) {
+    SetMem (mReadBack, sizeof (mReadBack), LARGE_VARIABLE_TEST_GUARD);
+    Size   = LARGE_VARIABLE_TEST_SIZE / 2 + 1;
+    Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, mReadBack);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+    UT_ASSERT_EQUAL (Size, LARGE_VARIABLE_TEST_MAX_SIZE);
+    for (Index = LARGE_VARIABLE_TEST_SIZE / 2 + 1; Index < sizeof (mReadBack); Index++) {
+      UT_ASSERT_EQUAL (mReadBack[Index], LARGE_VARIABLE_TEST_GUARD);
+    }
+
+    Size   = LARGE_VARIABLE_TEST_MAX_SIZE;
+    Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, NULL);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+    if (Pass == 0) {
+      UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, 0, NULL));
+    }
+  }
+
+  //
+  // A single variable
+  //
+  HostVariableReset ();
+  UT_ASSERT_NOT_EFI_ERROR (LargeVariableTestStore (LARGE_VARIABLE_TEST_SMALL_SIZE));
+  for (Pass = 0; Pass < 2; Pass++) {
+    SetMem (mReadBack, sizeof (mReadBack), LARGE_VARIABLE_TEST_GUARD);
+    Size   = LARGE_VARIABLE_TEST_SMALL_SIZE - 1;
+    Status = GetLargeVariable (mTestVariableName, &mTestVendorGuid, &Size, mReadBack);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+    UT_ASSERT_EQUAL (Size, LARGE_VARIABLE_TEST_SMALL_SIZE);
+    UT_ASSERT_EQUAL (mReadBack[LARGE_VARIABLE_TEST_SMALL_SIZE - 1], LARGE_VARIABLE_TEST_GUARD);
+
+    if (Pass == 0) {
+      UT_ASSERT_NOT_EFI_ERROR (VarLibSetVariable (mTestDigestName, &mTestVendorGuid, 0, 0, NULL));
+    }
+  }
+
+  Size   = sizeof (mReadBack);
+  Status = GetLargeVariable (L"NoSuchVar", &mTestVendorGuid, &Size, mReadBack);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sets up and runs the unit tests.
+
+  @return Result of the operation.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Digest", "MinPlatformPkg.LargeVariableLib.Digest", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Unchanged data is identical", "Identical", LargeVariableTestIdentical, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Deleted split variable", "DeletedSplit", LargeVariableTestDeletedSplit, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Resized split variable", "ResizedSplit", LargeVariableTestResizedSplit, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Single variable", "SingleVariable", LargeVariableTestSingleVariable, NULL, LargeVariableTestCleanup, NULL);
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Write", "MinPlatformPkg.LargeVariableLib.Write", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Only changed variables are written", "DeltaWrites", LargeVariableTestDeltaWrites, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Shrink and grow", "Resize", LargeVariableTestResize, NULL, LargeVariableTestCleanup, NULL);
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Read", "MinPlatformPkg.LargeVariableLib.Read", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Read with a digest", "ReadWithDigest", LargeVariableTestReadWithDigest, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Read without a digest", "ReadWithoutDigest", LargeVariableTestReadWithoutDigest, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Read with a stale digest", "ReadStaleDigest", LargeVariableTestReadStaleDigest, NULL, LargeVariableTestCleanup, NULL);
+  AddTestCase (Suite, "Buffer too small", "ReadBufferTooSmall", LargeVariableTestReadBufferTooSmall, NULL, LargeVariableTestCleanup, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
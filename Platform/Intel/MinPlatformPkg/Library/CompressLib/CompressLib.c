@@ -7,6 +7,10 @@
   This sequence is further divided into Blocks and Huffman codings
   are applied to each Block.
 
+  Repeated strings are found with hash chains over the 8 KB window. How
+  hard the match finder searches is set by PcdCompressLibLevel. All state
+  lives in a context allocated per call, so Compress() is re-entrant.
+
   Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -15,6 +19,7 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
 #include <Uefi/UefiBaseType.h>
 
 #define SHELL_FREE_NON_NULL(Pointer)  \
@@ -30,21 +35,22 @@
 //
 // Macro Definitions
 //
-typedef INT16             NODE;
 #define UINT8_BIT         8
 #define THRESHOLD         3
-#define INIT_CRC          0
 #define WNDBIT            13
 #define WNDSIZ            (1U << WNDBIT)
 #define MAXMATCH          256
 #define BLKSIZ            (1U << 14)  // 16 * 1024U
-#define PERC_FLAG         0x8000U
 #define CODE_BIT          16
 #define NIL               0
-#define MAX_HASH_VAL      (3 * WNDSIZ + (WNDSIZ / 512 + 1) * MAX_UINT8)
-#define HASH(LoopVar7, LoopVar5)        ((LoopVar7) + ((LoopVar5) << (WNDBIT - 9)) + WNDSIZ * 2)
-#define CRCPOLY           0xA001
-#define UPDATE_CRC(LoopVar5)     mCrc = mCrcTable[(mCrc ^ (LoopVar5)) & 0xFF] ^ (mCrc >> UINT8_BIT)
+
+//
+// Hash chains of the match finder. The current position always stays in
+// [WNDSIZ, WNDSIZ * 2), so position 0 can never be a match and serves as NIL.
+//
+#define HASH_BIT          15
+#define HASH_SIZE         (1U << HASH_BIT)
+#define HASH(String)      ((((UINT32) (String)[0] | ((UINT32) (String)[1] << 8) | ((UINT32) (String)[2] << 16)) * 0x9E3779B1U) >> (32 - HASH_BIT))
 
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
@@ -60,161 +66,144 @@ typedef INT16             NODE;
 #else
   #define                 NPT NP
 #endif
+
 //
-// Function Prototypes
+// Match finder tuning for each PcdCompressLibLevel value
 //
-
-/**
-  Put a dword to output stream.
-
-  @param[in] Data    The dword to put.
-**/
-VOID
-EFIAPI
-PutDword (
-  IN UINT32 Data
-  );
+typedef struct {
+  UINT16  GoodLength;   // Search a quarter of the chain once a match is this long
+  UINT16  MaxLazy;      // Don't look for a better match once a match is this long
+  UINT16  NiceLength;   // Stop searching the chain once a match is this long
+  UINT16  MaxChain;     // Maximum number of chain entries searched per position
+} COMPRESS_LEVEL;
+
+STATIC CONST COMPRESS_LEVEL  mCompressLevel[] = {
+  {  0,   0,   0,    0 },   // 0: Unused
+  {  4,   4,   8,    4 },   // 1: Fastest
+  {  4,   5,  16,    8 },
+  {  4,   6,  32,   32 },
+  {  4,   4,  16,   16 },
+  {  8,  16,  32,   32 },
+  {  8,  16, 128,  128 },   // 6: Default
+  {  8,  32, 128,  256 },
+  { 32, 128, 256, 1024 },
+  { 32, 256, 256, 4096 }    // 9: Best compression
+};
 
 //
-//  Global Variables
+// Compression state, allocated for each call to Compress()
 //
-STATIC UINT8  *mSrc;
-STATIC UINT8  *mDst;
-STATIC UINT8  *mSrcUpperLimit;
-STATIC UINT8  *mDstUpperLimit;
-
-STATIC UINT8  *mLevel;
-STATIC UINT8  *mText;
-STATIC UINT8  *mChildCount;
-STATIC UINT8  *mBuf;
-STATIC UINT8  mCLen[NC];
-STATIC UINT8  mPTLen[NPT];
-STATIC UINT8  *mLen;
-STATIC INT16  mHeap[NC + 1];
-STATIC INT32  mRemainder;
-STATIC INT32  mMatchLen;
-STATIC INT32  mBitCount;
-STATIC INT32  mHeapSize;
-STATIC INT32  mTempInt32;
-STATIC UINT32 mBufSiz = 0;
-STATIC UINT32 mOutputPos;
-STATIC UINT32 mOutputMask;
-STATIC UINT32 mSubBitBuf;
-STATIC UINT32 mCrc;
-STATIC UINT32 mCompSize;
-STATIC UINT32 mOrigSize;
-
-STATIC UINT16 *mFreq;
-STATIC UINT16 *mSortPtr;
-STATIC UINT16 mLenCnt[17];
-STATIC UINT16 mLeft[2 * NC - 1];
-STATIC UINT16 mRight[2 * NC - 1];
-STATIC UINT16 mCrcTable[MAX_UINT8 + 1];
-STATIC UINT16 mCFreq[2 * NC - 1];
-STATIC UINT16 mCCode[NC];
-STATIC UINT16 mPFreq[2 * NP - 1];
-STATIC UINT16 mPTCode[NPT];
-STATIC UINT16 mTFreq[2 * NT - 1];
-
-STATIC NODE   mPos;
-STATIC NODE   mMatchPos;
-STATIC NODE   mAvail;
-STATIC NODE   *mPosition;
-STATIC NODE   *mParent;
-STATIC NODE   *mPrev;
-STATIC NODE   *mNext = NULL;
-INT32         mHuffmanDepth = 0;
-
-/**
-  Make a CRC table.
-
-**/
-VOID
-EFIAPI
-MakeCrcTable (
-  VOID
-  )
-{
-  UINT32  LoopVar1;
+typedef struct {
+  UINT8                 *Src;
+  UINT8                 *Dst;
+  UINT8                 *SrcUpperLimit;
+  UINT8                 *DstUpperLimit;
+  UINT32                CompSize;
+  UINT32                OrigSize;
 
-  UINT32  LoopVar2;
-
-  UINT32  LoopVar4;
-
-  for (LoopVar1 = 0; LoopVar1 <= MAX_UINT8; LoopVar1++) {
-    LoopVar4 = LoopVar1;
-    for (LoopVar2 = 0; LoopVar2 < UINT8_BIT; LoopVar2++) {
-      if ((LoopVar4 & 1) != 0) {
-        LoopVar4 = (LoopVar4 >> 1) ^ CRCPOLY;
-      } else {
-        LoopVar4 >>= 1;
-      }
-    }
+  //
+  // Match finder
+  //
+  CONST COMPRESS_LEVEL  *Level;
+  UINT8                 *Text;
+  UINT16                *Head;
+  UINT16                *Prev;
+  INT32                 Pos;
+  INT32                 Remainder;
+  INT32                 MatchPos;
 
-    mCrcTable[LoopVar1] = (UINT16) LoopVar4;
-  }
-}
+  //
+  // Huffman encoder
+  //
+  UINT8                 *Buf;
+  UINT32                BufSiz;
+  UINT32                OutputPos;
+  UINT32                OutputMask;
+  UINT32                CPos;
+  UINT32                SubBitBuf;
+  INT32                 BitCount;
+  INT32                 HeapSize;
+  INT32                 TempInt32;
+  INT32                 HuffmanDepth;
+  UINT8                 *Len;
+  UINT16                *Freq;
+  UINT16                *SortPtr;
+  UINT8                 CLen[NC];
+  UINT8                 PTLen[NPT];
+  INT16                 Heap[NC + 1];
+  UINT16                LenCnt[17];
+  UINT16                Left[2 * NC - 1];
+  UINT16                Right[2 * NC - 1];
+  UINT16                CFreq[2 * NC - 1];
+  UINT16                CCode[NC];
+  UINT16                PFreq[2 * NP - 1];
+  UINT16                PTCode[NPT];
+  UINT16                TFreq[2 * NT - 1];
+} COMPRESS_CONTEXT;
 
 /**
   Put a dword to output stream
 
+  @param[in, out] Context   The compression context.
   @param[in] Data    The dword to put.
 **/
 VOID
 EFIAPI
 PutDword (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN UINT32 Data
   )
 {
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data)) & 0xff);
+  if (Context->Dst < Context->DstUpperLimit) {
+    *Context->Dst++ = (UINT8) (((UINT8) (Data)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
+  if (Context->Dst < Context->DstUpperLimit) {
+    *Context->Dst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
+  if (Context->Dst < Context->DstUpperLimit) {
+    *Context->Dst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
+  if (Context->Dst < Context->DstUpperLimit) {
+    *Context->Dst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
   }
 }
 
 /**
   Allocate memory spaces for data structures used in compression process.
 
+  @param[in, out] Context   The compression context.
+
   @retval EFI_SUCCESS           Memory was allocated successfully.
   @retval EFI_OUT_OF_RESOURCES  A memory allocation failed.
 **/
 EFI_STATUS
 EFIAPI
 AllocateMemory (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  mText       = AllocateZeroPool (WNDSIZ * 2 + MAXMATCH);
-  mLevel      = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mLevel));
-  mChildCount = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mChildCount));
-  mPosition   = AllocateZeroPool ((WNDSIZ + MAX_UINT8 + 1) * sizeof (*mPosition));
-  mParent     = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mParent));
-  mPrev       = AllocateZeroPool (WNDSIZ * 2 * sizeof (*mPrev));
-  mNext       = AllocateZeroPool ((MAX_HASH_VAL + 1) * sizeof (*mNext));
-
-  mBufSiz     = BLKSIZ;
-  mBuf        = AllocateZeroPool (mBufSiz);
-  while (mBuf == NULL) {
-    mBufSiz = (mBufSiz / 10U) * 9U;
-    if (mBufSiz < 4 * 1024U) {
+  Context->Text = AllocateZeroPool (WNDSIZ * 2 + MAXMATCH);
+  Context->Head = AllocateZeroPool (HASH_SIZE * sizeof (*Context->Head));
+  Context->Prev = AllocateZeroPool (WNDSIZ * sizeof (*Context->Prev));
+  if ((Context->Text == NULL) || (Context->Head == NULL) || (Context->Prev == NULL)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Context->BufSiz = BLKSIZ;
+  Context->Buf    = AllocateZeroPool (Context->BufSiz);
+  while (Context->Buf == NULL) {
+    Context->BufSiz = (Context->BufSiz / 10U) * 9U;
+    if (Context->BufSiz < 4 * 1024U) {
       return EFI_OUT_OF_RESOURCES;
     }
 
-    mBuf = AllocateZeroPool (mBufSiz);
+    Context->Buf = AllocateZeroPool (Context->BufSiz);
   }
 
-  mBuf[0] = 0;
+  Context->Buf[0] = 0;
 
   return EFI_SUCCESS;
 }
@@ -222,440 +211,213 @@ AllocateMemory (
 /**
   Called when compression is completed to free memory previously allocated.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 FreeMemory (
-  VOID
-  )
-{
-  SHELL_FREE_NON_NULL (mText);
-  SHELL_FREE_NON_NULL (mLevel);
-  SHELL_FREE_NON_NULL (mChildCount);
-  SHELL_FREE_NON_NULL (mPosition);
-  SHELL_FREE_NON_NULL (mParent);
-  SHELL_FREE_NON_NULL (mPrev);
-  SHELL_FREE_NON_NULL (mNext);
-  SHELL_FREE_NON_NULL (mBuf);
-}
-
-/**
-  Initialize String Info Log data structures.
-**/
-VOID
-EFIAPI
-InitSlide (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  NODE  LoopVar1;
-
-  SetMem (mLevel + WNDSIZ, (MAX_UINT8 + 1) * sizeof (UINT8), 1);
-  SetMem (mPosition + WNDSIZ, (MAX_UINT8 + 1) * sizeof (NODE), 0);
-
-  SetMem (mParent + WNDSIZ, WNDSIZ * sizeof (NODE), 0);
-
-  mAvail = 1;
-  for (LoopVar1 = 1; LoopVar1 < WNDSIZ - 1; LoopVar1++) {
-    mNext[LoopVar1] = (NODE) (LoopVar1 + 1);
-  }
-
-  mNext[WNDSIZ - 1] = NIL;
-  SetMem (mNext + WNDSIZ * 2, (MAX_HASH_VAL - WNDSIZ * 2 + 1) * sizeof (NODE), 0);
+  SHELL_FREE_NON_NULL (Context->Text);
+  SHELL_FREE_NON_NULL (Context->Head);
+  SHELL_FREE_NON_NULL (Context->Prev);
+  SHELL_FREE_NON_NULL (Context->Buf);
 }
 
 /**
-  Find child node given the parent node and the edge character
+  Read in source data
 
-  @param[in] LoopVar6       The parent node.
-  @param[in] LoopVar5       The edge character.
+  @param[in, out] Context   The compression context.
+  @param[out] Buffer        The buffer to hold the data.
+  @param[in] Length         The number of bytes to read.
 
-  @return             The child node.
-  @retval NIL(Zero)   No child could be found.
+  @return The number of bytes actually read.
 
 **/
-NODE
+INT32
 EFIAPI
-Child (
-  IN NODE   LoopVar6,
-  IN UINT8  LoopVar5
+ReadSource (
+  IN OUT COMPRESS_CONTEXT  *Context,
+  OUT    UINT8             *Buffer,
+  IN     INT32             Length
   )
 {
-  NODE  LoopVar4;
-
-  LoopVar4      = mNext[HASH (LoopVar6, LoopVar5)];
-  mParent[NIL]  = LoopVar6;  /* sentinel */
-  while (mParent[LoopVar4] != LoopVar6) {
-    LoopVar4 = mNext[LoopVar4];
+  if ((UINTN) Length > (UINTN) (Context->SrcUpperLimit - Context->Src)) {
+    Length = (INT32) (Context->SrcUpperLimit - Context->Src);
   }
 
-  return LoopVar4;
+  CopyMem (Buffer, Context->Src, Length);
+  Context->Src      += Length;
+  Context->OrigSize += Length;
+
+  return Length;
 }
 
 /**
-  Create a new child for a given parent node.
+  Add the string at the current position to its hash chain.
+
+  @param[in, out] Context   The compression context.
 
-  @param[in] LoopVar6       The parent node.
-  @param[in] LoopVar5       The edge character.
-  @param[in] LoopVar4       The child node.
+  @return The previous head of the hash chain, NIL if the chain was empty.
 
 **/
-VOID
+UINT16
 EFIAPI
-MakeChild (
-  IN NODE   LoopVar6,
-  IN UINT8  LoopVar5,
-  IN NODE   LoopVar4
+InsertString (
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  NODE  LoopVar12;
-
-  NODE  LoopVar10;
-
-  LoopVar12          = (NODE) HASH (LoopVar6, LoopVar5);
-  LoopVar10          = mNext[LoopVar12];
-  mNext[LoopVar12]   = LoopVar4;
-  mNext[LoopVar4]    = LoopVar10;
-  mPrev[LoopVar10]   = LoopVar4;
-  mPrev[LoopVar4]    = LoopVar12;
-  mParent[LoopVar4]  = LoopVar6;
-  mChildCount[LoopVar6]++;
-}
-
-/**
-  Split a node.
+  UINT32  Hash;
+  UINT16  Head;
 
-  @param[in] Old     The node to split.
+  Hash = HASH (&Context->Text[Context->Pos]);
+  Head = Context->Head[Hash];
+  Context->Prev[Context->Pos & (WNDSIZ - 1)] = Head;
+  Context->Head[Hash] = (UINT16) Context->Pos;
 
-**/
-VOID
-EFIAPI
-Split (
-  IN NODE Old
-  )
-{
-  NODE  New;
-
-  NODE  LoopVar10;
-
-  New               = mAvail;
-  mAvail            = mNext[New];
-  mChildCount[New]  = 0;
-  LoopVar10         = mPrev[Old];
-  mPrev[New]        = LoopVar10;
-  mNext[LoopVar10]  = New;
-  LoopVar10         = mNext[Old];
-  mNext[New]        = LoopVar10;
-  mPrev[LoopVar10]  = New;
-  mParent[New]      = mParent[Old];
-  mLevel[New]       = (UINT8) mMatchLen;
-  mPosition[New]    = mPos;
-  MakeChild (New, mText[mMatchPos + mMatchLen], Old);
-  MakeChild (New, mText[mPos + mMatchLen], mPos);
+  return Head;
 }
 
 /**
-  Insert string info for current position into the String Info Log.
+  Slide the window down by WNDSIZ bytes and read in new data.
+
+  @param[in, out] Context   The compression context.
 
 **/
 VOID
 EFIAPI
-InsertNode (
-  VOID
+SlideWindow (
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  NODE  LoopVar6;
-
-  NODE  LoopVar4;
+  UINT32  Index;
 
-  NODE  LoopVar2;
+  CopyMem (&Context->Text[0], &Context->Text[WNDSIZ], WNDSIZ + MAXMATCH);
+  Context->Remainder += ReadSource (Context, &Context->Text[WNDSIZ + MAXMATCH], WNDSIZ);
+  Context->Pos       -= WNDSIZ;
+  Context->MatchPos  -= WNDSIZ;
 
-  NODE  LoopVar10;
-  UINT8 LoopVar5;
-  UINT8 *TempString3;
-  UINT8 *TempString2;
-
-  if (mMatchLen >= 4) {
-    //
-    // We have just got a long match, the target tree
-    // can be located by MatchPos + 1. Travese the tree
-    // from bottom up to get to a proper starting point.
-    // The usage of PERC_FLAG ensures proper node deletion
-    // in DeleteNode() later.
-    //
-    mMatchLen--;
-    LoopVar4 = (NODE) ((mMatchPos + 1) | WNDSIZ);
-    LoopVar6 = mParent[LoopVar4];
-    while (LoopVar6 == NIL) {
-      LoopVar4 = mNext[LoopVar4];
-      LoopVar6 = mParent[LoopVar4];
-    }
-
-    while (mLevel[LoopVar6] >= mMatchLen) {
-      LoopVar4 = LoopVar6;
-      LoopVar6 = mParent[LoopVar6];
-    }
-
-    LoopVar10 = LoopVar6;
-    while (mPosition[LoopVar10] < 0) {
-      mPosition[LoopVar10]  = mPos;
-      LoopVar10             = mParent[LoopVar10];
-    }
-
-    if (LoopVar10 < WNDSIZ) {
-      mPosition[LoopVar10] = (NODE) (mPos | PERC_FLAG);
-    }
-  } else {
-    //
-    // Locate the target tree
-    //
-    LoopVar6 = (NODE) (mText[mPos] + WNDSIZ);
-    LoopVar5 = mText[mPos + 1];
-    LoopVar4 = Child (LoopVar6, LoopVar5);
-    if (LoopVar4 == NIL) {
-      MakeChild (LoopVar6, LoopVar5, mPos);
-      mMatchLen = 1;
-      return;
-    }
-
-    mMatchLen = 2;
-  }
   //
-  // Traverse down the tree to find a match.
-  // Update Position value along the route.
-  // Node split or creation is involved.
+  // Positions that fall out of the window end their chain
   //
-  for (;;) {
-    if (LoopVar4 >= WNDSIZ) {
-      LoopVar2  = MAXMATCH;
-      mMatchPos = LoopVar4;
-    } else {
-      LoopVar2  = mLevel[LoopVar4];
-      mMatchPos = (NODE) (mPosition[LoopVar4] & ~PERC_FLAG);
-    }
-
-    if (mMatchPos >= mPos) {
-      mMatchPos -= WNDSIZ;
-    }
-
-    TempString3 = &mText[mPos + mMatchLen];
-    TempString2 = &mText[mMatchPos + mMatchLen];
-    while (mMatchLen < LoopVar2) {
-      if (*TempString3 != *TempString2) {
-        Split (LoopVar4);
-        return;
-      }
-
-      mMatchLen++;
-      TempString3++;
-      TempString2++;
-    }
-
-    if (mMatchLen >= MAXMATCH) {
-      break;
-    }
-
-    mPosition[LoopVar4]  = mPos;
-    LoopVar6             = LoopVar4;
-    LoopVar4             = Child (LoopVar6, *TempString3);
-    if (LoopVar4 == NIL) {
-      MakeChild (LoopVar6, *TempString3, mPos);
-      return;
-    }
-
-    mMatchLen++;
+  for (Index = 0; Index < HASH_SIZE; Index++) {
+    Context->Head[Index] = (UINT16) ((Context->Head[Index] >= WNDSIZ) ? Context->Head[Index] - WNDSIZ : NIL);
   }
 
-  LoopVar10             = mPrev[LoopVar4];
-  mPrev[mPos]           = LoopVar10;
-  mNext[LoopVar10]      = mPos;
-  LoopVar10             = mNext[LoopVar4];
-  mNext[mPos]           = LoopVar10;
-  mPrev[LoopVar10]      = mPos;
-  mParent[mPos]         = LoopVar6;
-  mParent[LoopVar4]     = NIL;
-
-  //
-  // Special usage of 'next'
-  //
-  mNext[LoopVar4] = mPos;
-
+  for (Index = 0; Index < WNDSIZ; Index++) {
+    Context->Prev[Index] = (UINT16) ((Context->Prev[Index] >= WNDSIZ) ? Context->Prev[Index] - WNDSIZ : NIL);
+  }
 }
 
 /**
-  Delete outdated string info. (The Usage of PERC_FLAG
-  ensures a clean deletion).
+  Advance the current position, sliding the window if needed.
+
+  @param[in, out] Context   The compression context.
 
 **/
 VOID
 EFIAPI
-DeleteNode (
-  VOID
+AdvancePosition (
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  NODE  LoopVar6;
-
-  NODE  LoopVar4;
-
-  NODE  LoopVar11;
-
-  NODE  LoopVar10;
-
-  NODE  LoopVar9;
-
-  if (mParent[mPos] == NIL) {
-    return;
+  Context->Remainder--;
+  Context->Pos++;
+  if (Context->Pos == WNDSIZ * 2) {
+    SlideWindow (Context);
   }
-
-  LoopVar4             = mPrev[mPos];
-  LoopVar11            = mNext[mPos];
-  mNext[LoopVar4]      = LoopVar11;
-  mPrev[LoopVar11]     = LoopVar4;
-  LoopVar4             = mParent[mPos];
-  mParent[mPos]        = NIL;
-  if (LoopVar4 >= WNDSIZ) {
-    return;
-  }
-
-  mChildCount[LoopVar4]--;
-  if (mChildCount[LoopVar4] > 1) {
-    return;
-  }
-
-  LoopVar10 = (NODE) (mPosition[LoopVar4] & ~PERC_FLAG);
-  if (LoopVar10 >= mPos) {
-    LoopVar10 -= WNDSIZ;
-  }
-
-  LoopVar11 = LoopVar10;
-  LoopVar6 = mParent[LoopVar4];
-  LoopVar9 = mPosition[LoopVar6];
-  while ((LoopVar9 & PERC_FLAG) != 0) {
-    LoopVar9 &= ~PERC_FLAG;
-    if (LoopVar9 >= mPos) {
-      LoopVar9 -= WNDSIZ;
-    }
-
-    if (LoopVar9 > LoopVar11) {
-      LoopVar11 = LoopVar9;
-    }
-
-    mPosition[LoopVar6]  = (NODE) (LoopVar11 | WNDSIZ);
-    LoopVar6             = mParent[LoopVar6];
-    LoopVar9             = mPosition[LoopVar6];
-  }
-
-  if (LoopVar6 < WNDSIZ) {
-    if (LoopVar9 >= mPos) {
-      LoopVar9 -= WNDSIZ;
-    }
-
-    if (LoopVar9 > LoopVar11) {
-      LoopVar11 = LoopVar9;
-    }
-
-    mPosition[LoopVar6] = (NODE) (LoopVar11 | WNDSIZ | PERC_FLAG);
-  }
-
-  LoopVar11           = Child (LoopVar4, mText[LoopVar10 + mLevel[LoopVar4]]);
-  LoopVar10           = mPrev[LoopVar11];
-  LoopVar9            = mNext[LoopVar11];
-  mNext[LoopVar10]    = LoopVar9;
-  mPrev[LoopVar9]     = LoopVar10;
-  LoopVar10           = mPrev[LoopVar4];
-  mNext[LoopVar10]    = LoopVar11;
-  mPrev[LoopVar11]    = LoopVar10;
-  LoopVar10           = mNext[LoopVar4];
-  mPrev[LoopVar10]    = LoopVar11;
-  mNext[LoopVar11]    = LoopVar10;
-  mParent[LoopVar11]  = mParent[LoopVar4];
-  mParent[LoopVar4]   = NIL;
-  mNext[LoopVar4]     = mAvail;
-  mAvail              = LoopVar4;
 }
 
 /**
-  Read in source data
+  Find the longest match for the current position along its hash chain.
 
-  @param[out] LoopVar7   The buffer to hold the data.
-  @param[in] LoopVar8    The number of bytes to read.
+  Only matches longer than PrevLength are of interest. The position of the
+  best match is stored in Context->MatchPos.
 
-  @return The number of bytes actually read.
+  @param[in, out] Context     The compression context.
+  @param[in]      Candidate   The first chain entry to compare.
+  @param[in]      PrevLength  The length of the match at the previous position.
+
+  @return The length of the best match, PrevLength if none was longer.
 
 **/
 INT32
 EFIAPI
-FreadCrc (
-  OUT UINT8 *LoopVar7,
-  IN  INT32 LoopVar8
+LongestMatch (
+  IN OUT COMPRESS_CONTEXT  *Context,
+  IN     UINT16            Candidate,
+  IN     INT32             PrevLength
   )
 {
-  INT32 LoopVar1;
-
-  for (LoopVar1 = 0; mSrc < mSrcUpperLimit && LoopVar1 < LoopVar8; LoopVar1++) {
-    *LoopVar7++ = *mSrc++;
+  CONST COMPRESS_LEVEL  *Level;
+  UINT8                 *Scan;
+  UINT8                 *Match;
+  UINT32                ChainLength;
+  INT32                 Limit;
+  INT32                 MaxLen;
+  INT32                 NiceLength;
+  INT32                 BestLen;
+  INT32                 Len;
+  UINT16                Next;
+
+  Level       = Context->Level;
+  ChainLength = Level->MaxChain;
+  if (PrevLength >= Level->GoodLength) {
+    ChainLength >>= 2;
   }
 
-  LoopVar8 = LoopVar1;
-
-  LoopVar7 -= LoopVar8;
-  mOrigSize += LoopVar8;
-  LoopVar1--;
-  while (LoopVar1 >= 0) {
-    UPDATE_CRC (*LoopVar7++);
-    LoopVar1--;
+  MaxLen = (Context->Remainder < MAXMATCH) ? Context->Remainder : MAXMATCH;
+  if ((MaxLen < THRESHOLD) || (PrevLength >= MaxLen)) {
+    return PrevLength;
   }
 
-  return LoopVar8;
-}
+  NiceLength = (Level->NiceLength < MaxLen) ? Level->NiceLength : MaxLen;
+  BestLen    = PrevLength;
+  Limit      = Context->Pos - WNDSIZ;
+  Scan       = &Context->Text[Context->Pos];
 
-/**
-  Advance the current position (read in new data if needed).
-  Delete outdated string info. Find a match string for current position.
+  while ((Candidate > Limit) && (ChainLength-- > 0)) {
+    Match = &Context->Text[Candidate];
+    //
+    // Check the byte that would make the match longer first, it rejects
+    // most candidates with a single compare
+    //
+    if ((Match[BestLen] == Scan[BestLen]) && (Match[0] == Scan[0]) && (Match[1] == Scan[1])) {
+      for (Len = 2; (Len < MaxLen) && (Match[Len] == Scan[Len]); Len++) {
+      }
 
-  @retval TRUE      The operation was successful.
-  @retval FALSE     The operation failed due to insufficient memory.
+      if (Len > BestLen) {
+        Context->MatchPos = Candidate;
+        BestLen           = Len;
+        if (Len >= NiceLength) {
+          break;
+        }
+      }
+    }
 
-**/
-BOOLEAN
-EFIAPI
-GetNextMatch (
-  VOID
-  )
-{
-  INT32 LoopVar8;
-  VOID  *Temp;
-
-  mRemainder--;
-  mPos++;
-  if (mPos == WNDSIZ * 2) {
-    Temp = AllocateZeroPool (WNDSIZ + MAXMATCH);
-    if (Temp == NULL) {
-      return (FALSE);
+    Next = Context->Prev[Candidate & (WNDSIZ - 1)];
+    if (Next >= Candidate) {
+      break;
     }
-    CopyMem (Temp, &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    CopyMem (&mText[0], Temp, WNDSIZ + MAXMATCH);
-    FreePool (Temp);
-    LoopVar8 = FreadCrc (&mText[WNDSIZ + MAXMATCH], WNDSIZ);
-    mRemainder += LoopVar8;
-    mPos = WNDSIZ;
-  }
 
-  DeleteNode ();
-  InsertNode ();
+    Candidate = Next;
+  }
 
-  return (TRUE);
+  return BestLen;
 }
 
 /**
   Send entry LoopVar1 down the queue.
 
+  @param[in, out] Context   The compression context.
   @param[in] Index    The index of the item to move.
 
 **/
 VOID
 EFIAPI
 DownHeap (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32 Index
   )
 {
@@ -666,55 +428,59 @@ DownHeap (
   //
   // priority queue: send Index-th entry down heap
   //
-  LoopVar2 = mHeap[Index];
+  LoopVar2 = Context->Heap[Index];
   LoopVar1 = 2 * Index;
-  while (LoopVar1 <= mHeapSize) {
-    if (LoopVar1 < mHeapSize && mFreq[mHeap[LoopVar1]] > mFreq[mHeap[LoopVar1 + 1]]) {
+  while (LoopVar1 <= Context->HeapSize) {
+    if (LoopVar1 < Context->HeapSize && Context->Freq[Context->Heap[LoopVar1]] > Context->Freq[Context->Heap[LoopVar1 + 1]]) {
       LoopVar1++;
     }
 
-    if (mFreq[LoopVar2] <= mFreq[mHeap[LoopVar1]]) {
+    if (Context->Freq[LoopVar2] <= Context->Freq[Context->Heap[LoopVar1]]) {
       break;
     }
 
-    mHeap[Index]  = mHeap[LoopVar1];
+    Context->Heap[Index]  = Context->Heap[LoopVar1];
     Index         = LoopVar1;
     LoopVar1  = 2 * Index;
   }
 
-  mHeap[Index] = (INT16) LoopVar2;
+  Context->Heap[Index] = (INT16) LoopVar2;
 }
 
 /**
   Count the number of each code length for a Huffman tree.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar1      The top node.
 
 **/
 VOID
 EFIAPI
 CountLen (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32 LoopVar1
   )
 {
-  if (LoopVar1 < mTempInt32) {
-    mLenCnt[(mHuffmanDepth < 16) ? mHuffmanDepth : 16]++;
+  if (LoopVar1 < Context->TempInt32) {
+    Context->LenCnt[(Context->HuffmanDepth < 16) ? Context->HuffmanDepth : 16]++;
   } else {
-    mHuffmanDepth++;
-    CountLen (mLeft[LoopVar1]);
-    CountLen (mRight[LoopVar1]);
-    mHuffmanDepth--;
+    Context->HuffmanDepth++;
+    CountLen (Context, Context->Left[LoopVar1]);
+    CountLen (Context, Context->Right[LoopVar1]);
+    Context->HuffmanDepth--;
   }
 }
 
 /**
   Create code length array for a Huffman tree.
 
+  @param[in, out] Context   The compression context.
   @param[in] Root   The root of the tree.
 **/
 VOID
 EFIAPI
 MakeLen (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32 Root
   )
 {
@@ -724,10 +490,10 @@ MakeLen (
   UINT32  Cum;
 
   for (LoopVar1 = 0; LoopVar1 <= 16; LoopVar1++) {
-    mLenCnt[LoopVar1] = 0;
+    Context->LenCnt[LoopVar1] = 0;
   }
 
-  CountLen (Root);
+  CountLen (Context, Root);
 
   //
   // Adjust the length count array so that
@@ -735,15 +501,15 @@ MakeLen (
   //
   Cum = 0;
   for (LoopVar1 = 16; LoopVar1 > 0; LoopVar1--) {
-    Cum += mLenCnt[LoopVar1] << (16 - LoopVar1);
+    Cum += Context->LenCnt[LoopVar1] << (16 - LoopVar1);
   }
 
   while (Cum != (1U << 16)) {
-    mLenCnt[16]--;
+    Context->LenCnt[16]--;
     for (LoopVar1 = 15; LoopVar1 > 0; LoopVar1--) {
-      if (mLenCnt[LoopVar1] != 0) {
-        mLenCnt[LoopVar1]--;
-        mLenCnt[LoopVar1 + 1] += 2;
+      if (Context->LenCnt[LoopVar1] != 0) {
+        Context->LenCnt[LoopVar1]--;
+        Context->LenCnt[LoopVar1 + 1] += 2;
         break;
       }
     }
@@ -752,10 +518,10 @@ MakeLen (
   }
 
   for (LoopVar1 = 16; LoopVar1 > 0; LoopVar1--) {
-    LoopVar2 = mLenCnt[LoopVar1];
+    LoopVar2 = Context->LenCnt[LoopVar1];
     LoopVar2--;
     while (LoopVar2 >= 0) {
-      mLen[*mSortPtr++] = (UINT8) LoopVar1;
+      Context->Len[*Context->SortPtr++] = (UINT8) LoopVar1;
       LoopVar2--;
     }
   }
@@ -764,6 +530,7 @@ MakeLen (
 /**
   Assign code to each symbol based on the code length array.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar8      The number of symbols.
   @param[in] Len    The code length array.
   @param[out] Code  The stores codes for each symbol.
@@ -772,6 +539,7 @@ MakeLen (
 VOID
 EFIAPI
 MakeCode (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN  INT32         LoopVar8,
   IN  UINT8         Len[],
   OUT UINT16        Code[]
@@ -782,7 +550,7 @@ MakeCode (
 
   Start[1] = 0;
   for (LoopVar1 = 1; LoopVar1 <= 16; LoopVar1++) {
-    Start[LoopVar1 + 1] = (UINT16) ((Start[LoopVar1] + mLenCnt[LoopVar1]) << 1);
+    Start[LoopVar1 + 1] = (UINT16) ((Start[LoopVar1] + Context->LenCnt[LoopVar1]) << 1);
   }
 
   for (LoopVar1 = 0; LoopVar1 < LoopVar8; LoopVar1++) {
@@ -793,6 +561,7 @@ MakeCode (
 /**
   Generates Huffman codes given a frequency distribution of symbols.
 
+  @param[in, out] Context   The compression context.
   @param[in] NParm      The number of symbols.
   @param[in] FreqParm   The frequency of each symbol.
   @param[out] LenParm   The code length for each symbol.
@@ -804,6 +573,7 @@ MakeCode (
 INT32
 EFIAPI
 MakeTree (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN  INT32             NParm,
   IN  UINT16            FreqParm[],
   OUT UINT8             LenParm[],
@@ -821,57 +591,57 @@ MakeTree (
   //
   // make tree, calculate len[], return root
   //
-  mTempInt32        = NParm;
-  mFreq             = FreqParm;
-  mLen              = LenParm;
-  Avail             = mTempInt32;
-  mHeapSize         = 0;
-  mHeap[1]          = 0;
-  for (LoopVar1 = 0; LoopVar1 < mTempInt32; LoopVar1++) {
-    mLen[LoopVar1] = 0;
-    if ((mFreq[LoopVar1]) != 0) {
-      mHeapSize++;
-      mHeap[mHeapSize] = (INT16) LoopVar1;
+  Context->TempInt32        = NParm;
+  Context->Freq             = FreqParm;
+  Context->Len              = LenParm;
+  Avail             = Context->TempInt32;
+  Context->HeapSize         = 0;
+  Context->Heap[1]          = 0;
+  for (LoopVar1 = 0; LoopVar1 < Context->TempInt32; LoopVar1++) {
+    Context->Len[LoopVar1] = 0;
+    if ((Context->Freq[LoopVar1]) != 0) {
+      Context->HeapSize++;
+      Context->Heap[Context->HeapSize] = (INT16) LoopVar1;
     }
   }
 
-  if (mHeapSize < 2) {
-    CodeParm[mHeap[1]] = 0;
-    return mHeap[1];
+  if (Context->HeapSize < 2) {
+    CodeParm[Context->Heap[1]] = 0;
+    return Context->Heap[1];
   }
 
-  for (LoopVar1 = mHeapSize / 2; LoopVar1 >= 1; LoopVar1--) {
+  for (LoopVar1 = Context->HeapSize / 2; LoopVar1 >= 1; LoopVar1--) {
     //
     // make priority queue
     //
-    DownHeap (LoopVar1);
+    DownHeap (Context, LoopVar1);
   }
 
-  mSortPtr = CodeParm;
+  Context->SortPtr = CodeParm;
   do {
-    LoopVar1 = mHeap[1];
-    if (LoopVar1 < mTempInt32) {
-      *mSortPtr++ = (UINT16) LoopVar1;
+    LoopVar1 = Context->Heap[1];
+    if (LoopVar1 < Context->TempInt32) {
+      *Context->SortPtr++ = (UINT16) LoopVar1;
     }
 
-    mHeap[1] = mHeap[mHeapSize--];
-    DownHeap (1);
-    LoopVar2 = mHeap[1];
-    if (LoopVar2 < mTempInt32) {
-      *mSortPtr++ = (UINT16) LoopVar2;
+    Context->Heap[1] = Context->Heap[Context->HeapSize--];
+    DownHeap (Context, 1);
+    LoopVar2 = Context->Heap[1];
+    if (LoopVar2 < Context->TempInt32) {
+      *Context->SortPtr++ = (UINT16) LoopVar2;
     }
 
     LoopVar3         = Avail++;
-    mFreq[LoopVar3]  = (UINT16) (mFreq[LoopVar1] + mFreq[LoopVar2]);
-    mHeap[1]         = (INT16) LoopVar3;
-    DownHeap (1);
-    mLeft[LoopVar3]  = (UINT16) LoopVar1;
-    mRight[LoopVar3] = (UINT16) LoopVar2;
-  } while (mHeapSize > 1);
+    Context->Freq[LoopVar3]  = (UINT16) (Context->Freq[LoopVar1] + Context->Freq[LoopVar2]);
+    Context->Heap[1]         = (INT16) LoopVar3;
+    DownHeap (Context, 1);
+    Context->Left[LoopVar3]  = (UINT16) LoopVar1;
+    Context->Right[LoopVar3] = (UINT16) LoopVar2;
+  } while (Context->HeapSize > 1);
 
-  mSortPtr = CodeParm;
-  MakeLen (LoopVar3);
-  MakeCode (NParm, LenParm, CodeParm);
+  Context->SortPtr = CodeParm;
+  MakeLen (Context, LoopVar3);
+  MakeCode (Context, NParm, LenParm, CodeParm);
 
   //
   // return root
@@ -882,6 +652,7 @@ MakeTree (
 /**
   Outputs rightmost LoopVar8 bits of x
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar8   The rightmost LoopVar8 bits of the data is used.
   @param[in] x   The data.
 
@@ -889,33 +660,34 @@ MakeTree (
 VOID
 EFIAPI
 PutBits (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32    LoopVar8,
   IN UINT32   x
   )
 {
   UINT8 Temp;
 
-  if (LoopVar8 < mBitCount) {
-    mSubBitBuf |= x << (mBitCount -= LoopVar8);
+  if (LoopVar8 < Context->BitCount) {
+    Context->SubBitBuf |= x << (Context->BitCount -= LoopVar8);
   } else {
 
-    Temp = (UINT8) (mSubBitBuf | (x >> (LoopVar8 -= mBitCount)));
-    if (mDst < mDstUpperLimit) {
-      *mDst++ = Temp;
+    Temp = (UINT8) (Context->SubBitBuf | (x >> (LoopVar8 -= Context->BitCount)));
+    if (Context->Dst < Context->DstUpperLimit) {
+      *Context->Dst++ = Temp;
     }
-    mCompSize++;
+    Context->CompSize++;
 
     if (LoopVar8 < UINT8_BIT) {
-      mSubBitBuf = x << (mBitCount = UINT8_BIT - LoopVar8);
+      Context->SubBitBuf = x << (Context->BitCount = UINT8_BIT - LoopVar8);
     } else {
 
       Temp = (UINT8) (x >> (LoopVar8 - UINT8_BIT));
-      if (mDst < mDstUpperLimit) {
-        *mDst++ = Temp;
+      if (Context->Dst < Context->DstUpperLimit) {
+        *Context->Dst++ = Temp;
       }
-      mCompSize++;
+      Context->CompSize++;
 
-      mSubBitBuf = x << (mBitCount = 2 * UINT8_BIT - LoopVar8);
+      Context->SubBitBuf = x << (Context->BitCount = 2 * UINT8_BIT - LoopVar8);
     }
   }
 }
@@ -923,25 +695,29 @@ PutBits (
 /**
   Encode a signed 32 bit number.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar5     The number to encode.
 **/
 VOID
 EFIAPI
 EncodeC (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32 LoopVar5
   )
 {
-  PutBits (mCLen[LoopVar5], mCCode[LoopVar5]);
+  PutBits (Context, Context->CLen[LoopVar5], Context->CCode[LoopVar5]);
 }
 
 /**
   Encode a unsigned 32 bit number.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar7     The number to encode.
 **/
 VOID
 EFIAPI
 EncodeP (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN UINT32 LoopVar7
   )
 {
@@ -956,20 +732,21 @@ EncodeP (
     LoopVar5++;
   }
 
-  PutBits (mPTLen[LoopVar5], mPTCode[LoopVar5]);
+  PutBits (Context, Context->PTLen[LoopVar5], Context->PTCode[LoopVar5]);
   if (LoopVar5 > 1) {
-    PutBits (LoopVar5 - 1, LoopVar7 & (0xFFFFU >> (17 - LoopVar5)));
+    PutBits (Context, LoopVar5 - 1, LoopVar7 & (0xFFFFU >> (17 - LoopVar5)));
   }
 }
 
 /**
   Count the frequencies for the Extra Set.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 CountTFreq (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
   INT32 LoopVar1;
@@ -981,40 +758,40 @@ CountTFreq (
   INT32 Count;
 
   for (LoopVar1 = 0; LoopVar1 < NT; LoopVar1++) {
-    mTFreq[LoopVar1] = 0;
+    Context->TFreq[LoopVar1] = 0;
   }
 
   LoopVar8 = NC;
-  while (LoopVar8 > 0 && mCLen[LoopVar8 - 1] == 0) {
+  while (LoopVar8 > 0 && Context->CLen[LoopVar8 - 1] == 0) {
     LoopVar8--;
   }
 
   LoopVar1 = 0;
   while (LoopVar1 < LoopVar8) {
-    LoopVar3 = mCLen[LoopVar1++];
+    LoopVar3 = Context->CLen[LoopVar1++];
     if (LoopVar3 == 0) {
       Count = 1;
-      while (LoopVar1 < LoopVar8 && mCLen[LoopVar1] == 0) {
+      while (LoopVar1 < LoopVar8 && Context->CLen[LoopVar1] == 0) {
         LoopVar1++;
         Count++;
       }
 
       if (Count <= 2) {
-        mTFreq[0] = (UINT16) (mTFreq[0] + Count);
+        Context->TFreq[0] = (UINT16) (Context->TFreq[0] + Count);
       } else if (Count <= 18) {
-        mTFreq[1]++;
+        Context->TFreq[1]++;
       } else if (Count == 19) {
-        mTFreq[0]++;
-        mTFreq[1]++;
+        Context->TFreq[0]++;
+        Context->TFreq[1]++;
       } else {
-        mTFreq[2]++;
+        Context->TFreq[2]++;
       }
     } else {
       ASSERT ((LoopVar3 + 2) < (2 * NT - 1));
       if ((LoopVar3 + 2) >= (2 * NT - 1)) {
         return;
       }
-      mTFreq[LoopVar3 + 2]++;
+      Context->TFreq[LoopVar3 + 2]++;
     }
   }
 }
@@ -1022,6 +799,7 @@ CountTFreq (
 /**
   Outputs the code length array for the Extra Set or the Position Set.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar8       The number of symbols.
   @param[in] nbit           The number of bits needed to represent 'LoopVar8'.
   @param[in] Special        The special symbol that needs to be take care of.
@@ -1030,6 +808,7 @@ CountTFreq (
 VOID
 EFIAPI
 WritePTLen (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN INT32 LoopVar8,
   IN INT32 nbit,
   IN INT32 Special
@@ -1039,26 +818,26 @@ WritePTLen (
 
   INT32 LoopVar3;
 
-  while (LoopVar8 > 0 && mPTLen[LoopVar8 - 1] == 0) {
+  while (LoopVar8 > 0 && Context->PTLen[LoopVar8 - 1] == 0) {
     LoopVar8--;
   }
 
-  PutBits (nbit, LoopVar8);
+  PutBits (Context, nbit, LoopVar8);
   LoopVar1 = 0;
   while (LoopVar1 < LoopVar8) {
-    LoopVar3 = mPTLen[LoopVar1++];
+    LoopVar3 = Context->PTLen[LoopVar1++];
     if (LoopVar3 <= 6) {
-      PutBits (3, LoopVar3);
+      PutBits (Context, 3, LoopVar3);
     } else {
-      PutBits (LoopVar3 - 3, (1U << (LoopVar3 - 3)) - 2);
+      PutBits (Context, LoopVar3 - 3, (1U << (LoopVar3 - 3)) - 2);
     }
 
     if (LoopVar1 == Special) {
-      while (LoopVar1 < 6 && mPTLen[LoopVar1] == 0) {
+      while (LoopVar1 < 6 && Context->PTLen[LoopVar1] == 0) {
         LoopVar1++;
       }
 
-      PutBits (2, (LoopVar1 - 3) & 3);
+      PutBits (Context, 2, (LoopVar1 - 3) & 3);
     }
   }
 }
@@ -1066,11 +845,12 @@ WritePTLen (
 /**
   Outputs the code length array for Char&Length Set.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 WriteCLen (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
   INT32 LoopVar1;
@@ -1082,42 +862,42 @@ WriteCLen (
   INT32 Count;
 
   LoopVar8 = NC;
-  while (LoopVar8 > 0 && mCLen[LoopVar8 - 1] == 0) {
+  while (LoopVar8 > 0 && Context->CLen[LoopVar8 - 1] == 0) {
     LoopVar8--;
   }
 
-  PutBits (CBIT, LoopVar8);
+  PutBits (Context, CBIT, LoopVar8);
   LoopVar1 = 0;
   while (LoopVar1 < LoopVar8) {
-    LoopVar3 = mCLen[LoopVar1++];
+    LoopVar3 = Context->CLen[LoopVar1++];
     if (LoopVar3 == 0) {
       Count = 1;
-      while (LoopVar1 < LoopVar8 && mCLen[LoopVar1] == 0) {
+      while (LoopVar1 < LoopVar8 && Context->CLen[LoopVar1] == 0) {
         LoopVar1++;
         Count++;
       }
 
       if (Count <= 2) {
         for (LoopVar3 = 0; LoopVar3 < Count; LoopVar3++) {
-          PutBits (mPTLen[0], mPTCode[0]);
+          PutBits (Context, Context->PTLen[0], Context->PTCode[0]);
         }
       } else if (Count <= 18) {
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, Count - 3);
+        PutBits (Context, Context->PTLen[1], Context->PTCode[1]);
+        PutBits (Context, 4, Count - 3);
       } else if (Count == 19) {
-        PutBits (mPTLen[0], mPTCode[0]);
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, 15);
+        PutBits (Context, Context->PTLen[0], Context->PTCode[0]);
+        PutBits (Context, Context->PTLen[1], Context->PTCode[1]);
+        PutBits (Context, 4, 15);
       } else {
-        PutBits (mPTLen[2], mPTCode[2]);
-        PutBits (CBIT, Count - 20);
+        PutBits (Context, Context->PTLen[2], Context->PTCode[2]);
+        PutBits (Context, CBIT, Count - 20);
       }
     } else {
       ASSERT ((LoopVar3 + 2) < NPT);
       if ((LoopVar3 + 2) >= NPT) {
         return;
       }
-      PutBits (mPTLen[LoopVar3 + 2], mPTCode[LoopVar3 + 2]);
+      PutBits (Context, Context->PTLen[LoopVar3 + 2], Context->PTCode[LoopVar3 + 2]);
     }
   }
 }
@@ -1125,11 +905,12 @@ WriteCLen (
 /**
   Huffman code the block and output it.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 SendBlock (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
   UINT32  LoopVar1;
@@ -1145,79 +926,81 @@ SendBlock (
   UINT32  Size;
   Flags = 0;
 
-  Root = MakeTree (NC, mCFreq, mCLen, mCCode);
-  Size = mCFreq[Root];
-  PutBits (16, Size);
+  Root = MakeTree (Context, NC, Context->CFreq, Context->CLen, Context->CCode);
+  Size = Context->CFreq[Root];
+  PutBits (Context, 16, Size);
   if (Root >= NC) {
-    CountTFreq ();
-    Root = MakeTree (NT, mTFreq, mPTLen, mPTCode);
+    CountTFreq (Context);
+    Root = MakeTree (Context, NT, Context->TFreq, Context->PTLen, Context->PTCode);
     if (Root >= NT) {
-      WritePTLen (NT, TBIT, 3);
+      WritePTLen (Context, NT, TBIT, 3);
     } else {
-      PutBits (TBIT, 0);
-      PutBits (TBIT, Root);
+      PutBits (Context, TBIT, 0);
+      PutBits (Context, TBIT, Root);
     }
 
-    WriteCLen ();
+    WriteCLen (Context);
   } else {
-    PutBits (TBIT, 0);
-    PutBits (TBIT, 0);
-    PutBits (CBIT, 0);
-    PutBits (CBIT, Root);
+    PutBits (Context, TBIT, 0);
+    PutBits (Context, TBIT, 0);
+    PutBits (Context, CBIT, 0);
+    PutBits (Context, CBIT, Root);
   }
 
-  Root = MakeTree (NP, mPFreq, mPTLen, mPTCode);
+  Root = MakeTree (Context, NP, Context->PFreq, Context->PTLen, Context->PTCode);
   if (Root >= NP) {
-    WritePTLen (NP, PBIT, -1);
+    WritePTLen (Context, NP, PBIT, -1);
   } else {
-    PutBits (PBIT, 0);
-    PutBits (PBIT, Root);
+    PutBits (Context, PBIT, 0);
+    PutBits (Context, PBIT, Root);
   }
 
   Pos = 0;
   for (LoopVar1 = 0; LoopVar1 < Size; LoopVar1++) {
     if (LoopVar1 % UINT8_BIT == 0) {
-      Flags = mBuf[Pos++];
+      Flags = Context->Buf[Pos++];
     } else {
       Flags <<= 1;
     }
     if ((Flags & (1U << (UINT8_BIT - 1))) != 0) {
-      EncodeC (mBuf[Pos++] + (1U << UINT8_BIT));
-      LoopVar3 = mBuf[Pos++] << UINT8_BIT;
-      LoopVar3 += mBuf[Pos++];
+      EncodeC (Context, Context->Buf[Pos++] + (1U << UINT8_BIT));
+      LoopVar3 = Context->Buf[Pos++] << UINT8_BIT;
+      LoopVar3 += Context->Buf[Pos++];
 
-      EncodeP (LoopVar3);
+      EncodeP (Context, LoopVar3);
     } else {
-      EncodeC (mBuf[Pos++]);
+      EncodeC (Context, Context->Buf[Pos++]);
     }
   }
 
-  SetMem (mCFreq, NC * sizeof (UINT16), 0);
-  SetMem (mPFreq, NP * sizeof (UINT16), 0);
+  SetMem (Context->CFreq, NC * sizeof (UINT16), 0);
+  SetMem (Context->PFreq, NP * sizeof (UINT16), 0);
 }
 
 /**
   Start the huffman encoding.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 HufEncodeStart (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  SetMem (mCFreq, NC * sizeof (UINT16), 0);
-  SetMem (mPFreq, NP * sizeof (UINT16), 0);
+  SetMem (Context->CFreq, NC * sizeof (UINT16), 0);
+  SetMem (Context->PFreq, NP * sizeof (UINT16), 0);
 
-  mOutputPos = mOutputMask = 0;
+  Context->OutputPos = Context->OutputMask = 0;
 
-  mBitCount   = UINT8_BIT;
-  mSubBitBuf  = 0;
+  Context->BitCount   = UINT8_BIT;
+  Context->SubBitBuf  = 0;
 }
 
 /**
   Outputs an Original Character or a Pointer.
 
+  @param[in, out] Context   The compression context.
   @param[in] LoopVar5     The original character or the 'String Length' element of
                    a Pointer.
   @param[in] LoopVar7     The 'Position' field of a Pointer.
@@ -1225,129 +1008,143 @@ HufEncodeStart (
 VOID
 EFIAPI
 CompressOutput (
+  IN OUT COMPRESS_CONTEXT  *Context,
   IN UINT32 LoopVar5,
   IN UINT32 LoopVar7
   )
 {
-  STATIC UINT32 CPos;
-
-  if ((mOutputMask >>= 1) == 0) {
-    mOutputMask = 1U << (UINT8_BIT - 1);
-    if (mOutputPos >= mBufSiz - 3 * UINT8_BIT) {
-      SendBlock ();
-      mOutputPos = 0;
+  if ((Context->OutputMask >>= 1) == 0) {
+    Context->OutputMask = 1U << (UINT8_BIT - 1);
+    if (Context->OutputPos >= Context->BufSiz - 3 * UINT8_BIT) {
+      SendBlock (Context);
+      Context->OutputPos = 0;
     }
 
-    CPos        = mOutputPos++;
-    mBuf[CPos]  = 0;
+    Context->CPos        = Context->OutputPos++;
+    Context->Buf[Context->CPos]  = 0;
   }
-  mBuf[mOutputPos++] = (UINT8) LoopVar5;
-  mCFreq[LoopVar5]++;
+  Context->Buf[Context->OutputPos++] = (UINT8) LoopVar5;
+  Context->CFreq[LoopVar5]++;
   if (LoopVar5 >= (1U << UINT8_BIT)) {
-    mBuf[CPos] = (UINT8) (mBuf[CPos]|mOutputMask);
-    mBuf[mOutputPos++] = (UINT8) (LoopVar7 >> UINT8_BIT);
-    mBuf[mOutputPos++] = (UINT8) LoopVar7;
+    Context->Buf[Context->CPos] = (UINT8) (Context->Buf[Context->CPos]|Context->OutputMask);
+    Context->Buf[Context->OutputPos++] = (UINT8) (LoopVar7 >> UINT8_BIT);
+    Context->Buf[Context->OutputPos++] = (UINT8) LoopVar7;
     LoopVar5           = 0;
     while (LoopVar7 != 0) {
       LoopVar7 >>= 1;
       LoopVar5++;
     }
-    mPFreq[LoopVar5]++;
+    Context->PFreq[LoopVar5]++;
   }
 }
 
 /**
   End the huffman encoding.
 
+  @param[in, out] Context   The compression context.
 **/
 VOID
 EFIAPI
 HufEncodeEnd (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
-  SendBlock ();
+  SendBlock (Context);
 
   //
   // Flush remaining bits
   //
-  PutBits (UINT8_BIT - 1, 0);
+  PutBits (Context, UINT8_BIT - 1, 0);
 }
 
 /**
   The main controlling routine for compression process.
 
+  A match found at one position is only output after checking whether the
+  next position has a longer one (lazy matching), unless it is already at
+  least MaxLazy bytes long.
+
+  @param[in, out] Context   The compression context.
+
   @retval EFI_SUCCESS           The compression is successful.
   @retval EFI_OUT_0F_RESOURCES  Not enough memory for compression process.
 **/
 EFI_STATUS
 EFIAPI
 Encode (
-  VOID
+  IN OUT COMPRESS_CONTEXT  *Context
   )
 {
   EFI_STATUS  Status;
-  INT32       LastMatchLen;
-  NODE        LastMatchPos;
-
-  Status = AllocateMemory ();
+  UINT16      Candidate;
+  INT32       MatchLen;
+  INT32       PrevLength;
+  INT32       PrevMatch;
+  INT32       Count;
+  BOOLEAN     MatchAvailable;
+
+  Status = AllocateMemory (Context);
   if (EFI_ERROR (Status)) {
-    FreeMemory ();
+    FreeMemory (Context);
     return Status;
   }
 
-  InitSlide ();
+  HufEncodeStart (Context);
 
-  HufEncodeStart ();
+  Context->Remainder = ReadSource (Context, &Context->Text[WNDSIZ], WNDSIZ + MAXMATCH);
+  Context->Pos       = WNDSIZ;
+  MatchLen           = THRESHOLD - 1;
+  MatchAvailable     = FALSE;
 
-  mRemainder  = FreadCrc (&mText[WNDSIZ], WNDSIZ + MAXMATCH);
-
-  mMatchLen   = 0;
-  mPos        = WNDSIZ;
-  InsertNode ();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
-  }
+  while (Context->Remainder > 0) {
+    Candidate  = InsertString (Context);
+    PrevLength = MatchLen;
+    PrevMatch  = Context->MatchPos;
+    MatchLen   = THRESHOLD - 1;
 
-  while (mRemainder > 0) {
-    LastMatchLen = mMatchLen;
-    LastMatchPos = mMatchPos;
-    if (!GetNextMatch ()) {
-      Status = EFI_OUT_OF_RESOURCES;
-    }
-    if (mMatchLen > mRemainder) {
-      mMatchLen = mRemainder;
+    if ((Candidate != NIL) && (PrevLength < Context->Level->MaxLazy)) {
+      MatchLen = LongestMatch (Context, Candidate, PrevLength);
     }
 
-    if (mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
+    if ((PrevLength >= THRESHOLD) && (MatchLen <= PrevLength)) {
       //
-      // Not enough benefits are gained by outputting a pointer,
-      // so just output the original character
+      // The match at the previous position is at least as long as the one
+      // here, output a pointer to it and skip over the rest of it.
       //
-      CompressOutput (mText[mPos - 1], 0);
+      CompressOutput (
+        Context,
+        PrevLength + (MAX_UINT8 + 1 - THRESHOLD),
+        Context->Pos - PrevMatch - 2
+        );
+      for (Count = PrevLength - 1; Count > 0; Count--) {
+        AdvancePosition (Context);
+        if (Count > 1) {
+          InsertString (Context);
+        }
+      }
+
+      MatchAvailable = FALSE;
+      MatchLen       = THRESHOLD - 1;
     } else {
       //
-      // Outputting a pointer is beneficial enough, do it.
+      // Not enough benefits are gained by outputting a pointer,
+      // so just output the original character
       //
-
-      CompressOutput (LastMatchLen + (MAX_UINT8 + 1 - THRESHOLD),
-        (mPos - LastMatchPos - 2) & (WNDSIZ - 1));
-      LastMatchLen--;
-      while (LastMatchLen > 0) {
-        if (!GetNextMatch ()) {
-          Status = EFI_OUT_OF_RESOURCES;
-        }
-        LastMatchLen--;
+      if (MatchAvailable) {
+        CompressOutput (Context, Context->Text[Context->Pos - 1], 0);
       }
 
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
-      }
+      MatchAvailable = TRUE;
+      AdvancePosition (Context);
     }
   }
 
-  HufEncodeEnd ();
-  FreeMemory ();
+  if (MatchAvailable) {
+    CompressOutput (Context, Context->Text[Context->Pos - 1], 0);
+  }
+
+  HufEncodeEnd (Context);
+  FreeMemory (Context);
   return (Status);
 }
 
@@ -1362,6 +1159,7 @@ Encode (
 
   @retval EFI_SUCCESS           The compression was sucessful.
   @retval EFI_BUFFER_TOO_SMALL  The buffer was too small.  DstSize is required.
+  @retval EFI_OUT_OF_RESOURCES  Not enough memory for compression process.
 **/
 EFI_STATUS
 EFIAPI
@@ -1372,64 +1170,67 @@ Compress (
   IN OUT   UINT64 *DstSize
   )
 {
-  EFI_STATUS  Status;
+  EFI_STATUS        Status;
+  COMPRESS_CONTEXT  *Context;
+  UINT8             Level;
+  UINT32            CompSize;
+
+  Context = AllocateZeroPool (sizeof (*Context));
+  if (Context == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
   //
   // Initializations
   //
-  mBufSiz         = 0;
-  mBuf            = NULL;
-  mText           = NULL;
-  mLevel          = NULL;
-  mChildCount     = NULL;
-  mPosition       = NULL;
-  mParent         = NULL;
-  mPrev           = NULL;
-  mNext           = NULL;
-
-  mSrc            = SrcBuffer;
-  mSrcUpperLimit  = mSrc + SrcSize;
-  mDst            = DstBuffer;
-  mDstUpperLimit  = mDst + *DstSize;
-
-  PutDword (0L);
-  PutDword (0L);
+  Level = PcdGet8 (PcdCompressLibLevel);
+  ASSERT ((Level >= 1) && (Level < ARRAY_SIZE (mCompressLevel)));
+  if ((Level < 1) || (Level >= ARRAY_SIZE (mCompressLevel))) {
+    Level = 6;
+  }
+  Context->Level          = &mCompressLevel[Level];
 
-  MakeCrcTable ();
+  Context->Src            = SrcBuffer;
+  Context->SrcUpperLimit  = Context->Src + SrcSize;
+  Context->Dst            = DstBuffer;
+  Context->DstUpperLimit  = Context->Dst + *DstSize;
 
-  mOrigSize       = mCompSize = 0;
-  mCrc            = INIT_CRC;
+  PutDword (Context, 0L);
+  PutDword (Context, 0L);
 
   //
   // Compress it
   //
-  Status = Encode ();
+  Status = Encode (Context);
   if (EFI_ERROR (Status)) {
+    FreePool (Context);
     return EFI_OUT_OF_RESOURCES;
   }
   //
   // Null terminate the compressed data
   //
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = 0;
+  if (Context->Dst < Context->DstUpperLimit) {
+    *Context->Dst++ = 0;
   }
   //
   // Fill in compressed size and original size
   //
-  mDst = DstBuffer;
-  PutDword (mCompSize + 1);
-  PutDword (mOrigSize);
+  Context->Dst = DstBuffer;
+  PutDword (Context, Context->CompSize + 1);
+  PutDword (Context, Context->OrigSize);
+
+  CompSize = Context->CompSize;
+  FreePool (Context);
 
   //
   // Return
   //
-  if (mCompSize + 1 + 8 > *DstSize) {
-    *DstSize = mCompSize + 1 + 8;
+  if (CompSize + 1 + 8 > *DstSize) {
+    *DstSize = CompSize + 1 + 8;
     return EFI_BUFFER_TOO_SMALL;
   } else {
-    *DstSize = mCompSize + 1 + 8;
+    *DstSize = CompSize + 1 + 8;
     return EFI_SUCCESS;
   }
 
 }
-
@@ -0,0 +1,200 @@
+/** @file
+  Host benchmark for CompressLib.
+
+  Reports the compression ratio, and the compression and decompression speed,
+  at every PcdCompressLibLevel. It runs on the files given on the command
+  line, or on generated sample data when there are none. Every result is
+  decoded with the standard EFI decompressor and checked against the input.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "CompressLibHostSupport.h"
+
+//
+// Each measurement runs for at least this long
+//
+#define COMPRESS_BENCH_MIN_NS  (200ULL * 1000 * 1000)
+
+//
+// Size of the generated samples
+//
+#define COMPRESS_BENCH_SAMPLE_SIZE  SIZE_512KB
+
+/**
+  Reads the host clock.
+
+  @return Current time, in nanoseconds.
+
+**/
+STATIC
+UINT64
+CompressBenchGetTimeNs (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+/**
+  Benchmarks every level on one input and prints a line for each.
+
+  @param[in]  Name    The name of the input.
+  @param[in]  Source  The input.
+  @param[in]  Size    The size of Source in bytes.
+
+  @retval TRUE   Every level round-tripped.
+  @retval FALSE  Some level did not.
+
+**/
+STATIC
+BOOLEAN
+CompressBenchRun (
+  IN CONST CHAR8  *Name,
+  IN UINT8        *Source,
+  IN UINTN        Size
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Compressed;
+  UINT8       *Decoded;
+  UINTN       CompressedSize;
+  UINTN       DecodedSize;
+  UINT8       Level;
+  UINT64      Start;
+  UINT64      CompressNs;
+  UINT64      DecompressNs;
+  UINT64      Iterations;
+  BOOLEAN     Passed;
+
+  Compressed = AllocatePool (CompressHostBound (Size));
+  Decoded    = AllocatePool (MAX (Size, 1));
+  if ((Compressed == NULL) || (Decoded == NULL)) {
+    printf ("%s: out of memory\n", Name);
+    return FALSE;
+  }
+
+  printf ("%s, %u bytes\n", Name, (UINT32) Size);
+  printf ("  level   compressed    ratio   compress MB/s   decompress MB/s\n");
+
+  Passed = TRUE;
+  for (Level = COMPRESS_HOST_MIN_LEVEL; Level <= COMPRESS_HOST_MAX_LEVEL; Level++) {
+    CompressNs = 0;
+    for (Iterations = 0; CompressNs < COMPRESS_BENCH_MIN_NS; Iterations++) {
+      CompressedSize = CompressHostBound (Size);
+      Start          = CompressBenchGetTimeNs ();
+      Status         = CompressHostCompress (Level, Source, Size, Compressed, &CompressedSize);
+      CompressNs    += CompressBenchGetTimeNs () - Start;
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      printf ("  %5u   compression failed: 0x%llx\n", Level, (UINT64) Status);
+      Passed = FALSE;
+      continue;
+    }
+
+    CompressNs  /= Iterations;
+    DecompressNs = 0;
+    for (Iterations = 0; DecompressNs < COMPRESS_BENCH_MIN_NS; Iterations++) {
+      Start         = CompressBenchGetTimeNs ();
+      Status        = CompressHostDecompress (Compressed, CompressedSize, Decoded, Size, &DecodedSize);
+      DecompressNs += CompressBenchGetTimeNs () - Start;
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+
+    DecompressNs /= Iterations;
+    if (EFI_ERROR (Status) || (DecodedSize != Size) || (CompareMem (Decoded, Source, Size) != 0)) {
+      printf ("  %5u   round trip failed\n", Level);
+      Passed = FALSE;
+      continue;
+    }
+
+    printf (
+      "  %5u   %10u   %5.1f%%   %13.1f   %15.1f\n",
+      Level,
+      (UINT32) CompressedSize,
+      (Size == 0) ? 0.0 : 100.0 * CompressedSize / Size,
+      (double) Size * 1e3 / MAX (CompressNs, 1),
+      (double) Size * 1e3 / MAX (DecompressNs, 1)
+      );
+  }
+
+  FreePool (Compressed);
+  FreePool (Decoded);
+  return Passed;
+}
+
+/**
+  Standard POSIX C entry point.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  UINT8    *Source;
+  long     Size;
+  FILE     *File;
+  int      Index;
+  BOOLEAN  Passed;
+
+  Passed = TRUE;
+
+  if (argc < 2) {
+    Source = AllocatePool (COMPRESS_BENCH_SAMPLE_SIZE);
+    if (Source == NULL) {
+      return 1;
+    }
+
+    for (Index = 0; Index < CompressHostSampleMax; Index++) {
+      CompressHostFillSample ((COMPRESS_HOST_SAMPLE) Index, Source, COMPRESS_BENCH_SAMPLE_SIZE);
+      Passed &= CompressBenchRun (mCompressHostSampleName[Index], Source, COMPRESS_BENCH_SAMPLE_SIZE);
+    }
+
+    FreePool (Source);
+    return Passed ? 0 : 1;
+  }
+
+  for (Index = 1; Index < argc; Index++) {
+    File = fopen (argv[Index], "rb");
+    if (File == NULL) {
+      printf ("%s: cannot open\n", argv[Index]);
+      Passed = FALSE;
+      continue;
+    }
+
+    fseek (File, 0, SEEK_END);
+    Size = ftell (File);
+    fseek (File, 0, SEEK_SET);
+
+    Source = AllocatePool (MAX (Size, 1));
+    if ((Source == NULL) || (fread (Source, 1, Size, File) != (size_t) Size)) {
+      printf ("%s: cannot read\n", argv[Index]);
+      Passed = FALSE;
+    } else {
+      Passed &= CompressBenchRun (argv[Index], Source, Size);
+    }
+
+    if (Source != NULL) {
+      FreePool (Source);
+    }
+
+    fclose (File);
+  }
+
+  return Passed ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/** @file
+  Sample data and round-trip helper shared by the CompressLib host unit test
+  and benchmark.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "CompressLibHostSupport.h"
+
+CONST CHAR8  *mCompressHostSampleName[CompressHostSampleMax] = {
+  "sparse",
+  "text",
+  "binary",
+  "random"
+};
+
+STATIC CONST CHAR8  *mWords[] = {
+  "the", "memory", "training", "data", "was", "restored", "from", "variable",
+  "FSP", "NVS", "buffer", "size", "status", "success", "channel", "dimm",
+  "rank", "timing", "margin", "PEI", "DXE", "driver", "loaded", "at",
+  "address", "entry", "point", "image", "base", "length", "protocol", "installed"
+};
+
+/**
+  Returns the next value of a linear congruential generator.
+
+  @param[in, out]  Seed  The generator state.
+
+  @return A pseudo-random 32-bit value.
+
+**/
+STATIC
+UINT32
+CompressHostRandom (
+  IN OUT UINT32  *Seed
+  )
+{
+  *Seed = *Seed * 1103515245 + 12345;
+  return (*Seed >> 16) | (*Seed << 16);
+}
+
+/**
+  Fills a buffer with deterministic sample data.
+
+  @param[in]  Sample  The kind of data.
+  @param[out] Buffer  The buffer to fill.
+  @param[in]  Size    The size of Buffer in bytes.
+
+**/
+VOID
+CompressHostFillSample (
+  IN  COMPRESS_HOST_SAMPLE  Sample,
+  OUT UINT8                 *Buffer,
+  IN  UINTN                 Size
+  )
+{
+  UINT32       Seed;
+  UINTN        Index;
+  UINTN        Run;
+  CONST CHAR8  *Word;
+
+  Seed = 0x5EED0000 + (UINT32) Sample;
+
+  switch (Sample) {
+    case CompressHostSampleSparse:
+      //
+      // Short runs of noise every few hundred bytes
+      //
+      ZeroMem (Buffer, Size);
+      for (Index = 0; Index < Size; Index += 256 + CompressHostRandom (&Seed) % 512) {
+        for (Run = CompressHostRandom (&Seed) % 24; Run > 0 && Index < Size; Run--) {
+          Buffer[Index++] = (UINT8) CompressHostRandom (&Seed);
+        }
+      }
+
+      break;
+
+    case CompressHostSampleText:
+      Index = 0;
+      while (Index < Size) {
+        Word = mWords[CompressHostRandom (&Seed) % ARRAY_SIZE (mWords)];
+        while (*Word != '\0' && Index < Size) {
+          Buffer[Index++] = *Word++;
+        }
+
+        if (Index < Size) {
+          Buffer[Index++] = ((CompressHostRandom (&Seed) % 12) == 0) ? '\n' : ' ';
+        }
+      }
+
+      break;
+
+    case CompressHostSampleBinary:
+      //
+      // 16-byte records: an index, a type, an address and a few flag bits
+      //
+      for (Index = 0; Index < Size; Index++) {
+        switch (Index % 16) {
+          case 0:
+          case 1:
+            Buffer[Index] = (UINT8) ((Index / 16) >> ((Index % 16) * 8));
+            break;
+          case 2:
+            Buffer[Index] = (UINT8) (CompressHostRandom (&Seed) % 4);
+            break;
+          case 8:
+          case 9:
+          case 10:
+            Buffer[Index] = (UINT8) CompressHostRandom (&Seed);
+            break;
+          case 11:
+            Buffer[Index] = 0xFE;
+            break;
+          default:
+            Buffer[Index] = 0;
+            break;
+        }
+      }
+
+      break;
+
+    default:
+      for (Index = 0; Index < Size; Index++) {
+        Buffer[Index] = (UINT8) CompressHostRandom (&Seed);
+      }
+
+      break;
+  }
+}
+
+/**
+  Returns the largest size Compress() can produce for an input, which is a
+  safe size for its output buffer.
+
+  @param[in]  SrcSize  The size of the input in bytes.
+
+  @return The size of the output buffer.
+
+**/
+UINTN
+CompressHostBound (
+  IN UINTN  SrcSize
+  )
+{
+  //
+  // Literals take at most 9 bits plus the code tables of each block
+  //
+  return SrcSize + SrcSize / 4 + 1024;
+}
+
+/**
+  Compresses data at a given PcdCompressLibLevel.
+
+  @param[in]      Level      The level to compress at.
+  @param[in]      Src        The data to compress.
+  @param[in]      SrcSize    The size of Src in bytes.
+  @param[out]     Dst        The buffer to put the compressed data in.
+  @param[in, out] DstSize    On input the size of Dst, on output the size of
+                             the compressed data.
+
+  @return The status returned by Compress().
+
+**/
+EFI_STATUS
+CompressHostCompress (
+  IN     UINT8   Level,
+  IN     VOID    *Src,
+  IN     UINTN   SrcSize,
+  OUT    VOID    *Dst,
+  IN OUT UINTN   *DstSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Size;
+
+  PatchPcdSet8 (PcdCompressLibLevel, Level);
+
+  Size     = *DstSize;
+  Status   = Compress (Src, SrcSize, Dst, &Size);
+  *DstSize = (UINTN) Size;
+
+  return Status;
+}
+
+/**
+  Decompresses data with the standard EFI decompressor.
+
+  @param[in]      Src        The compressed data.
+  @param[in]      SrcSize    The size of Src in bytes.
+  @param[out]     Dst        The buffer to put the data in.
+  @param[in]      DstSize    The size of Dst in bytes.
+  @param[out]     OrigSize   The size of the decompressed data.
+
+  @retval EFI_SUCCESS            The data was decompressed.
+  @retval EFI_BUFFER_TOO_SMALL   Dst cannot hold the data.
+  @retval EFI_OUT_OF_RESOURCES   The scratch buffer could not be allocated.
+  @retval Others                 The data is not valid compressed data.
+
+**/
+EFI_STATUS
+CompressHostDecompress (
+  IN  VOID   *Src,
+  IN  UINTN  SrcSize,
+  OUT VOID   *Dst,
+  IN  UINTN  DstSize,
+  OUT UINTN  *OrigSize
+  )
+{
+  RETURN_STATUS  Status;
+  UINT32         DestinationSize;
+  UINT32         ScratchSize;
+  VOID           *Scratch;
+
+  Status = UefiDecompressGetInfo (Src, (UINT32) SrcSize, &DestinationSize, &ScratchSize);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  *OrigSize = DestinationSize;
+  if (DestinationSize > DstSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Scratch = AllocatePool (ScratchSize);
+  if (Scratch == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = UefiDecompress (Src, Dst, Scratch);
+  FreePool (Scratch);
+
+  return Status;
+}
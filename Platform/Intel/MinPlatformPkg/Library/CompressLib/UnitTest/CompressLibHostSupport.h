@@ -0,0 +1,115 @@
+/** @file
+  Sample data and round-trip helper shared by the CompressLib host unit test
+  and benchmark.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _COMPRESS_LIB_HOST_SUPPORT_H_
+#define _COMPRESS_LIB_HOST_SUPPORT_H_
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/CompressLib.h>
+#include <Library/UefiDecompressLib.h>
+
+//
+// Range of PcdCompressLibLevel
+//
+#define COMPRESS_HOST_MIN_LEVEL  1
+#define COMPRESS_HOST_MAX_LEVEL  9
+
+//
+// Kinds of generated sample data, from the most to the least compressible
+//
+typedef enum {
+  CompressHostSampleSparse,   // Mostly zeroes, like FSP NVS data
+  CompressHostSampleText,     // Words and punctuation, like a captured log
+  CompressHostSampleBinary,   // Fixed-size records with counters, like tables
+  CompressHostSampleRandom,   // Incompressible noise
+  CompressHostSampleMax
+} COMPRESS_HOST_SAMPLE;
+
+extern CONST CHAR8  *mCompressHostSampleName[CompressHostSampleMax];
+
+/**
+  Fills a buffer with deterministic sample data.
+
+  @param[in]  Sample  The kind of data.
+  @param[out] Buffer  The buffer to fill.
+  @param[in]  Size    The size of Buffer in bytes.
+
+**/
+VOID
+CompressHostFillSample (
+  IN  COMPRESS_HOST_SAMPLE  Sample,
+  OUT UINT8                 *Buffer,
+  IN  UINTN                 Size
+  );
+
+/**
+  Returns the largest size Compress() can produce for an input, which is a
+  safe size for its output buffer.
+
+  @param[in]  SrcSize  The size of the input in bytes.
+
+  @return The size of the output buffer.
+
+**/
+UINTN
+CompressHostBound (
+  IN UINTN  SrcSize
+  );
+
+/**
+  Compresses data at a given PcdCompressLibLevel.
+
+  @param[in]      Level      The level to compress at.
+  @param[in]      Src        The data to compress.
+  @param[in]      SrcSize    The size of Src in bytes.
+  @param[out]     Dst        The buffer to put the compressed data in.
+  @param[in, out] DstSize    On input the size of Dst, on output the size of
+                             the compressed data.
+
+  @return The status returned by Compress().
+
+**/
+EFI_STATUS
+CompressHostCompress (
+  IN     UINT8   Level,
+  IN     VOID    *Src,
+  IN     UINTN   SrcSize,
+  OUT    VOID    *Dst,
+  IN OUT UINTN   *DstSize
+  );
+
+/**
+  Decompresses data with the standard EFI decompressor.
+
+  @param[in]      Src        The compressed data.
+  @param[in]      SrcSize    The size of Src in bytes.
+  @param[out]     Dst        The buffer to put the data in.
+  @param[in]      DstSize    The size of Dst in bytes.
+  @param[out]     OrigSize   The size of the decompressed data.
+
+  @retval EFI_SUCCESS            The data was decompressed.
+  @retval EFI_BUFFER_TOO_SMALL   Dst cannot hold the data.
+  @retval EFI_OUT_OF_RESOURCES   The scratch buffer could not be allocated.
+  @retval Others                 The data is not valid compressed data.
+
+**/
+EFI_STATUS
+CompressHostDecompress (
+  IN  VOID   *Src,
+  IN  UINTN  SrcSize,
+  OUT VOID   *Dst,
+  IN  UINTN  DstSize,
+  OUT UINTN  *OrigSize
+  );
+
+#endif
@@ -0,0 +1,346 @@
+/** @file
+  Host based unit tests for CompressLib.
+
+  Everything Compress() produces, at every PcdCompressLibLevel, is decoded
+  with the standard EFI decompressor from MdePkg and compared with the input.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/UnitTestLib.h>
+#include <Library/DebugLib.h>
+
+#include "CompressLibHostSupport.h"
+
+#define UNIT_TEST_NAME     "CompressLib Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Input sizes around the edges of the window (8 KB), of a Huffman block
+// (16 KB) and of the longest match (256 bytes)
+//
+STATIC CONST UINTN  mSizes[] = {
+  0, 1, 2, 3, 4, 255, 256, 257, 8191, 8192, 8193, 16383, 16384, 16385, 50001
+};
+
+#define COMPRESS_TEST_MAX_SIZE  200000
+
+STATIC UINT8  mSource[COMPRESS_TEST_MAX_SIZE];
+STATIC UINT8  mDecoded[COMPRESS_TEST_MAX_SIZE];
+
+/**
+  Compresses a buffer, decompresses the result and compares it with the
+  input.
+
+  @param[in]  Level       The level to compress at.
+  @param[in]  Source      The data.
+  @param[in]  SourceSize  The size of Source in bytes.
+  @param[out] Compressed  The size of the compressed data. Optional.
+
+  @return Result of the check.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+CompressTestRoundTrip (
+  IN  UINT8  Level,
+  IN  UINT8  *Source,
+  IN  UINTN  SourceSize,
+  OUT UINTN  *Compressed OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Buffer;
+  UINTN       BufferSize;
+  UINTN       DecodedSize;
+
+  //
+  // Allocate exactly what is needed, so ASan catches an overrun
+  //
+  BufferSize = CompressHostBound (SourceSize);
+  Buffer     = AllocatePool (BufferSize);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = CompressHostCompress (Level, Source, SourceSize, Buffer, &BufferSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = CompressHostDecompress (Buffer, BufferSize, mDecoded, sizeof (mDecoded), &DecodedSize);
+  FreePool (Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (DecodedSize, SourceSize);
+  UT_ASSERT_MEM_EQUAL (mDecoded, Source, SourceSize);
+
+  if (Compressed != NULL) {
+    *Compressed = BufferSize;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Round-trips every kind of sample data, at every size and level.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CompressTestRoundTripAll (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS  Result;
+  UINTN             Sample;
+  UINTN             Size;
+  UINT8             Level;
+
+  for (Sample = 0; Sample < CompressHostSampleMax; Sample++) {
+    CompressHostFillSample ((COMPRESS_HOST_SAMPLE) Sample, mSource, sizeof (mSource));
+
+    for (Size = 0; Size < ARRAY_SIZE (mSizes); Size++) {
+      for (Level = COMPRESS_HOST_MIN_LEVEL; Level <= COMPRESS_HOST_MAX_LEVEL; Level++) {
+        Result = CompressTestRoundTrip (Level, mSource, mSizes[Size], NULL);
+        if (Result != UNIT_TEST_PASSED) {
+          UT_LOG_ERROR (
+            "%a data, %d bytes, level %d\n",
+            mCompressHostSampleName[Sample],
+            (UINT32) mSizes[Size],
+            Level
+            );
+          return Result;
+        }
+      }
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Round-trips matches at the longest distances and lengths the format allows,
+  and runs far longer than the longest match.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CompressTestLongMatches (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS  Result;
+  UINTN             Distance;
+  UINTN             Size;
+  UINT8             Level;
+  UINTN             Compressed;
+
+  for (Distance = 8190; Distance <= 8194; Distance++) {
+    //
+    // Noise followed by a copy of itself at Distance, then a long run
+    //
+    CompressHostFillSample (CompressHostSampleRandom, mSource, Distance);
+    CopyMem (&mSource[Distance], mSource, Distance);
+    Size = Distance * 2;
+    SetMem (&mSource[Size], 3000, 0x5A);
+    Size += 3000;
+
+    for (Level = COMPRESS_HOST_MIN_LEVEL; Level <= COMPRESS_HOST_MAX_LEVEL; Level++) {
+      Result = CompressTestRoundTrip (Level, mSource, Size, &Compressed);
+      if (Result != UNIT_TEST_PASSED) {
+        UT_LOG_ERROR ("Distance %d, level %d\n", (UINT32) Distance, Level);
+        return Result;
+      }
+
+      //
+      // Within the window the copy must be found at every level
+      //
+      if (Distance < 8192) {
+        UT_ASSERT_TRUE (Compressed < Distance + Distance / 4);
+      }
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Checks that compressible data gets smaller, and that higher levels do not
+  lose much ratio against lower ones.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CompressTestRatio (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS  Result;
+  UINTN             Sample;
+  UINTN             Fastest;
+  UINTN             Best;
+
+  for (Sample = 0; Sample < CompressHostSampleRandom; Sample++) {
+    CompressHostFillSample ((COMPRESS_HOST_SAMPLE) Sample, mSource, sizeof (mSource));
+
+    Result = CompressTestRoundTrip (COMPRESS_HOST_MIN_LEVEL, mSource, sizeof (mSource), &Fastest);
+    if (Result != UNIT_TEST_PASSED) {
+      return Result;
+    }
+
+    Result = CompressTestRoundTrip (COMPRESS_HOST_MAX_LEVEL, mSource, sizeof (mSource), &Best);
+    if (Result != UNIT_TEST_PASSED) {
+      return Result;
+    }
+
+    UT_LOG_INFO (
+      "%a: level 1 %d bytes, level 9 %d bytes\n",
+      mCompressHostSampleName[Sample],
+      (UINT32) Fastest,
+      (UINT32) Best
+      );
+    UT_ASSERT_TRUE (Fastest < sizeof (mSource) / 2);
+    UT_ASSERT_TRUE (Best <= Fastest + Fastest / 100);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Checks that a too small output buffer is reported with the size needed,
+  without writing past its end, and that the same input then compresses to
+  the same bytes. Compress() keeps no state between calls, so the output only
+  depends on the input.
+
+  @param[in]  Context  Unused.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CompressTestBufferTooSmall (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Expected;
+  UINT8       *Buffer;
+  UINTN       ExpectedSize;
+  UINTN       BufferSize;
+  UINTN       Size;
+
+  CompressHostFillSample (CompressHostSampleText, mSource, 20000);
+
+  ExpectedSize = CompressHostBound (20000);
+  Expected     = AllocatePool (ExpectedSize);
+  UT_ASSERT_NOT_NULL (Expected);
+  Status = CompressHostCompress (6, mSource, 20000, Expected, &ExpectedSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Size = 0; Size < ExpectedSize; Size += (Size < 16) ? 1 : 397) {
+    //
+    // Compress other data in between, which must not change the result
+    //
+    CompressHostFillSample (CompressHostSampleBinary, mDecoded, 30000);
+    BufferSize = CompressHostBound (30000);
+    Buffer     = AllocatePool (BufferSize);
+    UT_ASSERT_NOT_NULL (Buffer);
+    Status = CompressHostCompress (9, mDecoded, 30000, Buffer, &BufferSize);
+    FreePool (Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    BufferSize = Size;
+    Buffer     = AllocatePool (MAX (Size, 1));
+    UT_ASSERT_NOT_NULL (Buffer);
+    Status = CompressHostCompress (6, mSource, 20000, Buffer, &BufferSize);
+    FreePool (Buffer);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+    UT_ASSERT_EQUAL (BufferSize, ExpectedSize);
+  }
+
+  BufferSize = ExpectedSize;
+  Buffer     = AllocatePool (BufferSize);
+  UT_ASSERT_NOT_NULL (Buffer);
+  Status = CompressHostCompress (6, mSource, 20000, Buffer, &BufferSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (BufferSize, ExpectedSize);
+  UT_ASSERT_MEM_EQUAL (Buffer, Expected, ExpectedSize);
+
+  FreePool (Buffer);
+  FreePool (Expected);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sets up and runs the unit tests.
+
+  @return Result of the operation.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Compress", "MinPlatformPkg.CompressLib", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Round trip at every level", "RoundTrip", CompressTestRoundTripAll, NULL, NULL, NULL);
+  AddTestCase (Suite, "Matches at the window edge", "LongMatches", CompressTestLongMatches, NULL, NULL, NULL);
+  AddTestCase (Suite, "Compression ratio", "Ratio", CompressTestRatio, NULL, NULL, NULL);
+  AddTestCase (Suite, "Output buffer too small", "BufferTooSmall", CompressTestBufferTooSmall, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
@@ -14,6 +14,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/HobLib.h>
 #include <Library/PcdLib.h>
 #include <Ppi/MemoryDiscovered.h>
+#include <Guid/HobVariableIndex.h>
 #include "Variable.h"
 #include "Fce.h"
 
@@ -406,6 +407,152 @@ EFI_PEI_NOTIFY_DESCRIPTOR mMemoryNotifyList = {
   BuildDefaultDataHobForRecoveryVariable 
 };
 
+/**
+  Hashes a variable name and vendor GUID for the variable index.
+
+  @param[in]  VariableName      Pointer to the variable name.
+  @param[in]  NameSize          Size of the variable name in bytes, 0 if VariableName is
+                                Null-terminated and the size should be determined.
+  @param[in]  VendorGuid        A unique identifier for the vendor.
+  @param[out] NameSizeOut       If not NULL, returns the size of the name in bytes, including
+                                the Null terminator.
+
+  @return The hash of the name and GUID.
+
+**/
+STATIC
+UINT32
+HashVariable (
+  IN  CHAR16                    *VariableName,
+  IN  UINTN                     NameSize,
+  IN  EFI_GUID                  *VendorGuid,
+  OUT UINTN                     *NameSizeOut OPTIONAL
+  )
+{
+  UINT32  Hash;
+  UINT8   *Byte;
+  UINTN   Index;
+  UINTN   Count;
+
+  //
+  // 32-bit FNV-1a. The name is hashed up to and including its Null
+  // terminator, so that a Null-terminated lookup name and the stored
+  // name hash the same.
+  //
+  Hash = 0x811C9DC5;
+  Count = NameSize / sizeof (CHAR16);
+  for (Index = 0; (NameSize == 0) || (Index < Count); Index++) {
+    Hash = (Hash ^ (VariableName[Index] & 0xFF)) * 0x01000193;
+    Hash = (Hash ^ (VariableName[Index] >> 8)) * 0x01000193;
+    if (VariableName[Index] == L'\0') {
+      Index++;
+      break;
+    }
+  }
+  if (NameSizeOut != NULL) {
+    *NameSizeOut = Index * sizeof (CHAR16);
+  }
+
+  Byte = (UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Byte[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Builds the HOB that indexes the variables of the default variable HOB, so
+  that FindVariableFromHob() can find them without walking the store.
+
+  The index has to be rebuilt if variables are added to or removed from the
+  store, changing variable data in place keeps it valid.
+
+  @param[in]  VariableStoreHeader  Pointer to the variable store in the default variable HOB.
+
+  @retval EFI_SUCCESS           The index HOB was created.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to create HOB.
+
+**/
+EFI_STATUS
+BuildVariableIndexHob (
+  IN VARIABLE_STORE_HEADER      *VariableStoreHeader
+  )
+{
+  HOB_VARIABLE_INDEX            *VariableIndex;
+  HOB_VARIABLE_INDEX_ENTRY      *Entry;
+  AUTHENTICATED_VARIABLE_HEADER *StartPtr;
+  AUTHENTICATED_VARIABLE_HEADER *EndPtr;
+  AUTHENTICATED_VARIABLE_HEADER *CurrPtr;
+  BOOLEAN                       AuthFlag;
+  UINT32                        VariableCount;
+  UINT32                        EntryCount;
+  UINT32                        Hash;
+  UINT32                        Slot;
+
+  AuthFlag = CompareGuid (&VariableStoreHeader->Signature, &gEfiAuthenticatedVariableGuid);
+  StartPtr = GetStartPointer (VariableStoreHeader);
+  EndPtr   = GetEndPointer (VariableStoreHeader);
+
+  VariableCount = 0;
+  for ( CurrPtr = StartPtr
+      ; (CurrPtr < EndPtr) && IsValidVariableHeader (CurrPtr)
+      ; CurrPtr = GetNextVariablePtr (CurrPtr, AuthFlag)
+      ) {
+    if ((CurrPtr->State == VAR_ADDED) && (NameSizeOfVariable (CurrPtr, AuthFlag) != 0)) {
+      VariableCount++;
+    }
+  }
+
+  //
+  // Keep the table at most 3/4 full so that probe sequences stay short.
+  //
+  EntryCount = 8;
+  while (EntryCount < VariableCount + VariableCount / 3 + 1) {
+    EntryCount <<= 1;
+  }
+
+  VariableIndex = BuildGuidHob (
+                    &gHobVariableIndexHobGuid,
+                    sizeof (HOB_VARIABLE_INDEX) + EntryCount * sizeof (HOB_VARIABLE_INDEX_ENTRY)
+                    );
+  if (VariableIndex == NULL) {
+    DEBUG ((DEBUG_WARN, "HobVariableLib: No room for the variable index, lookups walk the store\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (VariableIndex, sizeof (HOB_VARIABLE_INDEX) + EntryCount * sizeof (HOB_VARIABLE_INDEX_ENTRY));
+  CopyGuid (&VariableIndex->StoreSignature, &VariableStoreHeader->Signature);
+  VariableIndex->StoreSize     = VariableStoreHeader->Size;
+  VariableIndex->EntryCount    = EntryCount;
+  VariableIndex->VariableCount = VariableCount;
+  Entry = (HOB_VARIABLE_INDEX_ENTRY *) (VariableIndex + 1);
+
+  //
+  // Variables are inserted in store order, so that a lookup finds the same
+  // variable as a walk of the store if a name is present more than once.
+  //
+  for ( CurrPtr = StartPtr
+      ; (CurrPtr < EndPtr) && IsValidVariableHeader (CurrPtr)
+      ; CurrPtr = GetNextVariablePtr (CurrPtr, AuthFlag)
+      ) {
+    if ((CurrPtr->State == VAR_ADDED) && (NameSizeOfVariable (CurrPtr, AuthFlag) != 0)) {
+      Hash = HashVariable (
+               GetVariableNamePtr (CurrPtr, AuthFlag),
+               NameSizeOfVariable (CurrPtr, AuthFlag),
+               GetVendorGuidPtr (CurrPtr, AuthFlag),
+               NULL
+               );
+      for (Slot = Hash & (EntryCount - 1); Entry[Slot].Offset != 0; Slot = (Slot + 1) & (EntryCount - 1)) {
+      }
+      Entry[Slot].Hash   = Hash;
+      Entry[Slot].Offset = (UINT32) ((UINTN) CurrPtr - (UINTN) VariableStoreHeader);
+    }
+  }
+
+  DEBUG ((DEBUG_INFO, "HobVariableLib: Indexed %d variables in %d slots\n", VariableCount, EntryCount));
+  return EFI_SUCCESS;
+}
+
 /**
   Find variable from default variable HOB.
 
@@ -430,6 +577,11 @@ FindVariableFromHob (
   AUTHENTICATED_VARIABLE_HEADER *EndPtr;
   AUTHENTICATED_VARIABLE_HEADER *CurrPtr;
   VOID                          *Point;
+  HOB_VARIABLE_INDEX            *VariableIndex;
+  HOB_VARIABLE_INDEX_ENTRY      *Entry;
+  UINTN                         NameSize;
+  UINT32                        Hash;
+  UINT32                        Slot;
 
   VariableStoreHeader = NULL;
 
@@ -449,6 +601,40 @@ FindVariableFromHob (
     return NULL;
   }
 
+  //
+  // Use the index when it was built for this store, it finds the variable
+  // without walking the store.
+  //
+  GuidHob = GetFirstGuidHob (&gHobVariableIndexHobGuid);
+  if (GuidHob != NULL) {
+    VariableIndex = (HOB_VARIABLE_INDEX *) GET_GUID_HOB_DATA (GuidHob);
+    if (CompareGuid (&VariableIndex->StoreSignature, &VariableStoreHeader->Signature) &&
+        (VariableIndex->StoreSize == VariableStoreHeader->Size)) {
+      VariableIndex->LookupCount++;
+      Entry = (HOB_VARIABLE_INDEX_ENTRY *) (VariableIndex + 1);
+      Hash  = HashVariable (VariableName, 0, VendorGuid, &NameSize);
+      for ( Slot = Hash & (VariableIndex->EntryCount - 1)
+          ; Entry[Slot].Offset != 0
+          ; Slot = (Slot + 1) & (VariableIndex->EntryCount - 1)
+          ) {
+        VariableIndex->ProbeCount++;
+        if (Entry[Slot].Hash != Hash) {
+          continue;
+        }
+        CurrPtr = (AUTHENTICATED_VARIABLE_HEADER *) ((UINTN) VariableStoreHeader + Entry[Slot].Offset);
+        if ((CurrPtr->State == VAR_ADDED) &&
+            (NameSizeOfVariable (CurrPtr, *AuthFlag) == NameSize) &&
+            CompareGuid (VendorGuid, GetVendorGuidPtr (CurrPtr, *AuthFlag)) &&
+            (CompareMem (VariableName, GetVariableNamePtr (CurrPtr, *AuthFlag), NameSize) == 0)) {
+          return CurrPtr;
+        }
+      }
+      VariableIndex->MissCount++;
+      return NULL;
+    }
+    VariableIndex->LinearScanCount++;
+  }
+
   StartPtr = GetStartPointer (VariableStoreHeader);
   EndPtr   = GetEndPointer (VariableStoreHeader);
   for ( CurrPtr = StartPtr
@@ -316,6 +316,21 @@ static EFI_PEI_NOTIFY_DESCRIPTOR mMemoryNotifyList = {
   BuildDefaultDataHobForRecoveryVariable
 };
 
+/**
+  Builds the HOB that indexes the variables of the default variable HOB, so
+  that FindVariableFromHob() can find them without walking the store.
+
+  @param[in]  VariableStoreHeader  Pointer to the variable store in the default variable HOB.
+
+  @retval EFI_SUCCESS           The index HOB was created.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to create HOB.
+
+**/
+EFI_STATUS
+BuildVariableIndexHob (
+  IN VARIABLE_STORE_HEADER      *VariableStoreHeader
+  );
+
 /**
   This function finds the matched default data and create GUID hob for it. 
   
@@ -445,6 +460,12 @@ CreateDefaultVariableHob (
   //
   VarStoreHeaderHob->Size = VarStoreHeader->Size - VarDataOffset + VarHobDataOffset;
 
+  //
+  // Index the variables, GetVariableFromHob() is called many times in PEI.
+  // The index is optional, lookups walk the store without it.
+  //
+  BuildVariableIndexHob (VarStoreHeaderHob);
+
   //
   // On recovery boot mode, emulation variable driver will be used.
   // But, Emulation variable only knows normal variable data format. 
@@ -17,6 +17,21 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 extern EFI_PEI_NOTIFY_DESCRIPTOR mMemoryNotifyList;
 
+/**
+  Builds the HOB that indexes the variables of the default variable HOB, so
+  that FindVariableFromHob() can find them without walking the store.
+
+  @param[in]  VariableStoreHeader  Pointer to the variable store in the default variable HOB.
+
+  @retval EFI_SUCCESS           The index HOB was created.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to create HOB.
+
+**/
+EFI_STATUS
+BuildVariableIndexHob (
+  IN VARIABLE_STORE_HEADER      *VariableStoreHeader
+  );
+
 /**
   This function finds the matched default data and create GUID hob for it. 
   
@@ -184,6 +199,12 @@ CreateDefaultVariableHob (
     return EFI_NOT_FOUND;
   }
 
+  //
+  // Index the variables, GetVariableFromHob() is called many times in PEI.
+  // The index is optional, lookups walk the store without it.
+  //
+  BuildVariableIndexHob (VarStoreHeaderHob);
+
   //
   // On recovery boot mode, emulation variable driver will be used.
   // But, Emulation variable only knows normal variable data format. 
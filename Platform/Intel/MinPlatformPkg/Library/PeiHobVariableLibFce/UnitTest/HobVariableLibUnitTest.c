@@ -0,0 +1,760 @@
+/** @file
+  Host based unit tests for the variable index of PeiHobVariableLibFce.
+
+  A default variable store is built in a HOB, with deleted, partially added
+  and duplicate variables, in both the normal and the authenticated format.
+  Every lookup is checked against what the store holds, first with the walk
+  of the store, then with the index, then with an index that does not match
+  the store.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/UnitTestLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/HobVariableLib.h>
+#include <Guid/HobVariableIndex.h>
+
+#include "HostHob.h"
+#include "../Variable.h"
+
+#define UNIT_TEST_NAME     "HobVariableLib Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Number of variable names in the store, and the size of the store
+//
+#define HOB_VARIABLE_TEST_COUNT       400
+#define HOB_VARIABLE_TEST_STORE_SIZE  0xF000
+
+//
+// Largest variable data
+//
+#define HOB_VARIABLE_TEST_MAX_DATA    16
+
+//
+// Copies of a variable in the store. The data and attributes of each copy
+// differ, so a lookup shows which one it found.
+//
+#define HOB_VARIABLE_TEST_ORIGINAL    0
+#define HOB_VARIABLE_TEST_EXTRA       1
+#define HOB_VARIABLE_TEST_UPDATED     2
+
+//
+// Misses looked up for each variable: another GUID, another case and a
+// shorter name
+//
+#define HOB_VARIABLE_TEST_MISSES      3
+
+STATIC BOOLEAN   mAuthenticated = TRUE;
+STATIC BOOLEAN   mNormal        = FALSE;
+STATIC EFI_GUID  mTestVendorGuid = { 0x6a1d2e57, 0x93c4, 0x4b80, { 0xa3, 0x1f, 0x5e, 0x77, 0x0c, 0xd2, 0x48, 0x9b } };
+
+/**
+  Builds the variable index HOB. Implemented by PeiHobVariableLibFce.
+
+  @param[in]  VariableStoreHeader  Pointer to the variable store in the default variable HOB.
+
+  @retval EFI_SUCCESS           The index HOB was created.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to create HOB.
+
+**/
+EFI_STATUS
+BuildVariableIndexHob (
+  IN VARIABLE_STORE_HEADER      *VariableStoreHeader
+  );
+
+/**
+  The default data FV is not available on the host, the tests build the
+  default variable HOB themselves.
+
+  @param[in] StoreId            Default store ID.
+  @param[in] SkuId              SKU ID.
+
+  @retval EFI_NOT_FOUND         The matched default data is not found.
+
+**/
+EFI_STATUS
+EFIAPI
+CreateDefaultVariableHob (
+  IN UINT16  StoreId,
+  IN UINT16  SkuId
+  )
+{
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Tells whether the first copy of a test variable is deleted, a later copy
+  holds its value.
+
+  @param[in]  Index  The number of the variable.
+
+  @return TRUE if the first copy is deleted.
+
+**/
+STATIC
+BOOLEAN
+HobVarTestIsDeleted (
+  IN UINTN  Index
+  )
+{
+  return (Index % 50) == 7;
+}
+
+/**
+  Tells whether a test variable is added twice, the first copy holds its
+  value.
+
+  @param[in]  Index  The number of the variable.
+
+  @return TRUE if the variable is added twice.
+
+**/
+STATIC
+BOOLEAN
+HobVarTestIsDuplicate (
+  IN UINTN  Index
+  )
+{
+  return (Index % 97) == 5;
+}
+
+/**
+  Tells whether a test variable is preceded by a copy that was never
+  completely added.
+
+  @param[in]  Index  The number of the variable.
+
+  @return TRUE if the variable has a partially added copy.
+
+**/
+STATIC
+BOOLEAN
+HobVarTestIsPartial (
+  IN UINTN  Index
+  )
+{
+  return (Index % 61) == 11;
+}
+
+/**
+  Returns the name of a test variable.
+
+  @param[in]   Index  The number of the variable.
+  @param[in]   Format The format of the name, with a %d for Index.
+  @param[out]  Name   The buffer to return the name in, 32 characters.
+
+**/
+STATIC
+VOID
+HobVarTestName (
+  IN  UINTN         Index,
+  IN  CONST CHAR16  *Format,
+  OUT CHAR16        *Name
+  )
+{
+  //
+  // The walk of the store compares as many bytes as the stored name has, so
+  // the rest of the buffer must be valid.
+  //
+  ZeroMem (Name, 32 * sizeof (CHAR16));
+  UnicodeSPrint (Name, 32 * sizeof (CHAR16), Format, (UINT32) Index);
+}
+
+/**
+  Returns the vendor GUID of a test variable. Variables share the GUID in
+  groups, so that the name has to be compared as well.
+
+  @param[in]   Index  The number of the variable.
+  @param[out]  Guid   The GUID.
+
+**/
+STATIC
+VOID
+HobVarTestGuid (
+  IN  UINTN     Index,
+  OUT EFI_GUID  *Guid
+  )
+{
+  CopyGuid (Guid, &mTestVendorGuid);
+  Guid->Data1 += (UINT32) (Index % 7);
+}
+
+/**
+  Returns the size of the data of a test variable.
+
+  @param[in]  Index  The number of the variable.
+
+  @return The size in bytes.
+
+**/
+STATIC
+UINTN
+HobVarTestDataSize (
+  IN UINTN  Index
+  )
+{
+  return 4 + Index % (HOB_VARIABLE_TEST_MAX_DATA - 3);
+}
+
+/**
+  Fills a buffer with the data of one copy of a test variable.
+
+  @param[in]   Index  The number of the variable.
+  @param[in]   Copy   The copy of the variable.
+  @param[out]  Data   The buffer, HobVarTestDataSize() bytes.
+
+**/
+STATIC
+VOID
+HobVarTestData (
+  IN  UINTN  Index,
+  IN  UINTN  Copy,
+  OUT UINT8  *Data
+  )
+{
+  UINTN  Offset;
+
+  for (Offset = 0; Offset < HobVarTestDataSize (Index); Offset++) {
+    Data[Offset] = (UINT8) (Index * 3 + Offset + Copy * 0x40);
+  }
+}
+
+/**
+  Returns the attributes of one copy of a test variable.
+
+  @param[in]  Copy   The copy of the variable.
+
+  @return The attributes.
+
+**/
+STATIC
+UINT32
+HobVarTestAttributes (
+  IN UINTN  Copy
+  )
+{
+  return (Copy == HOB_VARIABLE_TEST_ORIGINAL) ?
+         (EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS) :
+         (EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS);
+}
+
+/**
+  Appends one copy of a test variable to the store.
+
+  @param[in]      Authenticated  TRUE if the store holds authenticated variables.
+  @param[in, out] Next           Where to add the variable, on output where to add the next one.
+  @param[in]      Index          The number of the variable.
+  @param[in]      Copy           The copy of the variable.
+  @param[in]      State          The state of the variable.
+
+**/
+STATIC
+VOID
+HobVarTestAddVariable (
+  IN     BOOLEAN  Authenticated,
+  IN OUT UINT8    **Next,
+  IN     UINTN    Index,
+  IN     UINTN    Copy,
+  IN     UINT8    State
+  )
+{
+  AUTHENTICATED_VARIABLE_HEADER  *AuthVariable;
+  VARIABLE_HEADER                *Variable;
+  CHAR16                         Name[32];
+  UINTN                          NameSize;
+  UINT8                          *Ptr;
+
+  HobVarTestName (Index, L"Setup%dVar", Name);
+  NameSize = StrSize (Name);
+
+  Ptr = *Next;
+  if (Authenticated) {
+    AuthVariable = (AUTHENTICATED_VARIABLE_HEADER *) Ptr;
+    ZeroMem (AuthVariable, sizeof (*AuthVariable));
+    AuthVariable->StartId    = VARIABLE_DATA;
+    AuthVariable->State      = State;
+    AuthVariable->Attributes = HobVarTestAttributes (Copy);
+    AuthVariable->NameSize   = (UINT32) NameSize;
+    AuthVariable->DataSize   = (UINT32) HobVarTestDataSize (Index);
+    HobVarTestGuid (Index, &AuthVariable->VendorGuid);
+    Ptr += sizeof (*AuthVariable);
+  } else {
+    Variable = (VARIABLE_HEADER *) Ptr;
+    ZeroMem (Variable, sizeof (*Variable));
+    Variable->StartId    = VARIABLE_DATA;
+    Variable->State      = State;
+    Variable->Attributes = HobVarTestAttributes (Copy);
+    Variable->NameSize   = (UINT32) NameSize;
+    Variable->DataSize   = (UINT32) HobVarTestDataSize (Index);
+    HobVarTestGuid (Index, &Variable->VendorGuid);
+    Ptr += sizeof (*Variable);
+  }
+
+  CopyMem (Ptr, Name, NameSize);
+  Ptr += NameSize + GET_PAD_SIZE (NameSize);
+  HobVarTestData (Index, Copy, Ptr);
+  Ptr += HobVarTestDataSize (Index);
+
+  *Next = (UINT8 *) HEADER_ALIGN (Ptr);
+}
+
+/**
+  Builds the default variable HOB.
+
+  @param[in]  Authenticated  TRUE to build an authenticated variable store.
+  @param[in]  Count          The number of variable names in the store.
+
+  @return The variable store, NULL if the HOB could not be built.
+
+**/
+STATIC
+VARIABLE_STORE_HEADER *
+HobVarTestBuildStore (
+  IN BOOLEAN  Authenticated,
+  IN UINTN    Count
+  )
+{
+  VARIABLE_STORE_HEADER  *Store;
+  UINT8                  *Next;
+  UINTN                  Index;
+
+  Store = BuildGuidHob (
+            Authenticated ? &gEfiAuthenticatedVariableGuid : &gEfiVariableGuid,
+            HOB_VARIABLE_TEST_STORE_SIZE
+            );
+  if (Store == NULL) {
+    return NULL;
+  }
+
+  SetMem (Store, HOB_VARIABLE_TEST_STORE_SIZE, 0xFF);
+  CopyGuid (&Store->Signature, Authenticated ? &gEfiAuthenticatedVariableGuid : &gEfiVariableGuid);
+  Store->Size      = HOB_VARIABLE_TEST_STORE_SIZE;
+  Store->Format    = VARIABLE_STORE_FORMATTED;
+  Store->State     = VARIABLE_STORE_HEALTHY;
+  Store->Reserved  = 0;
+  Store->Reserved1 = 0;
+
+  Next = (UINT8 *) HEADER_ALIGN (Store + 1);
+  for (Index = 0; Index < Count; Index++) {
+    if (HobVarTestIsPartial (Index)) {
+      HobVarTestAddVariable (Authenticated, &Next, Index, HOB_VARIABLE_TEST_EXTRA, VAR_HEADER_VALID_ONLY);
+    }
+    HobVarTestAddVariable (
+      Authenticated,
+      &Next,
+      Index,
+      HOB_VARIABLE_TEST_ORIGINAL,
+      HobVarTestIsDeleted (Index) ? (VAR_ADDED & VAR_DELETED) : VAR_ADDED
+      );
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    if (HobVarTestIsDeleted (Index) || HobVarTestIsDuplicate (Index)) {
+      HobVarTestAddVariable (Authenticated, &Next, Index, HOB_VARIABLE_TEST_EXTRA, VAR_ADDED);
+    }
+  }
+
+  ASSERT ((UINTN) (Next - (UINT8 *) Store) < HOB_VARIABLE_TEST_STORE_SIZE);
+  return Store;
+}
+
+/**
+  Returns the number of variables the index of a store built by
+  HobVarTestBuildStore() should hold.
+
+  @param[in]  Count  The number of variable names in the store.
+
+  @return The number of added variables.
+
+**/
+STATIC
+UINT32
+HobVarTestAddedCount (
+  IN UINTN  Count
+  )
+{
+  UINTN   Index;
+  UINT32  Added;
+
+  Added = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Added += HobVarTestIsDuplicate (Index) ? 2 : 1;
+  }
+
+  return Added;
+}
+
+/**
+  Returns the variable index HOB.
+
+  @return The index, NULL if there is none.
+
+**/
+STATIC
+HOB_VARIABLE_INDEX *
+HobVarTestGetIndex (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE  *GuidHob;
+
+  GuidHob = GetFirstGuidHob (&gHobVariableIndexHobGuid);
+  if (GuidHob == NULL) {
+    return NULL;
+  }
+
+  return GET_GUID_HOB_DATA (GuidHob);
+}
+
+/**
+  Looks up every variable of the store, and names that are not in it.
+
+  @param[in]  Count  The number of variable names in the store.
+  @param[in]  Copy   The copy of the variables that should be found.
+
+  @return Result of the check.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+HobVarTestCheckLookups (
+  IN UINTN  Count,
+  IN UINTN  Copy
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      Name[32];
+  EFI_GUID    Guid;
+  UINT8       Expected[HOB_VARIABLE_TEST_MAX_DATA];
+  UINT8       Data[HOB_VARIABLE_TEST_MAX_DATA];
+  UINTN       DataSize;
+  UINT32      Attributes;
+  UINTN       Index;
+  UINTN       ExpectedCopy;
+
+  for (Index = 0; Index < Count; Index++) {
+    ExpectedCopy = Copy;
+    if ((Copy == HOB_VARIABLE_TEST_ORIGINAL) && HobVarTestIsDeleted (Index)) {
+      ExpectedCopy = HOB_VARIABLE_TEST_EXTRA;
+    }
+    HobVarTestData (Index, ExpectedCopy, Expected);
+
+    HobVarTestName (Index, L"Setup%dVar", Name);
+    HobVarTestGuid (Index, &Guid);
+    DataSize = sizeof (Data);
+    Status = GetVariableFromHob (Name, &Guid, &Attributes, &DataSize, Data);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (DataSize, HobVarTestDataSize (Index));
+    UT_ASSERT_MEM_EQUAL (Data, Expected, DataSize);
+    if (ExpectedCopy != HOB_VARIABLE_TEST_UPDATED) {
+      UT_ASSERT_EQUAL (Attributes, HobVarTestAttributes (ExpectedCopy));
+    }
+
+    Guid.Data1 += 7;
+    DataSize = sizeof (Data);
+    Status = GetVariableFromHob (Name, &Guid, NULL, &DataSize, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+    HobVarTestGuid (Index, &Guid);
+    HobVarTestName (Index, L"Setup%dVaR", Name);
+    DataSize = sizeof (Data);
+    Status = GetVariableFromHob (Name, &Guid, NULL, &DataSize, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+    HobVarTestName (Index, L"Setup%dVa", Name);
+    DataSize = sizeof (Data);
+    Status = GetVariableFromHob (Name, &Guid, NULL, &DataSize, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Empties the HOB list after each test.
+
+  @param[in]  Context  Unused.
+
+**/
+STATIC
+VOID
+EFIAPI
+HobVarTestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  HostHobReset ();
+}
+
+/**
+  Lookups through the index find the same variables as the walk of the store.
+
+  @param[in]  Context  Points to TRUE for an authenticated variable store.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+HobVarTestIndexMatchesWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_STORE_HEADER  *Store;
+  HOB_VARIABLE_INDEX     *VariableIndex;
+
+  Store = HobVarTestBuildStore (*(BOOLEAN *) Context, HOB_VARIABLE_TEST_COUNT);
+  UT_ASSERT_NOT_NULL (Store);
+
+  //
+  // Without the index, the store is walked
+  //
+  UT_ASSERT_EQUAL (HobVarTestCheckLookups (HOB_VARIABLE_TEST_COUNT, HOB_VARIABLE_TEST_ORIGINAL), UNIT_TEST_PASSED);
+
+  UT_ASSERT_NOT_EFI_ERROR (BuildVariableIndexHob (Store));
+  VariableIndex = HobVarTestGetIndex ();
+  UT_ASSERT_NOT_NULL (VariableIndex);
+  UT_ASSERT_EQUAL (VariableIndex->VariableCount, HobVarTestAddedCount (HOB_VARIABLE_TEST_COUNT));
+  UT_ASSERT_EQUAL (VariableIndex->EntryCount & (VariableIndex->EntryCount - 1), 0);
+  UT_ASSERT_TRUE (VariableIndex->EntryCount * 3 >= VariableIndex->VariableCount * 4);
+
+  UT_ASSERT_EQUAL (HobVarTestCheckLookups (HOB_VARIABLE_TEST_COUNT, HOB_VARIABLE_TEST_ORIGINAL), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (VariableIndex->LookupCount, HOB_VARIABLE_TEST_COUNT * (1 + HOB_VARIABLE_TEST_MISSES));
+  UT_ASSERT_EQUAL (VariableIndex->MissCount, HOB_VARIABLE_TEST_COUNT * HOB_VARIABLE_TEST_MISSES);
+  UT_ASSERT_EQUAL (VariableIndex->LinearScanCount, 0);
+
+  //
+  // A table at most 3/4 full keeps probe sequences short
+  //
+  UT_LOG_INFO (
+    "%d variables in %d slots, %d probes for %d lookups\n",
+    VariableIndex->VariableCount,
+    VariableIndex->EntryCount,
+    VariableIndex->ProbeCount,
+    VariableIndex->LookupCount
+    );
+  UT_ASSERT_TRUE (VariableIndex->ProbeCount <= 2 * VariableIndex->LookupCount);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Data written through the index is read back, the index stays valid.
+
+  @param[in]  Context  Points to TRUE for an authenticated variable store.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+HobVarTestSetVariable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  VARIABLE_STORE_HEADER  *Store;
+  CHAR16                 Name[32];
+  EFI_GUID               Guid;
+  UINT8                  Data[HOB_VARIABLE_TEST_MAX_DATA];
+  UINTN                  DataSize;
+  UINTN                  Index;
+
+  Store = HobVarTestBuildStore (*(BOOLEAN *) Context, HOB_VARIABLE_TEST_COUNT);
+  UT_ASSERT_NOT_NULL (Store);
+  UT_ASSERT_NOT_EFI_ERROR (BuildVariableIndexHob (Store));
+
+  for (Index = 0; Index < HOB_VARIABLE_TEST_COUNT; Index++) {
+    HobVarTestName (Index, L"Setup%dVar", Name);
+    HobVarTestGuid (Index, &Guid);
+    HobVarTestData (Index, HOB_VARIABLE_TEST_UPDATED, Data);
+    Status = SetVariableToHob (Name, &Guid, NULL, HobVarTestDataSize (Index) + 1, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+    Status = SetVariableToHob (Name, &Guid, NULL, HobVarTestDataSize (Index), Data);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    DataSize = HobVarTestDataSize (Index) - 1;
+    Status = GetVariableFromHob (Name, &Guid, NULL, &DataSize, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+    UT_ASSERT_EQUAL (DataSize, HobVarTestDataSize (Index));
+
+    HobVarTestName (Index, L"Setup%dVaR", Name);
+    Status = SetVariableToHob (Name, &Guid, NULL, HobVarTestDataSize (Index), Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  }
+
+  UT_ASSERT_EQUAL (HobVarTestCheckLookups (HOB_VARIABLE_TEST_COUNT, HOB_VARIABLE_TEST_UPDATED), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (HobVarTestGetIndex ()->LinearScanCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  An index that does not match the store is not used, lookups walk the store.
+
+  @param[in]  Context  Points to TRUE for an authenticated variable store.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+HobVarTestStaleIndex (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_STORE_HEADER  *Store;
+  HOB_VARIABLE_INDEX     *VariableIndex;
+
+  Store = HobVarTestBuildStore (*(BOOLEAN *) Context, HOB_VARIABLE_TEST_COUNT);
+  UT_ASSERT_NOT_NULL (Store);
+  UT_ASSERT_NOT_EFI_ERROR (BuildVariableIndexHob (Store));
+  VariableIndex = HobVarTestGetIndex ();
+  UT_ASSERT_NOT_NULL (VariableIndex);
+
+  //
+  // Another store size
+  //
+  VariableIndex->StoreSize++;
+  UT_ASSERT_EQUAL (HobVarTestCheckLookups (HOB_VARIABLE_TEST_COUNT, HOB_VARIABLE_TEST_ORIGINAL), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (VariableIndex->LookupCount, 0);
+  UT_ASSERT_EQUAL (VariableIndex->LinearScanCount, HOB_VARIABLE_TEST_COUNT * (1 + HOB_VARIABLE_TEST_MISSES));
+  VariableIndex->StoreSize--;
+
+  //
+  // Another store format
+  //
+  CopyGuid (
+    &VariableIndex->StoreSignature,
+    *(BOOLEAN *) Context ? &gEfiVariableGuid : &gEfiAuthenticatedVariableGuid
+    );
+  UT_ASSERT_EQUAL (HobVarTestCheckLookups (HOB_VARIABLE_TEST_COUNT, HOB_VARIABLE_TEST_ORIGINAL), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (VariableIndex->LookupCount, 0);
+  UT_ASSERT_EQUAL (VariableIndex->LinearScanCount, 2 * HOB_VARIABLE_TEST_COUNT * (1 + HOB_VARIABLE_TEST_MISSES));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  An empty store gets an empty index, and every lookup misses.
+
+  @param[in]  Context  Points to TRUE for an authenticated variable store.
+
+  @return Result of the test.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+HobVarTestEmptyStore (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  VARIABLE_STORE_HEADER  *Store;
+  HOB_VARIABLE_INDEX     *VariableIndex;
+  CHAR16                 Name[32];
+  EFI_GUID               Guid;
+  UINT8                  Data[HOB_VARIABLE_TEST_MAX_DATA];
+  UINTN                  DataSize;
+
+  Store = HobVarTestBuildStore (*(BOOLEAN *) Context, 0);
+  UT_ASSERT_NOT_NULL (Store);
+  UT_ASSERT_NOT_EFI_ERROR (BuildVariableIndexHob (Store));
+  VariableIndex = HobVarTestGetIndex ();
+  UT_ASSERT_NOT_NULL (VariableIndex);
+  UT_ASSERT_EQUAL (VariableIndex->VariableCount, 0);
+
+  HobVarTestName (0, L"Setup%dVar", Name);
+  HobVarTestGuid (0, &Guid);
+  DataSize = sizeof (Data);
+  Status = GetVariableFromHob (Name, &Guid, NULL, &DataSize, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_EQUAL (VariableIndex->MissCount, 1);
+  UT_ASSERT_EQUAL (VariableIndex->ProbeCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sets up and runs the unit tests.
+
+  @return Result of the operation.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+  UINTN                       Format;
+  BOOLEAN                     *Authenticated;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  HostHobReset ();
+
+  for (Format = 0; Format < 2; Format++) {
+    Authenticated = (Format == 0) ? &mNormal : &mAuthenticated;
+    Status = CreateUnitTestSuite (
+               &Suite,
+               Framework,
+               *Authenticated ? "Authenticated variable store" : "Variable store",
+               *Authenticated ? "MinPlatformPkg.HobVariableLib.Authenticated" : "MinPlatformPkg.HobVariableLib.Normal",
+               NULL,
+               NULL
+               );
+    if (EFI_ERROR (Status)) {
+      goto EXIT;
+    }
+
+    AddTestCase (Suite, "Index finds what the walk finds", "IndexMatchesWalk", HobVarTestIndexMatchesWalk, NULL, HobVarTestCleanup, Authenticated);
+    AddTestCase (Suite, "Set through the index", "SetVariable", HobVarTestSetVariable, NULL, HobVarTestCleanup, Authenticated);
+    AddTestCase (Suite, "Index of another store", "StaleIndex", HobVarTestStaleIndex, NULL, HobVarTestCleanup, Authenticated);
+    AddTestCase (Suite, "Empty store", "EmptyStore", HobVarTestEmptyStore, NULL, HobVarTestCleanup, Authenticated);
+  }
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
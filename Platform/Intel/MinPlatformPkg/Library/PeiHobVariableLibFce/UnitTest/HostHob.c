@@ -0,0 +1,185 @@
+/** @file
+  HOB list for host based tests of PeiHobVariableLibFce.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "HostHob.h"
+
+//
+// UINT64 keeps the HOBs 8-byte aligned, as in PEI
+//
+STATIC UINT64  mHostHobList[HOST_HOB_LIST_SIZE / sizeof (UINT64)];
+
+/**
+  Empties the HOB list.
+
+**/
+VOID
+HostHobReset (
+  VOID
+  )
+{
+  EFI_HOB_GENERIC_HEADER  *Hob;
+
+  ZeroMem (mHostHobList, sizeof (mHostHobList));
+  Hob            = (EFI_HOB_GENERIC_HEADER *) mHostHobList;
+  Hob->HobType   = EFI_HOB_TYPE_END_OF_HOB_LIST;
+  Hob->HobLength = sizeof (EFI_HOB_GENERIC_HEADER);
+}
+
+/**
+  Returns the pointer to the HOB list.
+
+  @return The pointer to the HOB list.
+
+**/
+VOID *
+EFIAPI
+GetHobList (
+  VOID
+  )
+{
+  return mHostHobList;
+}
+
+/**
+  Returns the next instance of a HOB type from the starting HOB.
+
+  @param[in]  Type      The HOB type to return.
+  @param[in]  HobStart  The starting HOB pointer to search from.
+
+  @return The next instance of a HOB type from the starting HOB, or NULL.
+
+**/
+VOID *
+EFIAPI
+GetNextHob (
+  IN UINT16                 Type,
+  IN CONST VOID             *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  ASSERT (HobStart != NULL);
+
+  Hob.Raw = (UINT8 *) HobStart;
+  while (!END_OF_HOB_LIST (Hob)) {
+    if (Hob.Header->HobType == Type) {
+      return Hob.Raw;
+    }
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+  return NULL;
+}
+
+/**
+  Returns the first instance of a HOB type among the whole HOB list.
+
+  @param[in]  Type      The HOB type to return.
+
+  @return The first instance of a HOB type, or NULL.
+
+**/
+VOID *
+EFIAPI
+GetFirstHob (
+  IN UINT16                 Type
+  )
+{
+  return GetNextHob (Type, GetHobList ());
+}
+
+/**
+  Returns the next instance of the matched GUID HOB from the starting HOB.
+
+  @param[in]  Guid      The GUID to match with in the HOB list.
+  @param[in]  HobStart  A pointer to a Guid.
+
+  @return The next instance of the matched GUID HOB from the starting HOB, or NULL.
+
+**/
+VOID *
+EFIAPI
+GetNextGuidHob (
+  IN CONST EFI_GUID         *Guid,
+  IN CONST VOID             *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS  GuidHob;
+
+  GuidHob.Raw = (UINT8 *) HobStart;
+  while ((GuidHob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
+    if (CompareGuid (Guid, &GuidHob.Guid->Name)) {
+      break;
+    }
+    GuidHob.Raw = GET_NEXT_HOB (GuidHob);
+  }
+  return GuidHob.Raw;
+}
+
+/**
+  Returns the first instance of the matched GUID HOB among the whole HOB list.
+
+  @param[in]  Guid      The GUID to match with in the HOB list.
+
+  @return The first instance of the matched GUID HOB, or NULL.
+
+**/
+VOID *
+EFIAPI
+GetFirstGuidHob (
+  IN CONST EFI_GUID         *Guid
+  )
+{
+  return GetNextGuidHob (Guid, GetHobList ());
+}
+
+/**
+  Builds a GUID HOB with a certain data length.
+
+  @param[in]  Guid        The GUID to tag the customized HOB.
+  @param[in]  DataLength  The size of the data payload for the GUID HOB.
+
+  @return The start address of GUID HOB data, or NULL if the HOB list is full.
+
+**/
+VOID *
+EFIAPI
+BuildGuidHob (
+  IN CONST EFI_GUID              *Guid,
+  IN UINTN                       DataLength
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+  EFI_HOB_GUID_TYPE     *GuidHob;
+  UINTN                 HobLength;
+
+  ASSERT (DataLength <= (0xFFF8 - sizeof (EFI_HOB_GUID_TYPE)));
+
+  Hob.Raw = GetHobList ();
+  while (!END_OF_HOB_LIST (Hob)) {
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  HobLength = ALIGN_VALUE (sizeof (EFI_HOB_GUID_TYPE) + DataLength, 8);
+  if ((UINTN) (Hob.Raw - (UINT8 *) mHostHobList) + HobLength + sizeof (EFI_HOB_GENERIC_HEADER) > sizeof (mHostHobList)) {
+    return NULL;
+  }
+
+  GuidHob                   = Hob.Guid;
+  GuidHob->Header.HobType   = EFI_HOB_TYPE_GUID_EXTENSION;
+  GuidHob->Header.HobLength = (UINT16) HobLength;
+  CopyGuid (&GuidHob->Name, Guid);
+
+  Hob.Raw += HobLength;
+  Hob.Header->HobType   = EFI_HOB_TYPE_END_OF_HOB_LIST;
+  Hob.Header->HobLength = sizeof (EFI_HOB_GENERIC_HEADER);
+
+  return GuidHob + 1;
+}
@@ -0,0 +1,32 @@
+/** @file
+  HOB list for host based tests of PeiHobVariableLibFce.
+
+  Provides the HobLib functions the library uses, on a HOB list in a static
+  buffer that the tests can empty between test cases.
+
+Copyright (c) 2026, agent <agent@local>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _HOST_HOB_H_
+#define _HOST_HOB_H_
+
+#include <PiPei.h>
+#include <Library/HobLib.h>
+
+//
+// Size of the HOB list, enough for a 64 KB variable store and its index
+//
+#define HOST_HOB_LIST_SIZE  SIZE_256KB
+
+/**
+  Empties the HOB list.
+
+**/
+VOID
+HostHobReset (
+  VOID
+  );
+
+#endif
@@ -14,6 +14,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/HobLib.h>
 #include <Library/PrintLib.h>
 #include <Guid/MemoryAllocationHob.h>
+#include <Guid/HobVariableIndex.h>
 
 #define MEMORY_ATTRIBUTE_MASK (EFI_RESOURCE_ATTRIBUTE_PRESENT | \
                                EFI_RESOURCE_ATTRIBUTE_INITIALIZED | \
@@ -284,6 +285,32 @@ DumpGuidHob (
   }
 }
 
+VOID
+DumpHobVariableIndex (
+  IN VOID                        *HobList
+  )
+{
+  EFI_HOB_GUID_TYPE           *GuidHob;
+  HOB_VARIABLE_INDEX          *VariableIndex;
+
+  GuidHob = GetNextGuidHob (&gHobVariableIndexHobGuid, HobList);
+  if (GuidHob == NULL) {
+    return;
+  }
+
+  VariableIndex = GET_GUID_HOB_DATA (GuidHob);
+  DEBUG ((DEBUG_INFO, "HOB variable index\n"));
+  DEBUG ((DEBUG_INFO,
+    "  Variables=%d  Slots=%d  Lookups=%d  Probes=%d  Misses=%d  LinearScans=%d\n",
+    VariableIndex->VariableCount,
+    VariableIndex->EntryCount,
+    VariableIndex->LookupCount,
+    VariableIndex->ProbeCount,
+    VariableIndex->MissCount,
+    VariableIndex->LinearScanCount
+    ));
+}
+
 VOID
 TestPointDumpHob (
   IN BOOLEAN  PhitHobOnly
@@ -313,6 +340,8 @@ TestPointDumpHob (
 
   DumpGuidHob (HobList);
 
+  DumpHobVariableIndex (HobList);
+
 Done:
   DEBUG ((DEBUG_INFO, "==== TestPointDumpHob - Exit\n"));
 
@@ -86,6 +86,52 @@ EFI_FW_VOL_BLOCK_DEVICE mFvbDeviceTemplate = {
 };
 
 
+STATIC
+VOID
+VarStoreMarkDirty (
+  IN UINTN Address,
+  IN UINTN Length
+  )
+{
+  UINTN Block;
+  UINTN LastBlock;
+
+  if (Length == 0) {
+    return;
+  }
+
+  Block = (Address - mFvInstance->FvBase) /
+            FixedPcdGet32 (PcdFirmwareBlockSize);
+  LastBlock = (Address - mFvInstance->FvBase + Length - 1) /
+                FixedPcdGet32 (PcdFirmwareBlockSize);
+
+  for (; Block <= LastBlock; Block++) {
+    mFvInstance->DirtyBlocks[Block / 8] |= (UINT8)(1 << (Block % 8));
+  }
+
+  mFvInstance->Dirty = TRUE;
+}
+
+
+BOOLEAN
+VarStoreIsBlockDirty (
+  IN UINTN Block
+  )
+{
+  return (mFvInstance->DirtyBlocks[Block / 8] & (1 << (Block % 8))) != 0;
+}
+
+
+VOID
+VarStoreClearDirty (
+  VOID
+  )
+{
+  ZeroMem (mFvInstance->DirtyBlocks, (mFvInstance->NumOfBlocks + 7) / 8);
+  mFvInstance->Dirty = FALSE;
+}
+
+
 EFI_STATUS
 VarStoreWrite (
   IN     UINTN Address,
@@ -94,7 +140,7 @@ VarStoreWrite (
   )
 {
   CopyMem ((VOID*)Address, Buffer, *NumBytes);
-  mFvInstance->Dirty = TRUE;
+  VarStoreMarkDirty (Address, *NumBytes);
 
   return EFI_SUCCESS;
 }
@@ -107,7 +153,7 @@ VarStoreErase (
   )
 {
   SetMem ((VOID*)Address, LbaLength, 0xff);
-  mFvInstance->Dirty = TRUE;
+  VarStoreMarkDirty (Address, LbaLength);
 
   return EFI_SUCCESS;
 }
@@ -833,7 +879,11 @@ FvbInitialize (
     FixedPcdGet32 (PcdNvStorageEventLogSize));
   StartOffset = BaseAddress - FixedPcdGet64 (PcdFdBaseAddress);
 
-  BufferSize = sizeof (EFI_FW_VOL_INSTANCE);
+  //
+  // Leave room for one dirty bit per block after the instance itself.
+  //
+  BufferSize = OFFSET_OF (EFI_FW_VOL_INSTANCE, DirtyBlocks) +
+               (UINT32)(Length / FixedPcdGet32 (PcdFirmwareBlockSize) + 7) / 8;
 
   mFvInstance = AllocateRuntimeZeroPool (BufferSize);
   if (mFvInstance == NULL) {
@@ -33,6 +33,12 @@ typedef struct {
   EFI_DEVICE_PATH_PROTOCOL   *Device;
   CHAR16                     *MappedFile;
   BOOLEAN                    Dirty;
+  //
+  // One bit per PcdFirmwareBlockSize block of the variable store, set when
+  // the block has been modified in memory but not yet written to MappedFile.
+  // Sized at allocation time, so this must remain the last member.
+  //
+  UINT8                      DirtyBlocks[1];
 } EFI_FW_VOL_INSTANCE;
 
 extern EFI_FW_VOL_INSTANCE *mFvInstance;
@@ -176,6 +182,16 @@ InstallDumpVarEventHandlers (
   VOID
 );
 
+BOOLEAN
+VarStoreIsBlockDirty (
+  IN UINTN Block
+  );
+
+VOID
+VarStoreClearDirty (
+  VOID
+  );
+
 EFI_STATUS
 FileWrite (
   IN EFI_FILE_PROTOCOL *File,
@@ -130,14 +130,40 @@ InstallVirtualAddressChangeHandler (
 }
 
 
+STATIC
+VOID
+RaiseResetDelay (
+  VOID
+  )
+{
+  RETURN_STATUS PcdStatus;
+
+  //
+  // Add a reset delay to give time for slow/cached devices
+  // to flush the NV variables write to permanent storage.
+  // But only do so if this won't reduce an existing user-set delay.
+  //
+  if (PcdGet32 (PcdPlatformResetDelay) < PLATFORM_RESET_DELAY) {
+    PcdStatus = PcdSet32S (PcdPlatformResetDelay, PLATFORM_RESET_DELAY);
+    ASSERT_RETURN_ERROR (PcdStatus);
+  }
+}
+
+
 STATIC
 EFI_STATUS
 DoDump (
-  IN EFI_DEVICE_PATH_PROTOCOL *Device
+  IN EFI_DEVICE_PATH_PROTOCOL *Device,
+  IN BOOLEAN                  All
   )
 {
   EFI_STATUS Status;
+  EFI_STATUS FlushStatus;
   EFI_FILE_PROTOCOL *File;
+  UINTN BlockSize;
+  UINTN Block;
+  UINTN End;
+  BOOLEAN Written;
 
   Status = FileOpen (Device,
              mFvInstance->MappedFile,
@@ -148,12 +174,66 @@ DoDump (
     return Status;
   }
 
-  Status = FileWrite (File,
-             mFvInstance->Offset,
-             mFvInstance->FvBase,
-             mFvInstance->FvLength);
-  FileClose (File);
-  return Status;
+  Written = FALSE;
+  if (All) {
+    Status = FileWrite (File,
+               mFvInstance->Offset,
+               mFvInstance->FvBase,
+               mFvInstance->FvLength);
+  } else {
+    //
+    // Only write back the blocks that changed, coalescing adjacent
+    // dirty blocks into a single write.
+    //
+    BlockSize = FixedPcdGet32 (PcdFirmwareBlockSize);
+    for (Block = 0; Block < mFvInstance->NumOfBlocks; Block = End) {
+      End = Block + 1;
+      if (!VarStoreIsBlockDirty (Block)) {
+        continue;
+      }
+
+      while (End < mFvInstance->NumOfBlocks && VarStoreIsBlockDirty (End)) {
+        End++;
+      }
+
+      Status = FileWrite (File,
+                 mFvInstance->Offset + Block * BlockSize,
+                 mFvInstance->FvBase + Block * BlockSize,
+                 (End - Block) * BlockSize);
+      Written = TRUE;
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+  }
+
+  //
+  // A successful Flush doesn't mean the data reached the media: the USB
+  // mass storage and SD/MMC block drivers complete FlushBlocks without
+  // touching the device's write cache. So any dirty block written back,
+  // even by a dump that failed part way, needs the reset delay. It is left
+  // alone only when no block was dirty. As before, the sync done when the
+  // volume shows up early in boot doesn't raise it.
+  //
+  if (Written) {
+    RaiseResetDelay ();
+  }
+
+  if (EFI_ERROR (Status)) {
+    FileClose (File);
+    return Status;
+  }
+
+  FlushStatus = File->Flush (File);
+  File->Close (File);
+
+  if (EFI_ERROR (FlushStatus)) {
+    DEBUG ((DEBUG_WARN, "Couldn't flush '%s': %r\n",
+      mFvInstance->MappedFile, FlushStatus));
+  }
+
+  VarStoreClearDirty ();
+  return EFI_SUCCESS;
 }
 
 
@@ -166,7 +246,6 @@ DumpVars (
   )
 {
   EFI_STATUS Status;
-  RETURN_STATUS PcdStatus;
 
   if (mFvInstance->Device == NULL) {
     DEBUG ((DEBUG_INFO, "Variable store not found?\n"));
@@ -178,7 +257,7 @@ DumpVars (
     return;
   }
 
-  Status = DoDump (mFvInstance->Device);
+  Status = DoDump (mFvInstance->Device, FALSE);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Couldn't dump '%s'\n", mFvInstance->MappedFile));
     ASSERT_EFI_ERROR (Status);
@@ -186,18 +265,6 @@ DumpVars (
   }
 
   DEBUG ((DEBUG_INFO, "Variables dumped!\n"));
-
-  //
-  // Add a reset delay to give time for slow/cached devices
-  // to flush the NV variables write to permanent storage.
-  // But only do so if this won't reduce an existing user-set delay.
-  //
-  if (PcdGet32 (PcdPlatformResetDelay) < PLATFORM_RESET_DELAY) {
-    PcdStatus = PcdSet32S (PcdPlatformResetDelay, PLATFORM_RESET_DELAY);
-    ASSERT_RETURN_ERROR (PcdStatus);
-  }
-
-  mFvInstance->Dirty = FALSE;
 }
 
 
@@ -305,7 +372,11 @@ OnSimpleFileSystemInstall (
       continue;
     }
 
-    Status = DoDump (Device);
+    //
+    // This volume need not be the one the firmware was loaded from, so
+    // bring the whole store in sync rather than just the dirty blocks.
+    //
+    Status = DoDump (Device, TRUE);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "Couldn't update '%s'\n", mFvInstance->MappedFile));
       ASSERT_EFI_ERROR (Status);
@@ -226,7 +226,7 @@ typedef struct {
   EFI_PHYSICAL_ADDRESS                RxBuffer;
   GENET_MAP_INFO                      RxBufferMap[GENET_DMA_DESC_COUNT];
   UINT16                              RxConsIndex;
-  UINT16                              RxProdIndex;
+  UINT16                              RxProdIndex;    // Last PROD_INDEX synced for the CPU
 
   GENET_PHY_MODE                      PhyMode;
 
@@ -369,6 +369,11 @@ GenetTxPending (
   IN  GENET_PRIVATE_DATA *Genet
   );
 
+UINT32
+GenetRxSync (
+  IN  GENET_PRIVATE_DATA *Genet
+  );
+
 EFI_STATUS
 GenetRxIntr (
   IN GENET_PRIVATE_DATA *Genet,
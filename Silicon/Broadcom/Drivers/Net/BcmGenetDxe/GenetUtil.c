@@ -7,6 +7,8 @@
 **/
 
 #include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/CacheMaintenanceLib.h>
 #include <Library/DebugLib.h>
 #include <Library/DmaLib.h>
 #include <Library/IoLib.h>
@@ -798,6 +800,56 @@ GenetTxPending (
   return (ConsIndex - Genet->TxConsIndex) & 0xFFFF;
 }
 
+/**
+  Make the RX buffers filled by the hardware since the last sync visible to
+  the CPU.
+
+  The RX buffers stay mapped for as long as the interface is initialized, so
+  instead of unmapping every buffer individually, the cache lines of all
+  newly completed descriptors are invalidated in one go. Only once those have
+  all been consumed is the producer index read again.
+
+  @param  Genet[in]  Pointer to GENET_PRIVATE_DATA.
+
+  @retval Number of received frames that can be consumed.
+
+**/
+UINT32
+GenetRxSync (
+  IN  GENET_PRIVATE_DATA *Genet
+  )
+{
+  UINT32 ProdIndex;
+  UINT32 Total;
+  UINT32 First;
+  UINT32 Count;
+
+  Total = (Genet->RxProdIndex - Genet->RxConsIndex) & 0xFFFF;
+  if (Total > 0) {
+    return Total;
+  }
+
+  ProdIndex = GenetMmioRead (Genet,
+                GENET_RX_DMA_PROD_INDEX (GENET_DMA_DEFAULT_QUEUE)) & 0xFFFF;
+  Total = MIN ((ProdIndex - Genet->RxConsIndex) & 0xFFFF, GENET_DMA_DESC_COUNT);
+  if (Total == 0) {
+    return 0;
+  }
+
+  // The new buffers are contiguous, unless the ring wraps around
+  First = Genet->RxConsIndex % GENET_DMA_DESC_COUNT;
+  Count = MIN (Total, GENET_DMA_DESC_COUNT - First);
+  InvalidateDataCacheRange (GENET_RX_BUFFER (Genet, First),
+    Count * GENET_MAX_PACKET_SIZE);
+  if (Count < Total) {
+    InvalidateDataCacheRange (GENET_RX_BUFFER (Genet, 0),
+      (Total - Count) * GENET_MAX_PACKET_SIZE);
+  }
+
+  Genet->RxProdIndex = (Genet->RxConsIndex + Total) & 0xFFFF;
+  return Total;
+}
+
 VOID
 GenetRxComplete (
   IN GENET_PRIVATE_DATA *Genet
@@ -831,7 +883,7 @@ GenetRxIntr (
   UINT32        Total;
   UINT32        DescStatus;
 
-  Total = GenetRxPending (Genet);
+  Total = GenetRxSync (Genet);
   if (Total > 0) {
     *DescIndex = Genet->RxConsIndex % GENET_DMA_DESC_COUNT;
     DescStatus = GenetMmioRead (Genet, GENET_RX_DESC_STATUS (*DescIndex));
@@ -757,10 +757,9 @@ GenetSimpleNetworkReceive (
     return Status;
   }
 
+  // The buffer stays mapped and was synced for the CPU by GenetRxIntr
   ASSERT (Genet->RxBufferMap[DescIndex].Mapping != NULL);
 
-  GenetDmaUnmapRxDescriptor (Genet, DescIndex);
-
   Frame = GENET_RX_BUFFER (Genet, DescIndex);
 
   if (FrameLength > 2 + Genet->SnpMode.MediaHeaderSize) {
@@ -772,8 +771,10 @@ GenetSimpleNetworkReceive (
       DEBUG ((DEBUG_ERROR,
         "%a: Buffer size (0x%X) is too small for frame (0x%X)\n",
         __FUNCTION__, *BufferSize, FrameLength));
-      Status = EFI_BUFFER_TOO_SMALL;
-      goto out;
+      // Leave the frame in the ring, so that it can be retried with a bigger buffer
+      *BufferSize = FrameLength;
+      EfiReleaseLock (&Genet->Lock);
+      return EFI_BUFFER_TOO_SMALL;
     }
 
     if (DestAddr != NULL) {
@@ -799,12 +800,6 @@ GenetSimpleNetworkReceive (
     Status = EFI_NOT_READY;
   }
 
-out:
-  Status = GenetDmaMapRxDescriptor (Genet, DescIndex);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "%a: Failed to remap RX descriptor!\n", __FUNCTION__));
-  }
-
   GenetRxComplete (Genet);
 
   EfiReleaseLock (&Genet->Lock);
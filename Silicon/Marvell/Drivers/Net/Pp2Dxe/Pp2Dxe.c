@@ -98,7 +98,7 @@ EFI_SIMPLE_NETWORK_MODE Pp2SnpModeTemplate = {
   },                                                    // Permanent Address
   NET_IFTYPE_ETHERNET,                                  // IfType
   TRUE,                                                 // MacAddressChangeable
-  FALSE,                                                // MultipleTxSupported
+  TRUE,                                                 // MultipleTxSupported
   TRUE,                                                 // MediaPresentSupported
   FALSE                                                 // MediaPresent
 };
@@ -142,6 +142,36 @@ QueueRemove (
   return Buffer;
 }
 
+#define QueueUsed(Ctx)  \
+  (((Ctx)->CompletionQueueTail + QUEUE_DEPTH - (Ctx)->CompletionQueueHead) % QUEUE_DEPTH)
+
+/*
+ * Move the buffers of all descriptors, which the HW reports as sent since
+ * the previous call, from the in-flight list to the completion queue.
+ */
+STATIC
+VOID
+Pp2DxeTxReap (
+  IN PP2DXE_CONTEXT *Pp2Context
+  )
+{
+  PP2DXE_PORT *Port = &Pp2Context->Port;
+  INTN TxSent;
+
+  if (Pp2Context->TxInFlightCount == 0) {
+    return;
+  }
+
+  /* Reading the counter clears it, so every sent buffer must be handed over now */
+  TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
+  while (TxSent-- > 0 && Pp2Context->TxInFlightCount > 0) {
+    QueueInsert (Pp2Context, Pp2Context->TxInFlight[Pp2Context->TxInFlightHead]);
+    Pp2Context->TxInFlight[Pp2Context->TxInFlightHead] = NULL;
+    Pp2Context->TxInFlightHead = (Pp2Context->TxInFlightHead + 1) % MVPP2_MAX_TXD;
+    Pp2Context->TxInFlightCount--;
+  }
+}
+
 STATIC
 EFI_STATUS
 Pp2DxeBmPoolInit (
@@ -671,6 +701,7 @@ Pp2SnpShutdown (
   SavedTpl = gBS->RaiseTPL (TPL_CALLBACK);
   PP2DXE_CONTEXT *Pp2Context = INSTANCE_FROM_SNP(This);
   UINT32 State = This->Mode->State;
+  INTN PollingCount;
 
   if (State != EfiSimpleNetworkInitialized) {
     switch (State) {
@@ -685,6 +716,25 @@ Pp2SnpShutdown (
     }
   }
 
+  /* Let the HW finish the outstanding packets, so their buffers can be recycled */
+  PollingCount = 0;
+  Pp2DxeTxReap (Pp2Context);
+  while (Pp2Context->TxInFlightCount != 0) {
+    if (PollingCount++ > MVPP2_TX_SEND_MAX_POLLING_COUNT) {
+      DEBUG((DEBUG_ERROR, "Pp2Dxe%d: %Lu packets not sent\n", Pp2Context->Instance, (UINT64)Pp2Context->TxInFlightCount));
+      /*
+       * The HW sent counter starts over once the port is initialized again,
+       * so entries left here would be reaped for packets sent later. Drop
+       * them, their buffers are never reported as transmitted.
+       */
+      ZeroMem (Pp2Context->TxInFlight, sizeof (Pp2Context->TxInFlight));
+      Pp2Context->TxInFlightHead = 0;
+      Pp2Context->TxInFlightCount = 0;
+      break;
+    }
+    Pp2DxeTxReap (Pp2Context);
+  }
+
   ReturnUnlock (SavedTpl, EFI_SUCCESS);
 }
 
@@ -834,6 +884,7 @@ Pp2SnpGetStatus (
   Snp->Mode->MediaPresent = LinkUp;
 
   if (TxBuf != NULL) {
+    Pp2DxeTxReap (Pp2Context);
     *TxBuf = QueueRemove (Pp2Context);
   }
 
@@ -857,9 +908,6 @@ Pp2SnpTransmit (
   MVPP2_SHARED *Mvpp2Shared = Pp2Context->Port.Priv;
   MVPP2_TX_QUEUE *AggrTxq = Mvpp2Shared->AggrTxqs;
   MVPP2_TX_DESC *TxDesc;
-  EFI_STATUS Status;
-  INTN PollingCount;
-  INTN TxSent;
   UINT8 *DataPtr = Buffer;
   UINT16 EtherType;
   UINT32 State = This->Mode->State;
@@ -899,6 +947,16 @@ Pp2SnpTransmit (
 
   EtherType = HTONS (*EtherTypePtr);
 
+  /*
+   * Every in-flight buffer has to fit in the completion queue once it is sent,
+   * so only post a new packet if there is room for it in both.
+   */
+  Pp2DxeTxReap (Pp2Context);
+  if (Pp2Context->TxInFlightCount >= Pp2Context->TxMaxPending ||
+      QueueUsed (Pp2Context) + Pp2Context->TxInFlightCount >= QUEUE_DEPTH - 1) {
+    ReturnUnlock (SavedTpl, EFI_NOT_READY);
+  }
+
   /* Fetch next descriptor */
   TxDesc = Mvpp2TxqNextDescGet(AggrTxq);
 
@@ -932,37 +990,13 @@ Pp2SnpTransmit (
   Mvpp2AggrTxqPendDescAdd(Port, 1);
 
   /*
-   * Egress processing:
-   * Wait until packet is passed from per-cpu aggregated queue
-   * to physical per-port TXQ.
+   * Don't wait for the HW - the buffer is handed back through GetStatus,
+   * once the TXQ sent counter covers its descriptor.
    */
-  PollingCount = 0;
-  TxSent = Mvpp2AggrTxqPendDescNumGet(Mvpp2Shared, 0);
-  do {
-    if (PollingCount++ > MVPP2_TX_SEND_MAX_POLLING_COUNT) {
-      DEBUG((DEBUG_ERROR, "Pp2Dxe: transmit polling failed\n"));
-      ReturnUnlock(SavedTpl, EFI_TIMEOUT);
-    }
-    TxSent = Mvpp2AggrTxqPendDescNumGet(Mvpp2Shared, 0);
-  } while (TxSent);
+  Pp2Context->TxInFlight[(Pp2Context->TxInFlightHead + Pp2Context->TxInFlightCount) % MVPP2_MAX_TXD] = Buffer;
+  Pp2Context->TxInFlightCount++;
 
-  /* Wait for packet to be transmitted by hardware. */
-  PollingCount = 0;
-  TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
-  while (!TxSent) {
-    if (PollingCount++ > MVPP2_TX_SEND_MAX_POLLING_COUNT) {
-      DEBUG((DEBUG_ERROR, "Pp2Dxe: transmit polling failed\n"));
-      ReturnUnlock(SavedTpl, EFI_TIMEOUT);
-    }
-    TxSent = Mvpp2TxqSentDescProc(Port, &Port->Txqs[0]);
-  }
-
-  /*
-   * At this point TxSent has increased - HW sent the packet
-   * Add buffer to completion queue and return.
-   */
-  Status = QueueInsert (Pp2Context, Buffer);
-  ReturnUnlock (SavedTpl, Status);
+  ReturnUnlock (SavedTpl, EFI_SUCCESS);
 }
 
 EFI_STATUS
@@ -1437,6 +1471,7 @@ Pp2DxeInitialiseController (
     }
 
     Pp2DxeParsePortPcd(Pp2Context, Index);
+    Pp2Context->TxMaxPending = MAX (1, MIN (PcdGet32 (PcdPp2TxMaxPending), MVPP2_MAX_TXD));
     Pp2Context->Port.TxpNum = 1;
     Pp2Context->Port.Priv = Mvpp2Shared;
     Pp2Context->Port.FirstRxq = 4 * (PortIndex - 1);
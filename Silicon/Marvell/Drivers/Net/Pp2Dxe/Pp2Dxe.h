@@ -143,8 +143,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define MTU                               1500
 
 /*
- * Maximum retries of checking, wheter HW really sent the packet
- * after it was done is software.
+ * Maximum retries of checking, wheter HW really sent the outstanding
+ * packets when the interface is shut down.
  */
 #define MVPP2_TX_SEND_MAX_POLLING_COUNT   10000
 
@@ -338,6 +338,11 @@ typedef struct {
   VOID                        *CompletionQueue[QUEUE_DEPTH];
   UINTN                       CompletionQueueHead;
   UINTN                       CompletionQueueTail;
+  /* Buffers posted to the TXQ, not yet reported as sent by the HW */
+  VOID                        *TxInFlight[MVPP2_MAX_TXD];
+  UINTN                       TxInFlightHead;
+  UINTN                       TxInFlightCount;
+  UINTN                       TxMaxPending;
   EFI_EVENT                   EfiExitBootServicesEvent;
   PP2_DEVICE_PATH             *DevicePath;
   EFI_ADAPTER_INFORMATION_PROTOCOL Aip;
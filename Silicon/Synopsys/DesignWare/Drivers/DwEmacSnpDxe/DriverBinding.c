@@ -127,6 +127,8 @@ DriverStart (
   if (Snp == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
+  // The ring bookkeeping and driver-maintained statistics start out cleared
+  ZeroMem (Snp, sizeof (SIMPLE_NETWORK_DRIVER));
 
   Status = gBS->OpenProtocol (Controller,
                               &gEdkiiNonDiscoverableDeviceProtocolGuid,
@@ -140,7 +142,7 @@ DriverStart (
   // Size for transmit and receive buffer
   BufferSize = ETH_BUFSIZE;
 
-  for (int Index=0; Index < DESC_NUM; Index++) {
+  for (int Index=0; Index < CONFIG_TX_DESCR_NUM; Index++) {
     //DMA TxdescRing allocate buffer and map
     Status = DmaAllocateBuffer (EfiBootServicesData,
                EFI_SIZE_TO_PAGES (sizeof (DESIGNWARE_HW_DESCRIPTOR)), (VOID *)&Snp->MacDriver.TxdescRing[Index]);
@@ -155,7 +157,9 @@ DriverStart (
       DEBUG ((DEBUG_ERROR, "%a () for TxdescRing: %r\n", __FUNCTION__, Status));
       return Status;
     }
+  }
 
+  for (int Index=0; Index < CONFIG_RX_DESCR_NUM; Index++) {
     // DMA RxdescRing allocte buffer and map
     Status = DmaAllocateBuffer (EfiBootServicesData,
                EFI_SIZE_TO_PAGES (sizeof (DESIGNWARE_HW_DESCRIPTOR)), (VOID *)&Snp->MacDriver.RxdescRing[Index]);
@@ -253,8 +257,8 @@ DriverStart (
   // Mac address is changeable as it is loaded from erasable memory
   SnpMode->MacAddressChangeable = TRUE;
 
-  // Can only transmit one packet at a time
-  SnpMode->MultipleTxSupported = FALSE;
+  // Frames are queued on the transmit descriptor ring
+  SnpMode->MultipleTxSupported = TRUE;
 
   // MediaPresent checks for cable connection and partner link
   SnpMode->MediaPresentSupported = TRUE;
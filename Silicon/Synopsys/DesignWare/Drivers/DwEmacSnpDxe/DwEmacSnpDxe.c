@@ -16,10 +16,174 @@
 #include "EmacDxeUtil.h"
 #include "PhyDxeUtil.h"
 
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/NetLib.h>
 #include <Library/DmaLib.h>
+#include <Library/TimerLib.h>
+
+/**
+  Returns the time elapsed between two performance counter values.
+
+  @param  Start    Performance counter value at the start.
+  @param  End      Performance counter value at the end.
+
+  @return The elapsed time, in nanoseconds.
+
+**/
+STATIC
+UINT64
+SnpElapsedNanoSeconds (
+  IN  UINT64    Start,
+  IN  UINT64    End
+  )
+{
+  UINT64    CounterStart;
+  UINT64    CounterEnd;
+
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+
+  // The counter may count down, and may wrap around once
+  if (CounterStart > CounterEnd) {
+    return GetTimeInNanoSecond ((Start >= End) ? (Start - End) : ((Start - CounterEnd) + (CounterStart - End)));
+  }
+
+  return GetTimeInNanoSecond ((End >= Start) ? (End - Start) : ((CounterEnd - Start) + (End - CounterStart)));
+}
+
+
+/**
+  Measures how many packets per second go through the transmit and receive
+  paths, by sending PcdDwEmacLoopbackSelfTestFrames frames through the MAC's
+  internal loopback and receiving them back with SnpTransmit () and
+  SnpReceive (). The result is reported on the debug output.
+
+  The interface must be initialized. Loopback mode is left once the test is
+  done, and the statistics counters are reset so the test frames don't show up
+  in them.
+
+  @param  Snp               Pointer to the driver instance.
+
+  @retval EFI_SUCCESS           Every frame came back intact.
+  @retval EFI_OUT_OF_RESOURCES  The frame buffers couldn't be allocated.
+  @retval EFI_TIMEOUT           Frames stopped coming back.
+  @retval EFI_DEVICE_ERROR      Frames came back corrupted.
+  @return Any other error from SnpTransmit () or SnpReceive ().
+
+**/
+STATIC
+EFI_STATUS
+SnpLoopbackSelfTest (
+  IN  SIMPLE_NETWORK_DRIVER   *Snp
+  )
+{
+  UINT8         *TxFrame;
+  UINT8         *RxFrame;
+  UINT32        Frames;
+  UINT32        Sent;
+  UINT32        Received;
+  UINT32        Corrupted;
+  UINTN         Index;
+  UINTN         Length;
+  UINT64        Start;
+  UINT64        LastProgress;
+  UINT64        ElapsedNs;
+  EFI_STATUS    Status;
+
+  Frames = FixedPcdGet32 (PcdDwEmacLoopbackSelfTestFrames);
+
+  TxFrame = AllocatePool (SNP_LOOPBACK_FRAME_SIZE);
+  RxFrame = AllocatePool (ETH_BUFSIZE);
+  if ((TxFrame == NULL) || (RxFrame == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto FreeFrames;
+  }
+
+  // The frame is addressed to the station address, so the receive filters
+  // take it whatever they are set to
+  CopyMem (&TxFrame[0], &Snp->SnpMode.CurrentAddress, NET_ETHER_ADDR_LEN);
+  CopyMem (&TxFrame[NET_ETHER_ADDR_LEN], &Snp->SnpMode.CurrentAddress, NET_ETHER_ADDR_LEN);
+  TxFrame[12] = (SNP_LOOPBACK_ETHER_TYPE & 0xFF00) >> 8;
+  TxFrame[13] = SNP_LOOPBACK_ETHER_TYPE & 0xFF;
+  for (Index = 14; Index < SNP_LOOPBACK_FRAME_SIZE; Index++) {
+    TxFrame[Index] = (UINT8)Index;
+  }
+
+  EmacSetLoopback (TRUE, Snp->MacBase);
+
+  Status = EFI_SUCCESS;
+  Sent = 0;
+  Received = 0;
+  Corrupted = 0;
+  Start = GetPerformanceCounter ();
+  LastProgress = Start;
+
+  while (Received + Corrupted < Frames) {
+    // Fill the transmit ring until SnpTransmit () has to wait for the DMA.
+    // Nobody calls GetStatus () for the test frames, so the buffers queued
+    // for recycling are taken back right away.
+    while (Sent < Frames) {
+      Status = SnpTransmit (&Snp->Snp, 0, SNP_LOOPBACK_FRAME_SIZE, TxFrame, NULL, NULL, NULL);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+      Snp->RecycledTxBufCount--;
+      Sent++;
+    }
+
+    if (EFI_ERROR (Status) && (Status != EFI_NOT_READY)) {
+      break;
+    }
+
+    Length = ETH_BUFSIZE;
+    Status = SnpReceive (&Snp->Snp, NULL, &Length, RxFrame, NULL, NULL, NULL);
+    if (!EFI_ERROR (Status)) {
+      if ((Length >= SNP_LOOPBACK_FRAME_SIZE) &&
+          (CompareMem (RxFrame, TxFrame, SNP_LOOPBACK_FRAME_SIZE) == 0)) {
+        Received++;
+      } else {
+        Corrupted++;
+      }
+      LastProgress = GetPerformanceCounter ();
+    } else if (Status == EFI_DEVICE_ERROR) {
+      // A frame came back with receive errors, and was dropped
+      Corrupted++;
+      LastProgress = GetPerformanceCounter ();
+    } else if (Status != EFI_NOT_READY) {
+      break;
+    } else if (SnpElapsedNanoSeconds (LastProgress, GetPerformanceCounter ()) > SNP_LOOPBACK_TIMEOUT_NS) {
+      Status = EFI_TIMEOUT;
+      break;
+    }
+
+    Status = EFI_SUCCESS;
+  }
+
+  ElapsedNs = SnpElapsedNanoSeconds (Start, GetPerformanceCounter ());
+
+  EmacSetLoopback (FALSE, Snp->MacBase);
+  EmacResetStatistic (Snp->MacBase);
+
+  DEBUG ((DEBUG_INFO, "SNP:DXE: Loopback self-test: %u of %u frames back (%u corrupted) in %Lu us, %Lu frames/s\n",
+          Received, Frames, Corrupted, DivU64x32 (ElapsedNs, 1000),
+          (ElapsedNs == 0) ? 0 : DivU64x64Remainder (MultU64x32 (Received, 1000000000), ElapsedNs, NULL)));
+
+  if (!EFI_ERROR (Status) && (Corrupted != 0)) {
+    Status = EFI_DEVICE_ERROR;
+  }
+
+FreeFrames:
+  if (TxFrame != NULL) {
+    FreePool (TxFrame);
+  }
+  if (RxFrame != NULL) {
+    FreePool (RxFrame);
+  }
+
+  return Status;
+}
+
 
 /**
   Change the state of a network interface from "stopped" to "started."
@@ -212,6 +376,14 @@ SnpInitialize (
   // Declare the driver as initialized
   Snp->SnpMode.State = EfiSimpleNetworkInitialized;
 
+  // A failed self-test is reported, but doesn't stop the interface from being used
+  if (FixedPcdGet32 (PcdDwEmacLoopbackSelfTestFrames) != 0) {
+    Status = SnpLoopbackSelfTest (Snp);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "SNP:DXE: Loopback self-test failed: %r\n", Status));
+    }
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -593,10 +765,15 @@ SnpStatistics (
   // Do a reset if required
   if (Reset) {
     ZeroMem (&Snp->Stats, sizeof(EFI_NETWORK_STATISTICS));
+    EmacResetStatistic (Snp->MacBase);
+  }
+
+  if (StatSize == NULL) {
+    return EFI_SUCCESS;
   }
 
   // Check buffer size
-  if (*StatSize < sizeof(EFI_NETWORK_STATISTICS)) {
+  if ((Statistics == NULL) || (*StatSize < sizeof(EFI_NETWORK_STATISTICS))) {
     *StatSize = sizeof(EFI_NETWORK_STATISTICS);
     return EFI_BUFFER_TOO_SMALL;
   }
@@ -605,7 +782,8 @@ SnpStatistics (
   EmacGetStatistic (&Snp->Stats, Snp->MacBase);
 
   // Fill in the statistics
-  CopyMem (&Statistics, &Snp->Stats, sizeof(EFI_NETWORK_STATISTICS));
+  *StatSize = sizeof(EFI_NETWORK_STATISTICS);
+  CopyMem (Statistics, &Snp->Stats, sizeof(EFI_NETWORK_STATISTICS));
 
   return EFI_SUCCESS;
 }
@@ -835,6 +1013,12 @@ SnpGetStatus (
     Snp->SnpMode.MediaPresent = TRUE;
   }
 
+  // Hand every descriptor the DMA has finished with back to the ring
+  if (!EFI_ERROR (EfiAcquireLockOrFail (&Snp->Lock))) {
+    EmacReclaimTxdesc (&Snp->MacDriver);
+    EfiReleaseLock (&Snp->Lock);
+  }
+
   // TxBuff
   if (TxBuff != NULL) {
     // Get a recycled buf from Snp->RecycledTxBuf
@@ -925,6 +1109,7 @@ SnpTransmit (
   DESIGNWARE_HW_DESCRIPTOR   *TxDescriptor;
   DESIGNWARE_HW_DESCRIPTOR   *TxDescriptorMap;
   UINT8                      *EthernetPacket;
+  UINT8                      *TxBufferAddr;
   UINT64                     *Tmp;
   EFI_STATUS                 Status;
   UINTN                      BufferSizeBuf;
@@ -933,30 +1118,17 @@ SnpTransmit (
   BufferSizeBuf = ETH_BUFSIZE;
   EthernetPacket = Data;
 
-  Snp = INSTANCE_FROM_SNP_THIS (This);
-
-  if (EFI_ERROR (EfiAcquireLockOrFail (&Snp->Lock))) {
-    return EFI_ACCESS_DENIED;
-  }
-
-  if ((Snp->MaxRecycledTxBuf + SNP_TX_BUFFER_INCREASE) >= SNP_MAX_TX_BUFFER_NUM) {
-    return EFI_NOT_READY;
-  }
-
   // Check preliminaries
   if ((This == NULL) || (Data == NULL)) {
     return EFI_INVALID_PARAMETER;
   }
+
+  Snp = INSTANCE_FROM_SNP_THIS (This);
+
   if (Snp->SnpMode.State != EfiSimpleNetworkInitialized) {
     return EFI_NOT_STARTED;
   }
 
-  Snp->MacDriver.TxCurrentDescriptorNum = Snp->MacDriver.TxNextDescriptorNum;
-  DescNum = Snp->MacDriver.TxCurrentDescriptorNum;
-
-  TxDescriptor = Snp->MacDriver.TxdescRing[DescNum];
-  TxDescriptorMap = (VOID *)(UINTN)Snp->MacDriver.TxdescRingMap[DescNum].AddrMap;
-
   // Ensure header is correct size if non-zero
   if (HdrSize) {
     if (HdrSize != Snp->SnpMode.MediaHeaderSize) {
@@ -972,8 +1144,53 @@ SnpTransmit (
   if (BuffSize < Snp->SnpMode.MediaHeaderSize) {
     return EFI_BUFFER_TOO_SMALL;
   }
+  if (BuffSize > ETH_BUFSIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (EFI_ERROR (EfiAcquireLockOrFail (&Snp->Lock))) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if ((Snp->MaxRecycledTxBuf + SNP_TX_BUFFER_INCREASE) >= SNP_MAX_TX_BUFFER_NUM) {
+    Status = EFI_NOT_READY;
+    goto ReleaseLock;
+  }
+
+  // Completed descriptors are only reclaimed in bulk, once the ring fills up
+  // here or when the caller polls GetStatus ()
+  if (Snp->MacDriver.TxDescriptorsInUse >= CONFIG_TX_DESCR_NUM) {
+    if (EmacReclaimTxdesc (&Snp->MacDriver) == 0) {
+      Status = EFI_NOT_READY;
+      goto ReleaseLock;
+    }
+  }
+
+  // Make sure the recycled buffer array can take this frame before queueing it
+  if (Snp->RecycledTxBufCount >= Snp->MaxRecycledTxBuf) {
+    Tmp = AllocatePool (sizeof (UINT64) * (Snp->MaxRecycledTxBuf + SNP_TX_BUFFER_INCREASE));
+    if (Tmp == NULL) {
+      Status = EFI_DEVICE_ERROR;
+      goto ReleaseLock;
+    }
+    CopyMem (Tmp, Snp->RecycledTxBuf, sizeof (UINT64) * Snp->RecycledTxBufCount);
+    FreePool (Snp->RecycledTxBuf);
+    Snp->RecycledTxBuf = Tmp;
+    Snp->MaxRecycledTxBuf += SNP_TX_BUFFER_INCREASE;
+  }
+
+  Snp->MacDriver.TxCurrentDescriptorNum = Snp->MacDriver.TxNextDescriptorNum;
+  DescNum = Snp->MacDriver.TxCurrentDescriptorNum;
+
+  TxDescriptor = Snp->MacDriver.TxdescRing[DescNum];
+  TxDescriptorMap = (VOID *)(UINTN)Snp->MacDriver.TxdescRingMap[DescNum].AddrMap;
+  TxBufferAddr = (UINT8 *)&Snp->MacDriver.TxBuffer[DescNum * CONFIG_ETH_BUFSIZE];
 
   if (HdrSize) {
+    if (SrcAddr == NULL) {
+      SrcAddr = &Snp->SnpMode.CurrentAddress;
+    }
+
     EthernetPacket[0] = DstAddr->Addr[0];
     EthernetPacket[1] = DstAddr->Addr[1];
     EthernetPacket[2] = DstAddr->Addr[2];
@@ -992,23 +1209,38 @@ SnpTransmit (
     EthernetPacket[12] = (*Protocol & 0xFF00) >> 8;
   }
 
-  CopyMem ((VOID *)(UINTN)TxDescriptor->Addr, EthernetPacket, BuffSize);
+  CopyMem (TxBufferAddr, EthernetPacket, BuffSize);
 
-  Status = DmaMap (MapOperationBusMasterRead, (VOID *)(UINTN)TxDescriptor->Addr,
-             &BufferSizeBuf, &TxBufferAddrMap, &Snp->MappingTxbuf);
+  // The mapping stays in place until the descriptor is reclaimed, as the DMA
+  // may still be reading the buffer after this function returns
+  Status = DmaMap (MapOperationBusMasterRead, TxBufferAddr,
+             &BufferSizeBuf, &TxBufferAddrMap, &Snp->MacDriver.TxBufNum[DescNum].Mapping);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a () for Txbuffer: %r\n", __FUNCTION__, Status));
-    return Status;
+    Snp->MacDriver.TxBufNum[DescNum].Mapping = NULL;
+    goto ReleaseLock;
   }
+  Snp->MacDriver.TxBufNum[DescNum].AddrMap = TxBufferAddrMap;
   TxDescriptorMap->Addr = TxBufferAddrMap;
 
   TxDescriptor->Tdes1 = (BuffSize << TDES1_SIZE1SHFT) &
                          TDES1_SIZE1MASK;
 
+  // Let the controller insert the IPv4 header and TCP/UDP/ICMP checksums;
+  // frames it does not recognise pass through untouched
+  if (Snp->MacDriver.TxChecksumOffload) {
+    TxDescriptor->Tdes0 |= TDES0_CIC_FULL;
+  }
+
+  // The descriptor must be complete before the DMA is given ownership
+  MemoryFence ();
+
   TxDescriptor->Tdes0 |= (TDES0_TXFIRST |
                           TDES0_TXLAST |
                           TDES0_OWN);
 
+  Snp->MacDriver.TxDescriptorsInUse++;
+
   // Increase descriptor number
   DescNum++;
 
@@ -1018,26 +1250,17 @@ SnpTransmit (
 
   Snp->MacDriver.TxNextDescriptorNum = DescNum;
 
-  if (Snp->RecycledTxBufCount < Snp->MaxRecycledTxBuf) {
-    Snp->RecycledTxBuf[Snp->RecycledTxBufCount] = (UINT64)(UINTN)Data;
-    Snp->RecycledTxBufCount ++;
-  } else {
-    Tmp = AllocatePool (sizeof (UINT64) * (Snp->MaxRecycledTxBuf + SNP_TX_BUFFER_INCREASE));
-    if (Tmp == NULL) {
-      return EFI_DEVICE_ERROR;
-    }
-    CopyMem (Tmp, Snp->RecycledTxBuf, sizeof (UINT64) * Snp->RecycledTxBufCount);
-    FreePool (Snp->RecycledTxBuf);
-    Snp->RecycledTxBuf = Tmp;
-    Snp->MaxRecycledTxBuf += SNP_TX_BUFFER_INCREASE;
-  }
+  // The frame was copied into the ring, so the caller's buffer can be
+  // recycled right away
+  Snp->RecycledTxBuf[Snp->RecycledTxBufCount] = (UINT64)(UINTN)Data;
+  Snp->RecycledTxBufCount++;
 
   // Start the transmission
   EmacDmaStart (Snp->MacBase);
 
-  DmaUnmap (Snp->MappingTxbuf);
+ReleaseLock:
   EfiReleaseLock (&Snp->Lock);
-  return EFI_SUCCESS;
+  return Status;
 }
 
 /**
@@ -1143,17 +1366,24 @@ SnpReceive (
 
   DescriptorStatus = RxDescriptor->Tdes0;
   if (DescriptorStatus & ((UINT32)RDES0_OWN)) {
+    Status = EFI_NOT_READY;
     goto ReleaseLock;
   }
 
+  // Frames that are rejected below still give their descriptor back to the
+  // DMA, otherwise the receive ring would stall on them
+  Status = EFI_DEVICE_ERROR;
+
   if (DescriptorStatus & RDES0_SAF) {
     DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: Source Address Filter Fail\n"));
-    return EFI_DEVICE_ERROR;
+    Snp->Stats.RxDroppedFrames++;
+    goto RecycleDescriptor;
   }
 
   if (DescriptorStatus & RDES0_AFM) {
     DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: Destination Address Filter Fail\n"));
-    return EFI_DEVICE_ERROR;
+    Snp->Stats.RxDroppedFrames++;
+    goto RecycleDescriptor;
   }
 
   if (DescriptorStatus & RDES0_ES) {
@@ -1170,7 +1400,17 @@ SnpReceive (
     if (DescriptorStatus & RDES0_LC) {
       DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: Late Collision\n"));
     }
-    if (DescriptorStatus & RDES0_GF) {
+    // With the checksum engine enabled, IPv4/IPv6 frames (frame type set)
+    // reuse the giant frame bit for header checksum errors and bit 0 for
+    // payload checksum errors
+    if (Snp->MacDriver.RxChecksumOffload && (DescriptorStatus & RDES0_FT)) {
+      if (DescriptorStatus & RDES0_GF) {
+        DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: IP Header Checksum Error\n"));
+      }
+      if (DescriptorStatus & RDES0_PCE) {
+        DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: Payload Checksum Error\n"));
+      }
+    } else if (DescriptorStatus & RDES0_GF) {
       DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: Giant Frame\n"));
     }
     if (DescriptorStatus & RDES0_OE) {
@@ -1187,18 +1427,23 @@ SnpReceive (
     if (DescriptorStatus & RDES0_CE) {
       DEBUG ((DEBUG_WARN, "SNP:DXE: Rx Descritpor Status Error: CRC Error\n"));
     }
-    return EFI_DEVICE_ERROR;
+    Snp->Stats.RxDroppedFrames++;
+    goto RecycleDescriptor;
   }
 
   Length = (DescriptorStatus >> RDES0_FL_SHIFT) & RDES0_FL_MASK;
   if (!Length) {
     DEBUG ((DEBUG_WARN, "SNP:DXE: Error: Invalid Frame Packet length \r\n"));
-    return EFI_NOT_READY;
+    Snp->Stats.RxDroppedFrames++;
+    Status = EFI_NOT_READY;
+    goto RecycleDescriptor;
   }
-  // Check buffer size
+  // Check buffer size, the frame stays queued for a retry with a larger buffer
   if (*BuffSize < Length) {
     DEBUG ((DEBUG_WARN, "SNP:DXE: Error: Buffer size is too small\n"));
-    return EFI_BUFFER_TOO_SMALL;
+    *BuffSize = Length;
+    Status = EFI_BUFFER_TOO_SMALL;
+    goto ReleaseLock;
   }
   *BuffSize = Length;
 
@@ -1243,11 +1488,12 @@ SnpReceive (
              &BufferSizeBuf, &RxBufferAddrMap, &Snp->MacDriver.RxBufNum[DescNum].Mapping);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a () for Rxbuffer: %r\n", __FUNCTION__, Status));
-    return Status;
+    goto ReleaseLock;
   }
   Snp->MacDriver.RxBufNum[DescNum].AddrMap = RxBufferAddrMap;
   RxDescriptorMap->Addr = Snp->MacDriver.RxBufNum[DescNum].AddrMap;
 
+RecycleDescriptor:
   RxDescriptor->Tdes0 |= (UINT32)RDES0_OWN;
 
   // Increase descriptor number
@@ -1258,11 +1504,8 @@ SnpReceive (
   }
   Snp->MacDriver.RxNextDescriptorNum = DescNum;
 
-  EfiReleaseLock (&Snp->Lock);
-  return EFI_SUCCESS;
-
 ReleaseLock:
   EfiReleaseLock (&Snp->Lock);
-  return EFI_NOT_READY;
+  return Status;
 }
 
@@ -66,9 +66,6 @@ typedef struct {
   // Current number of recycled buffer pointers in RecycledTxBuf
   UINT32                                 RecycledTxBufCount;
 
-  // For TX buffer DmaUnmap
-  VOID                                   *MappingTxbuf;
-
 } SIMPLE_NETWORK_DRIVER;
 
 extern EFI_COMPONENT_NAME_PROTOCOL       gSnpComponentName;
@@ -78,8 +75,14 @@ extern EFI_COMPONENT_NAME2_PROTOCOL      gSnpComponentName2;
 #define INSTANCE_FROM_SNP_THIS(a)        CR(a, SIMPLE_NETWORK_DRIVER, Snp, SNP_DRIVER_SIGNATURE)
 #define SNP_TX_BUFFER_INCREASE           32
 #define SNP_MAX_TX_BUFFER_NUM            65536
-#define DESC_NUM                         10
 #define ETH_BUFSIZE                      0x800
+
+// Loopback self-test frames: minimum sized, to the station address, with the
+// IEEE 802 local experimental EtherType. The test gives up if no frame makes
+// it through the loop for SNP_LOOPBACK_TIMEOUT_NS.
+#define SNP_LOOPBACK_FRAME_SIZE          60
+#define SNP_LOOPBACK_ETHER_TYPE          0x88B5
+#define SNP_LOOPBACK_TIMEOUT_NS          100000000ULL
 /*---------------------------------------------------------------------------------------------------------------------
 
   UEFI-Compliant functions for EFI_SIMPLE_NETWORK_PROTOCOL
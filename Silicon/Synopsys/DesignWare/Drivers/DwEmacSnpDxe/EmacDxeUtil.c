@@ -18,6 +18,7 @@
 
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/DmaLib.h>
 #include <Library/IoLib.h>
 #include <Library/MemoryAllocationLib.h>
 
@@ -90,11 +91,30 @@ EmacDxeInitialization (
   IN  UINTN         MacBaseAddress
   )
 {
+  UINT32  HwFeature;
+
   DEBUG ((DEBUG_INFO, "SNP:MAC: %a ()\r\n", __FUNCTION__));
 
   // Init EMAC DMA
   EmacDmaInit (EmacDriver, MacBaseAddress);
 
+  // Cores older than 3.50a have no HW feature register and read back zero,
+  // which leaves checksum offload disabled.
+  HwFeature = MmioRead32 (MacBaseAddress + DW_EMAC_DMAGRP_HW_FEATURE_OFST);
+  EmacDriver->TxChecksumOffload = (HwFeature & DW_EMAC_DMAGRP_HW_FEATURE_TXCOESEL_SET_MSK) != 0;
+  EmacDriver->RxChecksumOffload = (HwFeature & DW_EMAC_DMAGRP_HW_FEATURE_RXTYP2COE_SET_MSK) != 0;
+
+  // The software reset in EmacDmaInit () cleared the MAC configuration,
+  // so the receive checksum engine is enabled afterwards.
+  if (EmacDriver->RxChecksumOffload) {
+    MmioOr32 (MacBaseAddress +
+              DW_EMAC_GMACGRP_MAC_CONFIGURATION_OFST,
+              DW_EMAC_GMACGRP_MAC_CONFIGURATION_IPC_SET_MSK);
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:MAC: Checksum offload Tx %d Rx %d\r\n",
+          EmacDriver->TxChecksumOffload, EmacDriver->RxChecksumOffload));
+
   return EFI_SUCCESS;
 }
 
@@ -231,9 +251,15 @@ EmacSetupTxdesc (
   DESIGNWARE_HW_DESCRIPTOR   *TxDescriptor;
 
   for (Index = 0; Index < CONFIG_TX_DESCR_NUM; Index++) {
+    // Drop the mapping of any frame left over from before a re-initialization
+    if (EmacDriver->TxBufNum[Index].Mapping != NULL) {
+      DmaUnmap (EmacDriver->TxBufNum[Index].Mapping);
+      EmacDriver->TxBufNum[Index].Mapping = NULL;
+    }
+
     TxDescriptor = (VOID *)(UINTN)EmacDriver->TxdescRingMap[Index].AddrMap;
     TxDescriptor->Addr = (UINT32)(UINTN)&EmacDriver->TxBuffer[Index * CONFIG_ETH_BUFSIZE];
-    if (Index < 9) {
+    if (Index < CONFIG_TX_DESCR_NUM - 1) {
       TxDescriptor->AddrNext = (UINT32)(UINTN)EmacDriver->TxdescRingMap[Index + 1].AddrMap;
     }
     TxDescriptor->Tdes0 = TDES0_TXCHAIN;
@@ -251,6 +277,8 @@ EmacSetupTxdesc (
   // Initialize the descriptor number
   EmacDriver->TxCurrentDescriptorNum = 0;
   EmacDriver->TxNextDescriptorNum = 0;
+  EmacDriver->TxDirtyDescriptorNum = 0;
+  EmacDriver->TxDescriptorsInUse = 0;
 
   return EFI_SUCCESS;
 }
@@ -269,7 +297,7 @@ EmacSetupRxdesc (
   for (Index = 0; Index < CONFIG_RX_DESCR_NUM; Index++) {
     RxDescriptor = (VOID *)(UINTN)EmacDriver->RxdescRingMap[Index].AddrMap;
     RxDescriptor->Addr = EmacDriver->RxBufNum[Index].AddrMap;
-    if (Index < 9) {
+    if (Index < CONFIG_RX_DESCR_NUM - 1) {
       RxDescriptor->AddrNext = (UINT32)(UINTN)EmacDriver->RxdescRingMap[Index + 1].AddrMap;
     }
     RxDescriptor->Tdes0 = RDES0_OWN;
@@ -292,6 +320,48 @@ EmacSetupRxdesc (
 }
 
 
+UINT32
+EFIAPI
+EmacReclaimTxdesc (
+  IN  EMAC_DRIVER   *EmacDriver
+  )
+{
+  DESIGNWARE_HW_DESCRIPTOR   *TxDescriptor;
+  UINT32                     DescNum;
+  UINT32                     Reclaimed;
+
+  Reclaimed = 0;
+  DescNum = EmacDriver->TxDirtyDescriptorNum;
+
+  // The DMA completes descriptors in order, so stop at the first one it still owns
+  while (EmacDriver->TxDescriptorsInUse > 0) {
+    TxDescriptor = EmacDriver->TxdescRing[DescNum];
+    if (TxDescriptor->Tdes0 & TDES0_OWN) {
+      break;
+    }
+
+    if (EmacDriver->TxBufNum[DescNum].Mapping != NULL) {
+      DmaUnmap (EmacDriver->TxBufNum[DescNum].Mapping);
+      EmacDriver->TxBufNum[DescNum].Mapping = NULL;
+    }
+
+    // Leave only the chaining bit, the next frame sets up the rest
+    TxDescriptor->Tdes0 = TDES0_TXCHAIN;
+
+    DescNum++;
+    if (DescNum >= CONFIG_TX_DESCR_NUM) {
+      DescNum = 0;
+    }
+    EmacDriver->TxDescriptorsInUse--;
+    Reclaimed++;
+  }
+
+  EmacDriver->TxDirtyDescriptorNum = DescNum;
+
+  return Reclaimed;
+}
+
+
 VOID
 EFIAPI
 EmacStartTransmission (
@@ -616,11 +686,9 @@ EmacGetStatistic (
 
   DEBUG ((DEBUG_INFO, "SNP:MAC: %a ()\r\n", __FUNCTION__));
 
-  // Allocate Resources
-  Stats = AllocateZeroPool (sizeof (EFI_NETWORK_STATISTICS));
-  if (Stats == NULL) {
-    return;
-  }
+  // Only the hardware counters are refreshed; fields the MMC block does not
+  // count, such as RxDroppedFrames, are maintained by the driver.
+  Stats = Statistic;
 
   Stats->RxTotalFrames     = MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_RXFRAMECOUNT_GB_OFST);
   Stats->RxUndersizeFrames = MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_RXUNDERSIZE_G_OFST);
@@ -641,9 +709,44 @@ EmacGetStatistic (
   Stats->TxTotalBytes      = MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_TXOCTETCOUNT_GB_OFST);
   Stats->Collisions        = MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_TXLATECOL_OFST) +
                              MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_TXEXESSCOL_OFST);
+}
+
 
-  // Fill in the statistics
-  CopyMem (Statistic, Stats, sizeof (EFI_NETWORK_STATISTICS));
+VOID
+EFIAPI
+EmacResetStatistic (
+  IN   UINTN                     MacBaseAddress
+  )
+{
+  DEBUG ((DEBUG_INFO, "SNP:MAC: %a ()\r\n", __FUNCTION__));
+
+  // The counters reset bit clears itself once all MMC counters are zeroed
+  MmioOr32 (MacBaseAddress +
+            DW_EMAC_GMACGRP_MMC_CONTROL_OFST,
+            DW_EMAC_GMACGRP_MMC_CONTROL_CNTRST_SET_MSK);
+}
+
+
+VOID
+EFIAPI
+EmacSetLoopback (
+  IN  BOOLEAN  Enable,
+  IN  UINTN    MacBaseAddress
+  )
+{
+  DEBUG ((DEBUG_INFO, "SNP:MAC: %a (%d)\r\n", __FUNCTION__, Enable));
+
+  // In internal loopback the transmitted frames are turned around at the
+  // MII and never reach the PHY
+  if (Enable) {
+    MmioOr32 (MacBaseAddress +
+              DW_EMAC_GMACGRP_MAC_CONFIGURATION_OFST,
+              DW_EMAC_GMACGRP_MAC_CONFIGURATION_LM_SET_MSK);
+  } else {
+    MmioAnd32 (MacBaseAddress +
+               DW_EMAC_GMACGRP_MAC_CONFIGURATION_OFST,
+               DW_EMAC_GMACGRP_MAC_CONFIGURATION_LM_CLR_MSK);
+  }
 }
 
 
@@ -19,14 +19,16 @@
 
 #include <Protocol/SimpleNetwork.h>
 
+#include <Library/PcdLib.h>
+
 // Most common CRC32 Polynomial for little endian machines
 #define CRC_POLYNOMIAL                                            0xEDB88320
 #define HASH_TABLE_REG(n)                                         0x500 + (0x4 * n)
 #define RX_MAX_PACKET                                             1600
 
 #define CONFIG_ETH_BUFSIZE                                         2048
-#define CONFIG_TX_DESCR_NUM                                        10
-#define CONFIG_RX_DESCR_NUM                                        10
+#define CONFIG_TX_DESCR_NUM                                        FixedPcdGet32 (PcdDwEmacTxDescriptorCount)
+#define CONFIG_RX_DESCR_NUM                                        FixedPcdGet32 (PcdDwEmacRxDescriptorCount)
 #define TX_TOTAL_BUFSIZE                                           (CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
 #define RX_TOTAL_BUFSIZE                                           (CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
 
@@ -44,6 +46,7 @@
 #define TDES0_TXLAST                                               BIT29
 #define TDES0_TXFIRST                                              BIT28
 #define TDES0_TXCRCDIS                                             BIT27
+#define TDES0_CIC_FULL                                             (BIT23 | BIT22)
 #define TDES0_TXRINGEND                                            BIT21
 #define TDES0_TXCHAIN                                              BIT20
 
@@ -57,10 +60,12 @@
 #define RDES0_FL_SHIFT                                              16
 #define RDES1_CHAINED                                               BIT14
 
+#define RDES0_PCE                                                   BIT0
 #define RDES0_CE                                                    BIT1
 #define RDES0_DBE                                                   BIT2
 #define RDES0_RE                                                    BIT3
 #define RDES0_RWT                                                   BIT4
+#define RDES0_FT                                                    BIT5
 #define RDES0_LC                                                    BIT6
 #define RDES0_GF                                                    BIT7
 #define RDES0_OE                                                    BIT11
@@ -112,6 +117,7 @@
 #define DW_EMAC_DMAGRP_OPERATION_MODE_ST_CLR_MSK                    0xffffdfff
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_RE_CLR_MSK                0xfffffffb
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_TE_CLR_MSK                0xfffffff7
+#define DW_EMAC_GMACGRP_MAC_CONFIGURATION_LM_CLR_MSK                0xffffefff
 #define DW_EMAC_DMAGRP_OPERATION_MODE_SR_CLR_MSK                    0xfffffffd
 #define DW_EMAC_DMAGRP_STATUS_NIS_SET_MSK                           0x00010000
 #define DW_EMAC_DMAGRP_STATUS_RI_SET_MSK                            0x00000040
@@ -131,8 +137,13 @@
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_PS_SET_MSK                0x00008000
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_FES_SET_MSK               0x00004000
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_DM_SET_MSK                0x00000800
+#define DW_EMAC_GMACGRP_MAC_CONFIGURATION_LM_SET_MSK                0x00001000
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_BE_SET_MSK                0x00200000
 #define DW_EMAC_GMACGRP_MAC_CONFIGURATION_DO_SET_MSK                0x00002000
+#define DW_EMAC_GMACGRP_MAC_CONFIGURATION_IPC_SET_MSK               0x00000400
+#define DW_EMAC_GMACGRP_MMC_CONTROL_CNTRST_SET_MSK                  0x00000001
+#define DW_EMAC_DMAGRP_HW_FEATURE_TXCOESEL_SET_MSK                  0x00010000
+#define DW_EMAC_DMAGRP_HW_FEATURE_RXTYP2COE_SET_MSK                 0x00040000
 
 #define DW_EMAC_DMAGRP_BUS_MODE_SWR_GET(value)                      (((value) & 0x00000001) >> 0)
 #define DW_EMAC_DMAGRP_STATUS_EB_GET(value)                         (((value) & 0x03800000) >> 23)
@@ -248,11 +259,18 @@ typedef struct {
   CHAR8                       RxBuffer[RX_TOTAL_BUFSIZE];
   MAP_INFO                    TxdescRingMap[CONFIG_TX_DESCR_NUM ];
   MAP_INFO                    RxdescRingMap[CONFIG_RX_DESCR_NUM ];
-  MAP_INFO                    RxBufNum[CONFIG_TX_DESCR_NUM];
+  MAP_INFO                    RxBufNum[CONFIG_RX_DESCR_NUM];
+  MAP_INFO                    TxBufNum[CONFIG_TX_DESCR_NUM];
   UINT32                      TxCurrentDescriptorNum;
   UINT32                      TxNextDescriptorNum;
+  // Oldest transmit descriptor not yet reclaimed, and how many are in flight
+  UINT32                      TxDirtyDescriptorNum;
+  UINT32                      TxDescriptorsInUse;
   UINT32                      RxCurrentDescriptorNum;
   UINT32                      RxNextDescriptorNum;
+  // Checksum offload engines reported by the HW feature register
+  BOOLEAN                     TxChecksumOffload;
+  BOOLEAN                     RxChecksumOffload;
 } EMAC_DRIVER;
 
 VOID
@@ -297,6 +315,12 @@ EmacSetupRxdesc (
   IN  UINTN                   MacBaseAddress
   );
 
+UINT32
+EFIAPI
+EmacReclaimTxdesc (
+  IN  EMAC_DRIVER             *EmacDriver
+  );
+
 VOID
 EFIAPI
 EmacStartTransmission (
@@ -353,6 +377,19 @@ EmacGetStatistic (
   IN  UINTN                  MacBaseAddress
   );
 
+VOID
+EFIAPI
+EmacResetStatistic (
+  IN  UINTN                  MacBaseAddress
+  );
+
+VOID
+EFIAPI
+EmacSetLoopback (
+  IN  BOOLEAN                Enable,
+  IN  UINTN                  MacBaseAddress
+  );
+
 VOID
 EFIAPI
 EmacConfigAdjust (